@@ -509,6 +509,42 @@ core.register_chatcommand("set", {
 	end,
 })
 
+core.register_chatcommand("tunables", {
+	params = "",
+	description = "List runtime performance tunables",
+	privs = {server=true},
+	func = function(name, param)
+		local tunables = core.get_tunables()
+		local lines = {}
+		for tname, info in pairs(tunables) do
+			lines[#lines + 1] = string.format("%s = %g  [%g..%g]  %s",
+				tname, info.value, info.min, info.max, info.help)
+		end
+		if #lines == 0 then
+			return true, "No tunables registered."
+		end
+		table.sort(lines)
+		return true, table.concat(lines, "\n")
+	end,
+})
+
+core.register_chatcommand("set_tunable", {
+	params = "<name> <value>",
+	description = "Set a runtime performance tunable (not persisted)",
+	privs = {server=true},
+	func = function(name, param)
+		local tname, tvalue = string.match(param, "([^ ]+) (.+)")
+		if not tname then
+			return false, "Invalid parameters (see /help set_tunable)."
+		end
+		local ok, err = core.set_tunable(tname, tvalue)
+		if not ok then
+			return false, "Failed: " .. err
+		end
+		return true, tname .. " = " .. tvalue
+	end,
+})
+
 local function emergeblocks_callback(pos, action, num_calls_remaining, ctx)
 	if ctx.total_blocks == 0 then
 		ctx.total_blocks   = num_calls_remaining + 1
@@ -840,6 +876,14 @@ core.register_chatcommand("status", {
 	end,
 })
 
+core.register_chatcommand("network_stats", {
+	description = "Show per-packet-type network statistics",
+	privs = {server=true},
+	func = function(name, param)
+		return true, core.get_network_stats()
+	end,
+})
+
 core.register_chatcommand("time", {
 	params = "[<0..23>:<0..59> | <0..24000>]",
 	description = "Show or set time of day",
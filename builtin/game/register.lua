@@ -585,6 +585,26 @@ core.unregister_biome = make_wrap_deregistration(core.register_biome,
 
 core.registered_on_chat_messages, core.register_on_chat_message = make_registration()
 core.registered_globalsteps, core.register_globalstep = make_registration()
+
+-- Globalsteps registered with an interval are kept in a separate list;
+-- the engine advances their timers and only calls the ones that are due.
+core.registered_rated_globalsteps = {}
+local register_globalstep_raw = core.register_globalstep
+core.register_globalstep = function(func, interval)
+	if interval and interval > 0 then
+		core.registered_rated_globalsteps[#core.registered_rated_globalsteps + 1] = {
+			func = func,
+			interval = interval,
+			timer = 0,
+		}
+		core.callback_origins[func] = {
+			mod = core.get_current_modname() or "??",
+			name = "register_globalstep"
+		}
+	else
+		register_globalstep_raw(func)
+	end
+end
 core.registered_playerevents, core.register_playerevent = make_registration()
 core.registered_on_mods_loaded, core.register_on_mods_loaded = make_registration()
 core.registered_on_shutdown, core.register_on_shutdown = make_registration()
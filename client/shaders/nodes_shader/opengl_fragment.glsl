@@ -9,6 +9,10 @@ uniform vec3 eyePosition;
 // The cameraOffset is the current center of the visible world.
 uniform vec3 cameraOffset;
 uniform float animationTimer;
+// x = frame count of the tile animation (1 = not animated),
+// y = frame length in milliseconds. The base texture holds all frames
+// stacked vertically; the current frame is selected below.
+uniform vec2 animationParams;
 
 varying vec3 vPosition;
 // World position in the visible world (i.e. relative to the cameraOffset.)
@@ -20,9 +24,8 @@ varying vec3 worldPosition;
 varying float area_enable_parallax;
 
 varying vec3 eyeVec;
-varying vec3 tsEyeVec;
 varying vec3 lightVec;
-varying vec3 tsLightVec;
+varying vec3 vNormal;
 
 bool normalTexturePresent = false;
 
@@ -133,10 +136,33 @@ void main(void)
 	vec3 color;
 	vec4 bump;
 	vec2 uv = gl_TexCoord[0].st;
+
+	if (animationParams.x > 1.0) {
+		// Map the single-frame texture coordinates into the current
+		// frame of the vertical frame strip. animationTimer wraps
+		// every 1000 seconds (see GameGlobalShaderConstantSetter).
+		float frame = floor(mod(animationTimer * 100000.0 / animationParams.y,
+				animationParams.x));
+		uv.y = (uv.y + frame) / animationParams.x;
+	}
 	bool use_normalmap = false;
 	get_texture_flags();
 
 #ifdef ENABLE_PARALLAX_OCCLUSION
+	// Derive the tangent space from screen-space derivatives of the
+	// position and texture coordinates (the cotangent frame of Schueler)
+	// instead of per-vertex tangent attributes.
+	vec3 pos = -eyeVec;
+	vec3 dp1 = dFdx(pos);
+	vec3 dp2 = dFdy(pos);
+	vec2 duv1 = dFdx(uv);
+	vec2 duv2 = dFdy(uv);
+	vec3 tangent = normalize(cross(dp2, vNormal) * duv1.x
+			+ cross(vNormal, dp1) * duv2.x);
+	vec3 binormal = normalize(cross(dp2, vNormal) * duv1.y
+			+ cross(vNormal, dp1) * duv2.y);
+	vec3 tsEyeVec = normalize(vec3(dot(eyeVec, tangent),
+			dot(eyeVec, binormal), dot(eyeVec, vNormal)));
 	vec2 eyeRay = vec2 (tsEyeVec.x, -tsEyeVec.y);
 	const float scale = PARALLAX_OCCLUSION_SCALE / PARALLAX_OCCLUSION_ITERATIONS;
 	const float bias = PARALLAX_OCCLUSION_BIAS / PARALLAX_OCCLUSION_ITERATIONS;
@@ -19,8 +19,7 @@ varying vec3 worldPosition;
 
 varying vec3 eyeVec;
 varying vec3 lightVec;
-varying vec3 tsEyeVec;
-varying vec3 tsLightVec;
+varying vec3 vNormal;
 varying float area_enable_parallax;
 
 // Color of the light emitted by the light sources.
@@ -111,24 +110,12 @@ float disp_z;
 
 	vec3 sunPosition = vec3 (0.0, eyePosition.y * BS + 900.0, 0.0);
 
-	vec3 normal, tangent, binormal;
-	normal = normalize(gl_NormalMatrix * gl_Normal);
-	tangent = normalize(gl_NormalMatrix * gl_MultiTexCoord1.xyz);
-	binormal = normalize(gl_NormalMatrix * gl_MultiTexCoord2.xyz);
-
-	vec3 v;
+	// The tangent space vectors are derived in the fragment shader from
+	// screen-space derivatives; only the normal is passed along here.
+	vNormal = normalize(gl_NormalMatrix * gl_Normal);
 
 	lightVec = sunPosition - worldPosition;
-	v.x = dot(lightVec, tangent);
-	v.y = dot(lightVec, binormal);
-	v.z = dot(lightVec, normal);
-	tsLightVec = normalize (v);
-
 	eyeVec = -(gl_ModelViewMatrix * gl_Vertex).xyz;
-	v.x = dot(eyeVec, tangent);
-	v.y = dot(eyeVec, binormal);
-	v.z = dot(eyeVec, normal);
-	tsEyeVec = normalize (v);
 
 	// Calculate color.
 	// Red, green and blue components are pre-multiplied with
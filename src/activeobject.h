@@ -44,10 +44,12 @@ enum ActiveObjectType {
 
 struct ActiveObjectMessage
 {
-	ActiveObjectMessage(u16 id_, bool reliable_=true, const std::string &data_ = "") :
+	// data is taken by value so callers can move their built message
+	// through the whole queue chain without a copy
+	ActiveObjectMessage(u16 id_, bool reliable_=true, std::string data_ = "") :
 		id(id_),
 		reliable(reliable_),
-		datastring(data_)
+		datastring(std::move(data_))
 	{}
 
 	u16 id;
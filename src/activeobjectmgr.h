@@ -42,6 +42,8 @@ public:
 		return (n != m_active_objects.end() ? n->second : nullptr);
 	}
 
+	size_t getActiveObjectsCount() const { return m_active_objects.size(); }
+
 protected:
 	u16 getFreeId() const
 	{
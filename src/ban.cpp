@@ -27,9 +27,32 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/string.h"
 #include "log.h"
 #include "filesys.h"
+#include "util/thread.h"
+
+class BanSaveThread : public UpdateThread
+{
+public:
+	BanSaveThread(BanManager *manager) :
+		UpdateThread("BanSave"), m_manager(manager) {}
+
+protected:
+	void doUpdate()
+	{
+		try {
+			if (m_manager->isModified())
+				m_manager->save();
+		} catch (SerializationError &e) {
+			warningstream << "BanManager: " << e.what() << std::endl;
+		}
+	}
+
+private:
+	BanManager *m_manager;
+};
 
 BanManager::BanManager(const std::string &banfilepath):
-		m_banfilepath(banfilepath)
+		m_banfilepath(banfilepath),
+		m_ips_snapshot(std::make_shared<const StringMap>())
 {
 	try {
 		load();
@@ -37,10 +60,17 @@ BanManager::BanManager(const std::string &banfilepath):
 		infostream << "BanManager: creating "
 				<< m_banfilepath << std::endl;
 	}
+
+	m_save_thread = new BanSaveThread(this);
+	m_save_thread->start();
 }
 
 BanManager::~BanManager()
 {
+	m_save_thread->stop();
+	m_save_thread->wait();
+	delete m_save_thread;
+
 	save();
 }
 
@@ -64,37 +94,47 @@ void BanManager::load()
 			m_ips[ip] = name;
 		}
 	}
+	updateSnapshot();
 	m_modified = false;
 }
 
 void BanManager::save()
 {
-	MutexAutoLock lock(m_mutex);
+	MutexAutoLock save_lock(m_save_mutex);
 	infostream << "BanManager: saving to " << m_banfilepath << std::endl;
 	std::ostringstream ss(std::ios_base::binary);
 
-	for (const auto &ip : m_ips)
-		ss << ip.first << "|" << ip.second << "\n";
+	{
+		MutexAutoLock lock(m_mutex);
+		for (const auto &ip : m_ips)
+			ss << ip.first << "|" << ip.second << "\n";
+		m_modified = false;
+	}
 
 	if (!fs::safeWriteToFile(m_banfilepath, ss.str())) {
 		infostream << "BanManager: failed saving to " << m_banfilepath << std::endl;
+		MutexAutoLock lock(m_mutex);
+		m_modified = true;
 		throw SerializationError("BanManager::save(): Couldn't write file");
 	}
+}
 
-	m_modified = false;
+void BanManager::deferSave()
+{
+	m_save_thread->deferUpdate();
 }
 
 bool BanManager::isIpBanned(const std::string &ip)
 {
-	MutexAutoLock lock(m_mutex);
-	return m_ips.find(ip) != m_ips.end();
+	std::shared_ptr<const StringMap> ips = std::atomic_load(&m_ips_snapshot);
+	return ips->find(ip) != ips->end();
 }
 
 std::string BanManager::getBanDescription(const std::string &ip_or_name)
 {
-	MutexAutoLock lock(m_mutex);
+	std::shared_ptr<const StringMap> ips = std::atomic_load(&m_ips_snapshot);
 	std::string s;
-	for (const auto &ip : m_ips) {
+	for (const auto &ip : *ips) {
 		if (ip.first  == ip_or_name || ip.second == ip_or_name
 				|| ip_or_name.empty()) {
 			s += ip.first + "|" + ip.second + ", ";
@@ -106,9 +146,9 @@ std::string BanManager::getBanDescription(const std::string &ip_or_name)
 
 std::string BanManager::getBanName(const std::string &ip)
 {
-	MutexAutoLock lock(m_mutex);
-	StringMap::iterator it = m_ips.find(ip);
-	if (it == m_ips.end())
+	std::shared_ptr<const StringMap> ips = std::atomic_load(&m_ips_snapshot);
+	StringMap::const_iterator it = ips->find(ip);
+	if (it == ips->end())
 		return "";
 	return it->second;
 }
@@ -117,6 +157,7 @@ void BanManager::add(const std::string &ip, const std::string &name)
 {
 	MutexAutoLock lock(m_mutex);
 	m_ips[ip] = name;
+	updateSnapshot();
 	m_modified = true;
 }
 
@@ -131,6 +172,14 @@ void BanManager::remove(const std::string &ip_or_name)
 			++it;
 		}
 	}
+	if (m_modified)
+		updateSnapshot();
+}
+
+void BanManager::updateSnapshot()
+{
+	std::atomic_store(&m_ips_snapshot,
+			std::shared_ptr<const StringMap>(new StringMap(m_ips)));
 }
 
 
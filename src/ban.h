@@ -23,9 +23,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "threading/thread.h"
 #include "exceptions.h"
 #include <map>
+#include <memory>
 #include <string>
 #include <mutex>
 
+class BanSaveThread;
+
 class BanManager
 {
 public:
@@ -33,6 +36,9 @@ public:
 	~BanManager();
 	void load();
 	void save();
+	// Queues a save on the ban manager's own thread if there are
+	// unsaved changes
+	void deferSave();
 	bool isIpBanned(const std::string &ip);
 	// Supplying ip_or_name = "" lists all bans.
 	std::string getBanDescription(const std::string &ip_or_name);
@@ -42,8 +48,19 @@ public:
 	bool isModified();
 
 private:
+	// Replaces m_ips_snapshot with a copy of m_ips (m_mutex must be held)
+	void updateSnapshot();
+
+	// Protects m_ips and m_modified
 	std::mutex m_mutex;
+	// Serializes concurrent save() callers
+	std::mutex m_save_mutex;
 	std::string m_banfilepath = "";
 	StringMap m_ips;
+	// Immutable copy of m_ips swapped atomically on every change, so
+	// lookups on the connection handling path never take m_mutex
+	std::shared_ptr<const StringMap> m_ips_snapshot;
 	bool m_modified = false;
+
+	BanSaveThread *m_save_thread = nullptr;
 };
@@ -0,0 +1,74 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+
+#include <sstream>
+#include "noise.h"
+#include "serialization.h"
+
+class BenchCompression : public BenchBase {
+public:
+	BenchCompression() { BenchManager::registerModule(this); }
+	const char *getName() { return "BenchCompression"; }
+
+	void runBenchmarks();
+};
+
+static BenchCompression g_bench_instance;
+
+void BenchCompression::runBenchmarks()
+{
+	// Roughly block-payload-like input: repetitive with some entropy,
+	// so the compressors neither short-circuit nor work on pure noise
+	const size_t payload_size = 10000;
+	std::string payload;
+	payload.reserve(payload_size);
+	PseudoRandom pr(1337);
+	for (size_t i = 0; i < payload_size; i++)
+		payload += (char)(pr.next() % 16);
+
+	bench("compressZlib 10 KB payload", 1, [&] {
+		std::ostringstream os(std::ios_base::binary);
+		compressZlib(payload, os);
+	});
+
+	std::ostringstream os_zlib(std::ios_base::binary);
+	compressZlib(payload, os_zlib);
+	const std::string compressed_zlib = os_zlib.str();
+	bench("decompressZlib 10 KB payload", 1, [&] {
+		std::istringstream is(compressed_zlib, std::ios_base::binary);
+		std::ostringstream os(std::ios_base::binary);
+		decompressZlib(is, os);
+	});
+
+	bench("compressZstd 10 KB payload", 1, [&] {
+		std::ostringstream os(std::ios_base::binary);
+		compressZstd(payload, os);
+	});
+
+	std::ostringstream os_zstd(std::ios_base::binary);
+	compressZstd(payload, os_zstd);
+	const std::string compressed_zstd = os_zstd.str();
+	bench("decompressZstd 10 KB payload", 1, [&] {
+		std::istringstream is(compressed_zstd, std::ios_base::binary);
+		std::ostringstream os(std::ios_base::binary);
+		decompressZstd(is, os);
+	});
+}
@@ -0,0 +1,72 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+
+#include <vector>
+#include "network/connection.h"
+
+class BenchConnection : public BenchBase {
+public:
+	BenchConnection() { BenchManager::registerModule(this); }
+	const char *getName() { return "BenchConnection"; }
+
+	void runBenchmarks();
+};
+
+static BenchConnection g_bench_instance;
+
+void BenchConnection::runBenchmarks()
+{
+	// A send window worth of reliable packets with typical small payloads
+	const u16 window_size = 256;
+	const u16 first_seqnum = 65500; // crosses the u16 wraparound
+
+	Address address(127, 0, 0, 1, 30000);
+	std::vector<con::BufferedPacketPtr> packets;
+	for (u16 i = 0; i < window_size; i++) {
+		SharedBuffer<u8> data(128);
+		SharedBuffer<u8> reliable =
+				con::makeReliablePacket(data, first_seqnum + i);
+		packets.push_back(con::makePacket(address, reliable,
+				0x4f457403, 2, 0));
+	}
+
+	{
+		con::ReliablePacketBuffer buffer;
+		bench("ReliablePacketBuffer insert+popFirst", 2 * window_size, [&] {
+			for (const con::BufferedPacketPtr &p : packets)
+				buffer.insert(p, first_seqnum);
+			while (buffer.size() > 0)
+				buffer.popFirst();
+		});
+	}
+
+	{
+		// ACK pattern: every incoming ack pops its seqnum from the
+		// middle of the window
+		con::ReliablePacketBuffer buffer;
+		bench("ReliablePacketBuffer insert+popSeqnum", 2 * window_size, [&] {
+			for (const con::BufferedPacketPtr &p : packets)
+				buffer.insert(p, first_seqnum);
+			for (u16 i = window_size; i > 0; i--)
+				buffer.popSeqnum(first_seqnum + i - 1);
+		});
+	}
+}
@@ -0,0 +1,78 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+
+#include <sstream>
+#include "mapnode.h"
+#include "noise.h"
+#include "serialization.h"
+#include "util/serialize.h"
+
+class BenchMapNode : public BenchBase {
+public:
+	BenchMapNode() { BenchManager::registerModule(this); }
+	const char *getName() { return "BenchMapNode"; }
+
+	void runBenchmarks();
+};
+
+static BenchMapNode g_bench_instance;
+
+void BenchMapNode::runBenchmarks()
+{
+	// One mapblock worth of nodes with a mapgen-typical handful of
+	// distinct contents
+	const u32 nodecount = 16 * 16 * 16;
+	std::vector<MapNode> nodes(nodecount);
+	PseudoRandom pr(1337);
+	for (u32 i = 0; i < nodecount; i++)
+		nodes[i] = MapNode(pr.next() % 8, pr.next() % 256, pr.next() % 4);
+
+	bench("MapNode::serializeBulk 4096 nodes, raw", nodecount, [&] {
+		std::ostringstream os(std::ios_base::binary);
+		MapNode::serializeBulk(os, SER_FMT_VER_HIGHEST_WRITE,
+				&nodes[0], nodecount, 2, 2, false);
+	});
+
+	bench("MapNode::serializeBulk 4096 nodes, zlib", nodecount, [&] {
+		std::ostringstream os(std::ios_base::binary);
+		MapNode::serializeBulk(os, SER_FMT_VER_HIGHEST_WRITE,
+				&nodes[0], nodecount, 2, 2, true);
+	});
+
+	std::ostringstream os_raw(std::ios_base::binary);
+	MapNode::serializeBulk(os_raw, SER_FMT_VER_HIGHEST_WRITE,
+			&nodes[0], nodecount, 2, 2, false);
+	const std::string serialized = os_raw.str();
+	std::vector<MapNode> decoded(nodecount);
+	bench("MapNode::deSerializeBulk 4096 nodes, raw", nodecount, [&] {
+		std::istringstream is(serialized, std::ios_base::binary);
+		MapNode::deSerializeBulk(is, SER_FMT_VER_HIGHEST_WRITE,
+				&decoded[0], nodecount, 2, 2, false);
+	});
+
+	std::vector<u16> values(nodecount);
+	for (u32 i = 0; i < nodecount; i++)
+		values[i] = nodes[i].param0;
+	std::vector<u8> buf(2 * nodecount);
+	bench("writeU16Bulk 4096 values", nodecount, [&] {
+		writeU16Bulk(&buf[0], &values[0], nodecount);
+	});
+}
@@ -0,0 +1,63 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+
+#include "noise.h"
+
+class BenchNoise : public BenchBase {
+public:
+	BenchNoise() { BenchManager::registerModule(this); }
+	const char *getName() { return "BenchNoise"; }
+
+	void runBenchmarks();
+};
+
+static BenchNoise g_bench_instance;
+
+void BenchNoise::runBenchmarks()
+{
+	NoiseParams np(0, 1, v3f(64, 64, 64), 1337, 4, 0.6f, 2.0f);
+
+	// Mapgen-typical map sizes; the offset varies per call so no two
+	// calls can share intermediate results
+	{
+		Noise noise(&np, 0, 80, 80);
+		float x = 0.0f;
+		bench("Noise::perlinMap2D 80x80, 4 octaves", 80 * 80, [&] {
+			noise.perlinMap2D(x, 0.0f);
+			x += 80.0f;
+		});
+	}
+	{
+		Noise noise(&np, 0, 16, 16, 16);
+		float x = 0.0f;
+		bench("Noise::perlinMap3D 16x16x16, 4 octaves", 16 * 16 * 16, [&] {
+			noise.perlinMap3D(x, 0.0f, 0.0f);
+			x += 16.0f;
+		});
+	}
+	{
+		s32 seed = 0;
+		bench("noise3d_perlin point, 4 octaves", 1, [&] {
+			noise3d_perlin(seed * 0.1f, 0.0f, 0.0f, 1337, 4, 0.6f);
+			seed++;
+		});
+	}
+}
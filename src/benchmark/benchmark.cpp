@@ -0,0 +1,91 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include "log.h"
+#include "porting.h"
+
+// Per timed sample; several samples expose the run-to-run variance
+#define BENCH_SAMPLE_TARGET_NS (20 * 1000 * 1000ULL)
+#define BENCH_WARMUP_NS (50 * 1000 * 1000ULL)
+#define BENCH_NUM_SAMPLES 8
+
+void BenchBase::bench(const std::string &name, u64 ops_per_call,
+		const std::function<void()> &fn)
+{
+	// Warm up and estimate the duration of one call at the same time
+	u64 calls = 0;
+	u64 t0 = porting::getTimeNs();
+	u64 elapsed;
+	do {
+		fn();
+		calls++;
+		elapsed = porting::getTimeNs() - t0;
+	} while (elapsed < BENCH_WARMUP_NS);
+
+	u64 calls_per_sample = calls * BENCH_SAMPLE_TARGET_NS / elapsed;
+	if (calls_per_sample == 0)
+		calls_per_sample = 1;
+
+	double samples[BENCH_NUM_SAMPLES];
+	double mean = 0.0;
+	for (int s = 0; s < BENCH_NUM_SAMPLES; s++) {
+		t0 = porting::getTimeNs();
+		for (u64 i = 0; i < calls_per_sample; i++)
+			fn();
+		u64 dt = porting::getTimeNs() - t0;
+		samples[s] = (double)dt / ((double)calls_per_sample * ops_per_call);
+		mean += samples[s];
+	}
+	mean /= BENCH_NUM_SAMPLES;
+
+	double variance = 0.0;
+	for (double sample : samples)
+		variance += (sample - mean) * (sample - mean);
+	double stddev = std::sqrt(variance / (BENCH_NUM_SAMPLES - 1));
+
+	std::ostringstream line;
+	line << "    " << std::left << std::setw(44) << name
+		<< std::right << std::fixed << std::setprecision(1)
+		<< std::setw(12) << mean << " ns/op  +-"
+		<< std::setprecision(1) << 100.0 * stddev / mean << "%  ("
+		<< calls_per_sample * BENCH_NUM_SAMPLES << " calls)";
+	rawstream << line.str() << std::endl;
+}
+
+void run_benchmarks()
+{
+	u64 t1 = porting::getTimeMs();
+
+	rawstream << "Running benchmarks (mean of " << BENCH_NUM_SAMPLES
+		<< " samples, +- one standard deviation):" << std::endl;
+
+	std::vector<BenchBase *> &modules = BenchManager::getModules();
+	for (BenchBase *module : modules) {
+		rawstream << "======== " << module->getName() << std::endl;
+		module->runBenchmarks();
+	}
+
+	u64 tdiff = porting::getTimeMs() - t1;
+	rawstream << "Benchmarks took " << tdiff << "ms total." << std::endl;
+}
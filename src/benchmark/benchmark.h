@@ -0,0 +1,68 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+
+/*
+	Microbenchmark framework; the performance-measuring sibling of the
+	unit test framework in src/unittest. Modules register themselves with
+	BenchManager and are run via --run-benchmarks. Each measurement is
+	reported in nanoseconds per operation together with its spread over
+	the timing samples, so performance changes become reviewable numbers.
+*/
+
+class BenchBase {
+public:
+	virtual ~BenchBase() = default;
+
+	virtual void runBenchmarks() = 0;
+	virtual const char *getName() = 0;
+
+protected:
+	/*
+		Measures fn and reports it under the given name. fn is first run
+		repeatedly for a warmup period (caches, CPU clock governor), then
+		timed over several samples. ops_per_call says how many of the
+		benchmarked operations a single fn() call performs, e.g. the node
+		count when fn serializes a whole block.
+	*/
+	void bench(const std::string &name, u64 ops_per_call,
+			const std::function<void()> &fn);
+};
+
+class BenchManager {
+public:
+	static std::vector<BenchBase *> &getModules()
+	{
+		static std::vector<BenchBase *> modules;
+		return modules;
+	}
+
+	static void registerModule(BenchBase *module)
+	{
+		getModules().push_back(module);
+	}
+};
+
+void run_benchmarks();
@@ -39,16 +39,14 @@ ChatBuffer::ChatBuffer(u32 scrollback):
 
 void ChatBuffer::addLine(const std::wstring &name, const std::wstring &text)
 {
+	bool scrolled_at_bottom = (m_rows > 0) && isScrolledAtBottom();
+
 	ChatLine line(name, text);
 	m_unformatted.push_back(line);
+	m_format_cache.emplace_back();
 
-	if (m_rows > 0) {
-		// m_formatted is valid and must be kept valid
-		bool scrolled_at_bottom = (m_scroll == getBottomScrollPos());
-		u32 num_added = formatChatLine(line, m_cols, m_formatted);
-		if (scrolled_at_bottom)
-			m_scroll += num_added;
-	}
+	if (scrolled_at_bottom)
+		scrollBottom();
 
 	// Limit number of lines by m_scrollback
 	if (m_unformatted.size() > m_scrollback) {
@@ -59,8 +57,10 @@ void ChatBuffer::addLine(const std::wstring &name, const std::wstring &text)
 void ChatBuffer::clear()
 {
 	m_unformatted.clear();
-	m_formatted.clear();
-	m_scroll = 0;
+	m_format_cache.clear();
+	m_scroll_line = 0;
+	m_scroll_row = 0;
+	m_scroll_pre_rows = m_rows;
 }
 
 u32 ChatBuffer::getLineCount() const
@@ -83,36 +83,29 @@ void ChatBuffer::step(f32 dtime)
 
 void ChatBuffer::deleteOldest(u32 count)
 {
-	bool at_bottom = (m_scroll == getBottomScrollPos());
+	if (count == 0 || m_unformatted.empty())
+		return;
 
-	u32 del_unformatted = 0;
-	u32 del_formatted = 0;
+	bool at_bottom = (m_rows > 0) && isScrolledAtBottom();
 
-	while (count > 0 && del_unformatted < m_unformatted.size())
-	{
-		++del_unformatted;
+	u32 del = MYMIN(count, (u32) m_unformatted.size());
+	m_unformatted.erase(m_unformatted.begin(), m_unformatted.begin() + del);
+	m_format_cache.erase(m_format_cache.begin(), m_format_cache.begin() + del);
 
-		// keep m_formatted in sync
-		if (del_formatted < m_formatted.size())
-		{
-
-			sanity_check(m_formatted[del_formatted].first);
-			++del_formatted;
-			while (del_formatted < m_formatted.size() &&
-					!m_formatted[del_formatted].first)
-				++del_formatted;
-		}
+	if (m_rows == 0)
+		return;
 
-		--count;
+	if (m_scroll_line >= del) {
+		m_scroll_line -= del;
+	} else {
+		m_scroll_line = 0;
+		m_scroll_row = 0;
 	}
 
-	m_unformatted.erase(m_unformatted.begin(), m_unformatted.begin() + del_unformatted);
-	m_formatted.erase(m_formatted.begin(), m_formatted.begin() + del_formatted);
-
 	if (at_bottom)
-		m_scroll = getBottomScrollPos();
+		scrollBottom();
 	else
-		scrollAbsolute(m_scroll - del_formatted);
+		clampScroll();
 }
 
 void ChatBuffer::deleteByAge(f32 maxAge)
@@ -140,38 +133,21 @@ void ChatBuffer::reformat(u32 cols, u32 rows)
 		// Clear formatted buffer
 		m_cols = 0;
 		m_rows = 0;
-		m_scroll = 0;
-		m_formatted.clear();
+		m_scroll_line = 0;
+		m_scroll_row = 0;
+		m_scroll_pre_rows = 0;
 	}
 	else if (cols != m_cols || rows != m_rows)
 	{
-		// TODO: Avoid reformatting ALL lines (even invisible ones)
-		// each time the console size changes.
-
-		// Find out the scroll position in *unformatted* lines
-		u32 restore_scroll_unformatted = 0;
-		u32 restore_scroll_formatted = 0;
-		bool at_bottom = (m_scroll == getBottomScrollPos());
-		if (!at_bottom)
-		{
-			for (s32 i = 0; i < m_scroll; ++i)
-			{
-				if (m_formatted[i].first)
-					++restore_scroll_unformatted;
-			}
-		}
+		// Nothing is re-wrapped here: each cache entry remembers the
+		// width it was wrapped for, so a width change invalidates it
+		// lazily and only lines that actually become visible are
+		// formatted again. The scroll anchor is kept in unformatted
+		// lines and survives the change.
+		bool at_bottom = (m_rows == 0) || isScrolledAtBottom();
 
-		// If number of columns change, reformat everything
 		if (cols != m_cols)
-		{
-			m_formatted.clear();
-			for (u32 i = 0; i < m_unformatted.size(); ++i)
-			{
-				if (i == restore_scroll_unformatted)
-					restore_scroll_formatted = m_formatted.size();
-				formatChatLine(m_unformatted[i], cols, m_formatted);
-			}
-		}
+			m_scroll_row = 0; // row indices shift with the new width
 
 		// Update the console size
 		m_cols = cols;
@@ -179,50 +155,141 @@ void ChatBuffer::reformat(u32 cols, u32 rows)
 
 		// Restore the scroll position
 		if (at_bottom)
-		{
 			scrollBottom();
-		}
 		else
-		{
-			scrollAbsolute(restore_scroll_formatted);
-		}
+			clampScroll();
 	}
 }
 
+const std::vector<ChatFormattedLine>& ChatBuffer::getFormattedLines(u32 i) const
+{
+	FormattedLineCache &cache = m_format_cache[i];
+	if (cache.cols != m_cols) {
+		cache.lines.clear();
+		formatChatLine(m_unformatted[i], m_cols, cache.lines);
+		cache.cols = m_cols;
+	}
+	return cache.lines;
+}
+
 const ChatFormattedLine& ChatBuffer::getFormattedLine(u32 row) const
 {
-	s32 index = m_scroll + (s32) row;
-	if (index >= 0 && index < (s32) m_formatted.size())
-		return m_formatted[index];
+	if (m_rows == 0 || row >= m_rows || row < m_scroll_pre_rows)
+		return m_empty_formatted_line;
+
+	u32 target = row - m_scroll_pre_rows + m_scroll_row;
+	for (u32 i = m_scroll_line; i < m_unformatted.size(); ++i) {
+		const std::vector<ChatFormattedLine> &lines = getFormattedLines(i);
+		if (target < lines.size())
+			return lines[target];
+		target -= lines.size();
+	}
 
 	return m_empty_formatted_line;
 }
 
-void ChatBuffer::scroll(s32 rows)
+u32 ChatBuffer::countRowsFromScroll(u32 limit) const
+{
+	u32 count = 0;
+	for (u32 i = m_scroll_line; i < m_unformatted.size(); ++i) {
+		count += getFormattedLines(i).size();
+		if (count >= limit + m_scroll_row)
+			break;
+	}
+	return count >= m_scroll_row ? count - m_scroll_row : 0;
+}
+
+bool ChatBuffer::isScrolledAtBottom() const
 {
-	scrollAbsolute(m_scroll + rows);
+	return m_scroll_pre_rows + countRowsFromScroll(m_rows + 1) <= m_rows;
 }
 
-void ChatBuffer::scrollAbsolute(s32 scroll)
+void ChatBuffer::clampScroll()
 {
-	s32 top = getTopScrollPos();
-	s32 bottom = getBottomScrollPos();
+	if (m_rows == 0)
+		return;
 
-	m_scroll = scroll;
-	if (m_scroll < top)
-		m_scroll = top;
-	if (m_scroll > bottom)
-		m_scroll = bottom;
+	if (m_scroll_line >= m_unformatted.size()) {
+		scrollBottom();
+		return;
+	}
+	// A width change can reduce a line's row count
+	if (m_scroll_row >= getFormattedLines(m_scroll_line).size())
+		m_scroll_row = 0;
+
+	// Never leave blank rows below the newest line
+	m_scroll_pre_rows = 0;
+	if (countRowsFromScroll(m_rows) < m_rows)
+		scrollBottom();
+}
+
+void ChatBuffer::scroll(s32 rows)
+{
+	if (m_rows == 0 || m_unformatted.empty())
+		return;
+
+	if (rows > 0) {
+		// Towards newer lines; stop once the newest row is visible
+		while (rows-- > 0 && !isScrolledAtBottom()) {
+			if (m_scroll_row + 1 < getFormattedLines(m_scroll_line).size()) {
+				++m_scroll_row;
+			} else if (m_scroll_line + 1 < m_unformatted.size()) {
+				++m_scroll_line;
+				m_scroll_row = 0;
+			} else {
+				break;
+			}
+		}
+	} else {
+		// Towards older lines
+		while (rows++ < 0 && m_scroll_pre_rows == 0) {
+			if (m_scroll_row > 0) {
+				--m_scroll_row;
+			} else if (m_scroll_line > 0) {
+				--m_scroll_line;
+				m_scroll_row = getFormattedLines(m_scroll_line).size() - 1;
+			} else {
+				break;
+			}
+		}
+	}
 }
 
 void ChatBuffer::scrollBottom()
 {
-	m_scroll = getBottomScrollPos();
+	if (m_rows == 0)
+		return;
+
+	// Walk backwards from the newest line until the window is full
+	u32 rows_needed = m_rows;
+	u32 i = m_unformatted.size();
+	while (i > 0) {
+		u32 n = getFormattedLines(i - 1).size();
+		if (n >= rows_needed) {
+			m_scroll_line = i - 1;
+			m_scroll_row = n - rows_needed;
+			m_scroll_pre_rows = 0;
+			return;
+		}
+		rows_needed -= n;
+		--i;
+	}
+
+	// The whole buffer fits into the window; bottom-align it
+	m_scroll_line = 0;
+	m_scroll_row = 0;
+	m_scroll_pre_rows = rows_needed;
 }
 
 void ChatBuffer::scrollTop()
 {
-	m_scroll = getTopScrollPos();
+	if (m_rows == 0)
+		return;
+
+	m_scroll_line = 0;
+	m_scroll_row = 0;
+	m_scroll_pre_rows = 0;
+	clampScroll();
 }
 
 u32 ChatBuffer::formatChatLine(const ChatLine& line, u32 cols,
@@ -347,29 +414,6 @@ u32 ChatBuffer::formatChatLine(const ChatLine& line, u32 cols,
 	return num_added;
 }
 
-s32 ChatBuffer::getTopScrollPos() const
-{
-	s32 formatted_count = (s32) m_formatted.size();
-	s32 rows = (s32) m_rows;
-	if (rows == 0)
-		return 0;
-
-	if (formatted_count <= rows)
-		return formatted_count - rows;
-
-	return 0;
-}
-
-s32 ChatBuffer::getBottomScrollPos() const
-{
-	s32 formatted_count = (s32) m_formatted.size();
-	s32 rows = (s32) m_rows;
-	if (rows == 0)
-		return 0;
-
-	return formatted_count - rows;
-}
-
 void ChatBuffer::resize(u32 scrollback)
 {
 	m_scrollback = scrollback;
@@ -98,7 +98,8 @@ public:
 	u32 getColumns() const;
 	// Get number of rows, 0 if reformat has not been called yet.
 	u32 getRows() const;
-	// Update console size and reformat all formatted lines.
+	// Update console size. Lines are re-wrapped lazily as they become
+	// visible, so this is cheap even with a huge scrollback.
 	void reformat(u32 cols, u32 rows);
 	// Get formatted line for a given row (0 is top of screen).
 	// Only valid after reformat has been called at least once
@@ -106,8 +107,6 @@ public:
 	// Scrolling in formatted buffer (relative)
 	// positive rows == scroll up, negative rows == scroll down
 	void scroll(s32 rows);
-	// Scrolling in formatted buffer (absolute)
-	void scrollAbsolute(s32 scroll);
 	// Scroll to bottom of buffer (newest)
 	void scrollBottom();
 	// Scroll to top of buffer (oldest)
@@ -121,8 +120,16 @@ public:
 
 	void resize(u32 scrollback);
 protected:
-	s32 getTopScrollPos() const;
-	s32 getBottomScrollPos() const;
+	// Lazily wrap line i for the current number of columns and return
+	// the cached result
+	const std::vector<ChatFormattedLine> &getFormattedLines(u32 i) const;
+	// Count formatted rows from the scroll anchor to the newest line,
+	// formatting at most enough lines to reach the given cap
+	u32 countRowsFromScroll(u32 limit) const;
+	// true if the newest formatted row is inside the console window
+	bool isScrolledAtBottom() const;
+	// Keep the scroll anchor inside the valid scrolling range
+	void clampScroll();
 
 private:
 	// Scrollback size
@@ -130,14 +137,28 @@ private:
 	// Array of unformatted chat lines
 	std::vector<ChatLine> m_unformatted;
 
+	// Cached wrapped lines, kept parallel to m_unformatted. Entries are
+	// filled by getFormattedLines() when a line becomes visible; a width
+	// change invalidates them lazily via the stored column count.
+	struct FormattedLineCache
+	{
+		// Number of columns the lines were wrapped for (0 = not wrapped)
+		u32 cols = 0;
+		std::vector<ChatFormattedLine> lines;
+	};
+	mutable std::vector<FormattedLineCache> m_format_cache;
+
 	// Number of character columns in console
 	u32 m_cols = 0;
 	// Number of character rows in console
 	u32 m_rows = 0;
-	// Scroll position (console's top line index into m_formatted)
-	s32 m_scroll = 0;
-	// Array of formatted lines
-	std::vector<ChatFormattedLine> m_formatted;
+	// Scroll anchor: unformatted line at the top of the console window,
+	// and the wrapped row within that line
+	u32 m_scroll_line = 0;
+	u32 m_scroll_row = 0;
+	// Blank rows shown above the oldest line when the whole buffer is
+	// shorter than the window (the text is bottom-aligned)
+	u32 m_scroll_pre_rows = 0;
 	// Empty formatted line, for error returns
 	ChatFormattedLine m_empty_formatted_line;
 };
@@ -18,12 +18,67 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include <log.h>
+#include "mapblock.h"
 #include "profiler.h"
 #include "activeobjectmgr.h"
 
 namespace client
 {
 
+// Objects within this distance are stepped every frame, objects beyond
+// it every second frame, objects beyond the far limit every fourth
+static constexpr f32 CAO_STEP_NEAR_DISTANCE = 32.0f * BS;
+static constexpr f32 CAO_STEP_FAR_DISTANCE = 96.0f * BS;
+// Upper bound for the time handed to a throttled object at once
+static constexpr float CAO_STEP_DTIME_MAX = 0.5f;
+
+v3s16 ActiveObjectMgr::getCell(const v3f &pos)
+{
+	return getNodeBlockPos(floatToInt(pos, BS));
+}
+
+void ActiveObjectMgr::insertToCell(u16 id, v3s16 cell)
+{
+	m_grid[cell].push_back(id);
+	m_object_cell[id] = cell;
+}
+
+void ActiveObjectMgr::removeFromCell(u16 id)
+{
+	auto cell_it = m_object_cell.find(id);
+	if (cell_it == m_object_cell.end())
+		return;
+
+	auto grid_it = m_grid.find(cell_it->second);
+	if (grid_it != m_grid.end()) {
+		std::vector<u16> &ids = grid_it->second;
+		for (size_t i = 0; i < ids.size(); i++) {
+			if (ids[i] == id) {
+				ids[i] = ids.back();
+				ids.pop_back();
+				break;
+			}
+		}
+		if (ids.empty())
+			m_grid.erase(grid_it);
+	}
+	m_object_cell.erase(cell_it);
+}
+
+void ActiveObjectMgr::updateObjectPos(u16 id, const v3f &pos)
+{
+	auto cell_it = m_object_cell.find(id);
+	if (cell_it == m_object_cell.end())
+		return;
+
+	v3s16 cell = getCell(pos);
+	if (cell_it->second == cell)
+		return;
+
+	removeFromCell(id);
+	insertToCell(id, cell);
+}
+
 void ActiveObjectMgr::clear()
 {
 	// delete active objects
@@ -33,6 +88,9 @@ void ActiveObjectMgr::clear()
 		active_object.second = nullptr;
 	}
 	m_active_objects.clear();
+	m_grid.clear();
+	m_object_cell.clear();
+	m_skipped_dtime.clear();
 }
 
 void ActiveObjectMgr::step(
@@ -41,9 +99,57 @@ void ActiveObjectMgr::step(
 	g_profiler->avg("ActiveObjectMgr: CAO count [#]", m_active_objects.size());
 	for (auto &ao_it : m_active_objects) {
 		f(ao_it.second);
+		updateObjectPos(ao_it.first, ao_it.second->getPosition());
 	}
 }
 
+void ActiveObjectMgr::step(float dtime, const v3f &origin,
+		const std::function<void(ClientActiveObject *, float)> &f)
+{
+	g_profiler->avg("ActiveObjectMgr: CAO count [#]", m_active_objects.size());
+	m_step_counter++;
+
+	for (auto &ao_it : m_active_objects) {
+		u16 id = ao_it.first;
+		ClientActiveObject *obj = ao_it.second;
+
+		// The local player and attached objects must track their anchor
+		// every frame; everything else is throttled by distance
+		u32 interval = 1;
+		if (!obj->isLocalPlayer() && !obj->getParent()) {
+			f32 d2 = (obj->getPosition() - origin).getLengthSQ();
+			if (d2 > CAO_STEP_FAR_DISTANCE * CAO_STEP_FAR_DISTANCE)
+				interval = 4;
+			else if (d2 > CAO_STEP_NEAR_DISTANCE * CAO_STEP_NEAR_DISTANCE)
+				interval = 2;
+		}
+
+		// Stagger by id so the throttled objects do not all step in the
+		// same frame
+		if (interval > 1 && (m_step_counter + id) % interval != 0) {
+			m_skipped_dtime[id] += dtime;
+			continue;
+		}
+
+		float obj_dtime = dtime;
+		auto skipped_it = m_skipped_dtime.find(id);
+		if (skipped_it != m_skipped_dtime.end()) {
+			obj_dtime = MYMIN(obj_dtime + skipped_it->second,
+					CAO_STEP_DTIME_MAX);
+			m_skipped_dtime.erase(skipped_it);
+		}
+
+		f(obj, obj_dtime);
+		updateObjectPos(id, obj->getPosition());
+	}
+}
+
+void ActiveObjectMgr::updateFrame(float dtime)
+{
+	for (auto &ao_it : m_active_objects)
+		ao_it.second->updateFrame(dtime);
+}
+
 // clang-format off
 bool ActiveObjectMgr::registerObject(ClientActiveObject *obj)
 {
@@ -69,6 +175,7 @@ bool ActiveObjectMgr::registerObject(ClientActiveObject *obj)
 	infostream << "Client::ActiveObjectMgr::registerObject(): "
 			<< "added (id=" << obj->getId() << ")" << std::endl;
 	m_active_objects[obj->getId()] = obj;
+	insertToCell(obj->getId(), getCell(obj->getPosition()));
 	return true;
 }
 
@@ -83,6 +190,8 @@ void ActiveObjectMgr::removeObject(u16 id)
 		return;
 	}
 
+	removeFromCell(id);
+	m_skipped_dtime.erase(id);
 	m_active_objects.erase(id);
 
 	obj->removeFromScene(true);
@@ -94,15 +203,48 @@ void ActiveObjectMgr::getActiveObjects(const v3f &origin, f32 max_d,
 		std::vector<DistanceSortedActiveObject> &dest)
 {
 	f32 max_d2 = max_d * max_d;
-	for (auto &ao_it : m_active_objects) {
-		ClientActiveObject *obj = ao_it.second;
 
-		f32 d2 = (obj->getPosition() - origin).getLengthSQ();
+	v3s16 min_cell = getCell(origin - v3f(max_d, max_d, max_d));
+	v3s16 max_cell = getCell(origin + v3f(max_d, max_d, max_d));
+	u64 num_cells = (u64)(max_cell.X - min_cell.X + 1) *
+			(max_cell.Y - min_cell.Y + 1) * (max_cell.Z - min_cell.Z + 1);
+
+	// For very large radii walking the cells would be slower than the
+	// plain scan over all objects
+	if (num_cells >= m_active_objects.size()) {
+		for (auto &ao_it : m_active_objects) {
+			ClientActiveObject *obj = ao_it.second;
+
+			f32 d2 = (obj->getPosition() - origin).getLengthSQ();
 
-		if (d2 > max_d2)
+			if (d2 > max_d2)
+				continue;
+
+			dest.emplace_back(obj, d2);
+		}
+		return;
+	}
+
+	v3s16 cell;
+	for (cell.X = min_cell.X; cell.X <= max_cell.X; cell.X++)
+	for (cell.Y = min_cell.Y; cell.Y <= max_cell.Y; cell.Y++)
+	for (cell.Z = min_cell.Z; cell.Z <= max_cell.Z; cell.Z++) {
+		auto it = m_grid.find(cell);
+		if (it == m_grid.end())
 			continue;
 
-		dest.emplace_back(obj, d2);
+		for (u16 id : it->second) {
+			ClientActiveObject *obj = getActiveObject(id);
+			if (!obj)
+				continue;
+
+			f32 d2 = (obj->getPosition() - origin).getLengthSQ();
+
+			if (d2 > max_d2)
+				continue;
+
+			dest.emplace_back(obj, d2);
+		}
 	}
 }
 
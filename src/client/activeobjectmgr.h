@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <vector>
 #include "../activeobjectmgr.h"
 #include "clientobject.h"
+#include "util/numeric.h"
 
 namespace client
 {
@@ -32,10 +33,32 @@ public:
 	void clear();
 	void step(float dtime,
 			const std::function<void(ClientActiveObject *)> &f) override;
+	// Steps objects at a rate tiered by their distance from origin,
+	// passing each one the time accumulated since its last step
+	void step(float dtime, const v3f &origin,
+			const std::function<void(ClientActiveObject *, float)> &f);
+	// Advances render-side interpolation of every object; called once
+	// per rendered frame regardless of the simulation step rate
+	void updateFrame(float dtime);
 	bool registerObject(ClientActiveObject *obj) override;
 	void removeObject(u16 id) override;
 
 	void getActiveObjects(const v3f &origin, f32 max_d,
 			std::vector<DistanceSortedActiveObject> &dest);
+
+private:
+	static v3s16 getCell(const v3f &pos);
+	void insertToCell(u16 id, v3s16 cell);
+	void removeFromCell(u16 id);
+	void updateObjectPos(u16 id, const v3f &pos);
+
+	// Mapblock-granular spatial grid of object ids, so radius queries
+	// only touch nearby cells instead of every active object
+	std::unordered_map<v3s16, std::vector<u16>, v3s16Hash> m_grid;
+	// Cell each object is currently filed under
+	std::unordered_map<u16, v3s16> m_object_cell;
+	// Time accumulated by objects whose step was skipped this frame
+	std::unordered_map<u16, float> m_skipped_dtime;
+	u32 m_step_counter = 0;
 };
 } // namespace client
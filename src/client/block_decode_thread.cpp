@@ -0,0 +1,104 @@
+/*
+Minetest
+Copyright (C) 2013, 2017 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "block_decode_thread.h"
+#include <sstream>
+#include "client.h"
+#include "exceptions.h"
+#include "mapblock.h"
+#include "profiler.h"
+#include "settings.h"
+#include "threading/thread_pool.h"
+#include "util/numeric.h"
+
+BlockDecodeThread::BlockDecodeThread(Client *client):
+	m_client(client)
+{
+	int thread_count = g_settings->getU16("block_decode_threads");
+	thread_count = rangelim(thread_count, 1, 8);
+	m_pool_group = g_thread_pool->registerGroup("block_decode", thread_count);
+}
+
+BlockDecodeThread::~BlockDecodeThread()
+{
+	stop();
+}
+
+void BlockDecodeThread::stop()
+{
+	g_thread_pool->drainGroup(m_pool_group);
+	// drainGroup() discarded the tasks of the payloads still queued
+	while (!m_queue_in.empty())
+		m_queue_in.pop_frontNoEx(0);
+}
+
+void BlockDecodeThread::enqueueBlock(v3s16 p, std::string &&payload, u8 ser_version,
+		u32 seq)
+{
+	QueuedBlockDecode q;
+	q.p = p;
+	q.ser_version = ser_version;
+	q.seq = seq;
+	q.payload = std::move(payload);
+
+	m_queue_in.push_back(q);
+	g_thread_pool->submit(m_pool_group, TASK_PRIORITY_NORMAL,
+			[this] { decodeQueued(); });
+}
+
+void BlockDecodeThread::decodeQueued()
+{
+	QueuedBlockDecode q = m_queue_in.pop_frontNoEx(0);
+	// Real payloads are never empty, so this is the queue-empty marker
+	if (q.payload.empty())
+		return;
+
+	ScopeProfiler sp(g_profiler, "Client: Block decoding (sum)");
+
+	// The block stays detached from the map until the Client thread
+	// merges it, so the parent pointer is only carried along.
+	MapBlock *block = new MapBlock(
+			&m_client->getEnv().getMap(), q.p, m_client);
+
+	std::istringstream istr(q.payload, std::ios_base::binary);
+	try {
+		block->deSerialize(istr, q.ser_version, false);
+		block->deSerializeNetworkSpecific(istr);
+	} catch (SerializationError &e) {
+		warningstream << "BlockDecodeThread: Ignoring broken block payload at ("
+				<< q.p.X << "," << q.p.Y << "," << q.p.Z << "): "
+				<< e.what() << std::endl;
+		delete block;
+		block = nullptr;
+	} catch (VersionMismatchException &e) {
+		warningstream << "BlockDecodeThread: Ignoring block payload at ("
+				<< q.p.X << "," << q.p.Y << "," << q.p.Z << "): "
+				<< e.what() << std::endl;
+		delete block;
+		block = nullptr;
+	}
+
+	// A result is pushed even on failure (block == nullptr), so the
+	// enqueuer's outstanding-payload bookkeeping stays balanced
+	BlockDecodeResult r;
+	r.p = q.p;
+	r.seq = q.seq;
+	r.block = block;
+	m_queue_out.push_back(r);
+}
@@ -0,0 +1,79 @@
+/*
+Minetest
+Copyright (C) 2013, 2017 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <string>
+#include "irr_v3d.h"
+#include "util/container.h"
+
+class Client;
+class MapBlock;
+
+struct QueuedBlockDecode
+{
+	v3s16 p = v3s16(-1337, -1337, -1337);
+	u8 ser_version = 0;
+	// Sequence number assigned by the enqueuer; lets it recognize
+	// results that a later payload for the same block has superseded
+	u32 seq = 0;
+	// Raw over-the-network block payload as received
+	std::string payload;
+};
+
+struct BlockDecodeResult
+{
+	v3s16 p = v3s16(-1338, -1338, -1338);
+	u32 seq = 0;
+	// Deserialized block, detached from the map. The receiver merges it
+	// into ClientMap (or deletes it).
+	MapBlock *block = nullptr;
+};
+
+/*
+	Deserializes and decompresses received block payloads off the Client
+	thread, so bulk block streams do not stall input and prediction
+	processing. Decoding runs as tasks on the shared engine thread pool,
+	with concurrency capped by the block_decode_threads setting. Decoded
+	blocks come out of m_queue_out and are merged into the map by
+	Client::step().
+*/
+class BlockDecodeThread
+{
+public:
+	BlockDecodeThread(Client *client);
+	~BlockDecodeThread();
+
+	// Queues a raw network block payload for decoding
+	void enqueueBlock(v3s16 p, std::string &&payload, u8 ser_version, u32 seq);
+
+	// Discards payloads not yet being decoded and waits for the in-flight
+	// decode tasks to finish
+	void stop();
+
+	MutexedQueue<BlockDecodeResult> m_queue_out;
+
+private:
+	// Pops and decodes one queued payload; runs as a pool task
+	void decodeQueued();
+
+	Client *m_client;
+	u32 m_pool_group;
+	MutexedQueue<QueuedBlockDecode> m_queue_in;
+};
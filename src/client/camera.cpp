@@ -616,6 +616,13 @@ void Camera::drawWieldedTool(irr::core::matrix4* translation)
 	m_wieldmgr->drawAll();
 }
 
+void Nametag::setText(const std::string &text)
+{
+	nametag_text = text;
+	text_translated = translate_string(utf8_to_wide(text));
+	text_colorless = unescape_enriched(text_translated);
+}
+
 void Camera::drawNametags()
 {
 	core::matrix4 trans = m_cameranode->getProjectionMatrix();
@@ -635,11 +642,9 @@ void Camera::drawNametags()
 		f32 transformed_pos[4] = { pos.X, pos.Y, pos.Z, 1.0f };
 		trans.multiplyWith1x4Matrix(transformed_pos);
 		if (transformed_pos[3] > 0) {
-			std::wstring nametag_colorless =
-				unescape_translate(utf8_to_wide(nametag->nametag_text));
 			core::dimension2d<u32> textsize =
 				g_fontengine->getFont()->getDimension(
-				nametag_colorless.c_str());
+				nametag->text_colorless.c_str());
 			f32 zDiv = transformed_pos[3] == 0.0f ? 1.0f :
 				core::reciprocal(transformed_pos[3]);
 			v2u32 screensize = RenderingEngine::get_video_driver()->getScreenSize();
@@ -650,7 +655,7 @@ void Camera::drawNametags()
 				(0.5 - transformed_pos[1] * zDiv * 0.5) - textsize.Height / 2;
 			core::rect<s32> size(0, 0, textsize.Width, textsize.Height);
 			g_fontengine->getFont()->draw(
-				translate_string(utf8_to_wide(nametag->nametag_text)).c_str(),
+				nametag->text_translated.c_str(),
 				size + screen_pos, nametag->nametag_color);
 		}
 	}
@@ -37,13 +37,19 @@ struct Nametag {
 			const video::SColor &a_nametag_color,
 			const v3f &a_nametag_pos):
 		parent_node(a_parent_node),
-		nametag_text(a_nametag_text),
 		nametag_color(a_nametag_color),
 		nametag_pos(a_nametag_pos)
 	{
+		setText(a_nametag_text);
 	}
+	// The text is drawn every frame but set only when the object
+	// properties change, so the converted wide forms are kept here
+	// instead of being rebuilt in the draw loop
+	void setText(const std::string &text);
 	scene::ISceneNode *parent_node;
 	std::string nametag_text;
+	std::wstring text_translated;
+	std::wstring text_colorless;
 	video::SColor nametag_color;
 	v3f nametag_pos;
 };
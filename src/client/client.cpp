@@ -36,6 +36,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/directiontables.h"
 #include "util/pointedthing.h"
 #include "util/serialize.h"
+#include "util/sha2.h"
 #include "util/string.h"
 #include "util/srp.h"
 #include "filesys.h"
@@ -85,6 +86,7 @@ Client::Client(
 	m_sound(sound),
 	m_event(event),
 	m_mesh_update_thread(this),
+	m_block_decode_thread(this),
 	m_env(
 		new ClientMap(this, control, 666),
 		tsrc, this
@@ -241,6 +243,7 @@ void Client::Stop()
 		m_script->on_shutdown();
 	//request all client managed threads to stop
 	m_mesh_update_thread.stop();
+	m_block_decode_thread.stop();
 	// Save local server map
 	if (m_localdb) {
 		infostream << "Local map saving ended." << std::endl;
@@ -267,7 +270,13 @@ Client::~Client()
 	m_mesh_update_thread.wait();
 	while (!m_mesh_update_thread.m_queue_out.empty()) {
 		MeshUpdateResult r = m_mesh_update_thread.m_queue_out.pop_frontNoEx();
-		delete r.mesh;
+		delete r.minimap;
+	}
+
+	m_block_decode_thread.stop();
+	while (!m_block_decode_thread.m_queue_out.empty()) {
+		BlockDecodeResult r = m_block_decode_thread.m_queue_out.pop_frontNoEx();
+		delete r.block;
 	}
 
 
@@ -467,6 +476,39 @@ void Client::step(float dtime)
 		}
 	}
 
+	/*
+		Merge blocks decoded by the worker pool into the map and queue
+		their mesh updates
+	*/
+	while (!m_block_decode_thread.m_queue_out.empty()) {
+		BlockDecodeResult r = m_block_decode_thread.m_queue_out.pop_frontNoEx();
+
+		auto pending_it = m_pending_block_decodes.find(r.p);
+		if (pending_it == m_pending_block_decodes.end()) {
+			// Shouldn't happen; every enqueue records an entry
+			delete r.block;
+			continue;
+		}
+		PendingBlockDecode &pending = pending_it->second;
+		pending.outstanding--;
+
+		if (r.block) {
+			if (r.seq == pending.latest_seq)
+				updateReceivedBlock(r.p, r.block);
+			else
+				// Superseded by a newer payload for the same block
+				delete r.block;
+		}
+
+		if (pending.outstanding == 0) {
+			std::vector<std::pair<u16, MapNode>> deltas =
+					std::move(pending.deltas);
+			m_pending_block_decodes.erase(pending_it);
+			if (!deltas.empty())
+				applyBlockDelta(r.p, deltas);
+		}
+	}
+
 	/*
 		Replace updated meshes
 	*/
@@ -483,12 +525,14 @@ void Client::step(float dtime)
 			MeshUpdateResult r = m_mesh_update_thread.m_queue_out.pop_frontNoEx();
 			MapBlock *block = m_env.getMap().getBlockNoCreateNoEx(r.p);
 			if (block) {
-				// Delete the old mesh
-				delete block->mesh;
+				// Drop the old mesh
 				block->mesh = nullptr;
 
 				if (r.mesh) {
-					minimap_mapblock = r.mesh->moveMinimapMapblock();
+					// A deduplicated mesh carries this block's minimap
+					// data in the result instead
+					minimap_mapblock = r.minimap ? r.minimap
+							: r.mesh->moveMinimapMapblock();
 					if (minimap_mapblock == NULL)
 						do_mapper_update = false;
 
@@ -497,14 +541,12 @@ void Client::step(float dtime)
 						if (r.mesh->getMesh(l)->getMeshBufferCount() != 0)
 							is_empty = false;
 
-					if (is_empty)
-						delete r.mesh;
-					else
+					if (!is_empty)
 						// Replace with the new mesh
 						block->mesh = r.mesh;
 				}
 			} else {
-				delete r.mesh;
+				delete r.minimap;
 			}
 
 			if (m_minimap && do_mapper_update)
@@ -524,8 +566,10 @@ void Client::step(float dtime)
 				sendGotBlocks(blocks_to_ack);
 		}
 
-		if (num_processed_meshes > 0)
+		if (num_processed_meshes > 0) {
 			g_profiler->graphAdd("num_processed_meshes", num_processed_meshes);
+			m_env.getClientMap().reportMeshChange();
+		}
 	}
 
 	/*
@@ -955,6 +999,8 @@ void Client::deleteAuthData()
 			srp_user_delete((SRPUser *) m_auth_data);
 			m_auth_data = NULL;
 			break;
+		case AUTH_MECHANISM_SESSION_KEY:
+			break; // no auth data allocated
 		case AUTH_MECHANISM_NONE:
 			break;
 	}
@@ -962,8 +1008,51 @@ void Client::deleteAuthData()
 }
 
 
+/*
+	Session keys from successful logins, so a reconnect to the same server
+	can use the single round trip reauth path. Keyed by server address and
+	player name; lives for the whole process, since the Client object is
+	recreated on every connect.
+*/
+static std::unordered_map<std::string, std::string> g_session_key_cache;
+
+// Cache key identifying the current server and player
+static std::string session_key_cache_id(const Address &address,
+	const std::string &playername)
+{
+	return address.serializeString() + ":" + itos(address.getPort())
+		+ "/" + playername;
+}
+
+std::string Client::getCachedSessionKey()
+{
+	std::unordered_map<std::string, std::string>::const_iterator it =
+		g_session_key_cache.find(
+			session_key_cache_id(getServerAddress(), getPlayerName()));
+	if (it == g_session_key_cache.end())
+		return "";
+	return it->second;
+}
+
+void Client::cacheSessionKey(const std::string &key)
+{
+	g_session_key_cache[session_key_cache_id(getServerAddress(),
+		getPlayerName())] = key;
+}
+
+void Client::dropCachedSessionKey()
+{
+	g_session_key_cache.erase(
+		session_key_cache_id(getServerAddress(), getPlayerName()));
+}
+
 AuthMechanism Client::choseAuthMech(const u32 mechs)
 {
+	// Cheapest of all, but only offered and usable when both sides
+	// still remember the session key of a recent login
+	if ((mechs & AUTH_MECHANISM_SESSION_KEY) && !getCachedSessionKey().empty())
+		return AUTH_MECHANISM_SESSION_KEY;
+
 	if (mechs & AUTH_MECHANISM_SRP)
 		return AUTH_MECHANISM_SRP;
 
@@ -1046,6 +1135,19 @@ void Client::startAuth(AuthMechanism chosen_auth_mechanism)
 			Send(&resp_pkt);
 			break;
 		}
+		case AUTH_MECHANISM_SESSION_KEY: {
+			// Prove that we still know the session key of a recent
+			// login by hashing it together with the server's challenge
+			std::string proof_input = getCachedSessionKey() + m_reauth_challenge;
+			unsigned char digest[SHA256_DIGEST_LENGTH];
+			SHA256((const unsigned char *) proof_input.c_str(),
+				proof_input.size(), digest);
+
+			NetworkPacket resp_pkt(TOSERVER_SESSION_REAUTH, 0);
+			resp_pkt << std::string((char *) digest, SHA256_DIGEST_LENGTH);
+			Send(&resp_pkt);
+			break;
+		}
 		case AUTH_MECHANISM_NONE:
 			break; // not handled in this method
 	}
@@ -1642,6 +1744,34 @@ void texture_update_progress(void *args, u32 progress, u32 max_progress)
 		}
 }
 
+void Client::afterDefinitionsReceived()
+{
+	if (m_definitions_prepared)
+		return;
+
+	assert(m_itemdef_received); // pre-condition
+	assert(m_nodedef_received); // pre-condition
+	m_definitions_prepared = true;
+
+	infostream<<"Client::afterDefinitionsReceived() started"<<std::endl;
+
+	// These stages depend only on the item and node definitions, not on
+	// media, so they run as soon as both definition packets are in --
+	// usually while the media download is still going.
+
+	// Rebuild shaders
+	infostream<<"- Rebuilding shaders"<<std::endl;
+	m_shsrc->rebuildShaders();
+
+	// Update node aliases
+	infostream<<"- Updating node aliases"<<std::endl;
+	m_nodedef->updateAliases(m_itemdef);
+	for (const auto &path : getTextureDirs())
+		m_nodedef->applyTextureOverrides(path + DIR_DELIM + "override.txt");
+	m_nodedef->setNodeRegistrationStatus(true);
+	m_nodedef->runNodeResolveCallbacks();
+}
+
 void Client::afterContentReceived()
 {
 	infostream<<"Client::afterContentReceived() started"<<std::endl;
@@ -1649,6 +1779,9 @@ void Client::afterContentReceived()
 	assert(m_nodedef_received); // pre-condition
 	assert(mediaReceived()); // pre-condition
 
+	// Normally already done while the media was downloading
+	afterDefinitionsReceived();
+
 	const wchar_t* text = wgettext("Loading textures...");
 
 	// Clear cached pre-scaled 2D GUI images, as this cache
@@ -1662,24 +1795,6 @@ void Client::afterContentReceived()
 	m_tsrc->rebuildImagesAndTextures();
 	delete[] text;
 
-	// Rebuild shaders
-	infostream<<"- Rebuilding shaders"<<std::endl;
-	text = wgettext("Rebuilding shaders...");
-	RenderingEngine::draw_load_screen(text, guienv, m_tsrc, 0, 71);
-	m_shsrc->rebuildShaders();
-	delete[] text;
-
-	// Update node aliases
-	infostream<<"- Updating node aliases"<<std::endl;
-	text = wgettext("Initializing nodes...");
-	RenderingEngine::draw_load_screen(text, guienv, m_tsrc, 0, 72);
-	m_nodedef->updateAliases(m_itemdef);
-	for (const auto &path : getTextureDirs())
-		m_nodedef->applyTextureOverrides(path + DIR_DELIM + "override.txt");
-	m_nodedef->setNodeRegistrationStatus(true);
-	m_nodedef->runNodeResolveCallbacks();
-	delete[] text;
-
 	// Update node textures and assign shaders to each tile
 	infostream<<"- Updating node textures"<<std::endl;
 	TextureUpdateArgs tu_args;
@@ -25,8 +25,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <map>
 #include <set>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include "clientobject.h"
+#include "util/numeric.h"
 #include "gamedef.h"
 #include "inventorymanager.h"
 #include "localplayer.h"
@@ -35,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapnode.h"
 #include "tileanimation.h"
 #include "mesh_generator_thread.h"
+#include "block_decode_thread.h"
 #include "network/address.h"
 #include "network/peerhandler.h"
 #include <fstream>
@@ -187,6 +190,8 @@ public:
 	void handleCommand_AddNode(NetworkPacket* pkt);
 	void handleCommand_NodemetaChanged(NetworkPacket *pkt);
 	void handleCommand_BlockData(NetworkPacket* pkt);
+	void handleCommand_BlockDatas(NetworkPacket* pkt);
+	void handleCommand_BlockDelta(NetworkPacket* pkt);
 	void handleCommand_Inventory(NetworkPacket* pkt);
 	void handleCommand_TimeOfDay(NetworkPacket* pkt);
 	void handleCommand_ChatMessage(NetworkPacket *pkt);
@@ -224,6 +229,7 @@ public:
 	void handleCommand_EyeOffset(NetworkPacket* pkt);
 	void handleCommand_UpdatePlayerList(NetworkPacket* pkt);
 	void handleCommand_ModChannelMsg(NetworkPacket *pkt);
+	void handleCommand_ModChannelMsgs(NetworkPacket *pkt);
 	void handleCommand_ModChannelSignal(NetworkPacket *pkt);
 	void handleCommand_SrpBytesSandB(NetworkPacket *pkt);
 	void handleCommand_FormspecPrepend(NetworkPacket *pkt);
@@ -313,9 +319,6 @@ public:
 	void addUpdateMeshTaskWithEdge(v3s16 blockpos, bool ack_to_server=false, bool urgent=false);
 	void addUpdateMeshTaskForNode(v3s16 nodepos, bool ack_to_server=false, bool urgent=false);
 
-	void updateCameraOffset(v3s16 camera_offset)
-	{ m_mesh_update_thread.m_camera_offset = camera_offset; }
-
 	bool hasClientEvents() const { return !m_client_event_queue.empty(); }
 	// Get event from queue. If queue is empty, it triggers an assertion failure.
 	ClientEvent * getClientEvent();
@@ -353,6 +356,7 @@ public:
 
 	float mediaReceiveProgress();
 
+	void afterDefinitionsReceived();
 	void afterContentReceived();
 
 	float getRTT();
@@ -371,6 +375,10 @@ public:
 	ICraftDefManager* getCraftDefManager() override;
 	ITextureSource* getTextureSource();
 	virtual IShaderSource* getShaderSource();
+	// For code that must service the queued texture/shader requests of
+	// worker threads (see NodeDefManager::updateTextures())
+	IWritableTextureSource* getWritableTextureSource() { return m_tsrc; }
+	IWritableShaderSource* getWritableShaderSource() { return m_shsrc; }
 	u16 allocateUnknownNodeId(const std::string &name) override;
 	virtual ISoundManager* getSoundManager();
 	MtEventManager* getEventManager();
@@ -453,11 +461,25 @@ private:
 	void ReceiveAll();
 	void Receive();
 
+	// Insert or update a block decoded from a server payload by the
+	// decode thread pool; takes ownership of the block
+	void updateReceivedBlock(v3s16 p, MapBlock *decoded);
+
+	// Applies node changes from a block delta to the block at p
+	void applyBlockDelta(v3s16 p,
+			const std::vector<std::pair<u16, MapNode>> &changes);
+
 	void sendPlayerPos();
 
 	void deleteAuthData();
 	// helper method shared with clientpackethandler
-	static AuthMechanism choseAuthMech(const u32 mechs);
+	AuthMechanism choseAuthMech(const u32 mechs);
+
+	// Process-lifetime cache of SRP session keys, for single round trip
+	// reauthentication on reconnect (AUTH_MECHANISM_SESSION_KEY)
+	std::string getCachedSessionKey();
+	void cacheSessionKey(const std::string &key);
+	void dropCachedSessionKey();
 
 	void sendInit(const std::string &playerName);
 	void promptConfirmRegistration(AuthMechanism chosen_auth_mechanism);
@@ -487,6 +509,25 @@ private:
 
 
 	MeshUpdateThread m_mesh_update_thread;
+	BlockDecodeThread m_block_decode_thread;
+
+	/*
+		Blocks handed to the decode pool but not yet merged. Tracks the
+		sequence number of the newest payload per block (older results
+		are discarded, since workers may finish out of order) and node
+		deltas that arrived while a full payload was still decoding;
+		those are applied right after the merge to keep the server's
+		send order intact.
+	*/
+	struct PendingBlockDecode
+	{
+		u32 latest_seq = 0;
+		u32 outstanding = 0;
+		std::vector<std::pair<u16, MapNode>> deltas;
+	};
+	std::unordered_map<v3s16, PendingBlockDecode, v3s16Hash> m_pending_block_decodes;
+	u32 m_block_decode_seq = 0;
+
 	ClientEnvironment m_env;
 	ParticleManager m_particle_manager;
 	std::unique_ptr<con::Connection> m_con;
@@ -534,6 +575,8 @@ private:
 	// Usable by auth mechanisms.
 	AuthMechanism m_chosen_auth_mech;
 	void *m_auth_data = nullptr;
+	// Challenge from TOCLIENT_HELLO for AUTH_MECHANISM_SESSION_KEY
+	std::string m_reauth_challenge;
 
 
 	bool m_access_denied = false;
@@ -542,6 +585,8 @@ private:
 	std::queue<ClientEvent *> m_client_event_queue;
 	bool m_itemdef_received = false;
 	bool m_nodedef_received = false;
+	// Whether afterDefinitionsReceived() has run
+	bool m_definitions_prepared = false;
 	bool m_activeobjects_received = false;
 	bool m_mods_loaded = false;
 	ClientMediaDownloader *m_media_downloader;
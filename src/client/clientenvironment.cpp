@@ -47,6 +47,8 @@ ClientEnvironment::ClientEnvironment(ClientMap *map,
 	m_texturesource(texturesource),
 	m_client(client)
 {
+	m_simulation_step = rangelim(
+			g_settings->getFloat("client_simulation_step"), 0.0f, 0.2f);
 }
 
 ClientEnvironment::~ClientEnvironment()
@@ -259,9 +261,10 @@ void ClientEnvironment::step(float dtime)
 	*/
 
 	bool update_lighting = m_active_object_light_update_interval.step(dtime, 0.21);
-	auto cb_state = [this, dtime, update_lighting, day_night_ratio] (ClientActiveObject *cao) {
+	auto cb_state = [this, update_lighting, day_night_ratio]
+			(ClientActiveObject *cao, float cao_dtime) {
 		// Step object
-		cao->step(dtime, this);
+		cao->step(cao_dtime, this);
 
 		if (update_lighting) {
 			// Update lighting
@@ -280,7 +283,24 @@ void ClientEnvironment::step(float dtime)
 		}
 	};
 
-	m_ao_manager.step(dtime, cb_state);
+	// Step rate is tiered by distance from the player so crowds at the
+	// far end of a sightline do not drag the frame time down
+	if (m_simulation_step > 0.0f) {
+		// Fixed-rate stepping: simulation advances in constant slices
+		// while interpolation below keeps the rendering smooth
+		m_simulation_accumulator = MYMIN(m_simulation_accumulator + dtime,
+				4.0f * m_simulation_step);
+		while (m_simulation_accumulator >= m_simulation_step) {
+			m_simulation_accumulator -= m_simulation_step;
+			m_ao_manager.step(m_simulation_step, lplayer->getPosition(),
+					cb_state);
+		}
+	} else {
+		m_ao_manager.step(dtime, lplayer->getPosition(), cb_state);
+	}
+
+	// Advance render-side interpolation every frame
+	m_ao_manager.updateFrame(dtime);
 
 	/*
 		Step and handle simple objects
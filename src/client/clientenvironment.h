@@ -151,6 +151,9 @@ private:
 	std::vector<ClientSimpleObject*> m_simple_objects;
 	std::queue<ClientEnvEvent> m_client_event_queue;
 	IntervalLimiter m_active_object_light_update_interval;
+	// Fixed object simulation step length; 0 steps objects once per frame
+	float m_simulation_step;
+	float m_simulation_accumulator = 0.0f;
 	std::list<std::string> m_player_names;
 	v3s16 m_camera_offset;
 };
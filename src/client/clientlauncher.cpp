@@ -251,6 +251,12 @@ bool ClientLauncher::run(GameParams &game_params, const Settings &cmd_args)
 			RenderingEngine::get_video_driver()->setTextureCreationFlag(
 					video::ETCF_CREATE_MIP_MAPS, g_settings->getBool("mip_map"));
 
+			// Halves VRAM use and upload bandwidth at some color
+			// fidelity cost; useful on low-memory GPUs
+			RenderingEngine::get_video_driver()->setTextureCreationFlag(
+					video::ETCF_ALWAYS_16_BIT,
+					g_settings->getBool("texture_16bit"));
+
 #ifdef HAVE_TOUCHSCREENGUI
 			receiver->m_touchscreengui = new TouchScreenGUI(RenderingEngine::get_raw_device(), receiver);
 			g_touchscreengui = receiver->m_touchscreengui;
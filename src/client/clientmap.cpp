@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "camera.h"               // CameraModes
 #include "util/basic_macros.h"
 #include <algorithm>
+#include <cmath>
 #include "client/renderingengine.h"
 
 ClientMap::ClientMap(
@@ -57,6 +58,7 @@ ClientMap::ClientMap(
 	m_cache_trilinear_filter  = g_settings->getBool("trilinear_filter");
 	m_cache_bilinear_filter   = g_settings->getBool("bilinear_filter");
 	m_cache_anistropic_filter = g_settings->getBool("anisotropic_filter");
+	m_cache_lod_mesh_distance = g_settings->getS16("lod_mesh_distance");
 
 }
 
@@ -85,56 +87,307 @@ void ClientMap::OnRegisterSceneNode()
 	ISceneNode::OnRegisterSceneNode();
 }
 
-void ClientMap::getBlocksInViewRange(v3s16 cam_pos_nodes,
-		v3s16 *p_blocks_min, v3s16 *p_blocks_max)
+// World-coordinate bounding box of a cube of blocks
+static aabb3f getBlockBox(v3s16 min, s16 size)
 {
-	v3s16 box_nodes_d = m_control.wanted_range * v3s16(1, 1, 1);
-	// Define p_nodes_min/max as v3s32 because 'cam_pos_nodes -/+ box_nodes_d'
-	// can exceed the range of v3s16 when a large view range is used near the
-	// world edges.
-	v3s32 p_nodes_min(
-		cam_pos_nodes.X - box_nodes_d.X,
-		cam_pos_nodes.Y - box_nodes_d.Y,
-		cam_pos_nodes.Z - box_nodes_d.Z);
-	v3s32 p_nodes_max(
-		cam_pos_nodes.X + box_nodes_d.X,
-		cam_pos_nodes.Y + box_nodes_d.Y,
-		cam_pos_nodes.Z + box_nodes_d.Z);
-	// Take a fair amount as we will be dropping more out later
-	// Umm... these additions are a bit strange but they are needed.
-	*p_blocks_min = v3s16(
-			p_nodes_min.X / MAP_BLOCKSIZE - 3,
-			p_nodes_min.Y / MAP_BLOCKSIZE - 3,
-			p_nodes_min.Z / MAP_BLOCKSIZE - 3);
-	*p_blocks_max = v3s16(
-			p_nodes_max.X / MAP_BLOCKSIZE + 1,
-			p_nodes_max.Y / MAP_BLOCKSIZE + 1,
-			p_nodes_max.Z / MAP_BLOCKSIZE + 1);
+	return aabb3f(
+			min.X * MAP_BLOCKSIZE * BS,
+			min.Y * MAP_BLOCKSIZE * BS,
+			min.Z * MAP_BLOCKSIZE * BS,
+			(min.X + size) * MAP_BLOCKSIZE * BS,
+			(min.Y + size) * MAP_BLOCKSIZE * BS,
+			(min.Z + size) * MAP_BLOCKSIZE * BS);
+}
+
+void ClientMap::OcclusionBuffer::setup(v3f camera_pos, v3f camera_dir,
+		f32 camera_fov)
+{
+	m_camera_pos = camera_pos;
+	m_camera_dir = camera_dir;
+
+	// Build a screen-space basis from the view direction. Any basis
+	// works as long as occluders and tested boxes use the same one.
+	m_right = camera_dir.crossProduct(v3f(0.0f, 1.0f, 0.0f));
+	if (m_right.getLengthSQ() < 0.001f)
+		m_right = v3f(1.0f, 0.0f, 0.0f);
+	m_right.normalize();
+	m_up = m_right.crossProduct(camera_dir);
+
+	// A fov wider than the real one only lowers the effective
+	// resolution; it must just stay well below pi for tan()
+	m_scale = 1.0f / std::tan(rangelim(camera_fov, 0.5f, 3.0f) * 0.5f);
+
+	for (f32 &d : m_depth)
+		d = 1.0e30f;
+}
+
+bool ClientMap::OcclusionBuffer::project(const v3f &p, f32 *x, f32 *y,
+		f32 *depth) const
+{
+	v3f rel = p - m_camera_pos;
+	f32 d = rel.dotProduct(m_camera_dir);
+
+	// Points (nearly) on or behind the camera plane can't be projected
+	if (d < BS)
+		return false;
+
+	*x = (rel.dotProduct(m_right) / d * m_scale * 0.5f + 0.5f) * RESOLUTION;
+	*y = (rel.dotProduct(m_up) / d * m_scale * 0.5f + 0.5f) * RESOLUTION;
+	*depth = d;
+	return true;
+}
+
+void ClientMap::OcclusionBuffer::drawQuad(const f32 (&x)[4], const f32 (&y)[4],
+		f32 depth)
+{
+	f32 xmin = MYMIN(MYMIN(x[0], x[1]), MYMIN(x[2], x[3]));
+	f32 xmax = MYMAX(MYMAX(x[0], x[1]), MYMAX(x[2], x[3]));
+	f32 ymin = MYMIN(MYMIN(y[0], y[1]), MYMIN(y[2], y[3]));
+	f32 ymax = MYMAX(MYMAX(y[0], y[1]), MYMAX(y[2], y[3]));
+
+	s32 x0 = MYMAX((s32)std::floor(xmin), 0);
+	s32 x1 = MYMIN((s32)std::ceil(xmax), RESOLUTION - 1);
+	s32 y0 = MYMAX((s32)std::floor(ymin), 0);
+	s32 y1 = MYMIN((s32)std::ceil(ymax), RESOLUTION - 1);
+
+	for (s32 py = y0; py <= y1; py++) {
+		f32 cy = py + 0.5f;
+		for (s32 px = x0; px <= x1; px++) {
+			f32 cx = px + 0.5f;
+
+			// The pixel center is inside the convex quad when all
+			// edge functions have the same sign (the projection may
+			// flip the winding, so accept either one)
+			bool pos = false;
+			bool neg = false;
+			for (u32 i = 0; i < 4; i++) {
+				u32 j = (i + 1) % 4;
+				f32 e = (x[j] - x[i]) * (cy - y[i])
+						- (y[j] - y[i]) * (cx - x[i]);
+				if (e > 0.0f)
+					pos = true;
+				else if (e < 0.0f)
+					neg = true;
+			}
+			if (pos && neg)
+				continue;
+
+			f32 &d = m_depth[py * RESOLUTION + px];
+			if (depth < d)
+				d = depth;
+		}
+	}
+}
+
+void ClientMap::OcclusionBuffer::drawOccluder(const aabb3f &box)
+{
+	// Project the box corners. An occluder crossing the camera plane
+	// is simply skipped; that only loses some culling.
+	f32 x[8], y[8], depth[8];
+	f32 far_depth = 0.0f;
+	for (u32 i = 0; i < 8; i++) {
+		v3f corner(
+				(i & 1) ? box.MaxEdge.X : box.MinEdge.X,
+				(i & 2) ? box.MaxEdge.Y : box.MinEdge.Y,
+				(i & 4) ? box.MaxEdge.Z : box.MinEdge.Z);
+		if (!project(corner, &x[i], &y[i], &depth[i]))
+			return;
+		far_depth = MYMAX(far_depth, depth[i]);
+	}
+
+	// Corner indices of each face, in cyclic order
+	static const u8 faces[6][4] = {
+		{0, 2, 6, 4}, // X-
+		{1, 3, 7, 5}, // X+
+		{0, 1, 5, 4}, // Y-
+		{2, 3, 7, 6}, // Y+
+		{0, 1, 3, 2}, // Z-
+		{4, 5, 7, 6}, // Z+
+	};
+	const f32 cam[3] = {m_camera_pos.X, m_camera_pos.Y, m_camera_pos.Z};
+	const f32 bmin[3] = {box.MinEdge.X, box.MinEdge.Y, box.MinEdge.Z};
+	const f32 bmax[3] = {box.MaxEdge.X, box.MaxEdge.Y, box.MaxEdge.Z};
+
+	// Fill the camera-facing faces with the far depth of the box, so
+	// that it only occludes what lies completely behind it
+	for (u32 f = 0; f < 6; f++) {
+		u32 axis = f / 2;
+		bool facing_camera = (f & 1) ? cam[axis] > bmax[axis]
+				: cam[axis] < bmin[axis];
+		if (!facing_camera)
+			continue;
+
+		f32 qx[4], qy[4];
+		for (u32 i = 0; i < 4; i++) {
+			qx[i] = x[faces[f][i]];
+			qy[i] = y[faces[f][i]];
+		}
+		drawQuad(qx, qy, far_depth);
+	}
+}
+
+bool ClientMap::OcclusionBuffer::isOccluded(const aabb3f &box) const
+{
+	// A box reaching the camera plane is always treated as visible
+	f32 xmin = 0.0f, xmax = 0.0f, ymin = 0.0f, ymax = 0.0f;
+	f32 near_depth = 0.0f;
+	for (u32 i = 0; i < 8; i++) {
+		v3f corner(
+				(i & 1) ? box.MaxEdge.X : box.MinEdge.X,
+				(i & 2) ? box.MaxEdge.Y : box.MinEdge.Y,
+				(i & 4) ? box.MaxEdge.Z : box.MinEdge.Z);
+		f32 x, y, depth;
+		if (!project(corner, &x, &y, &depth))
+			return false;
+		if (i == 0) {
+			xmin = xmax = x;
+			ymin = ymax = y;
+			near_depth = depth;
+		} else {
+			xmin = MYMIN(xmin, x); xmax = MYMAX(xmax, x);
+			ymin = MYMIN(ymin, y); ymax = MYMAX(ymax, y);
+			near_depth = MYMIN(near_depth, depth);
+		}
+	}
+
+	s32 x0 = (s32)std::floor(xmin);
+	s32 x1 = (s32)std::floor(xmax);
+	s32 y0 = (s32)std::floor(ymin);
+	s32 y1 = (s32)std::floor(ymax);
+
+	// A box reaching past the edge of the buffer is treated as visible;
+	// the buffer fov may be narrower than the real one (see setup()),
+	// so what is outside of it can not be assumed hidden
+	if (x0 < 0 || x1 > RESOLUTION - 1 || y0 < 0 || y1 > RESOLUTION - 1)
+		return false;
+
+	// Occluded only if every touched pixel is covered by an occluder
+	// that lies strictly in front of the box
+	for (s32 py = y0; py <= y1; py++)
+	for (s32 px = x0; px <= x1; px++) {
+		if (m_depth[py * RESOLUTION + px] >= near_depth)
+			return false;
+	}
+
+	return true;
+}
+
+s32 ClientMap::buildOctreeNode(std::vector<MapBlock*> &blocks, v3s16 min, s16 size)
+{
+	// Don't hold a reference into m_octree across the recursion below;
+	// the vector may reallocate
+	s32 index = m_octree.size();
+	m_octree.emplace_back();
+	m_octree[index].min = min;
+	m_octree[index].size = size;
+	for (s32 &child : m_octree[index].children)
+		child = -1;
+
+	// Small sets aren't worth splitting further
+	if (size == 1 || blocks.size() <= 8) {
+		m_octree[index].blocks = std::move(blocks);
+		return index;
+	}
+
+	s16 half = size / 2;
+	std::vector<MapBlock*> child_blocks[8];
+	for (MapBlock *block : blocks) {
+		v3s16 p = block->getPos();
+		u32 i = (p.X >= min.X + half ? 1 : 0)
+				| (p.Y >= min.Y + half ? 2 : 0)
+				| (p.Z >= min.Z + half ? 4 : 0);
+		child_blocks[i].push_back(block);
+	}
+
+	for (u32 i = 0; i < 8; i++) {
+		if (child_blocks[i].empty())
+			continue;
+		v3s16 child_min(
+				min.X + (i & 1 ? half : 0),
+				min.Y + (i & 2 ? half : 0),
+				min.Z + (i & 4 ? half : 0));
+		s32 child = buildOctreeNode(child_blocks[i], child_min, half);
+		m_octree[index].children[i] = child;
+	}
+
+	return index;
+}
+
+void ClientMap::rebuildBlockOctree()
+{
+	ScopeProfiler sp(g_profiler, "CM::rebuildBlockOctree()", SPT_AVG);
+
+	m_octree.clear();
+	// The draw list was computed from the old block set
+	m_drawlist_valid = false;
+	m_octree_block_set_version = getBlockSetVersion();
+
+	std::vector<MapBlock*> blocks;
+	for (const auto &sector_it : m_sectors)
+		sector_it.second->getBlocks(blocks);
+
+	if (blocks.empty())
+		return;
+
+	// Bounding box of all loaded blocks
+	v3s16 p_min = blocks[0]->getPos();
+	v3s16 p_max = p_min;
+	for (MapBlock *block : blocks) {
+		v3s16 p = block->getPos();
+		p_min.X = MYMIN(p_min.X, p.X); p_max.X = MYMAX(p_max.X, p.X);
+		p_min.Y = MYMIN(p_min.Y, p.Y); p_max.Y = MYMAX(p_max.Y, p.Y);
+		p_min.Z = MYMIN(p_min.Z, p.Z); p_max.Z = MYMAX(p_max.Z, p.Z);
+	}
+
+	// Round the largest extent up to a power of two so that child cells
+	// always split evenly
+	s16 extent = MYMAX(p_max.X - p_min.X,
+			MYMAX(p_max.Y - p_min.Y, p_max.Z - p_min.Z)) + 1;
+	s16 size = 1;
+	while (size < extent)
+		size *= 2;
+
+	buildOctreeNode(blocks, p_min, size);
 }
 
 void ClientMap::updateDrawList()
 {
 	ScopeProfiler sp(g_profiler, "CM::updateDrawList()", SPT_AVG);
 
+	// Rebuild the octree if blocks were added or removed since last time
+	if (m_octree_block_set_version != getBlockSetVersion())
+		rebuildBlockOctree();
+
+	v3f camera_position = m_camera_position;
+	v3f camera_direction = m_camera_direction;
+	f32 camera_fov = m_camera_fov;
+
+	// If nothing that affects the visible set changed, the current draw
+	// list is still correct
+	if (m_drawlist_valid &&
+			m_drawlist_mesh_counter == m_mesh_change_counter &&
+			m_drawlist_camera_offset == m_camera_offset &&
+			m_drawlist_camera_fov == camera_fov &&
+			m_drawlist_wanted_range == m_control.wanted_range &&
+			m_drawlist_range_all == m_control.range_all &&
+			m_drawlist_camera_position.getDistanceFromSQ(camera_position)
+				< 0.01f * BS * 0.01f * BS &&
+			m_drawlist_camera_direction.getDistanceFromSQ(camera_direction)
+				< 0.0001f)
+		return;
+
 	for (auto &i : m_drawlist) {
 		MapBlock *block = i.second;
 		block->refDrop();
 	}
 	m_drawlist.clear();
 
-	v3f camera_position = m_camera_position;
-	v3f camera_direction = m_camera_direction;
-	f32 camera_fov = m_camera_fov;
-
 	// Use a higher fov to accomodate faster camera movements.
 	// Blocks are cropped better when they are drawn.
 	// Or maybe they aren't? Well whatever.
 	camera_fov *= 1.2;
 
 	v3s16 cam_pos_nodes = floatToInt(camera_position, BS);
-	v3s16 p_blocks_min;
-	v3s16 p_blocks_max;
-	getBlocksInViewRange(cam_pos_nodes, &p_blocks_min, &p_blocks_max);
 
 	// Number of blocks with mesh in rendering range
 	u32 blocks_in_range_with_mesh = 0;
@@ -156,38 +409,95 @@ void ClientMap::updateDrawList()
 	//if (occlusion_culling_enabled && m_control.show_wireframe)
 	//    occlusion_culling_enabled = porting::getTimeS() & 1;
 
-	for (const auto &sector_it : m_sectors) {
-		MapSector *sector = sector_it.second;
-		v2s16 sp = sector->getPos();
+	bool sw_occlusion = occlusion_culling_enabled &&
+			g_settings->getBool("software_occlusion_culling");
 
-		if (!m_control.range_all) {
-			if (sp.X < p_blocks_min.X || sp.X > p_blocks_max.X ||
-					sp.Y < p_blocks_min.Z || sp.Y > p_blocks_max.Z)
+	float range = 100000 * BS;
+	if (!m_control.range_all)
+		range = m_control.wanted_range * BS;
+
+	/*
+		Rasterize the fully solid blocks in view into the low-resolution
+		depth buffer, so that subtrees and blocks behind them can be
+		rejected without per-block ray sampling
+	*/
+	if (sw_occlusion) {
+		m_occlusion_buffer.setup(camera_position, camera_direction, camera_fov);
+
+		std::vector<s32> occluder_stack;
+		if (!m_octree.empty())
+			occluder_stack.push_back(0);
+
+		while (!occluder_stack.empty()) {
+			const BlockOctreeNode &node = m_octree[occluder_stack.back()];
+			occluder_stack.pop_back();
+
+			// Bounding sphere of the node, in world coordinates.
+			// The magic number is sqrt(3.0) / 2.0 in literal form.
+			v3f center(
+					(node.min.X + node.size * 0.5f) * MAP_BLOCKSIZE * BS,
+					(node.min.Y + node.size * 0.5f) * MAP_BLOCKSIZE * BS,
+					(node.min.Z + node.size * 0.5f) * MAP_BLOCKSIZE * BS);
+			f32 radius = 0.866025403784f * node.size * MAP_BLOCKSIZE * BS;
+
+			if (node.size > 1 && !isAreaInSight(center, radius,
+					camera_position, camera_direction, camera_fov, range))
 				continue;
+
+			for (s32 child : node.children) {
+				if (child != -1)
+					occluder_stack.push_back(child);
+			}
+
+			for (MapBlock *block : node.blocks) {
+				if (block->isSolidOccluder())
+					m_occlusion_buffer.drawOccluder(
+							getBlockBox(block->getPos(), 1));
+			}
 		}
+	}
 
-		MapBlockVect sectorblocks;
-		sector->getBlocks(sectorblocks);
+	/*
+		Walk the block octree, pruning whole subtrees whose bounding
+		sphere falls outside the view frustum or range
+	*/
 
-		/*
-			Loop through blocks in sector
-		*/
+	std::vector<s32> stack;
+	if (!m_octree.empty())
+		stack.push_back(0);
+
+	while (!stack.empty()) {
+		const BlockOctreeNode &node = m_octree[stack.back()];
+		stack.pop_back();
 
-		u32 sector_blocks_drawn = 0;
+		// Bounding sphere of the node, in world coordinates.
+		// The magic number is sqrt(3.0) / 2.0 in literal form.
+		v3f center(
+				(node.min.X + node.size * 0.5f) * MAP_BLOCKSIZE * BS,
+				(node.min.Y + node.size * 0.5f) * MAP_BLOCKSIZE * BS,
+				(node.min.Z + node.size * 0.5f) * MAP_BLOCKSIZE * BS);
+		f32 radius = 0.866025403784f * node.size * MAP_BLOCKSIZE * BS;
+
+		if (node.size > 1 && !isAreaInSight(center, radius, camera_position,
+				camera_direction, camera_fov, range))
+			continue;
 
-		for (MapBlock *block : sectorblocks) {
+		// Reject whole subtrees buried behind solid geometry
+		if (sw_occlusion && node.size > 1 &&
+				m_occlusion_buffer.isOccluded(getBlockBox(node.min, node.size)))
+			continue;
+
+		for (s32 child : node.children) {
+			if (child != -1)
+				stack.push_back(child);
+		}
+
+		for (MapBlock *block : node.blocks) {
 			/*
 				Compare block position to camera position, skip
 				if not seen on display
 			*/
 
-			if (block->mesh)
-				block->mesh->updateCameraOffset(m_camera_offset);
-
-			float range = 100000 * BS;
-			if (!m_control.range_all)
-				range = m_control.wanted_range * BS;
-
 			float d = 0.0;
 			if (!isBlockInSight(block->getPos(), camera_position,
 					camera_direction, camera_fov, range, &d))
@@ -205,8 +515,16 @@ void ClientMap::updateDrawList()
 			/*
 				Occlusion culling
 			*/
+			bool occluded;
+			if (sw_occlusion)
+				occluded = m_occlusion_buffer.isOccluded(
+						getBlockBox(block->getPos(), 1));
+			else
+				occluded = occlusion_culling_enabled &&
+						isBlockOccluded(block, cam_pos_nodes);
+
 			if ((!m_control.range_all && d > m_control.wanted_range * BS) ||
-					(occlusion_culling_enabled && isBlockOccluded(block, cam_pos_nodes))) {
+					occluded) {
 				blocks_occlusion_culled++;
 				continue;
 			}
@@ -217,14 +535,19 @@ void ClientMap::updateDrawList()
 			// Add to set
 			block->refGrab();
 			m_drawlist[block->getPos()] = block;
-
-			sector_blocks_drawn++;
-		} // foreach sectorblocks
-
-		if (sector_blocks_drawn != 0)
-			m_last_drawn_sectors.insert(sp);
+		}
 	}
 
+	// Remember what this draw list was computed from
+	m_drawlist_valid = true;
+	m_drawlist_mesh_counter = m_mesh_change_counter;
+	m_drawlist_camera_position = m_camera_position;
+	m_drawlist_camera_direction = m_camera_direction;
+	m_drawlist_camera_fov = m_camera_fov;
+	m_drawlist_camera_offset = m_camera_offset;
+	m_drawlist_wanted_range = m_control.wanted_range;
+	m_drawlist_range_all = m_control.range_all;
+
 	g_profiler->avg("MapBlock meshes in range [#]", blocks_in_range_with_mesh);
 	g_profiler->avg("MapBlocks occlusion culled [#]", blocks_occlusion_culled);
 	g_profiler->avg("MapBlocks drawn [#]", m_drawlist.size());
@@ -233,7 +556,10 @@ void ClientMap::updateDrawList()
 struct MeshBufList
 {
 	video::SMaterial m;
-	std::vector<scene::IMeshBuffer*> bufs;
+	// Mesh buffers are in block-local coordinates and carry their
+	// block's world translation, applied per draw; identical blocks may
+	// share one buffer and draw it at several translations
+	std::vector<std::pair<scene::IMeshBuffer*, v3f>> bufs;
 };
 
 struct MeshBufListList
@@ -251,7 +577,7 @@ struct MeshBufListList
 			list.clear();
 	}
 
-	void add(scene::IMeshBuffer *buf, u8 layer)
+	void add(scene::IMeshBuffer *buf, const v3f &translation, u8 layer)
 	{
 		// Append to the correct layer
 		std::vector<MeshBufList> &list = lists[layer];
@@ -263,15 +589,43 @@ struct MeshBufListList
 				continue;
 
 			if (l.m == m) {
-				l.bufs.push_back(buf);
+				l.bufs.emplace_back(buf, translation);
 				return;
 			}
 		}
 		MeshBufList l;
 		l.m = m;
-		l.bufs.push_back(buf);
+		l.bufs.emplace_back(buf, translation);
 		list.push_back(l);
 	}
+
+	// Sort each layer's material groups by texture and material type so
+	// that consecutive setMaterial calls change as little GL state as
+	// possible (the driver only applies the difference to the last
+	// material)
+	void sort()
+	{
+		for (auto &list : lists) {
+			std::sort(list.begin(), list.end(),
+				[](const MeshBufList &a, const MeshBufList &b) {
+					if (a.m.TextureLayer[0].Texture !=
+							b.m.TextureLayer[0].Texture)
+						return a.m.TextureLayer[0].Texture <
+								b.m.TextureLayer[0].Texture;
+					return a.m.MaterialType < b.m.MaterialType;
+				});
+		}
+	}
+};
+
+// A transparent mesh buffer and its view distance, for back-to-front
+// submission
+struct TransparentMeshBuffer
+{
+	f32 distance;
+	scene::IMeshBuffer *buf;
+	// World translation of the owning block (buffers are block-local)
+	v3f translation;
 };
 
 void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
@@ -284,12 +638,6 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 	else
 		prefix = "renderMap(TRANSPARENT): ";
 
-	/*
-		This is called two times per frame, reset on the non-transparent one
-	*/
-	if (pass == scene::ESNRP_SOLID)
-		m_last_drawn_sectors.clear();
-
 	/*
 		Get animation parameters
 	*/
@@ -316,6 +664,7 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 	*/
 
 	MeshBufListList drawbufs;
+	std::vector<TransparentMeshBuffer> transparent_bufs;
 
 	for (auto &i : m_drawlist) {
 		MapBlock *block = i.second;
@@ -329,10 +678,14 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 				camera_direction, camera_fov, 100000 * BS, &d))
 			continue;
 
+		// World translation of this block's (block-local) mesh buffers
+		const v3f block_translation =
+			intToFloat(block->getPos() * MAP_BLOCKSIZE - m_camera_offset, BS);
+
 		// Mesh animation
 		if (pass == scene::ESNRP_SOLID) {
 			//MutexAutoLock lock(block->mesh_mutex);
-			MapBlockMesh *mapBlockMesh = block->mesh;
+			MapBlockMesh *mapBlockMesh = block->mesh.get();
 			assert(mapBlockMesh);
 			// Pretty random but this should work somewhat nicely
 			bool faraway = d >= BS * 50;
@@ -354,11 +707,19 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 		{
 			//MutexAutoLock lock(block->mesh_mutex);
 
-			MapBlockMesh *mapBlockMesh = block->mesh;
+			MapBlockMesh *mapBlockMesh = block->mesh.get();
 			assert(mapBlockMesh);
 
+			// Swap in the simplified far-distance mesh tier beyond
+			// lod_mesh_distance mapblocks
+			bool use_lod = m_cache_lod_mesh_distance > 0 &&
+					d >= BS * MAP_BLOCKSIZE * m_cache_lod_mesh_distance &&
+					mapBlockMesh->getLodMesh(0);
+
 			for (int layer = 0; layer < MAX_TILE_LAYERS; layer++) {
-				scene::IMesh *mesh = mapBlockMesh->getMesh(layer);
+				scene::IMesh *mesh = use_lod ?
+						mapBlockMesh->getLodMesh(layer) :
+						mapBlockMesh->getMesh(layer);
 				assert(mesh);
 
 				u32 c = mesh->getMeshBufferCount();
@@ -383,7 +744,11 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 						material.setFlag(video::EMF_WIREFRAME,
 							m_control.show_wireframe);
 
-						drawbufs.add(buf, layer);
+						if (is_transparent_pass)
+							transparent_bufs.push_back({d, buf,
+								block_translation});
+						else
+							drawbufs.add(buf, block_translation, layer);
 					}
 				}
 			}
@@ -392,20 +757,99 @@ void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 
 	TimeTaker draw("Drawing mesh buffers");
 
-	// Render all layers in order
-	for (auto &lists : drawbufs.lists) {
-		for (MeshBufList &list : lists) {
+	if (is_transparent_pass) {
+		// The back-to-front order only changes when the camera moves a
+		// meaningful distance (buffer distances are per block anyway) or
+		// the buffer set itself changes, so reuse the previous
+		// permutation until then instead of re-sorting every frame
+		bool reuse_order =
+			m_transparent_sort_sig.size() == transparent_bufs.size() &&
+			camera_position.getDistanceFrom(m_transparent_sort_camera_pos) <
+				2.0f * BS;
+		if (reuse_order) {
+			for (u32 i = 0; i < transparent_bufs.size(); i++) {
+				if (m_transparent_sort_sig[i] != transparent_bufs[i].buf) {
+					reuse_order = false;
+					break;
+				}
+			}
+		}
+
+		if (!reuse_order) {
+			// Argsort over compact distance/index keys; the buffers
+			// themselves are only touched when drawing
+			struct TransparentSortKey
+			{
+				f32 distance;
+				u32 index;
+			};
+			std::vector<TransparentSortKey> keys;
+			keys.reserve(transparent_bufs.size());
+			for (u32 i = 0; i < transparent_bufs.size(); i++)
+				keys.push_back({transparent_bufs[i].distance, i});
+
+			// Back to front, so that distant blocks are blended first
+			// and nearby water/glass composes correctly over them
+			std::sort(keys.begin(), keys.end(),
+				[](const TransparentSortKey &a, const TransparentSortKey &b) {
+					return a.distance > b.distance;
+				});
+
+			m_transparent_sort_order.clear();
+			m_transparent_sort_order.reserve(keys.size());
+			for (const TransparentSortKey &key : keys)
+				m_transparent_sort_order.push_back(key.index);
+
+			m_transparent_sort_sig.clear();
+			m_transparent_sort_sig.reserve(transparent_bufs.size());
+			for (const TransparentMeshBuffer &tb : transparent_bufs)
+				m_transparent_sort_sig.push_back(tb.buf);
+
+			m_transparent_sort_camera_pos = camera_position;
+			g_profiler->add("renderMap: transparent sorts", 1);
+		}
+
+		const video::SMaterial *last_material = nullptr;
+		for (u32 draw_index : m_transparent_sort_order) {
+			TransparentMeshBuffer &tb = transparent_bufs[draw_index];
 			// Check and abort if the machine is swapping a lot
 			if (draw.getTimerTime() > 2000) {
 				infostream << "ClientMap::renderMap(): Rendering took >2s, " <<
 						"returning." << std::endl;
 				return;
 			}
-			driver->setMaterial(list.m);
-
-			for (scene::IMeshBuffer *buf : list.bufs) {
-				driver->drawMeshBuffer(buf);
-				vertex_count += buf->getVertexCount();
+			const video::SMaterial &m = tb.buf->getMaterial();
+			if (!last_material || !(*last_material == m)) {
+				driver->setMaterial(m);
+				last_material = &m;
+			}
+			core::matrix4 translation;
+			translation.setTranslation(tb.translation);
+			driver->setTransform(video::ETS_WORLD, translation);
+			driver->drawMeshBuffer(tb.buf);
+			vertex_count += tb.buf->getVertexCount();
+		}
+	} else {
+		// Render all layers in order, material groups sorted to
+		// minimize state changes
+		drawbufs.sort();
+		for (auto &lists : drawbufs.lists) {
+			for (MeshBufList &list : lists) {
+				// Check and abort if the machine is swapping a lot
+				if (draw.getTimerTime() > 2000) {
+					infostream << "ClientMap::renderMap(): Rendering took >2s, " <<
+							"returning." << std::endl;
+					return;
+				}
+				driver->setMaterial(list.m);
+
+				for (auto &buf : list.bufs) {
+					core::matrix4 translation;
+					translation.setTranslation(buf.second);
+					driver->setTransform(video::ETS_WORLD, translation);
+					driver->drawMeshBuffer(buf.first);
+					vertex_count += buf.first->getVertexCount();
+				}
 			}
 		}
 	}
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "camera.h"
 #include <set>
 #include <map>
+#include <vector>
 
 struct MapDrawControl
 {
@@ -98,8 +99,6 @@ public:
 		return m_box;
 	}
 
-	void getBlocksInViewRange(v3s16 cam_pos_nodes,
-		v3s16 *p_blocks_min, v3s16 *p_blocks_max);
 	void updateDrawList();
 	void renderMap(video::IVideoDriver* driver, s32 pass);
 
@@ -113,7 +112,56 @@ public:
 
 	const MapDrawControl & getControl() const { return m_control; }
 	f32 getCameraFov() const { return m_camera_fov; }
+
+	// Called from the main thread whenever a block mesh is created or
+	// replaced, so that updateDrawList() knows the visible set may have
+	// changed even though the camera has not moved.
+	void reportMeshChange() { m_mesh_change_counter++; }
 private:
+	/*
+		Node of the loose octree over all loaded blocks, used for
+		hierarchical view frustum culling in updateDrawList().
+		Children are indices into m_octree (-1 = no child); blocks are
+		only stored in leaf nodes.
+	*/
+	struct BlockOctreeNode
+	{
+		v3s16 min;       // minimum corner in block coordinates
+		s16 size;        // edge length in blocks (power of two)
+		s32 children[8];
+		std::vector<MapBlock*> blocks;
+	};
+
+	/*
+		Low-resolution software depth buffer used for occlusion culling
+		in updateDrawList(). Fully solid blocks are rasterized as opaque
+		boxes storing their far depth; a box is occluded when its near
+		depth lies behind the stored depth over its whole screen-space
+		bound. Both octree cells and single blocks are tested this way.
+	*/
+	class OcclusionBuffer
+	{
+	public:
+		void setup(v3f camera_pos, v3f camera_dir, f32 camera_fov);
+		void drawOccluder(const aabb3f &box);
+		bool isOccluded(const aabb3f &box) const;
+	private:
+		static const s32 RESOLUTION = 64;
+
+		bool project(const v3f &p, f32 *x, f32 *y, f32 *depth) const;
+		void drawQuad(const f32 (&x)[4], const f32 (&y)[4], f32 depth);
+
+		v3f m_camera_pos;
+		v3f m_camera_dir;
+		v3f m_right;
+		v3f m_up;
+		f32 m_scale = 1.0f;
+		f32 m_depth[RESOLUTION * RESOLUTION];
+	};
+
+	void rebuildBlockOctree();
+	s32 buildOctreeNode(std::vector<MapBlock*> &blocks, v3s16 min, s16 size);
+
 	Client *m_client;
 
 	aabb3f m_box = aabb3f(-BS * 1000000, -BS * 1000000, -BS * 1000000,
@@ -128,9 +176,39 @@ private:
 
 	std::map<v3s16, MapBlock*> m_drawlist;
 
-	std::set<v2s16> m_last_drawn_sectors;
+	// Octree over the loaded blocks, rebuilt lazily when the block set
+	// version of the map changes
+	std::vector<BlockOctreeNode> m_octree;
+	u32 m_octree_block_set_version = 0;
+
+	// Bumped by reportMeshChange()
+	u32 m_mesh_change_counter = 0;
+
+	OcclusionBuffer m_occlusion_buffer;
+
+	// State the current m_drawlist was computed from; updateDrawList()
+	// returns early when none of it has changed
+	bool m_drawlist_valid = false;
+	v3f m_drawlist_camera_position;
+	v3f m_drawlist_camera_direction;
+	f32 m_drawlist_camera_fov = 0.0f;
+	v3s16 m_drawlist_camera_offset;
+	float m_drawlist_wanted_range = 0.0f;
+	bool m_drawlist_range_all = false;
+	u32 m_drawlist_mesh_counter = 0;
+
+	// Cached back-to-front order of the transparent pass, reused until
+	// the camera moves past a threshold or the buffer set changes (see
+	// renderMap). m_transparent_sort_sig holds the buffers in collection
+	// order, m_transparent_sort_order the draw permutation over them.
+	std::vector<scene::IMeshBuffer *> m_transparent_sort_sig;
+	std::vector<u32> m_transparent_sort_order;
+	v3f m_transparent_sort_camera_pos = v3f(1e9, 1e9, 1e9);
 
 	bool m_cache_trilinear_filter;
 	bool m_cache_bilinear_filter;
 	bool m_cache_anistropic_filter;
+	// Distance (in mapblocks) beyond which the LOD mesh tier is drawn,
+	// 0 = disabled
+	s16 m_cache_lod_mesh_distance;
 };
@@ -29,12 +29,25 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/serialize.h"
 #include "util/sha1.h"
 #include "util/string.h"
+#include <atomic>
+#include <thread>
 
 static std::string getMediaCacheDir()
 {
 	return porting::path_cache + DIR_DELIM + "media";
 }
 
+// SHA1 digest of data as a 20-byte binary string
+static std::string compute_sha1(const std::string &data)
+{
+	SHA1 calculator;
+	calculator.addBytes(data.c_str(), data.size());
+	unsigned char *digest = calculator.getDigest();
+	std::string result((char *)digest, 20);
+	free(digest);
+	return result;
+}
+
 /*
 	ClientMediaDownloader
 */
@@ -160,24 +173,55 @@ void ClientMediaDownloader::step(Client *client)
 
 void ClientMediaDownloader::initialStep(Client *client)
 {
-	// Check media cache
+	// Check media cache. Reading and SHA1-verifying the cached files is
+	// spread over a worker pool; loading the verified data into the
+	// engine stays on this thread.
 	m_uncached_count = m_files.size();
-	for (auto &file_it : m_files) {
-		std::string name = file_it.first;
-		FileStatus *filestatus = file_it.second;
-		const std::string &sha1 = filestatus->sha1;
-
-		std::ostringstream tmp_os(std::ios_base::binary);
-		bool found_in_cache = m_media_cache.load(hex_encode(sha1), tmp_os);
-
-		// If found in cache, try to load it from there
-		if (found_in_cache) {
-			bool success = checkAndLoad(name, sha1,
-					tmp_os.str(), true, client);
-			if (success) {
-				filestatus->received = true;
-				m_uncached_count--;
-			}
+
+	std::vector<std::map<std::string, FileStatus*>::iterator> entries;
+	entries.reserve(m_files.size());
+	for (auto it = m_files.begin(); it != m_files.end(); ++it)
+		entries.push_back(it);
+
+	std::vector<std::string> datas(entries.size());
+	std::vector<std::string> digests(entries.size());
+	// Not vector<bool>: the workers write per-index concurrently
+	std::vector<u8> found(entries.size(), 0);
+
+	std::atomic<u32> cursor(0);
+	auto hash_worker = [&]() {
+		while (true) {
+			u32 i = cursor.fetch_add(1);
+			if (i >= entries.size())
+				break;
+			FileStatus *filestatus = entries[i]->second;
+			std::ostringstream tmp_os(std::ios_base::binary);
+			if (!m_media_cache.load(hex_encode(filestatus->sha1), tmp_os))
+				continue;
+			datas[i] = tmp_os.str();
+			digests[i] = compute_sha1(datas[i]);
+			found[i] = 1;
+		}
+	};
+
+	u32 thread_count = rangelim(std::thread::hardware_concurrency(), 1, 8);
+	std::vector<std::thread> workers;
+	for (u32 t = 1; t < thread_count; t++)
+		workers.emplace_back(hash_worker);
+	hash_worker();
+	for (std::thread &worker : workers)
+		worker.join();
+
+	for (u32 i = 0; i < entries.size(); i++) {
+		if (!found[i])
+			continue;
+		const std::string &name = entries[i]->first;
+		FileStatus *filestatus = entries[i]->second;
+		bool success = checkAndLoad(name, filestatus->sha1,
+				datas[i], true, client, &digests[i]);
+		if (success) {
+			filestatus->received = true;
+			m_uncached_count--;
 		}
 	}
 
@@ -510,21 +554,16 @@ void ClientMediaDownloader::conventionalTransferDone(
 
 bool ClientMediaDownloader::checkAndLoad(
 		const std::string &name, const std::string &sha1,
-		const std::string &data, bool is_from_cache, Client *client)
+		const std::string &data, bool is_from_cache, Client *client,
+		const std::string *precomputed_sha1)
 {
 	const char *cached_or_received = is_from_cache ? "cached" : "received";
 	const char *cached_or_received_uc = is_from_cache ? "Cached" : "Received";
 	std::string sha1_hex = hex_encode(sha1);
 
-	// Compute actual checksum of data
-	std::string data_sha1;
-	{
-		SHA1 data_sha1_calculator;
-		data_sha1_calculator.addBytes(data.c_str(), data.size());
-		unsigned char *data_tmpdigest = data_sha1_calculator.getDigest();
-		data_sha1.assign((char*) data_tmpdigest, 20);
-		free(data_tmpdigest);
-	}
+	// Compute actual checksum of data, unless a worker already did
+	std::string data_sha1 = precomputed_sha1 ?
+			*precomputed_sha1 : compute_sha1(data);
 
 	// Check that received file matches announced checksum
 	if (data_sha1 != sha1) {
@@ -102,9 +102,12 @@ private:
 	void startRemoteMediaTransfers();
 	void startConventionalTransfers(Client *client);
 
+	// precomputed_sha1 may carry the digest of data when it has already
+	// been computed (e.g. on a hashing worker thread)
 	bool checkAndLoad(const std::string &name, const std::string &sha1,
 			const std::string &data, bool is_from_cache,
-			Client *client);
+			Client *client,
+			const std::string *precomputed_sha1 = nullptr);
 
 	std::string serializeRequiredHashSet();
 	static void deSerializeHashSet(const std::string &data,
@@ -62,6 +62,10 @@ public:
 
 	// Step object in time
 	virtual void step(float dtime, ClientEnvironment *env) {}
+	// Advances render-side interpolation only; called once per rendered
+	// frame, which may be more often than step() when the simulation
+	// runs at a fixed rate (see client_simulation_step)
+	virtual void updateFrame(float dtime) {}
 
 	// Process a message sent by the server side object
 	virtual void processMessage(const std::string &data) {}
@@ -63,6 +63,9 @@ Clouds::Clouds(scene::ISceneManager* mgr,
 	m_params.color_ambient = video::SColor(255, 0, 0, 0);
 	m_params.speed         = v2f(0.0f, -2.0f);
 
+	m_meshbuffer = new scene::SMeshBuffer();
+	m_meshbuffer->setHardwareMappingHint(scene::EHM_STATIC);
+
 	readSettings();
 	g_settings->registerChangedCallback("enable_3d_clouds",
 		&cloud_3d_setting_changed, this);
@@ -74,6 +77,8 @@ Clouds::~Clouds()
 {
 	g_settings->deregisterChangedCallback("enable_3d_clouds",
 		&cloud_3d_setting_changed, this);
+
+	m_meshbuffer->drop();
 }
 
 void Clouds::OnRegisterSceneNode()
@@ -87,33 +92,8 @@ void Clouds::OnRegisterSceneNode()
 	ISceneNode::OnRegisterSceneNode();
 }
 
-void Clouds::render()
+void Clouds::updateMesh()
 {
-
-	if (m_params.density <= 0.0f)
-		return; // no need to do anything
-
-	video::IVideoDriver* driver = SceneManager->getVideoDriver();
-
-	if(SceneManager->getSceneNodeRenderPass() != scene::ESNRP_TRANSPARENT)
-	//if(SceneManager->getSceneNodeRenderPass() != scene::ESNRP_SOLID)
-		return;
-
-	ScopeProfiler sp(g_profiler, "Clouds::render()", SPT_AVG);
-
-	int num_faces_to_draw = m_enable_3d ? 6 : 1;
-
-	m_material.setFlag(video::EMF_BACK_FACE_CULLING, m_enable_3d);
-
-	driver->setTransform(video::ETS_WORLD, AbsoluteTransformation);
-	driver->setMaterial(m_material);
-
-	/*
-		Clouds move from Z+ towards Z-
-	*/
-
-	const float cloud_full_radius = cloud_size * m_cloud_radius_i;
-
 	v2f camera_pos_2d(m_camera_pos.X, m_camera_pos.Z);
 	// Position of cloud noise origin from the camera
 	v2f cloud_origin_from_camera_f = m_origin - camera_pos_2d;
@@ -125,11 +105,18 @@ void Clouds::render()
 		std::floor(center_of_drawing_in_noise_f.Y / cloud_size)
 	);
 
-	// The world position of the integer center point of drawing in the noise
-	v2f world_center_of_drawing_in_noise_f = v2f(
-		center_of_drawing_in_noise_i.X * cloud_size,
-		center_of_drawing_in_noise_i.Y * cloud_size
-	) + m_origin;
+	// Only rebuild the mesh when the grid contents or the lighting have
+	// changed; mere drift within the center cell reuses the old mesh
+	if (m_mesh_valid &&
+			center_of_drawing_in_noise_i == m_mesh_center &&
+			m_color.toSColor() == m_mesh_color &&
+			m_cloud_radius_i == m_mesh_radius_i &&
+			m_enable_3d == m_mesh_3d &&
+			m_params.density == m_mesh_density &&
+			m_params.thickness == m_mesh_thickness)
+		return;
+
+	int num_faces_to_draw = m_enable_3d ? 6 : 1;
 
 	/*video::SColor c_top(128,b*240,b*240,b*255);
 	video::SColor c_side_1(128,b*230,b*230,b*255);
@@ -153,20 +140,8 @@ void Clouds::render()
 	video::SColor c_side_2 = c_side_2_f.toSColor();
 	video::SColor c_bottom = c_bottom_f.toSColor();
 
-	// Get fog parameters for setting them back later
-	video::SColor fog_color(0,0,0,0);
-	video::E_FOG_TYPE fog_type = video::EFT_FOG_LINEAR;
-	f32 fog_start = 0;
-	f32 fog_end = 0;
-	f32 fog_density = 0;
-	bool fog_pixelfog = false;
-	bool fog_rangefog = false;
-	driver->getFog(fog_color, fog_type, fog_start, fog_end, fog_density,
-			fog_pixelfog, fog_rangefog);
-
-	// Set our own fog
-	driver->setFog(fog_color, fog_type, cloud_full_radius * 0.5,
-			cloud_full_radius*1.2, fog_density, fog_pixelfog, fog_rangefog);
+	m_meshbuffer->Vertices.set_used(0);
+	m_meshbuffer->Indices.set_used(0);
 
 	// Read noise
 
@@ -211,7 +186,9 @@ void Clouds::render()
 		if (!grid[i])
 			continue;
 
-		v2f p0 = v2f(xi,zi)*cloud_size + world_center_of_drawing_in_noise_f;
+		// Relative to the center of the noise grid; the grid position and
+		// height are applied as a translation at draw time
+		v2f p0 = v2f(xi,zi)*cloud_size;
 
 		video::S3DVertex v[4] = {
 			video::S3DVertex(0,0,0, 0,0,0, c_top, 0, 1),
@@ -317,19 +294,90 @@ void Clouds::render()
 				break;
 			}
 
-			v3f pos(p0.X, m_params.height * BS, p0.Y);
-			pos -= intToFloat(m_camera_offset, BS);
+			// The mesh buffer uses 16 bit indices
+			if (m_meshbuffer->getVertexCount() + 4 > U16_MAX)
+				continue;
+
+			v3f pos(p0.X, 0.0f, p0.Y);
 
-			for (video::S3DVertex &vertex : v)
+			u16 vertex_count = m_meshbuffer->getVertexCount();
+			for (video::S3DVertex &vertex : v) {
 				vertex.Pos += pos;
-			u16 indices[] = {0,1,2,2,3,0};
-			driver->drawVertexPrimitiveList(v, 4, indices, 2,
-					video::EVT_STANDARD, scene::EPT_TRIANGLES, video::EIT_16BIT);
+				m_meshbuffer->Vertices.push_back(vertex);
+			}
+			static const u16 quad_indices[] = {0,1,2,2,3,0};
+			for (u16 index : quad_indices)
+				m_meshbuffer->Indices.push_back(vertex_count + index);
 		}
 	}
 
 	delete[] grid;
 
+	m_meshbuffer->recalculateBoundingBox();
+	m_meshbuffer->setDirty();
+
+	m_mesh_valid = true;
+	m_mesh_center = center_of_drawing_in_noise_i;
+	m_mesh_color = m_color.toSColor();
+	m_mesh_radius_i = m_cloud_radius_i;
+	m_mesh_3d = m_enable_3d;
+	m_mesh_density = m_params.density;
+	m_mesh_thickness = m_params.thickness;
+}
+
+void Clouds::render()
+{
+	if (m_params.density <= 0.0f)
+		return; // no need to do anything
+
+	video::IVideoDriver* driver = SceneManager->getVideoDriver();
+
+	if(SceneManager->getSceneNodeRenderPass() != scene::ESNRP_TRANSPARENT)
+	//if(SceneManager->getSceneNodeRenderPass() != scene::ESNRP_SOLID)
+		return;
+
+	ScopeProfiler sp(g_profiler, "Clouds::render()", SPT_AVG);
+
+	updateMesh();
+
+	m_material.setFlag(video::EMF_BACK_FACE_CULLING, m_enable_3d);
+
+	/*
+		Clouds move from Z+ towards Z-
+	*/
+
+	// The world position of the center of the noise grid the mesh was
+	// built around
+	v3f world_center(
+		m_mesh_center.X * cloud_size + m_origin.X,
+		m_params.height * BS,
+		m_mesh_center.Y * cloud_size + m_origin.Y);
+	world_center -= intToFloat(m_camera_offset, BS);
+
+	core::matrix4 translate;
+	translate.setTranslation(world_center);
+	driver->setTransform(video::ETS_WORLD, translate);
+	driver->setMaterial(m_material);
+
+	const float cloud_full_radius = cloud_size * m_cloud_radius_i;
+
+	// Get fog parameters for setting them back later
+	video::SColor fog_color(0,0,0,0);
+	video::E_FOG_TYPE fog_type = video::EFT_FOG_LINEAR;
+	f32 fog_start = 0;
+	f32 fog_end = 0;
+	f32 fog_density = 0;
+	bool fog_pixelfog = false;
+	bool fog_rangefog = false;
+	driver->getFog(fog_color, fog_type, fog_start, fog_end, fog_density,
+			fog_pixelfog, fog_rangefog);
+
+	// Set our own fog
+	driver->setFog(fog_color, fog_type, cloud_full_radius * 0.5,
+			cloud_full_radius*1.2, fog_density, fog_pixelfog, fog_rangefog);
+
+	driver->drawMeshBuffer(m_meshbuffer);
+
 	// Restore fog settings
 	driver->setFog(fog_color, fog_type, fog_start, fog_end, fog_density,
 			fog_pixelfog, fog_rangefog);
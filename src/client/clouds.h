@@ -119,6 +119,8 @@ public:
 	const video::SColor getColor() const { return m_color.toSColor(); }
 
 private:
+	void updateMesh();
+
 	void updateBox()
 	{
 		float height_bs    = m_params.height    * BS;
@@ -141,4 +143,14 @@ private:
 	CloudParams m_params;
 	bool m_camera_inside_cloud = false;
 
+	scene::SMeshBuffer *m_meshbuffer = nullptr;
+	// Inputs the current mesh was built from, to detect when it has to
+	// be rebuilt
+	bool m_mesh_valid = false;
+	v2s16 m_mesh_center;
+	video::SColor m_mesh_color;
+	u16 m_mesh_radius_i = 0;
+	bool m_mesh_3d = false;
+	float m_mesh_density = 0.0f;
+	float m_mesh_thickness = 0.0f;
 };
@@ -952,8 +952,7 @@ void GenericCAO::step(float dtime, ClientEnvironment *env)
 			player->overridePosition = getParent()->getPosition();
 		}
 	} else {
-		rot_translator.translate(dtime);
-		v3f lastpos = pos_translator.val_current;
+		v3f lastpos = m_position;
 
 		if(m_prop.physical)
 		{
@@ -974,18 +973,16 @@ void GenericCAO::step(float dtime, ClientEnvironment *env)
 
 			bool is_end_position = moveresult.collides;
 			pos_translator.update(m_position, is_end_position, dtime);
-			pos_translator.translate(dtime);
-			updateNodePos();
 		} else {
 			m_position += dtime * m_velocity + 0.5 * dtime * dtime * m_acceleration;
 			m_velocity += dtime * m_acceleration;
 			pos_translator.update(m_position, pos_translator.aim_is_end,
 					pos_translator.anim_time);
-			pos_translator.translate(dtime);
-			updateNodePos();
 		}
+		// The translators are advanced and the scene node moved in
+		// updateFrame(), once per rendered frame
 
-		float moved = lastpos.getDistanceFrom(pos_translator.val_current);
+		float moved = lastpos.getDistanceFrom(m_position);
 		m_step_distance_counter += moved;
 		if (m_step_distance_counter > 1.5f * BS) {
 			m_step_distance_counter = 0.0f;
@@ -1048,6 +1045,23 @@ void GenericCAO::step(float dtime, ClientEnvironment *env)
 	}
 }
 
+void GenericCAO::updateFrame(float dtime)
+{
+	// Attachments are glued to their parent by Irrlicht
+	if (getParent())
+		return;
+
+	if (m_is_local_player) {
+		// step() forces the translator state for the local player
+		updateNodePos();
+		return;
+	}
+
+	rot_translator.translate(dtime);
+	pos_translator.translate(dtime);
+	updateNodePos();
+}
+
 void GenericCAO::updateTexturePos()
 {
 	if(m_spritenode)
@@ -1378,14 +1392,41 @@ void GenericCAO::updateAttachments()
 	}
 }
 
+void GenericCAO::applyPositionUpdate(bool do_interpolate,
+		bool is_end_position, float update_interval)
+{
+	m_rotation = wrapDegrees_0_360_v3f(m_rotation);
+
+	// Place us a bit higher if we're physical, to not sink into
+	// the ground due to sucky collision detection...
+	if (m_prop.physical)
+		m_position += v3f(0,0.002,0);
+
+	if (getParent() != NULL) // Just in case
+		return;
+
+	if (do_interpolate) {
+		if (!m_prop.physical)
+			pos_translator.update(m_position, is_end_position, update_interval);
+	} else {
+		pos_translator.init(m_position);
+	}
+	rot_translator.update(m_rotation, false, update_interval);
+	updateNodePos();
+}
+
 void GenericCAO::processMessage(const std::string &data)
 {
 	//infostream<<"GenericCAO: Got message"<<std::endl;
 	std::istringstream is(data, std::ios::binary);
 	// command
 	u8 cmd = readU8(is);
-	if (cmd == GENERIC_CMD_SET_PROPERTIES) {
-		m_prop = gob_read_set_properties(is);
+	if (cmd == GENERIC_CMD_SET_PROPERTIES ||
+			cmd == GENERIC_CMD_SET_PROPERTIES_DELTA) {
+		if (cmd == GENERIC_CMD_SET_PROPERTIES)
+			m_prop = gob_read_set_properties(is);
+		else
+			gob_read_set_properties_delta(is, m_prop);
 
 		m_selection_box = m_prop.selectionbox;
 		m_selection_box.MinEdge *= BS;
@@ -1413,9 +1454,13 @@ void GenericCAO::processMessage(const std::string &data)
 			m_prop.nametag = m_name;
 
 		expireVisuals();
-	} else if (cmd == GENERIC_CMD_UPDATE_POSITION) {
+	} else if (cmd == GENERIC_CMD_UPDATE_POSITION ||
+			cmd == GENERIC_CMD_UPDATE_POSITION_KEYFRAME) {
 		// Not sent by the server if this object is an attachment.
 		// We might however get here if the server notices the object being detached before the client.
+		if (cmd == GENERIC_CMD_UPDATE_POSITION_KEYFRAME)
+			m_pos_keyframe_seq = readU8(is);
+
 		m_position = readV3F32(is);
 		m_velocity = readV3F32(is);
 		m_acceleration = readV3F32(is);
@@ -1425,28 +1470,42 @@ void GenericCAO::processMessage(const std::string &data)
 		else
 			readV3F32(is);
 
-		m_rotation = wrapDegrees_0_360_v3f(m_rotation);
+		if (cmd == GENERIC_CMD_UPDATE_POSITION_KEYFRAME) {
+			// Following delta messages are relative to this position
+			m_pos_keyframe = m_position;
+			m_pos_keyframe_valid = true;
+		}
+
 		bool do_interpolate = readU8(is);
 		bool is_end_position = readU8(is);
 		float update_interval = readF32(is);
 
-		// Place us a bit higher if we're physical, to not sink into
-		// the ground due to sucky collision detection...
-		if(m_prop.physical)
-			m_position += v3f(0,0.002,0);
-
-		if(getParent() != NULL) // Just in case
+		applyPositionUpdate(do_interpolate, is_end_position, update_interval);
+	} else if (cmd == GENERIC_CMD_UPDATE_POSITION_DELTA) {
+		u8 keyframe_seq = readU8(is);
+		v3s16 dpos = readV3S16(is);
+		v3s16 vel = readV3S16(is);
+		v3s16 acc = readV3S16(is);
+		v3s16 rot = readV3S16(is);
+
+		// A delta referencing a keyframe we never got (or one we lost)
+		// can't be applied; the next keyframe resynchronizes us
+		if (!m_pos_keyframe_valid || keyframe_seq != m_pos_keyframe_seq)
 			return;
 
-		if(do_interpolate)
-		{
-			if(!m_prop.physical)
-				pos_translator.update(m_position, is_end_position, update_interval);
-		} else {
-			pos_translator.init(m_position);
-		}
-		rot_translator.update(m_rotation, false, update_interval);
-		updateNodePos();
+		m_position = m_pos_keyframe + v3f(dpos.X, dpos.Y, dpos.Z)
+				/ GOB_POS_QUANT_SCALE;
+		m_velocity = v3f(vel.X, vel.Y, vel.Z) / GOB_POS_QUANT_SCALE;
+		m_acceleration = v3f(acc.X, acc.Y, acc.Z) / GOB_POS_QUANT_SCALE;
+
+		if (std::fabs(m_prop.automatic_rotate) < 0.001f)
+			m_rotation = v3f(rot.X, rot.Y, rot.Z) / GOB_ROT_QUANT_SCALE;
+
+		bool do_interpolate = readU8(is);
+		bool is_end_position = readU8(is);
+		float update_interval = readF32(is);
+
+		applyPositionUpdate(do_interpolate, is_end_position, update_interval);
 	} else if (cmd == GENERIC_CMD_SET_TEXTURE_MOD) {
 		std::string mod = deSerializeString(is);
 
@@ -1590,6 +1649,15 @@ void GenericCAO::processMessage(const std::string &data)
 			int rating = readS16(is);
 			m_armor_groups[name] = rating;
 		}
+	} else if (cmd == GENERIC_CMD_UPDATE_ARMOR_GROUPS_DELTA) {
+		u16 changed_count = readU16(is);
+		for (u16 i = 0; i < changed_count; i++) {
+			std::string name = deSerializeString(is);
+			m_armor_groups[name] = readS16(is);
+		}
+		u16 removed_count = readU16(is);
+		for (u16 i = 0; i < removed_count; i++)
+			m_armor_groups.erase(deSerializeString(is));
 	} else if (cmd == GENERIC_CMD_UPDATE_NAMETAG_ATTRIBUTES) {
 		// Deprecated, for backwards compatibility only.
 		readU8(is); // version
@@ -1606,6 +1674,11 @@ void GenericCAO::processMessage(const std::string &data)
 		(void)type;
 
 		addAttachmentChild(child_id);
+	} else if (cmd == GENERIC_CMD_BATCH) {
+		// Several commands coalesced into one message
+		u8 count = readU8(is);
+		for (u8 i = 0; i < count; i++)
+			processMessage(deSerializeLongString(is));
 	} else {
 		warningstream << FUNCTION_NAME
 			<< ": unknown command or outdated client \""
@@ -89,6 +89,10 @@ private:
 	v3f m_acceleration;
 	v3f m_rotation;
 	u16 m_hp = 1;
+	// Reference for GENERIC_CMD_UPDATE_POSITION_DELTA messages
+	v3f m_pos_keyframe;
+	u8 m_pos_keyframe_seq = 0;
+	bool m_pos_keyframe_valid = false;
 	SmoothTranslator<v3f> pos_translator;
 	SmoothTranslatorWrappedv3f rot_translator;
 	// Spritesheet/animation stuff
@@ -240,6 +244,8 @@ public:
 
 	void step(float dtime, ClientEnvironment *env);
 
+	void updateFrame(float dtime);
+
 	void updateTexturePos();
 
 	// ffs this HAS TO BE a string copy! See #5739 if you think otherwise
@@ -252,6 +258,11 @@ public:
 
 	void updateBonePosition();
 
+	// Feeds a received position/velocity/acceleration/rotation set into
+	// the translators; shared by the absolute and delta update commands
+	void applyPositionUpdate(bool do_interpolate, bool is_end_position,
+			float update_interval);
+
 	void processMessage(const std::string &data);
 
 	bool directReportPunch(v3f dir, const ItemStack *punchitem=NULL,
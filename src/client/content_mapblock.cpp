@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client/renderingengine.h"
 #include "client.h"
 #include "noise.h"
+#include <unordered_map>
 
 // Distance of light extrapolation (for oversized nodes)
 // After this distance, it gives up and considers light level constant
@@ -71,8 +72,26 @@ MapblockMeshGenerator::MapblockMeshGenerator(MeshMakeData *input, MeshCollector
 		!data->m_smooth_lighting; // Mesh cache is not supported with smooth lighting
 
 	blockpos_nodes = data->m_blockpos * MAP_BLOCKSIZE;
+	plant_template = nullptr;
 }
 
+/*
+	Geometry template caches for drawtypes whose node-local geometry only
+	depends on (content, param2): the rotated/offset vertex sets are baked
+	on first sight of a variant and stamped afterwards, with only the
+	position and light fixups done per instance. thread_local because
+	several mesh generation threads may run concurrently.
+*/
+static inline u32 geometry_template_key(content_t c, u8 param2)
+{
+	return (u32)c << 8 | param2;
+}
+
+static thread_local std::unordered_map<u32,
+	std::vector<MapblockMeshGenerator::PlantlikeQuad>> plantlike_templates;
+static thread_local std::unordered_map<u32,
+	std::vector<aabb3f>> nodebox_templates;
+
 void MapblockMeshGenerator::useTile(int index, u8 set_flags, u8 reset_flags, bool special)
 {
 	if (special)
@@ -930,6 +949,13 @@ void MapblockMeshGenerator::drawPlantlikeQuad(float rotation, float quad_offset,
 		vertex.rotateXZBy(rotation + rotate_degree);
 		vertex += offset;
 	}
+	if (plant_template) {
+		PlantlikeQuad quad;
+		for (int i = 0; i < 4; i++)
+			quad.vertices[i] = vertices[i];
+		quad.tiling = plant_height;
+		plant_template->push_back(quad);
+	}
 	drawQuad(vertices, v3s16(0, 0, 0), plant_height);
 }
 
@@ -943,6 +969,24 @@ void MapblockMeshGenerator::drawPlantlike()
 	face_num = 0;
 	plant_height = 1.0;
 
+	// Position-independent variants are baked once per (content, param2)
+	// and stamped from the template afterwards
+	bool position_dependent = f->param_type_2 == CPT2_MESHOPTIONS &&
+		(n.param2 & (MO_BIT_RANDOM_OFFSET | MO_BIT_RANDOM_OFFSET_Y));
+	if (!position_dependent) {
+		u32 key = geometry_template_key(n.getContent(), n.param2);
+		auto it = plantlike_templates.find(key);
+		if (it != plantlike_templates.end()) {
+			for (const PlantlikeQuad &quad : it->second) {
+				v3f vertices[4] = {quad.vertices[0], quad.vertices[1],
+					quad.vertices[2], quad.vertices[3]};
+				drawQuad(vertices, v3s16(0, 0, 0), quad.tiling);
+			}
+			return;
+		}
+		plant_template = &plantlike_templates[key];
+	}
+
 	switch (f->param_type_2) {
 	case CPT2_MESHOPTIONS:
 		draw_style = PlantlikeStyle(n.param2 & MO_MASK_STYLE);
@@ -1000,6 +1044,8 @@ void MapblockMeshGenerator::drawPlantlike()
 		drawPlantlikeQuad(271, -BS / 2, true);
 		break;
 	}
+
+	plant_template = nullptr;
 }
 
 void MapblockMeshGenerator::drawPlantlikeNode()
@@ -1286,16 +1332,29 @@ void MapblockMeshGenerator::drawNodeboxNode()
 		getTile(tile_dirs[face], &tiles[face]);
 	}
 
+	if (f->node_box.type != NODEBOX_CONNECTED) {
+		// The transformed boxes only depend on (content, param2) here,
+		// so bake them once and stamp them for every further instance
+		u32 key = geometry_template_key(n.getContent(), n.param2);
+		auto it = nodebox_templates.find(key);
+		if (it == nodebox_templates.end()) {
+			it = nodebox_templates.emplace(key,
+				std::vector<aabb3f>()).first;
+			n.getNodeBoxes(nodedef, &it->second, 0);
+		}
+		for (const auto &box : it->second)
+			drawAutoLightedCuboid(box, nullptr, tiles, 6);
+		return;
+	}
+
 	// locate possible neighboring nodes to connect to
 	int neighbors_set = 0;
-	if (f->node_box.type == NODEBOX_CONNECTED) {
-		for (int dir = 0; dir != 6; dir++) {
-			int flag = 1 << dir;
-			v3s16 p2 = blockpos_nodes + p + connection_dirs[dir];
-			MapNode n2 = data->m_vmanip.getNodeNoEx(p2);
-			if (nodedef->nodeboxConnects(n, n2, flag))
-				neighbors_set |= flag;
-		}
+	for (int dir = 0; dir != 6; dir++) {
+		int flag = 1 << dir;
+		v3s16 p2 = blockpos_nodes + p + connection_dirs[dir];
+		MapNode n2 = data->m_vmanip.getNodeNoEx(p2);
+		if (nodedef->nodeboxConnects(n, n2, flag))
+			neighbors_set |= flag;
 	}
 
 	std::vector<aabb3f> boxes;
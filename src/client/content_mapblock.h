@@ -144,6 +144,16 @@ public:
 	int face_num;
 	float plant_height;
 
+	// A single rotated/offset plantlike quad, as cached per
+	// (content, param2) so that repeated instances (e.g. crop fields)
+	// skip the trigonometry and only get position/light fixups
+	struct PlantlikeQuad {
+		v3f vertices[4];
+		float tiling;
+	};
+	// Template being recorded by drawPlantlikeQuad(), or nullptr
+	std::vector<PlantlikeQuad> *plant_template;
+
 	void drawPlantlikeQuad(float rotation, float quad_offset = 0,
 		bool offset_top_only = false);
 	void drawPlantlike();
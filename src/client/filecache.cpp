@@ -23,11 +23,121 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/networkprotocol.h"
 #include "log.h"
 #include "filesys.h"
+#include "threading/mutex_auto_lock.h"
 #include <string>
+#include <sstream>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
 
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#define PACK_INDEX_HEADER "MTMEDIAPACK 1"
+
+FileCache::~FileCache()
+{
+#ifdef _WIN32
+	if (m_map)
+		UnmapViewOfFile((LPVOID)m_map);
+	if (m_map_obj)
+		CloseHandle((HANDLE)m_map_obj);
+	if (m_map_file)
+		CloseHandle((HANDLE)m_map_file);
+#else
+	if (m_map)
+		munmap((void*)m_map, m_map_size);
+#endif
+}
+
+std::string FileCache::packPath() const
+{
+	return m_dir + DIR_DELIM + "media.pack";
+}
+
+std::string FileCache::indexPath() const
+{
+	return m_dir + DIR_DELIM + "media.idx";
+}
+
+void FileCache::mapPack()
+{
+	if (m_pack_size == 0)
+		return;
+#ifdef _WIN32
+	HANDLE file = CreateFile(packPath().c_str(), GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		CloseHandle(file);
+		return;
+	}
+	const char *map = (const char*)MapViewOfFile(mapping, FILE_MAP_READ,
+			0, 0, (SIZE_T)m_pack_size);
+	if (!map) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return;
+	}
+	m_map_file = file;
+	m_map_obj = mapping;
+#else
+	int fd = open(packPath().c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	const char *map = (const char*)mmap(NULL, m_pack_size, PROT_READ,
+			MAP_SHARED, fd, 0);
+	// The mapping stays valid after the descriptor is closed
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+#endif
+	m_map = map;
+	m_map_size = m_pack_size;
+}
+
+void FileCache::init()
+{
+	if (m_initialized)
+		return;
+	m_initialized = true;
+
+	// The pack size bounds both the valid index entries and the offset
+	// at which the next file is appended
+	long long pack_size, pack_mtime;
+	if (fs::GetFileSizeAndMTime(packPath(), &pack_size, &pack_mtime))
+		m_pack_size = (u64)pack_size;
+
+	std::ifstream is(indexPath().c_str());
+	std::string line;
+	if (is.good() && std::getline(is, line) && line == PACK_INDEX_HEADER) {
+		m_index_has_header = true;
+		while (std::getline(is, line)) {
+			std::istringstream iss(line);
+			IndexEntry entry;
+			std::string name;
+			if (!(iss >> entry.offset >> entry.size >> name) ||
+					name.empty())
+				continue;
+			// Ignore entries truncated by an interrupted append
+			if (entry.offset + entry.size > m_pack_size)
+				continue;
+			m_index[name] = entry;
+		}
+	}
+
+	mapPack();
+}
+
 bool FileCache::loadByPath(const std::string &path, std::ostream &os)
 {
 	std::ifstream fis(path.c_str(), std::ios_base::binary);
@@ -79,11 +189,81 @@ bool FileCache::updateByPath(const std::string &path, const std::string &data)
 
 bool FileCache::update(const std::string &name, const std::string &data)
 {
-	std::string path = m_dir + DIR_DELIM + name;
-	return updateByPath(path, data);
+	MutexAutoLock lock(m_mutex);
+	init();
+
+	std::ofstream pack(packPath().c_str(), std::ios_base::binary |
+			std::ios_base::app);
+	if (!pack.good()) {
+		errorstream<<"FileCache: Can't write to pack file at "
+				<<packPath()<<std::endl;
+		// Fall back to a loose file so the data is cached anyway
+		return updateByPath(m_dir + DIR_DELIM + name, data);
+	}
+	pack.write(data.c_str(), data.length());
+	pack.close();
+	if (pack.fail())
+		return false;
+
+	IndexEntry entry;
+	entry.offset = m_pack_size;
+	entry.size = data.length();
+	m_pack_size += data.length();
+
+	std::ofstream idx(indexPath().c_str(), std::ios_base::app);
+	if (!idx.good()) {
+		errorstream<<"FileCache: Can't write to pack index at "
+				<<indexPath()<<std::endl;
+		return false;
+	}
+	if (!m_index_has_header) {
+		idx << PACK_INDEX_HEADER << "\n";
+		m_index_has_header = true;
+	}
+	idx << entry.offset << ' ' << entry.size << ' ' << name << "\n";
+	idx.close();
+	if (idx.fail())
+		return false;
+
+	m_index[name] = entry;
+	return true;
 }
+
 bool FileCache::load(const std::string &name, std::ostream &os)
 {
-	std::string path = m_dir + DIR_DELIM + name;
-	return loadByPath(path, os);
+	IndexEntry entry;
+	{
+		MutexAutoLock lock(m_mutex);
+		init();
+		auto it = m_index.find(name);
+		if (it == m_index.end()) {
+			// Fall back to a file cached by an older version
+			return loadByPath(m_dir + DIR_DELIM + name, os);
+		}
+		entry = it->second;
+	}
+
+	// Zero-copy path: the file is within the mapped part of the pack
+	if (m_map && entry.offset + entry.size <= m_map_size) {
+		os.write(m_map + entry.offset, entry.size);
+		return !os.fail();
+	}
+
+	// Appended during this session, read it conventionally
+	std::ifstream fis(packPath().c_str(), std::ios_base::binary);
+	if (!fis.good()) {
+		errorstream<<"FileCache: Failed to open pack file: \""
+				<<packPath()<<"\""<<std::endl;
+		return false;
+	}
+	fis.seekg(entry.offset);
+	std::string buf(entry.size, '\0');
+	fis.read(&buf[0], entry.size);
+	if (fis.fail()) {
+		errorstream<<"FileCache: Failed to read \""<<name
+				<<"\" from pack file"<<std::endl;
+		return false;
+	}
+	os.write(buf.data(), buf.size());
+	return !os.fail();
 }
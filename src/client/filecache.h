@@ -20,9 +20,24 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include "irrlichttypes.h"
 #include <iostream>
 #include <string>
+#include <mutex>
+#include <unordered_map>
 
+/*
+	Media file cache.
+
+	Files are stored consolidated in an append-only pack file
+	("media.pack") described by a text index ("media.idx") that is
+	loaded into memory once on first use. The pack is mapped into
+	memory so cache hits are served without per-file open/read
+	syscalls. Files cached by older versions as individual files in
+	the cache directory are still found and loaded.
+
+	load() may be called concurrently from multiple threads.
+*/
 class FileCache
 {
 public:
@@ -30,13 +45,43 @@ public:
 		'dir' is the file cache directory to use.
 	*/
 	FileCache(const std::string &dir) : m_dir(dir) {}
+	~FileCache();
 
 	bool update(const std::string &name, const std::string &data);
 	bool load(const std::string &name, std::ostream &os);
 
 private:
+	struct IndexEntry
+	{
+		u64 offset;
+		u64 size;
+	};
+
 	std::string m_dir;
 
+	std::mutex m_mutex;
+	bool m_initialized = false;
+	bool m_index_has_header = false;
+	std::unordered_map<std::string, IndexEntry> m_index;
+	// Size of the pack file, i.e. the offset of the next appended file
+	u64 m_pack_size = 0;
+
+	// Read-only mapping of the pack as it existed at startup; files
+	// appended during the session are read conventionally instead
+	const char *m_map = nullptr;
+	u64 m_map_size = 0;
+#ifdef _WIN32
+	void *m_map_file = nullptr;
+	void *m_map_obj = nullptr;
+#endif
+
+	std::string packPath() const;
+	std::string indexPath() const;
+
+	// The following require m_mutex to be held
+	void init();
+	void mapPack();
+
 	bool loadByPath(const std::string &path, std::ostream &os);
 	bool updateByPath(const std::string &path, const std::string &data);
 };
@@ -651,7 +651,7 @@ struct ClientEventHandler
  * hides most of the stuff in this class (nothing in this class is required
  * by any other file) but exposes the public methods/data only.
  */
-class Game {
+class Game : public SettingsCache {
 public:
 	Game();
 	~Game();
@@ -773,8 +773,7 @@ protected:
 	void showOverlayMessage(const char *msg, float dtime, int percent,
 			bool draw_clouds = true);
 
-	static void settingChangedCallback(const std::string &setting_name, void *data);
-	void readSettings();
+	void readSettings(Settings *settings);
 
 	inline bool isKeyDown(GameKeyType k)
 	{
@@ -897,6 +896,8 @@ private:
 	f32  m_repeat_right_click_time;
 	f32  m_cache_cam_smoothing;
 	f32  m_cache_fog_start;
+	f32  m_cache_fps_max;
+	f32  m_cache_pause_fps_max;
 
 	bool m_invert_mouse = false;
 	bool m_first_loop_after_window_activation = false;
@@ -911,36 +912,12 @@ private:
 };
 
 Game::Game() :
+	SettingsCache(g_settings),
 	m_game_ui(new GameUI())
 {
-	g_settings->registerChangedCallback("doubletap_jump",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("enable_clouds",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("doubletap_joysticks",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("enable_particles",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("enable_fog",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("mouse_sensitivity",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("joystick_frustum_sensitivity",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("repeat_rightclick_time",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("noclip",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("free_move",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("cinematic",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("cinematic_camera_smoothing",
-		&settingChangedCallback, this);
-	g_settings->registerChangedCallback("camera_smoothing",
-		&settingChangedCallback, this);
-
-	readSettings();
+	// Fills the m_cache_* members; the run() loop re-reads them
+	// whenever the settings generation changes
+	poll();
 
 #ifdef __ANDROID__
 	m_cache_hold_aux1 = false;	// This is initialised properly later
@@ -974,29 +951,6 @@ Game::~Game()
 	delete draw_control;
 
 	extendedResourceCleanup();
-
-	g_settings->deregisterChangedCallback("doubletap_jump",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("enable_clouds",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("enable_particles",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("enable_fog",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("mouse_sensitivity",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("repeat_rightclick_time",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("noclip",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("free_move",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("cinematic",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("cinematic_camera_smoothing",
-		&settingChangedCallback, this);
-	g_settings->deregisterChangedCallback("camera_smoothing",
-		&settingChangedCallback, this);
 }
 
 bool Game::startup(bool *kill,
@@ -1096,6 +1050,9 @@ void Game::run()
 			previous_screen_size = current_screen_size;
 		}
 
+		// Re-read the cached settings if anything changed them
+		poll();
+
 		// Calculate dtime =
 		//    RenderingEngine::run() from this iteration
 		//  + Sleep time until the wanted FPS are reached
@@ -2889,7 +2846,6 @@ void Game::updateCamera(u32 busy_time, f32 dtime)
 				camera_direction, camera_fov, camera_offset);
 
 		if (m_camera_offset_changed) {
-			client->updateCameraOffset(camera_offset);
 			client->getEnv().updateCameraOffset(camera_offset);
 
 			if (clouds)
@@ -3200,14 +3156,14 @@ void Game::handlePointingAtNode(const PointedThing &pointed,
 	NodeMetadata *meta = map.getNodeMetadata(nodepos);
 
 	if (meta) {
-		m_game_ui->setInfoText(unescape_translate(utf8_to_wide(
+		m_game_ui->setInfoText(unescape_translate(utf8_to_wide_cached(
 			meta->getString("infotext"))));
 	} else {
 		MapNode n = map.getNode(nodepos);
 
 		if (nodedef_manager->get(n).tiledef[0].name == "unknown_node.png") {
 			m_game_ui->setInfoText(L"Unknown node: " +
-				utf8_to_wide(nodedef_manager->get(n).name));
+				utf8_to_wide_cached(nodedef_manager->get(n).name));
 		}
 	}
 
@@ -3432,13 +3388,13 @@ void Game::handlePointingAtObject(const PointedThing &pointed,
 		const ItemStack &tool_item, const v3f &player_position, bool show_debug)
 {
 	std::wstring infotext = unescape_translate(
-		utf8_to_wide(runData.selected_object->infoText()));
+		utf8_to_wide_cached(runData.selected_object->infoText()));
 
 	if (show_debug) {
 		if (!infotext.empty()) {
 			infotext += L"\n";
 		}
-		infotext += utf8_to_wide(runData.selected_object->debugInfoText());
+		infotext += utf8_to_wide_cached(runData.selected_object->debugInfoText());
 	}
 
 	m_game_ui->setInfoText(infotext);
@@ -3904,8 +3860,8 @@ inline void Game::limitFps(FpsControl *fps_timings, f32 *dtime)
 		fps_timings->busy_time = 0;
 
 	u32 frametime_min = 1000 / (g_menumgr.pausesGame()
-			? g_settings->getFloat("pause_fps_max")
-			: g_settings->getFloat("fps_max"));
+			? m_cache_pause_fps_max
+			: m_cache_fps_max);
 
 	if (fps_timings->busy_time < frametime_min) {
 		fps_timings->sleep_time = frametime_min - fps_timings->busy_time;
@@ -3939,38 +3895,36 @@ void Game::showOverlayMessage(const char *msg, float dtime, int percent, bool dr
 	delete[] wmsg;
 }
 
-void Game::settingChangedCallback(const std::string &setting_name, void *data)
-{
-	((Game *)data)->readSettings();
-}
-
-void Game::readSettings()
+void Game::readSettings(Settings *settings)
 {
-	m_cache_doubletap_jump               = g_settings->getBool("doubletap_jump");
-	m_cache_enable_clouds                = g_settings->getBool("enable_clouds");
-	m_cache_enable_joysticks             = g_settings->getBool("enable_joysticks");
-	m_cache_enable_particles             = g_settings->getBool("enable_particles");
-	m_cache_enable_fog                   = g_settings->getBool("enable_fog");
-	m_cache_mouse_sensitivity            = g_settings->getFloat("mouse_sensitivity");
-	m_cache_joystick_frustum_sensitivity = g_settings->getFloat("joystick_frustum_sensitivity");
-	m_repeat_right_click_time            = g_settings->getFloat("repeat_rightclick_time");
+	m_cache_doubletap_jump               = settings->getBool("doubletap_jump");
+	m_cache_enable_clouds                = settings->getBool("enable_clouds");
+	m_cache_enable_joysticks             = settings->getBool("enable_joysticks");
+	m_cache_enable_particles             = settings->getBool("enable_particles");
+	m_cache_enable_fog                   = settings->getBool("enable_fog");
+	m_cache_mouse_sensitivity            = settings->getFloat("mouse_sensitivity");
+	m_cache_joystick_frustum_sensitivity = settings->getFloat("joystick_frustum_sensitivity");
+	m_repeat_right_click_time            = settings->getFloat("repeat_rightclick_time");
 
-	m_cache_enable_noclip                = g_settings->getBool("noclip");
-	m_cache_enable_free_move             = g_settings->getBool("free_move");
+	m_cache_enable_noclip                = settings->getBool("noclip");
+	m_cache_enable_free_move             = settings->getBool("free_move");
 
-	m_cache_fog_start                    = g_settings->getFloat("fog_start");
+	m_cache_fog_start                    = settings->getFloat("fog_start");
 
 	m_cache_cam_smoothing = 0;
-	if (g_settings->getBool("cinematic"))
-		m_cache_cam_smoothing = 1 - g_settings->getFloat("cinematic_camera_smoothing");
+	if (settings->getBool("cinematic"))
+		m_cache_cam_smoothing = 1 - settings->getFloat("cinematic_camera_smoothing");
 	else
-		m_cache_cam_smoothing = 1 - g_settings->getFloat("camera_smoothing");
+		m_cache_cam_smoothing = 1 - settings->getFloat("camera_smoothing");
+
+	m_cache_fps_max                      = settings->getFloat("fps_max");
+	m_cache_pause_fps_max                = settings->getFloat("pause_fps_max");
 
 	m_cache_fog_start = rangelim(m_cache_fog_start, 0.0f, 0.99f);
 	m_cache_cam_smoothing = rangelim(m_cache_cam_smoothing, 0.01f, 1.0f);
 	m_cache_mouse_sensitivity = rangelim(m_cache_mouse_sensitivity, 0.001, 100.0);
 
-	m_does_lost_focus_pause_game = g_settings->getBool("pause_on_lost_focus");
+	m_does_lost_focus_pause_game = settings->getBool("pause_on_lost_focus");
 }
 
 /****************************************************************************/
@@ -155,7 +155,11 @@ void GameUI::update(const RunStats &stats, Client *client, MapDrawControl *draw_
 
 	m_guitext2->setVisible(m_flags.show_debug);
 
-	setStaticText(m_guitext_info, translate_string(m_infotext).c_str());
+	// Only re-set (and re-translate) the static texts when they changed
+	if (m_infotext != m_infotext_shown) {
+		setStaticText(m_guitext_info, translate_string(m_infotext).c_str());
+		m_infotext_shown = m_infotext;
+	}
 	m_guitext_info->setVisible(m_flags.show_hud && g_menumgr.menuCount() == 0);
 
 	static const float statustext_time_max = 1.5f;
@@ -169,7 +173,10 @@ void GameUI::update(const RunStats &stats, Client *client, MapDrawControl *draw_
 		}
 	}
 
-	setStaticText(m_guitext_status, translate_string(m_statustext).c_str());
+	if (m_statustext != m_statustext_shown) {
+		setStaticText(m_guitext_status, translate_string(m_statustext).c_str());
+		m_statustext_shown = m_statustext;
+	}
 	m_guitext_status->setVisible(!m_statustext.empty());
 
 	if (!m_statustext.empty()) {
@@ -112,9 +112,11 @@ private:
 
 	gui::IGUIStaticText *m_guitext_info = nullptr; // At the middle of the screen
 	std::wstring m_infotext;
+	std::wstring m_infotext_shown; // Last text set on m_guitext_info
 
 	gui::IGUIStaticText *m_guitext_status = nullptr;
 	std::wstring m_statustext;
+	std::wstring m_statustext_shown; // Last text set on m_guitext_status
 	float m_statustext_time = 0.0f;
 	video::SColor m_statustext_initial_color;
 
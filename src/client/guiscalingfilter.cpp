@@ -18,10 +18,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "guiscalingfilter.h"
 #include "imagefilters.h"
+#include "filesys.h"
 #include "porting.h"
 #include "settings.h"
 #include "util/numeric.h"
+#include "util/sha1.h"
+#include "util/hex.h"
 #include <cstdio>
+#include <cstring>
+#include <string>
 #include "client/renderingengine.h"
 #include "client/tile.h" // hasNPotSupport()
 
@@ -37,6 +42,47 @@ std::map<io::path, video::IImage *> g_imgCache;
  */
 std::map<io::path, video::ITexture *> g_txrCache;
 
+/* Digests of the cached source images, used to key the on-disk cache of
+ * scaled results. Computed once per source image per session.
+ */
+std::map<io::path, std::string> g_imgDigestCache;
+
+/* Scaling the source images is also persisted to disk, so the cost is
+ * paid once per texture pack instead of once per launch. The file name
+ * is derived from the source pixels and the scaling parameters, so a
+ * changed texture pack never reuses stale entries; orphaned files are
+ * simply never read again.
+ */
+static std::string getScaledCachePath(video::IImage *srcimg,
+		const io::path &origname, const char *rectstr)
+{
+	std::string digest;
+	auto it = g_imgDigestCache.find(origname);
+	if (it != g_imgDigestCache.end()) {
+		digest = it->second;
+	} else {
+		SHA1 sha1;
+		void *data = srcimg->lock();
+		sha1.addBytes((const char *)data,
+				srcimg->getPitch() * srcimg->getDimension().Height);
+		srcimg->unlock();
+		unsigned char *d = sha1.getDigest();
+		digest = hex_encode((char *)d, 20);
+		free(d);
+		g_imgDigestCache[origname] = digest;
+	}
+
+	SHA1 keyhash;
+	keyhash.addBytes(digest.c_str(), digest.size());
+	keyhash.addBytes(rectstr, strlen(rectstr));
+	unsigned char *d = keyhash.getDigest();
+	std::string key = hex_encode((char *)d, 20);
+	free(d);
+
+	return porting::path_cache + DIR_DELIM + "gui_scaled" +
+			DIR_DELIM + key + ".png";
+}
+
 /* Manually insert an image into the cache, useful to avoid texture-to-image
  * conversion whenever we can intercept it.
  */
@@ -63,6 +109,7 @@ void guiScalingCacheClear()
 			RenderingEngine::get_video_driver()->removeTexture(it.second);
 	}
 	g_txrCache.clear();
+	g_imgDigestCache.clear();
 }
 
 /* Get a cached, high-quality pre-scaled texture for display purposes.  If the
@@ -107,12 +154,32 @@ video::ITexture *guiScalingResizeCached(video::IVideoDriver *driver,
 		g_imgCache[origname] = srcimg;
 	}
 
-	// Create a new destination image and scale the source into it.
-	imageCleanTransparent(srcimg, 0);
-	video::IImage *destimg = driver->createImage(src->getColorFormat(),
-			core::dimension2d<u32>((u32)destrect.getWidth(),
-			(u32)destrect.getHeight()));
-	imageScaleNNAA(srcimg, srcrect, destimg);
+	// Try the on-disk cache of scaled results first.
+	std::string cachepath = getScaledCachePath(srcimg, origname, rectstr);
+	video::IImage *destimg = NULL;
+	if (fs::PathExists(cachepath)) {
+		destimg = driver->createImageFromFile(cachepath.c_str());
+		if (destimg && (destimg->getDimension().Width !=
+					(u32)destrect.getWidth() ||
+				destimg->getDimension().Height !=
+					(u32)destrect.getHeight())) {
+			destimg->drop();
+			destimg = NULL;
+		}
+	}
+
+	if (destimg == NULL) {
+		// Create a new destination image and scale the source into it.
+		imageCleanTransparent(srcimg, 0);
+		destimg = driver->createImage(src->getColorFormat(),
+				core::dimension2d<u32>((u32)destrect.getWidth(),
+				(u32)destrect.getHeight()));
+		imageScaleNNAA(srcimg, srcrect, destimg);
+
+		// Persist the result for future sessions
+		if (fs::CreateAllDirs(porting::path_cache + DIR_DELIM + "gui_scaled"))
+			driver->writeImageToFile(destimg, cachepath.c_str());
+	}
 
 #if ENABLE_GLES
 	// Some platforms are picky about textures being powers of 2, so expand
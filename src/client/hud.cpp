@@ -279,20 +279,54 @@ void Hud::drawItems(v2s32 upperleftpos, v2s32 screen_offset, s32 itemcount,
 }
 
 
+const std::wstring &Hud::getElementText(HudElementCache &cache, const std::string &src)
+{
+	if (!cache.has_text || cache.text_src != src) {
+		cache.text = unescape_translate(utf8_to_wide(src));
+		cache.text_src = src;
+		cache.has_text = true;
+	}
+	return cache.text;
+}
+
+const std::wstring &Hud::getElementName(HudElementCache &cache, const std::string &src)
+{
+	if (!cache.has_name || cache.name_src != src) {
+		cache.name = unescape_translate(utf8_to_wide(src));
+		cache.name_src = src;
+		cache.has_name = true;
+	}
+	return cache.name;
+}
+
+video::ITexture *Hud::getElementTexture(HudElementCache &cache, const std::string &src)
+{
+	if (!cache.has_texture || cache.texture_src != src) {
+		cache.texture = tsrc->getTexture(src);
+		cache.texture_src = src;
+		cache.has_texture = true;
+	}
+	return cache.texture;
+}
+
 void Hud::drawLuaElements(const v3s16 &camera_offset)
 {
 	u32 text_height = g_fontengine->getTextHeight();
 	irr::gui::IGUIFont* font = g_fontengine->getFont();
+	if (m_element_cache.size() < player->maxHudId())
+		m_element_cache.resize(player->maxHudId());
 	for (size_t i = 0; i != player->maxHudId(); i++) {
 		HudElement *e = player->getHud(i);
 		if (!e)
 			continue;
 
+		HudElementCache &cache = m_element_cache[i];
+
 		v2s32 pos(floor(e->pos.X * (float) m_screensize.X + 0.5),
 				floor(e->pos.Y * (float) m_screensize.Y + 0.5));
 		switch (e->type) {
 			case HUD_ELEM_IMAGE: {
-				video::ITexture *texture = tsrc->getTexture(e->text);
+				video::ITexture *texture = getElementTexture(cache, e->text);
 				if (!texture)
 					continue;
 
@@ -318,7 +352,7 @@ void Hud::drawLuaElements(const v3s16 &camera_offset)
 										 (e->number >> 8)  & 0xFF,
 										 (e->number >> 0)  & 0xFF);
 				core::rect<s32> size(0, 0, e->scale.X, text_height * e->scale.Y);
-				std::wstring text = unescape_translate(utf8_to_wide(e->text));
+				const std::wstring &text = getElementText(cache, e->text);
 				core::dimension2d<u32> textsize = font->getDimension(text.c_str());
 				v2s32 offset((e->align.X - 1.0) * (textsize.Width / 2),
 				             (e->align.Y - 1.0) * (textsize.Height / 2));
@@ -327,7 +361,8 @@ void Hud::drawLuaElements(const v3s16 &camera_offset)
 				break; }
 			case HUD_ELEM_STATBAR: {
 				v2s32 offs(e->offset.X, e->offset.Y);
-				drawStatbar(pos, HUD_CORNER_UPPER, e->dir, e->text, e->number, offs, e->size);
+				drawStatbar(pos, HUD_CORNER_UPPER, e->dir,
+					getElementTexture(cache, e->text), e->number, offs, e->size);
 				break; }
 			case HUD_ELEM_INVENTORY: {
 				InventoryList *inv = inventory->getList(e->text);
@@ -356,11 +391,12 @@ void Hud::drawLuaElements(const v3s16 &camera_offset)
 										 (e->number >> 8)  & 0xFF,
 										 (e->number >> 0)  & 0xFF);
 				core::rect<s32> size(0, 0, 200, 2 * text_height);
-				std::wstring text = unescape_translate(utf8_to_wide(e->name));
-				font->draw(text.c_str(), size + pos, color);
+				const std::wstring &name = getElementName(cache, e->name);
+				font->draw(name.c_str(), size + pos, color);
+				// The distance is dynamic, so this line is composed each frame
 				std::ostringstream os;
 				os << distance << e->text;
-				text = unescape_translate(utf8_to_wide(os.str()));
+				std::wstring text = unescape_translate(utf8_to_wide(os.str()));
 				pos.Y += text_height;
 				font->draw(text.c_str(), size + pos, color);
 				break; }
@@ -372,13 +408,12 @@ void Hud::drawLuaElements(const v3s16 &camera_offset)
 }
 
 
-void Hud::drawStatbar(v2s32 pos, u16 corner, u16 drawdir, const std::string &texture,
+void Hud::drawStatbar(v2s32 pos, u16 corner, u16 drawdir, video::ITexture *stat_texture,
 		s32 count, v2s32 offset, v2s32 size)
 {
 	const video::SColor color(255, 255, 255, 255);
 	const video::SColor colors[] = {color, color, color, color};
 
-	video::ITexture *stat_texture = tsrc->getTexture(texture);
 	if (!stat_texture)
 		return;
 
@@ -770,7 +805,7 @@ void drawItemStack(video::IVideoDriver *driver,
 	{
 		// Get the item count as a string
 		std::string text = itos(item.count);
-		v2u32 dim = font->getDimension(utf8_to_wide(text).c_str());
+		v2u32 dim = font->getDimension(utf8_to_wide_cached(text).c_str());
 		v2s32 sdim(dim.X,dim.Y);
 
 		core::rect<s32> rect2(
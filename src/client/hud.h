@@ -81,7 +81,27 @@ public:
 	void drawLuaElements(const v3s16 &camera_offset);
 
 private:
-	void drawStatbar(v2s32 pos, u16 corner, u16 drawdir, const std::string &texture,
+	// Values derived from server-sent HUD element fields, cached per
+	// element ID so the draw loop doesn't re-translate strings and
+	// re-resolve textures every frame
+	struct HudElementCache
+	{
+		bool has_text = false;
+		std::string text_src;
+		std::wstring text;
+		bool has_texture = false;
+		std::string texture_src;
+		video::ITexture *texture = nullptr;
+		bool has_name = false;
+		std::string name_src;
+		std::wstring name;
+	};
+
+	const std::wstring &getElementText(HudElementCache &cache, const std::string &src);
+	const std::wstring &getElementName(HudElementCache &cache, const std::string &src);
+	video::ITexture *getElementTexture(HudElementCache &cache, const std::string &src);
+
+	void drawStatbar(v2s32 pos, u16 corner, u16 drawdir, video::ITexture *stat_texture,
 			s32 count, v2s32 offset, v2s32 size = v2s32());
 
 	void drawItems(v2s32 upperleftpos, v2s32 screen_offset, s32 itemcount,
@@ -98,6 +118,8 @@ private:
 	s32 m_padding; // Takes hud_scaling into account, updated by resizeHotbar()
 	video::SColor hbar_colors[4];
 
+	std::vector<HudElementCache> m_element_cache;
+
 	std::vector<aabb3f> m_selection_boxes;
 	std::vector<aabb3f> m_halo_boxes;
 	v3f m_selection_pos;
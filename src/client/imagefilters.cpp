@@ -19,6 +19,42 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "imagefilters.h"
 #include "util/numeric.h"
 #include <cmath>
+#include <thread>
+#include <vector>
+
+/* Runs fn(y0, y1) over the row range [0, height), splitting the rows
+ * across threads when the image is large enough to be worth it. The
+ * callback must only write to its own rows.
+ */
+template <typename F>
+static void partition_rows(u32 height, u32 width, const F &fn)
+{
+	u32 threads = std::thread::hardware_concurrency();
+	threads = rangelim(threads, 1, 4);
+	if (threads <= 1 || (u64)width * height < 256 * 256) {
+		fn(0, height);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	u32 rows_per_thread = (height + threads - 1) / threads;
+	for (u32 t = 0; t < threads; t++) {
+		u32 y0 = t * rows_per_thread;
+		u32 y1 = MYMIN(y0 + rows_per_thread, height);
+		if (y0 >= y1)
+			break;
+		workers.emplace_back([&fn, y0, y1]() { fn(y0, y1); });
+	}
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+// Whether the image can be walked as a tight span of ARGB8 pixels
+static bool is_raw_argb8(video::IImage *img)
+{
+	return img->getColorFormat() == video::ECF_A8R8G8B8 &&
+			img->getPitch() == img->getDimension().Width * 4;
+}
 
 /* Fill in RGB values for transparent pixels, to correct for odd colors
  * appearing at borders when blending.  This is because many PNG optimizers
@@ -35,6 +71,49 @@ void imageCleanTransparent(video::IImage *src, u32 threshold)
 {
 	core::dimension2d<u32> dim = src->getDimension();
 
+	if (is_raw_argb8(src)) {
+		// Fast path over the raw pixel span, avoiding the per-pixel
+		// format conversion of getPixel/setPixel. In-place parallel
+		// processing is safe: only pixels at or below the threshold
+		// are written, and neighbor sampling ignores exactly those
+		// (their alpha never changes).
+		u32 *data = (u32 *)src->lock();
+		const u32 w = dim.Width, h = dim.Height;
+
+		partition_rows(h, w, [&](u32 y0, u32 y1) {
+			for (u32 ctry = y0; ctry < y1; ctry++)
+			for (u32 ctrx = 0; ctrx < w; ctrx++) {
+				u32 c = data[ctry * w + ctrx];
+				if ((c >> 24) > threshold)
+					continue;
+
+				u32 ss = 0, sr = 0, sg = 0, sb = 0;
+				u32 sy_max = MYMIN(ctry + 1, h - 1);
+				u32 sx_max = MYMIN(ctrx + 1, w - 1);
+				for (u32 sy = (ctry < 1) ? 0 : (ctry - 1); sy <= sy_max; sy++)
+				for (u32 sx = (ctrx < 1) ? 0 : (ctrx - 1); sx <= sx_max; sx++) {
+					u32 d = data[sy * w + sx];
+					u32 a = d >> 24;
+					if (a <= threshold)
+						continue;
+					ss += a;
+					sr += a * ((d >> 16) & 0xFF);
+					sg += a * ((d >> 8) & 0xFF);
+					sb += a * (d & 0xFF);
+				}
+
+				if (ss > 0) {
+					data[ctry * w + ctrx] = (c & 0xFF000000) |
+							((sr / ss) << 16) |
+							((sg / ss) << 8) | (sb / ss);
+				}
+			}
+		});
+
+		src->unlock();
+		return;
+	}
+
 	// Walk each pixel looking for fully transparent ones.
 	// Note: loop y around x for better cache locality.
 	for (u32 ctry = 0; ctry < dim.Height; ctry++)
@@ -97,9 +176,69 @@ void imageScaleNNAA(video::IImage *src, const core::rect<s32> &srcrect, video::I
 	double sw = srcrect.getWidth() * 1.0;
 	double sh = srcrect.getHeight() * 1.0;
 
+	core::dimension2d<u32> dim = dest->getDimension();
+
+	if (is_raw_argb8(src) && is_raw_argb8(dest)) {
+		// Fast path over raw pixel spans; destination rows are
+		// independent, so they can be partitioned across threads
+		const u32 *src_data = (const u32 *)src->lock();
+		u32 *dest_data = (u32 *)dest->lock();
+		const u32 src_w = src->getDimension().Width;
+		const u32 dest_w = dim.Width, dest_h = dim.Height;
+
+		partition_rows(dest_h, dest_w, [&](u32 y0, u32 y1) {
+			for (u32 dy = y0; dy < y1; dy++)
+			for (u32 dx = 0; dx < dest_w; dx++) {
+				double minsx = rangelim(sox + (dx * sw / dest_w), 0, sw);
+				double maxsx = rangelim(minsx + sw / dest_w, 0, sw);
+				if (minsx > maxsx)
+					SWAP(double, minsx, maxsx);
+				double minsy = rangelim(soy + (dy * sh / dest_h), 0, sh);
+				double maxsy = rangelim(minsy + sh / dest_h, 0, sh);
+				if (minsy > maxsy)
+					SWAP(double, minsy, maxsy);
+
+				double area = 0, ra = 0, ga = 0, ba = 0, aa = 0;
+				for (double sy = floor(minsy); sy < maxsy; sy++)
+				for (double sx = floor(minsx); sx < maxsx; sx++) {
+					double pw = 1;
+					if (minsx > sx)
+						pw += sx - minsx;
+					if (maxsx < (sx + 1))
+						pw += maxsx - sx - 1;
+					double ph = 1;
+					if (minsy > sy)
+						ph += sy - minsy;
+					if (maxsy < (sy + 1))
+						ph += maxsy - sy - 1;
+					double pa = pw * ph;
+
+					u32 p = src_data[(u32)sy * src_w + (u32)sx];
+					area += pa;
+					ra += pa * ((p >> 16) & 0xFF);
+					ga += pa * ((p >> 8) & 0xFF);
+					ba += pa * (p & 0xFF);
+					aa += pa * (p >> 24);
+				}
+
+				u32 p = 0;
+				if (area > 0) {
+					p = ((u32)(aa / area + 0.5) << 24) |
+						((u32)(ra / area + 0.5) << 16) |
+						((u32)(ga / area + 0.5) << 8) |
+						(u32)(ba / area + 0.5);
+				}
+				dest_data[dy * dest_w + dx] = p;
+			}
+		});
+
+		dest->unlock();
+		src->unlock();
+		return;
+	}
+
 	// Walk each destination image pixel.
 	// Note: loop y around x for better cache locality.
-	core::dimension2d<u32> dim = dest->getDimension();
 	for (dy = 0; dy < dim.Height; dy++)
 	for (dx = 0; dx < dim.Width; dx++) {
 
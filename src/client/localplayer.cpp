@@ -38,6 +38,41 @@ LocalPlayer::LocalPlayer(Client *client, const char *name):
 {
 }
 
+const LocalPlayer::CachedNode &LocalPlayer::getNodeCached(Map *map,
+	const v3s16 &p)
+{
+	for (u8 i = 0; i < m_node_cache_used; i++) {
+		if (m_node_cache[i].p == p)
+			return m_node_cache[i];
+	}
+
+	CachedNode &cn = m_node_cache[m_node_cache_used % NODE_CACHE_SIZE];
+	if (m_node_cache_used < NODE_CACHE_SIZE)
+		m_node_cache_used++;
+
+	cn.p = p;
+	cn.n = map->getNode(p, &cn.is_valid);
+	cn.f = &m_client->ndef()->get(cn.n);
+	return cn;
+}
+
+void LocalPlayer::refreshNodeCache(Map *map)
+{
+	v3s16 cell = floatToInt(m_position, BS);
+	u32 nodes_version = map->getNodesVersion();
+	u32 block_set_version = map->getBlockSetVersion();
+
+	if (cell == m_node_cache_cell &&
+			nodes_version == m_node_cache_nodes_version &&
+			block_set_version == m_node_cache_block_set_version)
+		return;
+
+	m_node_cache_used = 0;
+	m_node_cache_cell = cell;
+	m_node_cache_nodes_version = nodes_version;
+	m_node_cache_block_set_version = block_set_version;
+}
+
 static aabb3f getNodeBoundingBox(const std::vector<aabb3f> &nodeboxes)
 {
 	if (nodeboxes.empty())
@@ -179,10 +214,13 @@ void LocalPlayer::move(f32 dtime, Environment *env, f32 pos_max_d,
 	}
 
 	Map *map = &env->getMap();
-	const NodeDefManager *nodemgr = m_client->ndef();
 
 	v3f position = getPosition();
 
+	// Several of the checks below resolve the same cells; flush the node
+	// memo only when the player's cell or the map has actually changed
+	refreshNodeCache(map);
+
 	// Copy parent position if local player is attached
 	if (isAttached) {
 		setPosition(overridePosition);
@@ -211,10 +249,6 @@ void LocalPlayer::move(f32 dtime, Environment *env, f32 pos_max_d,
 		Collision detection
 	*/
 
-	bool is_valid_position;
-	MapNode node;
-	v3s16 pp;
-
 	/*
 		Check if player is in liquid (the oscillating value)
 	*/
@@ -222,22 +256,22 @@ void LocalPlayer::move(f32 dtime, Environment *env, f32 pos_max_d,
 	// If in liquid, the threshold of coming out is at higher y
 	if (in_liquid)
 	{
-		pp = floatToInt(position + v3f(0.0f, BS * 0.1f, 0.0f), BS);
-		node = map->getNode(pp, &is_valid_position);
-		if (is_valid_position) {
-			in_liquid = nodemgr->get(node.getContent()).isLiquid();
-			liquid_viscosity = nodemgr->get(node.getContent()).liquid_viscosity;
+		const CachedNode &cn = getNodeCached(map,
+			floatToInt(position + v3f(0.0f, BS * 0.1f, 0.0f), BS));
+		if (cn.is_valid) {
+			in_liquid = cn.f->isLiquid();
+			liquid_viscosity = cn.f->liquid_viscosity;
 		} else {
 			in_liquid = false;
 		}
 	} else {
 		// If not in liquid, the threshold of going in is at lower y
 
-		pp = floatToInt(position + v3f(0.0f, BS * 0.5f, 0.0f), BS);
-		node = map->getNode(pp, &is_valid_position);
-		if (is_valid_position) {
-			in_liquid = nodemgr->get(node.getContent()).isLiquid();
-			liquid_viscosity = nodemgr->get(node.getContent()).liquid_viscosity;
+		const CachedNode &cn = getNodeCached(map,
+			floatToInt(position + v3f(0.0f, BS * 0.5f, 0.0f), BS));
+		if (cn.is_valid) {
+			in_liquid = cn.f->isLiquid();
+			liquid_viscosity = cn.f->liquid_viscosity;
 		} else {
 			in_liquid = false;
 		}
@@ -247,29 +281,26 @@ void LocalPlayer::move(f32 dtime, Environment *env, f32 pos_max_d,
 	/*
 		Check if player is in liquid (the stable value)
 	*/
-	pp = floatToInt(position + v3f(0.0f), BS);
-	node = map->getNode(pp, &is_valid_position);
-	if (is_valid_position) {
-		in_liquid_stable = nodemgr->get(node.getContent()).isLiquid();
-	} else {
-		in_liquid_stable = false;
+	{
+		const CachedNode &cn = getNodeCached(map, floatToInt(position, BS));
+		in_liquid_stable = cn.is_valid && cn.f->isLiquid();
 	}
 
 	/*
 		Check if player is climbing
 	*/
 
-	pp = floatToInt(position + v3f(0.0f, 0.5f * BS, 0.0f), BS);
-	v3s16 pp2 = floatToInt(position + v3f(0.0f, -0.2f * BS, 0.0f), BS);
-	node = map->getNode(pp, &is_valid_position);
-	bool is_valid_position2;
-	MapNode node2 = map->getNode(pp2, &is_valid_position2);
+	{
+		const CachedNode &cn = getNodeCached(map,
+			floatToInt(position + v3f(0.0f, 0.5f * BS, 0.0f), BS));
+		const CachedNode &cn2 = getNodeCached(map,
+			floatToInt(position + v3f(0.0f, -0.2f * BS, 0.0f), BS));
 
-	if (!(is_valid_position && is_valid_position2)) {
-		is_climbing = false;
-	} else {
-		is_climbing = (nodemgr->get(node.getContent()).climbable ||
-			nodemgr->get(node2.getContent()).climbable) && !free_move;
+		if (!(cn.is_valid && cn2.is_valid))
+			is_climbing = false;
+		else
+			is_climbing = (cn.f->climbable || cn2.f->climbable) &&
+				!free_move;
 	}
 
 	/*
@@ -424,18 +455,16 @@ void LocalPlayer::move(f32 dtime, Environment *env, f32 pos_max_d,
 
 	{
 		camera_barely_in_ceiling = false;
-		v3s16 camera_np = floatToInt(getEyePosition(), BS);
-		MapNode n = map->getNode(camera_np);
-		if (n.getContent() != CONTENT_IGNORE) {
-			if (nodemgr->get(n).walkable && nodemgr->get(n).solidness == 2)
-				camera_barely_in_ceiling = true;
-		}
+		const CachedNode &cn = getNodeCached(map,
+			floatToInt(getEyePosition(), BS));
+		if (cn.is_valid && cn.f->walkable && cn.f->solidness == 2)
+			camera_barely_in_ceiling = true;
 	}
 
 	/*
 		Check properties of the node on which the player is standing
 	*/
-	const ContentFeatures &f = nodemgr->get(map->getNode(m_standing_node));
+	const ContentFeatures &f = *getNodeCached(map, m_standing_node).f;
 
 	// Determine if jumping is possible
 	m_disable_jump = itemgroup_get(f.groups, "disable_jump");
@@ -22,9 +22,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "player.h"
 #include "environment.h"
 #include "constants.h"
+#include "mapnode.h"
 #include "settings.h"
 #include <list>
 
+struct ContentFeatures;
 class Client;
 class Environment;
 class GenericCAO;
@@ -166,6 +168,31 @@ private:
 		const v3f &position_before_move, const v3f &speed_before_move,
 		f32 pos_max_d);
 
+	/*
+		Memoized map->getNode() + NodeDefManager lookups for the handful of
+		cells around the player that move() inspects every frame.  The memo
+		is flushed when the player's feet enter another node or the map
+		reports a node or block set change, so while standing still each
+		cell is resolved once instead of once per query per frame.
+	*/
+	struct CachedNode
+	{
+		v3s16 p;
+		MapNode n;
+		const ContentFeatures *f;
+		bool is_valid;
+	};
+
+	const CachedNode &getNodeCached(Map *map, const v3s16 &p);
+	void refreshNodeCache(Map *map);
+
+	static const u8 NODE_CACHE_SIZE = 8;
+	CachedNode m_node_cache[NODE_CACHE_SIZE];
+	u8 m_node_cache_used = 0;
+	v3s16 m_node_cache_cell = v3s16(32767, 32767, 32767);
+	u32 m_node_cache_nodes_version = 0;
+	u32 m_node_cache_block_set_version = 0;
+
 	v3f m_position;
 	v3s16 m_standing_node;
 
@@ -35,11 +35,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 	MeshMakeData
 */
 
-MeshMakeData::MeshMakeData(Client *client, bool use_shaders,
-		bool use_tangent_vertices):
+MeshMakeData::MeshMakeData(Client *client, bool use_shaders):
 	m_client(client),
-	m_use_shaders(use_shaders),
-	m_use_tangent_vertices(use_tangent_vertices)
+	m_use_shaders(use_shaders)
 {}
 
 void MeshMakeData::fillBlockDataBegin(const v3s16 &blockpos)
@@ -119,6 +117,11 @@ void MeshMakeData::setSmoothLighting(bool smooth_lighting)
 	m_smooth_lighting = smooth_lighting;
 }
 
+void MeshMakeData::setGenerateLod(bool generate_lod)
+{
+	m_generate_lod = generate_lod;
+}
+
 /*
 	Light and vertex color functions
 */
@@ -604,10 +607,24 @@ static void makeFastFace(const TileSpec &tile, u16 li0, u16 li1, u16 li2, u16 li
 		vpos += pos;
 	}
 
-	f32 abs_scale = 1.0f;
-	if      (scale.X < 0.999f || scale.X > 1.001f) abs_scale = scale.X;
-	else if (scale.Y < 0.999f || scale.Y > 1.001f) abs_scale = scale.Y;
-	else if (scale.Z < 0.999f || scale.Z > 1.001f) abs_scale = scale.Z;
+	/*
+		Map the geometric scale to texture space. The row direction of
+		the face scans always corresponds to texture U, the remaining
+		in-plane axis to V (only used by the greedy meshing path; the
+		row path leaves it at 1).
+	*/
+	f32 u_scale = 1.0f;
+	f32 v_scale = 1.0f;
+	if (dir.Y != 0) {
+		u_scale = scale.X;
+		v_scale = scale.Z;
+	} else if (dir.X != 0) {
+		u_scale = scale.Z;
+		v_scale = scale.Y;
+	} else {
+		u_scale = scale.X;
+		v_scale = scale.Y;
+	}
 
 	v3f normal(dir.X, dir.Y, dir.Z);
 
@@ -624,10 +641,10 @@ static void makeFastFace(const TileSpec &tile, u16 li0, u16 li1, u16 li2, u16 li
 			< abs(day[1] - day[3]) + abs(night[1] - night[3]);
 
 	v2f32 f[4] = {
-		core::vector2d<f32>(x0 + w * abs_scale, y0 + h),
-		core::vector2d<f32>(x0, y0 + h),
+		core::vector2d<f32>(x0 + w * u_scale, y0 + h * v_scale),
+		core::vector2d<f32>(x0, y0 + h * v_scale),
 		core::vector2d<f32>(x0, y0),
-		core::vector2d<f32>(x0 + w * abs_scale, y0) };
+		core::vector2d<f32>(x0 + w * u_scale, y0) };
 
 	// equivalent to dest.push_back(FastFace()) but faster
 	dest.emplace_back();
@@ -998,6 +1015,294 @@ static void updateAllFastFaceRows(MeshMakeData *data,
 				dest);
 }
 
+/*
+	Cell of a face slice used by the greedy meshing path
+*/
+struct SliceCell
+{
+	bool makes_face = false;
+	bool merged = false;
+	v3s16 p_corrected;
+	v3s16 face_dir_corrected;
+	u16 lights[4] = {0, 0, 0, 0};
+	TileSpec tile;
+};
+
+static bool cellsCanMerge(const SliceCell &a, const SliceCell &b,
+	const v3s16 &offset)
+{
+	return b.makes_face && !b.merged
+		&& b.p_corrected == a.p_corrected + offset
+		&& b.face_dir_corrected == a.face_dir_corrected
+		&& memcmp(b.lights, a.lights, ARRLEN(a.lights) * sizeof(u16)) == 0
+		&& b.tile.isTileable(a.tile);
+}
+
+/*
+	2D version of updateFastFaceRow ("greedy meshing"): collects the faces
+	of a whole 16x16 slice and merges them into maximal rectangles instead
+	of rows. The merge conditions are exactly the ones of the row path, so
+	lighting is never interpolated across faces that would have differed
+	without merging.
+
+	startpos: origin of the slice
+	u_dir, v_dir: unit vectors spanning the slice, u_dir is the axis the
+	              row path scans in (it maps to texture U)
+	face_dir: unit vector normal to the slice
+*/
+static void updateFastFaceSlice(
+		MeshMakeData *data,
+		const v3s16 &&startpos,
+		v3s16 u_dir, v3s16 v_dir,
+		const v3f &&u_dir_f, const v3f &&v_dir_f,
+		const v3s16 &&face_dir,
+		std::vector<FastFace> &dest)
+{
+	std::vector<SliceCell> cells(MAP_BLOCKSIZE * MAP_BLOCKSIZE);
+
+	for (s16 v = 0; v < MAP_BLOCKSIZE; v++)
+	for (s16 u = 0; u < MAP_BLOCKSIZE; u++) {
+		SliceCell &cell = cells[v * MAP_BLOCKSIZE + u];
+		v3s16 p = startpos + u_dir * u + v_dir * v;
+		getTileInfo(data, p, face_dir, cell.makes_face,
+				cell.p_corrected, cell.face_dir_corrected,
+				cell.lights, cell.tile);
+	}
+
+	for (s16 v = 0; v < MAP_BLOCKSIZE; v++)
+	for (s16 u = 0; u < MAP_BLOCKSIZE; u++) {
+		const SliceCell &first = cells[v * MAP_BLOCKSIZE + u];
+		if (!first.makes_face || first.merged)
+			continue;
+
+		// Grow in u as far as possible
+		s16 w = 1;
+		while (u + w < MAP_BLOCKSIZE && cellsCanMerge(first,
+				cells[v * MAP_BLOCKSIZE + u + w], u_dir * w))
+			w++;
+
+		// Grow in v while the whole next row can merge. World-aligned
+		// tiles take their texture coordinates from the node position
+		// of a single row, keep those limited to the row merge.
+		s16 h = 1;
+		if (!first.tile.world_aligned) {
+			bool can_grow = true;
+			while (can_grow && v + h < MAP_BLOCKSIZE) {
+				for (s16 i = 0; i < w; i++) {
+					if (!cellsCanMerge(first,
+							cells[(v + h) * MAP_BLOCKSIZE + u + i],
+							u_dir * i + v_dir * h)) {
+						can_grow = false;
+						break;
+					}
+				}
+				if (can_grow)
+					h++;
+			}
+		}
+
+		for (s16 dv = 0; dv < h; dv++)
+		for (s16 du = 0; du < w; du++)
+			cells[(v + dv) * MAP_BLOCKSIZE + u + du].merged = true;
+
+		/*
+			Create one face covering w x h tiles. Same conventions as
+			the row path: pf is the corrected position of the last
+			merged cell, sp the center of the rectangle.
+		*/
+		v3s16 p_last = first.p_corrected
+			+ u_dir * (w - 1) + v_dir * (h - 1);
+		v3f pf(p_last.X, p_last.Y, p_last.Z);
+		v3f sp = pf - ((f32)w * 0.5f - 0.5f) * u_dir_f
+			- ((f32)h * 0.5f - 0.5f) * v_dir_f;
+
+		v3f scale(1, 1, 1);
+		if (u_dir.X != 0)
+			scale.X = w;
+		if (u_dir.Z != 0)
+			scale.Z = w;
+		if (v_dir.Y != 0)
+			scale.Y = h;
+		if (v_dir.Z != 0)
+			scale.Z = h;
+
+		makeFastFace(first.tile, first.lights[0], first.lights[1],
+				first.lights[2], first.lights[3],
+				pf, sp, first.face_dir_corrected, scale, dest);
+		g_profiler->avg("Meshgen: Tiles per face [#]", w * h);
+	}
+}
+
+static void updateAllFastFaceSlices(MeshMakeData *data,
+		std::vector<FastFace> &dest)
+{
+	/*
+		Top (y+) faces: slices of x+/z+
+	*/
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+		updateFastFaceSlice(data,
+				v3s16(0, y, 0),
+				v3s16(1, 0, 0), v3s16(0, 0, 1),
+				v3f  (1, 0, 0), v3f  (0, 0, 1),
+				v3s16(0, 1, 0), //face dir
+				dest);
+
+	/*
+		Right (x+) faces: slices of z+/y+
+	*/
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+		updateFastFaceSlice(data,
+				v3s16(x, 0, 0),
+				v3s16(0, 0, 1), v3s16(0, 1, 0),
+				v3f  (0, 0, 1), v3f  (0, 1, 0),
+				v3s16(1, 0, 0), //face dir
+				dest);
+
+	/*
+		Back (z+) faces: slices of x+/y+
+	*/
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		updateFastFaceSlice(data,
+				v3s16(0, 0, z),
+				v3s16(1, 0, 0), v3s16(0, 1, 0),
+				v3f  (1, 0, 0), v3f  (0, 1, 0),
+				v3s16(0, 0, 1), //face dir
+				dest);
+}
+
+/*
+	Far-distance LOD tier
+
+	The block content is downsampled to cells of 2x2x2 nodes; each cell is
+	represented by its most solid node. Faces are generated between adjacent
+	cells with the same rules as between nodes (face_contents), as quads
+	covering the whole 2x2-node cell boundary. Lighting is always flat since
+	the mesh is only drawn at distances where smooth lighting cannot be
+	resolved anyway.
+*/
+
+static const s16 LOD_CELL_SIZE = 2;
+
+// Returns the most solid node of the cell and its position in p_rep
+static MapNode getLodCellNode(MeshMakeData *data, const v3s16 &cell,
+		v3s16 *p_rep)
+{
+	VoxelManipulator &vmanip = data->m_vmanip;
+	const NodeDefManager *ndef = data->m_client->ndef();
+	v3s16 blockpos_nodes = data->m_blockpos * MAP_BLOCKSIZE;
+	v3s16 base = cell * LOD_CELL_SIZE;
+
+	MapNode best(CONTENT_IGNORE);
+	v3s16 best_p = base;
+	int best_rank = -1;
+
+	v3s16 dp;
+	for (dp.Y = 0; dp.Y < LOD_CELL_SIZE; dp.Y++)
+	for (dp.Z = 0; dp.Z < LOD_CELL_SIZE; dp.Z++)
+	for (dp.X = 0; dp.X < LOD_CELL_SIZE; dp.X++) {
+		v3s16 p = base + dp;
+		const MapNode &n = vmanip.getNodeRefUnsafeCheckFlags(
+				blockpos_nodes + p);
+		content_t c = n.getContent();
+		if (c == CONTENT_IGNORE)
+			continue;
+		// Prefer solid over liquid over non-solid over air, so that a
+		// cell containing any terrain keeps the terrain surface closed
+		int rank = 0;
+		if (c != CONTENT_AIR)
+			rank = 1 + ndef->get(n).solidness;
+		if (rank > best_rank) {
+			best_rank = rank;
+			best = n;
+			best_p = p;
+		}
+	}
+
+	*p_rep = best_p;
+	return best;
+}
+
+static void updateAllLodFaces(MeshMakeData *data, std::vector<FastFace> &dest)
+{
+	const NodeDefManager *ndef = data->m_client->ndef();
+	static const v3s16 face_dirs[3] = {
+		v3s16(0, 1, 0),
+		v3s16(1, 0, 0),
+		v3s16(0, 0, 1),
+	};
+	const s16 cells = MAP_BLOCKSIZE / LOD_CELL_SIZE;
+
+	for (const v3s16 &face_dir : face_dirs) {
+		v3s16 c;
+		// Like the full-detail path this includes the faces at the
+		// trailing edges of the block; the leading edges belong to the
+		// neighbor blocks' meshes.
+		for (c.Y = 0; c.Y < cells; c.Y++)
+		for (c.Z = 0; c.Z < cells; c.Z++)
+		for (c.X = 0; c.X < cells; c.X++) {
+			v3s16 p0, p1;
+			MapNode n0 = getLodCellNode(data, c, &p0);
+			if (n0.getContent() == CONTENT_IGNORE)
+				continue;
+			MapNode n1 = getLodCellNode(data, c + face_dir, &p1);
+			if (n1.getContent() == CONTENT_IGNORE)
+				continue;
+
+			bool equivalent = false;
+			u8 mf = face_contents(n0.getContent(), n1.getContent(),
+					&equivalent, ndef);
+			if (mf == 0)
+				continue;
+
+			MapNode n = n0;
+			v3s16 p_corrected = p0;
+			v3s16 face_dir_corrected = face_dir;
+			v3s16 cell_owner = c;
+			if (mf == 2) {
+				n = n1;
+				p_corrected = p1;
+				face_dir_corrected = -face_dir;
+				cell_owner = c + face_dir;
+			}
+
+			TileSpec tile;
+			getNodeTile(n, p_corrected, face_dir_corrected, data, tile);
+			tile.emissive_light = ndef->get(n).light_source;
+			if (equivalent) {
+				for (TileLayer &layer : tile.layers)
+					layer.material_flags |=
+							MATERIAL_FLAG_BACKFACE_CULLING;
+			}
+
+			u16 light = getFaceLight(n0, n1, face_dir, ndef);
+
+			// Center of the owning cell in node coordinates, moved to
+			// the node layer bordering the face (makeFastFace offsets
+			// the quad by another half node along the face direction)
+			v3f fdf(face_dir.X, face_dir.Y, face_dir.Z);
+			v3f sp = v3f(cell_owner.X, cell_owner.Y, cell_owner.Z)
+					* LOD_CELL_SIZE
+					+ v3f(0.5f * (LOD_CELL_SIZE - 1));
+			if (mf == 1)
+				sp += fdf * 0.5f * (LOD_CELL_SIZE - 1);
+			else
+				sp -= fdf * 0.5f * (LOD_CELL_SIZE - 1);
+
+			v3f scale(LOD_CELL_SIZE, LOD_CELL_SIZE, LOD_CELL_SIZE);
+			if (face_dir.X != 0)
+				scale.X = 1;
+			if (face_dir.Y != 0)
+				scale.Y = 1;
+			if (face_dir.Z != 0)
+				scale.Z = 1;
+
+			makeFastFace(tile, light, light, light, light,
+					v3f(p_corrected.X, p_corrected.Y, p_corrected.Z),
+					sp, face_dir_corrected, scale, dest);
+		}
+	}
+}
+
 static void applyTileColor(PreMeshBuffer &pmb)
 {
 	video::SColor tc = pmb.layer.color;
@@ -1016,7 +1321,7 @@ static void applyTileColor(PreMeshBuffer &pmb)
 	MapBlockMesh
 */
 
-MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
+MapBlockMesh::MapBlockMesh(MeshMakeData *data):
 	m_minimap_mapblock(NULL),
 	m_tsrc(data->m_client->getTextureSource()),
 	m_shdrsrc(data->m_client->getShaderSource()),
@@ -1026,8 +1331,9 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 {
 	for (auto &m : m_mesh)
 		m = new scene::SMesh();
+	for (auto &m : m_lod_mesh)
+		m = nullptr;
 	m_enable_shaders = data->m_use_shaders;
-	m_use_tangent_vertices = data->m_use_tangent_vertices;
 	m_enable_vbo = g_settings->getBool("enable_vbo");
 
 	if (g_settings->getBool("enable_minimap")) {
@@ -1053,7 +1359,10 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 	{
 		// 4-23ms for MAP_BLOCKSIZE=16  (NOTE: probably outdated)
 		//TimeTaker timer2("updateAllFastFaceRows()");
-		updateAllFastFaceRows(data, fastfaces_new);
+		if (g_settings->getBool("greedy_meshing"))
+			updateAllFastFaceSlices(data, fastfaces_new);
+		else
+			updateAllFastFaceRows(data, fastfaces_new);
 	}
 	// End of slow part
 
@@ -1061,7 +1370,7 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 		Convert FastFaces to MeshCollector
 	*/
 
-	MeshCollector collector;
+	MeshCollector collector(data->m_collector_estimate);
 
 	{
 		// avg 0ms (100ms spikes when loading textures the first time)
@@ -1090,6 +1399,8 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 		generator.generate();
 	}
 
+	m_collector_estimate = collector.getEstimate();
+
 	/*
 		Convert MeshCollector to SMesh
 	*/
@@ -1121,7 +1432,17 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 						&p.layer.texture_id);
 			}
 			// - Texture animation
-			if (p.layer.material_flags & MATERIAL_FLAG_ANIMATION) {
+			// With shaders, vertically stacked frames are selected in
+			// the shader from the frame strip bound as base texture, so
+			// no CPU work per frame is needed (see the material setup
+			// below and MainShaderConstantSetter). Cracked tiles keep
+			// the CPU path since the crack modifier applies per frame.
+			bool shader_animation = m_enable_shaders &&
+				(p.layer.material_flags &
+					MATERIAL_FLAG_ANIMATION_VERTICAL_FRAMES) &&
+				!(p.layer.material_flags & MATERIAL_FLAG_CRACK);
+			if ((p.layer.material_flags & MATERIAL_FLAG_ANIMATION) &&
+					!shader_animation) {
 				// Add to MapBlockMesh in order to animate these tiles
 				m_animation_tiles[std::pair<u8, u32>(layer, i)] = p.layer;
 				m_animation_frames[std::pair<u8, u32>(layer, i)] = 0;
@@ -1152,7 +1473,8 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 					if (vc->getAlpha() == 0) // No sunlight - no need to animate
 						final_color_blend(vc, copy, sunlight); // Finalize color
 					else // Record color to animate
-						m_daynight_diffs[std::pair<u8, u32>(layer, i)][j] = copy;
+						m_daynight_diffs[std::pair<u8, u32>(layer, i)]
+								.emplace_back(j, copy);
 
 					// The sunlight ratio has been stored,
 					// delete alpha (for the final rendering).
@@ -1179,45 +1501,29 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 				p.layer.applyMaterialOptions(material);
 			}
 
+			if (shader_animation) {
+				// Stash the animation parameters in the (otherwise
+				// unused) texture matrix; MainShaderConstantSetter
+				// passes them to the shader as animationParams
+				core::matrix4 &tm = material.getTextureMatrix(0);
+				tm[0] = p.layer.animation_frame_count;
+				tm[1] = p.layer.animation_frame_length_ms;
+			}
+
 			scene::SMesh *mesh = (scene::SMesh *)m_mesh[layer];
 
 			// Create meshbuffer, add to mesh
-			if (m_use_tangent_vertices) {
-				scene::SMeshBufferTangents *buf =
-						new scene::SMeshBufferTangents();
-				buf->Material = material;
-				buf->Vertices.reallocate(p.vertices.size());
-				buf->Indices.reallocate(p.indices.size());
-				for (const video::S3DVertex &v: p.vertices)
-					buf->Vertices.push_back(video::S3DVertexTangents(v.Pos, v.Color, v.TCoords));
-				for (u16 i: p.indices)
-					buf->Indices.push_back(i);
-				buf->recalculateBoundingBox();
-				mesh->addMeshBuffer(buf);
-				buf->drop();
-			} else {
-				scene::SMeshBuffer *buf = new scene::SMeshBuffer();
-				buf->Material = material;
-				buf->append(&p.vertices[0], p.vertices.size(),
-					&p.indices[0], p.indices.size());
-				mesh->addMeshBuffer(buf);
-				buf->drop();
-			}
+			scene::SMeshBuffer *buf = new scene::SMeshBuffer();
+			buf->Material = material;
+			buf->append(&p.vertices[0], p.vertices.size(),
+				&p.indices[0], p.indices.size());
+			mesh->addMeshBuffer(buf);
+			buf->drop();
 		}
 
 		/*
 			Do some stuff to the mesh
 		*/
-		m_camera_offset = camera_offset;
-		translateMesh(m_mesh[layer],
-			intToFloat(data->m_blockpos * MAP_BLOCKSIZE - camera_offset, BS));
-
-		if (m_use_tangent_vertices) {
-			scene::IMeshManipulator* meshmanip =
-				RenderingEngine::get_scene_manager()->getMeshManipulator();
-			meshmanip->recalculateTangents(m_mesh[layer], true, false, false);
-		}
-
 		if (m_mesh[layer]) {
 #if 0
 			// Usually 1-700 faces and 1-7 materials
@@ -1234,11 +1540,100 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 
 	//std::cout<<"added "<<fastfaces.getSize()<<" faces."<<std::endl;
 
+	/*
+		Build the far-distance LOD tier
+	*/
+	if (data->m_generate_lod)
+		generateLodMesh(data);
+
 	// Check if animation is required for this mesh
 	m_has_animation =
 		!m_crack_materials.empty() ||
 		!m_daynight_diffs.empty() ||
-		!m_animation_tiles.empty();
+		!m_animation_tiles.empty() ||
+		!m_lod_daynight_diffs.empty();
+}
+
+void MapBlockMesh::generateLodMesh(MeshMakeData *data)
+{
+	std::vector<FastFace> lod_faces;
+	updateAllLodFaces(data, lod_faces);
+
+	MeshCollector collector;
+	for (const FastFace &f : lod_faces) {
+		static const u16 indices[] = {0, 1, 2, 2, 3, 0};
+		static const u16 indices_alternate[] = {0, 1, 3, 2, 3, 1};
+		const u16 *indices_p =
+			f.vertex_0_2_connected ? indices : indices_alternate;
+		collector.append(f.tile, f.vertices, 4, indices_p, 6);
+	}
+
+	for (int layer = 0; layer < MAX_TILE_LAYERS; layer++) {
+		scene::SMesh *mesh = new scene::SMesh();
+		m_lod_mesh[layer] = mesh;
+
+		for (u32 i = 0; i < collector.prebuffers[layer].size(); i++) {
+			PreMeshBuffer &p = collector.prebuffers[layer][i];
+
+			applyTileColor(p);
+
+			// The LOD mesh is never animated; animated tiles show
+			// their first frame, cracks are not drawn at all
+			if (p.layer.material_flags & MATERIAL_FLAG_ANIMATION)
+				p.layer.texture = (*p.layer.frames)[0].texture;
+
+			if (!m_enable_shaders) {
+				// Extract colors for day-night animation
+				// Dummy sunlight to handle non-sunlit areas
+				video::SColorf sunlight;
+				get_sunlight_color(&sunlight, 0);
+				u32 vertex_count = p.vertices.size();
+				for (u32 j = 0; j < vertex_count; j++) {
+					video::SColor *vc = &p.vertices[j].Color;
+					video::SColor copy = *vc;
+					if (vc->getAlpha() == 0) // No sunlight - no need to animate
+						final_color_blend(vc, copy, sunlight); // Finalize color
+					else // Record color to animate
+						m_lod_daynight_diffs[std::pair<u8, u32>(layer, i)]
+								.emplace_back(j, copy);
+
+					// The sunlight ratio has been stored,
+					// delete alpha (for the final rendering).
+					vc->setAlpha(255);
+				}
+			}
+
+			// Create material
+			video::SMaterial material;
+			material.setFlag(video::EMF_LIGHTING, false);
+			material.setFlag(video::EMF_BACK_FACE_CULLING, true);
+			material.setFlag(video::EMF_BILINEAR_FILTER, false);
+			material.setFlag(video::EMF_FOG_ENABLE, true);
+			material.setTexture(0, p.layer.texture);
+
+			if (m_enable_shaders) {
+				material.MaterialType = m_shdrsrc->getShaderInfo(
+						p.layer.shader_id).material;
+				p.layer.applyMaterialOptionsWithShaders(material);
+				if (p.layer.normal_texture)
+					material.setTexture(1, p.layer.normal_texture);
+				material.setTexture(2, p.layer.flags_texture);
+			} else {
+				p.layer.applyMaterialOptions(material);
+			}
+
+			// Create meshbuffer, add to mesh
+			scene::SMeshBuffer *buf = new scene::SMeshBuffer();
+			buf->Material = material;
+			buf->append(&p.vertices[0], p.vertices.size(),
+				&p.indices[0], p.indices.size());
+			mesh->addMeshBuffer(buf);
+			buf->drop();
+		}
+
+		if (m_enable_vbo)
+			m_lod_mesh[layer]->setHardwareMappingHint(scene::EHM_STATIC);
+	}
 }
 
 MapBlockMesh::~MapBlockMesh()
@@ -1252,6 +1647,17 @@ MapBlockMesh::~MapBlockMesh()
 		m->drop();
 		m = NULL;
 	}
+	for (scene::IMesh *m : m_lod_mesh) {
+		if (!m)
+			continue;
+		if (m_enable_vbo)
+			for (u32 i = 0; i < m->getMeshBufferCount(); i++) {
+				scene::IMeshBuffer *buf = m->getMeshBuffer(i);
+				RenderingEngine::get_video_driver()->removeHardwareBuffer(buf);
+			}
+		m->drop();
+		m = NULL;
+	}
 	delete m_minimap_mapblock;
 }
 
@@ -1324,9 +1730,13 @@ bool MapBlockMesh::animate(bool faraway, float time, int crack,
 	// Day-night transition
 	if (!m_enable_shaders && (daynight_ratio != m_last_daynight_ratio)) {
 		// Force reload mesh to VBO
-		if (m_enable_vbo)
+		if (m_enable_vbo) {
 			for (scene::IMesh *m : m_mesh)
 				m->setDirty();
+			for (scene::IMesh *m : m_lod_mesh)
+				if (m)
+					m->setDirty();
+		}
 		video::SColorf day_color;
 		get_sunlight_color(&day_color, daynight_ratio);
 
@@ -1338,25 +1748,20 @@ bool MapBlockMesh::animate(bool faraway, float time, int crack,
 				final_color_blend(&(vertices[j.first].Color), j.second,
 						day_color);
 		}
+		for (auto &daynight_diff : m_lod_daynight_diffs) {
+			scene::IMeshBuffer *buf = m_lod_mesh[daynight_diff.first.first]->
+				getMeshBuffer(daynight_diff.first.second);
+			video::S3DVertex *vertices = (video::S3DVertex *)buf->getVertices();
+			for (const auto &j : daynight_diff.second)
+				final_color_blend(&(vertices[j.first].Color), j.second,
+						day_color);
+		}
 		m_last_daynight_ratio = daynight_ratio;
 	}
 
 	return true;
 }
 
-void MapBlockMesh::updateCameraOffset(v3s16 camera_offset)
-{
-	if (camera_offset != m_camera_offset) {
-		for (scene::IMesh *layer : m_mesh) {
-			translateMesh(layer,
-				intToFloat(m_camera_offset - camera_offset, BS));
-			if (m_enable_vbo)
-				layer->setDirty();
-		}
-		m_camera_offset = camera_offset;
-	}
-}
-
 video::SColor encode_light(u16 light, u8 emissive_light)
 {
 	// Get components
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irrlichttypes_extrabloated.h"
 #include "client/tile.h"
+#include "client/meshgen/collector.h"
 #include "voxel.h"
 #include <array>
 #include <map>
@@ -42,13 +43,14 @@ struct MeshMakeData
 	v3s16 m_blockpos = v3s16(-1337,-1337,-1337);
 	v3s16 m_crack_pos_relative = v3s16(-1337,-1337,-1337);
 	bool m_smooth_lighting = false;
+	bool m_generate_lod = false;
+	// Collector sizes of the previous mesh of this block, if any
+	MeshCollectorEstimate m_collector_estimate;
 
 	Client *m_client;
 	bool m_use_shaders;
-	bool m_use_tangent_vertices;
 
-	MeshMakeData(Client *client, bool use_shaders,
-			bool use_tangent_vertices = false);
+	MeshMakeData(Client *client, bool use_shaders);
 
 	/*
 		Copy block data manually (to allow optimizations by the caller)
@@ -76,11 +78,20 @@ struct MeshMakeData
 		Enable or disable smooth lighting
 	*/
 	void setSmoothLighting(bool smooth_lighting);
+
+	/*
+		Enable or disable generation of the far-distance LOD mesh
+	*/
+	void setGenerateLod(bool generate_lod);
 };
 
 /*
 	Holds a mesh for a mapblock.
 
+	The vertices are in block-local coordinates; the renderer applies
+	the block's world translation per draw, which also allows one mesh
+	to be shared between geometrically identical blocks.
+
 	Besides the SMesh*, this contains information used for animating
 	the vertex positions, colors and texture coordinates of the mesh.
 	For example:
@@ -93,7 +104,7 @@ class MapBlockMesh
 {
 public:
 	// Builds the mesh given
-	MapBlockMesh(MeshMakeData *data, v3s16 camera_offset);
+	MapBlockMesh(MeshMakeData *data);
 	~MapBlockMesh();
 
 	// Main animation function, parameters:
@@ -114,6 +125,12 @@ public:
 		return m_mesh[layer];
 	}
 
+	// Simplified far-distance mesh, or nullptr if none was generated
+	scene::IMesh *getLodMesh(u8 layer)
+	{
+		return m_lod_mesh[layer];
+	}
+
 	MinimapMapblock *moveMinimapMapblock()
 	{
 		MinimapMapblock *p = m_minimap_mapblock;
@@ -132,16 +149,27 @@ public:
 			m_animation_force_timer--;
 	}
 
-	void updateCameraOffset(v3s16 camera_offset);
+	const MeshCollectorEstimate &getCollectorEstimate() const
+	{
+		return m_collector_estimate;
+	}
 
 private:
+	// Builds m_lod_mesh from downsampled block content
+	void generateLodMesh(MeshMakeData *data);
+
 	scene::IMesh *m_mesh[MAX_TILE_LAYERS];
+	// Simplified meshes built from 2x2x2-node cells, drawn instead of
+	// m_mesh beyond lod_mesh_distance (nullptr if LOD is disabled)
+	scene::IMesh *m_lod_mesh[MAX_TILE_LAYERS];
 	MinimapMapblock *m_minimap_mapblock;
+	// Collector sizes of this mesh, kept as an estimate for the next
+	// rebuild of the same block
+	MeshCollectorEstimate m_collector_estimate;
 	ITextureSource *m_tsrc;
 	IShaderSource *m_shdrsrc;
 
 	bool m_enable_shaders;
-	bool m_use_tangent_vertices;
 	bool m_enable_vbo;
 
 	// Must animate() be called before rendering?
@@ -164,13 +192,16 @@ private:
 	// Animation info: day/night transitions
 	// Last daynight_ratio value passed to animate()
 	u32 m_last_daynight_ratio;
-	// For each mesh and mesh buffer, stores pre-baked colors
-	// of sunlit vertices
+	// For each mesh and mesh buffer, stores the (vertex index, pre-baked
+	// color) pairs of sunlit vertices, sorted by vertex index
 	// Keys are pairs of (mesh index, buffer index in the mesh)
-	std::map<std::pair<u8, u32>, std::map<u32, video::SColor > > m_daynight_diffs;
-
-	// Camera offset info -> do we have to translate the mesh?
-	v3s16 m_camera_offset;
+	// Only used without shaders; the shader path blends in GLSL from
+	// the dayLight uniform
+	std::map<std::pair<u8, u32>, std::vector<std::pair<u32, video::SColor>>>
+			m_daynight_diffs;
+	// Same, for the buffers of m_lod_mesh
+	std::map<std::pair<u8, u32>, std::vector<std::pair<u32, video::SColor>>>
+			m_lod_daynight_diffs;
 };
 
 /*!
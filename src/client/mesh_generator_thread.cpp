@@ -23,15 +23,28 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client.h"
 #include "mapblock.h"
 #include "map.h"
+#include "minimap.h"
+#include "util/memstats.h"
 
 /*
 	CachedMapBlockData
 */
 
+static MemoryPool *getMeshCachePool()
+{
+	static MemoryPool *pool = g_memstats->registerPool("meshgen_block_cache");
+	return pool;
+}
+
+static const u64 cached_block_bytes =
+		sizeof(MapNode) * MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+
 CachedMapBlockData::~CachedMapBlockData()
 {
 	assert(refcount_from_queue == 0);
 
+	if (data)
+		getMeshCachePool()->sub(cached_block_bytes);
 	delete[] data;
 }
 
@@ -52,10 +65,8 @@ MeshUpdateQueue::MeshUpdateQueue(Client *client):
 	m_client(client)
 {
 	m_cache_enable_shaders = g_settings->getBool("enable_shaders");
-	m_cache_use_tangent_vertices = m_cache_enable_shaders && (
-		g_settings->getBool("enable_bumpmapping") ||
-		g_settings->getBool("enable_parallax_occlusion"));
 	m_cache_smooth_lighting = g_settings->getBool("smooth_lighting");
+	m_cache_lod_mesh = g_settings->getS16("lod_mesh_distance") > 0;
 	m_meshgen_block_cache_size = g_settings->getS32("meshgen_block_cache_size");
 }
 
@@ -76,6 +87,12 @@ void MeshUpdateQueue::addBlock(Map *map, v3s16 p, bool ack_block_to_server, bool
 {
 	MutexAutoLock lock(m_mutex);
 
+	// Refresh the camera position for nearest-first dequeue. This runs
+	// on the main thread, where accessing the player is safe.
+	if (LocalPlayer *player = m_client->getEnv().getLocalPlayer())
+		m_camera_block_pos = getNodeBlockPos(
+				floatToInt(player->getPosition(), BS));
+
 	cleanupCache();
 
 	/*
@@ -140,23 +157,56 @@ void MeshUpdateQueue::addBlock(Map *map, v3s16 p, bool ack_block_to_server, bool
 }
 
 // Returned pointer must be deleted
-// Returns NULL if queue is empty
+// Returns NULL if queue is empty or everything eligible is in flight
 QueuedMeshUpdate *MeshUpdateQueue::pop()
 {
 	MutexAutoLock lock(m_mutex);
 
-	bool must_be_urgent = !m_urgents.empty();
-	for (std::vector<QueuedMeshUpdate*>::iterator i = m_queue.begin();
-			i != m_queue.end(); ++i) {
-		QueuedMeshUpdate *q = *i;
-		if(must_be_urgent && m_urgents.count(q->p) == 0)
-			continue;
-		m_queue.erase(i);
-		m_urgents.erase(q->p);
-		fillDataFromMapBlockCache(q);
-		return q;
+	// Pick the eligible update closest to the camera; urgent ones are
+	// preferred, but don't idle on non-urgent work while all urgents
+	// are being meshed by other workers.
+	std::vector<QueuedMeshUpdate *>::iterator chosen = m_queue.end();
+	for (int pass = !m_urgents.empty() ? 0 : 1; pass < 2; pass++) {
+		s32 chosen_distance = 0;
+		for (std::vector<QueuedMeshUpdate*>::iterator i = m_queue.begin();
+				i != m_queue.end(); ++i) {
+			QueuedMeshUpdate *q = *i;
+			if (pass == 0 && m_urgents.count(q->p) == 0)
+				continue;
+			if (m_inflight.count(q->p) != 0)
+				continue;
+			v3s16 d = q->p - m_camera_block_pos;
+			s32 distance = d.X * d.X + d.Y * d.Y + d.Z * d.Z;
+			if (chosen == m_queue.end() || distance < chosen_distance) {
+				chosen = i;
+				chosen_distance = distance;
+			}
+		}
+		if (chosen != m_queue.end())
+			break;
 	}
-	return NULL;
+	if (chosen == m_queue.end())
+		return NULL;
+
+	QueuedMeshUpdate *q = *chosen;
+	m_queue.erase(chosen);
+	m_urgents.erase(q->p);
+	m_inflight.insert(q->p);
+	fillDataFromMapBlockCache(q);
+	return q;
+}
+
+void MeshUpdateQueue::done(v3s16 p)
+{
+	MutexAutoLock lock(m_mutex);
+	m_inflight.erase(p);
+}
+
+void MeshUpdateQueue::setCollectorEstimate(v3s16 p,
+		const MeshCollectorEstimate &estimate)
+{
+	MutexAutoLock lock(m_mutex);
+	m_collector_estimates[p] = estimate;
 }
 
 CachedMapBlockData* MeshUpdateQueue::cacheBlock(Map *map, v3s16 p, UpdateMode mode,
@@ -184,12 +234,16 @@ CachedMapBlockData* MeshUpdateQueue::cacheBlock(Map *map, v3s16 p, UpdateMode mo
 
 	MapBlock *b = map->getBlockNoCreateNoEx(p);
 	if (b) {
-		if (!cached_block->data)
+		if (!cached_block->data) {
 			cached_block->data =
 					new MapNode[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+			getMeshCachePool()->add(cached_block_bytes);
+		}
 		memcpy(cached_block->data, b->getData(),
 				MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE * sizeof(MapNode));
 	} else {
+		if (cached_block->data)
+			getMeshCachePool()->sub(cached_block_bytes);
 		delete[] cached_block->data;
 		cached_block->data = nullptr;
 	}
@@ -207,8 +261,7 @@ CachedMapBlockData* MeshUpdateQueue::getCachedBlock(const v3s16 &p)
 
 void MeshUpdateQueue::fillDataFromMapBlockCache(QueuedMeshUpdate *q)
 {
-	MeshMakeData *data = new MeshMakeData(m_client, m_cache_enable_shaders,
-			m_cache_use_tangent_vertices);
+	MeshMakeData *data = new MeshMakeData(m_client, m_cache_enable_shaders);
 	q->data = data;
 
 	data->fillBlockDataBegin(q->p);
@@ -232,6 +285,12 @@ void MeshUpdateQueue::fillDataFromMapBlockCache(QueuedMeshUpdate *q)
 
 	data->setCrack(q->crack_level, q->crack_pos);
 	data->setSmoothLighting(m_cache_smooth_lighting);
+	data->setGenerateLod(m_cache_lod_mesh);
+
+	std::map<v3s16, MeshCollectorEstimate>::iterator it =
+			m_collector_estimates.find(q->p);
+	if (it != m_collector_estimates.end())
+		data->m_collector_estimate = it->second;
 }
 
 void MeshUpdateQueue::cleanupCache()
@@ -255,6 +314,7 @@ void MeshUpdateQueue::cleanupCache()
 		CachedMapBlockData *cached_block = it->second;
 		if (cached_block->refcount_from_queue == 0 &&
 				cached_block->last_used_timestamp < t_now - cache_seconds) {
+			m_collector_estimates.erase(it->first);
 			m_cache.erase(it++);
 			delete cached_block;
 		} else {
@@ -263,6 +323,22 @@ void MeshUpdateQueue::cleanupCache()
 	}
 }
 
+/*
+	MeshUpdateWorkerThread
+*/
+
+MeshUpdateWorkerThread::MeshUpdateWorkerThread(MeshUpdateThread *manager,
+		int id):
+	UpdateThread("Mesh" + itos(id)),
+	m_manager(manager)
+{
+}
+
+void MeshUpdateWorkerThread::doUpdate()
+{
+	m_manager->processQueue();
+}
+
 /*
 	MeshUpdateThread
 */
@@ -273,6 +349,43 @@ MeshUpdateThread::MeshUpdateThread(Client *client):
 {
 	m_generation_interval = g_settings->getU16("mesh_generation_interval");
 	m_generation_interval = rangelim(m_generation_interval, 0, 50);
+
+	m_mesh_dedup_enabled = g_settings->getBool("enable_mesh_dedup");
+
+	// This thread is the first worker of the pool
+	int thread_count = g_settings->getU16("mesh_generation_threads");
+	thread_count = rangelim(thread_count, 1, 8);
+	for (int i = 1; i < thread_count; i++)
+		m_workers.push_back(new MeshUpdateWorkerThread(this, i));
+}
+
+MeshUpdateThread::~MeshUpdateThread()
+{
+	for (MeshUpdateWorkerThread *worker : m_workers)
+		delete worker;
+}
+
+bool MeshUpdateThread::start()
+{
+	bool ok = UpdateThread::start();
+	for (MeshUpdateWorkerThread *worker : m_workers)
+		worker->start();
+	return ok;
+}
+
+void MeshUpdateThread::stop()
+{
+	UpdateThread::stop();
+	for (MeshUpdateWorkerThread *worker : m_workers)
+		worker->stop();
+}
+
+bool MeshUpdateThread::wait()
+{
+	bool ok = UpdateThread::wait();
+	for (MeshUpdateWorkerThread *worker : m_workers)
+		worker->wait();
+	return ok;
 }
 
 void MeshUpdateThread::updateBlock(Map *map, v3s16 p, bool ack_block_to_server,
@@ -281,9 +394,21 @@ void MeshUpdateThread::updateBlock(Map *map, v3s16 p, bool ack_block_to_server,
 	// Allow the MeshUpdateQueue to do whatever it wants
 	m_queue_in.addBlock(map, p, ack_block_to_server, urgent);
 	deferUpdate();
+	for (MeshUpdateWorkerThread *worker : m_workers)
+		worker->deferUpdate();
 }
 
-void MeshUpdateThread::doUpdate()
+// Hashes everything the mesh generator can see: the block's own nodes
+// plus the borrowed neighbor borders contained in the vmanip. Blocks
+// hashing equally produce identical (block-local) geometry.
+static u64 hashMeshContent(MeshMakeData *data)
+{
+	const VoxelArea &area = data->m_vmanip.m_area;
+	return murmur_hash_64_ua(data->m_vmanip.m_data,
+		area.getVolume() * sizeof(MapNode), 0x6d657368);
+}
+
+void MeshUpdateThread::processQueue()
 {
 	QueuedMeshUpdate *q;
 	while ((q = m_queue_in.pop())) {
@@ -291,15 +416,61 @@ void MeshUpdateThread::doUpdate()
 			sleep_ms(m_generation_interval);
 		ScopeProfiler sp(g_profiler, "Client: Mesh making (sum)");
 
-		MapBlockMesh *mesh_new = new MapBlockMesh(q->data, m_camera_offset);
+		// A block being cracked has position-specific geometry and must
+		// not be shared (nor pollute the cache with its crack overlay)
+		bool shareable = m_mesh_dedup_enabled &&
+			q->data->m_crack_pos_relative == v3s16(-1337, -1337, -1337);
+		u64 hash = 0;
+		std::shared_ptr<MapBlockMesh> mesh;
+
+		if (shareable) {
+			hash = hashMeshContent(q->data);
+			MutexAutoLock lock(m_mesh_dedup_mutex);
+			auto it = m_mesh_dedup.find(hash);
+			if (it != m_mesh_dedup.end())
+				mesh = it->second.lock();
+		}
 
 		MeshUpdateResult r;
 		r.p = q->p;
-		r.mesh = mesh_new;
 		r.ack_block_to_server = q->ack_block_to_server;
 
+		if (mesh) {
+			// The shared mesh's minimap data went to its first block;
+			// identical content yields identical minimap data, so
+			// rebuild just that part for this block
+			g_profiler->add("MeshUpdate: dedup hits", 1);
+			if (g_settings->getBool("enable_minimap")) {
+				r.minimap = new MinimapMapblock;
+				r.minimap->getMinimapNodes(&q->data->m_vmanip,
+					q->p * MAP_BLOCKSIZE);
+			}
+		} else {
+			mesh = std::make_shared<MapBlockMesh>(q->data);
+			m_queue_in.setCollectorEstimate(q->p,
+				mesh->getCollectorEstimate());
+			if (shareable) {
+				MutexAutoLock lock(m_mesh_dedup_mutex);
+				// Keep the table from accumulating expired entries
+				if (m_mesh_dedup.size() >= 2048) {
+					for (auto it = m_mesh_dedup.begin();
+							it != m_mesh_dedup.end(); )
+						it = it->second.expired() ?
+							m_mesh_dedup.erase(it) : ++it;
+				}
+				m_mesh_dedup[hash] = mesh;
+			}
+		}
+		r.mesh = mesh;
+
 		m_queue_out.push_back(r);
 
+		m_queue_in.done(q->p);
 		delete q;
 	}
 }
+
+void MeshUpdateThread::doUpdate()
+{
+	processQueue();
+}
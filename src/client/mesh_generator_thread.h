@@ -20,7 +20,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <ctime>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 #include "mapblock_mesh.h"
 #include "threading/mutex_auto_lock.h"
 #include "util/thread.h"
@@ -70,9 +72,17 @@ public:
 	void addBlock(Map *map, v3s16 p, bool ack_block_to_server, bool urgent);
 
 	// Returned pointer must be deleted
-	// Returns NULL if queue is empty
+	// Returns NULL if queue is empty or everything eligible is in flight
 	QueuedMeshUpdate *pop();
 
+	// Marks the block popped earlier as no longer being meshed, making
+	// queued re-updates of it eligible for pop() again
+	void done(v3s16 p);
+
+	// Records the collector sizes of the finished mesh of the block at p,
+	// used to pre-size the collector when the block is meshed again
+	void setCollectorEstimate(v3s16 p, const MeshCollectorEstimate &estimate);
+
 	u32 size()
 	{
 		MutexAutoLock lock(m_mutex);
@@ -83,13 +93,22 @@ private:
 	Client *m_client;
 	std::vector<QueuedMeshUpdate *> m_queue;
 	std::set<v3s16> m_urgents;
+	// Blocks currently being meshed by a worker. An update of such a
+	// block stays queued until done() so that two workers never mesh
+	// the same block concurrently (results would arrive out of order).
+	std::set<v3s16> m_inflight;
 	std::map<v3s16, CachedMapBlockData *> m_cache;
+	// Collector sizes of the last finished mesh per block, pruned
+	// together with m_cache
+	std::map<v3s16, MeshCollectorEstimate> m_collector_estimates;
+	// For nearest-first dequeue, updated on every addBlock()
+	v3s16 m_camera_block_pos;
 	std::mutex m_mutex;
 
 	// TODO: Add callback to update these when g_settings changes
 	bool m_cache_enable_shaders;
-	bool m_cache_use_tangent_vertices;
 	bool m_cache_smooth_lighting;
+	bool m_cache_lod_mesh;
 	int m_meshgen_block_cache_size;
 
 	CachedMapBlockData *cacheBlock(Map *map, v3s16 p, UpdateMode mode,
@@ -102,26 +121,69 @@ private:
 struct MeshUpdateResult
 {
 	v3s16 p = v3s16(-1338, -1338, -1338);
-	MapBlockMesh *mesh = nullptr;
+	std::shared_ptr<MapBlockMesh> mesh;
+	// Set instead of the mesh's own minimap data when the mesh was
+	// deduplicated (the shared mesh's copy belongs to its first block)
+	MinimapMapblock *minimap = nullptr;
 	bool ack_block_to_server = false;
 
 	MeshUpdateResult() = default;
 };
 
+class MeshUpdateThread;
+
+/*
+	Additional worker of the mesh generation thread pool. Processes the
+	queue of the managing MeshUpdateThread, which is itself the first
+	worker.
+*/
+class MeshUpdateWorkerThread : public UpdateThread
+{
+public:
+	MeshUpdateWorkerThread(MeshUpdateThread *manager, int id);
+
+protected:
+	virtual void doUpdate();
+
+private:
+	MeshUpdateThread *m_manager;
+};
+
 class MeshUpdateThread : public UpdateThread
 {
 public:
+	friend class MeshUpdateWorkerThread;
+
 	MeshUpdateThread(Client *client);
+	~MeshUpdateThread();
 
 	// Caches the block at p and its neighbors (if needed) and queues a mesh
 	// update for the block at p
 	void updateBlock(Map *map, v3s16 p, bool ack_block_to_server, bool urgent);
 
-	v3s16 m_camera_offset;
+	// These also start/stop the additional workers of the pool
+	// (intentionally hiding the Thread methods of the same name)
+	bool start();
+	void stop();
+	bool wait();
+
 	MutexedQueue<MeshUpdateResult> m_queue_out;
 
 private:
+	// Pops and meshes queued updates until the queue runs dry; run by
+	// this thread and every additional worker
+	void processQueue();
+
 	MeshUpdateQueue m_queue_in;
+	std::vector<MeshUpdateWorkerThread *> m_workers;
+
+	// Content-hash mesh deduplication: blocks whose mesh-relevant
+	// content (own nodes plus borrowed neighbor borders) hashes equally
+	// share one MapBlockMesh. weak_ptr so the cache never retains meshes
+	// beyond the blocks using them.
+	bool m_mesh_dedup_enabled;
+	std::unordered_map<u64, std::weak_ptr<MapBlockMesh>> m_mesh_dedup;
+	std::mutex m_mesh_dedup_mutex;
 
 	// TODO: Add callback to update these when g_settings changes
 	int m_generation_interval;
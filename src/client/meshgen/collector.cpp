@@ -22,6 +22,32 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "client/mesh.h"
 
+MeshCollector::MeshCollector(const MeshCollectorEstimate &estimate)
+{
+	for (int layer = 0; layer < MAX_TILE_LAYERS; layer++) {
+		if (estimate.buffers[layer] == 0)
+			continue;
+		prebuffers[layer].reserve(estimate.buffers[layer]);
+		m_vertex_estimate[layer] =
+				estimate.vertices[layer] / estimate.buffers[layer];
+		m_index_estimate[layer] =
+				estimate.indices[layer] / estimate.buffers[layer];
+	}
+}
+
+MeshCollectorEstimate MeshCollector::getEstimate() const
+{
+	MeshCollectorEstimate estimate;
+	for (int layer = 0; layer < MAX_TILE_LAYERS; layer++) {
+		estimate.buffers[layer] = prebuffers[layer].size();
+		for (const PreMeshBuffer &p : prebuffers[layer]) {
+			estimate.vertices[layer] += p.vertices.size();
+			estimate.indices[layer] += p.indices.size();
+		}
+	}
+	return estimate;
+}
+
 void MeshCollector::append(const TileSpec &tile, const video::S3DVertex *vertices,
 		u32 numVertices, const u16 *indices, u32 numIndices)
 {
@@ -89,6 +115,17 @@ void MeshCollector::append(const TileLayer &layer, const video::S3DVertex *verti
 		p.indices.push_back(indices[i] + vertex_count);
 }
 
+u32 MeshCollector::getLayerKey(const TileLayer &layer)
+{
+	// Hash of the fields TileLayer::operator== compares
+	u32 key = layer.texture_id;
+	key = key * 31 + layer.material_type;
+	key = key * 31 + layer.material_flags;
+	key = key * 31 + layer.scale;
+	key = key * 31 + layer.color.color;
+	return key;
+}
+
 PreMeshBuffer &MeshCollector::findBuffer(
 		const TileLayer &layer, u8 layernum, u32 numVertices)
 {
@@ -96,9 +133,18 @@ PreMeshBuffer &MeshCollector::findBuffer(
 		throw std::invalid_argument(
 				"Mesh can't contain more than 65536 vertices");
 	std::vector<PreMeshBuffer> &buffers = prebuffers[layernum];
-	for (PreMeshBuffer &p : buffers)
+	std::vector<u32> &bucket = m_buffer_index[layernum][getLayerKey(layer)];
+	for (u32 i : bucket) {
+		PreMeshBuffer &p = buffers[i];
 		if (p.layer == layer && p.vertices.size() + numVertices <= U16_MAX)
 			return p;
+	}
+	bucket.push_back(buffers.size());
 	buffers.emplace_back(layer);
-	return buffers.back();
+	PreMeshBuffer &p = buffers.back();
+	if (m_vertex_estimate[layernum] > 0) {
+		p.vertices.reserve(m_vertex_estimate[layernum]);
+		p.indices.reserve(m_index_estimate[layernum]);
+	}
+	return p;
 }
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 #include <array>
+#include <unordered_map>
 #include <vector>
 #include "irrlichttypes.h"
 #include <S3DVertex.h>
@@ -34,10 +35,29 @@ struct PreMeshBuffer
 	explicit PreMeshBuffer(const TileLayer &layer) : layer(layer) {}
 };
 
+/*!
+ * Per-layer buffer and vertex counts of a previously collected mesh.
+ * Used to pre-size the collector when the same block is meshed again,
+ * so that the append loop does not reallocate.
+ */
+struct MeshCollectorEstimate
+{
+	u32 buffers[MAX_TILE_LAYERS] = {};
+	u32 vertices[MAX_TILE_LAYERS] = {};
+	u32 indices[MAX_TILE_LAYERS] = {};
+};
+
 struct MeshCollector
 {
 	std::array<std::vector<PreMeshBuffer>, MAX_TILE_LAYERS> prebuffers;
 
+	MeshCollector() = default;
+	//! Pre-sizes the collector from the sizes of a previous mesh
+	explicit MeshCollector(const MeshCollectorEstimate &estimate);
+
+	//! Returns the collected sizes, to be reused as an estimate
+	MeshCollectorEstimate getEstimate() const;
+
 	// clang-format off
 	void append(const TileSpec &material,
 			const video::S3DVertex *vertices, u32 numVertices,
@@ -62,4 +82,15 @@ private:
 	// clang-format on
 
 	PreMeshBuffer &findBuffer(const TileLayer &layer, u8 layernum, u32 numVertices);
+
+	static u32 getLayerKey(const TileLayer &layer);
+
+	// Maps getLayerKey() to indices into prebuffers[layer], replacing a
+	// linear search over all buffers of a layer on every append
+	std::array<std::unordered_map<u32, std::vector<u32>>, MAX_TILE_LAYERS>
+			m_buffer_index;
+	// Average per-buffer sizes of the previous mesh, reserved on each
+	// newly opened buffer (0 = no estimate)
+	u32 m_vertex_estimate[MAX_TILE_LAYERS] = {};
+	u32 m_index_estimate[MAX_TILE_LAYERS] = {};
 };
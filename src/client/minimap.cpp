@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "minimap.h"
 #include <cmath>
+#include <cstring>
 #include "client.h"
 #include "clientmap.h"
 #include "settings.h"
@@ -90,6 +91,7 @@ void MinimapUpdateThread::doUpdate()
 	QueuedMinimapUpdate update;
 
 	while (popBlockUpdate(&update)) {
+		m_dirty_columns.insert(v3s16(update.pos.X, 0, update.pos.Z));
 		if (update.data) {
 			// Swap two values in the map using single lookup
 			std::pair<std::map<v3s16, MinimapMapblock*>::iterator, bool>
@@ -108,6 +110,13 @@ void MinimapUpdateThread::doUpdate()
 		}
 	}
 
+	// Many scattered changes: a full rescan is cheaper than compositing
+	// each dirty column range separately
+	if (m_dirty_columns.size() > 64) {
+		m_scan_valid = false;
+		m_dirty_columns.clear();
+	}
+
 	if (data->map_invalidated && data->mode != MINIMAP_MODE_OFF) {
 		getMap(data->pos, data->map_size, data->scan_height);
 		data->map_invalidated = false;
@@ -118,19 +127,94 @@ void MinimapUpdateThread::getMap(v3s16 pos, s16 size, s16 height)
 {
 	v3s16 pos_min(pos.X - size / 2, pos.Y - height / 2, pos.Z - size / 2);
 	v3s16 pos_max(pos_min.X + size - 1, pos.Y + height / 2, pos_min.Z + size - 1);
-	v3s16 blockpos_min = getNodeBlockPos(pos_min);
-	v3s16 blockpos_max = getNodeBlockPos(pos_max);
 
-// clear the map
-	for (int z = 0; z < size; z++)
-	for (int x = 0; x < size; x++) {
+	s16 dx = pos_min.X - m_last_pos_min.X;
+	s16 dz = pos_min.Z - m_last_pos_min.Z;
+
+	// The scan can only be reused if the mode (size) and the vertical
+	// scan range are unchanged and some columns remain in view
+	bool full_scan = !m_scan_valid || size != m_last_size ||
+			pos_min.Y != m_last_pos_min.Y || pos_max.Y != m_last_pos_max.Y ||
+			abs(dx) >= size || abs(dz) >= size;
+
+	if (full_scan) {
+		scanColumns(pos_min, pos_max, size, 0, 0, size - 1, size - 1);
+	} else {
+		if (dx != 0 || dz != 0) {
+			// Shift the still-valid columns of the previous scan.
+			// Rows are walked so that no source row is overwritten
+			// before it is read; memmove handles in-row overlap.
+			s16 z_begin = dz >= 0 ? 0 : size - 1;
+			s16 z_end = dz >= 0 ? size : -1;
+			s16 z_step = dz >= 0 ? 1 : -1;
+			for (s16 z = z_begin; z != z_end; z += z_step) {
+				s16 src_z = z + dz;
+				if (src_z < 0 || src_z >= size)
+					continue; // rescanned below
+				s16 x0 = MYMAX(0, -dx);
+				s16 x1 = MYMIN(size, size - dx);
+				if (x1 > x0)
+					memmove(&data->minimap_scan[z * size + x0],
+						&data->minimap_scan[src_z * size + x0 + dx],
+						(x1 - x0) * sizeof(MinimapPixel));
+			}
+
+			// Rescan the newly exposed ring
+			if (dx > 0)
+				scanColumns(pos_min, pos_max, size,
+						size - dx, 0, size - 1, size - 1);
+			else if (dx < 0)
+				scanColumns(pos_min, pos_max, size,
+						0, 0, -dx - 1, size - 1);
+			if (dz > 0)
+				scanColumns(pos_min, pos_max, size,
+						0, size - dz, size - 1, size - 1);
+			else if (dz < 0)
+				scanColumns(pos_min, pos_max, size,
+						0, 0, size - 1, -dz - 1);
+		}
+
+		// Recomposite the columns changed by block updates
+		for (const v3s16 &bp : m_dirty_columns) {
+			s32 x0 = (s32)bp.X * MAP_BLOCKSIZE - pos_min.X;
+			s32 z0 = (s32)bp.Z * MAP_BLOCKSIZE - pos_min.Z;
+			scanColumns(pos_min, pos_max, size, x0, z0,
+					x0 + MAP_BLOCKSIZE - 1, z0 + MAP_BLOCKSIZE - 1);
+		}
+	}
+
+	m_dirty_columns.clear();
+	m_scan_valid = true;
+	m_last_pos_min = pos_min;
+	m_last_pos_max = pos_max;
+	m_last_size = size;
+}
+
+void MinimapUpdateThread::scanColumns(v3s16 pos_min, v3s16 pos_max, s16 size,
+		s32 x0, s32 z0, s32 x1, s32 z1)
+{
+	x0 = MYMAX(x0, 0);
+	z0 = MYMAX(z0, 0);
+	x1 = MYMIN(x1, size - 1);
+	z1 = MYMIN(z1, size - 1);
+	if (x1 < x0 || z1 < z0)
+		return;
+
+// clear the region
+	for (s32 z = z0; z <= z1; z++)
+	for (s32 x = x0; x <= x1; x++) {
 		MinimapPixel &mmpixel = data->minimap_scan[x + z * size];
 		mmpixel.air_count = 0;
 		mmpixel.height = 0;
 		mmpixel.n = MapNode(CONTENT_AIR);
 	}
 
-// draw the map
+	v3s16 scan_min(pos_min.X + x0, pos_min.Y, pos_min.Z + z0);
+	v3s16 scan_max(pos_min.X + x1, pos_max.Y, pos_min.Z + z1);
+	v3s16 blockpos_min = getNodeBlockPos(scan_min);
+	v3s16 blockpos_max = getNodeBlockPos(scan_max);
+
+// draw the region
 	v3s16 blockpos;
 	for (blockpos.Z = blockpos_min.Z; blockpos.Z <= blockpos_max.Z; ++blockpos.Z)
 	for (blockpos.Y = blockpos_min.Y; blockpos.Y <= blockpos_max.Y; ++blockpos.Y)
@@ -144,8 +228,8 @@ void MinimapUpdateThread::getMap(v3s16 pos, s16 size, s16 height)
 		v3s16 block_node_min(blockpos * MAP_BLOCKSIZE);
 		v3s16 block_node_max(block_node_min + MAP_BLOCKSIZE - 1);
 		// clip
-		v3s16 range_min = componentwise_max(block_node_min, pos_min);
-		v3s16 range_max = componentwise_min(block_node_max, pos_max);
+		v3s16 range_min = componentwise_max(block_node_min, scan_min);
+		v3s16 range_max = componentwise_min(block_node_max, scan_max);
 
 		v3s16 pos;
 		pos.Y = range_min.Y;
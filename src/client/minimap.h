@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/thread.h"
 #include "voxel.h"
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -109,9 +110,22 @@ protected:
 	virtual void doUpdate();
 
 private:
+	// Clears and recomposites the scan columns in the given region of
+	// map coordinates (clamped to [0, size))
+	void scanColumns(v3s16 pos_min, v3s16 pos_max, s16 size,
+			s32 x0, s32 z0, s32 x1, s32 z1);
+
 	std::mutex m_queue_mutex;
 	std::deque<QueuedMinimapUpdate> m_update_queue;
 	std::map<v3s16, MinimapMapblock *> m_blocks_cache;
+
+	// State of the previous scan, for incremental updates
+	bool m_scan_valid = false;
+	v3s16 m_last_pos_min;
+	v3s16 m_last_pos_max;
+	s16 m_last_size = 0;
+	// XZ block columns changed since the previous scan (Y always 0)
+	std::set<v3s16> m_dirty_columns;
 };
 
 class Minimap {
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "particles.h"
+#include <algorithm>
 #include <cmath>
 #include "client.h"
 #include "collision.h"
@@ -64,9 +65,7 @@ Particle::Particle(
 	const struct TileAnimationParams &anim,
 	u8 glow,
 	video::SColor color
-):
-	scene::ISceneNode(RenderingEngine::get_scene_manager()->getRootSceneNode(),
-		RenderingEngine::get_scene_manager())
+)
 {
 	// Misc
 	m_gamedef = gamedef;
@@ -108,7 +107,6 @@ Particle::Particle(
 		 size / 2,
 		 size / 2,
 		 size / 2);
-	this->setAutomaticCulling(scene::EAC_OFF);
 
 	// Init lighting
 	updateLight();
@@ -117,26 +115,6 @@ Particle::Particle(
 	updateVertices();
 }
 
-void Particle::OnRegisterSceneNode()
-{
-	if (IsVisible)
-		SceneManager->registerNodeForRendering(this, scene::ESNRP_TRANSPARENT_EFFECT);
-
-	ISceneNode::OnRegisterSceneNode();
-}
-
-void Particle::render()
-{
-	video::IVideoDriver *driver = SceneManager->getVideoDriver();
-	driver->setMaterial(m_material);
-	driver->setTransform(video::ETS_WORLD, AbsoluteTransformation);
-
-	u16 indices[] = {0,1,2, 2,3,0};
-	driver->drawVertexPrimitiveList(m_vertices, 4,
-			indices, 2, video::EVT_STANDARD,
-			scene::EPT_TRIANGLES, video::EIT_16BIT);
-}
-
 void Particle::step(float dtime)
 {
 	m_time += dtime;
@@ -343,7 +321,7 @@ void ParticleSpawner::spawnParticle(ClientEnvironment *env, float radius,
 		* (m_maxsize - m_minsize)
 		+ m_minsize;
 
-	m_particlemanager->addParticle(new Particle(
+	m_particlemanager->addParticle(Particle(
 		m_gamedef,
 		m_player,
 		env,
@@ -413,13 +391,94 @@ void ParticleSpawner::step(float dtime, ClientEnvironment *env)
 }
 
 
+/*
+	ParticleBatchNode
+*/
+
+void ParticleBatchNode::OnRegisterSceneNode()
+{
+	if (IsVisible)
+		SceneManager->registerNodeForRendering(this, scene::ESNRP_TRANSPARENT_EFFECT);
+
+	ISceneNode::OnRegisterSceneNode();
+}
+
+void ParticleBatchNode::render()
+{
+	m_manager->renderParticles(SceneManager->getVideoDriver());
+}
+
+
 ParticleManager::ParticleManager(ClientEnvironment *env) :
 	m_env(env)
-{}
+{
+	m_batch_node = new ParticleBatchNode(
+			RenderingEngine::get_scene_manager()->getRootSceneNode(),
+			RenderingEngine::get_scene_manager(), this);
+}
 
 ParticleManager::~ParticleManager()
 {
 	clearAll();
+	m_batch_node->remove();
+}
+
+void ParticleManager::renderParticles(video::IVideoDriver *driver)
+{
+	MutexAutoLock lock(m_particle_list_lock);
+	if (m_particles.empty())
+		return;
+
+	driver->setTransform(video::ETS_WORLD, core::IdentityMatrix);
+
+	// Gather the (few) distinct textures, then submit each texture's
+	// particles as one primitive list
+	std::vector<video::ITexture *> textures;
+	for (const Particle &p : m_particles) {
+		video::ITexture *t = p.getMaterial().getTexture(0);
+		if (std::find(textures.begin(), textures.end(), t) == textures.end())
+			textures.push_back(t);
+	}
+
+	static const u16 quad_indices[] = {0, 1, 2, 2, 3, 0};
+
+	for (video::ITexture *texture : textures) {
+		m_render_vertices.clear();
+		m_render_indices.clear();
+		const video::SMaterial *material = nullptr;
+
+		for (const Particle &p : m_particles) {
+			if (p.getMaterial().getTexture(0) != texture)
+				continue;
+			material = &p.getMaterial();
+
+			// Flush if another quad would overflow the 16 bit indices
+			if (m_render_vertices.size() + 4 > U16_MAX) {
+				driver->setMaterial(*material);
+				driver->drawVertexPrimitiveList(&m_render_vertices[0],
+						m_render_vertices.size(), &m_render_indices[0],
+						m_render_indices.size() / 3, video::EVT_STANDARD,
+						scene::EPT_TRIANGLES, video::EIT_16BIT);
+				m_render_vertices.clear();
+				m_render_indices.clear();
+			}
+
+			u16 vertex_count = m_render_vertices.size();
+			const video::S3DVertex *v = p.getVertices();
+			for (u16 i = 0; i < 4; i++)
+				m_render_vertices.push_back(v[i]);
+			for (u16 i : quad_indices)
+				m_render_indices.push_back(vertex_count + i);
+		}
+
+		if (!m_render_vertices.empty()) {
+			driver->setMaterial(*material);
+			driver->drawVertexPrimitiveList(&m_render_vertices[0],
+					m_render_vertices.size(), &m_render_indices[0],
+					m_render_indices.size() / 3, video::EVT_STANDARD,
+					scene::EPT_TRIANGLES, video::EIT_16BIT);
+		}
+	}
 }
 
 void ParticleManager::step(float dtime)
@@ -445,14 +504,16 @@ void ParticleManager::stepSpawners(float dtime)
 void ParticleManager::stepParticles(float dtime)
 {
 	MutexAutoLock lock(m_particle_list_lock);
-	for (auto i = m_particles.begin(); i != m_particles.end();) {
-		if ((*i)->get_expired()) {
-			(*i)->remove();
-			delete *i;
-			i = m_particles.erase(i);
+	// Swap-remove expired particles; draw order does not matter since
+	// rendering batches by texture anyway
+	for (size_t i = 0; i < m_particles.size();) {
+		if (m_particles[i].get_expired()) {
+			m_particles[i] = std::move(m_particles.back());
+			m_particles.pop_back();
+			// The moved-in particle still has to be checked
 		} else {
-			(*i)->step(dtime);
-			++i;
+			m_particles[i].step(dtime);
+			i++;
 		}
 	}
 }
@@ -466,12 +527,7 @@ void ParticleManager::clearAll()
 		m_particle_spawners.erase(i++);
 	}
 
-	for(auto i = m_particles.begin(); i != m_particles.end();)
-	{
-		(*i)->remove();
-		delete *i;
-		i = m_particles.erase(i);
-	}
+	m_particles.clear();
 }
 
 void ParticleManager::handleParticleEvent(ClientEvent *event, Client *client,
@@ -543,7 +599,7 @@ void ParticleManager::handleParticleEvent(ClientEvent *event, Client *client,
 			video::ITexture *texture =
 				client->tsrc()->getTextureForMesh(*(event->spawn_particle.texture));
 
-			Particle *toadd = new Particle(client, player, m_env,
+			addParticle(Particle(client, player, m_env,
 					*event->spawn_particle.pos,
 					*event->spawn_particle.vel,
 					*event->spawn_particle.acc,
@@ -557,9 +613,7 @@ void ParticleManager::handleParticleEvent(ClientEvent *event, Client *client,
 					v2f(0.0, 0.0),
 					v2f(1.0, 1.0),
 					event->spawn_particle.animation,
-					event->spawn_particle.glow);
-
-			addParticle(toadd);
+					event->spawn_particle.glow));
 
 			delete event->spawn_particle.pos;
 			delete event->spawn_particle.vel;
@@ -642,7 +696,7 @@ void ParticleManager::addNodeParticle(IGameDef *gamedef,
 	else
 		n.getColor(f, &color);
 
-	Particle *toadd = new Particle(
+	addParticle(Particle(
 		gamedef,
 		player,
 		m_env,
@@ -660,13 +714,11 @@ void ParticleManager::addNodeParticle(IGameDef *gamedef,
 		texsize,
 		anim,
 		0,
-		color);
-
-	addParticle(toadd);
+		color));
 }
 
-void ParticleManager::addParticle(Particle *toadd)
+void ParticleManager::addParticle(Particle &&toadd)
 {
 	MutexAutoLock lock(m_particle_list_lock);
-	m_particles.push_back(toadd);
+	m_particles.push_back(std::move(toadd));
 }
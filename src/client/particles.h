@@ -31,7 +31,7 @@ class ClientEnvironment;
 struct MapNode;
 struct ContentFeatures;
 
-class Particle : public scene::ISceneNode
+class Particle
 {
 	public:
 	Particle(
@@ -56,24 +56,16 @@ class Particle : public scene::ISceneNode
 	);
 	~Particle() = default;
 
-	virtual const aabb3f &getBoundingBox() const
-	{
-		return m_box;
-	}
-
-	virtual u32 getMaterialCount() const
+	const video::SMaterial &getMaterial() const
 	{
-		return 1;
+		return m_material;
 	}
 
-	virtual video::SMaterial& getMaterial(u32 i)
+	const video::S3DVertex *getVertices() const
 	{
-		return m_material;
+		return m_vertices;
 	}
 
-	virtual void OnRegisterSceneNode();
-	virtual void render();
-
 	void step(float dtime);
 
 	bool get_expired ()
@@ -173,12 +165,44 @@ private:
 	u8 m_glow;
 };
 
+/**
+ * A single scene node rendering all particles, batched by texture.
+ *
+ * Replaces the former one-scene-node-per-particle setup: all particles
+ * of one texture are submitted as one primitive list, so even large
+ * bursts cost a handful of draw calls and no scene graph traffic.
+ */
+class ParticleBatchNode : public scene::ISceneNode
+{
+public:
+	ParticleBatchNode(scene::ISceneNode *parent, scene::ISceneManager *mgr,
+			ParticleManager *manager):
+		scene::ISceneNode(parent, mgr),
+		m_manager(manager)
+	{
+		setAutomaticCulling(scene::EAC_OFF);
+	}
+
+	virtual const aabb3f &getBoundingBox() const
+	{
+		return m_box;
+	}
+
+	virtual void OnRegisterSceneNode();
+	virtual void render();
+
+private:
+	ParticleManager *m_manager;
+	aabb3f m_box;
+};
+
 /**
  * Class doing particle as well as their spawners handling
  */
 class ParticleManager
 {
 friend class ParticleSpawner;
+friend class ParticleBatchNode;
 public:
 	ParticleManager(ClientEnvironment* env);
 	~ParticleManager();
@@ -207,16 +231,26 @@ public:
 	}
 
 protected:
-	void addParticle(Particle* toadd);
+	void addParticle(Particle &&toadd);
 
 private:
 
 	void stepParticles(float dtime);
 	void stepSpawners(float dtime);
 
+	// Submits all particles, one draw per texture; called by the
+	// batch node on the render thread
+	void renderParticles(video::IVideoDriver *driver);
+
 	void clearAll();
 
-	std::vector<Particle*> m_particles;
+	// Pooled storage: expired particles are swap-removed and the
+	// capacity is reused, so steady spawning does not allocate
+	std::vector<Particle> m_particles;
+	ParticleBatchNode *m_batch_node;
+	// Reused between renderParticles() calls to avoid reallocation
+	std::vector<video::S3DVertex> m_render_vertices;
+	std::vector<u16> m_render_indices;
 	std::unordered_map<u64, ParticleSpawner*> m_particle_spawners;
 	// Start the particle spawner ids generated from here after u32_max. lower values are
 	// for server sent spawners.
@@ -18,8 +18,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <atomic>
 #include <fstream>
 #include <iterator>
+#include <map>
 #include "shader.h"
 #include "irrlichttypes_extrabloated.h"
 #include "debug.h"
@@ -198,6 +200,12 @@ public:
 		for (IShaderConstantSetter *setter : m_setters)
 			setter->onSetConstants(services, is_highlevel);
 	}
+
+	virtual void OnSetMaterial(const video::SMaterial& material)
+	{
+		for (IShaderConstantSetter *setter : m_setters)
+			setter->onSetMaterial(material);
+	}
 };
 
 
@@ -209,14 +217,29 @@ class MainShaderConstantSetter : public IShaderConstantSetter
 {
 	CachedVertexShaderSetting<float, 16> m_world_view_proj;
 	CachedVertexShaderSetting<float, 16> m_world;
+	// Frame count and frame length (ms) of the current material's tile
+	// animation, stashed in its texture matrix by MapBlockMesh
+	CachedPixelShaderSetting<float, 2> m_animation_params;
+	float m_animation_params_value[2];
 
 public:
 	MainShaderConstantSetter() :
 		m_world_view_proj("mWorldViewProj"),
-		m_world("mWorld")
-	{}
+		m_world("mWorld"),
+		m_animation_params("animationParams")
+	{
+		m_animation_params_value[0] = 1.0f;
+		m_animation_params_value[1] = 0.0f;
+	}
 	~MainShaderConstantSetter() = default;
 
+	virtual void onSetMaterial(const video::SMaterial& material)
+	{
+		const core::matrix4 &tm = material.getTextureMatrix(0);
+		m_animation_params_value[0] = tm[0];
+		m_animation_params_value[1] = tm[1];
+	}
+
 	virtual void onSetConstants(video::IMaterialRendererServices *services,
 			bool is_highlevel)
 	{
@@ -240,6 +263,9 @@ public:
 		else
 			services->setVertexShaderConstant(world.pointer(), 4, 4);
 
+		// Set tile animation parameters of the current material
+		if (is_highlevel)
+			m_animation_params.set(m_animation_params_value, services);
 	}
 };
 
@@ -256,6 +282,29 @@ public:
 	ShaderSource
 */
 
+/*
+	A shader is identified by name, material type and drawtype; all three
+	must travel with a queued request so that the main thread can generate
+	the right variant.
+*/
+struct ShaderRequest
+{
+	std::string name;
+	u8 material_type = 0;
+	u8 drawtype = 0;
+
+	bool operator==(const ShaderRequest &other) const
+	{
+		return name == other.name &&
+			material_type == other.material_type &&
+			drawtype == other.drawtype;
+	}
+	bool operator!=(const ShaderRequest &other) const
+	{
+		return !(*this == other);
+	}
+};
+
 class ShaderSource : public IWritableShaderSource
 {
 public:
@@ -320,13 +369,25 @@ private:
 	std::mutex m_shaderinfo_cache_mutex;
 
 	// Queued shader fetches (to be processed by the main thread)
-	RequestQueue<std::string, u32, u8, u8> m_get_shader_queue;
+	RequestQueue<ShaderRequest, u32, u8, u8> m_get_shader_queue;
+
+	// Result queues for the above, one per requesting thread. Owned by
+	// the shader source so that a result arriving after a requester has
+	// given up still has a valid destination.
+	std::map<std::thread::id, ResultQueue<ShaderRequest, u32, u8, u8>>
+			m_result_queues;
+	std::mutex m_result_queue_mutex;
 
 	// Global constant setter factories
 	std::vector<IShaderConstantSetterFactory *> m_setter_factories;
 
 	// Shader callbacks
 	std::vector<ShaderCallback *> m_callbacks;
+
+	// The settings-derived part of the shaders header, built once and
+	// shared by all variants; cleared when shaders are rebuilt so that
+	// changed settings are picked up
+	std::string m_common_header_cache;
 };
 
 IWritableShaderSource *createShaderSource()
@@ -340,7 +401,7 @@ IWritableShaderSource *createShaderSource()
 ShaderInfo generate_shader(const std::string &name,
 		u8 material_type, u8 drawtype, std::vector<ShaderCallback *> &callbacks,
 		const std::vector<IShaderConstantSetterFactory *> &setter_factories,
-		SourceShaderCache *sourcecache);
+		SourceShaderCache *sourcecache, std::string &common_header_cache);
 
 /*
 	Load shader programs
@@ -371,6 +432,18 @@ ShaderSource::~ShaderSource()
 	}
 }
 
+/*
+	Each thread that queues requests for the main thread gets its own
+	caller id, so that RequestQueue::add() does not merge concurrent
+	requests for the same shader into a single waiter.
+*/
+static u8 get_shader_caller_id()
+{
+	static std::atomic<u8> next_id(1);
+	thread_local u8 caller_id = next_id.fetch_add(1);
+	return caller_id;
+}
+
 u32 ShaderSource::getShader(const std::string &name,
 		const u8 material_type, const u8 drawtype)
 {
@@ -384,25 +457,50 @@ u32 ShaderSource::getShader(const std::string &name,
 
 	/*errorstream<<"getShader(): Queued: name=\""<<name<<"\""<<std::endl;*/
 
-	// We're gonna ask the result to be put into here
+	// See if the shader already exists
+	{
+		MutexAutoLock lock(m_shaderinfo_cache_mutex);
+		for (u32 i = 0; i < m_shaderinfo_cache.size(); i++) {
+			ShaderInfo *info = &m_shaderinfo_cache[i];
+			if (info->name == name && info->material_type == material_type &&
+					info->drawtype == drawtype)
+				return i;
+		}
+	}
+
+	ShaderRequest request;
+	request.name = name;
+	request.material_type = material_type;
+	request.drawtype = drawtype;
 
-	static ResultQueue<std::string, u32, u8, u8> result_queue;
+	// We're gonna ask the result to be put into here,
+	// one queue per requesting thread so that concurrent requests
+	// cannot consume each other's results
+	ResultQueue<ShaderRequest, u32, u8, u8> *result_queue;
+	{
+		MutexAutoLock lock(m_result_queue_mutex);
+		result_queue = &m_result_queues[std::this_thread::get_id()];
+	}
 
 	// Throw a request in
-	m_get_shader_queue.add(name, 0, 0, &result_queue);
+	m_get_shader_queue.add(request, get_shader_caller_id(), 0, result_queue);
 
 	/* infostream<<"Waiting for shader from main thread, name=\""
 			<<name<<"\""<<std::endl;*/
 
-	while(true) {
-		GetResult<std::string, u32, u8, u8>
-			result = result_queue.pop_frontNoEx();
+	try {
+		while(true) {
+			// Wait result for a second
+			GetResult<ShaderRequest, u32, u8, u8>
+				result = result_queue->pop_front(1000);
 
-		if (result.key == name) {
-			return result.item;
+			if (result.key == request) {
+				return result.item;
+			}
 		}
-
-		errorstream << "Got shader with invalid name: " << result.key << std::endl;
+	} catch (ItemNotFoundException &e) {
+		errorstream << "Waiting for shader " << name << " timed out." << std::endl;
+		return 0;
 	}
 
 	infostream << "getShader(): Failed" << std::endl;
@@ -425,11 +523,14 @@ u32 ShaderSource::getShaderIdDirect(const std::string &name,
 	}
 
 	// Check if already have such instance
-	for(u32 i=0; i<m_shaderinfo_cache.size(); i++){
-		ShaderInfo *info = &m_shaderinfo_cache[i];
-		if(info->name == name && info->material_type == material_type &&
-			info->drawtype == drawtype)
-			return i;
+	{
+		MutexAutoLock lock(m_shaderinfo_cache_mutex);
+		for(u32 i=0; i<m_shaderinfo_cache.size(); i++){
+			ShaderInfo *info = &m_shaderinfo_cache[i];
+			if(info->name == name && info->material_type == material_type &&
+				info->drawtype == drawtype)
+				return i;
+		}
 	}
 
 	/*
@@ -442,7 +543,8 @@ u32 ShaderSource::getShaderIdDirect(const std::string &name,
 	}
 
 	ShaderInfo info = generate_shader(name, material_type, drawtype,
-			m_callbacks, m_setter_factories, &m_sourcecache);
+			m_callbacks, m_setter_factories, &m_sourcecache,
+			m_common_header_cache);
 
 	/*
 		Add shader to caches (add dummy shaders too)
@@ -472,8 +574,18 @@ ShaderInfo ShaderSource::getShaderInfo(u32 id)
 
 void ShaderSource::processQueue()
 {
+	/*
+		Fetch shaders
+	*/
+	//NOTE this is only thread safe for ONE consumer thread!
+	while (!m_get_shader_queue.empty()) {
+		GetRequest<ShaderRequest, u32, u8, u8>
+				request = m_get_shader_queue.pop();
 
-
+		m_get_shader_queue.pushResult(request, getShaderIdDirect(
+				request.key.name, request.key.material_type,
+				request.key.drawtype));
+	}
 }
 
 void ShaderSource::insertSourceShader(const std::string &name_of_shader,
@@ -502,101 +614,30 @@ void ShaderSource::rebuildShaders()
 		(This would be nice to do in the destructor too)
 	*/
 
+	// Settings may have changed, rebuild the common header
+	m_common_header_cache.clear();
+
 	// Recreate shaders
 	for (ShaderInfo &i : m_shaderinfo_cache) {
 		ShaderInfo *info = &i;
 		if (!info->name.empty()) {
 			*info = generate_shader(info->name, info->material_type,
 					info->drawtype, m_callbacks,
-					m_setter_factories, &m_sourcecache);
+					m_setter_factories, &m_sourcecache,
+					m_common_header_cache);
 		}
 	}
 }
 
 
-ShaderInfo generate_shader(const std::string &name, u8 material_type, u8 drawtype,
-		std::vector<ShaderCallback *> &callbacks,
-		const std::vector<IShaderConstantSetterFactory *> &setter_factories,
-		SourceShaderCache *sourcecache)
+/*
+	Build the part of the shaders header that is the same for every
+	variant: the drawtype/material constants and all settings-derived
+	defines. Reading the settings involves a mutex and map lookup each,
+	so doing this once instead of per variant matters at startup.
+*/
+static std::string make_common_shaders_header()
 {
-	ShaderInfo shaderinfo;
-	shaderinfo.name = name;
-	shaderinfo.material_type = material_type;
-	shaderinfo.drawtype = drawtype;
-	shaderinfo.material = video::EMT_SOLID;
-	switch (material_type) {
-	case TILE_MATERIAL_OPAQUE:
-	case TILE_MATERIAL_LIQUID_OPAQUE:
-	case TILE_MATERIAL_WAVING_LIQUID_OPAQUE:
-		shaderinfo.base_material = video::EMT_SOLID;
-		break;
-	case TILE_MATERIAL_ALPHA:
-	case TILE_MATERIAL_LIQUID_TRANSPARENT:
-	case TILE_MATERIAL_WAVING_LIQUID_TRANSPARENT:
-		shaderinfo.base_material = video::EMT_TRANSPARENT_ALPHA_CHANNEL;
-		break;
-	case TILE_MATERIAL_BASIC:
-	case TILE_MATERIAL_WAVING_LEAVES:
-	case TILE_MATERIAL_WAVING_PLANTS:
-	case TILE_MATERIAL_WAVING_LIQUID_BASIC:
-		shaderinfo.base_material = video::EMT_TRANSPARENT_ALPHA_CHANNEL_REF;
-		break;
-	}
-
-	bool enable_shaders = g_settings->getBool("enable_shaders");
-	if (!enable_shaders)
-		return shaderinfo;
-
-	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
-
-	video::IGPUProgrammingServices *gpu = driver->getGPUProgrammingServices();
-	if(!gpu){
-		errorstream<<"generate_shader(): "
-				"failed to generate \""<<name<<"\", "
-				"GPU programming not supported."
-				<<std::endl;
-		return shaderinfo;
-	}
-
-	// Choose shader language depending on driver type and settings
-	// Then load shaders
-	std::string vertex_program;
-	std::string pixel_program;
-	std::string geometry_program;
-	bool is_highlevel;
-	load_shaders(name, sourcecache, driver->getDriverType(),
-			enable_shaders, vertex_program, pixel_program,
-			geometry_program, is_highlevel);
-	// Check hardware/driver support
-	if (!vertex_program.empty() &&
-			!driver->queryFeature(video::EVDF_VERTEX_SHADER_1_1) &&
-			!driver->queryFeature(video::EVDF_ARB_VERTEX_PROGRAM_1)){
-		infostream<<"generate_shader(): vertex shaders disabled "
-				"because of missing driver/hardware support."
-				<<std::endl;
-		vertex_program = "";
-	}
-	if (!pixel_program.empty() &&
-			!driver->queryFeature(video::EVDF_PIXEL_SHADER_1_1) &&
-			!driver->queryFeature(video::EVDF_ARB_FRAGMENT_PROGRAM_1)){
-		infostream<<"generate_shader(): pixel shaders disabled "
-				"because of missing driver/hardware support."
-				<<std::endl;
-		pixel_program = "";
-	}
-	if (!geometry_program.empty() &&
-			!driver->queryFeature(video::EVDF_GEOMETRY_SHADER)){
-		infostream<<"generate_shader(): geometry shaders disabled "
-				"because of missing driver/hardware support."
-				<<std::endl;
-		geometry_program = "";
-	}
-
-	// If no shaders are used, don't make a separate material type
-	if (vertex_program.empty() && pixel_program.empty() && geometry_program.empty())
-		return shaderinfo;
-
-	// Create shaders header
 	std::string shaders_header = "#version 120\n";
 
 	static const char* drawTypes[] = {
@@ -648,13 +689,6 @@ ShaderInfo generate_shader(const std::string &name, u8 material_type, u8 drawtyp
 		shaders_header += "\n";
 	}
 
-	shaders_header += "#define MATERIAL_TYPE ";
-	shaders_header += itos(material_type);
-	shaders_header += "\n";
-	shaders_header += "#define DRAW_TYPE ";
-	shaders_header += itos(drawtype);
-	shaders_header += "\n";
-
 	if (g_settings->getBool("generate_normalmaps")) {
 		shaders_header += "#define GENERATE_NORMALMAPS 1\n";
 	} else {
@@ -746,6 +780,103 @@ ShaderInfo generate_shader(const std::string &name, u8 material_type, u8 drawtyp
 	shaders_header += ftos(rangelim(g_settings->getFloat("fog_start"), 0.0f, 0.99f));
 	shaders_header += "\n";
 
+	return shaders_header;
+}
+
+ShaderInfo generate_shader(const std::string &name, u8 material_type, u8 drawtype,
+		std::vector<ShaderCallback *> &callbacks,
+		const std::vector<IShaderConstantSetterFactory *> &setter_factories,
+		SourceShaderCache *sourcecache, std::string &common_header_cache)
+{
+	ShaderInfo shaderinfo;
+	shaderinfo.name = name;
+	shaderinfo.material_type = material_type;
+	shaderinfo.drawtype = drawtype;
+	shaderinfo.material = video::EMT_SOLID;
+	switch (material_type) {
+	case TILE_MATERIAL_OPAQUE:
+	case TILE_MATERIAL_LIQUID_OPAQUE:
+	case TILE_MATERIAL_WAVING_LIQUID_OPAQUE:
+		shaderinfo.base_material = video::EMT_SOLID;
+		break;
+	case TILE_MATERIAL_ALPHA:
+	case TILE_MATERIAL_LIQUID_TRANSPARENT:
+	case TILE_MATERIAL_WAVING_LIQUID_TRANSPARENT:
+		shaderinfo.base_material = video::EMT_TRANSPARENT_ALPHA_CHANNEL;
+		break;
+	case TILE_MATERIAL_BASIC:
+	case TILE_MATERIAL_WAVING_LEAVES:
+	case TILE_MATERIAL_WAVING_PLANTS:
+	case TILE_MATERIAL_WAVING_LIQUID_BASIC:
+		shaderinfo.base_material = video::EMT_TRANSPARENT_ALPHA_CHANNEL_REF;
+		break;
+	}
+
+	bool enable_shaders = g_settings->getBool("enable_shaders");
+	if (!enable_shaders)
+		return shaderinfo;
+
+	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
+
+	video::IGPUProgrammingServices *gpu = driver->getGPUProgrammingServices();
+	if(!gpu){
+		errorstream<<"generate_shader(): "
+				"failed to generate \""<<name<<"\", "
+				"GPU programming not supported."
+				<<std::endl;
+		return shaderinfo;
+	}
+
+	// Choose shader language depending on driver type and settings
+	// Then load shaders
+	std::string vertex_program;
+	std::string pixel_program;
+	std::string geometry_program;
+	bool is_highlevel;
+	load_shaders(name, sourcecache, driver->getDriverType(),
+			enable_shaders, vertex_program, pixel_program,
+			geometry_program, is_highlevel);
+	// Check hardware/driver support
+	if (!vertex_program.empty() &&
+			!driver->queryFeature(video::EVDF_VERTEX_SHADER_1_1) &&
+			!driver->queryFeature(video::EVDF_ARB_VERTEX_PROGRAM_1)){
+		infostream<<"generate_shader(): vertex shaders disabled "
+				"because of missing driver/hardware support."
+				<<std::endl;
+		vertex_program = "";
+	}
+	if (!pixel_program.empty() &&
+			!driver->queryFeature(video::EVDF_PIXEL_SHADER_1_1) &&
+			!driver->queryFeature(video::EVDF_ARB_FRAGMENT_PROGRAM_1)){
+		infostream<<"generate_shader(): pixel shaders disabled "
+				"because of missing driver/hardware support."
+				<<std::endl;
+		pixel_program = "";
+	}
+	if (!geometry_program.empty() &&
+			!driver->queryFeature(video::EVDF_GEOMETRY_SHADER)){
+		infostream<<"generate_shader(): geometry shaders disabled "
+				"because of missing driver/hardware support."
+				<<std::endl;
+		geometry_program = "";
+	}
+
+	// If no shaders are used, don't make a separate material type
+	if (vertex_program.empty() && pixel_program.empty() && geometry_program.empty())
+		return shaderinfo;
+
+	// Create shaders header: the shared part plus the variant defines
+	if (common_header_cache.empty())
+		common_header_cache = make_common_shaders_header();
+
+	std::string shaders_header = common_header_cache;
+	shaders_header += "#define MATERIAL_TYPE ";
+	shaders_header += itos(material_type);
+	shaders_header += "\n";
+	shaders_header += "#define DRAW_TYPE ";
+	shaders_header += itos(drawtype);
+	shaders_header += "\n";
+
 	// Call addHighLevelShaderMaterial() or addShaderMaterial()
 	const c8* vertex_program_ptr = 0;
 	const c8* pixel_program_ptr = 0;
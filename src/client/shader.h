@@ -67,6 +67,10 @@ public:
 	virtual ~IShaderConstantSetter() = default;
 	virtual void onSetConstants(video::IMaterialRendererServices *services,
 			bool is_highlevel) = 0;
+	// Called when the material is set, before onSetConstants; allows
+	// passing per-material data to the shader
+	virtual void onSetMaterial(const video::SMaterial& material)
+	{ }
 };
 
 
@@ -101,9 +101,65 @@ Sky::Sky(s32 id, ITextureSource *tsrc):
 		star.normalize();
 	}
 
+	bake_stars();
+
 	m_directional_colored_fog = g_settings->getBool("directional_colored_fog");
 }
 
+void Sky::bake_stars()
+{
+	// Bakes the star dome into a persistent vertex/index array, so that
+	// render() never has to do the per-star matrix math again. The dome
+	// is built at time-of-day zero; render() rotates the whole thing.
+	const float d = 0.007 / 2;
+
+#if ENABLE_GLES
+	m_star_vertices.resize(SKY_STAR_COUNT * 3);
+	m_star_indices.resize(SKY_STAR_COUNT * 3);
+	for (u32 i = 0; i < SKY_STAR_COUNT; i++) {
+		m_star_indices[i * 3 + 0] = i * 3 + 0;
+		m_star_indices[i * 3 + 1] = i * 3 + 1;
+		m_star_indices[i * 3 + 2] = i * 3 + 2;
+		v3f r = m_stars[i];
+		core::CMatrix4<f32> a;
+		a.buildRotateFromTo(v3f(0, 1, 0), r);
+		v3f p = v3f(-d, 1, -d);
+		v3f p1 = v3f(d, 1, 0);
+		v3f p2 = v3f(-d, 1, d);
+		a.rotateVect(p);
+		a.rotateVect(p1);
+		a.rotateVect(p2);
+		m_star_vertices[i * 3 + 0].Pos = p;
+		m_star_vertices[i * 3 + 1].Pos = p1;
+		m_star_vertices[i * 3 + 2].Pos = p2;
+	}
+#else
+	m_star_vertices.resize(SKY_STAR_COUNT * 4);
+	m_star_indices.resize(SKY_STAR_COUNT * 4);
+	for (u32 i = 0; i < SKY_STAR_COUNT; i++) {
+		m_star_indices[i * 4 + 0] = i * 4 + 0;
+		m_star_indices[i * 4 + 1] = i * 4 + 1;
+		m_star_indices[i * 4 + 2] = i * 4 + 2;
+		m_star_indices[i * 4 + 3] = i * 4 + 3;
+		v3f r = m_stars[i];
+		core::CMatrix4<f32> a;
+		a.buildRotateFromTo(v3f(0, 1, 0), r);
+		v3f p = v3f(-d, 1, -d);
+		v3f p1 = v3f( d, 1, -d);
+		v3f p2 = v3f( d, 1, d);
+		v3f p3 = v3f(-d, 1, d);
+		a.rotateVect(p);
+		a.rotateVect(p1);
+		a.rotateVect(p2);
+		a.rotateVect(p3);
+		m_star_vertices[i * 4 + 0].Pos = p;
+		m_star_vertices[i * 4 + 1].Pos = p1;
+		m_star_vertices[i * 4 + 2].Pos = p2;
+		m_star_vertices[i * 4 + 3].Pos = p3;
+	}
+#endif
+}
+
 
 void Sky::OnRegisterSceneNode()
 {
@@ -269,75 +325,34 @@ void Sky::render()
 				(0.25 - fabs(wicked_time_of_day < 0.5 ?
 				wicked_time_of_day : (1.0 - wicked_time_of_day))) * 20));
 			float f = starbrightness;
-			float d = 0.007 / 2;
 			video::SColor starcolor(255, f * 90, f * 90, f * 90);
 			// Stars are only drawn when brighter than skycolor
 			if (starcolor.getBlue() < m_skycolor.getBlue())
 				break;
-#if ENABLE_GLES
-			u16 indices[SKY_STAR_COUNT * 3];
-			video::S3DVertex vertices[SKY_STAR_COUNT * 3];
-			for (u32 i = 0; i < SKY_STAR_COUNT; i++) {
-				indices[i * 3 + 0] = i * 3 + 0;
-				indices[i * 3 + 1] = i * 3 + 1;
-				indices[i * 3 + 2] = i * 3 + 2;
-				v3f r = m_stars[i];
-				core::CMatrix4<f32> a;
-				a.buildRotateFromTo(v3f(0, 1, 0), r);
-				v3f p = v3f(-d, 1, -d);
-				v3f p1 = v3f(d, 1, 0);
-				v3f p2 = v3f(-d, 1, d);
-				a.rotateVect(p);
-				a.rotateVect(p1);
-				a.rotateVect(p2);
-				p.rotateXYBy(wicked_time_of_day * 360 - 90);
-				p1.rotateXYBy(wicked_time_of_day * 360 - 90);
-				p2.rotateXYBy(wicked_time_of_day * 360 - 90);
-				vertices[i * 3 + 0].Pos = p;
-				vertices[i * 3 + 0].Color = starcolor;
-				vertices[i * 3 + 1].Pos = p1;
-				vertices[i * 3 + 1].Color = starcolor;
-				vertices[i * 3 + 2].Pos = p2;
-				vertices[i * 3 + 2].Color = starcolor;
+
+			// The dome geometry is baked (see bake_stars()); only the
+			// colors are rewritten, and only while they are fading
+			if (starcolor != m_star_color) {
+				for (video::S3DVertex &vertex : m_star_vertices)
+					vertex.Color = starcolor;
+				m_star_color = starcolor;
 			}
-			driver->drawIndexedTriangleList(vertices, SKY_STAR_COUNT * 3,
-					indices, SKY_STAR_COUNT);
+
+			// Rotate the whole dome with the time of day via the world
+			// transform instead of per-vertex rotateXYBy() calls
+			const core::matrix4 world = driver->getTransform(video::ETS_WORLD);
+			core::matrix4 rot;
+			rot.setRotationDegrees(v3f(0, 0, wicked_time_of_day * 360 - 90));
+			driver->setTransform(video::ETS_WORLD, world * rot);
+#if ENABLE_GLES
+			driver->drawIndexedTriangleList(&m_star_vertices[0],
+				SKY_STAR_COUNT * 3, &m_star_indices[0], SKY_STAR_COUNT);
 #else
-			u16 indices[SKY_STAR_COUNT * 4];
-			video::S3DVertex vertices[SKY_STAR_COUNT * 4];
-			for (u32 i = 0; i < SKY_STAR_COUNT; i++) {
-				indices[i * 4 + 0] = i * 4 + 0;
-				indices[i * 4 + 1] = i * 4 + 1;
-				indices[i * 4 + 2] = i * 4 + 2;
-				indices[i * 4 + 3] = i * 4 + 3;
-				v3f r = m_stars[i];
-				core::CMatrix4<f32> a;
-				a.buildRotateFromTo(v3f(0, 1, 0), r);
-				v3f p = v3f(-d, 1, -d);
-				v3f p1 = v3f( d, 1, -d);
-				v3f p2 = v3f( d, 1, d);
-				v3f p3 = v3f(-d, 1, d);
-				a.rotateVect(p);
-				a.rotateVect(p1);
-				a.rotateVect(p2);
-				a.rotateVect(p3);
-				p.rotateXYBy(wicked_time_of_day * 360 - 90);
-				p1.rotateXYBy(wicked_time_of_day * 360 - 90);
-				p2.rotateXYBy(wicked_time_of_day * 360 - 90);
-				p3.rotateXYBy(wicked_time_of_day * 360 - 90);
-				vertices[i * 4 + 0].Pos = p;
-				vertices[i * 4 + 0].Color = starcolor;
-				vertices[i * 4 + 1].Pos = p1;
-				vertices[i * 4 + 1].Color = starcolor;
-				vertices[i * 4 + 2].Pos = p2;
-				vertices[i * 4 + 2].Color = starcolor;
-				vertices[i * 4 + 3].Pos = p3;
-				vertices[i * 4 + 3].Color = starcolor;
-			}
-			driver->drawVertexPrimitiveList(vertices, SKY_STAR_COUNT * 4,
-				indices, SKY_STAR_COUNT, video::EVT_STANDARD,
-				scene::EPT_QUADS, video::EIT_16BIT);
+			driver->drawVertexPrimitiveList(&m_star_vertices[0],
+				SKY_STAR_COUNT * 4, &m_star_indices[0], SKY_STAR_COUNT,
+				video::EVT_STANDARD, scene::EPT_QUADS, video::EIT_16BIT);
 #endif
+			driver->setTransform(video::ETS_WORLD, world);
 		} while (false);
 
 		// Draw sunrise/sunset horizon glow texture (textures/base/pack/sunrisebg.png)
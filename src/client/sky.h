@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <ISceneNode.h>
 #include <array>
+#include <vector>
 #include "camera.h"
 #include "irrlichttypes_extrabloated.h"
 
@@ -142,6 +143,12 @@ private:
 	video::SColor m_skycolor;
 	video::SColorf m_cloudcolor_f;
 	v3f m_stars[SKY_STAR_COUNT];
+	// Star dome geometry, baked once in the constructor. render() only
+	// rotates it into place with a transform and rewrites the vertex
+	// colors when the star brightness actually changes (dawn and dusk).
+	std::vector<video::S3DVertex> m_star_vertices;
+	std::vector<u16> m_star_indices;
+	video::SColor m_star_color = video::SColor(0, 0, 0, 0);
 	video::ITexture *m_sun_texture;
 	video::ITexture *m_moon_texture;
 	video::ITexture *m_sun_tonemap;
@@ -155,4 +162,5 @@ private:
 	void place_sky_body(
 			std::array<video::S3DVertex, 4> &vertices, float horizon_position,
 			float day_position);
+	void bake_stars();
 };
@@ -40,8 +40,14 @@ with this program; ifnot, write to the Free Software Foundation, Inc.,
 #include <vorbis/vorbisfile.h>
 #include <cassert>
 #include "log.h"
+#include "util/container.h" // MutexedQueue
 #include "util/numeric.h" // myrand()
 #include "porting.h"
+#include "threading/thread.h"
+#include "threading/mutex_auto_lock.h"
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <fstream>
 #include <unordered_map>
@@ -49,6 +55,15 @@ with this program; ifnot, write to the Free Software Foundation, Inc.,
 
 #define BUFFER_SIZE 30000
 
+// Sounds whose decoded PCM exceeds this many bytes (music, ambience) are
+// streamed from the compressed data at play time instead of being decoded
+// into one static buffer up front
+#define SOUND_STREAM_THRESHOLD (1024 * 1024)
+// Decoded bytes per stream chunk, i.e. per queued OpenAL buffer
+#define STREAM_CHUNK_SIZE (64 * 1024)
+// Chunks the decode thread keeps ready per stream
+#define STREAM_CHUNKS_TARGET 4
+
 std::shared_ptr<SoundManagerSingleton> g_sound_manager_singleton;
 
 typedef std::unique_ptr<ALCdevice, void (*)(ALCdevice *p)> unique_ptr_alcdevice;
@@ -107,8 +122,13 @@ struct SoundBuffer
 {
 	ALenum format;
 	ALsizei freq;
-	ALuint buffer_id;
+	ALuint buffer_id = 0;
 	std::vector<char> buffer;
+	// Streamed sounds keep the compressed Ogg data (or a path to it)
+	// instead of decoded PCM; each play opens its own decoder
+	bool streamed = false;
+	std::string stream_path;
+	std::string stream_data;
 };
 
 SoundBuffer *load_opened_ogg_file(OggVorbis_File *oggFile,
@@ -174,6 +194,32 @@ SoundBuffer *load_opened_ogg_file(OggVorbis_File *oggFile,
 	return snd;
 }
 
+// Size of the whole file decoded to 16-bit PCM, in bytes
+static ogg_int64_t ogg_decoded_size(OggVorbis_File *oggFile)
+{
+	vorbis_info *pInfo = ov_info(oggFile, -1);
+	return ov_pcm_total(oggFile, -1) * pInfo->channels * 2;
+}
+
+// Makes a SoundBuffer that only records where the compressed data lives;
+// decoding happens chunk by chunk while the sound plays
+static SoundBuffer *make_streamed_sound_buffer(OggVorbis_File *oggFile,
+		const std::string &path, const std::string &data)
+{
+	vorbis_info *pInfo = ov_info(oggFile, -1);
+
+	SoundBuffer *snd = new SoundBuffer;
+	snd->format = (pInfo->channels == 1) ?
+			AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+	snd->freq = pInfo->rate;
+	snd->streamed = true;
+	snd->stream_path = path;
+	snd->stream_data = data;
+
+	ov_clear(oggFile);
+	return snd;
+}
+
 SoundBuffer *load_ogg_from_file(const std::string &path)
 {
 	OggVorbis_File oggFile;
@@ -187,6 +233,9 @@ SoundBuffer *load_ogg_from_file(const std::string &path)
 		return nullptr;
 	}
 
+	if (ogg_decoded_size(&oggFile) > SOUND_STREAM_THRESHOLD)
+		return make_streamed_sound_buffer(&oggFile, path, "");
+
 	return load_opened_ogg_file(&oggFile, path);
 }
 
@@ -256,13 +305,152 @@ SoundBuffer *load_ogg_from_buffer(const std::string &buf, const std::string &id_
 		return nullptr;
 	}
 
+	if (ogg_decoded_size(&oggFile) > SOUND_STREAM_THRESHOLD)
+		return make_streamed_sound_buffer(&oggFile, "", buf);
+
 	return load_opened_ogg_file(&oggFile, id_for_log);
 }
 
+/*
+	Per-play decoder state of a streamed sound. The decode thread and the
+	main thread hand chunks over through m_chunks; everything below the
+	mutex is guarded by it.
+*/
+struct SoundStream
+{
+	ALenum format;
+	ALsizei freq;
+	bool loop;
+
+	std::mutex mutex;
+	OggVorbis_File oggfile;
+	// Read state for streams decoded from memory; points into the
+	// stream_data of the owning SoundBuffer, which outlives all of its
+	// playing streams
+	BufferSource source;
+	// Decoded PCM waiting to be queued on the source
+	std::deque<std::vector<char>> chunks;
+	bool reached_end = false;
+	// Whether a decode request for this stream is pending
+	bool queued_for_decode = false;
+
+	bool open = false;
+
+	~SoundStream()
+	{
+		if (open)
+			ov_clear(&oggfile);
+	}
+};
+
+// Opens a fresh decoder for one play of a streamed sound
+static std::shared_ptr<SoundStream> open_sound_stream(SoundBuffer *buf, bool loop)
+{
+	std::shared_ptr<SoundStream> stream(new SoundStream);
+	stream->format = buf->format;
+	stream->freq = buf->freq;
+	stream->loop = loop;
+
+	if (!buf->stream_path.empty()) {
+		if (ov_fopen(buf->stream_path.c_str(), &stream->oggfile) != 0) {
+			infostream << "Audio: Error reopening " << buf->stream_path
+				<< " for streaming" << std::endl;
+			return nullptr;
+		}
+	} else {
+		stream->source.buf = buf->stream_data.c_str();
+		stream->source.cur_offset = 0;
+		stream->source.len = buf->stream_data.size();
+		if (ov_open_callbacks(&stream->source, &stream->oggfile, nullptr, 0,
+				g_buffer_ov_callbacks) != 0) {
+			infostream << "Audio: Error reopening sound data"
+				" for streaming" << std::endl;
+			return nullptr;
+		}
+	}
+	stream->open = true;
+	return stream;
+}
+
+// Decodes roughly one chunk of PCM from the stream, wrapping around at the
+// end of looped streams. The stream mutex must be held by the caller.
+static void decode_stream_chunk(SoundStream *stream)
+{
+	int endian = 0; // 0 for Little-Endian, 1 for Big-Endian
+	int bitStream;
+	char array[BUFFER_SIZE];
+
+	std::vector<char> chunk;
+	chunk.reserve(STREAM_CHUNK_SIZE);
+
+	while (chunk.size() < STREAM_CHUNK_SIZE) {
+		long bytes = ov_read(&stream->oggfile, array,
+				MYMIN((long)sizeof(array),
+					(long)(STREAM_CHUNK_SIZE - chunk.size())),
+				endian, 2, 1, &bitStream);
+		if (bytes < 0) {
+			// Decode error; drop the rest of the stream
+			stream->reached_end = true;
+			break;
+		}
+		if (bytes == 0) {
+			if (!stream->loop || ov_raw_seek(&stream->oggfile, 0) != 0) {
+				stream->reached_end = true;
+				break;
+			}
+			continue;
+		}
+		chunk.insert(chunk.end(), array, array + bytes);
+	}
+
+	if (!chunk.empty())
+		stream->chunks.push_back(std::move(chunk));
+}
+
+/*
+	Keeps the chunk queues of playing streams topped up so the main thread
+	never blocks on Ogg decoding
+*/
+class SoundStreamThread : public Thread
+{
+public:
+	SoundStreamThread() : Thread("SoundStream") {}
+
+	void queueForDecode(const std::shared_ptr<SoundStream> &stream)
+	{
+		m_queue.push_back(stream);
+	}
+
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		while (!stopRequested()) {
+			std::shared_ptr<SoundStream> stream = m_queue.pop_frontNoEx(100);
+			if (!stream)
+				continue;
+
+			MutexAutoLock lock(stream->mutex);
+			stream->queued_for_decode = false;
+			while (!stream->reached_end &&
+					stream->chunks.size() < STREAM_CHUNKS_TARGET)
+				decode_stream_chunk(stream.get());
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+		return nullptr;
+	}
+
+private:
+	MutexedQueue<std::shared_ptr<SoundStream>> m_queue;
+};
+
 struct PlayingSound
 {
 	ALuint source_id;
 	bool loop;
+	// Set when the sound streams instead of playing one static buffer
+	std::shared_ptr<SoundStream> stream;
 };
 
 class SoundManagerSingleton
@@ -325,6 +513,12 @@ private:
 
 	std::unordered_map<int, FadeState> m_sounds_fading;
 	float m_fade_delay;
+	// Idle OpenAL buffers reused for stream chunks
+	std::vector<ALuint> m_stream_buffer_pool;
+	SoundStreamThread m_stream_thread;
+	// Position updates batched between steps; applied in one pass by
+	// flushSoundPositions()
+	std::unordered_map<int, v3f> m_queued_sound_positions;
 public:
 	OpenALSoundManager(SoundManagerSingleton *smg, OnDemandSoundFetcher *fetcher):
 		m_fetcher(fetcher),
@@ -333,6 +527,7 @@ public:
 		m_next_id(1),
 		m_fade_delay(0)
 	{
+		m_stream_thread.start();
 		infostream << "Audio: Initialized: OpenAL " << std::endl;
 	}
 
@@ -340,6 +535,9 @@ public:
 	{
 		infostream << "Audio: Deinitializing..." << std::endl;
 
+		m_stream_thread.stop();
+		m_stream_thread.wait();
+
 		std::unordered_set<int> source_del_list;
 
 		for (const auto &sp : m_sounds_playing)
@@ -356,12 +554,108 @@ public:
 		}
 		m_buffers.clear();
 
+		if (!m_stream_buffer_pool.empty())
+			alDeleteBuffers(m_stream_buffer_pool.size(),
+					&m_stream_buffer_pool[0]);
+
 		infostream << "Audio: Deinitialized." << std::endl;
 	}
 
 	void step(float dtime)
 	{
 		doFades(dtime);
+		serviceStreams();
+		flushSoundPositions();
+	}
+
+	ALuint acquireStreamBuffer()
+	{
+		if (!m_stream_buffer_pool.empty()) {
+			ALuint buffer_id = m_stream_buffer_pool.back();
+			m_stream_buffer_pool.pop_back();
+			return buffer_id;
+		}
+		ALuint buffer_id;
+		alGenBuffers(1, &buffer_id);
+		return buffer_id;
+	}
+
+	// Returns processed buffers of a streamed source to the pool
+	void unqueueProcessedBuffers(PlayingSound *sound)
+	{
+		ALint processed = 0;
+		alGetSourcei(sound->source_id, AL_BUFFERS_PROCESSED, &processed);
+		while (processed-- > 0) {
+			ALuint buffer_id;
+			alSourceUnqueueBuffers(sound->source_id, 1, &buffer_id);
+			m_stream_buffer_pool.push_back(buffer_id);
+		}
+	}
+
+	// Moves decoded chunks onto the OpenAL queue of the source.
+	// The stream mutex must be held by the caller.
+	// Returns whether anything was queued.
+	bool queueStreamChunks(PlayingSound *sound)
+	{
+		SoundStream *stream = sound->stream.get();
+		bool queued = false;
+		while (!stream->chunks.empty()) {
+			std::vector<char> &chunk = stream->chunks.front();
+			ALuint buffer_id = acquireStreamBuffer();
+			alBufferData(buffer_id, stream->format, &chunk[0],
+					chunk.size(), stream->freq);
+			alSourceQueueBuffers(sound->source_id, 1, &buffer_id);
+			stream->chunks.pop_front();
+			queued = true;
+		}
+		return queued;
+	}
+
+	// Recycles exhausted stream buffers, queues freshly decoded chunks and
+	// keeps the decode thread fed
+	void serviceStreams()
+	{
+		for (auto &sp : m_sounds_playing) {
+			PlayingSound *sound = sp.second;
+			if (!sound->stream)
+				continue;
+			SoundStream *stream = sound->stream.get();
+
+			unqueueProcessedBuffers(sound);
+
+			bool queued;
+			{
+				MutexAutoLock lock(stream->mutex);
+				queued = queueStreamChunks(sound);
+				if (!stream->reached_end && !stream->queued_for_decode) {
+					stream->queued_for_decode = true;
+					m_stream_thread.queueForDecode(sound->stream);
+				}
+			}
+
+			// Restart the source if the decoder could not keep up
+			if (queued) {
+				ALint state;
+				alGetSourcei(sound->source_id, AL_SOURCE_STATE, &state);
+				if (state == AL_STOPPED)
+					alSourcePlay(sound->source_id);
+			}
+		}
+		warn_if_error(alGetError(), "serviceStreams");
+	}
+
+	// Whether a streamed sound has played all of its data
+	bool streamDrained(PlayingSound *sound)
+	{
+		SoundStream *stream = sound->stream.get();
+		{
+			MutexAutoLock lock(stream->mutex);
+			if (!stream->reached_end || !stream->chunks.empty())
+				return false;
+		}
+		ALint queued = 0;
+		alGetSourcei(sound->source_id, AL_BUFFERS_QUEUED, &queued);
+		return queued == 0;
 	}
 
 	void addBuffer(const std::string &name, SoundBuffer *buf)
@@ -388,6 +682,32 @@ public:
 		return bufs[j];
 	}
 
+	// Attaches the sound data to a fresh source: the static buffer for
+	// short sounds, or the first chunks of a new stream for long ones.
+	// Looping of streams is done by the decoder, not by OpenAL.
+	bool setSourceData(PlayingSound *sound, SoundBuffer *buf, bool loop)
+	{
+		if (!buf->streamed) {
+			alSourcei(sound->source_id, AL_BUFFER, buf->buffer_id);
+			alSourcei(sound->source_id, AL_LOOPING, loop ? AL_TRUE : AL_FALSE);
+			return true;
+		}
+
+		sound->stream = open_sound_stream(buf, loop);
+		if (!sound->stream)
+			return false;
+
+		// Decode just enough synchronously for playback to start without
+		// a gap; the decode thread takes over from step()
+		SoundStream *stream = sound->stream.get();
+		MutexAutoLock lock(stream->mutex);
+		while (!stream->reached_end && stream->chunks.size() < 2)
+			decode_stream_chunk(stream);
+		queueStreamChunks(sound);
+		alSourcei(sound->source_id, AL_LOOPING, AL_FALSE);
+		return true;
+	}
+
 	PlayingSound* createPlayingSound(SoundBuffer *buf, bool loop,
 			float volume, float pitch)
 	{
@@ -397,11 +717,14 @@ public:
 		assert(sound);
 		warn_if_error(alGetError(), "before createPlayingSound");
 		alGenSources(1, &sound->source_id);
-		alSourcei(sound->source_id, AL_BUFFER, buf->buffer_id);
+		if (!setSourceData(sound, buf, loop)) {
+			alDeleteSources(1, &sound->source_id);
+			delete sound;
+			return nullptr;
+		}
 		alSourcei(sound->source_id, AL_SOURCE_RELATIVE, true);
 		alSource3f(sound->source_id, AL_POSITION, 0, 0, 0);
 		alSource3f(sound->source_id, AL_VELOCITY, 0, 0, 0);
-		alSourcei(sound->source_id, AL_LOOPING, loop ? AL_TRUE : AL_FALSE);
 		volume = std::fmax(0.0f, volume);
 		alSourcef(sound->source_id, AL_GAIN, volume);
 		alSourcef(sound->source_id, AL_PITCH, pitch);
@@ -420,7 +743,11 @@ public:
 		assert(sound);
 		warn_if_error(alGetError(), "before createPlayingSoundAt");
 		alGenSources(1, &sound->source_id);
-		alSourcei(sound->source_id, AL_BUFFER, buf->buffer_id);
+		if (!setSourceData(sound, buf, loop)) {
+			alDeleteSources(1, &sound->source_id);
+			delete sound;
+			return nullptr;
+		}
 		alSourcei(sound->source_id, AL_SOURCE_RELATIVE, false);
 		alSource3f(sound->source_id, AL_POSITION, pos.X, pos.Y, pos.Z);
 		alSource3f(sound->source_id, AL_VELOCITY, 0, 0, 0);
@@ -428,7 +755,6 @@ public:
 		// distance to clamp gain at <1 node distance, to avoid excessive
 		// volume when closer
 		alSourcef(sound->source_id, AL_REFERENCE_DISTANCE, 10.0f);
-		alSourcei(sound->source_id, AL_LOOPING, loop ? AL_TRUE : AL_FALSE);
 		// Multiply by 3 to compensate for reducing AL_REFERENCE_DISTANCE from
 		// the previous value of 30 to the new value of 10
 		volume = std::fmax(0.0f, volume * 3.0f);
@@ -469,10 +795,17 @@ public:
 			return;
 		PlayingSound *sound = i->second;
 
+		if (sound->stream) {
+			// Stopping marks all queued buffers processed so they can
+			// go back to the pool
+			alSourceStop(sound->source_id);
+			unqueueProcessedBuffers(sound);
+		}
 		alDeleteSources(1, &sound->source_id);
 
 		delete sound;
 		m_sounds_playing.erase(id);
+		m_queued_sound_positions.erase(id);
 	}
 
 	/* If buffer does not exist, consult the fetcher */
@@ -510,6 +843,11 @@ public:
 				ALint state;
 				alGetSourcei(sound->source_id, AL_SOURCE_STATE, &state);
 				if(state != AL_PLAYING){
+					// Streamed sounds may momentarily underrun while the
+					// decode thread catches up; only reap them once the
+					// whole stream has been played
+					if (sound->stream && !streamDrained(sound))
+						continue;
 					del_list.insert(id);
 				}
 			}
@@ -643,15 +981,26 @@ public:
 
 	void updateSoundPosition(int id, v3f pos)
 	{
-		auto i = m_sounds_playing.find(id);
-		if (i == m_sounds_playing.end())
-			return;
-		PlayingSound *sound = i->second;
+		// Batched so per-object updates do not each poke OpenAL; applied
+		// once per step by flushSoundPositions()
+		m_queued_sound_positions[id] = pos;
+	}
 
-		alSourcei(sound->source_id, AL_SOURCE_RELATIVE, false);
-		alSource3f(sound->source_id, AL_POSITION, pos.X, pos.Y, pos.Z);
-		alSource3f(sound->source_id, AL_VELOCITY, 0, 0, 0);
-		alSourcef(sound->source_id, AL_REFERENCE_DISTANCE, 30.0);
+	void flushSoundPositions()
+	{
+		for (const auto &it : m_queued_sound_positions) {
+			auto i = m_sounds_playing.find(it.first);
+			if (i == m_sounds_playing.end())
+				continue;
+			PlayingSound *sound = i->second;
+			const v3f &pos = it.second;
+
+			alSourcei(sound->source_id, AL_SOURCE_RELATIVE, false);
+			alSource3f(sound->source_id, AL_POSITION, pos.X, pos.Y, pos.Z);
+			alSource3f(sound->source_id, AL_VELOCITY, 0, 0, 0);
+			alSourcef(sound->source_id, AL_REFERENCE_DISTANCE, 30.0);
+		}
+		m_queued_sound_positions.clear();
 	}
 
 	bool updateSoundGain(int id, float gain)
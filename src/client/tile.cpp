@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "tile.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <ICameraSceneNode.h>
 #include <IrrCompileConfig.h>
 #include "util/string.h"
@@ -33,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "imagefilters.h"
 #include "guiscalingfilter.h"
 #include "renderingengine.h"
+#include "util/memstats.h"
 
 
 #if ENABLE_GLES
@@ -196,13 +199,19 @@ struct TextureInfo
 
 /*
 	SourceImageCache: A cache used for storing source images.
+	Access is guarded internally, so it can be used from image
+	generation worker threads.
 */
 
 class SourceImageCache
 {
 public:
+	SourceImageCache() :
+		m_pool(g_memstats->registerPool("texture_source_images"))
+	{}
 	~SourceImageCache() {
 		for (auto &m_image : m_images) {
+			m_pool->sub(m_image.second->getImageDataSizeInBytes());
 			m_image.second->drop();
 		}
 		m_images.clear();
@@ -210,12 +219,15 @@ public:
 	void insert(const std::string &name, video::IImage *img, bool prefer_local)
 	{
 		assert(img); // Pre-condition
+		MutexAutoLock lock(m_mutex);
 		// Remove old image
 		std::map<std::string, video::IImage*>::iterator n;
 		n = m_images.find(name);
 		if (n != m_images.end()){
-			if (n->second)
+			if (n->second) {
+				m_pool->sub(n->second->getImageDataSizeInBytes());
 				n->second->drop();
+			}
 		}
 
 		video::IImage* toadd = img;
@@ -239,9 +251,11 @@ public:
 		if (need_to_grab)
 			toadd->grab();
 		m_images[name] = toadd;
+		m_pool->add(toadd->getImageDataSizeInBytes());
 	}
 	video::IImage* get(const std::string &name)
 	{
+		MutexAutoLock lock(m_mutex);
 		std::map<std::string, video::IImage*>::iterator n;
 		n = m_images.find(name);
 		if (n != m_images.end())
@@ -251,6 +265,7 @@ public:
 	// Primarily fetches from cache, secondarily tries to read from filesystem
 	video::IImage *getOrLoad(const std::string &name)
 	{
+		MutexAutoLock lock(m_mutex);
 		std::map<std::string, video::IImage*>::iterator n;
 		n = m_images.find(name);
 		if (n != m_images.end()){
@@ -270,12 +285,113 @@ public:
 
 		if (img){
 			m_images[name] = img;
+			m_pool->add(img->getImageDataSizeInBytes());
 			img->grab(); // Grab for caller
 		}
 		return img;
 	}
 private:
 	std::map<std::string, video::IImage*> m_images;
+	std::mutex m_mutex;
+	MemoryPool *m_pool;
+};
+
+/*
+	ImageGenCache: Memoizes intermediate results of texture modifier
+	chains, so a prefix shared by many tiles ("default_stone.png^...")
+	is only composited once. Entries are evicted oldest-first since
+	distinct modifier strings keep accumulating (e.g. crack stages).
+	Access is guarded internally, like SourceImageCache.
+*/
+
+class ImageGenCache
+{
+public:
+	ImageGenCache(size_t limit = 2048) :
+		m_limit(limit),
+		m_pool(g_memstats->registerPool("texture_gen_cache"))
+	{}
+
+	~ImageGenCache()
+	{
+		for (auto &image : m_images) {
+			m_pool->sub(image.second->getImageDataSizeInBytes());
+			image.second->drop();
+		}
+		m_images.clear();
+	}
+
+	// Returns a fresh copy of the cached image, which the caller owns
+	// and may modify, or NULL on a cache miss
+	video::IImage *get(const std::string &name)
+	{
+		MutexAutoLock lock(m_mutex);
+		std::map<std::string, video::IImage*>::iterator n =
+				m_images.find(name);
+		if (n == m_images.end())
+			return NULL;
+		return copyImage(n->second);
+	}
+
+	// Stores a copy of the image; the caller keeps its reference
+	void insert(const std::string &name, video::IImage *img)
+	{
+		assert(img); // Pre-condition
+		MutexAutoLock lock(m_mutex);
+		if (m_images.find(name) != m_images.end())
+			return;
+
+		while (m_images.size() >= m_limit) {
+			std::map<std::string, video::IImage*>::iterator n =
+					m_images.find(m_queue.front());
+			if (n != m_images.end()) {
+				m_pool->sub(n->second->getImageDataSizeInBytes());
+				n->second->drop();
+				m_images.erase(n);
+			}
+			m_queue.pop_front();
+		}
+
+		video::IImage *copy = copyImage(img);
+		m_images[name] = copy;
+		m_pool->add(copy->getImageDataSizeInBytes());
+		m_queue.push_back(name);
+	}
+
+private:
+	static video::IImage *copyImage(video::IImage *img)
+	{
+		video::IImage *copy = RenderingEngine::get_video_driver()->
+				createImage(img->getColorFormat(), img->getDimension());
+		img->copyTo(copy);
+		return copy;
+	}
+
+	size_t m_limit;
+	std::map<std::string, video::IImage*> m_images;
+	// Insertion order of the cached names, oldest first
+	std::deque<std::string> m_queue;
+	std::mutex m_mutex;
+	MemoryPool *m_pool;
+};
+
+/*
+	A texture upload marshalled to the main thread; the image was already
+	generated on the requesting worker thread.
+*/
+struct TextureUploadRequest
+{
+	std::string name;
+	video::IImage *img = nullptr;
+
+	bool operator==(const TextureUploadRequest &other) const
+	{
+		return name == other.name && img == other.img;
+	}
+	bool operator!=(const TextureUploadRequest &other) const
+	{
+		return !(*this == other);
+	}
 };
 
 /*
@@ -388,19 +504,29 @@ private:
 	std::thread::id m_main_thread;
 
 	// Cache of source images
-	// This should be only accessed from the main thread
+	// Guarded internally; safe from worker threads
 	SourceImageCache m_sourcecache;
 
+	// Memoized intermediate results of modifier chains
+	// Guarded internally; safe from worker threads
+	ImageGenCache m_gencache;
+
 	// Generate a texture
 	u32 generateTexture(const std::string &name);
 
+	// Create the GL texture for a ready image and enter it into the
+	// caches; takes over the image reference. NULL images get a NULL
+	// texture entry. Shall be called from the main thread.
+	u32 uploadTexture(const std::string &name, video::IImage *img);
+
 	// Generate image based on a string like "stone.png" or "[crack:1:0".
 	// if baseimg is NULL, it is created. Otherwise stuff is made on it.
 	bool generateImagePart(std::string part_of_name, video::IImage *& baseimg);
 
 	/*! Generates an image from a full string like
 	 * "stone.png^mineral_coal.png^[crack:1:0".
-	 * Shall be called from the main thread.
+	 * Involves only CPU-side Irrlicht calls, so it may be called from
+	 * any thread.
 	 * The returned Image should be dropped.
 	 */
 	video::IImage* generateImage(const std::string &name);
@@ -416,8 +542,15 @@ private:
 	// The two former containers are behind this mutex
 	std::mutex m_textureinfo_cache_mutex;
 
-	// Queued texture fetches (to be processed by the main thread)
-	RequestQueue<std::string, u32, u8, u8> m_get_texture_queue;
+	// Queued texture uploads (to be processed by the main thread)
+	RequestQueue<TextureUploadRequest, u32, u8, u8> m_texture_upload_queue;
+
+	// Result queues for the above, one per requesting thread. Owned by
+	// the texture source so that a result arriving after a requester has
+	// given up still has a valid destination.
+	std::map<std::thread::id, ResultQueue<TextureUploadRequest, u32, u8, u8>>
+			m_result_queues;
+	std::mutex m_result_queue_mutex;
 
 	// Textures that have been overwritten with other ones
 	// but can't be deleted because the ITexture* might still be used
@@ -425,6 +558,8 @@ private:
 
 	// Maps image file names to loaded palettes.
 	std::unordered_map<std::string, Palette> m_palettes;
+	// Protects the above; pointers into the map stay valid across inserts
+	std::mutex m_palettes_mutex;
 
 	// Cached settings needed for making textures from meshes
 	bool m_setting_trilinear_filter;
@@ -451,6 +586,12 @@ TextureSource::TextureSource()
 	m_setting_trilinear_filter = g_settings->getBool("trilinear_filter");
 	m_setting_bilinear_filter = g_settings->getBool("bilinear_filter");
 	m_setting_anisotropic_filter = g_settings->getBool("anisotropic_filter");
+
+#if ENABLE_GLES
+	// Prime the cached npot capability while the GL context is ours, so
+	// image generation on worker threads never issues a GL query
+	hasNPotSupport();
+#endif
 }
 
 TextureSource::~TextureSource()
@@ -475,6 +616,18 @@ TextureSource::~TextureSource()
 			<< driver->getTextureCount() << std::endl;
 }
 
+/*
+	Each thread that queues requests for the main thread gets its own
+	caller id, so that RequestQueue::add() does not merge concurrent
+	requests for the same name into a single waiter.
+*/
+static u8 get_texture_caller_id()
+{
+	static std::atomic<u8> next_id(1);
+	thread_local u8 caller_id = next_id.fetch_add(1);
+	return caller_id;
+}
+
 u32 TextureSource::getTextureId(const std::string &name)
 {
 	//infostream<<"getTextureId(): \""<<name<<"\""<<std::endl;
@@ -500,25 +653,40 @@ u32 TextureSource::getTextureId(const std::string &name)
 	}
 
 
-	infostream<<"getTextureId(): Queued: name=\""<<name<<"\""<<std::endl;
+	infostream<<"getTextureId(): Generating off-thread: name=\""<<name
+			<<"\""<<std::endl;
 
-	// We're gonna ask the result to be put into here
-	static ResultQueue<std::string, u32, u8, u8> result_queue;
+	// Image-level generation can run right here; only the GL upload has
+	// to go through the main thread
+	TextureUploadRequest upload;
+	upload.name = name;
+	upload.img = generateImage(name);
 
-	// Throw a request in
-	m_get_texture_queue.add(name, 0, 0, &result_queue);
+	// We're gonna ask the result to be put into here,
+	// one queue per requesting thread so that concurrent requests
+	// cannot consume each other's results
+	ResultQueue<TextureUploadRequest, u32, u8, u8> *result_queue;
+	{
+		MutexAutoLock lock(m_result_queue_mutex);
+		result_queue = &m_result_queues[std::this_thread::get_id()];
+	}
+
+	// Throw the upload in
+	m_texture_upload_queue.add(upload, get_texture_caller_id(), 0, result_queue);
 
 	try {
 		while(true) {
 			// Wait result for a second
-			GetResult<std::string, u32, u8, u8>
-				result = result_queue.pop_front(1000);
+			GetResult<TextureUploadRequest, u32, u8, u8>
+				result = result_queue->pop_front(1000);
 
-			if (result.key == name) {
+			if (result.key == upload) {
 				return result.item;
 			}
 		}
 	} catch(ItemNotFoundException &e) {
+		// The image is not leaked: the main thread still processes the
+		// request eventually and drops it
 		errorstream << "Waiting for texture " << name << " timed out." << std::endl;
 		return 0;
 	}
@@ -601,11 +769,29 @@ u32 TextureSource::generateTexture(const std::string &name)
 		return 0;
 	}
 
+	return uploadTexture(name, generateImage(name));
+}
+
+u32 TextureSource::uploadTexture(const std::string &name, video::IImage *img)
+{
+	{
+		/*
+			A worker may have raced us here with the same name; keep ids
+			unique per name
+		*/
+		MutexAutoLock lock(m_textureinfo_cache_mutex);
+		std::map<std::string, u32>::iterator n;
+		n = m_name_to_id.find(name);
+		if (n != m_name_to_id.end()) {
+			if (img)
+				img->drop();
+			return n->second;
+		}
+	}
+
 	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
 	sanity_check(driver);
 
-	video::IImage *img = generateImage(name);
-
 	video::ITexture *tex = NULL;
 
 	if (img != NULL) {
@@ -673,76 +859,82 @@ video::ITexture* TextureSource::getTextureForMesh(const std::string &name, u32 *
 
 Palette* TextureSource::getPalette(const std::string &name)
 {
-	// Only the main thread may load images
-	sanity_check(std::this_thread::get_id() == m_main_thread);
-
 	if (name.empty())
 		return NULL;
 
-	auto it = m_palettes.find(name);
-	if (it == m_palettes.end()) {
-		// Create palette
-		video::IImage *img = generateImage(name);
-		if (!img) {
-			warningstream << "TextureSource::getPalette(): palette \"" << name
-				<< "\" could not be loaded." << std::endl;
-			return NULL;
-		}
-		Palette new_palette;
-		u32 w = img->getDimension().Width;
-		u32 h = img->getDimension().Height;
-		// Real area of the image
-		u32 area = h * w;
-		if (area == 0)
-			return NULL;
-		if (area > 256) {
-			warningstream << "TextureSource::getPalette(): the specified"
-				<< " palette image \"" << name << "\" is larger than 256"
-				<< " pixels, using the first 256." << std::endl;
-			area = 256;
-		} else if (256 % area != 0)
-			warningstream << "TextureSource::getPalette(): the "
-				<< "specified palette image \"" << name << "\" does not "
-				<< "contain power of two pixels." << std::endl;
-		// We stretch the palette so it will fit 256 values
-		// This many param2 values will have the same color
-		u32 step = 256 / area;
-		// For each pixel in the image
-		for (u32 i = 0; i < area; i++) {
-			video::SColor c = img->getPixel(i % w, i / w);
-			// Fill in palette with 'step' colors
-			for (u32 j = 0; j < step; j++)
-				new_palette.push_back(c);
-		}
-		img->drop();
-		// Fill in remaining elements
-		while (new_palette.size() < 256)
-			new_palette.emplace_back(0xFFFFFFFF);
-		m_palettes[name] = new_palette;
-		it = m_palettes.find(name);
+	{
+		MutexAutoLock lock(m_palettes_mutex);
+		auto it = m_palettes.find(name);
+		if (it != m_palettes.end())
+			return &((*it).second);
 	}
-	if (it != m_palettes.end())
-		return &((*it).second);
-	return NULL;
+
+	// Create palette; image generation is CPU-side only, so this is
+	// fine from worker threads too
+	video::IImage *img = generateImage(name);
+	if (!img) {
+		warningstream << "TextureSource::getPalette(): palette \"" << name
+			<< "\" could not be loaded." << std::endl;
+		return NULL;
+	}
+	Palette new_palette;
+	u32 w = img->getDimension().Width;
+	u32 h = img->getDimension().Height;
+	// Real area of the image
+	u32 area = h * w;
+	if (area == 0)
+		return NULL;
+	if (area > 256) {
+		warningstream << "TextureSource::getPalette(): the specified"
+			<< " palette image \"" << name << "\" is larger than 256"
+			<< " pixels, using the first 256." << std::endl;
+		area = 256;
+	} else if (256 % area != 0)
+		warningstream << "TextureSource::getPalette(): the "
+			<< "specified palette image \"" << name << "\" does not "
+			<< "contain power of two pixels." << std::endl;
+	// We stretch the palette so it will fit 256 values
+	// This many param2 values will have the same color
+	u32 step = 256 / area;
+	// For each pixel in the image
+	for (u32 i = 0; i < area; i++) {
+		video::SColor c = img->getPixel(i % w, i / w);
+		// Fill in palette with 'step' colors
+		for (u32 j = 0; j < step; j++)
+			new_palette.push_back(c);
+	}
+	img->drop();
+	// Fill in remaining elements
+	while (new_palette.size() < 256)
+		new_palette.emplace_back(0xFFFFFFFF);
+
+	MutexAutoLock lock(m_palettes_mutex);
+	// Keep the entry another thread may have inserted meanwhile; others
+	// could already hold a pointer to it
+	auto it = m_palettes.find(name);
+	if (it == m_palettes.end())
+		it = m_palettes.emplace(name, std::move(new_palette)).first;
+	return &((*it).second);
 }
 
 void TextureSource::processQueue()
 {
 	/*
-		Fetch textures
+		Upload worker-generated images
 	*/
 	//NOTE this is only thread safe for ONE consumer thread!
-	if (!m_get_texture_queue.empty())
+	while (!m_texture_upload_queue.empty())
 	{
-		GetRequest<std::string, u32, u8, u8>
-				request = m_get_texture_queue.pop();
+		GetRequest<TextureUploadRequest, u32, u8, u8>
+				request = m_texture_upload_queue.pop();
 
 		/*infostream<<"TextureSource::processQueue(): "
-				<<"got texture request with "
-				<<"name=\""<<request.key<<"\""
+				<<"got upload request with "
+				<<"name=\""<<request.key.name<<"\""
 				<<std::endl;*/
 
-		m_get_texture_queue.pushResult(request, generateTexture(request.key));
+		m_texture_upload_queue.pushResult(request,
+				uploadTexture(request.key.name, request.key.img));
 	}
 }
 
@@ -904,6 +1096,12 @@ static video::IImage *createInventoryCubeImage(
 
 video::IImage* TextureSource::generateImage(const std::string &name)
 {
+	// Shared modifier-chain prefixes are composited over and over across
+	// node tiles; hand out a copy of the memoized result when available
+	video::IImage *cached = m_gencache.get(name);
+	if (cached)
+		return cached;
+
 	// Get the base image
 
 	const char separator = '^';
@@ -1000,6 +1198,11 @@ video::IImage* TextureSource::generateImage(const std::string &name)
 				" create texture \"" << name << "\")" << std::endl;
 	}
 
+	// Plain source names are already cached by m_sourcecache; memoize
+	// composites so they can serve as prefixes of longer chains
+	if (baseimg && last_separator_pos != -1)
+		m_gencache.insert(name, baseimg);
+
 	return baseimg;
 }
 
@@ -164,6 +164,9 @@ enum MaterialType{
 //#define MATERIAL_FLAG_HIGHLIGHTED 0x10
 #define MATERIAL_FLAG_TILEABLE_HORIZONTAL 0x20
 #define MATERIAL_FLAG_TILEABLE_VERTICAL 0x40
+// The animation frames are stacked vertically in the base texture, so the
+// shader can select the frame instead of the CPU swapping frame textures
+#define MATERIAL_FLAG_ANIMATION_VERTICAL_FRAMES 0x80
 
 /*
 	This fully defines the looks of a tile.
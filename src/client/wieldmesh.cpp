@@ -192,6 +192,62 @@ private:
 
 ExtrusionMeshCache *g_extrusion_mesh_cache = NULL;
 
+/*
+	Caches fully built wield meshes by item name, so that many scene
+	nodes showing the same item (e.g. a field of dropped stacks) do not
+	each rebuild the geometry and materials from scratch. The cached
+	mesh is still cloned per scene node, because setColor() bakes
+	per-node lighting into the vertex colors; the build work is shared,
+	the vertex buffers are not.
+
+	WARNING: Not thread safe (see ExtrusionMeshCache above).
+*/
+struct WieldMeshPrototype
+{
+	// nullptr means "item has no wield mesh"
+	scene::SMesh *mesh = nullptr;
+	std::vector<ItemPartColor> colors;
+	v3f scale;
+};
+
+class WieldMeshCache : public IReferenceCounted
+{
+public:
+	virtual ~WieldMeshCache()
+	{
+		for (auto &it : m_cache) {
+			if (it.second.mesh)
+				it.second.mesh->drop();
+		}
+	}
+
+	// Returns nullptr if no prototype was stored for this key yet
+	const WieldMeshPrototype *get(const std::string &key)
+	{
+		auto it = m_cache.find(key);
+		if (it == m_cache.end())
+			return nullptr;
+		return &it->second;
+	}
+
+	// Takes over the ownership of proto.mesh
+	void put(const std::string &key, const WieldMeshPrototype &proto)
+	{
+		auto it = m_cache.find(key);
+		if (it != m_cache.end()) {
+			if (it->second.mesh)
+				it->second.mesh->drop();
+			m_cache.erase(it);
+		}
+		m_cache[key] = proto;
+	}
+
+private:
+	std::map<std::string, WieldMeshPrototype> m_cache;
+};
+
+WieldMeshCache *g_wield_mesh_cache = nullptr;
+
 
 WieldMeshSceneNode::WieldMeshSceneNode(scene::ISceneManager *mgr, s32 id, bool lighting):
 	scene::ISceneNode(mgr->getRootSceneNode(), mgr, id),
@@ -210,6 +266,12 @@ WieldMeshSceneNode::WieldMeshSceneNode(scene::ISceneManager *mgr, s32 id, bool l
 	else
 		g_extrusion_mesh_cache->grab();
 
+	// The wield mesh cache has the same lifetime
+	if (!g_wield_mesh_cache)
+		g_wield_mesh_cache = new WieldMeshCache();
+	else
+		g_wield_mesh_cache->grab();
+
 	// Disable bounding box culling for this scene node
 	// since we won't calculate the bounding box.
 	setAutomaticCulling(scene::EAC_OFF);
@@ -227,6 +289,9 @@ WieldMeshSceneNode::~WieldMeshSceneNode()
 	sanity_check(g_extrusion_mesh_cache);
 	if (g_extrusion_mesh_cache->drop())
 		g_extrusion_mesh_cache = nullptr;
+	sanity_check(g_wield_mesh_cache);
+	if (g_wield_mesh_cache->drop())
+		g_wield_mesh_cache = nullptr;
 }
 
 void WieldMeshSceneNode::setCube(const ContentFeatures &f,
@@ -335,6 +400,61 @@ scene::SMesh *createSpecialNodeMesh(Client *client, content_t id, std::vector<It
 }
 
 void WieldMeshSceneNode::setItem(const ItemStack &item, Client *client, bool check_wield_image)
+{
+	IItemDefManager *idef = client->getItemDefManager();
+	const ItemDefinition &def = item.getDefinition(idef);
+
+	// One prototype per item name and wield flag is enough: the wield
+	// image, scale etc. are all part of the item definition
+	std::string cache_key;
+	if (!def.name.empty())
+		cache_key = def.name + (check_wield_image ? "|w" : "|i");
+
+	if (!cache_key.empty()) {
+		const WieldMeshPrototype *proto = g_wield_mesh_cache->get(cache_key);
+		if (proto) {
+			m_colors = proto->colors;
+			m_base_color = idef->getItemstackColor(item, client);
+			if (proto->mesh) {
+				scene::SMesh *copy = cloneMesh(proto->mesh);
+				// cloneMeshBuffer() does not copy materials
+				for (u32 i = 0; i < copy->getMeshBufferCount(); i++)
+					copy->getMeshBuffer(i)->getMaterial() =
+						proto->mesh->getMeshBuffer(i)->getMaterial();
+				changeToMesh(copy);
+				copy->drop();
+				m_meshnode->setScale(proto->scale);
+			} else {
+				changeToMesh(nullptr);
+			}
+			return;
+		}
+	}
+
+	setItemUncached(item, client, check_wield_image);
+
+	if (cache_key.empty())
+		return;
+
+	// Store the built result for the next scene node showing this item
+	WieldMeshPrototype proto;
+	if (!m_mesh_null) {
+		proto.mesh = cloneMesh(m_meshnode->getMesh());
+		// Bake the customized scene node materials into the cached mesh
+		// buffers; setMesh() copies them out again on a cache hit
+		u32 mc = MYMIN(proto.mesh->getMeshBufferCount(),
+				m_meshnode->getMaterialCount());
+		for (u32 i = 0; i < mc; i++)
+			proto.mesh->getMeshBuffer(i)->getMaterial() =
+				m_meshnode->getMaterial(i);
+		proto.scale = m_meshnode->getScale();
+	}
+	proto.colors = m_colors;
+	g_wield_mesh_cache->put(cache_key, proto);
+}
+
+void WieldMeshSceneNode::setItemUncached(const ItemStack &item, Client *client,
+	bool check_wield_image)
 {
 	ITextureSource *tsrc = client->getTextureSource();
 	IItemDefManager *idef = client->getItemDefManager();
@@ -479,6 +599,7 @@ void WieldMeshSceneNode::render()
 
 void WieldMeshSceneNode::changeToMesh(scene::IMesh *mesh)
 {
+	m_mesh_null = (mesh == nullptr);
 	if (!mesh) {
 		scene::IMesh *dummymesh = g_extrusion_mesh_cache->createCube();
 		m_meshnode->setVisible(false);
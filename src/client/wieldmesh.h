@@ -80,6 +80,8 @@ public:
 	void setCube(const ContentFeatures &f, v3f wield_scale);
 	void setExtruded(const std::string &imagename, const std::string &overlay_image,
 			v3f wield_scale, ITextureSource *tsrc, u8 num_frames);
+	// Shows the wield mesh of the given item, building it through the
+	// global wield mesh cache (one build per item name, cloned per node)
 	void setItem(const ItemStack &item, Client *client,
 			bool check_wield_image = true);
 
@@ -94,11 +96,16 @@ public:
 	virtual const aabb3f &getBoundingBox() const { return m_bounding_box; }
 
 private:
+	// Builds the wield mesh without consulting the cache
+	void setItemUncached(const ItemStack &item, Client *client,
+			bool check_wield_image);
 	void changeToMesh(scene::IMesh *mesh);
 
 	// Child scene node with the current wield mesh
 	scene::IMeshSceneNode *m_meshnode = nullptr;
 	video::E_MATERIAL_TYPE m_material_type;
+	// Whether the node currently shows the "no mesh" dummy
+	bool m_mesh_null = true;
 
 	// True if EMF_LIGHTING should be enabled.
 	bool m_lighting;
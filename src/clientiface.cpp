@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <sstream>
 #include "clientiface.h"
+#include "util/tunables.h"
 #include "network/connection.h"
 #include "network/serveropcodes.h"
 #include "remoteplayer.h"
@@ -30,6 +31,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "content_sao.h"              // TODO this is used for cleanup of only
 #include "log.h"
 #include "util/srp.h"
+#include "util/directiontables.h"
 #include "face_position_cache.h"
 
 const char *ClientInterface::statenames[] = {
@@ -53,7 +55,6 @@ std::string ClientInterface::state2Name(ClientState state)
 }
 
 RemoteClient::RemoteClient() :
-	m_max_simul_sends(g_settings->getU16("max_simultaneous_block_sends_per_client")),
 	m_min_time_from_building(
 		g_settings->getFloat("full_block_send_enable_min_time_from_building")),
 	m_max_send_distance(g_settings->getS16("max_block_send_distance")),
@@ -63,6 +64,15 @@ RemoteClient::RemoteClient() :
 {
 }
 
+u16 RemoteClient::getMaxSimulSends() const
+{
+	static TunableInt *tune_max_simul_sends = g_tunables->registerInt(
+			"max_simultaneous_block_sends_per_client",
+			g_settings->getU16("max_simultaneous_block_sends_per_client"),
+			1, 4096, "Block send window per client");
+	return tune_max_simul_sends->get();
+}
+
 void RemoteClient::ResendBlockIfOnWire(v3s16 p)
 {
 	// if this block is on wire, mark it for sending again as soon as possible
@@ -112,7 +122,7 @@ void RemoteClient::GetNextBlocks (
 		return;
 
 	// Won't send anything if already sending
-	if (m_blocks_sending.size() >= m_max_simul_sends) {
+	if (m_blocks_sending.size() >= getMaxSimulSends()) {
 		//infostream<<"Not sending any blocks, Queue full."<<std::endl;
 		return;
 	}
@@ -131,6 +141,22 @@ void RemoteClient::GetNextBlocks (
 
 	v3s16 center = getNodeBlockPos(center_nodepos);
 
+	/*
+		Ask the map to read blocks a few seconds ahead of fast movement,
+		so they are already cached when the search below reaches them.
+	*/
+	if (playerspeed.getLength() > 5.0f * BS) {
+		v3s16 prefetch_center = getNodeBlockPos(
+				floatToInt(playerpos + playerspeed * 2.0f, BS));
+		if (prefetch_center != m_last_prefetch_center) {
+			m_last_prefetch_center = prefetch_center;
+			ServerMap &map = env->getServerMap();
+			map.queuePrefetch(prefetch_center);
+			for (const v3s16 &dir : g_6dirs)
+				map.queuePrefetch(prefetch_center + dir);
+		}
+	}
+
 	// Camera position and direction
 	v3f camera_pos = sao->getEyePosition();
 	v3f camera_dir = v3f(0,0,1);
@@ -147,6 +173,7 @@ void RemoteClient::GetNextBlocks (
 	if (m_last_center != center) {
 		m_nearest_unsent_d = 0;
 		m_last_center = center;
+		clearSendQueue();
 	}
 
 	/*infostream<<"m_nearest_unsent_reset_timer="
@@ -156,6 +183,7 @@ void RemoteClient::GetNextBlocks (
 	if (m_nearest_unsent_reset_timer > 20.0f) {
 		m_nearest_unsent_reset_timer = 0.0f;
 		m_nearest_unsent_d = 0;
+		clearSendQueue();
 		//infostream<<"Resetting m_nearest_unsent_d for "
 		//		<<server->getPlayerName(peer_id)<<std::endl;
 	}
@@ -165,7 +193,7 @@ void RemoteClient::GetNextBlocks (
 
 	//infostream<<"d_start="<<d_start<<std::endl;
 
-	u16 max_simul_sends_usually = m_max_simul_sends;
+	u16 max_simul_sends_usually = getMaxSimulSends();
 
 	/*
 		Check the time from last addNode/removeNode.
@@ -235,15 +263,70 @@ void RemoteClient::GetNextBlocks (
 
 	const v3s16 cam_pos_nodes = floatToInt(camera_pos, BS);
 
+	/*
+		Drain candidates left over from the previous spiral walk before
+		walking the spiral again. The cheap validity checks are redone
+		because the blocks and the camera may have changed meanwhile.
+	*/
+	while (!m_send_queue.empty()) {
+		u16 max_simul_dynamic = max_simul_sends_usually;
+		if (m_send_queue.top().d <= BLOCK_SEND_DISABLE_LIMITS_MAX_D)
+			max_simul_dynamic = getMaxSimulSends();
+		if (num_blocks_selected >= max_simul_dynamic)
+			break;
+
+		QueuedBlockSend c = m_send_queue.top();
+		m_send_queue.pop();
+		v3s16 p = c.pos;
+
+		if (m_blocks_sending.find(p) != m_blocks_sending.end() ||
+				m_blocks_sent.find(p) != m_blocks_sent.end())
+			continue;
+
+		f32 dist;
+		if (!(isBlockInSight(p, camera_pos, camera_dir, camera_fov,
+					d_blocks_in_sight, &dist) ||
+				(playerspeed.getLength() > 1.0f * BS &&
+				isBlockInSight(p, camera_pos, playerspeeddir, 0.1f,
+					d_blocks_in_sight))))
+			continue;
+
+		MapBlock *block = env->getMap().getBlockNoCreateNoEx(p);
+		if (!block || block->isDummy() || !block->isGenerated())
+			continue;
+
+		block->resetUsageTimer();
+
+		if (c.d >= d_opt && !block->getIsUnderground() &&
+				!block->getDayNightDiff())
+			continue;
+
+		if (m_occ_cull &&
+				env->getMap().isBlockOccluded(block, cam_pos_nodes))
+			continue;
+
+		dest.emplace_back((float)dist, p, peer_id);
+		num_blocks_selected += 1;
+	}
+
+	// While candidates remain queued the spiral walk would only find
+	// them again, so don't redo it.
+	if (!m_send_queue.empty())
+		return;
+
+	// Fill the queue with enough lookahead to cover the throttled ticks
+	// until the next walk.
+	const size_t send_queue_max = 4 * (size_t)max_simul_sends_usually;
+
 	s16 d;
 	for (d = d_start; d <= d_max; d++) {
 		/*
 			Get the border/face dot coordinates of a "d-radiused"
 			box
 		*/
-		std::vector<v3s16> list = FacePositionCache::getFacePositions(d);
+		const std::vector<v3s16> &list = FacePositionCache::getFacePositions(d);
 
-		std::vector<v3s16>::iterator li;
+		std::vector<v3s16>::const_iterator li;
 		for (li = list.begin(); li != list.end(); ++li) {
 			v3s16 p = *li + center;
 
@@ -260,12 +343,19 @@ void RemoteClient::GetNextBlocks (
 
 			// If block is very close, allow full maximum
 			if (d <= BLOCK_SEND_DISABLE_LIMITS_MAX_D)
-				max_simul_dynamic = m_max_simul_sends;
+				max_simul_dynamic = getMaxSimulSends();
 
-			// Don't select too many blocks for sending
+			// When the send limit is reached, keep walking to collect
+			// lookahead candidates into m_send_queue instead of
+			// stopping, so the next calls don't redo this walk.
+			bool overflow = false;
 			if (num_blocks_selected >= max_simul_dynamic) {
-				//queue_is_full = true;
-				goto queue_full_break;
+				if (m_send_queue.size() >= send_queue_max)
+					goto queue_full_break;
+				overflow = true;
+				// Resume the next full walk from here, as before
+				if (nearest_sent_d == -1)
+					nearest_sent_d = d;
 			}
 
 			// Don't send blocks that are currently being transferred
@@ -353,8 +443,13 @@ void RemoteClient::GetNextBlocks (
 
 			/*
 				Add inexistent block to emerge queue.
+				In overflow mode nothing is emerged; the resumed walk
+				handles these blocks, exactly as when the walk used to
+				stop at the send limit.
 			*/
 			if (block == NULL || surely_not_found_on_disk || block_is_invalid) {
+				if (overflow)
+					continue;
 				if (emerge->enqueueBlockEmerge(peer_id, p, generate)) {
 					if (nearest_emerged_d == -1)
 						nearest_emerged_d = d;
@@ -371,6 +466,12 @@ void RemoteClient::GetNextBlocks (
 			if (nearest_sent_d == -1)
 				nearest_sent_d = d;
 
+			if (overflow) {
+				// Remember the block for the following ticks
+				m_send_queue.push({(float)dist, d, p});
+				continue;
+			}
+
 			/*
 				Add block to send queue
 			*/
@@ -391,8 +492,12 @@ queue_full_break:
 		new_nearest_unsent_d = nearest_emergefull_d;
 	} else {
 		if (d > full_d_max) {
-			new_nearest_unsent_d = 0;
-			m_nothing_to_send_pause_timer = 2.0f;
+			if (m_send_queue.empty()) {
+				new_nearest_unsent_d = 0;
+				m_nothing_to_send_pause_timer = 2.0f;
+			} else if (nearest_sent_d != -1) {
+				new_nearest_unsent_d = nearest_sent_d;
+			}
 		} else {
 			if (nearest_sent_d != -1)
 				new_nearest_unsent_d = nearest_sent_d;
@@ -433,6 +538,7 @@ void RemoteClient::SetBlockNotSent(v3s16 p)
 {
 	m_nearest_unsent_d = 0;
 	m_nothing_to_send_pause_timer = 0;
+	clearSendQueue();
 
 	if (m_blocks_sending.find(p) != m_blocks_sending.end())
 		m_blocks_sending.erase(p);
@@ -445,6 +551,7 @@ void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 {
 	m_nearest_unsent_d = 0;
 	m_nothing_to_send_pause_timer = 0;
+	clearSendQueue();
 
 	for (auto &block : blocks) {
 		v3s16 p = block.first;
@@ -457,6 +564,19 @@ void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 	}
 }
 
+void RemoteClient::SetBlocksNotSent(const std::set<v3s16> &blocks)
+{
+	m_nearest_unsent_d = 0;
+	m_nothing_to_send_pause_timer = 0;
+	clearSendQueue();
+
+	for (const v3s16 &p : blocks) {
+		m_blocks_modified.insert(p);
+		m_blocks_sending.erase(p);
+		m_blocks_sent.erase(p);
+	}
+}
+
 void RemoteClient::notifyEvent(ClientStateEvent event)
 {
 	std::ostringstream myerror;
@@ -638,19 +758,31 @@ ClientInterface::~ClientInterface()
 	{
 		RecursiveMutexAutoLock clientslock(m_clients_mutex);
 
-		for (auto &client_it : m_clients) {
-			// Delete client
-			delete client_it.second;
-		}
+		// Clients are freed when the last snapshot referencing them goes away
+		m_clients.clear();
+		updateClientSnapshot();
 	}
 }
 
+std::shared_ptr<const RemoteClientMap> ClientInterface::getClientSnapshot()
+{
+	MutexAutoLock snaplock(m_snapshot_mutex);
+	return m_clients_snapshot;
+}
+
+void ClientInterface::updateClientSnapshot()
+{
+	auto snapshot = std::make_shared<RemoteClientMap>(m_clients);
+	MutexAutoLock snaplock(m_snapshot_mutex);
+	m_clients_snapshot = std::move(snapshot);
+}
+
 std::vector<session_t> ClientInterface::getClientIDs(ClientState min_state)
 {
 	std::vector<session_t> reply;
-	RecursiveMutexAutoLock clientslock(m_clients_mutex);
+	auto clients = getClientSnapshot();
 
-	for (const auto &m_client : m_clients) {
+	for (const auto &m_client : *clients) {
 		if (m_client.second->getState() >= min_state)
 			reply.push_back(m_client.second->peer_id);
 	}
@@ -660,13 +792,25 @@ std::vector<session_t> ClientInterface::getClientIDs(ClientState min_state)
 
 void ClientInterface::markBlockposAsNotSent(const v3s16 &pos)
 {
-	RecursiveMutexAutoLock clientslock(m_clients_mutex);
-	for (const auto &client : m_clients) {
+	auto clients = getClientSnapshot();
+	for (const auto &client : *clients) {
 		if (client.second->getState() >= CS_Active)
 			client.second->SetBlockNotSent(pos);
 	}
 }
 
+void ClientInterface::markBlockposAsNotSent(const std::set<v3s16> &positions)
+{
+	if (positions.empty())
+		return;
+
+	auto clients = getClientSnapshot();
+	for (const auto &client : *clients) {
+		if (client.second->getState() >= CS_Active)
+			client.second->SetBlocksNotSent(positions);
+	}
+}
+
 /**
  * Verify if user limit was reached.
  * User limit count all clients from HelloSent state (MT protocol user) to Active state
@@ -724,9 +868,11 @@ void ClientInterface::send(session_t peer_id, u8 channelnum,
 
 void ClientInterface::sendToAll(NetworkPacket *pkt)
 {
-	RecursiveMutexAutoLock clientslock(m_clients_mutex);
-	for (auto &client_it : m_clients) {
-		RemoteClient *client = client_it.second;
+	// Iterate a snapshot so concurrent sends and per-client state
+	// lookups do not contend on m_clients_mutex
+	auto clients = getClientSnapshot();
+	for (auto &client_it : *clients) {
+		RemoteClient *client = client_it.second.get();
 
 		if (client->net_proto_version != 0) {
 			m_con->Send(client->peer_id,
@@ -739,9 +885,9 @@ void ClientInterface::sendToAll(NetworkPacket *pkt)
 void ClientInterface::sendToAllCompat(NetworkPacket *pkt, NetworkPacket *legacypkt,
 		u16 min_proto_ver)
 {
-	RecursiveMutexAutoLock clientslock(m_clients_mutex);
-	for (auto &client_it : m_clients) {
-		RemoteClient *client = client_it.second;
+	auto clients = getClientSnapshot();
+	for (auto &client_it : *clients) {
+		RemoteClient *client = client_it.second.get();
 		NetworkPacket *pkt_to_send = nullptr;
 
 		if (client->net_proto_version >= min_proto_ver) {
@@ -763,15 +909,15 @@ void ClientInterface::sendToAllCompat(NetworkPacket *pkt, NetworkPacket *legacyp
 
 RemoteClient* ClientInterface::getClientNoEx(session_t peer_id, ClientState state_min)
 {
-	RecursiveMutexAutoLock clientslock(m_clients_mutex);
-	RemoteClientMap::const_iterator n = m_clients.find(peer_id);
+	auto clients = getClientSnapshot();
+	RemoteClientMap::const_iterator n = clients->find(peer_id);
 	// The client may not exist; clients are immediately removed if their
 	// access is denied, and this event occurs later then.
-	if (n == m_clients.end())
+	if (n == clients->end())
 		return NULL;
 
 	if (n->second->getState() >= state_min)
-		return n->second;
+		return n->second.get();
 
 	return NULL;
 }
@@ -785,18 +931,18 @@ RemoteClient* ClientInterface::lockedGetClientNoEx(session_t peer_id, ClientStat
 		return NULL;
 
 	if (n->second->getState() >= state_min)
-		return n->second;
+		return n->second.get();
 
 	return NULL;
 }
 
 ClientState ClientInterface::getClientState(session_t peer_id)
 {
-	RecursiveMutexAutoLock clientslock(m_clients_mutex);
-	RemoteClientMap::const_iterator n = m_clients.find(peer_id);
+	auto clients = getClientSnapshot();
+	RemoteClientMap::const_iterator n = clients->find(peer_id);
 	// The client may not exist; clients are immediately removed if their
 	// access is denied, and this event occurs later then.
-	if (n == m_clients.end())
+	if (n == clients->end())
 		return CS_Invalid;
 
 	return n->second->getState();
@@ -827,7 +973,7 @@ void ClientInterface::DeleteClient(session_t peer_id)
 		Mark objects to be not known by the client
 	*/
 	//TODO this should be done by client destructor!!!
-	RemoteClient *client = n->second;
+	RemoteClient *client = n->second.get();
 	// Handle objects
 	for (u16 id : client->m_known_objects) {
 		// Get object
@@ -837,9 +983,10 @@ void ClientInterface::DeleteClient(session_t peer_id)
 			obj->m_known_by_count--;
 	}
 
-	// Delete client
-	delete m_clients[peer_id];
+	// Remove the client; it is freed when the last snapshot that still
+	// references it goes away
 	m_clients.erase(peer_id);
+	updateClientSnapshot();
 }
 
 void ClientInterface::CreateClient(session_t peer_id)
@@ -852,9 +999,10 @@ void ClientInterface::CreateClient(session_t peer_id)
 	if (n != m_clients.end()) return;
 
 	// Create client
-	RemoteClient *client = new RemoteClient();
+	auto client = std::make_shared<RemoteClient>();
 	client->peer_id = peer_id;
 	m_clients[client->peer_id] = client;
+	updateClientSnapshot();
 }
 
 void ClientInterface::event(session_t peer_id, ClientStateEvent event)
@@ -881,13 +1029,13 @@ void ClientInterface::event(session_t peer_id, ClientStateEvent event)
 
 u16 ClientInterface::getProtocolVersion(session_t peer_id)
 {
-	RecursiveMutexAutoLock conlock(m_clients_mutex);
+	auto clients = getClientSnapshot();
 
 	// Error check
-	RemoteClientMap::iterator n = m_clients.find(peer_id);
+	RemoteClientMap::const_iterator n = clients->find(peer_id);
 
 	// No client to get version
-	if (n == m_clients.end())
+	if (n == clients->end())
 		return 0;
 
 	return n->second->net_proto_version;
@@ -27,9 +27,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/networkprotocol.h"
 #include "porting.h"
 
+#include "util/numeric.h"              // for v3s16Hash
 #include <list>
 #include <vector>
+#include <queue>
 #include <set>
+#include <unordered_set>
+#include <unordered_map>
+#include <memory>
 #include <mutex>
 
 class MapBlock;
@@ -240,6 +245,9 @@ public:
 	void *auth_data = nullptr;
 	u32 allowed_auth_mechs = 0;
 	u32 allowed_sudo_mechs = 0;
+	// Single-use challenge sent in TOCLIENT_HELLO when
+	// AUTH_MECHANISM_SESSION_KEY is offered
+	std::string reauth_challenge = "";
 
 	bool isSudoMechAllowed(AuthMechanism mech)
 	{ return allowed_sudo_mechs & mech; }
@@ -263,6 +271,7 @@ public:
 
 	void SetBlockNotSent(v3s16 p);
 	void SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks);
+	void SetBlocksNotSent(const std::set<v3s16> &blocks);
 
 	/**
 	 * tell client about this block being modified right now.
@@ -272,6 +281,32 @@ public:
 	 */
 	void ResendBlockIfOnWire(v3s16 p);
 
+	/*
+		Delta block sending: remembers at which MapBlock change counter
+		the client last received each block (fully or as a delta), so a
+		resend can carry only the nodes changed since then.
+	*/
+	void setBlockSyncCounter(v3s16 p, u32 counter)
+	{
+		m_block_sync_counters[p] = counter;
+	}
+
+	bool getBlockSyncCounter(v3s16 p, u32 *counter) const
+	{
+		auto it = m_block_sync_counters.find(p);
+		if (it == m_block_sync_counters.end())
+			return false;
+		*counter = it->second;
+		return true;
+	}
+
+	// Forces the next send of the block to be a full one (the client
+	// deleted the block, or it needs data a delta cannot carry)
+	void resetBlockSyncCounter(v3s16 p)
+	{
+		m_block_sync_counters.erase(p);
+	}
+
 	u32 getSendingCount() const { return m_blocks_sending.size(); }
 
 	bool isBlockSent(v3s16 p) const
@@ -351,15 +386,53 @@ private:
 		- A block is cleared from here when client says it has
 		  deleted it from it's memory
 
-		List of block positions.
+		Hash set of block positions; every GetNextBlocks() candidate
+		probes it, so lookups need to be constant time.
 		No MapBlock* is stored here because the blocks can get deleted.
 	*/
-	std::set<v3s16> m_blocks_sent;
+	std::unordered_set<v3s16, v3s16Hash> m_blocks_sent;
+
+	/*
+		MapBlock change counter at the time each block was last sent to
+		this client; see setBlockSyncCounter().
+	*/
+	std::unordered_map<v3s16, u32, v3s16Hash> m_block_sync_counters;
+
 	s16 m_nearest_unsent_d = 0;
 	v3s16 m_last_center;
+	// Last predicted block position handed to the map prefetcher
+	v3s16 m_last_prefetch_center;
 	float m_nearest_unsent_reset_timer = 0.0f;
 
-	const u16 m_max_simul_sends;
+	/*
+		Sendable blocks found by the last spiral walk that could not be
+		selected yet due to send throttling. Drained on later calls
+		before the spiral is walked again; invalidated whenever the walk
+		is restarted (center change, periodic reset, blocks marked not
+		sent).
+	*/
+	struct QueuedBlockSend
+	{
+		float dist;
+		s16 d; // distance ring the block was found on
+		v3s16 pos;
+
+		bool operator<(const QueuedBlockSend &other) const
+		{
+			// Make std::priority_queue yield the nearest block first
+			return dist > other.dist;
+		}
+	};
+	std::priority_queue<QueuedBlockSend> m_send_queue;
+
+	void clearSendQueue()
+	{
+		std::priority_queue<QueuedBlockSend>().swap(m_send_queue);
+	}
+
+	// Send window cap; reads the shared runtime tunable
+	u16 getMaxSimulSends() const;
+
 	const float m_min_time_from_building;
 	const s16 m_max_send_distance;
 	const s16 m_block_optimize_distance;
@@ -374,7 +447,7 @@ private:
 		Block is removed when GOTBLOCKS is received.
 		Value is time from sending. (not used at the moment)
 	*/
-	std::map<v3s16, float> m_blocks_sending;
+	std::unordered_map<v3s16, float, v3s16Hash> m_blocks_sending;
 
 	/*
 		Blocks that have been modified since last sending them.
@@ -382,9 +455,9 @@ private:
 		client reports it has received them to account for blocks
 		that are being modified while on the line.
 
-		List of block positions.
+		Hash set of block positions.
 	*/
-	std::set<v3s16> m_blocks_modified;
+	std::unordered_set<v3s16, v3s16Hash> m_blocks_modified;
 
 	/*
 		Count of excess GotBlocks().
@@ -420,7 +493,7 @@ private:
 	const u64 m_connection_time = porting::getTimeS();
 };
 
-typedef std::unordered_map<u16, RemoteClient*> RemoteClientMap;
+typedef std::unordered_map<u16, std::shared_ptr<RemoteClient>> RemoteClientMap;
 
 class ClientInterface {
 public:
@@ -439,6 +512,10 @@ public:
 	/* mark block as not sent to active client sessions */
 	void markBlockposAsNotSent(const v3s16 &pos);
 
+	/* bulk version of the above: one client pass for a whole batch of
+	 * invalidated blocks */
+	void markBlockposAsNotSent(const std::set<v3s16> &positions);
+
 	/* verify is server user limit was reached */
 	bool isUserLimitReached();
 
@@ -499,11 +576,26 @@ private:
 	/* update internal player list */
 	void UpdatePlayerList();
 
+	/*
+		Returns the current immutable snapshot of the client map.
+		Broadcasts and read-only lookups iterate this without taking
+		m_clients_mutex; the shared_ptr entries keep clients alive even
+		if they are deleted mid-iteration on another thread.
+	*/
+	std::shared_ptr<const RemoteClientMap> getClientSnapshot();
+
+	/* rebuild the snapshot; call with m_clients_mutex held */
+	void updateClientSnapshot();
+
 	// Connection
 	std::shared_ptr<con::Connection> m_con;
 	std::recursive_mutex m_clients_mutex;
 	// Connected clients (behind the con mutex)
 	RemoteClientMap m_clients;
+	// Immutable snapshot of m_clients, swapped out on every change
+	std::shared_ptr<const RemoteClientMap> m_clients_snapshot =
+			std::make_shared<RemoteClientMap>();
+	std::mutex m_snapshot_mutex;
 	std::vector<std::string> m_clients_names; //for announcing masterserver
 
 	// Environment
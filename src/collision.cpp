@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "collision.h"
+#include <algorithm>
 #include <cmath>
 #include "mapblock.h"
 #include "map.h"
@@ -273,28 +274,79 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 
 	bool any_position_valid = false;
 
-	v3s16 p;
-	for (p.X = min.X; p.X <= max.X; p.X++)
-	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
-	for (p.Z = min.Z; p.Z <= max.Z; p.Z++) {
-		bool is_position_valid;
-		MapNode n = map->getNode(p, &is_position_valid);
+	// Go block by block so that the per-block collision box cache,
+	// shared by all objects moving through a block, can be used
+	const NodeDefManager *nodedef = gamedef->getNodeDefManager();
+	v3s16 bpmin = getNodeBlockPos(min);
+	v3s16 bpmax = getNodeBlockPos(max);
+	v3s16 bp;
+	for (bp.X = bpmin.X; bp.X <= bpmax.X; bp.X++)
+	for (bp.Y = bpmin.Y; bp.Y <= bpmax.Y; bp.Y++)
+	for (bp.Z = bpmin.Z; bp.Z <= bpmax.Z; bp.Z++) {
+		MapBlock *block = map->getBlockNoCreateNoEx(bp);
+		v3s16 origin = bp * MAP_BLOCKSIZE;
+		// Intersection of the movement range with this block
+		v3s16 rmin(MYMAX(min.X, origin.X),
+				MYMAX(min.Y, origin.Y),
+				MYMAX(min.Z, origin.Z));
+		v3s16 rmax(MYMIN(max.X, origin.X + MAP_BLOCKSIZE - 1),
+				MYMIN(max.Y, origin.Y + MAP_BLOCKSIZE - 1),
+				MYMIN(max.Z, origin.Z + MAP_BLOCKSIZE - 1));
+
+		if (!block) {
+			// Collide with unloaded nodes
+			v3s16 p;
+			for (p.X = rmin.X; p.X <= rmax.X; p.X++)
+			for (p.Y = rmin.Y; p.Y <= rmax.Y; p.Y++)
+			for (p.Z = rmin.Z; p.Z <= rmax.Z; p.Z++)
+				cinfo.emplace_back(true, false, 0, p, getNodeBox(p, BS));
+			continue;
+		}
+
+		block->cacheCollisionBoxes();
 
-		if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
-			// Object collides into walkable nodes
+		v3s16 p;
+		for (p.X = rmin.X; p.X <= rmax.X; p.X++)
+		for (p.Y = rmin.Y; p.Y <= rmax.Y; p.Y++)
+		for (p.Z = rmin.Z; p.Z <= rmax.Z; p.Z++) {
+			u32 i = (p.Z - origin.Z) * MapBlock::zstride
+					+ (p.Y - origin.Y) * MapBlock::ystride
+					+ (p.X - origin.X);
 
+			if (block->collision_ignore[i / 32] & (1U << (i % 32))) {
+				// Collide with unloaded nodes (dummy blocks) and
+				// loaded CONTENT_IGNORE nodes
+				cinfo.emplace_back(true, false, 0, p, getNodeBox(p, BS));
+				continue;
+			}
 			any_position_valid = true;
-			const NodeDefManager *nodedef = gamedef->getNodeDefManager();
-			const ContentFeatures &f = nodedef->get(n);
 
-			if (!f.walkable)
+			if (block->collision_solid[i / 32] & (1U << (i % 32))) {
+				// Walkable full-cube node
+				cinfo.emplace_back(false, false, 0, p, getNodeBox(p, BS));
 				continue;
+			}
 
-			int n_bouncy_value = itemgroup_get(f.groups, "bouncy");
+			// Walkable nodes with custom boxes or groups are in the
+			// (index-sorted) special list; everything else is non-walkable
+			auto it = std::lower_bound(block->collision_special.begin(),
+					block->collision_special.end(), i,
+					[](const MapBlock::NodeCollisionInfo &info, u32 index) {
+						return info.index < index;
+					});
+			if (it == block->collision_special.end() || it->index != i)
+				continue;
 
-			int neighbors = 0;
-			if (f.drawtype == NDT_NODEBOX &&
-				f.node_box.type == NODEBOX_CONNECTED) {
+			// Calculate float position only once
+			v3f posf = intToFloat(p, BS);
+			if (it->connected) {
+				// Connected nodeboxes depend on the neighbor nodes and
+				// are not cached
+				bool is_position_valid;
+				MapNode n = block->getNodeNoCheck(p - origin,
+						&is_position_valid);
+
+				int neighbors = 0;
 				v3s16 p2 = p;
 
 				p2.Y++;
@@ -319,22 +371,21 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 				p2 = p;
 				p2.X++;
 				getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
-			}
-			std::vector<aabb3f> nodeboxes;
-			n.getCollisionBoxes(gamedef->ndef(), &nodeboxes, neighbors);
 
-			// Calculate float position only once
-			v3f posf = intToFloat(p, BS);
-			for (auto box : nodeboxes) {
-				box.MinEdge += posf;
-				box.MaxEdge += posf;
-				cinfo.emplace_back(false, false, n_bouncy_value, p, box);
+				std::vector<aabb3f> nodeboxes;
+				n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
+				for (auto box : nodeboxes) {
+					box.MinEdge += posf;
+					box.MaxEdge += posf;
+					cinfo.emplace_back(false, false, it->bouncy, p, box);
+				}
+			} else {
+				for (aabb3f box : it->boxes) {
+					box.MinEdge += posf;
+					box.MaxEdge += posf;
+					cinfo.emplace_back(false, false, it->bouncy, p, box);
+				}
 			}
-		} else {
-			// Collide with unloaded nodes (position invalid) and loaded
-			// CONTENT_IGNORE nodes (position valid)
-			aabb3f box = getNodeBox(p, BS);
-			cinfo.emplace_back(true, false, 0, p, box);
 		}
 	}
 
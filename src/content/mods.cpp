@@ -408,9 +408,9 @@ void ModMetadata::clear()
 bool ModMetadata::save(const std::string &root_path)
 {
 	Json::Value json;
-	for (StringMap::const_iterator it = m_stringvars.begin();
+	for (MetadataStringMap::const_iterator it = m_stringvars.begin();
 			it != m_stringvars.end(); ++it) {
-		json[it->first] = it->second;
+		json[it->first] = it->second.str();
 	}
 
 	if (!fs::PathExists(root_path)) {
@@ -426,16 +426,11 @@ bool ModMetadata::save(const std::string &root_path)
 		return false;
 	}
 
-	bool w_ok = fs::safeWriteToFile(
+	// Queued on the shared writer thread; failures are logged there
+	fs::safeWriteToFileAsync(
 			root_path + DIR_DELIM + m_mod_name, fastWriteJson(json));
-
-	if (w_ok) {
-		m_modified = false;
-	} else {
-		errorstream << "ModMetadata[" << m_mod_name << "]: failed write file."
-			    << std::endl;
-	}
-	return w_ok;
+	m_modified = false;
+	return true;
 }
 
 bool ModMetadata::load(const std::string &root_path)
@@ -88,8 +88,8 @@ public:
 			data += " ";
 			data += itos(m_base_position.Z);
 
-			ActiveObjectMessage aom(getId(), false, data);
-			m_messages_out.push(aom);
+			m_messages_out.push(ActiveObjectMessage(getId(), false,
+				std::move(data)));
 		}
 	}
 
@@ -247,6 +247,59 @@ const std::unordered_set<int> &UnitSAO::getAttachmentChildIds() const
 	return m_attachment_child_ids;
 }
 
+// Rounds value * scale into a s16, returns false if it doesn't fit
+static bool quantizeV3(v3f value, float scale, v3s16 *result)
+{
+	v3f scaled = value * scale;
+	if (std::fabs(scaled.X) > S16_MAX || std::fabs(scaled.Y) > S16_MAX ||
+			std::fabs(scaled.Z) > S16_MAX)
+		return false;
+
+	*result = v3s16(myround(scaled.X), myround(scaled.Y), myround(scaled.Z));
+	return true;
+}
+
+std::string UnitSAO::generateQuantizedPositionCommand(v3f position,
+	v3f velocity, v3f acceleration, bool do_interpolate,
+	bool is_movement_end, f32 update_interval)
+{
+	// Send an absolute position this often even if deltas keep fitting,
+	// so freshly added observers and clients that lost the keyframe
+	// catch up quickly
+	static const u16 keyframe_interval = 10;
+
+	bool keyframe = !m_pos_keyframe_valid ||
+		m_pos_updates_since_keyframe >= keyframe_interval;
+
+	v3s16 dpos, vel, acc;
+	if (!keyframe) {
+		keyframe = !quantizeV3(position - m_pos_keyframe,
+				GOB_POS_QUANT_SCALE, &dpos) ||
+			!quantizeV3(velocity, GOB_POS_QUANT_SCALE, &vel) ||
+			!quantizeV3(acceleration, GOB_POS_QUANT_SCALE, &acc);
+	}
+
+	if (keyframe) {
+		m_pos_keyframe = position;
+		m_pos_keyframe_seq++;
+		m_pos_keyframe_valid = true;
+		m_pos_updates_since_keyframe = 0;
+		return gob_cmd_update_position_keyframe(m_pos_keyframe_seq,
+			position, velocity, acceleration, m_rotation,
+			do_interpolate, is_movement_end, update_interval);
+	}
+
+	// Rotation always fits after wrapping
+	v3s16 rot(
+		myround(wrapDegrees_180(m_rotation.X) * GOB_ROT_QUANT_SCALE),
+		myround(wrapDegrees_180(m_rotation.Y) * GOB_ROT_QUANT_SCALE),
+		myround(wrapDegrees_180(m_rotation.Z) * GOB_ROT_QUANT_SCALE));
+
+	m_pos_updates_since_keyframe++;
+	return gob_cmd_update_position_delta(m_pos_keyframe_seq, dpos, vel, acc,
+		rot, do_interpolate, is_movement_end, update_interval);
+}
+
 void UnitSAO::onAttach(int parent_id)
 {
 	if (!parent_id)
@@ -289,6 +342,62 @@ void UnitSAO::notifyObjectPropertiesModified()
 	m_properties_sent = false;
 }
 
+std::string UnitSAO::generatePropertiesCommand()
+{
+	// The first broadcast must be a full snapshot; later ones carry
+	// only the fields changed since the previous broadcast. Clients
+	// arriving in between get a fresh snapshot in their initialization
+	// data and apply the same deltas from there.
+	std::string str;
+	if (m_prop_broadcast_valid)
+		str = gob_cmd_set_properties_delta(m_prop, m_prop_last_broadcast);
+	else
+		str = gob_cmd_set_properties(m_prop);
+
+	if (!str.empty()) {
+		m_prop_last_broadcast = m_prop;
+		m_prop_broadcast_valid = true;
+	}
+	return str;
+}
+
+void UnitSAO::sendBatchedCommands(const std::vector<std::string> &cmds)
+{
+	if (cmds.empty())
+		return;
+
+	if (cmds.size() == 1) {
+		// A single command goes out unwrapped
+		m_messages_out.push(ActiveObjectMessage(getId(), true, cmds.front()));
+		return;
+	}
+
+	// The batch count is a u8; in the absurd case of more commands,
+	// send several batches
+	for (size_t i = 0; i < cmds.size(); i += 255) {
+		std::vector<std::string> chunk(cmds.begin() + i,
+			cmds.begin() + MYMIN(i + 255, cmds.size()));
+		m_messages_out.push(ActiveObjectMessage(getId(), true,
+			gob_cmd_batch(chunk)));
+	}
+}
+
+std::string UnitSAO::generateArmorGroupsCommand()
+{
+	std::string str;
+	if (m_armor_groups_broadcast_valid)
+		str = gob_cmd_update_armor_groups_delta(m_armor_groups,
+				m_armor_groups_last_broadcast);
+	else
+		str = gob_cmd_update_armor_groups(m_armor_groups);
+
+	if (!str.empty()) {
+		m_armor_groups_last_broadcast = m_armor_groups;
+		m_armor_groups_broadcast_valid = true;
+	}
+	return str;
+}
+
 /*
 	LuaEntitySAO
 */
@@ -399,10 +508,45 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 	if(!m_properties_sent)
 	{
 		m_properties_sent = true;
-		std::string str = getPropertyPacket();
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		std::string str = generatePropertiesCommand();
+		if (!str.empty()) {
+			// create message and add to list
+			m_messages_out.push(ActiveObjectMessage(getId(), true,
+				std::move(str)));
+		}
+	}
+
+	// Distance-tiered sleep: entities far from every player step at a
+	// reduced rate or not at all. Attached objects follow their parent
+	// and are never put to sleep.
+	if (m_prop.sleep_distance > 0.0f && !isAttached()) {
+		m_sleep_check_timer += dtime;
+		if (m_sleep_check_timer >= 0.5f) {
+			m_sleep_check_timer = 0.0f;
+			float d = m_env->getDistanceToNearestPlayer(m_base_position);
+			if (d >= 0.0f && d < m_prop.sleep_distance * BS)
+				m_sleep_tier = SLEEP_NONE;
+			else if (m_prop.suspend_distance > 0.0f && (d < 0.0f ||
+					d >= m_prop.suspend_distance * BS))
+				m_sleep_tier = SLEEP_SUSPENDED;
+			else
+				m_sleep_tier = SLEEP_REDUCED;
+		}
+		if (m_sleep_tier != SLEEP_NONE) {
+			// Cap the accumulated time so waking entities don't get an
+			// arbitrarily large dtime to catch up on
+			m_sleep_dtime = MYMIN(m_sleep_dtime + dtime, 10.0f);
+			if (m_sleep_tier == SLEEP_SUSPENDED ||
+					m_sleep_dtime < m_prop.sleep_step_interval)
+				return;
+			// Deliver the time accumulated while asleep in one step
+			dtime = m_sleep_dtime;
+			m_sleep_dtime = 0.0f;
+		} else if (m_sleep_dtime > 0.0f) {
+			// Just woke up: deliver the accumulated time as well
+			dtime += m_sleep_dtime;
+			m_sleep_dtime = 0.0f;
+		}
 	}
 
 	// If attached, check that our parent is still there. If it isn't, detach.
@@ -498,51 +642,43 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		}
 	}
 
+	// Collect this tick's reliable updates; they are sent as one message
+	std::vector<std::string> cmds;
+
 	if (!m_armor_groups_sent) {
 		m_armor_groups_sent = true;
-		std::string str = gob_cmd_update_armor_groups(
-				m_armor_groups);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		std::string str = generateArmorGroupsCommand();
+		if (!str.empty())
+			cmds.push_back(str);
 	}
 
 	if (!m_animation_sent) {
 		m_animation_sent = true;
-		std::string str = gob_cmd_update_animation(
-			m_animation_range, m_animation_speed, m_animation_blend, m_animation_loop);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		cmds.push_back(gob_cmd_update_animation(
+			m_animation_range, m_animation_speed, m_animation_blend, m_animation_loop));
 	}
 
 	if (!m_animation_speed_sent) {
 		m_animation_speed_sent = true;
-		std::string str = gob_cmd_update_animation_speed(m_animation_speed);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		cmds.push_back(gob_cmd_update_animation_speed(m_animation_speed));
 	}
 
 	if (!m_bone_position_sent) {
 		m_bone_position_sent = true;
 		for (std::unordered_map<std::string, core::vector2d<v3f>>::const_iterator
 				ii = m_bone_position.begin(); ii != m_bone_position.end(); ++ii){
-			std::string str = gob_cmd_update_bone_position((*ii).first,
-					(*ii).second.X, (*ii).second.Y);
-			// create message and add to list
-			ActiveObjectMessage aom(getId(), true, str);
-			m_messages_out.push(aom);
+			cmds.push_back(gob_cmd_update_bone_position((*ii).first,
+					(*ii).second.X, (*ii).second.Y));
 		}
 	}
 
 	if (!m_attachment_sent) {
 		m_attachment_sent = true;
-		std::string str = gob_cmd_update_attachment(m_attachment_parent_id, m_attachment_bone, m_attachment_position, m_attachment_rotation);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		cmds.push_back(gob_cmd_update_attachment(m_attachment_parent_id,
+				m_attachment_bone, m_attachment_position, m_attachment_rotation));
 	}
+
+	sendBatchedCommands(cmds);
 }
 
 std::string LuaEntitySAO::getClientInitializationData(u16 protocol_version)
@@ -657,8 +793,8 @@ u16 LuaEntitySAO::punch(v3f dir,
 
 			std::string str = gob_cmd_punched(getHP());
 			// create message and add to list
-			ActiveObjectMessage aom(getId(), true, str);
-			m_messages_out.push(aom);
+			m_messages_out.push(ActiveObjectMessage(getId(), true,
+				std::move(str)));
 		}
 	}
 
@@ -754,8 +890,7 @@ void LuaEntitySAO::setTextureMod(const std::string &mod)
 	std::string str = gob_cmd_set_texture_mod(mod);
 	m_current_texture_modifier = mod;
 	// create message and add to list
-	ActiveObjectMessage aom(getId(), true, str);
-	m_messages_out.push(aom);
+	m_messages_out.push(ActiveObjectMessage(getId(), true, std::move(str)));
 }
 
 std::string LuaEntitySAO::getTextureMod() const
@@ -773,8 +908,7 @@ void LuaEntitySAO::setSprite(v2s16 p, int num_frames, float framelength,
 		select_horiz_by_yawpitch
 	);
 	// create message and add to list
-	ActiveObjectMessage aom(getId(), true, str);
-	m_messages_out.push(aom);
+	m_messages_out.push(ActiveObjectMessage(getId(), true, std::move(str)));
 }
 
 std::string LuaEntitySAO::getName()
@@ -803,6 +937,8 @@ void LuaEntitySAO::sendPosition(bool do_interpolate, bool is_movement_end)
 
 	float update_interval = m_env->getSendRecommendedInterval();
 
+	// Both encodings are queued; the server routes the matching one to
+	// each client depending on its protocol version
 	std::string str = gob_cmd_update_position(
 		m_base_position,
 		m_velocity,
@@ -813,8 +949,13 @@ void LuaEntitySAO::sendPosition(bool do_interpolate, bool is_movement_end)
 		update_interval
 	);
 	// create message and add to list
-	ActiveObjectMessage aom(getId(), false, str);
-	m_messages_out.push(aom);
+	m_messages_out.push(ActiveObjectMessage(getId(), false, std::move(str)));
+
+	std::string str_q = generateQuantizedPositionCommand(m_base_position,
+		m_velocity, m_acceleration, do_interpolate, is_movement_end,
+		update_interval);
+	m_messages_out.push(ActiveObjectMessage(getId(), false,
+		std::move(str_q)));
 }
 
 bool LuaEntitySAO::getCollisionBox(aabb3f *toset) const
@@ -1059,10 +1200,12 @@ void PlayerSAO::step(float dtime, bool send_recommended)
 
 	if (!m_properties_sent) {
 		m_properties_sent = true;
-		std::string str = getPropertyPacket();
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		std::string str = generatePropertiesCommand();
+		if (!str.empty()) {
+			// create message and add to list
+			m_messages_out.push(ActiveObjectMessage(getId(), true,
+				std::move(str)));
+		}
 		m_env->getScriptIface()->player_event(this, "properties_changed");
 	}
 
@@ -1118,6 +1261,8 @@ void PlayerSAO::step(float dtime, bool send_recommended)
 		else
 			pos = m_base_position;
 
+		// Both encodings are queued; the server routes the matching one
+		// to each client depending on its protocol version
 		std::string str = gob_cmd_update_position(
 			pos,
 			v3f(0.0f, 0.0f, 0.0f),
@@ -1128,59 +1273,56 @@ void PlayerSAO::step(float dtime, bool send_recommended)
 			update_interval
 		);
 		// create message and add to list
-		ActiveObjectMessage aom(getId(), false, str);
-		m_messages_out.push(aom);
+		m_messages_out.push(ActiveObjectMessage(getId(), false,
+			std::move(str)));
+
+		std::string str_q = generateQuantizedPositionCommand(pos,
+			v3f(0.0f, 0.0f, 0.0f), v3f(0.0f, 0.0f, 0.0f), true, false,
+			update_interval);
+		m_messages_out.push(ActiveObjectMessage(getId(), false,
+			std::move(str_q)));
 	}
 
+	// Collect this tick's reliable updates; they are sent as one message
+	std::vector<std::string> cmds;
+
 	if (!m_armor_groups_sent) {
 		m_armor_groups_sent = true;
-		std::string str = gob_cmd_update_armor_groups(
-				m_armor_groups);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		std::string str = generateArmorGroupsCommand();
+		if (!str.empty())
+			cmds.push_back(str);
 	}
 
 	if (!m_physics_override_sent) {
 		m_physics_override_sent = true;
-		std::string str = gob_cmd_update_physics_override(m_physics_override_speed,
+		cmds.push_back(gob_cmd_update_physics_override(m_physics_override_speed,
 				m_physics_override_jump, m_physics_override_gravity,
 				m_physics_override_sneak, m_physics_override_sneak_glitch,
-				m_physics_override_new_move);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+				m_physics_override_new_move));
 	}
 
 	if (!m_animation_sent) {
 		m_animation_sent = true;
-		std::string str = gob_cmd_update_animation(
-			m_animation_range, m_animation_speed, m_animation_blend, m_animation_loop);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		cmds.push_back(gob_cmd_update_animation(
+			m_animation_range, m_animation_speed, m_animation_blend, m_animation_loop));
 	}
 
 	if (!m_bone_position_sent) {
 		m_bone_position_sent = true;
 		for (std::unordered_map<std::string, core::vector2d<v3f>>::const_iterator
 				ii = m_bone_position.begin(); ii != m_bone_position.end(); ++ii) {
-			std::string str = gob_cmd_update_bone_position((*ii).first,
-					(*ii).second.X, (*ii).second.Y);
-			// create message and add to list
-			ActiveObjectMessage aom(getId(), true, str);
-			m_messages_out.push(aom);
+			cmds.push_back(gob_cmd_update_bone_position((*ii).first,
+					(*ii).second.X, (*ii).second.Y));
 		}
 	}
 
 	if (!m_attachment_sent) {
 		m_attachment_sent = true;
-		std::string str = gob_cmd_update_attachment(m_attachment_parent_id,
-				m_attachment_bone, m_attachment_position, m_attachment_rotation);
-		// create message and add to list
-		ActiveObjectMessage aom(getId(), true, str);
-		m_messages_out.push(aom);
+		cmds.push_back(gob_cmd_update_attachment(m_attachment_parent_id,
+				m_attachment_bone, m_attachment_position, m_attachment_rotation));
 	}
+
+	sendBatchedCommands(cmds);
 }
 
 void PlayerSAO::setBasePosition(const v3f &position)
@@ -1288,8 +1430,8 @@ u16 PlayerSAO::punch(v3f dir,
 		if (puncher->getType() == ACTIVEOBJECT_TYPE_PLAYER) {
 			std::string str = gob_cmd_punched(getHP());
 			// create message and add to list
-			ActiveObjectMessage aom(getId(), true, str);
-			m_messages_out.push(aom);
+			m_messages_out.push(ActiveObjectMessage(getId(), true,
+				std::move(str)));
 			return 0;
 		}
 	}
@@ -1311,8 +1453,8 @@ u16 PlayerSAO::punch(v3f dir,
 		if (puncher->getType() == ACTIVEOBJECT_TYPE_PLAYER) {
 			std::string str = gob_cmd_punched(getHP());
 			// create message and add to list
-			ActiveObjectMessage aom(getId(), true, str);
-			m_messages_out.push(aom);
+			m_messages_out.push(ActiveObjectMessage(getId(), true,
+				std::move(str)));
 		}
 	}
 
@@ -68,15 +68,48 @@ public:
 	ObjectProperties* accessObjectProperties();
 	void notifyObjectPropertiesModified();
 protected:
+	/*
+		Builds the position update message for protocol >= 41 clients:
+		either an absolute keyframe or a quantized delta against the last
+		keyframe. Deltas are loss-tolerant since they all reference the
+		keyframe, not each other; a new keyframe is emitted periodically
+		and whenever a value doesn't fit the quantized range.
+	*/
+	std::string generateQuantizedPositionCommand(v3f position, v3f velocity,
+			v3f acceleration, bool do_interpolate, bool is_movement_end,
+			f32 update_interval);
+
+	/*
+		Build the broadcast message for changed properties or armor
+		groups: a full snapshot the first time, afterwards a delta
+		against the last broadcast state. Returns an empty string when
+		nothing actually changed.
+	*/
+	std::string generatePropertiesCommand();
+	std::string generateArmorGroupsCommand();
+
+	/*
+		Queue this tick's reliable update commands as a single message:
+		one command goes out as-is, several are wrapped into a
+		GENERIC_CMD_BATCH, cutting per-message queue and header overhead
+		for objects that update bones and attachments every tick.
+	*/
+	void sendBatchedCommands(const std::vector<std::string> &cmds);
+
 	u16 m_hp = 1;
 
 	v3f m_rotation;
 
 	bool m_properties_sent = true;
 	ObjectProperties m_prop;
+	// Last broadcast state; valid once a full snapshot was broadcast
+	ObjectProperties m_prop_last_broadcast;
+	bool m_prop_broadcast_valid = false;
 
 	ItemGroupList m_armor_groups;
 	bool m_armor_groups_sent = false;
+	ItemGroupList m_armor_groups_last_broadcast;
+	bool m_armor_groups_broadcast_valid = false;
 
 	v2f m_animation_range;
 	float m_animation_speed = 0.0f;
@@ -95,6 +128,12 @@ protected:
 	v3f m_attachment_position;
 	v3f m_attachment_rotation;
 	bool m_attachment_sent = false;
+
+	// Keyframe state for quantized position updates
+	v3f m_pos_keyframe;
+	u8 m_pos_keyframe_seq = 0;
+	u16 m_pos_updates_since_keyframe = 0;
+	bool m_pos_keyframe_valid = false;
 private:
 	void onAttach(int parent_id);
 	void onDetach(int parent_id);
@@ -169,6 +208,17 @@ private:
 	float m_last_sent_position_timer = 0.0f;
 	float m_last_sent_move_precision = 0.0f;
 	std::string m_current_texture_modifier = "";
+
+	// Distance-tiered sleep state, see step()
+	enum SleepTier : u8 {
+		SLEEP_NONE,     // step every tick
+		SLEEP_REDUCED,  // step every sleep_step_interval seconds
+		SLEEP_SUSPENDED // don't step at all
+	};
+	SleepTier m_sleep_tier = SLEEP_NONE;
+	float m_sleep_check_timer = 0.0f;
+	// Time accumulated while asleep, delivered in one step on wake
+	float m_sleep_dtime = 0.0f;
 };
 
 /*
@@ -46,6 +46,32 @@ static bool hasGroupItem(const std::vector<std::string> &recipe)
 	return false;
 }
 
+// Pick one recipe element to key the group recipe index by.
+// A plain item name is preferred because it is more selective than a group.
+static std::string getIndexElementFrom(const std::vector<std::string> &recipe)
+{
+	for (const auto &item : recipe) {
+		if (!item.empty() && !isGroupRecipeStr(item))
+			return item;
+	}
+	for (const auto &item : recipe) {
+		if (!item.empty())
+			return item;
+	}
+	return "";
+}
+
+// Normalize a recipe element to an index key.
+// "group:a,b" is keyed under its first group only; inputs matching all of
+// the groups necessarily match the first one, so the bucket is a superset.
+static std::string craftGetIndexKey(const std::string &name)
+{
+	if (!isGroupRecipeStr(name))
+		return name;
+	Strfnd f(name.substr(6));
+	return "group:" + f.next(",");
+}
+
 inline u64 getHashForString(const std::string &recipe_str)
 {
 	/*errorstream << "Hashing craft string  \"" << recipe_str << '"';*/
@@ -449,6 +475,12 @@ u64 CraftDefinitionShaped::getHash(CraftHashType type) const
 	return getHashForGrid(type, rec_names);
 }
 
+std::string CraftDefinitionShaped::getIndexElement() const
+{
+	assert(hash_inited); // Pre-condition
+	return getIndexElementFrom(recipe_names);
+}
+
 void CraftDefinitionShaped::initHash(IGameDef *gamedef)
 {
 	if (hash_inited)
@@ -567,6 +599,12 @@ u64 CraftDefinitionShapeless::getHash(CraftHashType type) const
 	return getHashForGrid(type, recipe_names);
 }
 
+std::string CraftDefinitionShapeless::getIndexElement() const
+{
+	assert(hash_inited); // Pre-condition
+	return getIndexElementFrom(recipe_names);
+}
+
 void CraftDefinitionShapeless::initHash(IGameDef *gamedef)
 {
 	if (hash_inited)
@@ -770,6 +808,12 @@ u64 CraftDefinitionCooking::getHash(CraftHashType type) const
 	return 0;
 }
 
+std::string CraftDefinitionCooking::getIndexElement() const
+{
+	assert(hash_inited); // Pre-condition
+	return recipe_name;
+}
+
 void CraftDefinitionCooking::initHash(IGameDef *gamedef)
 {
 	if (hash_inited)
@@ -872,6 +916,12 @@ u64 CraftDefinitionFuel::getHash(CraftHashType type) const
 	return 0;
 }
 
+std::string CraftDefinitionFuel::getIndexElement() const
+{
+	assert(hash_inited); // Pre-condition
+	return recipe_name;
+}
+
 void CraftDefinitionFuel::initHash(IGameDef *gamedef)
 {
 	if (hash_inited)
@@ -927,6 +977,30 @@ public:
 		CraftDefinition::RecipePriority priority_best =
 			CraftDefinition::PRIORITY_NO_RECIPE;
 		CraftDefinition *def_best = nullptr;
+
+		auto try_definition = [&] (CraftDefinition *def) {
+			/*errorstream << "Checking " << input.dump() << std::endl
+				<< " against " << def->dump() << std::endl;*/
+
+			CraftDefinition::RecipePriority priority = def->getPriority();
+			if (priority > priority_best
+					&& def->check(input, gamedef)) {
+				// Check if the crafted node/item exists
+				CraftOutput out = def->getOutput(input, gamedef);
+				ItemStack is;
+				is.deSerialize(out.item, gamedef->idef());
+				if (!is.isKnown(gamedef->idef())) {
+					infostream << "trying to craft non-existent "
+						<< out.item << ", ignoring recipe" << std::endl;
+					return;
+				}
+
+				output = out;
+				priority_best = priority;
+				def_best = def;
+			}
+		};
+
 		for (int type = 0; type <= craft_hash_type_max; type++) {
 			u64 hash = getHashForGrid((CraftHashType) type, input_names);
 
@@ -944,30 +1018,39 @@ public:
 			// definitions can override earlier ones.
 			for (std::vector<CraftDefinition*>::size_type
 					i = hash_collisions.size(); i > 0; i--) {
-				CraftDefinition *def = hash_collisions[i - 1];
-
-				/*errorstream << "Checking " << input.dump() << std::endl
-					<< " against " << def->dump() << std::endl;*/
-
-				CraftDefinition::RecipePriority priority = def->getPriority();
-				if (priority > priority_best
-						&& def->check(input, gamedef)) {
-					// Check if the crafted node/item exists
-					CraftOutput out = def->getOutput(input, gamedef);
-					ItemStack is;
-					is.deSerialize(out.item, gamedef->idef());
-					if (!is.isKnown(gamedef->idef())) {
-						infostream << "trying to craft non-existent "
-							<< out.item << ", ignoring recipe" << std::endl;
-						continue;
-					}
-
-					output = out;
-					priority_best = priority;
-					def_best = def;
-				}
+				try_definition(hash_collisions[i - 1]);
 			}
 		}
+
+		// Group recipes are found through the inverted index: collect the
+		// buckets of every input item name and of every group those items
+		// belong to, then check the candidates in registration order (later
+		// registrations first, so they can override earlier ones).
+		std::set<std::string> index_keys;
+		for (const std::string &name : input_names) {
+			if (name.empty() || !gamedef->idef()->isKnown(name))
+				continue;
+			index_keys.insert(name);
+			const ItemGroupList &groups = gamedef->idef()->get(name).groups;
+			for (const auto &group : groups)
+				index_keys.insert("group:" + group.first);
+		}
+		std::vector<std::pair<u32, CraftDefinition*> > candidates(
+			m_always_check.begin(), m_always_check.end());
+		for (const std::string &key : index_keys) {
+			auto bucket_iter = m_group_index.find(key);
+			if (bucket_iter == m_group_index.end())
+				continue;
+			candidates.insert(candidates.end(),
+				bucket_iter->second.begin(), bucket_iter->second.end());
+		}
+		std::sort(candidates.begin(), candidates.end(),
+			[] (const std::pair<u32, CraftDefinition*> &a,
+					const std::pair<u32, CraftDefinition*> &b) {
+				return a.first > b.first;
+			});
+		for (const auto &candidate : candidates)
+			try_definition(candidate.second);
 		if (priority_best == CraftDefinition::PRIORITY_NO_RECIPE)
 			return false;
 		if (decrementInput)
@@ -1062,6 +1145,16 @@ public:
 				}
 			}
 		}
+		for (const auto &it : m_group_index) {
+			for (const auto &iit : it.second) {
+				os << "index key " << it.first
+					<< " def " << iit.second->dump()
+					<< "\n";
+			}
+		}
+		for (const auto &it : m_always_check) {
+			os << "always checked def " << it.second->dump() << "\n";
+		}
 		return os.str();
 	}
 	virtual void registerCraft(CraftDefinition *def, IGameDef *gamedef)
@@ -1086,6 +1179,14 @@ public:
 			}
 			m_craft_defs[type].clear();
 		}
+		for (auto &it : m_group_index) {
+			for (auto &iit : it.second)
+				delete iit.second;
+		}
+		m_group_index.clear();
+		for (auto &it : m_always_check)
+			delete it.second;
+		m_always_check.clear();
 		m_output_craft_definitions.clear();
 	}
 	virtual void initHashes(IGameDef *gamedef)
@@ -1097,6 +1198,20 @@ public:
 			// Initialize and get the definition's hash
 			def->initHash(gamedef);
 			CraftHashType type = def->getHashType();
+
+			// Group recipes would all collide on their item count, so they
+			// go into the inverted index instead of a hash layer. The order
+			// number keeps registration order across index buckets.
+			if (type == CRAFT_HASH_TYPE_COUNT) {
+				std::string elem = def->getIndexElement();
+				if (elem.empty())
+					m_always_check.emplace_back(m_next_index_order++, def);
+				else
+					m_group_index[craftGetIndexKey(elem)].emplace_back(
+						m_next_index_order++, def);
+				continue;
+			}
+
 			u64 hash = def->getHash(type);
 
 			// Enter the definition
@@ -1107,6 +1222,15 @@ public:
 private:
 	std::vector<std::unordered_map<u64, std::vector<CraftDefinition*> > >
 		m_craft_defs;
+	// Inverted index over group recipes, built by initHashes(): maps one
+	// recipe element ("default:stick" or "group:wood") to the definitions
+	// containing it, paired with their registration order number.
+	std::unordered_map<std::string, std::vector<std::pair<u32, CraftDefinition*> > >
+		m_group_index;
+	// Group recipes without any recipe element (tool repair); checked
+	// against every input.
+	std::vector<std::pair<u32, CraftDefinition*> > m_always_check;
+	u32 m_next_index_order = 0;
 	std::unordered_map<std::string, std::vector<CraftDefinition*> >
 		m_output_craft_definitions;
 };
@@ -179,6 +179,13 @@ public:
 	}
 	virtual u64 getHash(CraftHashType type) const = 0;
 
+	// One recipe element ("default:stick" or "group:wood,stick") used to
+	// key the manager's group recipe index. Only meaningful for
+	// CRAFT_HASH_TYPE_COUNT definitions and only valid after initHash();
+	// an empty string means the definition has no such element and must
+	// be checked against every input (tool repair).
+	virtual std::string getIndexElement() const { return ""; }
+
 	// to be called after all mods are loaded, so that we catch all aliases
 	virtual void initHash(IGameDef *gamedef) = 0;
 
@@ -216,6 +223,8 @@ public:
 
 	virtual u64 getHash(CraftHashType type) const;
 
+	virtual std::string getIndexElement() const;
+
 	virtual void initHash(IGameDef *gamedef);
 
 	virtual std::string dump() const;
@@ -260,6 +269,8 @@ public:
 
 	virtual u64 getHash(CraftHashType type) const;
 
+	virtual std::string getIndexElement() const;
+
 	virtual void initHash(IGameDef *gamedef);
 
 	virtual std::string dump() const;
@@ -341,6 +352,8 @@ public:
 
 	virtual u64 getHash(CraftHashType type) const;
 
+	virtual std::string getIndexElement() const;
+
 	virtual void initHash(IGameDef *gamedef);
 
 	virtual std::string dump() const;
@@ -384,6 +397,8 @@ public:
 
 	virtual u64 getHash(CraftHashType type) const;
 
+	virtual std::string getIndexElement() const;
+
 	virtual void initHash(IGameDef *gamedef);
 
 	virtual std::string dump() const;
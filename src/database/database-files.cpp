@@ -25,15 +25,61 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "porting.h"
 #include "filesys.h"
+#include "threading/mutex_auto_lock.h"
 #include "util/string.h"
+#include "util/thread.h"
 
 // !!! WARNING !!!
 // This backend is intended to be used on Minetest 0.4.16 only for the transition backend
 // for player files
 
+class PlayerFileWriteThread : public UpdateThread
+{
+public:
+	PlayerFileWriteThread(PlayerDatabaseFiles *database) :
+		UpdateThread("PlayerFileWrite"), m_database(database) {}
+
+protected:
+	void doUpdate() { m_database->flushWrites(); }
+
+private:
+	PlayerDatabaseFiles *m_database;
+};
+
 PlayerDatabaseFiles::PlayerDatabaseFiles(const std::string &savedir) : m_savedir(savedir)
 {
 	fs::CreateDir(m_savedir);
+
+	m_write_thread = new PlayerFileWriteThread(this);
+	m_write_thread->start();
+}
+
+PlayerDatabaseFiles::~PlayerDatabaseFiles()
+{
+	m_write_thread->stop();
+	m_write_thread->wait();
+	delete m_write_thread;
+
+	// Write whatever the thread did not get to
+	flushWrites();
+}
+
+void PlayerDatabaseFiles::flushWrites()
+{
+	// Hold m_flush_mutex across the writes so a concurrent caller cannot
+	// overtake an earlier batch and write stale data for the same player
+	MutexAutoLock flush_lock(m_flush_mutex);
+
+	std::vector<std::pair<std::string, std::string>> queue;
+	{
+		MutexAutoLock lock(m_write_queue_mutex);
+		queue.swap(m_write_queue);
+	}
+
+	for (const auto &entry : queue) {
+		if (!fs::safeWriteToFile(entry.first, entry.second))
+			infostream << "Failed to write " << entry.first << std::endl;
+	}
 }
 
 void PlayerDatabaseFiles::serialize(std::ostringstream &os, RemotePlayer *player)
@@ -63,54 +109,67 @@ void PlayerDatabaseFiles::serialize(std::ostringstream &os, RemotePlayer *player
 
 void PlayerDatabaseFiles::savePlayer(RemotePlayer *player)
 {
-	fs::CreateDir(m_savedir);
-
-	std::string savedir = m_savedir + DIR_DELIM;
-	std::string path = savedir + player->getName();
-	bool path_found = false;
-	RemotePlayer testplayer("", NULL);
-
-	for (u32 i = 0; i < PLAYER_FILE_ALTERNATE_TRIES && !path_found; i++) {
-		if (!fs::PathExists(path)) {
-			path_found = true;
-			continue;
+	std::string path;
+	auto path_it = m_save_paths.find(player->getName());
+	if (path_it != m_save_paths.end()) {
+		path = path_it->second;
+	} else {
+		fs::CreateDir(m_savedir);
+
+		std::string savedir = m_savedir + DIR_DELIM;
+		path = savedir + player->getName();
+		bool path_found = false;
+		RemotePlayer testplayer("", NULL);
+
+		for (u32 i = 0; i < PLAYER_FILE_ALTERNATE_TRIES && !path_found; i++) {
+			if (!fs::PathExists(path)) {
+				path_found = true;
+				continue;
+			}
+
+			// Open and deserialize file to check player name
+			std::ifstream is(path.c_str(), std::ios_base::binary);
+			if (!is.good()) {
+				errorstream << "Failed to open " << path << std::endl;
+				return;
+			}
+
+			testplayer.deSerialize(is, path, NULL);
+			is.close();
+			if (strcmp(testplayer.getName(), player->getName()) == 0) {
+				path_found = true;
+				continue;
+			}
+
+			path = savedir + player->getName() + itos(i);
 		}
 
-		// Open and deserialize file to check player name
-		std::ifstream is(path.c_str(), std::ios_base::binary);
-		if (!is.good()) {
-			errorstream << "Failed to open " << path << std::endl;
+		if (!path_found) {
+			errorstream << "Didn't find free file for player "
+					<< player->getName() << std::endl;
 			return;
 		}
 
-		testplayer.deSerialize(is, path, NULL);
-		is.close();
-		if (strcmp(testplayer.getName(), player->getName()) == 0) {
-			path_found = true;
-			continue;
-		}
-
-		path = savedir + player->getName() + itos(i);
+		m_save_paths[player->getName()] = path;
 	}
 
-	if (!path_found) {
-		errorstream << "Didn't find free file for player " << player->getName()
-				<< std::endl;
-		return;
-	}
-
-	// Open and serialize file
+	// Serialize on the calling thread, write on the file thread
 	std::ostringstream ss(std::ios_base::binary);
 	serialize(ss, player);
-	if (!fs::safeWriteToFile(path, ss.str())) {
-		infostream << "Failed to write " << path << std::endl;
+	{
+		MutexAutoLock lock(m_write_queue_mutex);
+		m_write_queue.emplace_back(path, ss.str());
 	}
+	m_write_thread->deferUpdate();
 
 	player->onSuccessfulSave();
 }
 
 bool PlayerDatabaseFiles::removePlayer(const std::string &name)
 {
+	flushWrites();
+	m_save_paths.erase(name);
+
 	std::string players_path = m_savedir + DIR_DELIM;
 	std::string path = players_path + name;
 
@@ -137,6 +196,8 @@ bool PlayerDatabaseFiles::removePlayer(const std::string &name)
 
 bool PlayerDatabaseFiles::loadPlayer(RemotePlayer *player, PlayerSAO *sao)
 {
+	flushWrites();
+
 	std::string players_path = m_savedir + DIR_DELIM;
 	std::string path = players_path + player->getName();
 
@@ -162,6 +223,8 @@ bool PlayerDatabaseFiles::loadPlayer(RemotePlayer *player, PlayerSAO *sao)
 
 void PlayerDatabaseFiles::listPlayers(std::vector<std::string> &res)
 {
+	flushWrites();
+
 	std::vector<fs::DirListNode> files = fs::GetDirListing(m_savedir);
 	// list files into players directory
 	for (std::vector<fs::DirListNode>::const_iterator it = files.begin(); it !=
@@ -243,6 +306,9 @@ void AuthDatabaseFiles::reload()
 
 bool AuthDatabaseFiles::readAuthFile()
 {
+	// A write of auth.txt may still be queued on the shared writer thread
+	fs::flushAsyncWrites();
+
 	std::string path = m_savedir + DIR_DELIM + "auth.txt";
 	std::ifstream file(path, std::ios::binary);
 	if (!file.good()) {
@@ -282,9 +348,8 @@ bool AuthDatabaseFiles::writeAuthFile()
 		output << ":" << authEntry.last_login;
 		output << std::endl;
 	}
-	if (!fs::safeWriteToFile(path, output.str())) {
-		infostream << "Failed to write " << path << std::endl;
-		return false;
-	}
+	// Queued on the shared writer thread; m_auth_list already holds the
+	// authoritative state, the file is only read back by reload()
+	fs::safeWriteToFileAsync(path, output.str());
 	return true;
 }
@@ -24,13 +24,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // for player files
 
 #include "database.h"
+#include <mutex>
 #include <unordered_map>
+#include <utility>
+
+class PlayerFileWriteThread;
 
 class PlayerDatabaseFiles : public PlayerDatabase
 {
 public:
 	PlayerDatabaseFiles(const std::string &savedir);
-	virtual ~PlayerDatabaseFiles() = default;
+	virtual ~PlayerDatabaseFiles();
 
 	void savePlayer(RemotePlayer *player);
 	bool loadPlayer(RemotePlayer *player, PlayerSAO *sao);
@@ -39,8 +43,27 @@ public:
 
 private:
 	void serialize(std::ostringstream &os, RemotePlayer *player);
+	// Writes all queued player files (called by the write thread, and
+	// synchronously before anything reads the player directory)
+	void flushWrites();
 
 	std::string m_savedir;
+
+	// File paths resolved by savePlayer(), so the alternate-file probing
+	// (which re-reads existing files) only runs once per player
+	std::unordered_map<std::string, std::string> m_save_paths;
+
+	// Writes queued player files so the server thread never waits on disk
+	PlayerFileWriteThread *m_write_thread = nullptr;
+
+	// Protects m_write_queue (filled by savePlayer, drained by flushWrites)
+	std::mutex m_write_queue_mutex;
+	// Serializes flushWrites() callers so files land in queue order
+	std::mutex m_flush_mutex;
+	// (path, file contents) pairs waiting to be written
+	std::vector<std::pair<std::string, std::string>> m_write_queue;
+
+	friend class PlayerFileWriteThread;
 };
 
 class AuthDatabaseFiles : public AuthDatabase
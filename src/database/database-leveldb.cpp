@@ -26,9 +26,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "filesys.h"
 #include "exceptions.h"
+#include "settings.h"
 #include "util/string.h"
 
 #include "leveldb/db.h"
+#include "leveldb/cache.h"
+#include "leveldb/filter_policy.h"
 
 
 #define ENSURE_STATUS_OK(s) \
@@ -38,10 +41,27 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 	}
 
 
-Database_LevelDB::Database_LevelDB(const std::string &savedir)
+Database_LevelDB::Database_LevelDB(const std::string &savedir, Settings &conf)
 {
 	leveldb::Options options;
 	options.create_if_missing = true;
+
+	// Optional world.mt tuning knobs (sizes in bytes, bloom bits per key).
+	// The block cache serves repeat reads from memory; the bloom filter
+	// keeps lookups of absent blocks from touching every level on disk.
+	if (conf.exists("leveldb_block_cache_size")) {
+		m_block_cache = leveldb::NewLRUCache(
+			conf.getU64("leveldb_block_cache_size"));
+		options.block_cache = m_block_cache;
+	}
+	if (conf.exists("leveldb_bloom_filter_bits_per_key")) {
+		u16 bits = conf.getU16("leveldb_bloom_filter_bits_per_key");
+		if (bits > 0) {
+			m_filter_policy = leveldb::NewBloomFilterPolicy(bits);
+			options.filter_policy = m_filter_policy;
+		}
+	}
+
 	leveldb::Status status = leveldb::DB::Open(options,
 		savedir + DIR_DELIM + "map.db", &m_database);
 	ENSURE_STATUS_OK(status);
@@ -50,10 +70,33 @@ Database_LevelDB::Database_LevelDB(const std::string &savedir)
 Database_LevelDB::~Database_LevelDB()
 {
 	delete m_database;
+	delete m_block_cache;
+	delete m_filter_policy;
+}
+
+void Database_LevelDB::beginSave()
+{
+	m_batch.Clear();
+	m_batch_active = true;
+}
+
+void Database_LevelDB::endSave()
+{
+	m_batch_active = false;
+	leveldb::Status status = m_database->Write(leveldb::WriteOptions(),
+		&m_batch);
+	m_batch.Clear();
+	ENSURE_STATUS_OK(status);
 }
 
 bool Database_LevelDB::saveBlock(const v3s16 &pos, const std::string &data)
 {
+	if (m_batch_active) {
+		// Accumulated into the batch and committed by endSave()
+		m_batch.Put(i64tos(getBlockAsInteger(pos)), data);
+		return true;
+	}
+
 	leveldb::Status status = m_database->Put(leveldb::WriteOptions(),
 			i64tos(getBlockAsInteger(pos)), data);
 	if (!status.ok()) {
@@ -26,11 +26,19 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <string>
 #include "database.h"
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+
+namespace leveldb {
+	class Cache;
+	class FilterPolicy;
+}
+
+class Settings;
 
 class Database_LevelDB : public MapDatabase
 {
 public:
-	Database_LevelDB(const std::string &savedir);
+	Database_LevelDB(const std::string &savedir, Settings &conf);
 	~Database_LevelDB();
 
 	bool saveBlock(const v3s16 &pos, const std::string &data);
@@ -38,11 +46,20 @@ public:
 	bool deleteBlock(const v3s16 &pos);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 
-	void beginSave() {}
-	void endSave() {}
+	void beginSave();
+	void endSave();
 
 private:
 	leveldb::DB *m_database;
+	// Between beginSave() and endSave() the Puts are accumulated here and
+	// committed with a single Write(), one sync per save cycle instead of
+	// one per block
+	leveldb::WriteBatch m_batch;
+	bool m_batch_active = false;
+
+	// Owned tuning objects from world.mt knobs; LevelDB only borrows them
+	leveldb::Cache *m_block_cache = nullptr;
+	const leveldb::FilterPolicy *m_filter_policy = nullptr;
 };
 
 #endif // USE_LEVELDB
@@ -0,0 +1,258 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+Pack file format (map.pack):
+	u8[4] magic "MTPK"
+	u8 version (=1)
+	u32 block_count
+	block_count * index entry, sorted ascending by key:
+		s64 key (as in MapDatabase::getBlockAsInteger)
+		u64 offset (from file start)
+		u32 size
+	block data blobs
+All integers are big-endian, as written by util/serialize.h.
+*/
+
+#include "database-pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "util/serialize.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#define PACK_MAGIC "MTPK"
+#define PACK_VERSION 1
+#define PACK_HEADER_SIZE (4 + 1 + 4)
+#define PACK_INDEX_ENTRY_SIZE (8 + 8 + 4)
+
+Database_Pack::Database_Pack(const std::string &savedir) :
+	m_pack_path(savedir + DIR_DELIM + "map.pack")
+{
+	if (!fs::CreateAllDirs(savedir))
+		throw FileNotGoodException("Failed to create pack database "
+				"save directory");
+	openFile();
+}
+
+Database_Pack::~Database_Pack()
+{
+	if (m_modified)
+		writeFile();
+	closeFile();
+}
+
+void Database_Pack::openFile()
+{
+	if (!fs::PathExists(m_pack_path)) {
+		// A fresh pack; everything lives in the overlay until close
+		return;
+	}
+
+#ifndef _WIN32
+	int fd = open(m_pack_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw FileNotGoodException("Failed to open pack file " + m_pack_path);
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED) {
+			m_map = (const char *)map;
+			m_map_size = st.st_size;
+			m_mmapped = true;
+		}
+	}
+	close(fd);
+#endif
+
+	if (!m_mmapped) {
+		// No mmap support (or it failed); fall back to reading the whole
+		// file into memory
+		std::ifstream is(m_pack_path.c_str(), std::ios_base::binary);
+		if (!is.good())
+			throw FileNotGoodException("Failed to open pack file " + m_pack_path);
+		is.seekg(0, std::ios_base::end);
+		u64 size = is.tellg();
+		is.seekg(0);
+		char *buf = new char[size];
+		is.read(buf, size);
+		if (is.fail()) {
+			delete[] buf;
+			throw FileNotGoodException("Failed to read pack file " + m_pack_path);
+		}
+		m_map = buf;
+		m_map_size = size;
+	}
+
+	if (m_map_size < PACK_HEADER_SIZE
+			|| memcmp(m_map, PACK_MAGIC, 4) != 0
+			|| readU8((u8 *)m_map + 4) != PACK_VERSION)
+		throw DatabaseException("Invalid pack file " + m_pack_path);
+
+	u32 count = readU32((u8 *)m_map + 5);
+	if (m_map_size < PACK_HEADER_SIZE + (u64)count * PACK_INDEX_ENTRY_SIZE)
+		throw DatabaseException("Truncated pack file index in " + m_pack_path);
+
+	m_index.reserve(count);
+	const u8 *p = (const u8 *)m_map + PACK_HEADER_SIZE;
+	for (u32 i = 0; i < count; i++, p += PACK_INDEX_ENTRY_SIZE) {
+		IndexEntry e;
+		e.key = (s64)readU64(p);
+		e.offset = readU64(p + 8);
+		e.size = readU32(p + 16);
+		if (e.offset + e.size > m_map_size)
+			throw DatabaseException("Pack file entry out of bounds in "
+					+ m_pack_path);
+		m_index.push_back(e);
+	}
+}
+
+void Database_Pack::closeFile()
+{
+	if (!m_map)
+		return;
+#ifndef _WIN32
+	if (m_mmapped) {
+		munmap((void *)m_map, m_map_size);
+		m_map = nullptr;
+		return;
+	}
+#endif
+	delete[] m_map;
+	m_map = nullptr;
+}
+
+const Database_Pack::IndexEntry *Database_Pack::findEntry(s64 key) const
+{
+	auto it = std::lower_bound(m_index.begin(), m_index.end(), key,
+		[](const IndexEntry &e, s64 k) {
+			return e.key < k;
+		});
+	if (it == m_index.end() || it->key != key)
+		return nullptr;
+	return &(*it);
+}
+
+bool Database_Pack::saveBlock(const v3s16 &pos, const std::string &data)
+{
+	m_overlay[getBlockAsInteger(pos)] = data;
+	m_modified = true;
+	return true;
+}
+
+void Database_Pack::loadBlock(const v3s16 &pos, std::string *block)
+{
+	s64 key = getBlockAsInteger(pos);
+
+	auto it = m_overlay.find(key);
+	if (it != m_overlay.end()) {
+		*block = it->second;
+		return;
+	}
+
+	const IndexEntry *e = findEntry(key);
+	if (!e) {
+		block->clear();
+		return;
+	}
+	block->assign(m_map + e->offset, e->size);
+}
+
+bool Database_Pack::deleteBlock(const v3s16 &pos)
+{
+	s64 key = getBlockAsInteger(pos);
+	if (m_overlay.count(key) == 0 && !findEntry(key))
+		return false;
+	// Deletions are overlay entries with empty data
+	m_overlay[key].clear();
+	m_modified = true;
+	return true;
+}
+
+void Database_Pack::listAllLoadableBlocks(std::vector<v3s16> &dst)
+{
+	for (const IndexEntry &e : m_index) {
+		if (m_overlay.find(e.key) == m_overlay.end())
+			dst.push_back(getIntegerAsBlock(e.key));
+	}
+	for (const auto &it : m_overlay) {
+		if (!it.second.empty())
+			dst.push_back(getIntegerAsBlock(it.first));
+	}
+}
+
+void Database_Pack::writeFile()
+{
+	// Merge the mapped file and the overlay into a new sorted index
+	std::map<s64, std::pair<const char *, u32>> merged;
+	for (const IndexEntry &e : m_index)
+		merged[e.key] = std::make_pair(m_map + e.offset, e.size);
+	for (const auto &it : m_overlay) {
+		if (it.second.empty())
+			merged.erase(it.first);
+		else
+			merged[it.first] =
+				std::make_pair(it.second.data(), (u32)it.second.size());
+	}
+
+	std::string tmp_path = m_pack_path + ".new";
+	std::ofstream os(tmp_path.c_str(), std::ios_base::binary);
+	if (!os.good()) {
+		errorstream << "Database_Pack: cannot write " << tmp_path << std::endl;
+		return;
+	}
+
+	os.write(PACK_MAGIC, 4);
+	writeU8(os, PACK_VERSION);
+	writeU32(os, merged.size());
+
+	u64 offset = PACK_HEADER_SIZE + (u64)merged.size() * PACK_INDEX_ENTRY_SIZE;
+	for (const auto &it : merged) {
+		writeU64(os, (u64)it.first);
+		writeU64(os, offset);
+		writeU32(os, it.second.second);
+		offset += it.second.second;
+	}
+	for (const auto &it : merged)
+		os.write(it.second.first, it.second.second);
+
+	os.close();
+	if (os.fail()) {
+		errorstream << "Database_Pack: failed writing " << tmp_path << std::endl;
+		return;
+	}
+
+	// The old mapping must be gone before replacing the file it maps
+	closeFile();
+	fs::DeleteSingleFileOrEmptyDirectory(m_pack_path);
+	if (!fs::Rename(tmp_path, m_pack_path))
+		errorstream << "Database_Pack: failed to move " << tmp_path
+			<< " into place" << std::endl;
+}
@@ -0,0 +1,85 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include "database.h"
+#include "irrlichttypes.h"
+
+/*
+	Read-mostly map backend serving blocks from a single memory-mapped,
+	sorted, index-prefixed pack file (map.pack in the world directory).
+
+	Intended for static worlds (lobbies, adventure maps): block loads are
+	a binary search over the mapped index plus one memcpy, with no query
+	machinery and no syscalls on the warm path. The pack file is produced
+	offline with the usual migration step:
+
+		minetestserver --migrate pack --world <world>
+
+	Writes are accepted but only land in memory; the whole file is
+	rewritten when the backend is closed. Use a read-write backend for
+	worlds that change at runtime.
+*/
+class Database_Pack : public MapDatabase
+{
+public:
+	Database_Pack(const std::string &savedir);
+	~Database_Pack();
+
+	bool saveBlock(const v3s16 &pos, const std::string &data);
+	void loadBlock(const v3s16 &pos, std::string *block);
+	bool deleteBlock(const v3s16 &pos);
+	void listAllLoadableBlocks(std::vector<v3s16> &dst);
+
+	void beginSave() {}
+	void endSave() {}
+
+private:
+	struct IndexEntry
+	{
+		s64 key;
+		u64 offset;
+		u32 size;
+	};
+
+	void openFile();
+	void closeFile();
+	void writeFile();
+
+	// Binary search in the index; returns nullptr if absent
+	const IndexEntry *findEntry(s64 key) const;
+
+	std::string m_pack_path;
+
+	// Mapped (or, without mmap support, fully read) file contents
+	const char *m_map = nullptr;
+	u64 m_map_size = 0;
+	bool m_mmapped = false;
+
+	// Decoded from the file header at open; sorted by key
+	std::vector<IndexEntry> m_index;
+
+	// Runtime modifications; merged over the mapped file and written
+	// back on close. Empty data means the block was deleted.
+	std::map<s64, std::string> m_overlay;
+	bool m_modified = false;
+};
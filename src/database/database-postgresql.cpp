@@ -33,6 +33,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <netinet/in.h>
 #endif
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+
 #include "debug.h"
 #include "exceptions.h"
 #include "settings.h"
@@ -210,6 +215,11 @@ void MapDatabasePostgreSQL::initStatements()
 				"UPDATE SET data = $4::bytea");
 	}
 
+	prepareStatement("read_blocks",
+		"SELECT posX, posY, posZ, data FROM blocks "
+			"WHERE posX = ANY($1::int4[]) AND posY = ANY($2::int4[]) AND "
+			"posZ = ANY($3::int4[])");
+
 	prepareStatement("delete_block", "DELETE FROM blocks WHERE "
 		"posX = $1::int4 AND posY = $2::int4 AND posZ = $3::int4");
 
@@ -217,6 +227,71 @@ void MapDatabasePostgreSQL::initStatements()
 		"SELECT posX, posY, posZ FROM blocks");
 }
 
+void MapDatabasePostgreSQL::beginSave()
+{
+	Database_PostgreSQL::beginSave();
+	// Multi-row upserts need "excluded"; servers without UPSERT keep the
+	// per-block statements
+	m_batching = getPGVersion() >= 90500;
+	m_pending_writes.clear();
+}
+
+void MapDatabasePostgreSQL::endSave()
+{
+	flushPendingWrites();
+	m_batching = false;
+	Database_PostgreSQL::endSave();
+}
+
+// Blocks flushed per statement; at 4 parameters per block this stays far
+// below PostgreSQL's limit of 65535 parameters
+#define PG_WRITE_BATCH_MAX 512
+
+void MapDatabasePostgreSQL::flushPendingWrites()
+{
+	for (size_t i = 0; i < m_pending_writes.size(); i += PG_WRITE_BATCH_MAX) {
+		size_t end = std::min(i + PG_WRITE_BATCH_MAX, m_pending_writes.size());
+		size_t count = end - i;
+
+		std::vector<s32> coords;
+		coords.reserve(count * 3);
+		std::vector<const void *> args;
+		std::vector<int> arg_len, arg_fmt;
+		args.reserve(count * 4);
+		arg_len.reserve(count * 4);
+		arg_fmt.reserve(count * 4);
+
+		std::ostringstream sql;
+		sql << "INSERT INTO blocks (posX, posY, posZ, data) VALUES ";
+		for (size_t n = 0; n < count; n++) {
+			const PendingWrite &w = m_pending_writes[i + n];
+			coords.push_back(htonl(w.pos.X));
+			coords.push_back(htonl(w.pos.Y));
+			coords.push_back(htonl(w.pos.Z));
+			for (size_t c = 0; c < 3; c++) {
+				args.push_back(&coords[n * 3 + c]);
+				arg_len.push_back(sizeof(s32));
+				arg_fmt.push_back(1);
+			}
+			args.push_back(w.data.c_str());
+			arg_len.push_back((int)w.data.size());
+			arg_fmt.push_back(1);
+
+			if (n > 0)
+				sql << ",";
+			sql << "($" << (n * 4 + 1) << "::int4,$" << (n * 4 + 2)
+				<< "::int4,$" << (n * 4 + 3) << "::int4,$"
+				<< (n * 4 + 4) << "::bytea)";
+		}
+		sql << " ON CONFLICT ON CONSTRAINT blocks_pkey DO "
+			"UPDATE SET data = excluded.data";
+
+		execParams(sql.str(), (int)args.size(), args.data(),
+			arg_len.data(), arg_fmt.data());
+	}
+	m_pending_writes.clear();
+}
+
 bool MapDatabasePostgreSQL::saveBlock(const v3s16 &pos, const std::string &data)
 {
 	// Verify if we don't overflow the platform integer with the mapblock size
@@ -227,6 +302,12 @@ bool MapDatabasePostgreSQL::saveBlock(const v3s16 &pos, const std::string &data)
 		return false;
 	}
 
+	if (m_batching) {
+		// Buffered and flushed as one multi-row statement by endSave()
+		m_pending_writes.push_back(PendingWrite{pos, data});
+		return true;
+	}
+
 	verifyDatabase();
 
 	s32 x, y, z;
@@ -273,6 +354,71 @@ void MapDatabasePostgreSQL::loadBlock(const v3s16 &pos, std::string *block)
 	PQclear(results);
 }
 
+// Reads an int4 column from a binary-format result
+static inline s32 pg_binary_to_int(PGresult *res, int row, int col)
+{
+	s32 val;
+	memcpy(&val, PQgetvalue(res, row, col), sizeof(val));
+	return ntohl(val);
+}
+
+void MapDatabasePostgreSQL::loadBlocks(const std::vector<v3s16> &positions,
+		std::vector<std::string> *blocks)
+{
+	blocks->clear();
+	blocks->resize(positions.size());
+	if (positions.empty())
+		return;
+
+	verifyDatabase();
+
+	// The per-axis ANYs select the cross product of the coordinate sets,
+	// a superset of the wanted blocks; the exact positions are picked out
+	// below. Batches are spatially clustered, so the superset stays small
+	// and the whole batch costs a single round trip.
+	std::ostringstream xs, ys, zs;
+	xs << "{";
+	ys << "{";
+	zs << "{";
+	for (size_t i = 0; i < positions.size(); i++) {
+		if (i > 0) {
+			xs << ",";
+			ys << ",";
+			zs << ",";
+		}
+		xs << positions[i].X;
+		ys << positions[i].Y;
+		zs << positions[i].Z;
+	}
+	xs << "}";
+	ys << "}";
+	zs << "}";
+
+	std::string xstr = xs.str(), ystr = ys.str(), zstr = zs.str();
+	const void *args[] = { xstr.c_str(), ystr.c_str(), zstr.c_str() };
+
+	PGresult *results = execPrepared("read_blocks", ARRLEN(args), args,
+		NULL, NULL, false);
+
+	std::map<v3s16, size_t> wanted;
+	for (size_t i = 0; i < positions.size(); i++)
+		wanted[positions[i]] = i;
+
+	int numrows = PQntuples(results);
+	for (int row = 0; row < numrows; row++) {
+		v3s16 p(pg_binary_to_int(results, row, 0),
+			pg_binary_to_int(results, row, 1),
+			pg_binary_to_int(results, row, 2));
+		std::map<v3s16, size_t>::iterator it = wanted.find(p);
+		if (it == wanted.end())
+			continue;
+		(*blocks)[it->second] = std::string(PQgetvalue(results, row, 3),
+			PQgetlength(results, row, 3));
+	}
+
+	PQclear(results);
+}
+
 bool MapDatabasePostgreSQL::deleteBlock(const v3s16 &pos)
 {
 	verifyDatabase();
@@ -518,7 +664,7 @@ void PlayerDatabasePostgreSQL::savePlayer(RemotePlayer *player)
 	}
 
 	execPrepared("remove_player_metadata", 1, rmvalues);
-	const StringMap &attrs = sao->getMeta().getStrings();
+	const MetadataStringMap &attrs = sao->getMeta().getStrings();
 	for (const auto &attr : attrs) {
 		const char *meta_values[] = {
 			player->getName(),
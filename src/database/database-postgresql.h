@@ -81,6 +81,18 @@ protected:
 			(const void **)params, NULL, NULL, clear, nobinary);
 	}
 
+	// For one-off statements whose parameter count is only known at
+	// runtime (multi-row inserts); otherwise like execPrepared()
+	inline PGresult *execParams(const std::string &sql, const int paramsNumber,
+		const void **params,
+		const int *paramsLengths = NULL, const int *paramsFormats = NULL,
+		bool clear = true, bool nobinary = true)
+	{
+		return checkResults(PQexecParams(m_conn, sql.c_str(), paramsNumber,
+			NULL, (const char* const*) params, paramsLengths, paramsFormats,
+			nobinary ? 1 : 0), clear);
+	}
+
 	void createTableIfNotExists(const std::string &table_name, const std::string &definition);
 	void verifyDatabase();
 
@@ -115,15 +127,31 @@ public:
 
 	bool saveBlock(const v3s16 &pos, const std::string &data);
 	void loadBlock(const v3s16 &pos, std::string *block);
+	void loadBlocks(const std::vector<v3s16> &positions,
+			std::vector<std::string> *blocks);
 	bool deleteBlock(const v3s16 &pos);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 
-	void beginSave() { Database_PostgreSQL::beginSave(); }
-	void endSave() { Database_PostgreSQL::endSave(); }
+	void beginSave();
+	void endSave();
 
 protected:
 	virtual void createDatabase();
 	virtual void initStatements();
+
+private:
+	// Flushes m_pending_writes as multi-row upserts
+	void flushPendingWrites();
+
+	// Writes buffered between beginSave() and endSave(), so a transaction
+	// costs a handful of round trips instead of one per block. Only used
+	// on servers with UPSERT support (9.5+).
+	struct PendingWrite {
+		v3s16 pos;
+		std::string data;
+	};
+	std::vector<PendingWrite> m_pending_writes;
+	bool m_batching = false;
 };
 
 class PlayerDatabasePostgreSQL : private Database_PostgreSQL, public PlayerDatabase
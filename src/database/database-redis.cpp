@@ -73,27 +73,68 @@ Database_Redis::~Database_Redis()
 }
 
 void Database_Redis::beginSave() {
-	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "MULTI"));
-	if (!reply) {
+	// Only appended to the output buffer; everything up to and including
+	// the EXEC goes over the wire in one round trip when endSave() flushes
+	if (redisAppendCommand(ctx, "MULTI") != REDIS_OK) {
 		throw DatabaseException(std::string(
 			"Redis command 'MULTI' failed: ") + ctx->errstr);
 	}
-	freeReplyObject(reply);
+	m_transaction_active = true;
+	m_pending_commands = 0;
 }
 
 void Database_Redis::endSave() {
-	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "EXEC"));
-	if (!reply) {
+	if (redisAppendCommand(ctx, "EXEC") != REDIS_OK) {
 		throw DatabaseException(std::string(
 			"Redis command 'EXEC' failed: ") + ctx->errstr);
 	}
-	freeReplyObject(reply);
+
+	// Flush the pipeline and collect the replies: one for MULTI, one
+	// "QUEUED" per buffered command and the EXEC result array
+	size_t num_replies = m_pending_commands + 2;
+	m_transaction_active = false;
+	m_pending_commands = 0;
+
+	for (size_t i = 0; i < num_replies; i++) {
+		redisReply *reply = nullptr;
+		if (redisGetReply(ctx, (void **)&reply) != REDIS_OK || !reply) {
+			throw DatabaseException(std::string(
+				"Redis transaction failed: ") + ctx->errstr);
+		}
+		if (i == num_replies - 1 && reply->type == REDIS_REPLY_ARRAY) {
+			// The EXEC reply carries the per-command results
+			for (size_t j = 0; j < reply->elements; j++) {
+				redisReply *element = reply->element[j];
+				if (element->type == REDIS_REPLY_ERROR)
+					warningstream << "endSave: saving block failed: "
+						<< std::string(element->str, element->len)
+						<< std::endl;
+			}
+		} else if (reply->type == REDIS_REPLY_ERROR) {
+			warningstream << "endSave: " <<
+				std::string(reply->str, reply->len) << std::endl;
+		}
+		freeReplyObject(reply);
+	}
 }
 
 bool Database_Redis::saveBlock(const v3s16 &pos, const std::string &data)
 {
 	std::string tmp = i64tos(getBlockAsInteger(pos));
 
+	if (m_transaction_active) {
+		// Buffered write; failures surface when endSave() reads the
+		// transaction replies
+		if (redisAppendCommand(ctx, "HSET %s %s %b", hash.c_str(),
+				tmp.c_str(), data.c_str(), data.size()) != REDIS_OK) {
+			warningstream << "saveBlock: redis command 'HSET' failed on "
+				"block " << PP(pos) << ": " << ctx->errstr << std::endl;
+			return false;
+		}
+		m_pending_commands++;
+		return true;
+	}
+
 	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "HSET %s %s %b",
 			hash.c_str(), tmp.c_str(), data.c_str(), data.size()));
 	if (!reply) {
@@ -156,6 +197,64 @@ void Database_Redis::loadBlock(const v3s16 &pos, std::string *block)
 		"Redis command 'HGET %s %s' gave invalid reply."));
 }
 
+void Database_Redis::loadBlocks(const std::vector<v3s16> &positions,
+		std::vector<std::string> *blocks)
+{
+	blocks->clear();
+	blocks->resize(positions.size());
+	if (positions.empty())
+		return;
+
+	// Pipeline all the HGETs so the whole batch costs one round trip
+	for (const v3s16 &pos : positions) {
+		std::string tmp = i64tos(getBlockAsInteger(pos));
+		if (redisAppendCommand(ctx, "HGET %s %s",
+				hash.c_str(), tmp.c_str()) != REDIS_OK) {
+			throw DatabaseException(std::string(
+				"Redis command 'HGET %s %s' failed: ") + ctx->errstr);
+		}
+	}
+
+	// Drain every reply before reporting an error, otherwise leftover
+	// replies would be misattributed to the next command
+	std::string first_error;
+	for (size_t i = 0; i < positions.size(); i++) {
+		redisReply *reply = nullptr;
+		if (redisGetReply(ctx, (void **)&reply) != REDIS_OK || !reply) {
+			throw DatabaseException(std::string(
+				"Redis command 'HGET %s %s' failed: ") + ctx->errstr);
+		}
+		switch (reply->type) {
+		case REDIS_REPLY_STRING:
+			(*blocks)[i] = std::string(reply->str, reply->len);
+			break;
+		case REDIS_REPLY_NIL:
+			// block not found in database
+			break;
+		case REDIS_REPLY_ERROR:
+			errorstream << "loadBlocks: loading block " << PP(positions[i])
+				<< " failed: " << std::string(reply->str, reply->len)
+				<< std::endl;
+			if (first_error.empty())
+				first_error = std::string(reply->str, reply->len);
+			break;
+		default:
+			errorstream << "loadBlocks: loading block " << PP(positions[i])
+				<< " returned invalid reply type " << reply->type
+				<< std::endl;
+			if (first_error.empty())
+				first_error = "invalid reply type";
+			break;
+		}
+		freeReplyObject(reply);
+	}
+
+	if (!first_error.empty()) {
+		throw DatabaseException(std::string(
+			"Redis command 'HGET %s %s' errored: ") + first_error);
+	}
+}
+
 bool Database_Redis::deleteBlock(const v3s16 &pos)
 {
 	std::string tmp = i64tos(getBlockAsInteger(pos));
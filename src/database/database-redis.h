@@ -40,12 +40,19 @@ public:
 
 	bool saveBlock(const v3s16 &pos, const std::string &data);
 	void loadBlock(const v3s16 &pos, std::string *block);
+	void loadBlocks(const std::vector<v3s16> &positions,
+			std::vector<std::string> *blocks);
 	bool deleteBlock(const v3s16 &pos);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 
 private:
 	redisContext *ctx = nullptr;
 	std::string hash = "";
+	// Between beginSave() and endSave() the HSETs are only appended to
+	// the output buffer; endSave() flushes them and reads all replies in
+	// one round trip. Counts the commands queued since MULTI.
+	bool m_transaction_active = false;
+	size_t m_pending_commands = 0;
 };
 
 #endif // USE_REDIS
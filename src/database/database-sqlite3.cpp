@@ -167,6 +167,13 @@ void Database_SQLite3::openDatabase()
 			 + itos(g_settings->getU16("sqlite_synchronous"));
 	SQLOK(sqlite3_exec(m_database, query_str.c_str(), NULL, NULL, NULL),
 		"Failed to modify sqlite3 synchronous mode");
+	if (g_settings->getBool("sqlite_wal")) {
+		// WAL lets commits append to the log instead of rewriting pages,
+		// which makes group-committed block saves far cheaper
+		SQLOK(sqlite3_exec(m_database, "PRAGMA journal_mode = WAL",
+				NULL, NULL, NULL),
+			"Failed to enable sqlite3 write-ahead logging");
+	}
 	SQLOK(sqlite3_exec(m_database, "PRAGMA foreign_keys = ON", NULL, NULL, NULL),
 		"Failed to enable sqlite3 foreign key support");
 }
@@ -452,8 +459,9 @@ void PlayerDatabaseSQLite3::savePlayer(RemotePlayer *player)
 	sanity_check(sao);
 
 	const v3f &pos = sao->getBasePosition();
+	bool player_exists = playerDataExists(player->getName());
 	// Begin save in brace is mandatory
-	if (!playerDataExists(player->getName())) {
+	if (!player_exists) {
 		beginSave();
 		str_to_sqlite(m_stmt_player_add, 1, player->getName());
 		double_to_sqlite(m_stmt_player_add, 2, sao->getLookPitch());
@@ -481,52 +489,57 @@ void PlayerDatabaseSQLite3::savePlayer(RemotePlayer *player)
 		sqlite3_reset(m_stmt_player_update);
 	}
 
-	// Write player inventories
-	str_to_sqlite(m_stmt_player_remove_inventory, 1, player->getName());
-	sqlite3_vrfy(sqlite3_step(m_stmt_player_remove_inventory), SQLITE_DONE);
-	sqlite3_reset(m_stmt_player_remove_inventory);
-
-	str_to_sqlite(m_stmt_player_remove_inventory_items, 1, player->getName());
-	sqlite3_vrfy(sqlite3_step(m_stmt_player_remove_inventory_items), SQLITE_DONE);
-	sqlite3_reset(m_stmt_player_remove_inventory_items);
-
-	std::vector<const InventoryList*> inventory_lists = sao->getInventory()->getLists();
-	for (u16 i = 0; i < inventory_lists.size(); i++) {
-		const InventoryList* list = inventory_lists[i];
-
-		str_to_sqlite(m_stmt_player_add_inventory, 1, player->getName());
-		int_to_sqlite(m_stmt_player_add_inventory, 2, i);
-		int_to_sqlite(m_stmt_player_add_inventory, 3, list->getWidth());
-		str_to_sqlite(m_stmt_player_add_inventory, 4, list->getName());
-		int_to_sqlite(m_stmt_player_add_inventory, 5, list->getSize());
-		sqlite3_vrfy(sqlite3_step(m_stmt_player_add_inventory), SQLITE_DONE);
-		sqlite3_reset(m_stmt_player_add_inventory);
-
-		for (u32 j = 0; j < list->getSize(); j++) {
-			std::ostringstream os;
-			list->getItem(j).serialize(os);
-			std::string itemStr = os.str();
-
-			str_to_sqlite(m_stmt_player_add_inventory_items, 1, player->getName());
-			int_to_sqlite(m_stmt_player_add_inventory_items, 2, i);
-			int_to_sqlite(m_stmt_player_add_inventory_items, 3, j);
-			str_to_sqlite(m_stmt_player_add_inventory_items, 4, itemStr);
-			sqlite3_vrfy(sqlite3_step(m_stmt_player_add_inventory_items), SQLITE_DONE);
-			sqlite3_reset(m_stmt_player_add_inventory_items);
+	// Write player inventories. Rewriting every list is the expensive part
+	// of this function, so it is skipped when the inventory is unchanged.
+	if (!player_exists || player->checkInventoryModified()) {
+		str_to_sqlite(m_stmt_player_remove_inventory, 1, player->getName());
+		sqlite3_vrfy(sqlite3_step(m_stmt_player_remove_inventory), SQLITE_DONE);
+		sqlite3_reset(m_stmt_player_remove_inventory);
+
+		str_to_sqlite(m_stmt_player_remove_inventory_items, 1, player->getName());
+		sqlite3_vrfy(sqlite3_step(m_stmt_player_remove_inventory_items), SQLITE_DONE);
+		sqlite3_reset(m_stmt_player_remove_inventory_items);
+
+		std::vector<const InventoryList*> inventory_lists = sao->getInventory()->getLists();
+		for (u16 i = 0; i < inventory_lists.size(); i++) {
+			const InventoryList* list = inventory_lists[i];
+
+			str_to_sqlite(m_stmt_player_add_inventory, 1, player->getName());
+			int_to_sqlite(m_stmt_player_add_inventory, 2, i);
+			int_to_sqlite(m_stmt_player_add_inventory, 3, list->getWidth());
+			str_to_sqlite(m_stmt_player_add_inventory, 4, list->getName());
+			int_to_sqlite(m_stmt_player_add_inventory, 5, list->getSize());
+			sqlite3_vrfy(sqlite3_step(m_stmt_player_add_inventory), SQLITE_DONE);
+			sqlite3_reset(m_stmt_player_add_inventory);
+
+			for (u32 j = 0; j < list->getSize(); j++) {
+				std::ostringstream os;
+				list->getItem(j).serialize(os);
+				std::string itemStr = os.str();
+
+				str_to_sqlite(m_stmt_player_add_inventory_items, 1, player->getName());
+				int_to_sqlite(m_stmt_player_add_inventory_items, 2, i);
+				int_to_sqlite(m_stmt_player_add_inventory_items, 3, j);
+				str_to_sqlite(m_stmt_player_add_inventory_items, 4, itemStr);
+				sqlite3_vrfy(sqlite3_step(m_stmt_player_add_inventory_items), SQLITE_DONE);
+				sqlite3_reset(m_stmt_player_add_inventory_items);
+			}
 		}
 	}
 
-	str_to_sqlite(m_stmt_player_metadata_remove, 1, player->getName());
-	sqlite3_vrfy(sqlite3_step(m_stmt_player_metadata_remove), SQLITE_DONE);
-	sqlite3_reset(m_stmt_player_metadata_remove);
-
-	const StringMap &attrs = sao->getMeta().getStrings();
-	for (const auto &attr : attrs) {
-		str_to_sqlite(m_stmt_player_metadata_add, 1, player->getName());
-		str_to_sqlite(m_stmt_player_metadata_add, 2, attr.first);
-		str_to_sqlite(m_stmt_player_metadata_add, 3, attr.second);
-		sqlite3_vrfy(sqlite3_step(m_stmt_player_metadata_add), SQLITE_DONE);
-		sqlite3_reset(m_stmt_player_metadata_add);
+	if (!player_exists || sao->getMeta().isModified()) {
+		str_to_sqlite(m_stmt_player_metadata_remove, 1, player->getName());
+		sqlite3_vrfy(sqlite3_step(m_stmt_player_metadata_remove), SQLITE_DONE);
+		sqlite3_reset(m_stmt_player_metadata_remove);
+
+		const MetadataStringMap &attrs = sao->getMeta().getStrings();
+		for (const auto &attr : attrs) {
+			str_to_sqlite(m_stmt_player_metadata_add, 1, player->getName());
+			str_to_sqlite(m_stmt_player_metadata_add, 2, attr.first);
+			str_to_sqlite(m_stmt_player_metadata_add, 3, attr.second);
+			sqlite3_vrfy(sqlite3_step(m_stmt_player_metadata_add), SQLITE_DONE);
+			sqlite3_reset(m_stmt_player_metadata_add);
+		}
 	}
 
 	endSave();
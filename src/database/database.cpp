@@ -38,6 +38,15 @@ static inline s16 unsigned_to_signed(u16 i, u16 max_positive)
 }
 
 
+void MapDatabase::loadBlocks(const std::vector<v3s16> &positions,
+		std::vector<std::string> *blocks)
+{
+	blocks->resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		loadBlock(positions[i], &(*blocks)[i]);
+}
+
+
 // Modulo of a negative number does not work consistently in C
 static inline s64 pythonmodulo(s64 i, s16 mod)
 {
@@ -21,6 +21,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "emerge.h"
 
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <queue>
 
@@ -46,6 +48,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "voxel.h"
 
+// Set while a thread finalizes a chunk generated by another thread (see
+// EmergeThread::finalizePendingChunk); getCurrentMapgen() resolves to it
+static thread_local Mapgen *t_finalizing_mapgen = nullptr;
+
 class EmergeThread : public Thread {
 public:
 	bool enable_mapgen_debug_info;
@@ -62,6 +68,13 @@ public:
 
 	void cancelPendingItems();
 
+	// Finalizes a chunk handed over by this thread's generation stage.
+	// Called from the server thread with the env lock held.
+	void finalizePendingChunk();
+	// Drops a not-yet-finalized chunk; only valid once the thread has
+	// been stopped and joined
+	void discardPendingChunk();
+
 	static void runCompletionCallbacks(
 		const v3s16 &pos, EmergeAction action,
 		const EmergeCallbackList &callbacks);
@@ -73,14 +86,35 @@ private:
 	Mapgen *m_mapgen;
 
 	Event m_queue_event;
-	std::queue<v3s16> m_block_queue;
+	// Not an actual FIFO: popBlockEmerge() picks the entry closest to an
+	// interested player (see EmergeManager::getBlockPriority)
+	std::deque<v3s16> m_block_queue;
+
+	/*
+		Staged pipeline (see EmergeManager::finalizeCompletedChunks).
+		After makeChunk the generated chunk waits here until the server
+		thread has blitted it into the map and run the Lua callbacks;
+		meanwhile this thread keeps servicing loads from memory and disk.
+		Only one chunk per thread is ever in flight, because the next
+		makeChunk would clobber the mapgen state (heightmaps, gennotify)
+		that the finalize stage still reads.
+	*/
+	bool m_pipeline;
+	v3s16 m_finalize_pos;
+	BlockMakeData m_finalize_bmdata;
+	BlockEmergeData m_finalize_bedata;
+	std::atomic<bool> m_finalize_pending;
+
+	// Ensures the previous chunk's finalize stage has run (doing it
+	// here if need be) and readies m_finalize_bmdata for reuse
+	void waitForPendingFinalize();
 
 	bool popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata);
 
 	EmergeAction getBlockOrStartGen(
 		const v3s16 &pos, bool allow_gen, MapBlock **block, BlockMakeData *data);
 	MapBlock *finishGen(v3s16 pos, BlockMakeData *bmdata,
-		std::map<v3s16, MapBlock *> *modified_blocks);
+		std::map<v3s16, MapBlock *> *modified_blocks, bool env_locked = false);
 
 	friend class EmergeManager;
 };
@@ -188,6 +222,9 @@ void EmergeManager::initMapgens(MapgenParams *params)
 {
 	FATAL_ERROR_IF(!m_mapgens.empty(), "Mapgen already initialised.");
 
+	// All mapgens share `params`, which is immutable from this point on
+	// (MapSettingsManager refuses further changes once it has been built),
+	// so generation itself never needs to consult Settings
 	mgparams = params;
 
 	for (u32 i = 0; i != m_threads.size(); i++)
@@ -197,6 +234,9 @@ void EmergeManager::initMapgens(MapgenParams *params)
 
 Mapgen *EmergeManager::getCurrentMapgen()
 {
+	if (t_finalizing_mapgen)
+		return t_finalizing_mapgen;
+
 	if (!m_threads_active)
 		return nullptr;
 
@@ -236,9 +276,25 @@ void EmergeManager::stopThreads()
 	for (u32 i = 0; i != m_threads.size(); i++)
 		m_threads[i]->wait();
 
+	// Chunks still waiting for their finalize stage will never get it
+	for (u32 i = 0; i != m_threads.size(); i++)
+		m_threads[i]->discardPendingChunk();
+
 	m_threads_active = false;
 }
 
+size_t EmergeManager::getQueuedCount()
+{
+	MutexAutoLock queuelock(m_queue_mutex);
+	return m_blocks_enqueued.size();
+}
+
+void EmergeManager::finalizeCompletedChunks()
+{
+	for (EmergeThread *thread : m_threads)
+		thread->finalizePendingChunk();
+}
+
 
 bool EmergeManager::isRunning()
 {
@@ -391,10 +447,54 @@ bool EmergeManager::pushBlockEmergeData(
 		count_peer++;
 	}
 
+	// A requesting peer is evidently connected, even if the positions
+	// have not been refreshed since it joined
+	if (peer_requested != PEER_ID_INEXISTENT)
+		m_active_peers.insert(peer_requested);
+
 	return true;
 }
 
 
+void EmergeManager::updatePlayerPositions(const std::vector<v3s16> &positions,
+	const std::unordered_set<session_t> &peers)
+{
+	MutexAutoLock queuelock(m_queue_mutex);
+
+	m_peer_block_positions = positions;
+	m_active_peers = peers;
+}
+
+
+s32 EmergeManager::getBlockPriority(const v3s16 &pos)
+{
+	if (m_peer_block_positions.empty())
+		return 0;
+
+	s32 best = S32_MAX;
+	for (const v3s16 &p : m_peer_block_positions) {
+		v3s16 d = pos - p;
+		s32 dist = (s32)d.X * d.X + (s32)d.Y * d.Y + (s32)d.Z * d.Z;
+		if (dist < best)
+			best = dist;
+	}
+
+	return best;
+}
+
+
+bool EmergeManager::isRequestObsolete(const BlockEmergeData &bedata)
+{
+	// Server- or mod-initiated requests never become obsolete here
+	if (bedata.peer_requested == PEER_ID_INEXISTENT)
+		return false;
+	if (!bedata.callbacks.empty())
+		return false;
+
+	return m_active_peers.find(bedata.peer_requested) == m_active_peers.end();
+}
+
+
 bool EmergeManager::popBlockEmergeData(v3s16 pos, BlockEmergeData *bedata)
 {
 	std::map<v3s16, BlockEmergeData>::iterator it;
@@ -451,7 +551,9 @@ EmergeThread::EmergeThread(Server *server, int ethreadid) :
 	m_server(server),
 	m_map(NULL),
 	m_emerge(NULL),
-	m_mapgen(NULL)
+	m_mapgen(NULL),
+	m_pipeline(g_settings->getBool("emerge_pipeline")),
+	m_finalize_pending(false)
 {
 	m_name = "Emerge-" + itos(ethreadid);
 }
@@ -465,7 +567,7 @@ void EmergeThread::signal()
 
 bool EmergeThread::pushBlock(const v3s16 &pos)
 {
-	m_block_queue.push(pos);
+	m_block_queue.push_back(pos);
 	return true;
 }
 
@@ -479,7 +581,7 @@ void EmergeThread::cancelPendingItems()
 		v3s16 pos;
 
 		pos = m_block_queue.front();
-		m_block_queue.pop();
+		m_block_queue.pop_front();
 
 		m_emerge->popBlockEmergeData(pos, &bedata);
 
@@ -488,6 +590,65 @@ void EmergeThread::cancelPendingItems()
 }
 
 
+void EmergeThread::waitForPendingFinalize()
+{
+	if (m_finalize_pending.load(std::memory_order_acquire)) {
+		// The server thread has not gotten to our chunk yet; rather
+		// than idle, finalize it ourselves. Worst case this equals the
+		// old synchronous behavior.
+		SharedMutexWriteLock envlock(m_server->m_env_mutex);
+		finalizePendingChunk();
+	}
+
+	// Ready the slot for the next chunk
+	delete m_finalize_bmdata.vmanip;
+	m_finalize_bmdata.vmanip = nullptr;
+	while (m_finalize_bmdata.transforming_liquid.size())
+		m_finalize_bmdata.transforming_liquid.pop_front();
+}
+
+
+void EmergeThread::finalizePendingChunk()
+{
+	if (!m_finalize_pending.load(std::memory_order_acquire))
+		return;
+
+	std::map<v3s16, MapBlock *> modified_blocks;
+
+	// Let getCurrentMapgen() resolve to the generating thread's mapgen
+	// while its chunk is finalized here
+	t_finalizing_mapgen = m_mapgen;
+	MapBlock *block = finishGen(m_finalize_pos, &m_finalize_bmdata,
+			&modified_blocks, true);
+	t_finalizing_mapgen = nullptr;
+
+	runCompletionCallbacks(m_finalize_pos, EMERGE_GENERATED,
+			m_finalize_bedata.callbacks);
+
+	if (block)
+		modified_blocks[m_finalize_pos] = block;
+	if (!modified_blocks.empty())
+		m_server->SetBlocksNotSent(modified_blocks);
+
+	m_finalize_pending.store(false, std::memory_order_release);
+}
+
+
+void EmergeThread::discardPendingChunk()
+{
+	if (!m_finalize_pending.load(std::memory_order_acquire))
+		return;
+
+	delete m_finalize_bmdata.vmanip;
+	m_finalize_bmdata.vmanip = nullptr;
+
+	runCompletionCallbacks(m_finalize_pos, EMERGE_CANCELLED,
+			m_finalize_bedata.callbacks);
+
+	m_finalize_pending.store(false, std::memory_order_release);
+}
+
+
 void EmergeThread::runCompletionCallbacks(const v3s16 &pos, EmergeAction action,
 	const EmergeCallbackList &callbacks)
 {
@@ -507,35 +668,85 @@ bool EmergeThread::popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata)
 {
 	MutexAutoLock queuelock(m_emerge->m_queue_mutex);
 
-	if (m_block_queue.empty())
-		return false;
+	while (!m_block_queue.empty()) {
+		// Pick the queued block closest to any interested player, so that
+		// after a teleport the new surroundings generate before the stale
+		// far-away requests
+		size_t best_i = 0;
+		s32 best_prio = m_emerge->getBlockPriority(m_block_queue[0]);
+		for (size_t i = 1; i < m_block_queue.size(); i++) {
+			s32 prio = m_emerge->getBlockPriority(m_block_queue[i]);
+			if (prio < best_prio) {
+				best_i = i;
+				best_prio = prio;
+			}
+		}
 
-	*pos = m_block_queue.front();
-	m_block_queue.pop();
+		v3s16 p = m_block_queue[best_i];
+		m_block_queue.erase(m_block_queue.begin() + best_i);
 
-	m_emerge->popBlockEmergeData(*pos, bedata);
+		if (!m_emerge->popBlockEmergeData(p, bedata))
+			continue;
 
-	return true;
+		// Requests left behind by a disconnected peer are dropped here in
+		// O(1) instead of spending generation capacity on them
+		if (m_emerge->isRequestObsolete(*bedata)) {
+			runCompletionCallbacks(p, EMERGE_CANCELLED, bedata->callbacks);
+			continue;
+		}
+
+		*pos = p;
+		return true;
+	}
+
+	return false;
 }
 
 
 EmergeAction EmergeThread::getBlockOrStartGen(
 	const v3s16 &pos, bool allow_gen, MapBlock **block, BlockMakeData *bmdata)
 {
-	MutexAutoLock envlock(m_server->m_env_mutex);
+	bool in_memory;
+	{
+		SharedMutexWriteLock envlock(m_server->m_env_mutex);
 
-	// 1). Attempt to fetch block from memory
-	*block = m_map->getBlockNoCreateNoEx(pos);
-	if (*block && !(*block)->isDummy()) {
-		if ((*block)->isGenerated())
+		// 1). Attempt to fetch block from memory
+		*block = m_map->getBlockNoCreateNoEx(pos);
+		in_memory = *block && !(*block)->isDummy();
+		if (in_memory && (*block)->isGenerated())
 			return EMERGE_FROM_MEMORY;
-	} else {
-		// 2). Attempt to load block from disk if it was not in the memory
-		*block = m_map->loadBlock(pos);
-		if (*block && (*block)->isGenerated())
-			return EMERGE_FROM_DISK;
 	}
 
+	if (!in_memory) {
+		// 2). Attempt to load it from disk. The database read and the
+		// deserialization run without the environment lock, so cold
+		// loads scale with the number of emerge threads.
+		std::string blob;
+		if (m_map->loadBlockData(pos, &blob)) {
+			MapBlock *loaded = m_map->deserializeBlock(pos, &blob);
+			SharedMutexWriteLock envlock(m_server->m_env_mutex);
+			if (loaded) {
+				*block = m_map->insertLoadedBlock(loaded);
+				if (!*block) {
+					// Lost a race for the position (e.g. against a dummy
+					// block); fall back to the synchronous path
+					*block = m_map->loadBlock(pos);
+				}
+			}
+			if (*block && (*block)->isGenerated())
+				return EMERGE_FROM_DISK;
+		} else {
+			// Nothing in the database; let the full loadBlock() try the
+			// legacy sector files
+			SharedMutexWriteLock envlock(m_server->m_env_mutex);
+			*block = m_map->loadBlock(pos);
+			if (*block && (*block)->isGenerated())
+				return EMERGE_FROM_DISK;
+		}
+	}
+
+	SharedMutexWriteLock envlock(m_server->m_env_mutex);
+
 	// 3). Attempt to start generation
 	if (allow_gen && m_map->initBlockMake(pos, bmdata))
 		return EMERGE_GENERATED;
@@ -546,9 +757,12 @@ EmergeAction EmergeThread::getBlockOrStartGen(
 
 
 MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
-	std::map<v3s16, MapBlock *> *modified_blocks)
+	std::map<v3s16, MapBlock *> *modified_blocks, bool env_locked)
 {
-	MutexAutoLock envlock(m_server->m_env_mutex);
+	std::unique_lock<SharedMutex> envlock(m_server->m_env_mutex,
+			std::defer_lock);
+	if (!env_locked)
+		envlock.lock();
 	ScopeProfiler sp(g_profiler,
 		"EmergeThread: after Mapgen::makeChunk", SPT_AVG);
 
@@ -632,16 +846,34 @@ void *EmergeThread::run()
 		bool allow_gen = bedata.flags & BLOCK_EMERGE_ALLOW_GEN;
 		EMERGE_DBG_OUT("pos=" PP(pos) " allow_gen=" << allow_gen);
 
-		action = getBlockOrStartGen(pos, allow_gen, &block, &bmdata);
+		BlockMakeData *bmdata_ptr = &bmdata;
+		if (allow_gen && m_pipeline) {
+			// Our previous chunk must be fully finalized before the
+			// mapgen state can be reused
+			waitForPendingFinalize();
+			bmdata_ptr = &m_finalize_bmdata;
+		}
+
+		action = getBlockOrStartGen(pos, allow_gen, &block, bmdata_ptr);
 		if (action == EMERGE_GENERATED) {
 			{
 				ScopeProfiler sp(g_profiler,
 					"EmergeThread: Mapgen::makeChunk", SPT_AVG);
 
-				m_mapgen->makeChunk(&bmdata);
+				m_mapgen->makeChunk(bmdata_ptr);
+			}
+
+			if (m_pipeline) {
+				// Hand the chunk to the server thread; the blit, the Lua
+				// callbacks and the client notification all happen there
+				// while this thread services the next queue item
+				m_finalize_pos = pos;
+				m_finalize_bedata = bedata;
+				m_finalize_pending.store(true, std::memory_order_release);
+				continue;
 			}
 
-			block = finishGen(pos, &bmdata, &modified_blocks);
+			block = finishGen(pos, bmdata_ptr, &modified_blocks);
 		}
 
 		runCompletionCallbacks(pos, action, bedata.callbacks);
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <map>
 #include <mutex>
+#include <unordered_set>
 #include "network/networkprotocol.h"
 #include "irr_v3d.h"
 #include "util/container.h"
@@ -123,6 +124,20 @@ public:
 	void stopThreads();
 	bool isRunning();
 
+	// Runs the finalize stage of the emerge pipeline: blits chunks the
+	// emerge threads have generated into the map and fires their
+	// callbacks. Call from the server thread with the env lock held.
+	void finalizeCompletedChunks();
+
+	// Refreshes the player block positions used to prioritize the emerge
+	// queues and the set of connected peers used to drop obsolete requests.
+	// Call from the server thread.
+	void updatePlayerPositions(const std::vector<v3s16> &positions,
+		const std::unordered_set<session_t> &peers);
+
+	// Depth of the emerge queue, e.g. for the metrics exporter
+	size_t getQueuedCount();
+
 	bool enqueueBlockEmerge(
 		session_t peer_id,
 		v3s16 blockpos,
@@ -156,6 +171,18 @@ private:
 	std::map<v3s16, BlockEmergeData> m_blocks_enqueued;
 	std::unordered_map<u16, u16> m_peer_queue_count;
 
+	// Block positions of connected players and their session IDs, updated
+	// each tick by updatePlayerPositions() (guarded by m_queue_mutex).
+	// Peers are also added on enqueue so fresh requests are never treated
+	// as obsolete before the next tick's refresh.
+	std::vector<v3s16> m_peer_block_positions;
+	std::unordered_set<session_t> m_active_peers;
+
+	// Requires m_queue_mutex held; lower value = higher priority
+	s32 getBlockPriority(const v3s16 &pos);
+	// Requires m_queue_mutex held
+	bool isRequestObsolete(const BlockEmergeData &bedata);
+
 	u16 m_qlimit_total;
 	u16 m_qlimit_diskonly;
 	u16 m_qlimit_generate;
@@ -94,8 +94,13 @@ inline static bool isPointableNode(const MapNode &n,
 	       (liquids_pointable && features.isLiquid());
 }
 
-void Environment::continueRaycast(RaycastState *state, PointedThing *result)
+void Environment::continueRaycast(RaycastState *state, PointedThing *result,
+	RaycastNodeCache *cache)
 {
+	RaycastNodeCache local_cache;
+	if (cache == nullptr)
+		cache = &local_cache;
+
 	const NodeDefManager *nodedef = getMap().getNodeDefManager();
 	if (state->m_initialization_needed) {
 		// Add objects
@@ -159,7 +164,7 @@ void Environment::continueRaycast(RaycastState *state, PointedThing *result)
 			v3s16 np(x, y, z);
 			bool is_valid_position;
 
-			n = map.getNode(np, &is_valid_position);
+			n = cache->getNode(map, np, &is_valid_position);
 			if (!(is_valid_position && isPointableNode(n, nodedef,
 					state->m_liquids_pointable))) {
 				continue;
@@ -259,6 +264,22 @@ void Environment::continueRaycast(RaycastState *state, PointedThing *result)
 	}
 }
 
+void Environment::raycastBatch(std::vector<RaycastState> &states,
+	std::vector<PointedThing> &results)
+{
+	results.clear();
+	results.reserve(states.size());
+
+	// Nearby rays tend to pass through the same blocks, so one cache
+	// serves the whole batch.
+	RaycastNodeCache cache;
+	for (RaycastState &state : states) {
+		PointedThing result;
+		continueRaycast(&state, &result, &cache);
+		results.push_back(result);
+	}
+}
+
 void Environment::stepTimeOfDay(float dtime)
 {
 	MutexAutoLock lock(this->m_time_lock);
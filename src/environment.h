@@ -42,6 +42,7 @@ class IGameDef;
 class Map;
 struct PointedThing;
 class RaycastState;
+class RaycastNodeCache;
 
 class Environment
 {
@@ -92,9 +93,22 @@ public:
 	/*!
 	 * Returns the next node or object the shootline meets.
 	 * @param state current state of the raycast
-	 * @result output, will contain the next pointed thing
+	 * @param result output, will contain the next pointed thing
+	 * @param cache optional block-lookup cache shared between rays,
+	 * may be null
 	 */
-	void continueRaycast(RaycastState *state, PointedThing *result);
+	void continueRaycast(RaycastState *state, PointedThing *result,
+		RaycastNodeCache *cache = nullptr);
+
+	/*!
+	 * Runs a batch of raycasts, sharing the block-lookup cache
+	 * between rays. Only the first pointed thing of each ray is
+	 * found; rays that hit nothing get POINTEDTHING_NOTHING.
+	 * @param[in]  states  the raycasts to run
+	 * @param[out] results one pointed thing per state
+	 */
+	void raycastBatch(std::vector<RaycastState> &states,
+		std::vector<PointedThing> &results);
 
 	// counter used internally when triggering ABMs
 	u32 m_added_objects;
@@ -18,27 +18,42 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "face_position_cache.h"
-#include "threading/mutex_auto_lock.h"
 
+#include <array>
+#include <unordered_map>
 
-std::unordered_map<u16, std::vector<v3s16>> FacePositionCache::cache;
-std::mutex FacePositionCache::cache_mutex;
+// Radii below this are covered by the shared precomputed tables; the
+// block send loop and find_node_near rarely go beyond it
+static const u16 PRECOMPUTED_RADII = 16;
 
-// Calculate the borders of a "d-radius" cube
 const std::vector<v3s16> &FacePositionCache::getFacePositions(u16 d)
 {
-	MutexAutoLock lock(cache_mutex);
-	std::unordered_map<u16, std::vector<v3s16>>::const_iterator it = cache.find(d);
-	if (it != cache.end())
+	// Built once on first use; initialization of the static local is
+	// thread-safe and all later accesses are read-only
+	static const std::array<std::vector<v3s16>, PRECOMPUTED_RADII> precomputed = [] {
+		std::array<std::vector<v3s16>, PRECOMPUTED_RADII> tables;
+		for (u16 i = 0; i < PRECOMPUTED_RADII; i++)
+			tables[i] = generateFacePosition(i);
+		return tables;
+	}();
+
+	if (d < PRECOMPUTED_RADII)
+		return precomputed[d];
+
+	// Rare large radii are cached per thread, so this path needs no
+	// lock either
+	static thread_local std::unordered_map<u16, std::vector<v3s16>> large_cache;
+	auto it = large_cache.find(d);
+	if (it != large_cache.end())
 		return it->second;
 
-	return generateFacePosition(d);
+	return large_cache[d] = generateFacePosition(d);
 }
 
-const std::vector<v3s16> &FacePositionCache::generateFacePosition(u16 d)
+// Calculate the borders of a "d-radius" cube
+std::vector<v3s16> FacePositionCache::generateFacePosition(u16 d)
 {
-	cache[d] = std::vector<v3s16>();
-	std::vector<v3s16> &c = cache[d];
+	std::vector<v3s16> c;
 	if (d == 0) {
 		c.emplace_back(0,0,0);
 		return c;
@@ -77,6 +92,9 @@ const std::vector<v3s16> &FacePositionCache::generateFacePosition(u16 d)
 		return c;
 	}
 
+	// The faces of the cube hold 24*d*d + 2 positions
+	c.reserve(24 * (u32) d * d + 2);
+
 	// Take blocks in all sides, starting from y=0 and going +-y
 	for (s16 y = 0; y <= d - 1; y++) {
 		// Left and right side, including borders
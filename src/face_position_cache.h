@@ -21,21 +21,22 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irr_v3d.h"
 
-#include <map>
 #include <vector>
-#include <unordered_map>
-#include <mutex>
 
 /*
- * This class permits caching getFacePosition call results.
- * This reduces CPU usage and vector calls.
+ * Provides the border positions of a "d-radius" cube, as used by the
+ * block send loop and find_node_near.
+ *
+ * The tables for the practically used radii are built once and shared
+ * read-only afterwards, so those lookups take no lock; rarer large
+ * radii fall back to a per-thread cache, which keeps that path
+ * lock-free as well. Returned references stay valid for the lifetime
+ * of the calling thread.
  */
 class FacePositionCache {
 public:
 	static const std::vector<v3s16> &getFacePositions(u16 d);
 
 private:
-	static const std::vector<v3s16> &generateFacePosition(u16 d);
-	static std::unordered_map<u16, std::vector<v3s16>> cache;
-	static std::mutex cache_mutex;
+	static std::vector<v3s16> generateFacePosition(u16 d);
 };
@@ -24,9 +24,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <cstring>
 #include <cerrno>
 #include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "log.h"
 #include "config.h"
 #include "porting.h"
+#include "threading/event.h"
+#include "threading/thread_pool.h"
 #ifdef __ANDROID__
 #include "settings.h" // For g_settings
 #endif
@@ -694,6 +698,23 @@ const char *GetFilenameFromPath(const char *path)
 	return filename ? filename + 1 : path;
 }
 
+bool GetFileSizeAndMTime(const std::string &path,
+		long long *size, long long *mtime)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path.c_str(), &st) != 0)
+		return false;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+#endif
+	*size = (long long)st.st_size;
+	*mtime = (long long)st.st_mtime;
+	return true;
+}
+
 bool safeWriteToFile(const std::string &path, const std::string &content)
 {
 	std::string tmp_file = path + ".~mt";
@@ -744,6 +765,41 @@ bool safeWriteToFile(const std::string &path, const std::string &content)
 	return true;
 }
 
+/*
+	Small metadata files (env_meta.txt, map_meta.txt, auth.txt, mod storage)
+	are rewritten on a fixed cadence from the server thread. The asynchronous
+	variant hands the write to the shared thread pool instead; a group cap of
+	one serializes the writes, so successive writes to the same path land on
+	disk in submission order while keeping safeWriteToFile()'s
+	rename-into-place semantics.
+*/
+static u32 getAsyncWriteGroup()
+{
+	static u32 group_id = g_thread_pool->registerGroup("file_write", 1);
+	return group_id;
+}
+
+void safeWriteToFileAsync(const std::string &path, const std::string &content)
+{
+	g_thread_pool->submit(getAsyncWriteGroup(), TASK_PRIORITY_NORMAL,
+		[path, content]() {
+			if (!safeWriteToFile(path, content))
+				errorstream << "safeWriteToFileAsync: failed to write "
+					<< path << std::endl;
+		});
+}
+
+void flushAsyncWrites()
+{
+	// The writes are serialized, so once this sentinel task has run
+	// everything submitted before it is on disk. If the pool has not been
+	// started, submit() already ran every write inline.
+	Event written;
+	g_thread_pool->submit(getAsyncWriteGroup(), TASK_PRIORITY_NORMAL,
+		[&written]() { written.signal(); });
+	written.wait();
+}
+
 bool Rename(const std::string &from, const std::string &to)
 {
 	return rename(from.c_str(), to.c_str()) == 0;
@@ -126,8 +126,24 @@ std::string AbsolutePath(const std::string &path);
 // delimiter is found.
 const char *GetFilenameFromPath(const char *path);
 
+// Returns the size and modification time of a file, or false if it
+// cannot be accessed
+bool GetFileSizeAndMTime(const std::string &path,
+		long long *size, long long *mtime);
+
 bool safeWriteToFile(const std::string &path, const std::string &content);
 
+// Asynchronous variant of safeWriteToFile(). The write runs as a task on the
+// shared thread pool, serialized with every other asynchronous write, so
+// successive writes to the same path land on disk in submission order.
+// Failures are logged instead of returned.
+void safeWriteToFileAsync(const std::string &path, const std::string &content);
+
+// Waits until every write queued with safeWriteToFileAsync() so far has
+// finished. Call this before reading back a file that may have a write
+// pending, and after the final saves on shutdown.
+void flushAsyncWrites();
+
 bool Rename(const std::string &from, const std::string &to);
 
 } // namespace fs
@@ -36,6 +36,25 @@ ObjectProperties gob_read_set_properties(std::istream &is)
 	return prop;
 }
 
+std::string gob_cmd_set_properties_delta(const ObjectProperties &prop,
+		const ObjectProperties &last_sent)
+{
+	std::string fields = prop.serializeDelta(last_sent);
+	if (fields.empty())
+		return "";
+
+	std::string os;
+	os.reserve(1 + fields.size());
+	putU8(os, GENERIC_CMD_SET_PROPERTIES_DELTA);
+	os += fields;
+	return os;
+}
+
+void gob_read_set_properties_delta(std::istream &is, ObjectProperties &prop)
+{
+	prop.deSerializeDelta(is);
+}
+
 std::string gob_cmd_update_position(
 	v3f position,
 	v3f velocity,
@@ -45,34 +64,102 @@ std::string gob_cmd_update_position(
 	bool is_movement_end,
 	f32 update_interval
 ){
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 4 * 12 + 2 + 4);
 	// command
-	writeU8(os, GENERIC_CMD_UPDATE_POSITION);
+	putU8(os, GENERIC_CMD_UPDATE_POSITION);
 	// pos
-	writeV3F32(os, position);
+	putV3F32(os, position);
 	// velocity
-	writeV3F32(os, velocity);
+	putV3F32(os, velocity);
 	// acceleration
-	writeV3F32(os, acceleration);
+	putV3F32(os, acceleration);
 	// rotation
-	writeV3F32(os, rotation);
+	putV3F32(os, rotation);
 	// do_interpolate
-	writeU8(os, do_interpolate);
+	putU8(os, do_interpolate);
 	// is_end_position (for interpolation)
-	writeU8(os, is_movement_end);
+	putU8(os, is_movement_end);
 	// update_interval (for interpolation)
-	writeF32(os, update_interval);
-	return os.str();
+	putF32(os, update_interval);
+	return os;
+}
+
+std::string gob_cmd_update_position_keyframe(
+	u8 keyframe_seq,
+	v3f position,
+	v3f velocity,
+	v3f acceleration,
+	v3f rotation,
+	bool do_interpolate,
+	bool is_movement_end,
+	f32 update_interval
+){
+	std::string os;
+	os.reserve(2 + 4 * 12 + 2 + 4);
+	// command
+	putU8(os, GENERIC_CMD_UPDATE_POSITION_KEYFRAME);
+	// reference for following delta messages
+	putU8(os, keyframe_seq);
+	// pos
+	putV3F32(os, position);
+	// velocity
+	putV3F32(os, velocity);
+	// acceleration
+	putV3F32(os, acceleration);
+	// rotation
+	putV3F32(os, rotation);
+	// do_interpolate
+	putU8(os, do_interpolate);
+	// is_end_position (for interpolation)
+	putU8(os, is_movement_end);
+	// update_interval (for interpolation)
+	putF32(os, update_interval);
+	return os;
+}
+
+std::string gob_cmd_update_position_delta(
+	u8 keyframe_seq,
+	v3s16 position_delta,
+	v3s16 velocity,
+	v3s16 acceleration,
+	v3s16 rotation,
+	bool do_interpolate,
+	bool is_movement_end,
+	f32 update_interval
+){
+	std::string os;
+	os.reserve(2 + 4 * 6 + 2 + 4);
+	// command
+	putU8(os, GENERIC_CMD_UPDATE_POSITION_DELTA);
+	// keyframe this delta is relative to
+	putU8(os, keyframe_seq);
+	// pos relative to the keyframe, quantized
+	putV3S16(os, position_delta);
+	// velocity, quantized
+	putV3S16(os, velocity);
+	// acceleration, quantized
+	putV3S16(os, acceleration);
+	// rotation, quantized
+	putV3S16(os, rotation);
+	// do_interpolate
+	putU8(os, do_interpolate);
+	// is_end_position (for interpolation)
+	putU8(os, is_movement_end);
+	// update_interval (for interpolation)
+	putF32(os, update_interval);
+	return os;
 }
 
 std::string gob_cmd_set_texture_mod(const std::string &mod)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 2 + mod.size());
 	// command
-	writeU8(os, GENERIC_CMD_SET_TEXTURE_MOD);
+	putU8(os, GENERIC_CMD_SET_TEXTURE_MOD);
 	// parameters
-	os<<serializeString(mod);
-	return os.str();
+	putString(os, mod);
+	return os;
 }
 
 std::string gob_cmd_set_sprite(
@@ -81,127 +168,184 @@ std::string gob_cmd_set_sprite(
 	f32 framelength,
 	bool select_horiz_by_yawpitch
 ){
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 4 + 2 + 4 + 1);
 	// command
-	writeU8(os, GENERIC_CMD_SET_SPRITE);
+	putU8(os, GENERIC_CMD_SET_SPRITE);
 	// parameters
-	writeV2S16(os, p);
-	writeU16(os, num_frames);
-	writeF32(os, framelength);
-	writeU8(os, select_horiz_by_yawpitch);
-	return os.str();
+	putV2S16(os, p);
+	putU16(os, num_frames);
+	putF32(os, framelength);
+	putU8(os, select_horiz_by_yawpitch);
+	return os;
 }
 
 std::string gob_cmd_punched(u16 result_hp)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 2);
 	// command
-	writeU8(os, GENERIC_CMD_PUNCHED);
+	putU8(os, GENERIC_CMD_PUNCHED);
 	// result_hp
-	writeU16(os, result_hp);
-	return os.str();
+	putU16(os, result_hp);
+	return os;
 }
 
 std::string gob_cmd_update_armor_groups(const ItemGroupList &armor_groups)
 {
-	std::ostringstream os(std::ios::binary);
-	writeU8(os, GENERIC_CMD_UPDATE_ARMOR_GROUPS);
-	writeU16(os, armor_groups.size());
+	std::string os;
+	putU8(os, GENERIC_CMD_UPDATE_ARMOR_GROUPS);
+	putU16(os, armor_groups.size());
 	for (const auto &armor_group : armor_groups) {
-		os<<serializeString(armor_group.first);
-		writeS16(os, armor_group.second);
+		putString(os, armor_group.first);
+		putS16(os, armor_group.second);
 	}
-	return os.str();
+	return os;
+}
+
+std::string gob_cmd_update_armor_groups_delta(const ItemGroupList &armor_groups,
+		const ItemGroupList &last_sent)
+{
+	std::string changed;
+	u16 changed_count = 0;
+	for (const auto &armor_group : armor_groups) {
+		auto it = last_sent.find(armor_group.first);
+		if (it == last_sent.end() || it->second != armor_group.second) {
+			putString(changed, armor_group.first);
+			putS16(changed, armor_group.second);
+			changed_count++;
+		}
+	}
+
+	std::string removed;
+	u16 removed_count = 0;
+	for (const auto &armor_group : last_sent) {
+		if (armor_groups.find(armor_group.first) == armor_groups.end()) {
+			putString(removed, armor_group.first);
+			removed_count++;
+		}
+	}
+
+	if (changed_count == 0 && removed_count == 0)
+		return "";
+
+	std::string os;
+	os.reserve(5 + changed.size() + removed.size());
+	putU8(os, GENERIC_CMD_UPDATE_ARMOR_GROUPS_DELTA);
+	putU16(os, changed_count);
+	os += changed;
+	putU16(os, removed_count);
+	os += removed;
+	return os;
 }
 
 std::string gob_cmd_update_physics_override(float physics_override_speed, float physics_override_jump,
 		float physics_override_gravity, bool sneak, bool sneak_glitch, bool new_move)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 3 * 4 + 3);
 	// command
-	writeU8(os, GENERIC_CMD_SET_PHYSICS_OVERRIDE);
+	putU8(os, GENERIC_CMD_SET_PHYSICS_OVERRIDE);
 	// parameters
-	writeF32(os, physics_override_speed);
-	writeF32(os, physics_override_jump);
-	writeF32(os, physics_override_gravity);
+	putF32(os, physics_override_speed);
+	putF32(os, physics_override_jump);
+	putF32(os, physics_override_gravity);
 	// these are sent inverted so we get true when the server sends nothing
-	writeU8(os, !sneak);
-	writeU8(os, !sneak_glitch);
-	writeU8(os, !new_move);
-	return os.str();
+	putU8(os, !sneak);
+	putU8(os, !sneak_glitch);
+	putU8(os, !new_move);
+	return os;
 }
 
 std::string gob_cmd_update_animation(v2f frames, float frame_speed, float frame_blend, bool frame_loop)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 8 + 4 + 4 + 1);
 	// command
-	writeU8(os, GENERIC_CMD_SET_ANIMATION);
+	putU8(os, GENERIC_CMD_SET_ANIMATION);
 	// parameters
-	writeV2F32(os, frames);
-	writeF32(os, frame_speed);
-	writeF32(os, frame_blend);
+	putV2F32(os, frames);
+	putF32(os, frame_speed);
+	putF32(os, frame_blend);
 	// these are sent inverted so we get true when the server sends nothing
-	writeU8(os, !frame_loop);
-	return os.str();
+	putU8(os, !frame_loop);
+	return os;
 }
 
 std::string gob_cmd_update_animation_speed(float frame_speed)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 4);
 	// command
-	writeU8(os, GENERIC_CMD_SET_ANIMATION_SPEED);
+	putU8(os, GENERIC_CMD_SET_ANIMATION_SPEED);
 	// parameters
-	writeF32(os, frame_speed);
-	return os.str();
+	putF32(os, frame_speed);
+	return os;
 }
 
 std::string gob_cmd_update_bone_position(const std::string &bone, v3f position,
 		v3f rotation)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 2 + bone.size() + 2 * 12);
 	// command
-	writeU8(os, GENERIC_CMD_SET_BONE_POSITION);
+	putU8(os, GENERIC_CMD_SET_BONE_POSITION);
 	// parameters
-	os<<serializeString(bone);
-	writeV3F32(os, position);
-	writeV3F32(os, rotation);
-	return os.str();
+	putString(os, bone);
+	putV3F32(os, position);
+	putV3F32(os, rotation);
+	return os;
 }
 
 std::string gob_cmd_update_attachment(int parent_id, const std::string &bone,
 		v3f position, v3f rotation)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 2 + 2 + bone.size() + 2 * 12);
 	// command
-	writeU8(os, GENERIC_CMD_ATTACH_TO);
+	putU8(os, GENERIC_CMD_ATTACH_TO);
 	// parameters
-	writeS16(os, parent_id);
-	os<<serializeString(bone);
-	writeV3F32(os, position);
-	writeV3F32(os, rotation);
-	return os.str();
+	putS16(os, parent_id);
+	putString(os, bone);
+	putV3F32(os, position);
+	putV3F32(os, rotation);
+	return os;
 }
 
 std::string gob_cmd_update_nametag_attributes(video::SColor color)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 1 + 4);
 	// command
-	writeU8(os, GENERIC_CMD_UPDATE_NAMETAG_ATTRIBUTES);
+	putU8(os, GENERIC_CMD_UPDATE_NAMETAG_ATTRIBUTES);
 	// parameters
-	writeU8(os, 1); // version for forward compatibility
-	writeARGB8(os, color);
-	return os.str();
+	putU8(os, 1); // version for forward compatibility
+	putARGB8(os, color);
+	return os;
 }
 
 std::string gob_cmd_update_infant(u16 id, u8 type,
 		const std::string &client_initialization_data)
 {
-	std::ostringstream os(std::ios::binary);
+	std::string os;
+	os.reserve(1 + 2 + 1 + 4 + client_initialization_data.size());
 	// command
-	writeU8(os, GENERIC_CMD_SPAWN_INFANT);
+	putU8(os, GENERIC_CMD_SPAWN_INFANT);
 	// parameters
-	writeU16(os, id);
-	writeU8(os, type);
-	os<<serializeLongString(client_initialization_data);
-	return os.str();
+	putU16(os, id);
+	putU8(os, type);
+	putLongString(os, client_initialization_data);
+	return os;
+}
+
+std::string gob_cmd_batch(const std::vector<std::string> &cmds)
+{
+	std::string os;
+	// command
+	putU8(os, GENERIC_CMD_BATCH);
+	// parameters
+	putU8(os, cmds.size());
+	for (const std::string &cmd : cmds)
+		putLongString(os, cmd);
+	return os;
 }
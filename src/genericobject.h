@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <string>
+#include <vector>
 #include "irrlichttypes_bloated.h"
 #include <iostream>
 #include "itemgroup.h"
@@ -37,13 +38,33 @@ enum GenericCMD {
 	GENERIC_CMD_SET_PHYSICS_OVERRIDE,
 	GENERIC_CMD_UPDATE_NAMETAG_ATTRIBUTES,
 	GENERIC_CMD_SPAWN_INFANT,
-	GENERIC_CMD_SET_ANIMATION_SPEED
+	GENERIC_CMD_SET_ANIMATION_SPEED,
+	// Quantized position updates (protocol >= 41); see
+	// UnitSAO::generateQuantizedPositionCommand()
+	GENERIC_CMD_UPDATE_POSITION_KEYFRAME,
+	GENERIC_CMD_UPDATE_POSITION_DELTA,
+	// Per-field updates of properties and armor groups; see
+	// ObjectProperties::serializeDelta()
+	GENERIC_CMD_SET_PROPERTIES_DELTA,
+	GENERIC_CMD_UPDATE_ARMOR_GROUPS_DELTA,
+	// Several commands coalesced into one message; see gob_cmd_batch()
+	GENERIC_CMD_BATCH
 };
 
+// Quantization scales for GENERIC_CMD_UPDATE_POSITION_DELTA
+// (value * scale rounded into a s16)
+#define GOB_POS_QUANT_SCALE 100.0f // position, velocity, acceleration
+#define GOB_ROT_QUANT_SCALE 10.0f  // rotation (degrees)
+
 #include "object_properties.h"
 std::string gob_cmd_set_properties(const ObjectProperties &prop);
 ObjectProperties gob_read_set_properties(std::istream &is);
 
+// Returns an empty string when no field differs from last_sent
+std::string gob_cmd_set_properties_delta(const ObjectProperties &prop,
+		const ObjectProperties &last_sent);
+void gob_read_set_properties_delta(std::istream &is, ObjectProperties &prop);
+
 std::string gob_cmd_update_position(
 	v3f position,
 	v3f velocity,
@@ -54,6 +75,28 @@ std::string gob_cmd_update_position(
 	f32 update_interval
 );
 
+std::string gob_cmd_update_position_keyframe(
+	u8 keyframe_seq,
+	v3f position,
+	v3f velocity,
+	v3f acceleration,
+	v3f rotation,
+	bool do_interpolate,
+	bool is_movement_end,
+	f32 update_interval
+);
+
+std::string gob_cmd_update_position_delta(
+	u8 keyframe_seq,
+	v3s16 position_delta,
+	v3s16 velocity,
+	v3s16 acceleration,
+	v3s16 rotation,
+	bool do_interpolate,
+	bool is_movement_end,
+	f32 update_interval
+);
+
 std::string gob_cmd_set_texture_mod(const std::string &mod);
 
 std::string gob_cmd_set_sprite(
@@ -67,6 +110,10 @@ std::string gob_cmd_punched(u16 result_hp);
 
 std::string gob_cmd_update_armor_groups(const ItemGroupList &armor_groups);
 
+// Returns an empty string when the groups equal last_sent
+std::string gob_cmd_update_armor_groups_delta(const ItemGroupList &armor_groups,
+		const ItemGroupList &last_sent);
+
 std::string gob_cmd_update_physics_override(float physics_override_speed,
 		float physics_override_jump, float physics_override_gravity,
 		bool sneak, bool sneak_glitch, bool new_move);
@@ -85,3 +132,7 @@ std::string gob_cmd_update_nametag_attributes(video::SColor color);
 
 std::string gob_cmd_update_infant(u16 id, u8 type,
 		const std::string &client_initialization_data);
+
+// Wraps several commands into a single message to cut per-message
+// queue and header overhead
+std::string gob_cmd_batch(const std::vector<std::string> &cmds);
@@ -2355,6 +2355,20 @@ void GUIFormSpecMenu::regenerateGui(v2u32 screensize)
 		return;
 	}
 
+	// Periodic updates often re-send a formspec identical to the one the
+	// element tree was built from; rebuilding everything for those causes
+	// visible hitches. Hash the source strings and keep the current tree
+	// when neither they nor the screensize changed.
+	std::string source = m_formspec_prepend;
+	source += '\n';
+	source += m_formspec_string;
+	u64 source_hash = murmur_hash_64_ua(source.data(), source.length(), 0xdeadbeef);
+	if (m_tooltip_element && source_hash == m_built_source_hash
+			&& screensize == m_built_screensize)
+		return;
+	m_built_source_hash = source_hash;
+	m_built_screensize = screensize;
+
 	parserData mydata;
 
 	//preserve tables
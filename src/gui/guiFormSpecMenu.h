@@ -425,6 +425,11 @@ protected:
 	std::string m_formspec_prepend;
 	InventoryLocation m_current_inventory_location;
 
+	// Hash of the source strings and the screensize the current element
+	// tree was built from; regenerateGui() keeps the tree when unchanged
+	u64 m_built_source_hash = 0;
+	v2u32 m_built_screensize;
+
 	std::vector<ListDrawSpec> m_inventorylists;
 	std::vector<ListRingSpec> m_inventory_rings;
 	std::vector<ImageDrawSpec> m_backgrounds;
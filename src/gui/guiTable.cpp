@@ -124,54 +124,67 @@ void GUITable::setTextList(const std::vector<std::string> &content,
 
 	m_is_textlist = true;
 
-	s32 empty_string_index = allocString("");
+	m_textlist_empty_string = allocString("");
 
+	// Unlike generic tables, the layout of a textlist row does not depend
+	// on any other row, so cells are materialized lazily by
+	// buildTextListRow() once a row is actually drawn or hit. This keeps
+	// the cost of opening huge lists independent of their row count.
+	m_textlist_content = content;
 	m_rows.resize(content.size());
 	for (s32 i = 0; i < (s32) content.size(); ++i) {
 		Row *row = &m_rows[i];
-		row->cells = new Cell[1];
-		row->cellcount = 1;
+		row->cells = nullptr;
+		row->cellcount = 0;
 		row->indent = 0;
 		row->visible_index = i;
 		m_visible_rows.push_back(i);
-
-		Cell *cell = row->cells;
-		cell->xmin = 0;
-		cell->xmax = 0x7fff;  // something large enough
-		cell->xpos = 6;
-		cell->content_type = COLUMN_TYPE_TEXT;
-		cell->content_index = empty_string_index;
-		cell->tooltip_index = empty_string_index;
-		cell->color.set(255, 255, 255, 255);
-		cell->color_defined = false;
-		cell->reported_column = 1;
-
-		// parse row content (color)
-		const std::string &s = content[i];
-		if (s[0] == '#' && s[1] == '#') {
-			// double # to escape
-			cell->content_index = allocString(s.substr(2));
-		}
-		else if (s[0] == '#' && s.size() >= 7 &&
-				parseColorString(
-					s.substr(0,7), cell->color, false)) {
-			// single # for color
-			cell->color_defined = true;
-			cell->content_index = allocString(s.substr(7));
-		}
-		else {
-			// no #, just text
-			cell->content_index = allocString(s);
-		}
-
 	}
 
-	allocationComplete();
+	// Note: no allocationComplete() here; lazily built rows still call
+	// allocString() and profit from the deduplication map
 
 	// Clamp scroll bar position
 	updateScrollBar();
 }
 
+void GUITable::buildTextListRow(s32 i)
+{
+	Row *row = &m_rows[i];
+
+	row->cells = new Cell[1];
+	row->cellcount = 1;
+
+	Cell *cell = row->cells;
+	cell->xmin = 0;
+	cell->xmax = 0x7fff;  // something large enough
+	cell->xpos = 6;
+	cell->content_type = COLUMN_TYPE_TEXT;
+	cell->content_index = m_textlist_empty_string;
+	cell->tooltip_index = m_textlist_empty_string;
+	cell->color.set(255, 255, 255, 255);
+	cell->color_defined = false;
+	cell->reported_column = 1;
+
+	// parse row content (color)
+	const std::string &s = m_textlist_content[i];
+	if (s[0] == '#' && s[1] == '#') {
+		// double # to escape
+		cell->content_index = allocString(s.substr(2));
+	}
+	else if (s[0] == '#' && s.size() >= 7 &&
+			parseColorString(
+				s.substr(0,7), cell->color, false)) {
+		// single # for color
+		cell->color_defined = true;
+		cell->content_index = allocString(s.substr(7));
+	}
+	else {
+		// no #, just text
+		cell->content_index = allocString(s);
+	}
+}
+
 void GUITable::setTable(const TableOptions &options,
 		const TableColumns &columns,
 		std::vector<std::string> &content)
@@ -507,6 +520,8 @@ void GUITable::clear()
 	m_images.clear();
 	m_alloc_strings.clear();
 	m_alloc_images.clear();
+	m_textlist_content.clear();
+	m_textlist_empty_string = 0;
 }
 
 std::string GUITable::checkEvent()
@@ -671,6 +686,8 @@ void GUITable::draw()
 	row_rect.LowerRightCorner.Y = row_rect.UpperLeftCorner.Y + m_rowheight;
 
 	for (s32 i = row_min; i < row_max; ++i) {
+		if (m_is_textlist && !m_rows[m_visible_rows[i]].cells)
+			buildTextListRow(m_visible_rows[i]);
 		Row *row = &m_rows[m_visible_rows[i]];
 		bool is_sel = i == m_selected;
 		video::SColor color = m_color;
@@ -977,8 +994,12 @@ void GUITable::allocationComplete()
 
 const GUITable::Row* GUITable::getRow(s32 i) const
 {
-	if (i >= 0 && i < (s32) m_visible_rows.size())
-		return &m_rows[m_visible_rows[i]];
+	if (i >= 0 && i < (s32) m_visible_rows.size()) {
+		s32 raw_i = m_visible_rows[i];
+		if (m_is_textlist && !m_rows[raw_i].cells)
+			const_cast<GUITable *>(this)->buildTextListRow(raw_i);
+		return &m_rows[raw_i];
+	}
 
 	return NULL;
 }
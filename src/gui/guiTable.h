@@ -182,6 +182,11 @@ protected:
 	bool m_is_textlist = false;
 	bool m_has_tree_column = false;
 
+	// Raw content of textlist rows; their cells are materialized lazily
+	// by buildTextListRow() (indexed like m_rows, empty for generic tables)
+	std::vector<std::string> m_textlist_content;
+	s32 m_textlist_empty_string = 0;
+
 	// Selection status
 	s32 m_selected = -1; // index of row (1...n), or 0 if none selected
 	s32 m_sel_column = 0;
@@ -211,6 +216,10 @@ protected:
 	s32 allocImage(const std::string &imagename);
 	void allocationComplete();
 
+	// Materialize the cell of a lazily built textlist row
+	// (see setTextList)
+	void buildTextListRow(s32 i);
+
 	// Helper for draw() that draws a single cell
 	void drawCell(const Cell *cell, video::SColor color,
 			const core::rect<s32> &rowrect,
@@ -236,6 +236,89 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 
 void ItemStack::deSerialize(const std::string &str, IItemDefManager *itemdef)
 {
+	// Legacy format markers that the fast path below must not mistake for
+	// plain item names
+	static const char *legacy_names[] = {
+		"MaterialItem", "MaterialItem2", "MaterialItem3", "MBOItem",
+		"node", "NodeItem", "craft", "CraftItem", "tool", "ToolItem"
+	};
+
+	/*
+		Fast path for the overwhelmingly common "name", "name count" and
+		"name count wear" forms: parse straight out of the string instead
+		of routing every token through an istringstream.  Joining players
+		deserialize thousands of stacks and craft checking re-parses
+		constantly, so the stream setup cost matters.  Quoted names,
+		metadata and the legacy formats fall back to the stream parser.
+	*/
+	do {
+		if (str.empty() || str.find('"') != std::string::npos)
+			break;
+
+		u16 parsed_count = 1;
+		u16 parsed_wear = 0;
+
+		size_t name_end = str.find(' ');
+		if (name_end != std::string::npos) {
+			size_t count_begin = name_end + 1;
+			size_t count_end = str.find(' ', count_begin);
+			if (count_end == count_begin)
+				break; // unusual whitespace, let the stream parser decide
+			std::string count_str = str.substr(count_begin,
+				count_end == std::string::npos ?
+					std::string::npos : count_end - count_begin);
+			if (count_str.empty())
+				break;
+			parsed_count = stoi(count_str);
+
+			if (count_end != std::string::npos) {
+				size_t wear_begin = count_end + 1;
+				size_t wear_end = str.find(' ', wear_begin);
+				if (wear_end != std::string::npos)
+					break; // metadata or trailing fields follow
+				std::string wear_str = str.substr(wear_begin);
+				if (wear_str.empty())
+					break;
+				parsed_wear = stoi(wear_str);
+			}
+		}
+
+		std::string parsed_name = str.substr(0, name_end);
+		if (parsed_name.empty())
+			break; // malformed, let the stream parser raise the error
+
+		bool is_legacy = false;
+		for (const char *legacy_name : legacy_names) {
+			if (parsed_name == legacy_name) {
+				is_legacy = true;
+				break;
+			}
+		}
+		if (is_legacy)
+			break;
+
+		clear();
+		if (itemdef) {
+			// getAlias() returns its argument by reference when there is
+			// no alias, in which case the parsed name can be moved in
+			const std::string &alias = itemdef->getAlias(parsed_name);
+			if (&alias == &parsed_name)
+				name = std::move(parsed_name);
+			else
+				name = alias;
+		} else {
+			name = std::move(parsed_name);
+		}
+		count = parsed_count;
+		wear = parsed_wear;
+
+		if (name.empty() || count == 0)
+			clear();
+		else if (itemdef && itemdef->get(name).type == ITEM_TOOL)
+			count = 1;
+		return;
+	} while (false);
+
 	std::istringstream is(str, std::ios::binary);
 	deSerialize(is, itemdef);
 }
@@ -414,16 +497,17 @@ void InventoryList::serialize(std::ostream &os, bool incremental) const
 
 	os<<"Width "<<m_width<<"\n";
 
-	for (const auto &item : m_items) {
-		if (item.empty()) {
+	for (u32 i = 0; i < m_items.size(); i++) {
+		const ItemStack &item = m_items[i];
+		if (incremental && i < m_dirty_slots.size() && !m_dirty_slots[i]) {
+			// Slot unchanged since the last send
+			os<<"Keep";
+		} else if (item.empty()) {
 			os<<"Empty";
 		} else {
 			os<<"Item ";
 			item.serialize(os);
 		}
-		// TODO: Implement this:
-		// if (!incremental || item.checkModified())
-		// os << "Keep";
 		os<<"\n";
 	}
 
@@ -499,6 +583,7 @@ InventoryList & InventoryList::operator = (const InventoryList &other)
 	m_width = other.m_width;
 	m_name = other.m_name;
 	m_itemdef = other.m_itemdef;
+	m_dirty_slots = other.m_dirty_slots;
 	//setDirty(true);
 
 	return *this;
@@ -568,7 +653,7 @@ ItemStack InventoryList::changeItem(u32 i, const ItemStack &newitem)
 
 	ItemStack olditem = m_items[i];
 	m_items[i] = newitem;
-	setModified();
+	setSlotDirty(i);
 	return olditem;
 }
 
@@ -576,7 +661,7 @@ void InventoryList::deleteItem(u32 i)
 {
 	assert(i < m_items.size()); // Pre-condition
 	m_items[i].clear();
-	setModified();
+	setSlotDirty(i);
 }
 
 ItemStack InventoryList::addItem(const ItemStack &newitem_)
@@ -625,7 +710,7 @@ ItemStack InventoryList::addItem(u32 i, const ItemStack &newitem)
 
 	ItemStack leftover = m_items[i].addItem(newitem, m_itemdef);
 	if (leftover != newitem)
-		setModified();
+		setSlotDirty(i);
 	return leftover;
 }
 
@@ -680,8 +765,10 @@ ItemStack InventoryList::removeItem(const ItemStack &item)
 	for (auto i = m_items.rbegin(); i != m_items.rend(); ++i) {
 		if (i->name == item.name) {
 			u32 still_to_remove = item.count - removed.count;
-			ItemStack leftover = removed.addItem(i->takeItem(still_to_remove),
-					m_itemdef);
+			ItemStack taken = i->takeItem(still_to_remove);
+			if (!taken.empty())
+				setSlotDirty((u32)(m_items.rend() - i) - 1);
+			ItemStack leftover = removed.addItem(taken, m_itemdef);
 			// Allow oversized stacks
 			removed.count += leftover.count;
 
@@ -689,8 +776,6 @@ ItemStack InventoryList::removeItem(const ItemStack &item)
 				break;
 		}
 	}
-	if (!removed.empty())
-		setModified();
 	return removed;
 }
 
@@ -701,7 +786,7 @@ ItemStack InventoryList::takeItem(u32 i, u32 takecount)
 
 	ItemStack taken = m_items[i].takeItem(takecount);
 	if (!taken.empty())
-		setModified();
+		setSlotDirty(i);
 	return taken;
 }
 
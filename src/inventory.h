@@ -266,7 +266,19 @@ public:
 	void moveItemSomewhere(u32 i, InventoryList *dest, u32 count);
 
 	inline bool checkModified() const { return m_dirty; }
-	inline void setModified(bool dirty = true) { m_dirty = dirty; }
+	inline void setModified(bool dirty = true)
+	{
+		m_dirty = dirty;
+		m_dirty_slots.assign(m_items.size(), dirty);
+	}
+	// Mark a single changed slot, keeping the rest eligible for "Keep"
+	// lines in incremental serialization
+	inline void setSlotDirty(u32 i)
+	{
+		m_dirty = true;
+		if (i < m_dirty_slots.size())
+			m_dirty_slots[i] = true;
+	}
 
 private:
 	std::vector<ItemStack> m_items;
@@ -275,6 +287,8 @@ private:
 	u32 m_width = 0;
 	IItemDefManager *m_itemdef;
 	bool m_dirty = true;
+	// Per-slot change tracking for incremental serialization
+	std::vector<bool> m_dirty_slots;
 };
 
 class Inventory
@@ -30,6 +30,7 @@
 */
 
 #include <irrlicht.h>
+#include <algorithm>
 #include <iostream>
 #include "CGUITTFont.h"
 
@@ -449,6 +450,9 @@ void CGUITTFont::reset_images()
 		delete Glyph_Pages[i];
 	Glyph_Pages.clear();
 
+	// Cached runs reference the source rects of the deleted pages.
+	m_run_cache.clear();
+
 	// Always update the internal FreeType loading flags after resetting.
 	update_load_flags();
 }
@@ -553,45 +557,97 @@ void CGUITTFont::draw(const core::stringw& text, const core::rect<s32>& position
 
 void CGUITTFont::draw(const EnrichedString &text, const core::rect<s32>& position, video::SColor color, bool hcenter, bool vcenter, const core::rect<s32>* clip)
 {
-	std::vector<video::SColor> colors = text.getColors();
-
 	if (!Driver)
 		return;
 
-	// Clear the glyph pages of their render information.
-	for (u32 i = 0; i < Glyph_Pages.size(); ++i)
-	{
-		Glyph_Pages[i]->render_positions.clear();
-		Glyph_Pages[i]->render_source_rects.clear();
-	}
+	const GlyphRun &run = getGlyphRun(text);
 
-	// Set up some variables.
-	core::dimension2d<s32> textDimension;
+	// Determine offset positions. Line breaks are re-centered against the
+	// dimension of the whole text, so centering is a plain translation of
+	// the cached run.
 	core::position2d<s32> offset = position.UpperLeftCorner;
+	if (hcenter)
+		offset.X += (position.getWidth() - (s32) run.dimension.Width) >> 1;
+	if (vcenter)
+		offset.Y += (position.getHeight() - (s32) run.dimension.Height) >> 1;
+
+	// Push any glyphs loaded during shaping to the page textures.
+	update_glyph_pages();
 
-	// Determine offset positions.
-	if (hcenter || vcenter)
+	const std::vector<video::SColor> &applied_colors = run.colors;
+	for (const GlyphRunPage &run_page : run.pages)
 	{
-		textDimension = getDimension(text.c_str());
+		CGUITTGlyphPage* const page = Glyph_Pages[run_page.page];
 
-		if (hcenter)
-			offset.X = ((position.getWidth() - textDimension.Width) >> 1) + offset.X;
+		// Translate the cached positions to the draw position.
+		m_run_scratch.set_used(0);
+		for (u32 i = 0; i < run_page.positions.size(); ++i)
+			m_run_scratch.push_back(run_page.positions[i] + offset);
 
-		if (vcenter)
-			offset.Y = ((position.getHeight() - textDimension.Height) >> 1) + offset.Y;
+		if (shadow_offset) {
+			for (u32 i = 0; i < m_run_scratch.size(); ++i)
+				m_run_scratch[i] += core::vector2di(shadow_offset, shadow_offset);
+			Driver->draw2DImageBatch(page->texture, m_run_scratch, run_page.source_rects, clip, video::SColor(shadow_alpha,0,0,0), true);
+			for (u32 i = 0; i < m_run_scratch.size(); ++i)
+				m_run_scratch[i] -= core::vector2di(shadow_offset, shadow_offset);
+		}
+		for (u32 i = 0; i < m_run_scratch.size(); ++i) {
+			irr::video::SColor col;
+			if (!applied_colors.empty()) {
+				col = applied_colors[i < applied_colors.size() ? i : 0];
+			} else {
+				col = irr::video::SColor(255, 255, 255, 255);
+			}
+			if (!use_transparency)
+				col.color |= 0xff000000;
+			Driver->draw2DImage(page->texture, m_run_scratch[i], run_page.source_rects[i], clip, col, true);
+		}
 	}
+}
+
+const CGUITTFont::GlyphRun& CGUITTFont::getGlyphRun(const EnrichedString &text)
+{
+	// The per-character colors are part of the shaped output, so they are
+	// folded into the cache key.
+	const std::vector<video::SColor> &colors = text.getColors();
+	u64 colors_hash = 0;
+	for (const video::SColor &c : colors)
+		colors_hash = colors_hash * 0x9e3779b97f4a7c15ULL + c.color;
+
+	std::pair<std::wstring, u64> key(text.getString(), colors_hash);
+	std::map<std::pair<std::wstring, u64>, GlyphRun>::iterator it =
+		m_run_cache.find(key);
+	if (it != m_run_cache.end())
+		return it->second;
+
+	// Keep the cache from growing without bound when the text churns
+	// (chat history, debug info).
+	if (m_run_cache.size() >= 256)
+		m_run_cache.clear();
+
+	GlyphRun &run = m_run_cache[key];
+	buildGlyphRun(text, run);
+	return run;
+}
+
+void CGUITTFont::buildGlyphRun(const EnrichedString &text, GlyphRun &run)
+{
+	const std::vector<video::SColor> &colors = text.getColors();
 
 	// Convert to a unicode string.
 	core::ustring utext = text.getString();
 
-	// Set up our render map.
-	core::map<u32, CGUITTGlyphPage*> Render_Map;
+	run.dimension = getDimension(utext);
+
+	// Maps glyph page indices to their entry in run.pages.
+	core::map<u32, u32> page_runs;
+
+	core::position2d<s32> offset(0, 0);
 
 	// Start parsing characters.
 	u32 n;
 	uchar32_t previousChar = 0;
 	core::ustring::const_iterator iter(utext);
-	std::vector<video::SColor> applied_colors;
 	while (!iter.atEnd())
 	{
 		uchar32_t currentChar = *iter;
@@ -613,10 +669,7 @@ void CGUITTFont::draw(const EnrichedString &text, const core::rect<s32>& positio
 		{
 			previousChar = 0;
 			offset.Y += font_metrics.height / 64;
-			offset.X = position.UpperLeftCorner.X;
-
-			if (hcenter)
-				offset.X += (position.getWidth() - textDimension.Width) >> 1;
+			offset.X = 0;
 			++iter;
 			continue;
 		}
@@ -634,13 +687,22 @@ void CGUITTFont::draw(const EnrichedString &text, const core::rect<s32>& positio
 
 			// Determine rendering information.
 			SGUITTGlyph& glyph = Glyphs[n-1];
-			CGUITTGlyphPage* const page = Glyph_Pages[glyph.glyph_page];
-			page->render_positions.push_back(core::position2di(offset.X + offx, offset.Y + offy));
-			page->render_source_rects.push_back(glyph.source_rect);
-			Render_Map.set(glyph.glyph_page, page);
+			core::map<u32, u32>::Node* node = page_runs.find(glyph.glyph_page);
+			u32 run_i;
+			if (node) {
+				run_i = node->getValue();
+			} else {
+				run_i = run.pages.size();
+				run.pages.emplace_back();
+				run.pages.back().page = glyph.glyph_page;
+				page_runs.set(glyph.glyph_page, run_i);
+			}
+			GlyphRunPage &run_page = run.pages[run_i];
+			run_page.positions.push_back(core::position2di(offset.X + offx, offset.Y + offy));
+			run_page.source_rects.push_back(glyph.source_rect);
 			u32 current_color = iter.getPos();
 			if (current_color < colors.size())
-				applied_colors.push_back(colors[current_color]);
+				run.colors.push_back(colors[current_color]);
 		}
 		offset.X += getWidthFromCharacter(currentChar);
 
@@ -648,36 +710,11 @@ void CGUITTFont::draw(const EnrichedString &text, const core::rect<s32>& positio
 		++iter;
 	}
 
-	// Draw now.
-	update_glyph_pages();
-	core::map<u32, CGUITTGlyphPage*>::Iterator j = Render_Map.getIterator();
-	while (!j.atEnd())
-	{
-		core::map<u32, CGUITTGlyphPage*>::Node* n = j.getNode();
-		j++;
-		if (n == 0) continue;
-
-		CGUITTGlyphPage* page = n->getValue();
-
-		if (shadow_offset) {
-			for (size_t i = 0; i < page->render_positions.size(); ++i)
-				page->render_positions[i] += core::vector2di(shadow_offset, shadow_offset);
-			Driver->draw2DImageBatch(page->texture, page->render_positions, page->render_source_rects, clip, video::SColor(shadow_alpha,0,0,0), true);
-			for (size_t i = 0; i < page->render_positions.size(); ++i)
-				page->render_positions[i] -= core::vector2di(shadow_offset, shadow_offset);
-		}
-		for (size_t i = 0; i < page->render_positions.size(); ++i) {
-			irr::video::SColor col;
-			if (!applied_colors.empty()) {
-				col = applied_colors[i < applied_colors.size() ? i : 0];
-			} else {
-				col = irr::video::SColor(255, 255, 255, 255);
-			}
-			if (!use_transparency)
-				col.color |= 0xff000000;
-			Driver->draw2DImage(page->texture, page->render_positions[i], page->render_source_rects[i], clip, col, true);
-		}
-	}
+	// Draw in ascending page order, like the old per-draw render map did.
+	std::sort(run.pages.begin(), run.pages.end(),
+		[] (const GlyphRunPage &a, const GlyphRunPage &b) {
+			return a.page < b.page;
+		});
 }
 
 core::dimension2d<u32> CGUITTFont::getCharDimension(const wchar_t ch) const
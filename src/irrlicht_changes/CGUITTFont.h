@@ -33,6 +33,9 @@
 
 #include <irrlicht.h>
 #include <ft2build.h>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 #include "irrUString.h"
 #include "util/enriched_string.h"
@@ -367,6 +370,30 @@ namespace gui
 			core::vector2di getKerning(const uchar32_t thisLetter, const uchar32_t previousLetter) const;
 			core::dimension2d<u32> getDimensionUntilEndOfLine(const wchar_t* p) const;
 
+			//! The part of a shaped glyph run drawn from one glyph page:
+			//! positions are relative to the top-left of the text.
+			struct GlyphRunPage
+			{
+				u32 page = 0;
+				core::array<core::position2di> positions;
+				core::array<core::rect<s32> > source_rects;
+			};
+
+			//! A shaped glyph run. Size and style are fixed per font
+			//! instance, so runs are cached per (text, colors) and identical
+			//! strings skip the per-character shaping walk in draw().
+			struct GlyphRun
+			{
+				std::vector<GlyphRunPage> pages;
+				std::vector<video::SColor> colors;
+				core::dimension2d<u32> dimension;
+			};
+
+			//! Returns the cached run for the given text, shaping it first
+			//! if necessary.
+			const GlyphRun& getGlyphRun(const EnrichedString& text);
+			void buildGlyphRun(const EnrichedString& text, GlyphRun& run);
+
 			void createSharedPlane();
 
 			irr::IrrlichtDevice* Device;
@@ -385,6 +412,12 @@ namespace gui
 			core::ustring Invisible;
 			u32 shadow_offset;
 			u32 shadow_alpha;
+
+			// Shaped run cache; cleared by reset_images() since glyph
+			// source rects become invalid with the pages
+			std::map<std::pair<std::wstring, u64>, GlyphRun> m_run_cache;
+			// Scratch buffer for translating cached run positions in draw()
+			core::array<core::position2di> m_run_scratch;
 	};
 
 } // end namespace gui
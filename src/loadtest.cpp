@@ -0,0 +1,591 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "loadtest.h"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "constants.h"
+#include "log.h"
+#include "network/connection.h"
+#include "network/networkexceptions.h"
+#include "network/networkpacket.h"
+#include "network/networkprotocol.h"
+#include "network/peerhandler.h"
+#include "noise.h"
+#include "porting.h"
+#include "settings.h"
+#include "util/auth.h"
+#include "util/basic_macros.h"
+#include "util/numeric.h"
+#include "util/pointedthing.h"
+#include "util/srp.h"
+#include "util/string.h"
+#include "version.h"
+
+/*
+	One scripted bot: a connection plus just enough protocol state to
+	log in and then behave like a player. The full Client class is not
+	used because it drags in the rendering path; everything the server
+	cares about fits in the handshake and a handful of packet types.
+*/
+class LoadTestBot : public con::PeerHandler
+{
+public:
+	LoadTestBot(const std::string &name, const std::string &password):
+		m_con(new con::Connection(PROTOCOL_ID, 512, CONNECTION_TIMEOUT,
+				false, this)),
+		m_name(name),
+		m_password(password),
+		m_random((int) murmur_hash_64_ua(name.c_str(), name.size(), 0xb07))
+	{
+		m_con->SetTimeoutMs(0);
+	}
+
+	~LoadTestBot()
+	{
+		deleteAuthData();
+	}
+
+	DISABLE_CLASS_COPY(LoadTestBot);
+
+	// Behavior knobs, filled in from the scenario file by the driver
+	float move_speed = 4.0f;
+	float dig_interval = 2.0f;
+	float chat_interval = 10.0f;
+
+	void connect(const Address &address)
+	{
+		m_con->Connect(address);
+		m_state = BOT_CONNECTING;
+	}
+
+	void step(float dtime);
+
+	void disconnect()
+	{
+		m_con->Disconnect();
+		m_state = BOT_DISCONNECTED;
+	}
+
+	bool isPlaying() const { return m_state == BOT_PLAYING; }
+	bool isFailed() const { return m_state == BOT_FAILED; }
+
+	void addTrafficTotals(u64 *tx_bytes, u64 *tx_packets,
+			u64 *rx_bytes, u64 *rx_packets)
+	{
+		u64 bytes, packets;
+		m_con->m_tx_pkt_stats.getTotals(&bytes, &packets);
+		*tx_bytes += bytes;
+		*tx_packets += packets;
+		m_con->m_rx_pkt_stats.getTotals(&bytes, &packets);
+		*rx_bytes += bytes;
+		*rx_packets += packets;
+	}
+
+	// con::PeerHandler
+	void peerAdded(con::Peer *peer) {}
+	void deletingPeer(con::Peer *peer, bool timeout)
+	{
+		if (m_state != BOT_DISCONNECTED) {
+			warningstream << "LoadTestBot " << m_name << ": lost peer ("
+				<< (timeout ? "timeout" : "closed") << ")" << std::endl;
+			m_state = BOT_FAILED;
+		}
+	}
+
+private:
+	enum BotState {
+		BOT_CREATED,
+		BOT_CONNECTING,   // waiting for the connection handshake
+		BOT_HANDSHAKE,    // auth in progress
+		BOT_PLAYING,
+		BOT_DISCONNECTED,
+		BOT_FAILED
+	};
+
+	void send(NetworkPacket *pkt, u8 channel, bool reliable)
+	{
+		m_con->Send(PEER_ID_SERVER, channel, pkt, reliable);
+	}
+
+	void receiveAll();
+	void processPacket(NetworkPacket *pkt);
+	void startAuth(u32 auth_mechs);
+	void deleteAuthData();
+	void flushGotBlocks();
+	void writePlayerPos(NetworkPacket *pkt);
+	void stepPlaying(float dtime);
+
+	std::unique_ptr<con::Connection> m_con;
+	std::string m_name;
+	std::string m_password;
+	BotState m_state = BOT_CREATED;
+
+	// Auth
+	SRPUser *m_auth_data = nullptr;
+	AuthMechanism m_chosen_auth_mech = AUTH_MECHANISM_NONE;
+
+	// World state
+	v3f m_pos;
+	float m_yaw = 0.0f;
+	std::vector<v3s16> m_gotblocks;
+
+	// Behavior timers
+	float m_dir_timer = 0.0f;
+	float m_dig_timer = 0.0f;
+	bool m_dig_started = false;
+	float m_chat_timer = 0.0f;
+	u32 m_chat_counter = 0;
+
+	PseudoRandom m_random;
+};
+
+void LoadTestBot::step(float dtime)
+{
+	receiveAll();
+
+	switch (m_state) {
+	case BOT_CONNECTING:
+		if (m_con->Connected()) {
+			// Same as Client::sendInit()
+			NetworkPacket pkt(TOSERVER_INIT,
+					1 + 2 + 2 + (1 + m_name.size()));
+			pkt << (u8) SER_FMT_VER_HIGHEST_READ
+				<< (u16) NETPROTO_COMPRESSION_NONE;
+			pkt << (u16) CLIENT_PROTOCOL_VERSION_MIN
+				<< (u16) CLIENT_PROTOCOL_VERSION_MAX;
+			pkt << m_name;
+			send(&pkt, 1, false);
+			m_state = BOT_HANDSHAKE;
+		}
+		break;
+	case BOT_PLAYING:
+		stepPlaying(dtime);
+		break;
+	default:
+		break;
+	}
+}
+
+void LoadTestBot::receiveAll()
+{
+	u64 start_ms = porting::getTimeMs();
+	for (;;) {
+		// Limit time even if there would be huge amounts of data to
+		// process
+		if (porting::getTimeMs() > start_ms + 100)
+			break;
+
+		try {
+			NetworkPacket pkt;
+			m_con->Receive(&pkt);
+			processPacket(&pkt);
+		} catch (con::NoIncomingDataException &e) {
+			break;
+		} catch (con::InvalidIncomingDataException &e) {
+			infostream << "LoadTestBot " << m_name
+				<< ": InvalidIncomingDataException: " << e.what()
+				<< std::endl;
+		}
+	}
+	flushGotBlocks();
+}
+
+void LoadTestBot::processPacket(NetworkPacket *pkt)
+{
+	switch (pkt->getCommand()) {
+	case TOCLIENT_HELLO: {
+		if (pkt->getSize() < 1)
+			return;
+		u8 serialization_ver;
+		u16 compression_mode;
+		u16 proto_ver;
+		u32 auth_mechs;
+		std::string username_legacy;
+		*pkt >> serialization_ver >> compression_mode >> proto_ver
+			>> auth_mechs >> username_legacy;
+		startAuth(auth_mechs);
+		break;
+	}
+	case TOCLIENT_SRP_BYTES_S_B: {
+		if (!m_auth_data)
+			return;
+		std::string s;
+		std::string B;
+		*pkt >> s >> B;
+
+		char *bytes_M = 0;
+		size_t len_M = 0;
+		srp_user_process_challenge(m_auth_data,
+			(const unsigned char *) s.c_str(), s.size(),
+			(const unsigned char *) B.c_str(), B.size(),
+			(unsigned char **) &bytes_M, &len_M);
+		if (!bytes_M) {
+			errorstream << "LoadTestBot " << m_name
+				<< ": SRP-6a S_B safety check violation" << std::endl;
+			m_state = BOT_FAILED;
+			return;
+		}
+
+		NetworkPacket resp_pkt(TOSERVER_SRP_BYTES_M, 0);
+		resp_pkt << std::string(bytes_M, len_M);
+		send(&resp_pkt, 1, true);
+		break;
+	}
+	case TOCLIENT_AUTH_ACCEPT: {
+		deleteAuthData();
+
+		v3f playerpos;
+		u64 map_seed;
+		f32 recommended_send_interval;
+		u32 sudo_auth_methods;
+		*pkt >> playerpos >> map_seed >> recommended_send_interval
+			>> sudo_auth_methods;
+		m_pos = playerpos - v3f(0, BS / 2, 0);
+		m_yaw = m_random.range(0, 359);
+
+		// The bot has no media or definitions to wait for, so INIT2 and
+		// CLIENT_READY go out back to back
+		NetworkPacket init2_pkt(TOSERVER_INIT2, 2);
+		init2_pkt << std::string("");
+		send(&init2_pkt, 1, true);
+
+		NetworkPacket ready_pkt(TOSERVER_CLIENT_READY,
+				1 + 1 + 1 + 1 + 2 + strlen(g_version_hash) + 2);
+		ready_pkt << (u8) VERSION_MAJOR << (u8) VERSION_MINOR
+			<< (u8) VERSION_PATCH << (u8) 0
+			<< (u16) strlen(g_version_hash);
+		ready_pkt.putRawString(g_version_hash, (u16) strlen(g_version_hash));
+		ready_pkt << (u16) FORMSPEC_API_VERSION;
+		send(&ready_pkt, 0, true);
+
+		m_state = BOT_PLAYING;
+		break;
+	}
+	case TOCLIENT_ACCESS_DENIED: {
+		u8 denyCode;
+		std::string custom_reason;
+		*pkt >> denyCode >> custom_reason;
+		errorstream << "LoadTestBot " << m_name << ": access denied, code "
+			<< (int) denyCode << " \"" << custom_reason << "\"" << std::endl;
+		m_state = BOT_FAILED;
+		break;
+	}
+	case TOCLIENT_BLOCKDATA: {
+		if (pkt->getSize() < 6)
+			return;
+		v3s16 p;
+		*pkt >> p;
+		m_gotblocks.push_back(p);
+		break;
+	}
+	case TOCLIENT_BLOCKDATAS: {
+		if (pkt->getSize() < 2)
+			return;
+		u16 count;
+		*pkt >> count;
+		for (u16 i = 0; i < count; i++) {
+			v3s16 p;
+			*pkt >> p;
+			pkt->readLongString();
+			m_gotblocks.push_back(p);
+		}
+		break;
+	}
+	case TOCLIENT_DEATHSCREEN: {
+		NetworkPacket resp_pkt(TOSERVER_RESPAWN, 0);
+		send(&resp_pkt, 0, true);
+		break;
+	}
+	default:
+		// Everything else (definitions, objects, chat, ...) only needs
+		// to be received to load the server realistically
+		break;
+	}
+}
+
+void LoadTestBot::startAuth(u32 auth_mechs)
+{
+	if (auth_mechs & AUTH_MECHANISM_FIRST_SRP) {
+		// Register ourselves; same as Client::startAuth()
+		m_chosen_auth_mech = AUTH_MECHANISM_FIRST_SRP;
+
+		std::string verifier;
+		std::string salt;
+		generate_srp_verifier_and_salt(m_name, m_password,
+			&verifier, &salt);
+
+		NetworkPacket resp_pkt(TOSERVER_FIRST_SRP, 0);
+		resp_pkt << salt << verifier << (u8) (m_password.empty() ? 1 : 0);
+		send(&resp_pkt, 1, true);
+	} else if (auth_mechs & AUTH_MECHANISM_SRP) {
+		m_chosen_auth_mech = AUTH_MECHANISM_SRP;
+
+		std::string playername_u = lowercase(m_name);
+		m_auth_data = srp_user_new(SRP_SHA256, SRP_NG_2048,
+			m_name.c_str(), playername_u.c_str(),
+			(const unsigned char *) m_password.c_str(),
+			m_password.length(), NULL, NULL);
+		char *bytes_A = 0;
+		size_t len_A = 0;
+		SRP_Result res = srp_user_start_authentication(m_auth_data,
+			NULL, NULL, 0, (unsigned char **) &bytes_A, &len_A);
+		if (res != SRP_OK) {
+			errorstream << "LoadTestBot " << m_name
+				<< ": creating local SRP user failed" << std::endl;
+			m_state = BOT_FAILED;
+			return;
+		}
+
+		NetworkPacket resp_pkt(TOSERVER_SRP_BYTES_A, 0);
+		resp_pkt << std::string(bytes_A, len_A) << (u8) 1;
+		send(&resp_pkt, 1, true);
+	} else {
+		errorstream << "LoadTestBot " << m_name
+			<< ": server offers no supported auth mechanism (0x"
+			<< std::hex << auth_mechs << std::dec << ")" << std::endl;
+		m_state = BOT_FAILED;
+	}
+}
+
+void LoadTestBot::deleteAuthData()
+{
+	if (m_auth_data) {
+		srp_user_delete(m_auth_data);
+		m_auth_data = nullptr;
+	}
+}
+
+void LoadTestBot::flushGotBlocks()
+{
+	// Acknowledge received blocks so the server keeps its send window
+	// moving; u8 count per packet
+	size_t i = 0;
+	while (i < m_gotblocks.size()) {
+		size_t count = MYMIN(m_gotblocks.size() - i, 255);
+		NetworkPacket pkt(TOSERVER_GOTBLOCKS, 1 + 6 * count);
+		pkt << (u8) count;
+		for (size_t k = 0; k < count; k++)
+			pkt << m_gotblocks[i + k];
+		send(&pkt, 2, true);
+		i += count;
+	}
+	m_gotblocks.clear();
+}
+
+// Same wire format as writePlayerPos() in client.cpp
+void LoadTestBot::writePlayerPos(NetworkPacket *pkt)
+{
+	float yaw_rad = m_yaw * (float) M_PI / 180.0f;
+	v3f speed_v = v3f(std::sin(yaw_rad), 0, std::cos(yaw_rad))
+			* move_speed * BS;
+
+	v3f pf = m_pos * 100;
+	v3f sf = speed_v * 100;
+	v3s32 position(pf.X, pf.Y, pf.Z);
+	v3s32 speed(sf.X, sf.Y, sf.Z);
+	u32 keyPressed = 0x01; // forward
+	u8 fov = 100;          // ~1.25 rad, scaled by 80
+	u8 wanted_range = 10;
+
+	*pkt << position << speed << (s32) 0 /* pitch*100 */
+		<< (s32) (m_yaw * 100) << keyPressed;
+	*pkt << fov << wanted_range;
+}
+
+void LoadTestBot::stepPlaying(float dtime)
+{
+	// Walk a random path: keep a heading for a few seconds, then turn.
+	// The server moves the player from the positions we report, so no
+	// collision handling is needed (anticheat clamps the speed).
+	m_dir_timer -= dtime;
+	if (m_dir_timer <= 0.0f) {
+		m_dir_timer = m_random.range(30, 80) / 10.0f;
+		m_yaw = m_random.range(0, 359);
+	}
+	float yaw_rad = m_yaw * (float) M_PI / 180.0f;
+	m_pos += v3f(std::sin(yaw_rad), 0, std::cos(yaw_rad))
+			* move_speed * BS * dtime;
+
+	NetworkPacket pkt(TOSERVER_PLAYERPOS, 12 + 12 + 4 + 4 + 4 + 1 + 1);
+	writePlayerPos(&pkt);
+	send(&pkt, 0, false);
+
+	if (dig_interval > 0.0f) {
+		m_dig_timer += dtime;
+		if (m_dig_timer >= dig_interval) {
+			m_dig_timer = 0.0f;
+
+			// Point at the node under our feet; start the dig on one
+			// interval and complete it on the next so the dig time is
+			// plausible
+			v3s16 under = floatToInt(m_pos, BS) + v3s16(0, -1, 0);
+			v3s16 above = under + v3s16(0, 1, 0);
+			PointedThing pointed(under, above, under,
+					intToFloat(under, BS), v3s16(0, 1, 0), 0, 0.0f);
+
+			InteractAction action = m_dig_started ?
+				INTERACT_DIGGING_COMPLETED : INTERACT_START_DIGGING;
+			m_dig_started = !m_dig_started;
+
+			NetworkPacket dig_pkt(TOSERVER_INTERACT, 1 + 2 + 0);
+			dig_pkt << (u8) action;
+			dig_pkt << (u16) 0; // wield index
+			std::ostringstream tmp_os(std::ios::binary);
+			pointed.serialize(tmp_os);
+			dig_pkt.putLongString(tmp_os.str());
+			writePlayerPos(&dig_pkt);
+			send(&dig_pkt, 0, true);
+		}
+	}
+
+	if (chat_interval > 0.0f) {
+		m_chat_timer += dtime;
+		if (m_chat_timer >= chat_interval) {
+			m_chat_timer = 0.0f;
+			std::ostringstream os;
+			os << "load test check-in " << ++m_chat_counter;
+			std::wstring message = utf8_to_wide(os.str());
+			NetworkPacket chat_pkt(TOSERVER_CHAT_MESSAGE,
+					2 + message.size() * sizeof(u16));
+			chat_pkt << message;
+			send(&chat_pkt, 0, true);
+		}
+	}
+}
+
+bool run_loadtest(const std::string &scenario_path)
+{
+	Settings scenario;
+	scenario.setDefault("address", "127.0.0.1");
+	scenario.setDefault("port", "30000");
+	scenario.setDefault("bots", "16");
+	scenario.setDefault("duration", "60");
+	scenario.setDefault("connect_interval", "0.25");
+	scenario.setDefault("name_prefix", "LoadBot");
+	scenario.setDefault("password", "");
+	scenario.setDefault("move_speed", "4");
+	scenario.setDefault("dig_interval", "2");
+	scenario.setDefault("chat_interval", "10");
+	scenario.setDefault("send_interval", "0.1");
+	if (!scenario.readConfigFile(scenario_path.c_str())) {
+		errorstream << "run_loadtest: cannot read scenario file \""
+			<< scenario_path << "\"" << std::endl;
+		return false;
+	}
+
+	const u32 num_bots = scenario.getU32("bots");
+	const float duration = scenario.getFloat("duration");
+	const float connect_interval = scenario.getFloat("connect_interval");
+	const float send_interval = MYMAX(scenario.getFloat("send_interval"),
+			0.02f);
+	const std::string name_prefix = scenario.get("name_prefix");
+	const std::string password = scenario.get("password");
+
+	Address address(0, 0, 0, 0, scenario.getU16("port"));
+	try {
+		address.Resolve(scenario.get("address").c_str());
+	} catch (ResolveError &e) {
+		errorstream << "run_loadtest: cannot resolve \""
+			<< scenario.get("address") << "\": " << e.what() << std::endl;
+		return false;
+	}
+
+	actionstream << "run_loadtest: connecting " << num_bots << " bots to "
+		<< address.serializeString() << ":" << address.getPort()
+		<< " for " << duration << "s" << std::endl;
+
+	std::vector<std::unique_ptr<LoadTestBot>> bots;
+	bots.reserve(num_bots);
+
+	float connect_timer = 0.0f;
+	float report_timer = 0.0f;
+	float elapsed = 0.0f;
+	u64 last_time_ms = porting::getTimeMs();
+
+	// Ramp-up time comes on top of the measurement duration
+	const float total_time = duration + num_bots * connect_interval;
+
+	while (elapsed < total_time) {
+		sleep_ms((int) (send_interval * 1000));
+		u64 now_ms = porting::getTimeMs();
+		float dtime = (now_ms - last_time_ms) / 1000.0f;
+		last_time_ms = now_ms;
+		elapsed += dtime;
+
+		connect_timer -= dtime;
+		if (bots.size() < num_bots && connect_timer <= 0.0f) {
+			connect_timer = connect_interval;
+			std::ostringstream name;
+			name << name_prefix << (bots.size() + 1);
+			auto bot = std::make_unique<LoadTestBot>(name.str(), password);
+			bot->move_speed = scenario.getFloat("move_speed");
+			bot->dig_interval = scenario.getFloat("dig_interval");
+			bot->chat_interval = scenario.getFloat("chat_interval");
+			bot->connect(address);
+			bots.push_back(std::move(bot));
+		}
+
+		for (auto &bot : bots)
+			bot->step(dtime);
+
+		report_timer += dtime;
+		if (report_timer >= 5.0f) {
+			report_timer = 0.0f;
+			u32 playing = 0, failed = 0;
+			u64 tx_bytes = 0, tx_packets = 0, rx_bytes = 0, rx_packets = 0;
+			for (auto &bot : bots) {
+				playing += bot->isPlaying() ? 1 : 0;
+				failed += bot->isFailed() ? 1 : 0;
+				bot->addTrafficTotals(&tx_bytes, &tx_packets,
+						&rx_bytes, &rx_packets);
+			}
+			actionstream << "run_loadtest: t=" << (int) elapsed << "s bots="
+				<< bots.size() << " playing=" << playing << " failed="
+				<< failed << " tx=" << (tx_bytes / 1024) << "KB/"
+				<< tx_packets << "pkts rx=" << (rx_bytes / 1024) << "KB/"
+				<< rx_packets << "pkts" << std::endl;
+		}
+	}
+
+	u32 playing = 0, failed = 0;
+	u64 tx_bytes = 0, tx_packets = 0, rx_bytes = 0, rx_packets = 0;
+	for (auto &bot : bots) {
+		playing += bot->isPlaying() ? 1 : 0;
+		failed += bot->isFailed() ? 1 : 0;
+		bot->addTrafficTotals(&tx_bytes, &tx_packets, &rx_bytes, &rx_packets);
+		bot->disconnect();
+	}
+	bots.clear();
+
+	actionstream << "run_loadtest: finished after " << (int) elapsed
+		<< "s: " << playing << "/" << num_bots << " bots playing, "
+		<< failed << " failed" << std::endl;
+	actionstream << "run_loadtest: totals: tx " << (tx_bytes / 1024)
+		<< " KB in " << tx_packets << " packets ("
+		<< (int) (tx_bytes / MYMAX(elapsed, 1.0f)) << " B/s), rx "
+		<< (rx_bytes / 1024) << " KB in " << rx_packets << " packets ("
+		<< (int) (rx_bytes / MYMAX(elapsed, 1.0f)) << " B/s)" << std::endl;
+
+	return failed == 0;
+}
@@ -0,0 +1,50 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <string>
+
+/*
+	Connects a number of headless scripted bot clients to a server so its
+	tick and bandwidth behavior can be measured under player-like load
+	from a single machine (--loadtest <scenario file>).
+
+	The bots speak the network protocol directly on con::Connection; no
+	rendering, media download or client environment is involved, so one
+	machine can sustain on the order of a hundred of them. Each bot logs
+	in (registering itself via SRP on first contact), acknowledges map
+	blocks, walks a random path, periodically digs the node under its
+	feet and sends chat messages.
+
+	The scenario file uses the minetest.conf format:
+
+		address          = 127.0.0.1  # server to connect to
+		port             = 30000
+		bots             = 16         # number of bots
+		duration         = 60         # seconds to run after ramp-up
+		connect_interval = 0.25       # seconds between bot connects
+		name_prefix      = LoadBot    # bots are <prefix>1 .. <prefix>N
+		password         =
+		move_speed       = 4          # nodes per second
+		dig_interval     = 2          # seconds between digs, 0 disables
+		chat_interval    = 10         # seconds between messages, 0 disables
+		send_interval    = 0.1        # seconds between position sends
+*/
+bool run_loadtest(const std::string &scenario_path);
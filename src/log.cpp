@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 
 #include "threading/mutex_auto_lock.h"
+#include "threading/thread.h"
 #include "debug.h"
 #include "gettime.h"
 #include "porting.h"
@@ -154,6 +155,171 @@ AndroidSystemLogOutput g_android_log_output;
 ///////////////////////////////////////////////////////////////////////////////
 
 
+////
+//// Asynchronous logging
+////
+
+struct LogRecord {
+	LogLevel level;
+	bool raw;
+	std::string text;
+	std::string timestamp;
+	std::string thread_name;
+};
+
+// Must be a power of two
+static const size_t LOG_RING_SIZE = 4096;
+
+/*
+	Bounded lock-free multi-producer/single-consumer ring (Vyukov's
+	bounded queue). Producers that find it full drop the record and
+	bump the overflow counter instead of blocking.
+*/
+struct Logger::AsyncState {
+	struct Cell {
+		std::atomic<size_t> sequence;
+		LogRecord record;
+	};
+
+	class WriterThread : public Thread {
+	public:
+		WriterThread(Logger *logger, AsyncState *state) :
+			Thread("LogWriter"), m_logger(logger), m_state(state)
+		{}
+
+	protected:
+		void *run()
+		{
+			while (!stopRequested()) {
+				m_state->drain(m_logger);
+				sleep_ms(10);
+			}
+			// Write whatever the producers managed to queue
+			m_state->drain(m_logger);
+			return nullptr;
+		}
+
+	private:
+		Logger *m_logger;
+		AsyncState *m_state;
+	};
+
+	AsyncState(Logger *logger) :
+		cells(new Cell[LOG_RING_SIZE]),
+		thread(new WriterThread(logger, this))
+	{
+		for (size_t i = 0; i < LOG_RING_SIZE; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~AsyncState()
+	{
+		delete thread;
+		delete[] cells;
+	}
+
+	bool push(LogRecord &&rec)
+	{
+		Cell *cell;
+		size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			cell = &cells[pos & (LOG_RING_SIZE - 1)];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+			if (dif == 0) {
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed))
+					break;
+			} else if (dif < 0) {
+				// Full
+				return false;
+			} else {
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+		cell->record = std::move(rec);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Only called by the writer thread
+	bool pop(LogRecord &rec)
+	{
+		Cell *cell = &cells[dequeue_pos & (LOG_RING_SIZE - 1)];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		if ((intptr_t)seq - (intptr_t)(dequeue_pos + 1) < 0)
+			return false;
+		rec = std::move(cell->record);
+		cell->sequence.store(dequeue_pos + LOG_RING_SIZE,
+				std::memory_order_release);
+		dequeue_pos++;
+		return true;
+	}
+
+	void drain(Logger *logger)
+	{
+		LogRecord rec;
+		while (pop(rec)) {
+			if (rec.raw) {
+				logger->logToOutputsRaw(rec.level, rec.text);
+				continue;
+			}
+			std::ostringstream os(std::ios_base::binary);
+			os << rec.timestamp << ": " << getLevelLabel(rec.level)
+				<< "[" << rec.thread_name << "]: " << rec.text;
+			logger->logToOutputs(rec.level, os.str(), rec.timestamp,
+					rec.thread_name, rec.text);
+		}
+
+		u64 lost = dropped.exchange(0, std::memory_order_relaxed);
+		if (lost != 0) {
+			std::ostringstream os(std::ios_base::binary);
+			os << getTimestamp() << ": WARNING[LogWriter]: " << lost
+				<< " log message(s) dropped (ring buffer full)";
+			logger->logToOutputs(LL_WARNING, os.str(), getTimestamp(),
+					"LogWriter", "log messages dropped");
+		}
+	}
+
+	Cell *cells;
+	std::atomic<size_t> enqueue_pos{0};
+	// Consumer-side only, needs no atomicity
+	size_t dequeue_pos = 0;
+	std::atomic<u64> dropped{0};
+
+	WriterThread *thread;
+};
+
+void Logger::startLogThread()
+{
+	if (m_async.load(std::memory_order_acquire))
+		return;
+
+	AsyncState *state = new AsyncState(this);
+	state->thread->start();
+	m_async.store(state, std::memory_order_release);
+}
+
+void Logger::stopLogThread()
+{
+	// Producers racing with this would have to log exactly while the
+	// process shuts down or re-initializes logging; callers only do
+	// either when the other threads are gone.
+	AsyncState *state = m_async.exchange(nullptr);
+	if (!state)
+		return;
+
+	state->thread->stop();
+	state->thread->wait();
+	delete state;
+}
+
+Logger::~Logger()
+{
+	stopLogThread();
+}
+
+
 ////
 //// Logger
 ////
@@ -273,8 +439,20 @@ void Logger::log(LogLevel lev, const std::string &text)
 		return;
 
 	const std::string thread_name = getThreadName();
-	const std::string label = getLevelLabel(lev);
 	const std::string timestamp = getTimestamp();
+
+	// Errors are written synchronously so they cannot get lost if the
+	// process dies; everything else goes through the ring and gets
+	// formatted on the writer thread
+	AsyncState *async = m_async.load(std::memory_order_acquire);
+	if (async && lev >= LL_WARNING) {
+		LogRecord rec = {lev, false, text, timestamp, thread_name};
+		if (!async->push(std::move(rec)))
+			async->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	const std::string label = getLevelLabel(lev);
 	std::ostringstream os(std::ios_base::binary);
 	os << timestamp << ": " << label << "[" << thread_name << "]: " << text;
 
@@ -286,6 +464,14 @@ void Logger::logRaw(LogLevel lev, const std::string &text)
 	if (m_silenced_levels[lev])
 		return;
 
+	AsyncState *async = m_async.load(std::memory_order_acquire);
+	if (async && lev >= LL_WARNING) {
+		LogRecord rec = {lev, true, text, "", ""};
+		if (!async->push(std::move(rec)))
+			async->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
 	logToOutputsRaw(lev, text);
 }
 
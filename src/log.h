@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <queue>
 #include <string>
@@ -53,6 +54,8 @@ typedef u8 LogLevelMask;
 
 class Logger {
 public:
+	~Logger();
+
 	void addOutput(ILogOutput *out);
 	void addOutput(ILogOutput *out, LogLevel lev);
 	void addOutputMasked(ILogOutput *out, LogLevelMask mask);
@@ -70,6 +73,13 @@ public:
 	void setTraceEnabled(bool enable) { m_trace_enabled = enable; }
 	bool getTraceEnabled() { return m_trace_enabled; }
 
+	// Route warning and lower-priority messages through a lock-free ring
+	// drained by a dedicated writer thread, so producers never wait on
+	// the outputs. Errors stay synchronous, and everything is
+	// synchronous before startLogThread() / after stopLogThread().
+	void startLogThread();
+	void stopLogThread();
+
 	static LogLevel stringToLevel(const std::string &name);
 	static const std::string getLevelLabel(LogLevel lev);
 
@@ -92,6 +102,10 @@ private:
 	std::map<std::thread::id, std::string> m_thread_names;
 	mutable std::mutex m_mutex;
 	bool m_trace_enabled;
+
+	// Ring buffer and writer thread; non-null while the thread runs
+	struct AsyncState;
+	std::atomic<AsyncState *> m_async{nullptr};
 };
 
 class ILogOutput {
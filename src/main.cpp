@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "chat_interface.h"
 #include "debug.h"
 #include "unittest/test.h"
+#include "benchmark/benchmark.h"
 #include "server.h"
 #include "filesys.h"
 #include "version.h"
@@ -31,9 +32,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gettext.h"
 #include "log.h"
 #include "util/quicktune.h"
+#include "util/tracerecorder.h"
 #include "httpfetch.h"
 #include "gameparams.h"
+#include "loadtest.h"
 #include "database/database.h"
+#include "threading/thread.h"
+#include "threading/thread_pool.h"
+#include <deque>
+#include <mutex>
 #include "config.h"
 #include "player.h"
 #include "porting.h"
@@ -189,8 +196,18 @@ int main(int argc, char *argv[])
 	if (cmd_args.getFlag("run-unittests")) {
 		return run_tests();
 	}
+
+	// Run benchmarks
+	if (cmd_args.getFlag("run-benchmarks")) {
+		run_benchmarks();
+		return 0;
+	}
 #endif
 
+	// Run scripted load test bots against a server
+	if (cmd_args.exists("loadtest"))
+		return run_loadtest(cmd_args.get("loadtest")) ? 0 : 1;
+
 	GameParams game_params;
 #ifdef SERVER
 	porting::attachOrCreateConsole();
@@ -229,6 +246,8 @@ int main(int argc, char *argv[])
 	// Stop httpfetch thread (if started)
 	httpfetch_cleanup();
 
+	g_thread_pool->stop();
+
 	END_DEBUG_EXCEPTION_HANDLER
 
 	return retval;
@@ -261,6 +280,14 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Set network port (UDP)"))));
 	allowed_options->insert(std::make_pair("run-unittests", ValueSpec(VALUETYPE_FLAG,
 			_("Run the unit tests and exit"))));
+	allowed_options->insert(std::make_pair("run-benchmarks", ValueSpec(VALUETYPE_FLAG,
+			_("Run the benchmarks and exit"))));
+	allowed_options->insert(std::make_pair("loadtest", ValueSpec(VALUETYPE_STRING,
+			_("Connect load test bots per the given scenario file and exit"))));
+	allowed_options->insert(std::make_pair("replay-session", ValueSpec(VALUETYPE_STRING,
+			_("Replay a recorded session into the server (implies --server)"))));
+	allowed_options->insert(std::make_pair("replay-speed", ValueSpec(VALUETYPE_STRING,
+			_("Speed factor for --replay-session (default 1.0)"))));
 	allowed_options->insert(std::make_pair("map-dir", ValueSpec(VALUETYPE_STRING,
 			_("Same as --world (deprecated)"))));
 	allowed_options->insert(std::make_pair("world", ValueSpec(VALUETYPE_STRING,
@@ -483,6 +510,13 @@ static bool init_common(const Settings &cmd_args, int argc, char *argv[])
 
 	init_log_streams(cmd_args);
 
+	// Move log formatting and output writing off the logging threads.
+	// The writer must be joined before static destruction starts tearing
+	// down the outputs it writes to (the ~Logger call is only a
+	// fallback), so stop it on every exit path out of main().
+	g_logger.startLogThread();
+	atexit([] { g_logger.stopLogThread(); });
+
 	// Initialize random seed
 	srand(time(0));
 	mysrand(time(0));
@@ -490,9 +524,18 @@ static bool init_common(const Settings &cmd_args, int argc, char *argv[])
 	// Initialize HTTP fetcher
 	httpfetch_init(g_settings->getS32("curl_parallel_limit"));
 
+	// Start the shared worker thread pool
+	g_thread_pool->start(g_settings->getU16("thread_pool_threads"),
+			g_settings->getBool("thread_pool_affinity"));
+
 	init_gettext(porting::path_locale.c_str(),
 		g_settings->get("language"), argc, argv);
 
+	// Record begin/end events of every TimeTaker; the buffer is dumped
+	// as chrome://tracing JSON when the process exits
+	if (g_settings->getBool("event_tracing"))
+		g_trace_recorder->start(porting::path_user + DIR_DELIM + "trace.json");
+
 	return true;
 }
 
@@ -896,7 +939,14 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 
 			server.start();
 			// Run server
-			dedicated_server_loop(server, kill);
+			if (cmd_args.exists("replay-session")) {
+				server.setSessionReplayMode(true);
+				session_replay_loop(server, kill, cmd_args.get("replay-session"),
+						cmd_args.exists("replay-speed") ?
+							cmd_args.getFloat("replay-speed") : 1.0f);
+			} else {
+				dedicated_server_loop(server, kill);
+			}
 		} catch (const ModError &e) {
 			g_term_console.stopAndWaitforThread();
 			errorstream << "ModError: " << e.what() << std::endl;
@@ -928,7 +978,14 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 
 			// Run server
 			bool &kill = *porting::signal_handler_killstatus();
-			dedicated_server_loop(server, kill);
+			if (cmd_args.exists("replay-session")) {
+				server.setSessionReplayMode(true);
+				session_replay_loop(server, kill, cmd_args.get("replay-session"),
+						cmd_args.exists("replay-speed") ?
+							cmd_args.getFloat("replay-speed") : 1.0f);
+			} else {
+				dedicated_server_loop(server, kill);
+			}
 
 		} catch (const ModError &e) {
 			errorstream << "ModError: " << e.what() << std::endl;
@@ -942,6 +999,73 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	return true;
 }
 
+/*
+	Parallel migration pipeline. Reader threads (one database connection
+	each) load raw block blobs into a bounded queue; the main thread
+	drains it into the new backend in batched transactions. The blobs are
+	copied verbatim, so there is no transform stage.
+*/
+
+// Blocks per writer transaction
+#define MIGRATE_BATCH_SIZE 1024
+// Blobs buffered between the readers and the writer
+#define MIGRATE_QUEUE_LIMIT 4096
+// More readers than this usually just saturate the disk
+#define MIGRATE_MAX_READERS 4
+
+struct MigrateQueue
+{
+	std::mutex mutex;
+	std::deque<std::pair<v3s16, std::string>> items;
+};
+
+class MigrateReaderThread : public Thread
+{
+public:
+	MigrateReaderThread(MapDatabase *db, const std::vector<v3s16> *blocks,
+			size_t begin, size_t end, MigrateQueue *queue):
+		Thread("MigrateReader"),
+		m_db(db),
+		m_blocks(blocks),
+		m_begin(begin),
+		m_end(end),
+		m_queue(queue)
+	{}
+
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		for (size_t i = m_begin; i < m_end && !stopRequested(); i++) {
+			const v3s16 &pos = (*m_blocks)[i];
+			std::string data;
+			m_db->loadBlock(pos, &data);
+			// Empty blobs are passed on too so the writer can count them
+			for (;;) {
+				{
+					std::lock_guard<std::mutex> lock(m_queue->mutex);
+					if (m_queue->items.size() < MIGRATE_QUEUE_LIMIT) {
+						m_queue->items.emplace_back(pos, std::move(data));
+						break;
+					}
+				}
+				// Queue full; the writer is the bottleneck
+				sleep_ms(1);
+			}
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+		return nullptr;
+	}
+
+private:
+	MapDatabase *m_db;
+	const std::vector<v3s16> *m_blocks;
+	size_t m_begin;
+	size_t m_end;
+	MigrateQueue *m_queue;
+};
+
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args)
 {
 	std::string migrate_to = cmd_args.get("migrate");
@@ -955,7 +1079,7 @@ static bool migrate_map_database(const GameParams &game_params, const Settings &
 	if (!world_mt.exists("backend")) {
 		errorstream << "Please specify your current backend in world.mt:"
 			<< std::endl
-			<< "	backend = {sqlite3|leveldb|redis|dummy|postgresql}"
+			<< "	backend = {sqlite3|leveldb|redis|dummy|postgresql|pack}"
 			<< std::endl;
 		return false;
 	}
@@ -970,33 +1094,100 @@ static bool migrate_map_database(const GameParams &game_params, const Settings &
 	MapDatabase *old_db = ServerMap::createDatabase(backend, game_params.world_path, world_mt),
 		*new_db = ServerMap::createDatabase(migrate_to, game_params.world_path, world_mt);
 
-	u32 count = 0;
 	time_t last_update_time = 0;
 	bool &kill = *porting::signal_handler_killstatus();
 
 	std::vector<v3s16> blocks;
 	old_db->listAllLoadableBlocks(blocks);
+
+	// Partition the block list over reader threads, each with its own
+	// connection to the old backend
+	size_t num_readers = Thread::getNumberOfProcessors();
+	if (num_readers > MIGRATE_MAX_READERS)
+		num_readers = MIGRATE_MAX_READERS;
+	if (num_readers < 1)
+		num_readers = 1;
+	if (num_readers > blocks.size())
+		num_readers = blocks.size() > 0 ? blocks.size() : 1;
+
+	MigrateQueue queue;
+	std::vector<MapDatabase *> reader_dbs;
+	std::vector<MigrateReaderThread *> readers;
+	size_t per_reader = blocks.size() / num_readers;
+	for (size_t i = 0; i < num_readers; i++) {
+		MapDatabase *db = ServerMap::createDatabase(backend,
+				game_params.world_path, world_mt);
+		size_t begin = i * per_reader;
+		size_t end = (i + 1 == num_readers) ? blocks.size() : begin + per_reader;
+		MigrateReaderThread *reader =
+				new MigrateReaderThread(db, &blocks, begin, end, &queue);
+		reader_dbs.push_back(db);
+		readers.push_back(reader);
+		reader->start();
+	}
+
+	auto stop_readers = [&]() {
+		for (MigrateReaderThread *reader : readers)
+			reader->stop();
+		for (MigrateReaderThread *reader : readers) {
+			reader->wait();
+			delete reader;
+		}
+		for (MapDatabase *db : reader_dbs)
+			delete db;
+	};
+
+	size_t processed = 0;
+	u32 count = 0;
+	u64 start_ms = porting::getTimeMs();
 	new_db->beginSave();
-	for (std::vector<v3s16>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
-		if (kill) return false;
+	while (processed < blocks.size()) {
+		if (kill) {
+			stop_readers();
+			return false;
+		}
+
+		bool have_item = false;
+		std::pair<v3s16, std::string> item;
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.items.empty()) {
+				item = std::move(queue.items.front());
+				queue.items.pop_front();
+				have_item = true;
+			}
+		}
+		if (!have_item) {
+			// Readers haven't caught up yet
+			sleep_ms(1);
+			continue;
+		}
 
-		std::string data;
-		old_db->loadBlock(*it, &data);
-		if (!data.empty()) {
-			new_db->saveBlock(*it, data);
+		processed++;
+		if (!item.second.empty()) {
+			new_db->saveBlock(item.first, item.second);
+			if (++count % MIGRATE_BATCH_SIZE == 0) {
+				new_db->endSave();
+				new_db->beginSave();
+			}
 		} else {
-			errorstream << "Failed to load block " << PP(*it) << ", skipping it." << std::endl;
+			errorstream << "Failed to load block " << PP(item.first)
+				<< ", skipping it." << std::endl;
 		}
-		if (++count % 0xFF == 0 && time(NULL) - last_update_time >= 1) {
-			std::cerr << " Migrated " << count << " blocks, "
-				<< (100.0 * count / blocks.size()) << "% completed.\r";
-			new_db->endSave();
-			new_db->beginSave();
+
+		if (time(NULL) - last_update_time >= 1) {
+			double elapsed = (porting::getTimeMs() - start_ms) / 1000.0;
+			double rate = elapsed > 0 ? processed / elapsed : 0;
+			long eta = rate > 0 ? (long)((blocks.size() - processed) / rate) : 0;
+			std::cerr << " Migrated " << processed << " blocks, "
+				<< (100.0 * processed / blocks.size()) << "% completed, "
+				<< (u64)rate << " blocks/s, ETA " << eta << " s.   \r";
 			last_update_time = time(NULL);
 		}
 	}
 	std::cerr << std::endl;
 	new_db->endSave();
+	stop_readers();
 	delete old_db;
 	delete new_db;
 
@@ -24,6 +24,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "voxel.h"
 #include "voxelalgorithms.h"
 #include "porting.h"
+#include "metrics.h"
+#include "util/tunables.h"
 #include "serialization.h"
 #include "nodemetadata.h"
 #include "settings.h"
@@ -43,8 +45,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server.h"
 #include "database/database.h"
 #include "database/database-dummy.h"
+#include "database/database-pack.h"
 #include "database/database-sqlite3.h"
 #include "script/scripting_server.h"
+#include "threading/thread.h"
+#include <atomic>
 #include <deque>
 #include <queue>
 #if USE_LEVELDB
@@ -58,6 +63,29 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 
 
+/*
+	Per-thread MRU cache for block lookups.
+
+	Every thread that reads the map (env thread, emerge threads, the send
+	path) keeps its own few most recently used blocks, so lookups of the
+	same blocks from different threads don't fight over one shared cache
+	line. Entries are validated against a global generation counter that
+	is bumped whenever any block or sector is deleted; stale entries are
+	simply ignored.
+*/
+struct ThreadBlockCacheEntry
+{
+	Map *map = nullptr;
+	v3s16 pos;
+	MapBlock *block = nullptr;
+	u64 generation = 0;
+};
+
+static const size_t THREAD_BLOCK_CACHE_SIZE = 4;
+static std::atomic<u64> g_block_cache_generation(1);
+static thread_local ThreadBlockCacheEntry t_block_cache[THREAD_BLOCK_CACHE_SIZE];
+static thread_local size_t t_block_cache_next = 0;
+
 /*
 	Map
 */
@@ -77,6 +105,7 @@ Map::~Map()
 	for (auto &sector : m_sectors) {
 		delete sector.second;
 	}
+	g_block_cache_generation.fetch_add(1, std::memory_order_release);
 }
 
 void Map::addEventReceiver(MapEventReceiver *event_receiver)
@@ -98,23 +127,12 @@ void Map::dispatchEvent(const MapEditEvent &event)
 
 MapSector * Map::getSectorNoGenerateNoLock(v2s16 p)
 {
-	if(m_sector_cache != NULL && p == m_sector_cache_p){
-		MapSector * sector = m_sector_cache;
-		return sector;
-	}
-
-	std::map<v2s16, MapSector*>::iterator n = m_sectors.find(p);
+	auto n = m_sectors.find(p);
 
 	if (n == m_sectors.end())
 		return NULL;
 
-	MapSector *sector = n->second;
-
-	// Cache the last result
-	m_sector_cache_p = p;
-	m_sector_cache = sector;
-
-	return sector;
+	return n->second;
 }
 
 MapSector * Map::getSectorNoGenerate(v2s16 p)
@@ -124,11 +142,26 @@ MapSector * Map::getSectorNoGenerate(v2s16 p)
 
 MapBlock * Map::getBlockNoCreateNoEx(v3s16 p3d)
 {
+	u64 generation = g_block_cache_generation.load(std::memory_order_acquire);
+	for (ThreadBlockCacheEntry &e : t_block_cache) {
+		if (e.map == this && e.generation == generation && e.pos == p3d)
+			return e.block;
+	}
+
 	v2s16 p2d(p3d.X, p3d.Z);
 	MapSector * sector = getSectorNoGenerate(p2d);
 	if(sector == NULL)
 		return NULL;
 	MapBlock *block = sector->getBlockNoCreateNoEx(p3d.Y);
+
+	if (block) {
+		ThreadBlockCacheEntry &e = t_block_cache[t_block_cache_next];
+		t_block_cache_next = (t_block_cache_next + 1) % THREAD_BLOCK_CACHE_SIZE;
+		e.map = this;
+		e.pos = p3d;
+		e.block = block;
+		e.generation = generation;
+	}
 	return block;
 }
 
@@ -189,6 +222,7 @@ void Map::setNode(v3s16 p, MapNode & n)
 		return;
 	}
 	block->setNodeNoCheck(relpos, n);
+	reportNodesChange();
 }
 
 void Map::addNodeAndUpdate(v3s16 p, MapNode n,
@@ -253,6 +287,85 @@ void Map::removeNodeAndUpdate(v3s16 p,
 	addNodeAndUpdate(p, MapNode(CONTENT_AIR), modified_blocks, true);
 }
 
+bool Map::addNodesAndUpdate(
+		const std::vector<std::pair<v3s16, MapNode>> &nodes,
+		std::map<v3s16, MapBlock*> &modified_blocks,
+		bool remove_metadata)
+{
+	bool all_succeeded = true;
+
+	// The nodes that were actually set, with their old contents.
+	// update_lighting_nodes() merges their light frontiers and runs one
+	// combined propagation over them.
+	std::vector<std::pair<v3s16, MapNode>> oldnodes;
+	oldnodes.reserve(nodes.size());
+
+	for (const auto &it : nodes) {
+		const v3s16 p = it.first;
+		MapNode n = it.second;
+
+		// Collect old node for rollback
+		RollbackNode rollback_oldnode(this, p, m_gamedef);
+
+		// This is needed for updating the lighting
+		MapNode oldnode = getNode(p);
+
+		// Remove node metadata
+		if (remove_metadata) {
+			removeNodeMetadata(p);
+		}
+
+		// Set the node on the map
+		// Ignore light (because calling voxalgo::update_lighting_nodes)
+		n.setLight(LIGHTBANK_DAY, 0, m_nodedef);
+		n.setLight(LIGHTBANK_NIGHT, 0, m_nodedef);
+		try {
+			setNode(p, n);
+		} catch (InvalidPositionException &e) {
+			// Unlike the single-node variant, don't let one unloaded
+			// position abort the whole batch; the nodes that were
+			// already set still need their lighting update.
+			all_succeeded = false;
+			continue;
+		}
+
+		oldnodes.emplace_back(p, oldnode);
+
+		// Report for rollback
+		if (m_gamedef->rollback()) {
+			RollbackNode rollback_newnode(this, p, m_gamedef);
+			RollbackAction action;
+			action.setSetNode(p, rollback_oldnode, rollback_newnode);
+			m_gamedef->rollback()->reportAction(action);
+		}
+
+		/*
+			Add neighboring liquid nodes and this node to transform queue.
+			(it's vital for the node itself to get updated last, if it was removed.)
+		 */
+
+		for (const v3s16 &dir : g_7dirs) {
+			v3s16 p2 = p + dir;
+
+			bool is_valid_position;
+			MapNode n2 = getNode(p2, &is_valid_position);
+			if(is_valid_position &&
+					(m_nodedef->get(n2).isLiquid() ||
+					n2.getContent() == CONTENT_AIR))
+				m_transforming_liquid.push_back(p2);
+		}
+	}
+
+	// Update lighting
+	voxalgo::update_lighting_nodes(this, oldnodes, modified_blocks);
+
+	for (auto &modified_block : modified_blocks) {
+		modified_block.second->expireDayNightDiff();
+	}
+
+	return all_succeeded;
+}
+
 bool Map::addNodeWithEvent(v3s16 p, MapNode n, bool remove_metadata)
 {
 	MapEditEvent event;
@@ -304,6 +417,27 @@ bool Map::removeNodeWithEvent(v3s16 p)
 	return succeeded;
 }
 
+bool Map::addNodesWithEvent(const std::vector<std::pair<v3s16, MapNode>> &nodes,
+		bool remove_metadata)
+{
+	// A single-node edit sends a compact per-node event; for a batch the
+	// modified blocks are marked unsent as a whole instead.
+	MapEditEvent event;
+	event.type = MEET_OTHER;
+
+	std::map<v3s16, MapBlock*> modified_blocks;
+	bool succeeded = addNodesAndUpdate(nodes, modified_blocks, remove_metadata);
+
+	// Copy modified_blocks to event
+	for (auto &modified_block : modified_blocks) {
+		event.modified_blocks.insert(modified_block.first);
+	}
+
+	dispatchEvent(event);
+
+	return succeeded;
+}
+
 struct TimeOrderedMapBlock {
 	MapSector *sect;
 	MapBlock *block;
@@ -319,6 +453,10 @@ struct TimeOrderedMapBlock {
 	};
 };
 
+// Upper bound for the settled-liquids cache; above it, newly unloaded
+// blocks are simply not remembered and get a scan on reload.
+static const size_t REFLOW_SETTLED_LIMIT = 1 << 20;
+
 /*
 	Updates usage timers
 */
@@ -363,6 +501,13 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 						saved_blocks_count++;
 					}
 
+					// Remember blocks whose liquids were settled, so the
+					// reflow scan can be skipped when they are loaded again
+					if (!block->reflow_settled)
+						m_reflow_settled.erase(p);
+					else if (m_reflow_settled.size() < REFLOW_SETTLED_LIMIT)
+						m_reflow_settled.insert(p);
+
 					// Delete from memory
 					sector->deleteBlock(block);
 
@@ -415,6 +560,13 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 				saved_blocks_count++;
 			}
 
+			// Remember blocks whose liquids were settled, so the reflow
+			// scan can be skipped when they are loaded again
+			if (!block->reflow_settled)
+				m_reflow_settled.erase(p);
+			else if (m_reflow_settled.size() < REFLOW_SETTLED_LIMIT)
+				m_reflow_settled.insert(p);
+
 			// Delete from memory
 			b.sect->deleteBlock(block);
 
@@ -433,6 +585,10 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 	}
 	endSave();
 
+	// Deleted blocks may still sit in per-thread lookup caches
+	if (deleted_blocks_count != 0)
+		g_block_cache_generation.fetch_add(1, std::memory_order_release);
+
 	// Finally delete the empty sectors
 	deleteSectors(sector_deletion_queue);
 
@@ -453,6 +609,144 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 	}
 }
 
+struct EvictionOrderedMapBlock {
+	MapSector *sect;
+	MapBlock *block;
+	// Squared distance to the nearest player, in blocks
+	u64 dist_sq;
+	bool dirty;
+
+	// The top of the priority queue is evicted first: farthest from
+	// any player, then clean before dirty (clean blocks drop free),
+	// then least recently used
+	bool operator<(const EvictionOrderedMapBlock &b) const
+	{
+		if (dist_sq != b.dist_sq)
+			return dist_sq < b.dist_sq;
+		if (dirty != b.dirty)
+			return dirty;
+		return block->getUsageTimer() < b.block->getUsageTimer();
+	};
+};
+
+void Map::evictBlocksOverBudget(u64 budget_bytes,
+		const std::vector<v3s16> &player_block_positions,
+		const std::set<v3s16> *keep_blocks,
+		std::vector<v3s16> *unloaded_blocks)
+{
+	bool save_before_unloading = (mapType() == MAPTYPE_SERVER);
+
+	// Blocks this close to a player are never evicted, even when the
+	// budget is set unrealistically low
+	static const u64 min_keep_dist_sq = 3 * 3;
+
+	// Profile modified reasons
+	Profiler modprofiler;
+
+	u32 deleted_blocks_count = 0;
+	u32 saved_blocks_count = 0;
+
+	u64 memory_used = 0;
+	std::priority_queue<EvictionOrderedMapBlock> eviction_queue;
+	for (auto &sector_it : m_sectors) {
+		MapSector *sector = sector_it.second;
+
+		MapBlockVect blocks;
+		sector->getBlocks(blocks);
+
+		for (MapBlock *block : blocks) {
+			memory_used += block->getMemoryUsage();
+
+			v3s16 p = block->getPos();
+			u64 dist_sq = U64_MAX;
+			for (const v3s16 &player_pos : player_block_positions) {
+				v3s16 d = p - player_pos;
+				u64 ds = (s64) d.X * d.X + (s64) d.Y * d.Y +
+						(s64) d.Z * d.Z;
+				dist_sq = MYMIN(dist_sq, ds);
+			}
+			eviction_queue.push({sector, block, dist_sq,
+					block->getModified() != MOD_STATE_CLEAN});
+		}
+	}
+
+	if (memory_used <= budget_bytes)
+		return;
+
+	beginSave();
+	while (memory_used > budget_bytes && !eviction_queue.empty()) {
+		EvictionOrderedMapBlock b = eviction_queue.top();
+		eviction_queue.pop();
+
+		MapBlock *block = b.block;
+
+		if (b.dist_sq < min_keep_dist_sq)
+			break; // Everything left is at least as close
+		if (block->refGet() != 0)
+			continue;
+
+		v3s16 p = block->getPos();
+
+		// Active and forceloaded blocks hold their active objects'
+		// static data in memory only; deleting them would lose it
+		if (keep_blocks && keep_blocks->count(p) != 0)
+			continue;
+
+		// Save if modified; the save thread does the actual database
+		// write in the background
+		if (block->getModified() != MOD_STATE_CLEAN && save_before_unloading) {
+			modprofiler.add(block->getModifiedReasonString(), 1);
+			if (!saveBlock(block))
+				continue;
+			saved_blocks_count++;
+		}
+
+		// Remember blocks whose liquids were settled, so the reflow
+		// scan can be skipped when they are loaded again
+		if (!block->reflow_settled)
+			m_reflow_settled.erase(p);
+		else if (m_reflow_settled.size() < REFLOW_SETTLED_LIMIT)
+			m_reflow_settled.insert(p);
+
+		// Delete from memory
+		memory_used -= block->getMemoryUsage();
+		b.sect->deleteBlock(block);
+
+		if (unloaded_blocks)
+			unloaded_blocks->push_back(p);
+
+		deleted_blocks_count++;
+	}
+	endSave();
+
+	// Deleted blocks may still sit in per-thread lookup caches
+	if (deleted_blocks_count != 0)
+		g_block_cache_generation.fetch_add(1, std::memory_order_release);
+
+	// Delete empty sectors
+	std::vector<v2s16> sector_deletion_queue;
+	for (auto &sector_it : m_sectors) {
+		if (sector_it.second->empty())
+			sector_deletion_queue.push_back(sector_it.first);
+	}
+	deleteSectors(sector_deletion_queue);
+
+	if (deleted_blocks_count != 0) {
+		PrintInfo(infostream); // ServerMap/ClientMap:
+		infostream << "Evicted " << deleted_blocks_count
+				<< " blocks to fit the memory budget";
+		if (save_before_unloading)
+			infostream << ", of which " << saved_blocks_count
+					<< " were written";
+		infostream << "." << std::endl;
+		if (saved_blocks_count != 0) {
+			PrintInfo(infostream); // ServerMap/ClientMap:
+			infostream << "Blocks modified by: " << std::endl;
+			modprofiler.print(infostream);
+		}
+	}
+}
+
 void Map::unloadUnreferencedBlocks(std::vector<v3s16> *unloaded_blocks)
 {
 	timerUpdate(0.0, -1.0, 0, unloaded_blocks);
@@ -462,13 +756,12 @@ void Map::deleteSectors(std::vector<v2s16> &sectorList)
 {
 	for (v2s16 j : sectorList) {
 		MapSector *sector = m_sectors[j];
-		// If sector is in sector cache, remove it from there
-		if(m_sector_cache == sector)
-			m_sector_cache = NULL;
 		// Remove from map and delete
 		m_sectors.erase(j);
 		delete sector;
 	}
+	if (!sectorList.empty())
+		g_block_cache_generation.fetch_add(1, std::memory_order_release);
 }
 
 void Map::PrintInfo(std::ostream &out)
@@ -500,6 +793,85 @@ struct NodeNeighbor {
 	{ }
 };
 
+// Squared node distances to the nearest player delimiting the bands
+static const s64 liquid_band_limits_sq[LiquidTransformQueue::NUM_BANDS - 1] = {
+	64 * 64,
+	192 * 192
+};
+// Nodes a band may pop per round; near flows get most of the throughput
+static const int liquid_band_budgets[LiquidTransformQueue::NUM_BANDS] = {
+	8, 4, 2
+};
+
+void LiquidTransformQueue::push_back(v3s16 p)
+{
+	if (!m_set.insert(p).second)
+		return;
+	m_bands[bandOf(p)].push_back(p);
+}
+
+v3s16 LiquidTransformQueue::pop_front()
+{
+	// Pick the first band that has nodes and budget left. If every
+	// non-empty band has spent its budget, start a new round; a band
+	// that is alone in the queue thus gets the full throughput.
+	int band = -1;
+	for (int b = 0; b < NUM_BANDS; b++) {
+		if (m_bands[b].empty())
+			continue;
+		if (band < 0)
+			band = b;
+		if (m_budgets[b] > 0) {
+			band = b;
+			break;
+		}
+	}
+	sanity_check(band >= 0);
+	if (m_budgets[band] <= 0) {
+		for (int b = 0; b < NUM_BANDS; b++)
+			m_budgets[b] = liquid_band_budgets[b];
+	}
+	m_budgets[band]--;
+
+	v3s16 p = m_bands[band].front();
+	m_bands[band].pop_front();
+	m_set.erase(p);
+	return p;
+}
+
+u32 LiquidTransformQueue::dump(u32 count)
+{
+	u32 dropped = 0;
+	for (int b = NUM_BANDS - 1; b >= 0 && dropped < count; b--) {
+		while (!m_bands[b].empty() && dropped < count) {
+			m_set.erase(m_bands[b].front());
+			m_bands[b].pop_front();
+			dropped++;
+		}
+	}
+	return dropped;
+}
+
+int LiquidTransformQueue::bandOf(v3s16 p) const
+{
+	// Without players everything is equally urgent
+	if (m_ref_positions.empty())
+		return 0;
+
+	s64 nearest_sq = S64_MAX;
+	for (const v3s16 &ref : m_ref_positions) {
+		s64 dx = p.X - ref.X;
+		s64 dy = p.Y - ref.Y;
+		s64 dz = p.Z - ref.Z;
+		nearest_sq = MYMIN(nearest_sq, dx * dx + dy * dy + dz * dz);
+	}
+	for (int b = 0; b < NUM_BANDS - 1; b++) {
+		if (nearest_sq <= liquid_band_limits_sq[b])
+			return b;
+	}
+	return NUM_BANDS - 1;
+}
+
 void Map::transforming_liquid_add(v3s16 p) {
         m_transforming_liquid.push_back(p);
 }
@@ -518,7 +890,10 @@ void Map::transformLiquids(std::map<v3s16, MapBlock*> &modified_blocks,
 
 	std::vector<std::pair<v3s16, MapNode> > changed_nodes;
 
-	u32 liquid_loop_max = g_settings->getS32("liquid_loop_max");
+	static TunableInt *tune_liquid_loop_max = g_tunables->registerInt(
+			"liquid_loop_max", g_settings->getS32("liquid_loop_max"),
+			100, 100000000, "Max liquid nodes transformed per step");
+	u32 liquid_loop_max = tune_liquid_loop_max->get();
 	u32 loop_max = liquid_loop_max;
 
 #if 0
@@ -548,10 +923,15 @@ void Map::transformLiquids(std::map<v3s16, MapBlock*> &modified_blocks,
 		/*
 			Get a queued transforming liquid node
 		*/
-		v3s16 p0 = m_transforming_liquid.front();
-		m_transforming_liquid.pop_front();
+		v3s16 p0 = m_transforming_liquid.pop_front();
 
 		MapNode n0 = getNode(p0);
+		if (n0.getContent() == CONTENT_IGNORE) {
+			// The pending update targets an unloaded block; make sure the
+			// block gets a liquid scan when it is next loaded
+			m_reflow_settled.erase(getNodeBlockPos(p0));
+			continue;
+		}
 
 		/*
 			Collect information about current node
@@ -628,6 +1008,10 @@ void Map::transformLiquids(std::map<v3s16, MapBlock*> &modified_blocks,
 					} else {
 						neutrals[num_neutrals++] = nb;
 						if (nb.n.getContent() == CONTENT_IGNORE) {
+							// The unloaded neighbor must get a liquid scan
+							// when it is loaded; this liquid might flow
+							// into it then
+							m_reflow_settled.erase(getNodeBlockPos(npos));
 							// If node below is ignore prevent water from
 							// spreading outwards and otherwise prevent from
 							// flowing away as ignore node might be the source
@@ -877,8 +1261,9 @@ void Map::transformLiquids(std::map<v3s16, MapBlock*> &modified_blocks,
 		infostream << "transformLiquids(): DUMPING " << dump_qty
 		           << " blocks from the queue" << std::endl;
 
-		while (dump_qty--)
-			m_transforming_liquid.pop_front();
+		// Dump the far bands first; the flows close to players are the
+		// ones worth keeping
+		m_transforming_liquid.dump(dump_qty);
 
 		m_queue_size_timer_started = false; // optimistically assume we can keep up now
 		m_unprocessed_count = m_transforming_liquid.size();
@@ -1197,6 +1582,8 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 	// Tell the EmergeManager about our MapSettingsManager
 	emerge->map_settings_mgr = &settings_mgr;
 
+	m_ignore_world_load_errors = g_settings->getBool("ignore_world_load_errors");
+
 	/*
 		Try to load map; if not found, create a new one.
 	*/
@@ -1265,6 +1652,10 @@ ServerMap::~ServerMap()
 {
 	verbosestream<<FUNCTION_NAME<<std::endl;
 
+	stopPrefetchThread();
+	// Stop the save thread first; the final save below is synchronous
+	stopSaveThread();
+
 	try
 	{
 		if (m_map_saving_enabled) {
@@ -1426,7 +1817,8 @@ void ServerMap::finishBlockMake(BlockMakeData *data,
 
 	/*
 		Blit generated stuff to map
-		NOTE: blitBackAll adds nearly everything to changed_blocks
+		NOTE: blitBackAll adds everything the generator actually wrote
+		to changed_blocks; untouched margin blocks are skipped
 	*/
 	data->vmanip->blitBackAll(changed_blocks);
 
@@ -1925,6 +2317,7 @@ void ServerMap::listAllLoadableBlocks(std::vector<v3s16> &dst)
 		errorstream << "Map::listAllLoadableBlocks(): Result will be missing "
 				<< "all blocks that are stored in flat files." << std::endl;
 	}
+	MutexAutoLock dblock(m_dbase_mutex);
 	dbase->listAllLoadableBlocks(dst);
 	if (dbase_ro)
 		dbase_ro->listAllLoadableBlocks(dst);
@@ -1954,9 +2347,11 @@ MapDatabase *ServerMap::createDatabase(
 		return new MapDatabaseSQLite3(savedir);
 	if (name == "dummy")
 		return new Database_Dummy();
+	if (name == "pack")
+		return new Database_Pack(savedir);
 	#if USE_LEVELDB
 	if (name == "leveldb")
-		return new Database_LevelDB(savedir);
+		return new Database_LevelDB(savedir, conf);
 	#endif
 	#if USE_REDIS
 	if (name == "redis")
@@ -1973,18 +2368,320 @@ MapDatabase *ServerMap::createDatabase(
 	throw BaseException(std::string("Database backend ") + name + " not supported.");
 }
 
+/*
+	MapSaveThread
+
+	Writes queued blocks to the map database in the background. The
+	server thread only serializes dirty blocks into ServerMap's pending
+	map; the actual database I/O (and its fsyncs) happens here, batched
+	into one transaction per wakeup.
+*/
+class MapSaveThread : public Thread
+{
+public:
+	MapSaveThread(ServerMap *map):
+		Thread("MapSave"),
+		m_map(map)
+	{}
+
+	void stop()
+	{
+		Thread::stop();
+		// Wake the thread up so it notices the stop request
+		m_map->m_save_sem.post();
+	}
+
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		while (!stopRequested()) {
+			m_map->m_save_sem.wait();
+			// Coalesce everything queued so far into one batch
+			while (m_map->m_save_sem.wait(0));
+
+			if (stopRequested())
+				break;
+
+			m_map->writePendingBlocks();
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+		return nullptr;
+	}
+
+private:
+	ServerMap *m_map;
+};
+
+void ServerMap::startSaveThread()
+{
+	if (m_save_thread || !m_map_saving_enabled)
+		return;
+	m_save_thread = new MapSaveThread(this);
+	m_save_thread->start();
+}
+
+void ServerMap::stopSaveThread()
+{
+	if (!m_save_thread)
+		return;
+	m_save_thread->stop();
+	m_save_thread->wait();
+	delete m_save_thread;
+	m_save_thread = nullptr;
+	// Flush whatever the thread did not get to before stopping
+	writePendingBlocks();
+}
+
+bool ServerMap::saveThreadRunning()
+{
+	return m_save_thread && m_save_thread->isRunning();
+}
+
+// Upper bound for positions waiting to be prefetched
+#define PREFETCH_QUEUE_LIMIT 256
+// Upper bound for prefetched blobs waiting to be consumed
+#define PREFETCH_CACHE_LIMIT 512
+
+/*
+	MapPrefetchThread
+
+	Reads blocks predicted from player movement into ServerMap's
+	prefetch cache, so the send path finds them there instead of doing
+	a synchronous database read under the environment lock.
+*/
+class MapPrefetchThread : public Thread
+{
+public:
+	MapPrefetchThread(ServerMap *map):
+		Thread("MapPrefetch"),
+		m_map(map)
+	{}
+
+	void stop()
+	{
+		Thread::stop();
+		// Wake the thread up so it notices the stop request
+		m_map->m_prefetch_sem.post();
+	}
+
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		while (!stopRequested()) {
+			m_map->m_prefetch_sem.wait();
+			if (stopRequested())
+				break;
+
+			// Drain the whole queue at once; batched backends (redis)
+			// then pay one round trip for the lot
+			std::vector<v3s16> batch;
+			{
+				MutexAutoLock qlock(m_map->m_prefetch_queue_mutex);
+				if (m_map->m_prefetch_queue.empty())
+					continue;
+				batch.assign(m_map->m_prefetch_queue.begin(),
+					m_map->m_prefetch_queue.end());
+				m_map->m_prefetch_queue.clear();
+			}
+			m_map->prefetchBlocks(batch);
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+		return nullptr;
+	}
+
+private:
+	ServerMap *m_map;
+};
+
+void ServerMap::startPrefetchThread()
+{
+	if (m_prefetch_thread)
+		return;
+	m_prefetch_thread = new MapPrefetchThread(this);
+	m_prefetch_thread->start();
+}
+
+void ServerMap::stopPrefetchThread()
+{
+	if (!m_prefetch_thread)
+		return;
+	m_prefetch_thread->stop();
+	m_prefetch_thread->wait();
+	delete m_prefetch_thread;
+	m_prefetch_thread = nullptr;
+}
+
+void ServerMap::queuePrefetch(v3s16 p)
+{
+	if (!m_prefetch_thread)
+		return;
+	// Already in memory, nothing to warm up
+	if (getBlockNoCreateNoEx(p))
+		return;
+	{
+		MutexAutoLock lock(m_prefetched_mutex);
+		if (m_prefetched.find(p) != m_prefetched.end())
+			return;
+	}
+	{
+		MutexAutoLock qlock(m_prefetch_queue_mutex);
+		if (m_prefetch_queue.size() >= PREFETCH_QUEUE_LIMIT)
+			return;
+		m_prefetch_queue.push_back(p);
+	}
+	m_prefetch_sem.post();
+}
+
+void ServerMap::prefetchBlocks(const std::vector<v3s16> &positions)
+{
+	std::vector<std::string> blobs;
+	{
+		MutexAutoLock dblock(m_dbase_mutex);
+		dbase->loadBlocks(positions, &blobs);
+		if (dbase_ro) {
+			for (size_t i = 0; i < positions.size(); i++) {
+				if (blobs[i].empty())
+					dbase_ro->loadBlock(positions[i], &blobs[i]);
+			}
+		}
+	}
+
+	MutexAutoLock lock(m_prefetched_mutex);
+	for (size_t i = 0; i < positions.size(); i++) {
+		if (blobs[i].empty())
+			continue;
+		// Keep the cache bounded; predictions are short-lived anyway
+		if (m_prefetched.size() >= PREFETCH_CACHE_LIMIT)
+			m_prefetched.clear();
+		m_prefetched[positions[i]] = std::move(blobs[i]);
+		g_profiler->add("MapPrefetchThread: blocks prefetched [#]", 1);
+	}
+}
+
+void ServerMap::queueBlockSave(MapBlock *block)
+{
+	v3s16 p3d = block->getPos();
+
+	// Dummy blocks are not written
+	if (block->isDummy()) {
+		warningstream << "queueBlockSave: Not writing dummy block "
+			<< PP(p3d) << std::endl;
+		return;
+	}
+
+	// Format used for writing
+	u8 version = SER_FMT_VER_HIGHEST_WRITE;
+
+	/*
+		[0] u8 serialization version
+		[1] data
+	*/
+	std::ostringstream o(std::ios_base::binary);
+	o.write((char*) &version, 1);
+	block->serialize(o, version, true);
+
+	{
+		MutexAutoLock pendinglock(m_save_pending_mutex);
+		PendingBlockSave &e = m_save_pending[p3d];
+		e.seq = ++m_save_seq;
+		e.data = o.str();
+	}
+	m_save_sem.post();
+
+	// The save thread owns the data now; from the map's point of view
+	// the block is saved
+	block->resetModified();
+}
+
+// Blocks committed per transaction by the save thread. Bounding the
+// group-commit keeps individual commits (and the dbase lock hold time)
+// short even when a huge backlog has piled up.
+#define SAVE_GROUP_COMMIT_MAX 1024
+
+// Pending blocks above which queueing stops and saveBlock() falls back
+// to waiting on a direct write (backpressure on the server thread)
+#define SAVE_PENDING_LIMIT 4096
+
+void ServerMap::writePendingBlocks()
+{
+	// Snapshot the batch; entries stay visible to loadBlock() until the
+	// database write has actually happened
+	std::vector<std::pair<v3s16, PendingBlockSave>> batch;
+	{
+		MutexAutoLock pendinglock(m_save_pending_mutex);
+		batch.assign(m_save_pending.begin(), m_save_pending.end());
+	}
+	if (batch.empty())
+		return;
+
+	for (size_t i = 0; i < batch.size(); i += SAVE_GROUP_COMMIT_MAX) {
+		size_t end = MYMIN(i + SAVE_GROUP_COMMIT_MAX, batch.size());
+		MutexAutoLock dblock(m_dbase_mutex);
+		dbase->beginSave();
+		for (size_t j = i; j < end; j++)
+			dbase->saveBlock(batch[j].first, batch[j].second.data);
+		dbase->endSave();
+	}
+
+	{
+		MutexAutoLock pendinglock(m_save_pending_mutex);
+		for (auto &it : batch) {
+			auto j = m_save_pending.find(it.first);
+			// Keep entries that were re-queued while we were writing
+			if (j != m_save_pending.end() && j->second.seq == it.second.seq)
+				m_save_pending.erase(j);
+		}
+	}
+
+	g_profiler->add("MapSaveThread: blocks written", batch.size());
+}
+
 void ServerMap::beginSave()
 {
+	// The save thread batches its own transactions
+	if (saveThreadRunning())
+		return;
+	MutexAutoLock dblock(m_dbase_mutex);
 	dbase->beginSave();
 }
 
 void ServerMap::endSave()
 {
+	if (saveThreadRunning())
+		return;
+	MutexAutoLock dblock(m_dbase_mutex);
 	dbase->endSave();
 }
 
 bool ServerMap::saveBlock(MapBlock *block)
 {
+	{
+		// A stale prefetched blob must not shadow the newer data
+		MutexAutoLock prefetchlock(m_prefetched_mutex);
+		m_prefetched.erase(block->getPos());
+	}
+	if (saveThreadRunning()) {
+		size_t pending;
+		{
+			MutexAutoLock pendinglock(m_save_pending_mutex);
+			pending = m_save_pending.size();
+		}
+		queueBlockSave(block);
+		if (pending >= SAVE_PENDING_LIMIT) {
+			// Backpressure: the writer is far behind; wait out its
+			// current group commit before queueing anything else
+			g_profiler->add("ServerMap: save backpressure stalls [#]", 1);
+			MutexAutoLock dblock(m_dbase_mutex);
+		}
+		return true;
+	}
+	// The synchronous fallback shares the connection with the prefetch
+	// thread, which only holds m_dbase_mutex
+	MutexAutoLock dblock(m_dbase_mutex);
 	return saveBlock(block, dbase);
 }
 
@@ -2010,7 +2707,11 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db)
 	o.write((char*) &version, 1);
 	block->serialize(o, version, true);
 
+	u64 write_begin_us = porting::getTimeUs();
 	bool ret = db->saveBlock(p3d, o.str());
+	g_metrics->observe("minetest_map_save_block_seconds",
+			"Map block database write duration",
+			(porting::getTimeUs() - write_begin_us) / 1e6);
 	if (ret) {
 		// We just wrote it to the disk so clear modified flag
 		block->resetModified();
@@ -2061,8 +2762,7 @@ void ServerMap::loadBlock(const std::string &sectordir, const std::string &block
 		// If it's a new block, insert it to the map
 		if (created_new) {
 			sector->insertBlock(block);
-			ReflowScan scanner(this, m_emerge->ndef);
-			scanner.scan(block, &m_transforming_liquid);
+			scanLoadedBlockLiquids(block);
 		}
 
 		/*
@@ -2122,8 +2822,7 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 		// If it's a new block, insert it to the map
 		if (created_new) {
 			sector->insertBlock(block);
-			ReflowScan scanner(this, m_emerge->ndef);
-			scanner.scan(block, &m_transforming_liquid);
+			scanLoadedBlockLiquids(block);
 		}
 
 		/*
@@ -2147,7 +2846,7 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 		// TODO: Block should be marked as invalid in memory so that it is
 		// not touched but the game can run
 
-		if(g_settings->getBool("ignore_world_load_errors")){
+		if(m_ignore_world_load_errors){
 			errorstream<<"Ignoring block load error. Duck and cover! "
 					<<"(ignore_world_load_errors)"<<std::endl;
 		} else {
@@ -2156,6 +2855,115 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 	}
 }
 
+bool ServerMap::loadBlockData(v3s16 blockpos, std::string *blob)
+{
+	blob->clear();
+	{
+		// A block queued for saving but not yet written must be re-read
+		// from the pending data, not from the (stale) database
+		MutexAutoLock pendinglock(m_save_pending_mutex);
+		auto it = m_save_pending.find(blockpos);
+		if (it != m_save_pending.end())
+			*blob = it->second.data;
+	}
+	if (blob->empty()) {
+		// Consume a speculatively prefetched blob if one exists
+		MutexAutoLock prefetchlock(m_prefetched_mutex);
+		auto it = m_prefetched.find(blockpos);
+		if (it != m_prefetched.end()) {
+			*blob = std::move(it->second);
+			m_prefetched.erase(it);
+		}
+	}
+	if (blob->empty()) {
+		MutexAutoLock dblock(m_dbase_mutex);
+		dbase->loadBlock(blockpos, blob);
+		if (blob->empty() && dbase_ro)
+			dbase_ro->loadBlock(blockpos, blob);
+	}
+	return !blob->empty();
+}
+
+MapBlock *ServerMap::deserializeBlock(v3s16 blockpos, std::string *blob)
+{
+	MapBlock *block = nullptr;
+	try {
+		std::istringstream is(*blob, std::ios_base::binary);
+
+		u8 version = SER_FMT_VER_INVALID;
+		is.read((char *)&version, 1);
+
+		if (is.fail())
+			throw SerializationError("ServerMap::deserializeBlock(): Failed"
+					" to read MapBlock version");
+
+		block = new MapBlock(this, blockpos, m_gamedef);
+		block->deSerialize(is, version, true);
+
+		// We just loaded it, so it's up-to-date.
+		block->resetModified();
+		return block;
+	}
+	catch (SerializationError &e)
+	{
+		delete block;
+
+		errorstream<<"Invalid block data in database"
+				<<" ("<<blockpos.X<<","<<blockpos.Y<<","<<blockpos.Z<<")"
+				<<" (SerializationError): "<<e.what()<<std::endl;
+
+		if(m_ignore_world_load_errors){
+			errorstream<<"Ignoring block load error. Duck and cover! "
+					<<"(ignore_world_load_errors)"<<std::endl;
+			return nullptr;
+		}
+		throw SerializationError("Invalid block data in database");
+	}
+}
+
+MapBlock *ServerMap::insertLoadedBlock(MapBlock *block)
+{
+	v3s16 p3d = block->getPos();
+	v2s16 p2d(p3d.X, p3d.Z);
+
+	MapSector *sector = createSector(p2d);
+	MapBlock *existing = sector->getBlockNoCreateNoEx(p3d.Y);
+	if (existing) {
+		// Somebody else got a block in while we were deserializing;
+		// theirs is already wired into the map, so it wins
+		delete block;
+		return nullptr;
+	}
+
+	sector->insertBlock(block);
+	scanLoadedBlockLiquids(block);
+
+	std::map<v3s16, MapBlock*> modified_blocks;
+	// Fix lighting if necessary
+	voxalgo::update_block_border_lighting(this, block, modified_blocks);
+	if (!modified_blocks.empty()) {
+		//Modified lighting, send event
+		MapEditEvent event;
+		event.type = MEET_OTHER;
+		for (auto &it : modified_blocks)
+			event.modified_blocks.insert(it.first);
+		dispatchEvent(event);
+	}
+	return block;
+}
+
+void ServerMap::scanLoadedBlockLiquids(MapBlock *block)
+{
+	if (m_reflow_settled.count(block->getPos())) {
+		// The block's liquids were settled when it was last unloaded and
+		// nothing around it changed since; the scan would queue nothing.
+		block->reflow_settled = true;
+		return;
+	}
+	ReflowScan scanner(this, m_emerge->ndef);
+	scanner.scan(block, &m_transforming_liquid);
+}
+
 MapBlock* ServerMap::loadBlock(v3s16 blockpos)
 {
 	bool created_new = (getBlockNoCreateNoEx(blockpos) == NULL);
@@ -2163,15 +2971,9 @@ MapBlock* ServerMap::loadBlock(v3s16 blockpos)
 	v2s16 p2d(blockpos.X, blockpos.Z);
 
 	std::string ret;
-	dbase->loadBlock(blockpos, &ret);
-	if (!ret.empty()) {
+	if (loadBlockData(blockpos, &ret)) {
 		loadBlock(&ret, blockpos, createSector(p2d), false);
-	} else if (dbase_ro) {
-		dbase_ro->loadBlock(blockpos, &ret);
-		if (!ret.empty()) {
-			loadBlock(&ret, blockpos, createSector(p2d), false);
-		}
-	} else {
+	} else if (!dbase_ro) {
 		// Not found in database, try the files
 
 		// The directory layout we're going to load from.
@@ -2228,6 +3030,16 @@ MapBlock* ServerMap::loadBlock(v3s16 blockpos)
 
 bool ServerMap::deleteBlock(v3s16 blockpos)
 {
+	{
+		MutexAutoLock pendinglock(m_save_pending_mutex);
+		m_save_pending.erase(blockpos);
+	}
+	{
+		MutexAutoLock prefetchlock(m_prefetched_mutex);
+		m_prefetched.erase(blockpos);
+	}
+	m_reflow_settled.erase(blockpos);
+	MutexAutoLock dblock(m_dbase_mutex);
 	if (!dbase->deleteBlock(blockpos))
 		return false;
 
@@ -2238,6 +3050,7 @@ bool ServerMap::deleteBlock(v3s16 blockpos)
 		if (!sector)
 			return false;
 		sector->deleteBlock(block);
+		g_block_cache_generation.fetch_add(1, std::memory_order_release);
 	}
 
 	return true;
@@ -2364,6 +3177,11 @@ void MMVManip::blitBackAll(std::map<v3s16, MapBlock*> *modified_blocks,
 			(!overwrite_generated && block->isGenerated()))
 			continue;
 
+		// Skip blocks the vmanip never wrote into; copying identical
+		// data back would needlessly mark them for saving and resending
+		if (block->contentsEqualTo(*this))
+			continue;
+
 		block->copyFrom(*this);
 		block->raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_VMANIP);
 
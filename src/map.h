@@ -23,7 +23,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <sstream>
 #include <set>
 #include <map>
+#include <deque>
 #include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "irrlichttypes_bloated.h"
 #include "mapnode.h"
@@ -31,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "voxel.h"
 #include "modifiedstate.h"
 #include "util/container.h"
+#include "util/numeric.h"
 #include "nodetimer.h"
 #include "map_settings_manager.h"
 #include "debug.h"
@@ -46,6 +51,8 @@ class IGameDef;
 class IRollbackManager;
 class EmergeManager;
 class ServerEnvironment;
+class MapSaveThread;
+class MapPrefetchThread;
 struct BlockMakeData;
 
 /*
@@ -117,6 +124,50 @@ public:
 	virtual void onMapEditEvent(const MapEditEvent &event) = 0;
 };
 
+/*
+	LiquidTransformQueue
+
+	Queue of the nodes waiting for a liquid transform step. The nodes are
+	partitioned into priority bands by their distance to the nearest player
+	at the time they are queued, and transformLiquids() drains the bands
+	with weighted round-robin budgets so that a huge flood fill far away
+	from everybody cannot starve the small flows the players actually see.
+	A hash set rejects duplicate pushes in O(1) like UniqueQueue does.
+*/
+class LiquidTransformQueue
+{
+public:
+	static const int NUM_BANDS = 3;
+
+	// Sets the positions (in nodes) that newly queued nodes measure their
+	// distance against; usually the connected players. Nodes already in
+	// the queue keep the band they were assigned when they were pushed.
+	void setReferencePositions(const std::vector<v3s16> &positions)
+	{
+		m_ref_positions = positions;
+	}
+
+	void push_back(v3s16 p);
+
+	// Removes and returns the next node, preferring the bands close to
+	// players as long as their budget for the current round lasts.
+	v3s16 pop_front();
+
+	// Drops up to count nodes, farthest band first; used when the queue
+	// grows faster than it can be processed. Returns the number dropped.
+	u32 dump(u32 count);
+
+	u32 size() const { return m_set.size(); }
+
+private:
+	int bandOf(v3s16 p) const;
+
+	std::unordered_set<v3s16, v3s16Hash> m_set;
+	std::deque<v3s16> m_bands[NUM_BANDS];
+	std::vector<v3s16> m_ref_positions;
+	int m_budgets[NUM_BANDS] = {0, 0, 0};
+};
+
 class Map /*: public NodeContainer*/
 {
 public:
@@ -189,6 +240,16 @@ public:
 	void removeNodeAndUpdate(v3s16 p,
 			std::map<v3s16, MapBlock*> &modified_blocks);
 
+	// Batch variant of addNodeAndUpdate(). Sets all the given nodes first
+	// and then runs a single combined lighting update over their merged
+	// light frontier, instead of one propagation per node over overlapping
+	// volumes. Nodes at unloaded positions are skipped.
+	// Returns true if all nodes were set.
+	bool addNodesAndUpdate(
+			const std::vector<std::pair<v3s16, MapNode>> &nodes,
+			std::map<v3s16, MapBlock*> &modified_blocks,
+			bool remove_metadata = true);
+
 	/*
 		Wrappers for the latter ones.
 		These emit events.
@@ -196,6 +257,9 @@ public:
 	*/
 	bool addNodeWithEvent(v3s16 p, MapNode n, bool remove_metadata = true);
 	bool removeNodeWithEvent(v3s16 p);
+	// Emits a single MEET_OTHER event covering all modified blocks.
+	bool addNodesWithEvent(const std::vector<std::pair<v3s16, MapNode>> &nodes,
+			bool remove_metadata = true);
 
 	// Call these before and after saving of many blocks
 	virtual void beginSave() {}
@@ -215,6 +279,23 @@ public:
 	void timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 			std::vector<v3s16> *unloaded_blocks=NULL);
 
+	/*
+		Unloads blocks until the estimated in-memory footprint fits
+		budget_bytes, evicting the blocks farthest from any player
+		first; at equal distance clean blocks go before dirty ones
+		(which must be written out) and least recently used blocks go
+		first. Keeps RAM bounded under exploration, where the pure
+		timeout rule of timerUpdate() lets memory grow without limit.
+		Blocks in keep_blocks (active and forceloaded blocks, whose
+		objects' static data is not stored in the block) are never
+		evicted. Saves modified blocks before unloading on
+		MAPTYPE_SERVER.
+	*/
+	void evictBlocksOverBudget(u64 budget_bytes,
+			const std::vector<v3s16> &player_block_positions,
+			const std::set<v3s16> *keep_blocks=NULL,
+			std::vector<v3s16> *unloaded_blocks=NULL);
+
 	/*
 		Unloads all blocks with a zero refCount().
 		Saves modified blocks before unloading on MAPTYPE_SERVER.
@@ -269,7 +350,7 @@ public:
 	/*
 		Misc.
 	*/
-	std::map<v2s16, MapSector*> *getSectorsPtr(){return &m_sectors;}
+	std::unordered_map<v2s16, MapSector*, v2s16Hash> *getSectorsPtr(){return &m_sectors;}
 
 	/*
 		Variables
@@ -277,7 +358,32 @@ public:
 
 	void transforming_liquid_add(v3s16 p);
 
+	// Updates the player positions (in nodes) used to assign priority
+	// bands to newly queued liquid nodes
+	void transforming_liquid_set_players(const std::vector<v3s16> &positions)
+	{
+		m_transforming_liquid.setReferencePositions(positions);
+	}
+
+	// Drops a block from the settled-liquids cache so that it gets a
+	// reflow scan when it is next loaded. Called whenever a pending
+	// liquid update or a scan runs into the unloaded block.
+	void dropSettledLiquids(v3s16 blockpos) { m_reflow_settled.erase(blockpos); }
+
 	bool isBlockOccluded(MapBlock *block, v3s16 cam_pos_nodes);
+
+	// Incremented whenever blocks are added to or removed from the map.
+	// Lets caches of the loaded block set (e.g. the client draw list
+	// octree) detect that they need a rebuild.
+	u32 getBlockSetVersion() const { return m_block_set_version; }
+	void reportBlockSetChange() { m_block_set_version++; }
+
+	// Incremented whenever node contents change, so that per-frame caches
+	// of node lookups (e.g. LocalPlayer's movement node context) know when
+	// to refresh.  setNode() reports automatically; paths that write into
+	// blocks directly (network block data and deltas) report by hand.
+	u32 getNodesVersion() const { return m_nodes_version; }
+	void reportNodesChange() { m_nodes_version++; }
 protected:
 	friend class LuaVoxelManip;
 
@@ -287,14 +393,20 @@ protected:
 
 	std::set<MapEventReceiver*> m_event_receivers;
 
-	std::map<v2s16, MapSector*> m_sectors;
+	std::unordered_map<v2s16, MapSector*, v2s16Hash> m_sectors;
+
+	// Bumped on every block insertion/deletion, see getBlockSetVersion()
+	u32 m_block_set_version = 1;
 
-	// Be sure to set this to NULL when the cached sector is deleted
-	MapSector *m_sector_cache = nullptr;
-	v2s16 m_sector_cache_p;
+	// Bumped on every node content change, see getNodesVersion()
+	u32 m_nodes_version = 1;
 
 	// Queued transforming water nodes
-	UniqueQueue<v3s16> m_transforming_liquid;
+	LiquidTransformQueue m_transforming_liquid;
+
+	// Blocks whose liquids were known settled when they were unloaded;
+	// they skip the reflow scan when they are loaded again
+	std::set<v3s16> m_reflow_settled;
 
 	// This stores the properties of the nodes on the map.
 	const NodeDefManager *m_nodedef;
@@ -399,6 +511,26 @@ public:
 	void beginSave();
 	void endSave();
 
+	/*
+		Asynchronous write-behind saving. While the save thread runs,
+		saveBlock() only serializes the block and queues it; the thread
+		batches the database writes in the background.
+	*/
+	void startSaveThread();
+	// Stops the save thread and flushes everything still queued
+	void stopSaveThread();
+
+	/*
+		Speculative prefetch. queuePrefetch() hands block positions to a
+		background thread that reads their data from the database into a
+		small cache consumed by loadBlock(), so blocks predicted from
+		player movement don't cost synchronous reads in the send path.
+	*/
+	void startPrefetchThread();
+	void stopPrefetchThread();
+	// Server thread only. Blocks already in memory or cached are ignored.
+	void queuePrefetch(v3s16 p);
+
 	void save(ModifiedState save_level);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 	void listAllLoadedBlocks(std::vector<v3s16> &dst);
@@ -414,6 +546,27 @@ public:
 	// Database version
 	void loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool save_after_load=false);
 
+	/*
+		Two-phase loading for worker threads (see EmergeThread).
+		loadBlockData() and deserializeBlock() need no environment lock,
+		so several threads can read and decompress blocks in parallel;
+		insertLoadedBlock() attaches the finished block under the lock.
+	*/
+	// Fetches the serialized block data, trying the save queue, the
+	// prefetch cache and the database in that order
+	bool loadBlockData(v3s16 blockpos, std::string *blob);
+	// Deserializes into a detached block not yet part of the map.
+	// Returns nullptr on bad data (with ignore_world_load_errors).
+	MapBlock *deserializeBlock(v3s16 blockpos, std::string *blob);
+	// Takes ownership. Returns nullptr if the position was occupied in
+	// the meantime (the block is then deleted, not inserted).
+	MapBlock *insertLoadedBlock(MapBlock *block);
+
+	// Queues pending liquid updates for a freshly loaded block. The scan
+	// is skipped if the block's liquids were known settled when it was
+	// last unloaded and nothing around it changed in the meantime.
+	void scanLoadedBlockLiquids(MapBlock *block);
+
 	bool deleteBlock(v3s16 blockpos);
 
 	void updateVManip(v3s16 pos);
@@ -445,6 +598,10 @@ private:
 	std::string m_savedir;
 	bool m_map_saving_enabled;
 
+	// Cached at construction so the block load paths, which also run on
+	// the emerge threads, never have to take the settings mutex
+	bool m_ignore_world_load_errors;
+
 #if 0
 	// Chunk size in MapSectors
 	// If 0, chunks are disabled.
@@ -460,6 +617,54 @@ private:
 	bool m_map_metadata_changed = true;
 	MapDatabase *dbase = nullptr;
 	MapDatabase *dbase_ro = nullptr;
+
+	/*
+		Write-behind saving (see MapSaveThread in map.cpp).
+		Serialized blocks wait in m_save_pending until the save thread has
+		written them; loadBlock() services reads from there first so a
+		queued-but-unwritten block can never be re-read stale from disk.
+		The sequence number detects blocks re-queued while being written.
+	*/
+	friend class MapSaveThread;
+
+	struct PendingBlockSave
+	{
+		u32 seq;
+		std::string data;
+	};
+
+	// Serializes the block and hands it to the save thread
+	void queueBlockSave(MapBlock *block);
+	// Writes all currently pending blocks in one transaction
+	void writePendingBlocks();
+	bool saveThreadRunning();
+
+	MapSaveThread *m_save_thread = nullptr;
+	std::map<v3s16, PendingBlockSave> m_save_pending;
+	std::mutex m_save_pending_mutex;
+	u32 m_save_seq = 0;
+	Semaphore m_save_sem;
+	// Serializes all accesses to dbase between the save thread and the
+	// (env-locked) server and emerge threads
+	std::mutex m_dbase_mutex;
+
+	/*
+		Speculative prefetch (see MapPrefetchThread in map.cpp).
+		Blobs read ahead of time wait in m_prefetched until loadBlock()
+		consumes them; saveBlock() and deleteBlock() drop entries for
+		their position so a stale blob can never shadow newer data.
+	*/
+	friend class MapPrefetchThread;
+
+	// Reads a batch of blocks from the database into the prefetch cache
+	void prefetchBlocks(const std::vector<v3s16> &positions);
+
+	MapPrefetchThread *m_prefetch_thread = nullptr;
+	std::deque<v3s16> m_prefetch_queue;
+	std::mutex m_prefetch_queue_mutex;
+	Semaphore m_prefetch_sem;
+	std::map<v3s16, std::string> m_prefetched;
+	std::mutex m_prefetched_mutex;
 };
 
 
@@ -133,11 +133,8 @@ bool MapSettingsManager::saveMapMeta()
 
 	oss << "[end_of_params]\n";
 
-	if (!fs::safeWriteToFile(m_map_meta_path, oss.str())) {
-		errorstream << "saveMapMeta: could not write "
-			<< m_map_meta_path << std::endl;
-		return false;
-	}
+	// Queued on the shared writer thread; failures are logged there
+	fs::safeWriteToFileAsync(m_map_meta_path, oss.str());
 
 	return true;
 }
@@ -19,12 +19,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mapblock.h"
 
+#include <memory>
 #include <sstream>
 #include "map.h"
 #include "light.h"
 #include "nodedef.h"
 #include "nodemetadata.h"
 #include "gamedef.h"
+#include "itemgroup.h"
 #include "log.h"
 #include "nameidmapping.h"
 #include "content_mapnode.h" // For legacy name-id mapping
@@ -34,9 +36,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client/mapblock_mesh.h"
 #endif
 #include "porting.h"
+#include "profiler.h"
 #include "util/string.h"
 #include "util/serialize.h"
 #include "util/basic_macros.h"
+#include "util/memstats.h"
+#include "util/slab_arena.h"
 
 static const char *modified_reason_strings[] = {
 	"initial",
@@ -61,6 +66,37 @@ static const char *modified_reason_strings[] = {
 	"unknown",
 };
 
+/*
+	Node array arena
+*/
+
+static SlabArena g_node_arena(
+	sizeof(MapNode) * MapBlock::nodecount, 64);
+
+MapNode *allocNodeArray()
+{
+	static MemoryPool *pool = g_memstats->registerPool("mapblock_nodes");
+	static MemoryPool *arena_pool =
+			g_memstats->registerPool("mapblock_node_arena");
+
+	MapNode *data = (MapNode *)g_node_arena.alloc();
+	pool->add(sizeof(MapNode) * MapBlock::nodecount);
+	// Capacity only grows here, so sampling it here is enough
+	arena_pool->set(g_node_arena.getCapacityBytes());
+	g_profiler->avg("MapBlock: node arrays in use [#]",
+			g_node_arena.getUsedCount());
+	return data;
+}
+
+void freeNodeArray(MapNode *data)
+{
+	if (!data)
+		return;
+	static MemoryPool *pool = g_memstats->registerPool("mapblock_nodes");
+	g_node_arena.free(data);
+	pool->sub(sizeof(MapNode) * MapBlock::nodecount);
+}
+
 
 /*
 	MapBlock
@@ -78,14 +114,7 @@ MapBlock::MapBlock(Map *parent, v3s16 pos, IGameDef *gamedef, bool dummy):
 
 MapBlock::~MapBlock()
 {
-#ifndef SERVER
-	{
-		delete mesh;
-		mesh = nullptr;
-	}
-#endif
-
-	delete[] data;
+	freeNodeArray(data);
 }
 
 bool MapBlock::isValidPositionParent(v3s16 p)
@@ -102,13 +131,15 @@ MapNode MapBlock::getNodeParent(v3s16 p, bool *is_valid_position)
 	if (!isValidPosition(p))
 		return m_parent->getNode(getPosRelative() + p, is_valid_position);
 
-	if (!data) {
+	if (isDummy()) {
 		if (is_valid_position)
 			*is_valid_position = false;
 		return {CONTENT_IGNORE};
 	}
 	if (is_valid_position)
 		*is_valid_position = true;
+	if (m_homogeneous)
+		return m_homogeneous_node;
 	return data[p.Z * zstride + p.Y * ystride + p.X];
 }
 
@@ -134,11 +165,192 @@ std::string MapBlock::getModifiedReasonString()
 }
 
 
+bool MapBlock::compactIfHomogeneous()
+{
+	if (m_homogeneous)
+		return true;
+	if (!data)
+		return false;
+
+	const MapNode &first = data[0];
+	for (u32 i = 1; i < nodecount; i++) {
+		if (!(data[i] == first))
+			return false;
+	}
+
+	m_homogeneous_node = first;
+	m_homogeneous = true;
+	freeNodeArray(data);
+	data = nullptr;
+	return true;
+}
+
+void MapBlock::cacheContents()
+{
+	if (contents_cached || do_not_cache_contents)
+		return;
+	if (isDummy())
+		return;
+
+	contents.clear();
+	if (m_homogeneous) {
+		contents.insert(m_homogeneous_node.getContent());
+	} else {
+		for (u32 i = 0; i < nodecount; i++) {
+			contents.insert(data[i].getContent());
+			if (contents.size() > 64) {
+				// Too many different content types
+				// (same limit as the ABM scan uses)
+				do_not_cache_contents = true;
+				contents.clear();
+				return;
+			}
+		}
+	}
+	contents_cached = true;
+}
+
+void MapBlock::cacheCollisionBoxes()
+{
+	if (collision_cached)
+		return;
+
+	memset(collision_solid, 0, sizeof(collision_solid));
+	memset(collision_ignore, 0, sizeof(collision_ignore));
+	collision_special.clear();
+
+	if (isDummy()) {
+		// Everything collides like an unloaded node
+		memset(collision_ignore, 0xFF, sizeof(collision_ignore));
+		collision_cached = true;
+		return;
+	}
+
+	const NodeDefManager *nodedef = m_gamedef->ndef();
+	const aabb3f fullbox(-0.5f * BS, -0.5f * BS, -0.5f * BS,
+			0.5f * BS, 0.5f * BS, 0.5f * BS);
+
+	for (u32 i = 0; i < nodecount; i++) {
+		MapNode n = m_homogeneous ? m_homogeneous_node : data[i];
+		if (n.getContent() == CONTENT_IGNORE) {
+			collision_ignore[i / 32] |= 1U << (i % 32);
+			continue;
+		}
+		const ContentFeatures &f = nodedef->get(n);
+		if (!f.walkable)
+			continue;
+
+		NodeCollisionInfo info;
+		info.index = i;
+		info.bouncy = itemgroup_get(f.groups, "bouncy");
+		info.connected = f.drawtype == NDT_NODEBOX &&
+				f.node_box.type == NODEBOX_CONNECTED;
+		if (!info.connected) {
+			n.getCollisionBoxes(nodedef, &info.boxes, 0);
+			if (info.bouncy == 0 && info.boxes.size() == 1 &&
+					info.boxes[0].MinEdge == fullbox.MinEdge &&
+					info.boxes[0].MaxEdge == fullbox.MaxEdge) {
+				collision_solid[i / 32] |= 1U << (i % 32);
+				continue;
+			}
+		}
+		collision_special.push_back(std::move(info));
+	}
+	collision_cached = true;
+}
+
+void MapBlock::cachePathOpenFaces()
+{
+	if (path_faces_cached)
+		return;
+
+	path_open_faces = 0;
+
+	if (isDummy()) {
+		// Unknown content: all faces stay closed
+		path_faces_cached = true;
+		return;
+	}
+
+	const NodeDefManager *nodedef = m_gamedef->ndef();
+
+	if (m_homogeneous) {
+		MapNode n = m_homogeneous_node;
+		if (n.getContent() != CONTENT_IGNORE && !nodedef->get(n).walkable)
+			path_open_faces = 0x3F;
+		path_faces_cached = true;
+		return;
+	}
+
+	auto passable = [&] (s16 x, s16 y, s16 z) {
+		MapNode n = data[z * zstride + y * ystride + x];
+		return n.getContent() != CONTENT_IGNORE &&
+				!nodedef->get(n).walkable;
+	};
+
+	for (s16 a = 0; a < MAP_BLOCKSIZE && path_open_faces != 0x3F; a++)
+	for (s16 b = 0; b < MAP_BLOCKSIZE; b++) {
+		if (passable(MAP_BLOCKSIZE - 1, a, b))
+			path_open_faces |= PATH_FACE_XP;
+		if (passable(0, a, b))
+			path_open_faces |= PATH_FACE_XM;
+		if (passable(a, MAP_BLOCKSIZE - 1, b))
+			path_open_faces |= PATH_FACE_YP;
+		if (passable(a, 0, b))
+			path_open_faces |= PATH_FACE_YM;
+		if (passable(a, b, MAP_BLOCKSIZE - 1))
+			path_open_faces |= PATH_FACE_ZP;
+		if (passable(a, b, 0))
+			path_open_faces |= PATH_FACE_ZM;
+	}
+	path_faces_cached = true;
+}
+
+void MapBlock::updateLiquidColumns()
+{
+	const NodeDefManager *nodemgr = m_gamedef->ndef();
+
+	memset(liquid_columns, 0, sizeof(liquid_columns));
+	if (m_homogeneous) {
+		if (nodemgr->get(m_homogeneous_node).isLiquid())
+			memset(liquid_columns, 0xFF, sizeof(liquid_columns));
+		liquid_columns_cached = true;
+		return;
+	}
+	if (!data) {
+		// Dummy block; stays all zero
+		liquid_columns_cached = true;
+		return;
+	}
+
+	// Blocks contain long runs of identical nodes, so memoizing the last
+	// looked-up content avoids most of the ContentFeatures fetches
+	content_t prev_content = CONTENT_IGNORE;
+	bool prev_liquid = false;
+	for (u32 i = 0; i < nodecount; i++) {
+		content_t c = data[i].getContent();
+		if (c != prev_content) {
+			prev_content = c;
+			prev_liquid = nodemgr->get(c).isLiquid();
+		}
+		if (prev_liquid)
+			liquid_columns[i / zstride] |= 1 << (i % ystride);
+	}
+	liquid_columns_cached = true;
+}
+
 void MapBlock::copyTo(VoxelManipulator &dst)
 {
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
+	if (m_homogeneous) {
+		// A homogeneous block blits as a fill, no need to materialize
+		// the node array
+		dst.fill(m_homogeneous_node, getPosRelative(), data_size);
+		return;
+	}
+
 	// Copy from data to VoxelManipulator
 	dst.copyFrom(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
@@ -149,9 +361,46 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
+	materialize();
+
 	// Copy from VoxelManipulator to data
 	dst.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+
+	// Bulk rewrite; single changed nodes are not known
+	invalidateDeltaJournal();
+}
+
+bool MapBlock::getChangedNodesSince(u32 counter, std::vector<u16> &indices) const
+{
+	if (counter < m_delta_journal_base)
+		return false;
+
+	// The same node is often written repeatedly (e.g. light updates);
+	// only report it once
+	std::set<u16> seen;
+	for (u32 i = counter - m_delta_journal_base;
+			i < m_delta_journal.size(); i++) {
+		u16 index = m_delta_journal[i];
+		if (seen.insert(index).second)
+			indices.push_back(index);
+	}
+	return true;
+}
+
+bool MapBlock::contentsEqualTo(VoxelManipulator &dst)
+{
+	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
+	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
+
+	if (m_homogeneous)
+		return dst.equalsToUniform(m_homogeneous_node,
+				getPosRelative(), data_size);
+	if (!data)
+		return false;
+
+	return dst.equalsTo(data, data_area, v3s16(0,0,0),
+			getPosRelative(), data_size);
 }
 
 void MapBlock::actuallyUpdateDayNightDiff()
@@ -161,11 +410,34 @@ void MapBlock::actuallyUpdateDayNightDiff()
 	// Running this function un-expires m_day_night_differs
 	m_day_night_differs_expired = false;
 
+	if (m_homogeneous) {
+		MapNode n = m_homogeneous_node;
+		m_day_night_differs = n.getContent() != CONTENT_AIR
+				&& !n.isLightDayNightEq(nodemgr);
+		return;
+	}
+
 	if (!data) {
 		m_day_night_differs = false;
 		return;
 	}
 
+	// If the cached content summary proves no content in this block can
+	// carry differing day/night light, skip the node scan entirely
+	if (contents_cached) {
+		bool can_differ = false;
+		for (content_t c : contents) {
+			if (nodemgr->lightDayNightCanDiffer(c)) {
+				can_differ = true;
+				break;
+			}
+		}
+		if (!can_differ) {
+			m_day_night_differs = false;
+			return;
+		}
+	}
+
 	bool differs = false;
 
 	/*
@@ -180,9 +452,13 @@ void MapBlock::actuallyUpdateDayNightDiff()
 		if (n == previous_n)
 			continue;
 
-		differs = !n.isLightDayNightEq(nodemgr);
-		if (differs)
-			break;
+		// The packed per-content flag spares the ContentFeatures
+		// lookup for nodes that cannot differ at all
+		if (nodemgr->lightDayNightCanDiffer(n.getContent())) {
+			differs = !n.isLightDayNightEq(nodemgr);
+			if (differs)
+				break;
+		}
 		previous_n = n;
 	}
 
@@ -207,6 +483,41 @@ void MapBlock::actuallyUpdateDayNightDiff()
 	m_day_night_differs = differs;
 }
 
+void MapBlock::actuallyUpdateSolidOccluder()
+{
+	const NodeDefManager *nodemgr = m_gamedef->ndef();
+
+	m_solid_occluder_expired = false;
+
+	if (m_homogeneous) {
+		m_solid_occluder = nodemgr->get(m_homogeneous_node).solidness == 2;
+		return;
+	}
+
+	if (!data) {
+		m_solid_occluder = false;
+		return;
+	}
+
+	bool solid = true;
+	MapNode previous_n = data[0];
+	for (u32 i = 0; i < nodecount; i++) {
+		MapNode n = data[i];
+
+		// If node is identical to previous node, don't check it again
+		if (i > 0 && n == previous_n)
+			continue;
+
+		if (nodemgr->get(n).solidness != 2) {
+			solid = false;
+			break;
+		}
+		previous_n = n;
+	}
+
+	m_solid_occluder = solid;
+}
+
 void MapBlock::expireDayNightDiff()
 {
 	if (!data) {
@@ -355,16 +666,160 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 	}
 }
 
+/*
+	Bulk node data, serialization version >= 29.
+
+	Blocks usually contain few distinct contents and long runs of
+	identical nodes, so a per-block content palette plus run-length
+	encoding shrinks the data a lot before it even reaches the
+	compressor, and decodes with far less CPU than decompressing the flat
+	4-byte-per-node layout. The encoded buffer is zstd-compressed, which
+	is both faster and stronger than the zlib it replaces:
+
+	u8 marker: 0 = flat layout (as in version <= 28), 1 = palette + RLE
+	marker 1:
+		u16 palette_size
+		palette_size * u16 content id
+		u16 run_count
+		run_count * (u16 run_length, u16 palette_index,
+				u8 param1, u8 param2)
+*/
+static void serializeBulkPalette(std::ostream &os, const MapNode *nodes,
+		u32 nodecount)
+{
+	struct Run
+	{
+		u16 length;
+		u16 index;
+		u8 param1;
+		u8 param2;
+	};
+
+	// Build the content palette and the run list in one pass
+	std::vector<u16> palette;
+	std::unordered_map<content_t, u16> palette_indices;
+	std::vector<Run> runs;
+
+	for (u32 i = 0; i < nodecount; i++) {
+		const MapNode &n = nodes[i];
+		if (!runs.empty()) {
+			Run &r = runs.back();
+			if (palette[r.index] == n.param0 && r.param1 == n.param1
+					&& r.param2 == n.param2) {
+				r.length++;
+				continue;
+			}
+		}
+		u16 index;
+		auto it = palette_indices.find(n.param0);
+		if (it == palette_indices.end()) {
+			index = palette.size();
+			palette.push_back(n.param0);
+			palette_indices[n.param0] = index;
+		} else {
+			index = it->second;
+		}
+		runs.push_back({1, index, n.param1, n.param2});
+	}
+
+	std::ostringstream tmp(std::ios_base::binary);
+
+	u32 encoded_size = 1 + 2 + 2 * palette.size() + 2 + 6 * runs.size();
+	if (encoded_size < 1 + 4 * nodecount) {
+		writeU8(tmp, 1);
+		writeU16(tmp, palette.size());
+		for (u16 c : palette)
+			writeU16(tmp, c);
+		writeU16(tmp, runs.size());
+		for (const Run &r : runs) {
+			writeU16(tmp, r.length);
+			writeU16(tmp, r.index);
+			writeU8(tmp, r.param1);
+			writeU8(tmp, r.param2);
+		}
+	} else {
+		// Degenerate block; the flat layout is smaller
+		writeU8(tmp, 0);
+		for (u32 i = 0; i < nodecount; i++)
+			writeU16(tmp, nodes[i].param0);
+		for (u32 i = 0; i < nodecount; i++)
+			writeU8(tmp, nodes[i].param1);
+		for (u32 i = 0; i < nodecount; i++)
+			writeU8(tmp, nodes[i].param2);
+	}
+
+	compressZstd(tmp.str(), os);
+}
+
+static void deSerializeBulkPalette(std::istream &is, MapNode *nodes,
+		u32 nodecount)
+{
+	std::ostringstream os(std::ios_base::binary);
+	decompressZstd(is, os);
+	std::istringstream iss(os.str(), std::ios_base::binary);
+
+	u8 marker = readU8(iss);
+	if (marker == 0) {
+		for (u32 i = 0; i < nodecount; i++)
+			nodes[i].param0 = readU16(iss);
+		for (u32 i = 0; i < nodecount; i++)
+			nodes[i].param1 = readU8(iss);
+		for (u32 i = 0; i < nodecount; i++)
+			nodes[i].param2 = readU8(iss);
+	} else if (marker == 1) {
+		u16 palette_size = readU16(iss);
+		std::vector<u16> palette(palette_size);
+		for (u16 i = 0; i < palette_size; i++)
+			palette[i] = readU16(iss);
+
+		u16 run_count = readU16(iss);
+		u32 i = 0;
+		for (u16 r = 0; r < run_count; r++) {
+			u16 length = readU16(iss);
+			u16 index = readU16(iss);
+			u8 param1 = readU8(iss);
+			u8 param2 = readU8(iss);
+			if (index >= palette_size || i + length > nodecount)
+				throw SerializationError("deSerializeBulkPalette: "
+						"invalid run");
+			MapNode n(palette[index], param1, param2);
+			for (u16 j = 0; j < length; j++)
+				nodes[i++] = n;
+		}
+		if (i != nodecount)
+			throw SerializationError("deSerializeBulkPalette: "
+					"runs do not cover the block");
+	} else {
+		throw SerializationError("deSerializeBulkPalette: "
+				"unknown node data marker");
+	}
+
+	if (iss.eof() || iss.fail())
+		throw SerializationError("deSerializeBulkPalette: "
+				"failed to read bulk node data");
+}
+
 void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
 
-	if (!data)
+	if (isDummy())
 		throw SerializationError("ERROR: Not writing dummy block.");
 
 	FATAL_ERROR_IF(version < SER_FMT_VER_LOWEST_WRITE, "Serialisation version error");
 
+	// A homogeneous block is expanded into a transient array for the
+	// writer; the compact in-memory representation is kept.
+	std::unique_ptr<MapNode[]> expanded;
+	MapNode *nodes = data;
+	if (m_homogeneous) {
+		expanded.reset(new MapNode[nodecount]);
+		for (u32 i = 0; i < nodecount; i++)
+			expanded[i] = m_homogeneous_node;
+		nodes = expanded.get();
+	}
+
 	// First byte
 	u8 flags = 0;
 	if(is_underground)
@@ -386,15 +841,18 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
 	{
 		MapNode *tmp_nodes = new MapNode[nodecount];
 		for(u32 i=0; i<nodecount; i++)
-			tmp_nodes[i] = data[i];
+			tmp_nodes[i] = nodes[i];
 		getBlockNodeIdMapping(&nimap, tmp_nodes, m_gamedef->ndef());
 
 		u8 content_width = 2;
 		u8 params_width = 2;
 		writeU8(os, content_width);
 		writeU8(os, params_width);
-		MapNode::serializeBulk(os, version, tmp_nodes, nodecount,
-				content_width, params_width, true);
+		if (version >= 29)
+			serializeBulkPalette(os, tmp_nodes, nodecount);
+		else
+			MapNode::serializeBulk(os, version, tmp_nodes, nodecount,
+					content_width, params_width, true);
 		delete[] tmp_nodes;
 	}
 	else
@@ -403,8 +861,11 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
 		u8 params_width = 2;
 		writeU8(os, content_width);
 		writeU8(os, params_width);
-		MapNode::serializeBulk(os, version, data, nodecount,
-				content_width, params_width, true);
+		if (version >= 29)
+			serializeBulkPalette(os, nodes, nodecount);
+		else
+			MapNode::serializeBulk(os, version, nodes, nodecount,
+					content_width, params_width, true);
 	}
 
 	/*
@@ -442,7 +903,7 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
 
 void MapBlock::serializeNetworkSpecific(std::ostream &os)
 {
-	if (!data) {
+	if (isDummy()) {
 		throw SerializationError("ERROR: Not writing dummy block.");
 	}
 
@@ -457,6 +918,10 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())<<std::endl);
 
 	m_day_night_differs_expired = false;
+	m_solid_occluder_expired = true;
+
+	// The whole node array is replaced
+	invalidateDeltaJournal();
 
 	if(version <= 21)
 	{
@@ -484,8 +949,14 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 		throw SerializationError("MapBlock::deSerialize(): invalid content_width");
 	if(params_width != 2)
 		throw SerializationError("MapBlock::deSerialize(): invalid params_width");
-	MapNode::deSerializeBulk(is, version, data, nodecount,
-			content_width, params_width, true);
+	// The block may currently be a dummy or stored compactly
+	if (!data)
+		reallocate();
+	if (version >= 29)
+		deSerializeBulkPalette(is, data, nodecount);
+	else
+		MapNode::deSerializeBulk(is, version, data, nodecount,
+				content_width, params_width, true);
 
 	/*
 		NodeMetadata
@@ -550,6 +1021,10 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 		}
 	}
 
+	// Most loaded blocks are pure air or solid stone; store those
+	// compactly until something writes to them
+	compactIfHomogeneous();
+
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 			<<": Done."<<std::endl);
 }
@@ -568,6 +1043,33 @@ void MapBlock::deSerializeNetworkSpecific(std::istream &is)
 	}
 }
 
+void MapBlock::absorbDecoded(MapBlock *src)
+{
+	assert(src->m_pos == m_pos); // Pre-condition
+
+	// Node data and metadata are swapped, so the old contents are
+	// released when the source block is deleted
+	std::swap(data, src->data);
+	std::swap(m_homogeneous, src->m_homogeneous);
+	std::swap(m_homogeneous_node, src->m_homogeneous_node);
+	m_node_metadata.swap(src->m_node_metadata);
+
+	is_underground = src->is_underground;
+	m_lighting_complete = src->m_lighting_complete;
+	m_day_night_differs = src->m_day_night_differs;
+	m_day_night_differs_expired = src->m_day_night_differs_expired;
+	m_generated = src->m_generated;
+	m_solid_occluder_expired = true;
+
+	// The whole node array was replaced
+	invalidateDeltaJournal();
+	contents_cached = false;
+	abm_candidates.clear();
+	liquid_columns_cached = false;
+	reflow_settled = false;
+	collision_cached = false;
+}
+
 /*
 	Legacy serialization
 */
@@ -690,6 +1192,8 @@ void MapBlock::deSerialize_pre22(std::istream &is, u8 version, bool disk)
 	}
 
 	// Deserialize node data
+	if (!data)
+		reallocate();
 	for (u32 i = 0; i < nodecount; i++) {
 		data[i].deSerialize(&databuf_nodelist[i * ser_length], version);
 	}
@@ -20,6 +20,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <set>
+#include <unordered_map>
+#include <memory>
+#include <vector>
 #include "irr_v3d.h"
 #include "mapnode.h"
 #include "exceptions.h"
@@ -32,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "mapgen/mapgen.h"
 
+class ActiveBlockModifier;
 class Map;
 class NodeMetadataList;
 class IGameDef;
@@ -70,6 +74,15 @@ class VoxelManipulator;
 //// MapBlock itself
 ////
 
+/*
+	Node arrays are all the same size and churn constantly as blocks load
+	and unload, so they come from a dedicated slab arena instead of the
+	general allocator: recycling is O(1) and multi-day uptimes don't
+	fragment the heap. The returned memory is uninitialized.
+*/
+MapNode *allocNodeArray();
+void freeNodeArray(MapNode *data);
+
 class MapBlock
 {
 public:
@@ -88,16 +101,57 @@ public:
 
 	void reallocate()
 	{
-		delete[] data;
-		data = new MapNode[nodecount];
+		freeNodeArray(data);
+		data = allocNodeArray();
 		for (u32 i = 0; i < nodecount; i++)
 			data[i] = MapNode(CONTENT_IGNORE);
+		m_homogeneous = false;
+		invalidateDeltaJournal();
 
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
+	/*
+		Expands the compact homogeneous representation back into a full
+		node array. Not a content change, so the modified flag is left
+		alone.
+	*/
+	void materialize()
+	{
+		if (!m_homogeneous)
+			return;
+		freeNodeArray(data);
+		data = allocNodeArray();
+		for (u32 i = 0; i < nodecount; i++)
+			data[i] = m_homogeneous_node;
+		m_homogeneous = false;
+	}
+
+	/*
+		If every node in the block is identical, drops the node array and
+		keeps the single node instead; the array is re-materialized on
+		first write. Returns true if the block is stored compactly.
+	*/
+	bool compactIfHomogeneous();
+
+	inline bool isHomogeneous() const
+	{
+		return m_homogeneous;
+	}
+
+	// Approximate heap footprint of this block, used by the
+	// memory-budgeted unloader (Map::evictBlocksOverBudget)
+	inline size_t getMemoryUsage() const
+	{
+		size_t size = sizeof(MapBlock);
+		if (!m_homogeneous)
+			size += nodecount * sizeof(MapNode);
+		return size;
+	}
+
 	MapNode* getData()
 	{
+		materialize();
 		return data;
 	}
 
@@ -114,8 +168,16 @@ public:
 		} else if (mod == m_modified) {
 			m_modified_reason |= reason;
 		}
-		if (mod == MOD_STATE_WRITE_NEEDED)
+		if (mod == MOD_STATE_WRITE_NEEDED) {
+			change_counter++;
 			contents_cached = false;
+			abm_candidates.clear();
+			collision_cached = false;
+			path_faces_cached = false;
+			liquid_columns_cached = false;
+			reflow_settled = false;
+			m_solid_occluder_expired = true;
+		}
 	}
 
 	inline u32 getModified()
@@ -142,7 +204,7 @@ public:
 
 	inline bool isDummy()
 	{
-		return !data;
+		return !data && !m_homogeneous;
 	}
 
 	inline void unDummify()
@@ -242,7 +304,7 @@ public:
 
 	inline bool isValidPosition(s16 x, s16 y, s16 z)
 	{
-		return data
+		return !isDummy()
 			&& x >= 0 && x < MAP_BLOCKSIZE
 			&& y >= 0 && y < MAP_BLOCKSIZE
 			&& z >= 0 && z < MAP_BLOCKSIZE;
@@ -260,6 +322,9 @@ public:
 		if (!*valid_position)
 			return {CONTENT_IGNORE};
 
+		if (m_homogeneous)
+			return m_homogeneous_node;
+
 		return data[z * zstride + y * ystride + x];
 	}
 
@@ -279,7 +344,9 @@ public:
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
+		materialize();
 		data[z * zstride + y * ystride + x] = n;
+		recordChangedNode(z * zstride + y * ystride + x);
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -294,10 +361,13 @@ public:
 
 	inline MapNode getNodeNoCheck(s16 x, s16 y, s16 z, bool *valid_position)
 	{
-		*valid_position = data != nullptr;
+		*valid_position = !isDummy();
 		if (!*valid_position)
 			return {CONTENT_IGNORE};
 
+		if (m_homogeneous)
+			return m_homogeneous_node;
+
 		return data[z * zstride + y * ystride + x];
 	}
 
@@ -314,6 +384,9 @@ public:
 
 	inline const MapNode &getNodeUnsafe(s16 x, s16 y, s16 z)
 	{
+		if (m_homogeneous)
+			return m_homogeneous_node;
+
 		return data[z * zstride + y * ystride + x];
 	}
 
@@ -324,10 +397,12 @@ public:
 
 	inline void setNodeNoCheck(s16 x, s16 y, s16 z, MapNode & n)
 	{
+		materialize();
 		if (!data)
 			throw InvalidPositionException();
 
 		data[z * zstride + y * ystride + x] = n;
+		recordChangedNode(z * zstride + y * ystride + x);
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE_NO_CHECK);
 	}
 
@@ -336,6 +411,32 @@ public:
 		setNodeNoCheck(p.X, p.Y, p.Z, n);
 	}
 
+	////
+	//// Change journal for delta block sending
+	////
+
+	// Value identifying the current content of the block. A client that
+	// received the block at counter c can be brought up to date by the
+	// nodes recorded since c.
+	inline u32 getChangeCounter() const
+	{
+		return m_delta_journal_base + m_delta_journal.size();
+	}
+
+	// Forgets all recorded changes; getChangedNodesSince() fails for all
+	// earlier counter values afterwards. Called on bulk rewrites where
+	// tracking single nodes is pointless.
+	inline void invalidateDeltaJournal()
+	{
+		m_delta_journal_base += m_delta_journal.size() + 1;
+		m_delta_journal.clear();
+	}
+
+	// Collects the indices of nodes changed since the given change counter
+	// value, without duplicates. Returns false if the journal does not
+	// reach back that far; the caller has to fall back to the full block.
+	bool getChangedNodesSince(u32 counter, std::vector<u16> &indices) const;
+
 	// These functions consult the parent container if the position
 	// is not valid on this MapBlock.
 	bool isValidPositionParent(v3s16 p);
@@ -356,6 +457,10 @@ public:
 	// Copies data from VoxelManipulator getPosRelative()
 	void copyFrom(VoxelManipulator &dst);
 
+	// Returns true if copyFrom(dst) would not change this block, i.e.
+	// the manipulator never wrote into the block's area
+	bool contentsEqualTo(VoxelManipulator &dst);
+
 	// Update day-night lighting difference flag.
 	// Sets m_day_night_differs to appropriate value.
 	// These methods don't care about neighboring blocks.
@@ -372,6 +477,19 @@ public:
 		return m_day_night_differs;
 	}
 
+	// Update the cached solid-occluder flag.
+	// The block is a solid occluder when every node in it is a fully
+	// opaque normal cube, so the renderer may treat the whole block
+	// as an opaque box for occlusion culling purposes.
+	void actuallyUpdateSolidOccluder();
+
+	inline bool isSolidOccluder()
+	{
+		if (m_solid_occluder_expired)
+			actuallyUpdateSolidOccluder();
+		return m_solid_occluder;
+	}
+
 	////
 	//// Miscellaneous stuff
 	////
@@ -489,6 +607,12 @@ public:
 
 	void serializeNetworkSpecific(std::ostream &os);
 	void deSerializeNetworkSpecific(std::istream &is);
+
+	// Takes over the contents of a block that was deserialized into a
+	// detached MapBlock (e.g. by a decode worker thread). This pointer
+	// stays stable for everything referencing the block; the source is
+	// left holding the old contents and should be deleted.
+	void absorbDecoded(MapBlock *src);
 private:
 	/*
 		Private methods
@@ -505,6 +629,7 @@ private:
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
+		materialize();
 		return data[z * zstride + y * ystride + x];
 	}
 
@@ -519,7 +644,9 @@ public:
 	*/
 
 #ifndef SERVER // Only on client
-	MapBlockMesh *mesh = nullptr;
+	// Shared because geometrically identical blocks may reference one
+	// deduplicated mesh (see MeshUpdateThread)
+	std::shared_ptr<MapBlockMesh> mesh;
 #endif
 
 	NodeMetadataList m_node_metadata;
@@ -539,6 +666,97 @@ public:
 	// True if we never want to cache content types for this block
 	bool do_not_cache_contents = false;
 
+	// Ensure the content type cache is filled, scanning the node array
+	// if necessary. Blocks with very many distinct contents stay
+	// uncached (see do_not_cache_contents).
+	void cacheContents();
+
+	// Returns false only if the block provably contains none of the
+	// given content types. Lets area queries skip whole blocks.
+	bool mayContainContent(const std::vector<content_t> &list) const
+	{
+		if (!contents_cached)
+			return true;
+		for (content_t c : list) {
+			if (contents.find(c) != contents.end())
+				return true;
+		}
+		return false;
+	}
+	// Cached ABM candidate node indices (indices into the node data
+	// array), keyed by the ABM they belong to. Invalidated together with
+	// the content type cache.
+	std::unordered_map<ActiveBlockModifier *, std::vector<u16>> abm_candidates;
+
+	//// Collision optimizations ////
+	struct NodeCollisionInfo {
+		// Index into the node data array
+		u16 index;
+		// Value of the "bouncy" group
+		s32 bouncy;
+		// NODEBOX_CONNECTED: the boxes depend on neighbor nodes and
+		// must be computed at query time instead
+		bool connected;
+		// Node-relative collision boxes, in BS units
+		std::vector<aabb3f> boxes;
+	};
+	// Bit (i % 32) of collision_solid[i / 32] is set if node i is
+	// walkable with a single full-cube collision box and no "bouncy"
+	// group; such nodes need no entry in collision_special.
+	u32 collision_solid[nodecount / 32];
+	// Bits for CONTENT_IGNORE nodes, which collide like unloaded ones
+	u32 collision_ignore[nodecount / 32];
+	// Walkable nodes not covered by collision_solid, sorted by index
+	std::vector<NodeCollisionInfo> collision_special;
+	// True if the above matches the node data
+	bool collision_cached = false;
+
+	// Ensure the collision box cache is filled, shared by all objects
+	// moving through this block. Invalidated on modification like the
+	// other caches.
+	void cacheCollisionBoxes();
+
+	//// Pathfinder optimizations ////
+	// Incremented whenever the block content changes. Lets consumers
+	// (e.g. the path cache in pathfinder.cpp) cheaply detect that data
+	// derived from this block has gone stale.
+	u32 change_counter = 0;
+
+	// Face bits for path_open_faces
+	enum {
+		PATH_FACE_XP = 1 << 0,
+		PATH_FACE_XM = 1 << 1,
+		PATH_FACE_YP = 1 << 2,
+		PATH_FACE_YM = 1 << 3,
+		PATH_FACE_ZP = 1 << 4,
+		PATH_FACE_ZM = 1 << 5,
+	};
+	// Bit d is set if the respective block face contains at least one
+	// non-walkable (passable) node. This makes up the block-level
+	// abstraction graph the hierarchical pathfinder searches first.
+	u8 path_open_faces = 0;
+	// True if path_open_faces matches the node data
+	bool path_faces_cached = false;
+
+	// Ensure path_open_faces is filled. Invalidated on modification
+	// like the other caches.
+	void cachePathOpenFaces();
+
+	//// Liquid reflow optimizations ////
+	// Per-column liquid presence: bit x of liquid_columns[z] is set if
+	// the column (x, z) contains at least one liquid node. Lets ReflowScan
+	// jump straight to candidate columns.
+	u16 liquid_columns[MAP_BLOCKSIZE];
+	// True if liquid_columns matches the node data
+	bool liquid_columns_cached = false;
+	// True if the last reflow scan of this block queued nothing and no
+	// node was modified since; such blocks can skip the scan when they
+	// are unloaded and loaded again.
+	bool reflow_settled = false;
+
+	// Rebuilds liquid_columns from the node data
+	void updateLiquidColumns();
+
 private:
 	/*
 		Private member variables
@@ -560,11 +778,38 @@ private:
 	IGameDef *m_gamedef;
 
 	/*
-		If NULL, block is a dummy block.
+		If NULL, block is a dummy block unless m_homogeneous is set.
 		Dummy blocks are used for caching not-found-on-disk blocks.
 	*/
 	MapNode *data = nullptr;
 
+	/*
+		Compact representation for blocks where every node is identical
+		(pure air, solid stone, ...). While m_homogeneous is set, data is
+		NULL and m_homogeneous_node stands in for all nodecount nodes;
+		the array is re-materialized on first write.
+	*/
+	bool m_homogeneous = false;
+	MapNode m_homogeneous_node = MapNode(CONTENT_IGNORE);
+
+	/*
+		Journal of node writes (indices into data) since
+		m_delta_journal_base, oldest first. Bounded: once a block collects
+		more changes than a delta could reasonably carry, the journal is
+		invalidated and full sends take over.
+	*/
+	static const u32 DELTA_JOURNAL_MAX_SIZE = 192;
+	std::vector<u16> m_delta_journal;
+	u32 m_delta_journal_base = 0;
+
+	inline void recordChangedNode(u32 index)
+	{
+		if (m_delta_journal.size() >= DELTA_JOURNAL_MAX_SIZE)
+			invalidateDeltaJournal();
+		else
+			m_delta_journal.push_back(index);
+	}
+
 	/*
 		- On the server, this is used for telling whether the
 		  block has been modified from the one on disk.
@@ -597,6 +842,10 @@ private:
 	bool m_day_night_differs = false;
 	bool m_day_night_differs_expired = true;
 
+	// Whether all nodes are fully opaque cubes, see isSolidOccluder()
+	bool m_solid_occluder = false;
+	bool m_solid_occluder_expired = true;
+
 	bool m_generated = false;
 
 	/*
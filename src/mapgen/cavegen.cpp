@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "util/numeric.h"
+#include <algorithm>
 #include <cmath>
 #include "map.h"
 #include "mapgen.h"
@@ -58,6 +59,8 @@ CavesNoiseIntersection::CavesNoiseIntersection(
 	// re-carving the solid overtop placed for blocking sunlight
 	noise_cave1 = new Noise(np_cave1, seed, m_csize.X, m_csize.Y + 1, m_csize.Z);
 	noise_cave2 = new Noise(np_cave2, seed, m_csize.X, m_csize.Y + 1, m_csize.Z);
+
+	m_carve_buf = new u8[m_csize.X * (m_csize.Y + 1) * m_csize.Z];
 }
 
 
@@ -65,6 +68,8 @@ CavesNoiseIntersection::~CavesNoiseIntersection()
 {
 	delete noise_cave1;
 	delete noise_cave2;
+
+	delete[] m_carve_buf;
 }
 
 
@@ -77,6 +82,17 @@ void CavesNoiseIntersection::generateCaves(MMVManip *vm,
 	noise_cave1->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 	noise_cave2->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 
+	// Decide the intersection test for all noise cells in one branch-free
+	// bulk pass.  contour(v) equals max(0, 1 - |v|), so the whole test
+	// reduces to compare-and-mask operations the compiler can vectorize,
+	// and the column loop below is left with a cheap table lookup per node.
+	u32 carve_count = (u32)m_csize.X * (m_csize.Y + 1) * m_csize.Z;
+	for (u32 i = 0; i < carve_count; i++) {
+		float d1 = std::max(0.0f, 1.0f - std::fabs(noise_cave1->result[i]));
+		float d2 = std::max(0.0f, 1.0f - std::fabs(noise_cave2->result[i]));
+		m_carve_buf[i] = d1 * d2 > m_cave_width;
+	}
+
 	const v3s16 &em = vm->m_area.getExtent();
 	u32 index2d = 0;  // Biomemap index
 
@@ -120,10 +136,7 @@ void CavesNoiseIntersection::generateCaves(MMVManip *vm,
 			}
 
 			// Ground
-			float d1 = contour(noise_cave1->result[index3d]);
-			float d2 = contour(noise_cave2->result[index3d]);
-
-			if (d1 * d2 > m_cave_width && m_ndef->get(c).is_ground_content) {
+			if (m_carve_buf[index3d] && m_ndef->get(c).is_ground_content) {
 				// In tunnel and ground content, excavate
 				vm->m_data[vi] = MapNode(CONTENT_AIR);
 				is_under_tunnel = true;
@@ -60,6 +60,10 @@ private:
 
 	Noise *noise_cave1;
 	Noise *noise_cave2;
+
+	// Carve bitmap computed in bulk from the two noise maps; one entry per
+	// noise cell, nonzero where the intersection test says "tunnel"
+	u8 *m_carve_buf;
 };
 
 /*
@@ -292,18 +292,125 @@ s16 Mapgen::findLiquidSurface(v2s16 p2d, s16 ymin, s16 ymax)
 }
 
 
+/*
+ * Vectorized kernels for the chunk-wide column scans (the heightmap
+ * surface search and sunlight propagation).  Both passes spend nearly
+ * all of their time classifying nodes, so they walk the chunk in
+ * contiguous x rows and classify 8 nodes per step through the dense
+ * per-content tables built by buildContentLUTs(); only the (rare)
+ * columns that actually change state are handed back to scalar code.
+ * AVX2 is detected at runtime; anything else takes the scalar rows.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define MAPGEN_HAVE_AVX2 1
+#include <immintrin.h>
+
+static bool cpuHasAvx2()
+{
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	return has_avx2;
+}
+
+// Returns a bitmask (lane i -> bit i) of which of the 8 nodes at 'row'
+// have a nonzero entry in 'lut', a table indexed by content ID and
+// padded so its 4-byte gathers cannot read past the end
+__attribute__((target("avx2")))
+static inline u32 classifyNodes8Avx2(const MapNode *row, const u8 *lut)
+{
+	static_assert(sizeof(MapNode) == 4, "MapNode must pack into 32 bits");
+	__m256i nodes = _mm256_loadu_si256((const __m256i *)row);
+	__m256i content = _mm256_and_si256(nodes, _mm256_set1_epi32(0xFFFF));
+	__m256i flags = _mm256_i32gather_epi32((const int *)lut, content, 1);
+	flags = _mm256_and_si256(flags, _mm256_set1_epi32(0xFF));
+	__m256i nz = _mm256_cmpgt_epi32(flags, _mm256_setzero_si256());
+	return _mm256_movemask_ps(_mm256_castsi256_ps(nz));
+}
+
+// Sets param1 = LIGHT_SUN on 8 consecutive nodes (param1 is byte 2 of
+// the packed node)
+__attribute__((target("avx2")))
+static inline void setSunlight8Avx2(MapNode *row)
+{
+	__m256i nodes = _mm256_loadu_si256((const __m256i *)row);
+	nodes = _mm256_or_si256(
+		_mm256_and_si256(nodes, _mm256_set1_epi32((int)0xFF00FFFF)),
+		_mm256_set1_epi32(LIGHT_SUN << 16));
+	_mm256_storeu_si256((__m256i *)row, nodes);
+}
+#endif
+
+
+void Mapgen::buildContentLUTs()
+{
+	if (!m_walkable_lut.empty())
+		return;
+
+	// One entry per possible content ID, so lookups (and the gathers of
+	// the AVX2 kernel) need no range check; IDs that are not registered
+	// resolve to CONTENT_UNKNOWN exactly as in NodeDefManager::get().
+	// The extra 4 bytes keep the 4-byte gathers in bounds at the end.
+	const u32 lut_size = 0x10000;
+	m_walkable_lut.resize(lut_size + 4, 0);
+	m_sunlight_lut.resize(lut_size + 4, 0);
+	for (u32 c = 0; c < lut_size; c++) {
+		const ContentFeatures &f = ndef->get((content_t)c);
+		m_walkable_lut[c] = f.walkable;
+		m_sunlight_lut[c] = f.sunlight_propagates;
+	}
+}
+
+
 void Mapgen::updateHeightmap(v3s16 nmin, v3s16 nmax)
 {
 	if (!heightmap)
 		return;
 
 	//TimeTaker t("Mapgen::updateHeightmap", NULL, PRECISION_MICRO);
-	int index = 0;
-	for (s16 z = nmin.Z; z <= nmax.Z; z++) {
-		for (s16 x = nmin.X; x <= nmax.X; x++, index++) {
-			s16 y = findGroundLevel(v2s16(x, z), nmin.Y, nmax.Y);
-
-			heightmap[index] = y;
+	buildContentLUTs();
+	const u8 *walkable_lut = m_walkable_lut.data();
+	const v3s16 &em = vm->m_area.getExtent();
+	const u32 sx = nmax.X - nmin.X + 1;
+#ifdef MAPGEN_HAVE_AVX2
+	const bool use_avx2 = cpuHasAvx2();
+#endif
+
+	s16 *hrow = heightmap;
+	for (s16 z = nmin.Z; z <= nmax.Z; z++, hrow += sx) {
+		for (u32 xi = 0; xi < sx; xi++)
+			hrow[xi] = -MAX_MAP_GENERATION_LIMIT;
+		u32 unresolved = sx;
+
+		// Top-down over contiguous x rows: every column keeps the first
+		// (highest) walkable node it meets, exactly like the old
+		// node-by-node findGroundLevel() walk
+		u32 row_i = vm->m_area.index(nmin.X, nmax.Y, z);
+		for (s16 y = nmax.Y; y >= nmin.Y && unresolved > 0; y--) {
+			const MapNode *row = &vm->m_data[row_i];
+			u32 xi = 0;
+#ifdef MAPGEN_HAVE_AVX2
+			if (use_avx2) {
+				for (; xi + 8 <= sx; xi += 8) {
+					u32 mask = classifyNodes8Avx2(row + xi, walkable_lut);
+					while (mask) {
+						u32 bit = __builtin_ctz(mask);
+						mask &= mask - 1;
+						if (hrow[xi + bit] == -MAX_MAP_GENERATION_LIMIT) {
+							hrow[xi + bit] = y;
+							unresolved--;
+						}
+					}
+				}
+			}
+#endif
+			for (; xi < sx; xi++) {
+				if (hrow[xi] == -MAX_MAP_GENERATION_LIMIT &&
+						walkable_lut[row[xi].getContent()]) {
+					hrow[xi] = y;
+					unresolved--;
+				}
+			}
+			row_i -= em.X; // VoxelArea::add_y(em, i, -1), for a whole row
 		}
 	}
 }
@@ -425,14 +532,13 @@ void Mapgen::setLighting(u8 light, v3s16 nmin, v3s16 nmax)
 {
 	ScopeProfiler sp(g_profiler, "EmergeThread: update lighting", SPT_AVG);
 	VoxelArea a(nmin, nmax);
+	const u32 sx = a.getExtent().X;
 
-	for (int z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++) {
-		for (int y = a.MinEdge.Y; y <= a.MaxEdge.Y; y++) {
-			u32 i = vm->m_area.index(a.MinEdge.X, y, z);
-			for (int x = a.MinEdge.X; x <= a.MaxEdge.X; x++, i++)
-				vm->m_data[i].param1 = light;
-		}
-	}
+	vm->m_area.forEachXRow(a, [&](u32 i, s16 y, s16 z) {
+		MapNode *row = &vm->m_data[i];
+		for (u32 xi = 0; xi < sx; xi++)
+			row[xi].param1 = light;
+	});
 }
 
 
@@ -493,67 +599,188 @@ void Mapgen::propagateSunlight(v3s16 nmin, v3s16 nmax, bool propagate_shadow)
 	VoxelArea a(nmin, nmax);
 	bool block_is_underground = (water_level >= nmax.Y);
 	const v3s16 &em = vm->m_area.getExtent();
+	const u32 sx = a.getExtent().X;
+
+	buildContentLUTs();
+	const u8 *sunlight_lut = m_sunlight_lut.data();
+#ifdef MAPGEN_HAVE_AVX2
+	const bool use_avx2 = cpuHasAvx2();
+#endif
 
 	// NOTE: Direct access to the low 4 bits of param1 is okay here because,
 	// by definition, sunlight will never be in the night lightbank.
 
-	for (int z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++) {
-		for (int x = a.MinEdge.X; x <= a.MaxEdge.X; x++) {
-			// see if we can get a light value from the overtop
-			u32 i = vm->m_area.index(x, a.MaxEdge.Y + 1, z);
-			if (vm->m_data[i].getContent() == CONTENT_IGNORE) {
-				if (block_is_underground)
-					continue;
-			} else if ((vm->m_data[i].param1 & 0x0F) != LIGHT_SUN &&
-					propagate_shadow) {
-				continue;
+	// All columns of a z row march downwards together, so every y step
+	// touches one contiguous x row of nodes.  Each z row only reads and
+	// writes its own column of the volume, so the rows are independent and
+	// the Z range can be split over the thread pool.
+	a.forEachZSlab([&](s16 z_min, s16 z_max) {
+	std::vector<u8> sunlit(sx);
+	for (int z = z_min; z <= z_max; z++) {
+		// See which columns get a light value from the overtop
+		u32 lit_count = 0;
+		u32 row_i = vm->m_area.index(a.MinEdge.X, a.MaxEdge.Y + 1, z);
+		{
+			const MapNode *row = &vm->m_data[row_i];
+			for (u32 xi = 0; xi < sx; xi++) {
+				bool lit;
+				if (row[xi].getContent() == CONTENT_IGNORE)
+					lit = !block_is_underground;
+				else
+					lit = (row[xi].param1 & 0x0F) == LIGHT_SUN ||
+						!propagate_shadow;
+				sunlit[xi] = lit;
+				lit_count += lit;
 			}
-			VoxelArea::add_y(em, i, -1);
+		}
 
-			for (int y = a.MaxEdge.Y; y >= a.MinEdge.Y; y--) {
-				MapNode &n = vm->m_data[i];
-				if (!ndef->get(n).sunlight_propagates)
-					break;
-				n.param1 = LIGHT_SUN;
-				VoxelArea::add_y(em, i, -1);
+		// A column goes (and stays) dark at its first node that does not
+		// propagate sunlight
+		for (int y = a.MaxEdge.Y; y >= a.MinEdge.Y && lit_count > 0; y--) {
+			row_i -= em.X;
+			MapNode *row = &vm->m_data[row_i];
+			u32 xi = 0;
+#ifdef MAPGEN_HAVE_AVX2
+			if (use_avx2) {
+				for (; xi + 8 <= sx; xi += 8) {
+					u32 smask = 0;
+					for (u32 b = 0; b < 8; b++)
+						smask |= (u32)(sunlit[xi + b] != 0) << b;
+					if (smask == 0)
+						continue;
+
+					u32 pmask = classifyNodes8Avx2(row + xi, sunlight_lut);
+					u32 lit = smask & pmask;
+					if (lit == 0xFF) {
+						setSunlight8Avx2(row + xi);
+					} else {
+						while (lit) {
+							u32 bit = __builtin_ctz(lit);
+							lit &= lit - 1;
+							row[xi + bit].param1 = LIGHT_SUN;
+						}
+					}
+
+					u32 dark = smask & ~pmask;
+					while (dark) {
+						u32 bit = __builtin_ctz(dark);
+						dark &= dark - 1;
+						sunlit[xi + bit] = 0;
+						lit_count--;
+					}
+				}
+			}
+#endif
+			for (; xi < sx; xi++) {
+				if (!sunlit[xi])
+					continue;
+				if (sunlight_lut[row[xi].getContent()]) {
+					row[xi].param1 = LIGHT_SUN;
+				} else {
+					sunlit[xi] = 0;
+					lit_count--;
+				}
 			}
 		}
 	}
+	});
 	//printf("propagateSunlight: %dms\n", t.stop());
 }
 
 
+// Whether a node with light value 'la' could brighten a neighbor with light
+// value 'lb' in either bank, i.e. whether the pair is a light discontinuity
+static inline bool canBrighten(u8 la, u8 lb)
+{
+	return (la & 0x0F) > (lb & 0x0F) + 0x01 ||
+		(la & 0xF0) > (lb & 0xF0) + 0x10;
+}
+
+inline u8 Mapgen::getLightInfo(content_t c)
+{
+	if (c >= m_light_source_lut.size())
+		m_light_source_lut.resize(c + 1, 0xFF);
+	u8 entry = m_light_source_lut[c];
+	if (entry == 0xFF) {
+		const ContentFeatures &cf = ndef->get(c);
+		entry = (cf.light_source << 1) | (cf.light_propagates ? 1 : 0);
+		m_light_source_lut[c] = entry;
+	}
+	return entry;
+}
+
 void Mapgen::spreadLight(const v3s16 &nmin, const v3s16 &nmax)
 {
 	//TimeTaker t("spreadLight");
 	std::queue<std::pair<v3s16, u8>> queue;
 	VoxelArea a(nmin, nmax);
-
+	const v3s16 &em = vm->m_area.getExtent();
+	const u32 ystride = em.X;
+	const u32 zstride = (u32)em.X * em.Y;
+
+	// Seed the BFS only from light sources and from light discontinuities:
+	// axis-adjacent node pairs where one side could brighten the other.
+	// Uniformly sunlit sky and uniformly dark ground produce no seeds, so
+	// mostly-open and mostly-solid chunks skip nearly all the neighbor
+	// spreading work of the old full-volume pass; the resulting light
+	// fixpoint is identical since no-op spreads never change it.
 	for (int z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++) {
 		for (int y = a.MinEdge.Y; y <= a.MaxEdge.Y; y++) {
 			u32 i = vm->m_area.index(a.MinEdge.X, y, z);
 			for (int x = a.MinEdge.X; x <= a.MaxEdge.X; x++, i++) {
 				MapNode &n = vm->m_data[i];
-				if (n.getContent() == CONTENT_IGNORE)
-					continue;
-
-				const ContentFeatures &cf = ndef->get(n);
-				if (!cf.light_propagates)
-					continue;
+				content_t c = n.getContent();
+				u8 light = 0;
 
 				// TODO(hmmmmm): Abstract away direct param1 accesses with a
 				// wrapper, but something lighter than MapNode::get/setLight
 
-				u8 light_produced = cf.light_source;
-				if (light_produced)
-					n.param1 = light_produced | (light_produced << 4);
+				// As before, only light-propagating nodes receive their
+				// light_source value and spread light to their neighbors
+				if (c != CONTENT_IGNORE) {
+					u8 info = getLightInfo(c);
+					if (info & 1) {
+						u8 light_produced = info >> 1;
+						if (light_produced)
+							n.param1 = light_produced | (light_produced << 4);
+
+						light = n.param1;
+					}
+				}
+
+				// Compare against the already-visited -x/-y/-z neighbors and
+				// enqueue the brighter side of any discontinuity.  Light in
+				// nodes that cannot spread it (CONTENT_IGNORE, solids) is
+				// treated as zero, same as the old full scan skipping them.
+				for (int axis = 0; axis < 3; axis++) {
+					u32 ni;
+					v3s16 np(x, y, z);
+					if (axis == 0) {
+						if (x == a.MinEdge.X)
+							continue;
+						ni = i - 1;
+						np.X--;
+					} else if (axis == 1) {
+						if (y == a.MinEdge.Y)
+							continue;
+						ni = i - ystride;
+						np.Y--;
+					} else {
+						if (z == a.MinEdge.Z)
+							continue;
+						ni = i - zstride;
+						np.Z--;
+					}
 
-				u8 light = n.param1;
-				if (light) {
-					const v3s16 p(x, y, z);
-					// spread to all 6 neighbor nodes
-					for (const auto &dir : g_6dirs)
-						lightSpread(a, queue, p + dir, light);
+					const MapNode &n2 = vm->m_data[ni];
+					content_t c2 = n2.getContent();
+					u8 light2 = 0;
+					if (c2 != CONTENT_IGNORE && (getLightInfo(c2) & 1))
+						light2 = n2.param1;
+					if (canBrighten(light, light2))
+						queue.emplace(v3s16(x, y, z), light);
+					else if (canBrighten(light2, light))
+						queue.emplace(np, light2);
 				}
 			}
 		}
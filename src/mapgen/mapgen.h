@@ -220,6 +220,19 @@ private:
 	// that checks whether there are floodable nodes without liquid beneath
 	// the node at index vi.
 	inline bool isLiquidHorizontallyFlowable(u32 vi, v3s16 em);
+
+	// Lazily filled (light_source << 1 | light_propagates) cache indexed by
+	// content ID (0xFF = not yet known); spares spreadLight() a full
+	// ContentFeatures lookup per node.
+	inline u8 getLightInfo(content_t c);
+	std::vector<u8> m_light_source_lut;
+
+	// Dense walkable / sunlight_propagates tables covering the whole
+	// content ID space, for the chunk-wide column scans of
+	// updateHeightmap() and propagateSunlight(); see buildContentLUTs()
+	void buildContentLUTs();
+	std::vector<u8> m_walkable_lut;
+	std::vector<u8> m_sunlight_lut;
 };
 
 /*
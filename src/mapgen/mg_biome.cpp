@@ -175,6 +175,10 @@ void BiomeParamsOriginal::writeParams(Settings *settings) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Climate values for at most this many columns are remembered per BiomeGen;
+// the cache is simply dropped once the limit is reached
+#define CLIMATE_CACHE_LIMIT 16384
+
 BiomeGenOriginal::BiomeGenOriginal(BiomeManager *biomemgr,
 	BiomeParamsOriginal *params, v3s16 chunksize)
 {
@@ -214,12 +218,25 @@ BiomeGenOriginal::~BiomeGenOriginal()
 // Only usable in a mapgen thread
 Biome *BiomeGenOriginal::calcBiomeAtPoint(v3s16 pos) const
 {
-	float heat =
-		NoisePerlin2D(&m_params->np_heat,       pos.X, pos.Z, m_params->seed) +
-		NoisePerlin2D(&m_params->np_heat_blend, pos.X, pos.Z, m_params->seed);
-	float humidity =
-		NoisePerlin2D(&m_params->np_humidity,       pos.X, pos.Z, m_params->seed) +
-		NoisePerlin2D(&m_params->np_humidity_blend, pos.X, pos.Z, m_params->seed);
+	float heat, humidity;
+
+	u32 key = ((u32)(u16)pos.Z << 16) | (u16)pos.X;
+	auto it = m_climate_cache.find(key);
+	if (it != m_climate_cache.end()) {
+		heat     = it->second.first;
+		humidity = it->second.second;
+	} else {
+		heat =
+			NoisePerlin2D(&m_params->np_heat,       pos.X, pos.Z, m_params->seed) +
+			NoisePerlin2D(&m_params->np_heat_blend, pos.X, pos.Z, m_params->seed);
+		humidity =
+			NoisePerlin2D(&m_params->np_humidity,       pos.X, pos.Z, m_params->seed) +
+			NoisePerlin2D(&m_params->np_humidity_blend, pos.X, pos.Z, m_params->seed);
+
+		if (m_climate_cache.size() >= CLIMATE_CACHE_LIMIT)
+			m_climate_cache.clear();
+		m_climate_cache[key] = std::make_pair(heat, humidity);
+	}
 
 	return calcBiomeFromNoise(heat, humidity, pos);
 }
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <unordered_map>
 #include "objdef.h"
 #include "nodedef.h"
 #include "noise.h"
@@ -175,6 +176,13 @@ public:
 private:
 	BiomeParamsOriginal *m_params;
 
+	// Column-keyed climate cache for calcBiomeAtPoint().  Heat and humidity
+	// depend only on (X, Z) and the map seed, so repeated point queries for
+	// the same column (spawn point probing, mods) can skip the noise
+	// evaluation.  Each emerge thread owns its own BiomeGen, so the cache is
+	// effectively sharded per thread and needs no locking.
+	mutable std::unordered_map<u32, std::pair<float, float>> m_climate_cache;
+
 	Noise *noise_heat;
 	Noise *noise_humidity;
 	Noise *noise_heat_blend;
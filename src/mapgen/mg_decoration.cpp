@@ -129,7 +129,11 @@ bool Decoration::canPlaceDecoration(MMVManip *vm, v3s16 p)
 
 size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 {
-	PcgRandom ps(blockseed + 53);
+	// A decoration confined to a Y range that cannot occur in this chunk
+	// would reject every placement below anyway; skip it outright.
+	if (y_max < nmin.Y || y_min > nmax.Y)
+		return 0;
+
 	int carea_size = nmax.X - nmin.X + 1;
 
 	// Divide area into parts
@@ -142,6 +146,13 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 
 	for (s16 z0 = 0; z0 < divlen; z0++)
 	for (s16 x0 = 0; x0 < divlen; x0++) {
+		// Each division gets its own deterministically seeded RNG instead of
+		// all sharing one sequential stream.  This makes the cells fully
+		// independent: they can be processed in any order - or in parallel,
+		// where the writes are known to be disjoint - and a skipped cell
+		// does not shift the random values of the remaining ones.
+		PcgRandom ps(blockseed + 53 + (u32)(z0 * divlen + x0) * 2654435761U);
+
 		v2s16 p2d_center( // Center position of part of division
 			nmin.X + sidelen / 2 + sidelen * x0,
 			nmin.Z + sidelen / 2 + sidelen * z0
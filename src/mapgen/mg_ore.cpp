@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mg_ore.h"
 #include "mapgen.h"
+#include "threading/mutex_auto_lock.h"
 #include "noise.h"
 #include "map.h"
 #include "log.h"
@@ -45,17 +46,64 @@ OreManager::OreManager(IGameDef *gamedef) :
 }
 
 
-size_t OreManager::placeAllOres(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+void OreManager::rebuildOreIndex()
 {
-	size_t nplaced = 0;
+	m_ore_index.clear();
 
+	u32 seed_offset = 0;
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Ore *ore = (Ore *)m_objects[i];
 		if (!ore)
 			continue;
 
-		nplaced += ore->placeOre(mg, blockseed, nmin, nmax);
-		blockseed++;
+		OreIndexEntry entry;
+		entry.ore         = ore;
+		entry.y_min       = ore->y_min;
+		entry.y_max       = ore->y_max;
+		entry.seed_offset = seed_offset++;
+		m_ore_index.push_back(entry);
+	}
+
+	std::sort(m_ore_index.begin(), m_ore_index.end(),
+		[](const OreIndexEntry &a, const OreIndexEntry &b) {
+			return a.y_min < b.y_min;
+		});
+
+	m_ore_index_count = m_objects.size();
+}
+
+
+size_t OreManager::placeAllOres(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+{
+	size_t nplaced = 0;
+
+	{
+		MutexAutoLock lock(m_index_mutex);
+		if (m_ore_index_count != m_objects.size())
+			rebuildOreIndex();
+	}
+
+	// Collect the ores whose Y range intersects the chunk.  The index is
+	// sorted by y_min, so everything past the first entry starting above the
+	// chunk can be skipped wholesale.
+	std::vector<const OreIndexEntry *> matches;
+	for (const OreIndexEntry &entry : m_ore_index) {
+		if (entry.y_min > nmax.Y)
+			break;
+		if (entry.y_max >= nmin.Y)
+			matches.push_back(&entry);
+	}
+
+	// Place in registration order; ores may overlap, so the application
+	// order affects the result
+	std::sort(matches.begin(), matches.end(),
+		[](const OreIndexEntry *a, const OreIndexEntry *b) {
+			return a->seed_offset < b->seed_offset;
+		});
+
+	for (const OreIndexEntry *entry : matches) {
+		nplaced += entry->ore->placeOre(mg, blockseed + entry->seed_offset,
+			nmin, nmax);
 	}
 
 	return nplaced;
@@ -69,6 +117,10 @@ void OreManager::clear()
 		delete ore;
 	}
 	m_objects.clear();
+
+	MutexAutoLock lock(m_index_mutex);
+	m_ore_index.clear();
+	m_ore_index_count = SIZE_MAX;
 }
 
 
@@ -112,7 +164,8 @@ size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 	v3s16 nmin, v3s16 nmax, u8 *biomemap)
 {
-	PcgRandom pr(blockseed);
+	PcgRandom pr_base(blockseed);
+	BufferedPcgRandom pr(pr_base);
 	MapNode n_ore(c_ore, 0, ore_param2);
 
 	u32 sizex  = (nmax.X - nmin.X + 1);
@@ -161,7 +214,8 @@ void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 void OreSheet::generate(MMVManip *vm, int mapseed, u32 blockseed,
 	v3s16 nmin, v3s16 nmax, u8 *biomemap)
 {
-	PcgRandom pr(blockseed + 4234);
+	PcgRandom pr_base(blockseed + 4234);
+	BufferedPcgRandom pr(pr_base);
 	MapNode n_ore(c_ore, 0, ore_param2);
 
 	u16 max_height = column_height_max;
@@ -224,7 +278,8 @@ OrePuff::~OrePuff()
 void OrePuff::generate(MMVManip *vm, int mapseed, u32 blockseed,
 	v3s16 nmin, v3s16 nmax, u8 *biomemap)
 {
-	PcgRandom pr(blockseed + 4234);
+	PcgRandom pr_base(blockseed + 4234);
+	BufferedPcgRandom pr(pr_base);
 	MapNode n_ore(c_ore, 0, ore_param2);
 
 	int y_start = pr.range(nmin.Y, nmax.Y);
@@ -297,7 +352,8 @@ void OrePuff::generate(MMVManip *vm, int mapseed, u32 blockseed,
 void OreBlob::generate(MMVManip *vm, int mapseed, u32 blockseed,
 	v3s16 nmin, v3s16 nmax, u8 *biomemap)
 {
-	PcgRandom pr(blockseed + 2404);
+	PcgRandom pr_base(blockseed + 2404);
+	BufferedPcgRandom pr(pr_base);
 	MapNode n_ore(c_ore, 0, ore_param2);
 
 	u32 sizex  = (nmax.X - nmin.X + 1);
@@ -369,7 +425,8 @@ OreVein::~OreVein()
 void OreVein::generate(MMVManip *vm, int mapseed, u32 blockseed,
 	v3s16 nmin, v3s16 nmax, u8 *biomemap)
 {
-	PcgRandom pr(blockseed + 520);
+	PcgRandom pr_base(blockseed + 520);
+	BufferedPcgRandom pr(pr_base);
 	MapNode n_ore(c_ore, 0, ore_param2);
 
 	int sizex = nmax.X - nmin.X + 1;
@@ -437,7 +494,8 @@ OreStratum::~OreStratum()
 void OreStratum::generate(MMVManip *vm, int mapseed, u32 blockseed,
 	v3s16 nmin, v3s16 nmax, u8 *biomemap)
 {
-	PcgRandom pr(blockseed + 4234);
+	PcgRandom pr_base(blockseed + 4234);
+	BufferedPcgRandom pr(pr_base);
 	MapNode n_ore(c_ore, 0, ore_param2);
 
 	if (flags & OREFLAG_USE_NOISE) {
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <mutex>
 #include <unordered_set>
 #include "objdef.h"
 #include "noise.h"
@@ -183,4 +184,23 @@ public:
 	void clear();
 
 	size_t placeAllOres(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+
+private:
+	// Y-range interval index over the registered ores, sorted by y_min, so
+	// placeAllOres() only visits ores whose range intersects the chunk.
+	// seed_offset preserves each ore's position in the registration order,
+	// keeping per-ore block seeds (and thus generated maps) unchanged.
+	struct OreIndexEntry {
+		Ore *ore;
+		s16 y_min;
+		s16 y_max;
+		u32 seed_offset;
+	};
+
+	// Requires m_index_mutex held
+	void rebuildOreIndex();
+
+	std::vector<OreIndexEntry> m_ore_index;
+	size_t m_ore_index_count = SIZE_MAX;
+	std::mutex m_index_mutex;
 };
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <cstring> // memcpy
 #include <fstream>
 #include <typeinfo>
 #include "mg_schematic.h"
@@ -88,10 +89,23 @@ void Schematic::resolveNodeNames()
 		content_t c_new = c_nodes[c_original];
 		schemdata[i].setContent(c_new);
 	}
+
+	// Content IDs are final now, so the rotation variants can be baked
+	bakeRotations();
 }
 
 
-void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+void Schematic::invalidateRotations()
+{
+	for (RotatedSchematic &rs : m_baked_rotations) {
+		rs.nodes.clear();
+		rs.probs.clear();
+		rs.trivial = false;
+	}
+}
+
+
+void Schematic::bakeRotations()
 {
 	sanity_check(m_ndef != NULL);
 
@@ -99,34 +113,77 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 	int ystride = size.X;
 	int zstride = size.X * size.Y;
 
-	s16 sx = size.X;
-	s16 sy = size.Y;
-	s16 sz = size.Z;
-
-	int i_start, i_step_x, i_step_z;
-	switch (rot) {
-		case ROTATE_90:
-			i_start  = sx - 1;
-			i_step_x = zstride;
-			i_step_z = -xstride;
-			SWAP(s16, sx, sz);
-			break;
-		case ROTATE_180:
-			i_start  = zstride * (sz - 1) + sx - 1;
-			i_step_x = -xstride;
-			i_step_z = -zstride;
-			break;
-		case ROTATE_270:
-			i_start  = zstride * (sz - 1);
-			i_step_x = -zstride;
-			i_step_z = xstride;
-			SWAP(s16, sx, sz);
-			break;
-		default:
-			i_start  = 0;
-			i_step_x = xstride;
-			i_step_z = zstride;
+	for (int rot = ROTATE_0; rot <= ROTATE_270; rot++) {
+		s16 sx = size.X;
+		s16 sy = size.Y;
+		s16 sz = size.Z;
+
+		int i_start, i_step_x, i_step_z;
+		switch (rot) {
+			case ROTATE_90:
+				i_start  = sx - 1;
+				i_step_x = zstride;
+				i_step_z = -xstride;
+				SWAP(s16, sx, sz);
+				break;
+			case ROTATE_180:
+				i_start  = zstride * (sz - 1) + sx - 1;
+				i_step_x = -xstride;
+				i_step_z = -zstride;
+				break;
+			case ROTATE_270:
+				i_start  = zstride * (sz - 1);
+				i_step_x = -zstride;
+				i_step_z = xstride;
+				SWAP(s16, sx, sz);
+				break;
+			default:
+				i_start  = 0;
+				i_step_x = xstride;
+				i_step_z = zstride;
+		}
+
+		RotatedSchematic &rs = m_baked_rotations[rot];
+		rs.size = v3s16(sx, sy, sz);
+		rs.nodes.resize((u32)sx * sy * sz);
+		rs.probs.resize((u32)sx * sy * sz);
+		rs.trivial = true;
+
+		u32 bi = 0;
+		for (s16 y = 0; y != sy; y++)
+		for (s16 z = 0; z != sz; z++) {
+			u32 i = z * i_step_z + y * ystride + i_start;
+			for (s16 x = 0; x != sx; x++, i += i_step_x, bi++) {
+				MapNode n = schemdata[i];
+				u8 prob = n.param1;
+				n.param1 = 0;
+				if (rot)
+					n.rotateAlongYAxis(m_ndef, (Rotation)rot);
+
+				rs.nodes[bi] = n;
+				rs.probs[bi] = prob;
+
+				if (n.getContent() == CONTENT_IGNORE ||
+						(prob & MTSCHEM_PROB_MASK) != MTSCHEM_PROB_ALWAYS)
+					rs.trivial = false;
+			}
+		}
 	}
+}
+
+
+void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+{
+	sanity_check(m_ndef != NULL);
+	sanity_check(rot <= ROTATE_270);
+
+	const RotatedSchematic &rs = m_baked_rotations[rot];
+	if (rs.nodes.empty())
+		bakeRotations();
+
+	s16 sx = rs.size.X;
+	s16 sy = rs.size.Y;
+	s16 sz = rs.size.Z;
 
 	s16 y_map = p.Y;
 	for (s16 y = 0; y != sy; y++) {
@@ -135,17 +192,29 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 			continue;
 
 		for (s16 z = 0; z != sz; z++) {
-			u32 i = z * i_step_z + y * ystride + i_start;
-			for (s16 x = 0; x != sx; x++, i += i_step_x) {
+			u32 i = ((u32)y * sz + z) * sx;
+
+			// When overwriting unconditionally and no node needs special
+			// treatment, blit whole rows at once
+			if (force_place && rs.trivial &&
+					vm->m_area.contains(v3s16(p.X, y_map, p.Z + z)) &&
+					vm->m_area.contains(v3s16(p.X + sx - 1, y_map, p.Z + z))) {
+				u32 vi = vm->m_area.index(p.X, y_map, p.Z + z);
+				memcpy(&vm->m_data[vi], &rs.nodes[i], sx * sizeof(MapNode));
+				continue;
+			}
+
+			for (s16 x = 0; x != sx; x++, i++) {
 				v3s16 pos(p.X + x, y_map, p.Z + z);
 				if (!vm->m_area.contains(pos))
 					continue;
 
-				if (schemdata[i].getContent() == CONTENT_IGNORE)
+				const MapNode &sn = rs.nodes[i];
+				if (sn.getContent() == CONTENT_IGNORE)
 					continue;
 
-				u8 placement_prob     = schemdata[i].param1 & MTSCHEM_PROB_MASK;
-				bool force_place_node = schemdata[i].param1 & MTSCHEM_FORCE_PLACE;
+				u8 placement_prob     = rs.probs[i] & MTSCHEM_PROB_MASK;
+				bool force_place_node = rs.probs[i] & MTSCHEM_FORCE_PLACE;
 
 				if (placement_prob == MTSCHEM_PROB_NEVER)
 					continue;
@@ -161,11 +230,8 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 					(placement_prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
 					continue;
 
-				vm->m_data[vi] = schemdata[i];
-				vm->m_data[vi].param1 = 0;
-
-				if (rot)
-					vm->m_data[vi].rotateAlongYAxis(m_ndef, rot);
+				// param1 is already cleared and param2 pre-rotated
+				vm->m_data[vi] = sn;
 			}
 		}
 		y_map++;
@@ -325,6 +391,7 @@ bool Schematic::deserializeFromMts(std::istream *is,
 			schemdata[i].param1 >>= 1;
 	}
 
+	invalidateRotations();
 	return true;
 }
 
@@ -526,6 +593,7 @@ bool Schematic::getSchematicFromMap(Map *map, v3s16 p1, v3s16 p2)
 	}
 
 	delete vm;
+	invalidateRotations();
 	return true;
 }
 
@@ -551,6 +619,8 @@ void Schematic::applyProbabilities(v3s16 p0,
 		s16 y = (*splist)[i].first - p0.Y;
 		slice_probs[y] = (*splist)[i].second;
 	}
+
+	invalidateRotations();
 }
 
 
@@ -116,11 +116,32 @@ public:
 		std::vector<std::pair<v3s16, u8> > *plist,
 		std::vector<std::pair<s16, u8> > *splist);
 
+	// One pre-baked rotation variant of the schematic.  Nodes are stored in
+	// placement order (x fastest) with param2 already rotated and param1
+	// cleared, ready to be written to the map; the original param1 values
+	// (probability and force-place bit) are kept alongside in 'probs'.
+	struct RotatedSchematic {
+		v3s16 size;
+		std::vector<MapNode> nodes;
+		std::vector<u8> probs;
+		// No CONTENT_IGNORE nodes and all probabilities MTSCHEM_PROB_ALWAYS;
+		// allows whole rows to be copied without per-node checks
+		bool trivial = false;
+	};
+
+	// (Re)computes all four rotation variants; called once the node names
+	// have been resolved to content IDs
+	void bakeRotations();
+	void invalidateRotations();
+
 	std::vector<content_t> c_nodes;
 	u32 flags = 0;
 	v3s16 size;
 	MapNode *schemdata = nullptr;
 	u8 *slice_probs = nullptr;
+
+private:
+	RotatedSchematic m_baked_rotations[4];
 };
 
 class SchematicManager : public ObjDefManager {
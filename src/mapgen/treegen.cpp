@@ -139,6 +139,52 @@ treegen::error spawn_ltree(ServerEnvironment *env, v3s16 p0,
 	return SUCCESS;
 }
 
+treegen::error spawn_ltrees(ServerEnvironment *env,
+	const std::vector<v3s16> &positions,
+	const NodeDefManager *ndef, const TreeDef &tree_definition)
+{
+	if (positions.empty())
+		return SUCCESS;
+
+	ServerMap *map = &env->getServerMap();
+	std::map<v3s16, MapBlock*> modified_blocks;
+	MMVManip vmanip(map);
+	treegen::error e;
+
+	// Emerge the union of the per-tree regions once, so that the whole
+	// batch shares a single map access and lighting pass instead of
+	// paying for one per trunk
+	v3s16 blockp_min = getNodeBlockPos(positions[0]);
+	v3s16 blockp_max = blockp_min;
+	for (size_t i = 1; i < positions.size(); i++) {
+		v3s16 bp = getNodeBlockPos(positions[i]);
+		blockp_min.X = MYMIN(blockp_min.X, bp.X);
+		blockp_min.Y = MYMIN(blockp_min.Y, bp.Y);
+		blockp_min.Z = MYMIN(blockp_min.Z, bp.Z);
+		blockp_max.X = MYMAX(blockp_max.X, bp.X);
+		blockp_max.Y = MYMAX(blockp_max.Y, bp.Y);
+		blockp_max.Z = MYMAX(blockp_max.Z, bp.Z);
+	}
+	vmanip.initialEmerge(blockp_min - v3s16(1, 1, 1),
+		blockp_max + v3s16(1, 3, 1));
+
+	for (v3s16 p0 : positions) {
+		e = make_ltree(vmanip, p0, ndef, tree_definition);
+		if (e != SUCCESS)
+			return e;
+	}
+
+	voxalgo::blit_back_with_light(map, &vmanip, &modified_blocks);
+
+	// Send a MEET_OTHER event
+	MapEditEvent event;
+	event.type = MEET_OTHER;
+	for (auto &modified_block : modified_blocks)
+		event.modified_blocks.insert(modified_block.first);
+	map->dispatchEvent(event);
+	return SUCCESS;
+}
+
 
 //L-System tree generator
 treegen::error make_ltree(MMVManip &vmanip, v3s16 p0,
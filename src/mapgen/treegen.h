@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <matrix4.h>
+#include <vector>
 #include "noise.h"
 
 class MMVManip;
@@ -75,6 +76,11 @@ namespace treegen {
 	// Spawn L-systems tree from LUA
 	treegen::error spawn_ltree (ServerEnvironment *env, v3s16 p0,
 		const NodeDefManager *ndef, const TreeDef &tree_definition);
+	// Spawn a batch of L-systems trees sharing one definition through a
+	// single vmanip and lighting update (used by core.spawn_trees())
+	treegen::error spawn_ltrees(ServerEnvironment *env,
+		const std::vector<v3s16> &positions,
+		const NodeDefManager *ndef, const TreeDef &tree_definition);
 
 	// L-System tree gen helper functions
 	void tree_node_placement(MMVManip &vmanip, v3f p0,
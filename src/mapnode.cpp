@@ -726,8 +726,8 @@ void MapNode::serializeBulk(std::ostream &os, int version,
 	u32 start2 = (content_width + 1) * nodecount;
 
 	// Serialize content
+	writeU16Bulk(databuf, &nodes[0].param0, nodecount, sizeof(MapNode));
 	for (u32 i = 0; i < nodecount; i++) {
-		writeU16(&databuf[i * 2], nodes[i].param0);
 		writeU8(&databuf[start1 + i], nodes[i].param1);
 		writeU8(&databuf[start2 + i], nodes[i].param2);
 	}
@@ -786,8 +786,8 @@ void MapNode::deSerializeBulk(std::istream &is, int version,
 	}
 	else if(content_width == 2)
 	{
-		for(u32 i=0; i<nodecount; i++)
-			nodes[i].param0 = readU16(&databuf[i*2]);
+		readU16Bulk(&databuf[0], &nodes[0].param0, nodecount,
+				sizeof(MapNode));
 	}
 
 	// Deserialize param1
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mapsector.h"
 #include "exceptions.h"
+#include "map.h"
 #include "mapblock.h"
 #include "serialization.h"
 
@@ -46,6 +47,8 @@ void MapSector::deleteBlocks()
 
 	// Clear container
 	m_blocks.clear();
+
+	m_parent->reportBlockSetChange();
 }
 
 MapBlock * MapSector::getBlockBuffered(s16 y)
@@ -89,6 +92,8 @@ MapBlock * MapSector::createBlankBlock(s16 y)
 
 	m_blocks[y] = block;
 
+	m_parent->reportBlockSetChange();
+
 	return block;
 }
 
@@ -106,6 +111,8 @@ void MapSector::insertBlock(MapBlock *block)
 
 	// Insert into container
 	m_blocks[block_y] = block;
+
+	m_parent->reportBlockSetChange();
 }
 
 void MapSector::deleteBlock(MapBlock *block)
@@ -118,6 +125,8 @@ void MapSector::deleteBlock(MapBlock *block)
 	// Remove from container
 	m_blocks.erase(block_y);
 
+	m_parent->reportBlockSetChange();
+
 	// Delete
 	delete block;
 }
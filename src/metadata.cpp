@@ -60,7 +60,7 @@ bool Metadata::operator==(const Metadata &other) const
 
 const std::string &Metadata::getString(const std::string &name, u16 recursion) const
 {
-	StringMap::const_iterator it = m_stringvars.find(name);
+	MetadataStringMap::const_iterator it = m_stringvars.find(name);
 	if (it == m_stringvars.end()) {
 		static const std::string empty_string = std::string("");
 		return empty_string;
@@ -72,7 +72,7 @@ const std::string &Metadata::getString(const std::string &name, u16 recursion) c
 bool Metadata::getStringToRef(
 		const std::string &name, std::string &str, u16 recursion) const
 {
-	StringMap::const_iterator it = m_stringvars.find(name);
+	MetadataStringMap::const_iterator it = m_stringvars.find(name);
 	if (it == m_stringvars.end()) {
 		return false;
 	}
@@ -91,11 +91,12 @@ bool Metadata::getStringToRef(
 bool Metadata::setString(const std::string &name, const std::string &var)
 {
 	if (var.empty()) {
-		m_stringvars.erase(name);
+		if (m_stringvars.erase(name) > 0)
+			m_modified = true;
 		return true;
 	}
 
-	StringMap::iterator it = m_stringvars.find(name);
+	MetadataStringMap::iterator it = m_stringvars.find(name);
 	if (it != m_stringvars.end() && it->second == var) {
 		return false;
 	}
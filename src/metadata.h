@@ -23,6 +23,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <iostream>
 #include <vector>
 #include "util/string.h"
+#include "util/sharedstring.h"
+
+// Metadata values are interned so that identical strings (e.g. the
+// formspec of every chest in the world) share one heap copy
+typedef std::unordered_map<std::string, SharedString> MetadataStringMap;
 
 class Metadata
 {
@@ -49,7 +54,7 @@ public:
 	bool getStringToRef(const std::string &name, std::string &str, u16 recursion = 0) const;
 	virtual bool setString(const std::string &name, const std::string &var);
 	inline bool removeString(const std::string &name) { return setString(name, ""); }
-	const StringMap &getStrings() const
+	const MetadataStringMap &getStrings() const
 	{
 		return m_stringvars;
 	}
@@ -59,5 +64,5 @@ public:
 	inline bool isModified() const  { return m_modified; }
 	inline void setModified(bool v) { m_modified = v; }
 protected:
-	StringMap m_stringvars;
+	MetadataStringMap m_stringvars;
 };
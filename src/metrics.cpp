@@ -0,0 +1,259 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "metrics.h"
+
+#include <cstring>
+#include <sstream>
+#include "log.h"
+#include "porting.h"
+#include "profiler.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/basic_macros.h"
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0501
+#endif
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define CLOSE_SOCKET(fd) closesocket(fd)
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define CLOSE_SOCKET(fd) close(fd)
+#endif
+
+static MetricsCollector main_metrics_collector;
+MetricsCollector *g_metrics = &main_metrics_collector;
+
+// Histogram bucket upper bounds in seconds; Prometheus derives
+// percentiles from the cumulative bucket counts
+static const double BUCKET_BOUNDS[] = {
+	0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+	1.0, 2.5, 5.0, 8.0
+};
+static const size_t NUM_BUCKETS = ARRLEN(BUCKET_BOUNDS);
+
+void MetricsCollector::setGauge(const std::string &name,
+		const std::string &help, double value)
+{
+	MutexAutoLock lock(m_mutex);
+	Metric &m = m_gauges[name];
+	m.help = help;
+	m.value = value;
+}
+
+void MetricsCollector::setCounter(const std::string &name,
+		const std::string &help, double value)
+{
+	MutexAutoLock lock(m_mutex);
+	Metric &m = m_counters[name];
+	m.help = help;
+	m.value = value;
+}
+
+void MetricsCollector::observe(const std::string &name,
+		const std::string &help, double value)
+{
+	MutexAutoLock lock(m_mutex);
+	Histogram &h = m_histograms[name];
+	if (h.counts.empty()) {
+		h.help = help;
+		h.counts.resize(NUM_BUCKETS + 1);
+	}
+	size_t bucket = 0;
+	while (bucket < NUM_BUCKETS && value > BUCKET_BOUNDS[bucket])
+		bucket++;
+	h.counts[bucket]++;
+	h.sum += value;
+	h.count++;
+}
+
+// Escapes a Prometheus label value
+static std::string escapeLabel(const std::string &s)
+{
+	std::string result;
+	for (char c : s) {
+		if (c == '\\' || c == '"')
+			result += '\\';
+		if (c == '\n') {
+			result += "\\n";
+			continue;
+		}
+		result += c;
+	}
+	return result;
+}
+
+void MetricsCollector::render(std::ostream &os)
+{
+	{
+		MutexAutoLock lock(m_mutex);
+
+		for (const auto &it : m_gauges) {
+			os << "# HELP " << it.first << " " << it.second.help << "\n";
+			os << "# TYPE " << it.first << " gauge\n";
+			os << it.first << " " << it.second.value << "\n";
+		}
+
+		for (const auto &it : m_counters) {
+			os << "# HELP " << it.first << " " << it.second.help << "\n";
+			os << "# TYPE " << it.first << " counter\n";
+			os << it.first << " " << it.second.value << "\n";
+		}
+
+		for (const auto &it : m_histograms) {
+			const Histogram &h = it.second;
+			os << "# HELP " << it.first << " " << h.help << "\n";
+			os << "# TYPE " << it.first << " histogram\n";
+			u64 cumulative = 0;
+			for (size_t i = 0; i < NUM_BUCKETS; i++) {
+				cumulative += h.counts[i];
+				os << it.first << "_bucket{le=\"" << BUCKET_BOUNDS[i]
+					<< "\"} " << cumulative << "\n";
+			}
+			os << it.first << "_bucket{le=\"+Inf\"} " << h.count << "\n";
+			os << it.first << "_sum " << h.sum << "\n";
+			os << it.first << "_count " << h.count << "\n";
+		}
+	}
+
+	// The free-form engine profiler values go out as one labeled metric
+	Profiler::GraphValues values;
+	g_profiler->getValues(values);
+	if (!values.empty()) {
+		os << "# HELP minetest_profiler_value Engine profiler values "
+			"(averaged ones are per sample)\n";
+		os << "# TYPE minetest_profiler_value gauge\n";
+		for (const auto &it : values) {
+			os << "minetest_profiler_value{key=\""
+				<< escapeLabel(it.first) << "\"} " << it.second << "\n";
+		}
+	}
+}
+
+/*
+	MetricsServerThread
+*/
+
+MetricsServerThread::MetricsServerThread(const std::string &bind_addr,
+		u16 port):
+	Thread("Metrics"),
+	m_bind_addr(bind_addr),
+	m_port(port)
+{
+}
+
+void *MetricsServerThread::run()
+{
+	socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == INVALID_SOCKET) {
+		errorstream << "MetricsServerThread: socket() failed" << std::endl;
+		return nullptr;
+	}
+
+	int on = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(m_port);
+	addr.sin_addr.s_addr = inet_addr(m_bind_addr.c_str());
+	if (addr.sin_addr.s_addr == INADDR_NONE) {
+		errorstream << "MetricsServerThread: invalid metrics_address \""
+			<< m_bind_addr << "\"" << std::endl;
+		CLOSE_SOCKET(sock);
+		return nullptr;
+	}
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+			listen(sock, 4) != 0) {
+		errorstream << "MetricsServerThread: cannot listen on "
+			<< m_bind_addr << ":" << m_port << std::endl;
+		CLOSE_SOCKET(sock);
+		return nullptr;
+	}
+
+	// Nonblocking accept so stop() is noticed promptly
+#ifdef _WIN32
+	u_long nonblocking = 1;
+	ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#endif
+
+	actionstream << "Serving metrics on " << m_bind_addr << ":" << m_port
+		<< std::endl;
+
+	while (!stopRequested()) {
+		socket_t client = accept(sock, nullptr, nullptr);
+		if (client == INVALID_SOCKET) {
+			sleep_ms(100);
+			continue;
+		}
+
+		// The accepted socket may inherit O_NONBLOCK on some platforms
+#ifdef _WIN32
+		u_long blocking = 0;
+		ioctlsocket(client, FIONBIO, &blocking);
+#else
+		fcntl(client, F_SETFL, fcntl(client, F_GETFL) & ~O_NONBLOCK);
+#endif
+
+		// Best-effort read of the request; every request gets the
+		// metrics page, so its content does not matter
+		char reqbuf[1024];
+		recv(client, reqbuf, sizeof(reqbuf), 0);
+
+		std::ostringstream body(std::ios_base::binary);
+		g_metrics->render(body);
+		const std::string body_str = body.str();
+
+		std::ostringstream response(std::ios_base::binary);
+		response << "HTTP/1.1 200 OK\r\n"
+			<< "Content-Type: text/plain; version=0.0.4\r\n"
+			<< "Content-Length: " << body_str.size() << "\r\n"
+			<< "Connection: close\r\n\r\n"
+			<< body_str;
+		const std::string response_str = response.str();
+
+		size_t sent = 0;
+		while (sent < response_str.size()) {
+			int n = send(client, response_str.c_str() + sent,
+					response_str.size() - sent, 0);
+			if (n <= 0)
+				break;
+			sent += n;
+		}
+		CLOSE_SOCKET(client);
+	}
+
+	CLOSE_SOCKET(sock);
+	return nullptr;
+}
@@ -0,0 +1,99 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "threading/thread.h"
+
+/*
+	Collects operational metrics and renders them in the Prometheus text
+	exposition format. The server thread pushes gauge/counter/histogram
+	updates; the MetricsServerThread listener (metrics_port setting)
+	renders a snapshot per scrape, together with all engine profiler
+	values, so degradation can be alerted on before players notice.
+
+	All methods are thread-safe.
+*/
+class MetricsCollector
+{
+public:
+	// Gauges may go up and down (queue depths, object counts)
+	void setGauge(const std::string &name, const std::string &help,
+			double value);
+
+	// Counters must only grow; value is the running total
+	void setCounter(const std::string &name, const std::string &help,
+			double value);
+
+	/*
+		Records one observation into a histogram with log-spaced seconds
+		buckets (1 ms .. ~8 s), from which Prometheus derives
+		percentiles. Use for latencies, e.g. the environment step time.
+	*/
+	void observe(const std::string &name, const std::string &help,
+			double value);
+
+	// Writes all metrics, including the engine profiler values
+	void render(std::ostream &os);
+
+private:
+	struct Metric
+	{
+		std::string help;
+		double value = 0.0;
+	};
+	struct Histogram
+	{
+		std::string help;
+		std::vector<u64> counts; // one per bucket plus +Inf
+		double sum = 0.0;
+		u64 count = 0;
+	};
+
+	std::mutex m_mutex;
+	std::map<std::string, Metric> m_gauges;
+	std::map<std::string, Metric> m_counters;
+	std::map<std::string, Histogram> m_histograms;
+};
+
+/*
+	Minimal HTTP listener that answers every request with the metrics
+	page. Metrics are a diagnostics surface, so it binds to
+	metrics_address (default loopback); put a real reverse proxy in
+	front if remote scraping is needed.
+*/
+class MetricsServerThread : public Thread
+{
+public:
+	MetricsServerThread(const std::string &bind_addr, u16 port);
+
+protected:
+	void *run();
+
+private:
+	std::string m_bind_addr;
+	u16 m_port;
+};
+
+extern MetricsCollector *g_metrics;
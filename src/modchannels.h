@@ -53,6 +53,14 @@ private:
 	std::vector<u16> m_client_consumers;
 };
 
+// A single mod channel message, as queued for batched delivery
+struct ModChannelMsg
+{
+	std::string channel;
+	std::string sender;
+	std::string message;
+};
+
 enum ModChannelSignal : u8
 {
 	MODCHANNEL_SIGNAL_JOIN_OK,
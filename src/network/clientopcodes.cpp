@@ -114,14 +114,15 @@ const ToClientCommandHandler toClientCommandTable[TOCLIENT_NUM_MSG_TYPES] =
 	{ "TOCLIENT_MODCHANNEL_MSG",           TOCLIENT_STATE_CONNECTED, &Client::handleCommand_ModChannelMsg }, // 0x57
 	{ "TOCLIENT_MODCHANNEL_SIGNAL",        TOCLIENT_STATE_CONNECTED, &Client::handleCommand_ModChannelSignal }, // 0x58
 	{ "TOCLIENT_NODEMETA_CHANGED",         TOCLIENT_STATE_CONNECTED, &Client::handleCommand_NodemetaChanged }, // 0x59
-	null_command_handler,
-	null_command_handler,
+	{ "TOCLIENT_BLOCKDATAS",               TOCLIENT_STATE_CONNECTED, &Client::handleCommand_BlockDatas }, // 0x5a
+	{ "TOCLIENT_MODCHANNEL_MSGS",          TOCLIENT_STATE_CONNECTED, &Client::handleCommand_ModChannelMsgs }, // 0x5b
 	null_command_handler,
 	null_command_handler,
 	null_command_handler,
 	null_command_handler,
 	{ "TOCLIENT_SRP_BYTES_S_B",            TOCLIENT_STATE_NOT_CONNECTED, &Client::handleCommand_SrpBytesSandB }, // 0x60
 	{ "TOCLIENT_FORMSPEC_PREPEND",         TOCLIENT_STATE_CONNECTED, &Client::handleCommand_FormspecPrepend }, // 0x61,
+	{ "TOCLIENT_BLOCK_DELTA",              TOCLIENT_STATE_CONNECTED, &Client::handleCommand_BlockDelta }, // 0x62
 };
 
 const static ServerCommandFactory null_command_factory = { "TOSERVER_NULL", 0, false };
@@ -211,4 +212,5 @@ const ServerCommandFactory serverCommandFactoryTable[TOSERVER_NUM_MSG_TYPES] =
 	{ "TOSERVER_FIRST_SRP",          1, true }, // 0x50
 	{ "TOSERVER_SRP_BYTES_A",        1, true }, // 0x51
 	{ "TOSERVER_SRP_BYTES_M",        1, true }, // 0x52
+	{ "TOSERVER_SESSION_REAUTH",     1, true }, // 0x53
 };
@@ -61,6 +61,10 @@ void Client::handleCommand_Hello(NetworkPacket* pkt)
 	*pkt >> serialization_ver >> compression_mode >> proto_ver
 		>> auth_mechs >> username_legacy;
 
+	// Used by AUTH_MECHANISM_SESSION_KEY (protocol >= 42)
+	if (auth_mechs & AUTH_MECHANISM_SESSION_KEY)
+		*pkt >> m_reauth_challenge;
+
 	// Chose an auth method we support
 	AuthMechanism chosen_auth_mechanism = choseAuthMech(auth_mechs);
 
@@ -116,6 +120,18 @@ void Client::handleCommand_Hello(NetworkPacket* pkt)
 
 void Client::handleCommand_AuthAccept(NetworkPacket* pkt)
 {
+	// Remember the SRP session key, so the next reconnect to this server
+	// can use the cheap reauth path instead of a full SRP exchange
+	if ((m_chosen_auth_mech == AUTH_MECHANISM_SRP ||
+			m_chosen_auth_mech == AUTH_MECHANISM_LEGACY_PASSWORD) &&
+			m_auth_data) {
+		size_t key_len = 0;
+		const unsigned char *key = srp_user_get_session_key(
+			(SRPUser *) m_auth_data, &key_len);
+		if (key && key_len > 0)
+			cacheSessionKey(std::string((const char *) key, key_len));
+	}
+
 	deleteAuthData();
 
 	v3f playerpos;
@@ -175,6 +191,11 @@ void Client::handleCommand_AccessDenied(NetworkPacket* pkt)
 	m_access_denied = true;
 	m_access_denied_reason = "Unknown";
 
+	// If the cheap reauth path failed, forget the stale session key so
+	// the next attempt falls back to a full SRP login
+	if (m_chosen_auth_mech == AUTH_MECHANISM_SESSION_KEY)
+		dropCachedSessionKey();
+
 	if (pkt->getCommand() != TOCLIENT_ACCESS_DENIED) {
 		// 13/03/15 Legacy code from 0.4.12 and lesser but is still used
 		// in some places of the server code
@@ -272,18 +293,8 @@ void Client::handleCommand_NodemetaChanged(NetworkPacket *pkt)
 	}
 }
 
-void Client::handleCommand_BlockData(NetworkPacket* pkt)
+void Client::updateReceivedBlock(v3s16 p, MapBlock *decoded)
 {
-	// Ignore too small packet
-	if (pkt->getSize() < 6)
-		return;
-
-	v3s16 p;
-	*pkt >> p;
-
-	std::string datastring(pkt->getString(6), pkt->getSize() - 6);
-	std::istringstream istr(datastring, std::ios_base::binary);
-
 	MapSector *sector;
 	MapBlock *block;
 
@@ -295,21 +306,22 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	block = sector->getBlockNoCreateNoEx(p.Y);
 	if (block) {
 		/*
-			Update an existing block
+			Update an existing block: take over the decoded contents,
+			keeping the MapBlock pointer stable
 		*/
-		block->deSerialize(istr, m_server_ser_ver, false);
-		block->deSerializeNetworkSpecific(istr);
+		block->absorbDecoded(decoded);
+		delete decoded;
 	}
 	else {
 		/*
-			Create a new block
+			Insert the decoded block as a new block
 		*/
-		block = new MapBlock(&m_env.getMap(), p, this);
-		block->deSerialize(istr, m_server_ser_ver, false);
-		block->deSerializeNetworkSpecific(istr);
+		block = decoded;
 		sector->insertBlock(block);
 	}
 
+	m_env.getMap().reportNodesChange();
+
 	if (m_localdb) {
 		ServerMap::saveBlock(block, m_localdb);
 	}
@@ -320,6 +332,119 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	addUpdateMeshTaskWithEdge(p, true);
 }
 
+void Client::handleCommand_BlockData(NetworkPacket* pkt)
+{
+	// Ignore too small packet
+	if (pkt->getSize() < 6)
+		return;
+
+	v3s16 p;
+	*pkt >> p;
+
+	std::string datastring(pkt->getString(6), pkt->getSize() - 6);
+
+	PendingBlockDecode &pending = m_pending_block_decodes[p];
+	pending.latest_seq = ++m_block_decode_seq;
+	pending.outstanding++;
+	// A newer full payload supersedes any deltas queued so far
+	pending.deltas.clear();
+
+	m_block_decode_thread.enqueueBlock(p, std::move(datastring),
+			m_server_ser_ver, pending.latest_seq);
+}
+
+void Client::handleCommand_BlockDatas(NetworkPacket* pkt)
+{
+	// Ignore too small packet
+	if (pkt->getSize() < 2)
+		return;
+
+	u16 count;
+	*pkt >> count;
+
+	for (u16 i = 0; i < count; i++) {
+		v3s16 p;
+		*pkt >> p;
+
+		PendingBlockDecode &pending = m_pending_block_decodes[p];
+		pending.latest_seq = ++m_block_decode_seq;
+		pending.outstanding++;
+		// A newer full payload supersedes any deltas queued so far
+		pending.deltas.clear();
+
+		m_block_decode_thread.enqueueBlock(p, pkt->readLongString(),
+				m_server_ser_ver, pending.latest_seq);
+	}
+}
+
+void Client::handleCommand_BlockDelta(NetworkPacket* pkt)
+{
+	if (pkt->getSize() < 8)
+		return;
+
+	v3s16 p;
+	u16 count;
+	*pkt >> p >> count;
+
+	std::vector<std::pair<u16, MapNode>> changes;
+	changes.reserve(count);
+	for (u16 i = 0; i < count; i++) {
+		u16 index;
+		MapNode n;
+		*pkt >> index >> n.param0 >> n.param1 >> n.param2;
+
+		if (index >= MapBlock::nodecount)
+			return;
+
+		changes.emplace_back(index, n);
+	}
+
+	auto pending_it = m_pending_block_decodes.find(p);
+	if (pending_it != m_pending_block_decodes.end()) {
+		// A full payload for this block is still being decoded; queue
+		// the delta to be applied right after the merge
+		PendingBlockDecode &pending = pending_it->second;
+		pending.deltas.insert(pending.deltas.end(),
+				changes.begin(), changes.end());
+		return;
+	}
+
+	applyBlockDelta(p, changes);
+}
+
+void Client::applyBlockDelta(v3s16 p,
+		const std::vector<std::pair<u16, MapNode>> &changes)
+{
+	MapBlock *block = m_env.getMap().getBlockNoCreateNoEx(p);
+	if (!block || block->isDummy()) {
+		// We no longer have the block. The server learns of the deletion
+		// from TOSERVER_DELETEDBLOCKS and falls back to a full send.
+		infostream << "Client: Ignoring delta for missing block "
+				<< PP(p) << std::endl;
+		return;
+	}
+
+	for (const auto &change : changes) {
+		v3s16 rel(change.first % MAP_BLOCKSIZE,
+				(change.first / MapBlock::ystride) % MAP_BLOCKSIZE,
+				change.first / MapBlock::zstride);
+		MapNode n = change.second;
+		block->setNodeNoCheck(rel, n);
+	}
+
+	m_env.getMap().reportNodesChange();
+
+	if (m_localdb) {
+		ServerMap::saveBlock(block, m_localdb);
+	}
+
+	/*
+		Add it to mesh update queue and set it to be acknowledged after
+		update, like a full block.
+	*/
+	addUpdateMeshTaskWithEdge(p, true);
+}
+
 void Client::handleCommand_Inventory(NetworkPacket* pkt)
 {
 	if (pkt->getSize() < 1)
@@ -743,6 +868,10 @@ void Client::handleCommand_NodeDef(NetworkPacket* pkt)
 	std::istringstream tmp_is2(tmp_os.str());
 	m_nodedef->deSerialize(tmp_is2);
 	m_nodedef_received = true;
+
+	// Start the media-independent init stages while media downloads
+	if (m_itemdef_received)
+		afterDefinitionsReceived();
 }
 
 void Client::handleCommand_ItemDef(NetworkPacket* pkt)
@@ -763,6 +892,10 @@ void Client::handleCommand_ItemDef(NetworkPacket* pkt)
 	std::istringstream tmp_is2(tmp_os.str());
 	m_itemdef->deSerialize(tmp_is2);
 	m_itemdef_received = true;
+
+	// Start the media-independent init stages while media downloads
+	if (m_nodedef_received)
+		afterDefinitionsReceived();
 }
 
 void Client::handleCommand_PlaySound(NetworkPacket* pkt)
@@ -1428,6 +1561,33 @@ void Client::handleCommand_ModChannelMsg(NetworkPacket *pkt)
 	m_script->on_modchannel_message(channel_name, sender, channel_msg);
 }
 
+void Client::handleCommand_ModChannelMsgs(NetworkPacket *pkt)
+{
+	u16 count;
+	*pkt >> count;
+
+	std::vector<ModChannelMsg> messages;
+	messages.reserve(count);
+	for (u16 i = 0; i < count; i++) {
+		ModChannelMsg msg;
+		*pkt >> msg.channel >> msg.sender >> msg.message;
+
+		if (!m_modchannel_mgr->channelRegistered(msg.channel)) {
+			verbosestream << "Server sent us messages on unregistered channel "
+				<< msg.channel << ", ignoring." << std::endl;
+			continue;
+		}
+		messages.push_back(std::move(msg));
+	}
+
+	verbosestream << "Mod channel message batch received from server "
+		<< pkt->getPeerId() << " (" << messages.size() << " messages)"
+		<< std::endl;
+
+	if (!messages.empty())
+		m_script->on_modchannel_messages(messages);
+}
+
 void Client::handleCommand_ModChannelSignal(NetworkPacket *pkt)
 {
 	u8 signal_tmp;
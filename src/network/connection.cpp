@@ -19,9 +19,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <iomanip>
 #include <cerrno>
+#include <thread>
 #include <algorithm>
 #include <cmath>
 #include "connection.h"
+#include "sessionlog.h"
 #include "serialization.h"
 #include "log.h"
 #include "porting.h"
@@ -56,18 +58,18 @@ std::mutex log_message_mutex;
 
 #define PING_TIMEOUT 5.0
 
-BufferedPacket makePacket(Address &address, const SharedBuffer<u8> &data,
+BufferedPacketPtr makePacket(Address &address, const SharedBuffer<u8> &data,
 		u32 protocol_id, session_t sender_peer_id, u8 channel)
 {
 	u32 packet_size = data.getSize() + BASE_HEADER_SIZE;
-	BufferedPacket p(packet_size);
-	p.address = address;
+	BufferedPacketPtr p = std::make_shared<BufferedPacket>(packet_size);
+	p->address = address;
 
-	writeU32(&p.data[0], protocol_id);
-	writeU16(&p.data[4], sender_peer_id);
-	writeU8(&p.data[6], channel);
+	writeU32(&p->data[0], protocol_id);
+	writeU16(&p->data[4], sender_peer_id);
+	writeU8(&p->data[6], channel);
 
-	memcpy(&p.data[BASE_HEADER_SIZE], *data, data.getSize());
+	memcpy(&p->data[BASE_HEADER_SIZE], *data, data.getSize());
 
 	return p;
 }
@@ -163,8 +165,8 @@ void ReliablePacketBuffer::print()
 	MutexAutoLock listlock(m_list_mutex);
 	LOG(dout_con<<"Dump of ReliablePacketBuffer:" << std::endl);
 	unsigned int index = 0;
-	for (BufferedPacket &bufferedPacket : m_list) {
-		u16 s = readU16(&(bufferedPacket.data[BASE_HEADER_SIZE+1]));
+	for (BufferedPacketPtr &bufferedPacket : m_list) {
+		u16 s = readU16(&(bufferedPacket->data[BASE_HEADER_SIZE+1]));
 		LOG(dout_con<<index<< ":" << s << std::endl);
 		index++;
 	}
@@ -184,14 +186,10 @@ u32 ReliablePacketBuffer::size()
 
 RPBSearchResult ReliablePacketBuffer::findPacket(u16 seqnum)
 {
-	std::list<BufferedPacket>::iterator i = m_list.begin();
-	for(; i != m_list.end(); ++i)
-	{
-		u16 s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
-		if (s == seqnum)
-			break;
-	}
-	return i;
+	std::unordered_map<u16, RPBSearchResult>::iterator i = m_index.find(seqnum);
+	if (i == m_index.end())
+		return m_list.end();
+	return i->second;
 }
 
 RPBSearchResult ReliablePacketBuffer::notFound()
@@ -204,29 +202,30 @@ bool ReliablePacketBuffer::getFirstSeqnum(u16& result)
 	MutexAutoLock listlock(m_list_mutex);
 	if (m_list.empty())
 		return false;
-	const BufferedPacket &p = *m_list.begin();
-	result = readU16(&p.data[BASE_HEADER_SIZE + 1]);
+	const BufferedPacketPtr &p = *m_list.begin();
+	result = readU16(&p->data[BASE_HEADER_SIZE + 1]);
 	return true;
 }
 
-BufferedPacket ReliablePacketBuffer::popFirst()
+BufferedPacketPtr ReliablePacketBuffer::popFirst()
 {
 	MutexAutoLock listlock(m_list_mutex);
 	if (m_list.empty())
 		throw NotFoundException("Buffer is empty");
-	BufferedPacket p = *m_list.begin();
+	BufferedPacketPtr p = *m_list.begin();
+	m_index.erase(readU16(&p->data[BASE_HEADER_SIZE + 1]));
 	m_list.erase(m_list.begin());
 
 	if (m_list.empty()) {
 		m_oldest_non_answered_ack = 0;
 	} else {
 		m_oldest_non_answered_ack =
-				readU16(&m_list.begin()->data[BASE_HEADER_SIZE + 1]);
+				readU16(&(*m_list.begin())->data[BASE_HEADER_SIZE + 1]);
 	}
 	return p;
 }
 
-BufferedPacket ReliablePacketBuffer::popSeqnum(u16 seqnum)
+BufferedPacketPtr ReliablePacketBuffer::popSeqnum(u16 seqnum)
 {
 	MutexAutoLock listlock(m_list_mutex);
 	RPBSearchResult r = findPacket(seqnum);
@@ -235,42 +234,43 @@ BufferedPacket ReliablePacketBuffer::popSeqnum(u16 seqnum)
 				<< " not found in reliable buffer"<<std::endl);
 		throw NotFoundException("seqnum not found in buffer");
 	}
-	BufferedPacket p = *r;
+	BufferedPacketPtr p = *r;
 
 
 	RPBSearchResult next = r;
 	++next;
 	if (next != notFound()) {
-		u16 s = readU16(&(next->data[BASE_HEADER_SIZE+1]));
+		u16 s = readU16(&((*next)->data[BASE_HEADER_SIZE+1]));
 		m_oldest_non_answered_ack = s;
 	}
 
+	m_index.erase(seqnum);
 	m_list.erase(r);
 
 	if (m_list.empty()) {
 		m_oldest_non_answered_ack = 0;
 	} else {
 		m_oldest_non_answered_ack =
-				readU16(&m_list.begin()->data[BASE_HEADER_SIZE + 1]);
+				readU16(&(*m_list.begin())->data[BASE_HEADER_SIZE + 1]);
 	}
 	return p;
 }
 
-void ReliablePacketBuffer::insert(BufferedPacket &p, u16 next_expected)
+void ReliablePacketBuffer::insert(const BufferedPacketPtr &p, u16 next_expected)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	if (p.data.getSize() < BASE_HEADER_SIZE + 3) {
+	if (p->data.getSize() < BASE_HEADER_SIZE + 3) {
 		errorstream << "ReliablePacketBuffer::insert(): Invalid data size for "
 			"reliable packet" << std::endl;
 		return;
 	}
-	u8 type = readU8(&p.data[BASE_HEADER_SIZE + 0]);
+	u8 type = readU8(&p->data[BASE_HEADER_SIZE + 0]);
 	if (type != PACKET_TYPE_RELIABLE) {
 		errorstream << "ReliablePacketBuffer::insert(): type is not reliable"
 			<< std::endl;
 		return;
 	}
-	u16 seqnum = readU16(&p.data[BASE_HEADER_SIZE + 1]);
+	u16 seqnum = readU16(&p->data[BASE_HEADER_SIZE + 1]);
 
 	if (!seqnum_in_window(seqnum, next_expected, MAX_RELIABLE_WINDOW_SIZE)) {
 		errorstream << "ReliablePacketBuffer::insert(): seqnum is outside of "
@@ -290,15 +290,16 @@ void ReliablePacketBuffer::insert(BufferedPacket &p, u16 next_expected)
 	if (m_list.empty())
 	{
 		m_list.push_back(p);
+		m_index[seqnum] = m_list.begin();
 		m_oldest_non_answered_ack = seqnum;
 		// Done.
 		return;
 	}
 
 	// Otherwise find the right place
-	std::list<BufferedPacket>::iterator i = m_list.begin();
+	std::list<BufferedPacketPtr>::iterator i = m_list.begin();
 	// Find the first packet in the list which has a higher seqnum
-	u16 s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
+	u16 s = readU16(&((*i)->data[BASE_HEADER_SIZE+1]));
 
 	/* case seqnum is smaller then next_expected seqnum */
 	/* this is true e.g. on wrap around */
@@ -306,7 +307,7 @@ void ReliablePacketBuffer::insert(BufferedPacket &p, u16 next_expected)
 		while(((s < seqnum) || (s >= next_expected)) && (i != m_list.end())) {
 			++i;
 			if (i != m_list.end())
-				s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
+				s = readU16(&((*i)->data[BASE_HEADER_SIZE+1]));
 		}
 	}
 	/* non wrap around case (at least for incoming and next_expected */
@@ -315,7 +316,7 @@ void ReliablePacketBuffer::insert(BufferedPacket &p, u16 next_expected)
 		while(((s < seqnum) && (s >= next_expected)) && (i != m_list.end())) {
 			++i;
 			if (i != m_list.end())
-				s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
+				s = readU16(&((*i)->data[BASE_HEADER_SIZE+1]));
 		}
 	}
 
@@ -323,9 +324,9 @@ void ReliablePacketBuffer::insert(BufferedPacket &p, u16 next_expected)
 		/* nothing to do this seems to be a resent packet */
 		/* for paranoia reason data should be compared */
 		if (
-			(readU16(&(i->data[BASE_HEADER_SIZE+1])) != seqnum) ||
-			(i->data.getSize() != p.data.getSize()) ||
-			(i->address != p.address)
+			(readU16(&((*i)->data[BASE_HEADER_SIZE+1])) != seqnum) ||
+			((*i)->data.getSize() != p->data.getSize()) ||
+			((*i)->address != p->address)
 			)
 		{
 			/* if this happens your maximum transfer window may be to big */
@@ -333,45 +334,46 @@ void ReliablePacketBuffer::insert(BufferedPacket &p, u16 next_expected)
 					"Duplicated seqnum %d non matching packet detected:\n",
 					seqnum);
 			fprintf(stderr, "Old: seqnum: %05d size: %04d, address: %s\n",
-					readU16(&(i->data[BASE_HEADER_SIZE+1])),i->data.getSize(),
-					i->address.serializeString().c_str());
+					readU16(&((*i)->data[BASE_HEADER_SIZE+1])),(*i)->data.getSize(),
+					(*i)->address.serializeString().c_str());
 			fprintf(stderr, "New: seqnum: %05d size: %04u, address: %s\n",
-					readU16(&(p.data[BASE_HEADER_SIZE+1])),p.data.getSize(),
-					p.address.serializeString().c_str());
+					readU16(&(p->data[BASE_HEADER_SIZE+1])),p->data.getSize(),
+					p->address.serializeString().c_str());
 			throw IncomingDataCorruption("duplicated packet isn't same as original one");
 		}
 	}
 	/* insert or push back */
 	else if (i != m_list.end()) {
-		m_list.insert(i, p);
+		m_index[seqnum] = m_list.insert(i, p);
 	} else {
 		m_list.push_back(p);
+		m_index[seqnum] = --m_list.end();
 	}
 
 	/* update last packet number */
-	m_oldest_non_answered_ack = readU16(&(*m_list.begin()).data[BASE_HEADER_SIZE+1]);
+	m_oldest_non_answered_ack = readU16(&(*m_list.begin())->data[BASE_HEADER_SIZE+1]);
 }
 
 void ReliablePacketBuffer::incrementTimeouts(float dtime)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	for (BufferedPacket &bufferedPacket : m_list) {
-		bufferedPacket.time += dtime;
-		bufferedPacket.totaltime += dtime;
+	for (BufferedPacketPtr &bufferedPacket : m_list) {
+		bufferedPacket->time += dtime;
+		bufferedPacket->totaltime += dtime;
 	}
 }
 
-std::list<BufferedPacket> ReliablePacketBuffer::getTimedOuts(float timeout,
+std::list<BufferedPacketPtr> ReliablePacketBuffer::getTimedOuts(float timeout,
 													unsigned int max_packets)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	std::list<BufferedPacket> timed_outs;
-	for (BufferedPacket &bufferedPacket : m_list) {
-		if (bufferedPacket.time >= timeout) {
+	std::list<BufferedPacketPtr> timed_outs;
+	for (BufferedPacketPtr &bufferedPacket : m_list) {
+		if (bufferedPacket->time >= timeout) {
 			timed_outs.push_back(bufferedPacket);
 
 			//this packet will be sent right afterwards reset timeout here
-			bufferedPacket.time = 0.0f;
+			bufferedPacket->time = 0.0f;
 			if (timed_outs.size() >= max_packets)
 				break;
 		}
@@ -651,7 +653,7 @@ void Channel::UpdatePacketTooLateCounter()
 	current_packet_too_late++;
 }
 
-void Channel::UpdateTimers(float dtime)
+void Channel::UpdateTimers(float dtime, float rtt_min, float rtt_avg)
 {
 	bpm_counter += dtime;
 	packet_loss_counter += dtime;
@@ -679,44 +681,71 @@ void Channel::UpdateTimers(float dtime)
 			current_packet_successful = 0;
 		}
 
-		/* dynamic window size */
-		float successful_to_lost_ratio = 0.0f;
-		bool done = false;
-
-		if (packets_successful > 0) {
-			successful_to_lost_ratio = packet_loss/packets_successful;
-		} else if (packet_loss > 0) {
-			window_size = std::max(
-					(window_size - 10),
-					MIN_RELIABLE_WINDOW_SIZE);
-			done = true;
-		}
-
-		if (!done) {
-			if ((successful_to_lost_ratio < 0.01f) &&
-				(window_size < MAX_RELIABLE_WINDOW_SIZE)) {
-				/* don't even think about increasing if we didn't even
-				 * use major parts of our window */
-				if (reasonable_amount_of_data_transmitted)
-					window_size = std::min(
-							(window_size + 100),
-							MAX_RELIABLE_WINDOW_SIZE);
-			} else if ((successful_to_lost_ratio < 0.05f) &&
-					(window_size < MAX_RELIABLE_WINDOW_SIZE)) {
-				/* don't even think about increasing if we didn't even
-				 * use major parts of our window */
+		if (m_delay_based_control && rtt_min > 0.0f && rtt_avg > 0.0f) {
+			/* Delay-based window control: grow while the measured RTT stays
+			 * near the propagation delay, back off only once queueing delay
+			 * shows up at the bottleneck. Isolated losses don't shrink the
+			 * window, which keeps bulk map transfer going on lossy WAN links.
+			 */
+			if (rtt_avg < rtt_min * 1.25f) {
+				/* no queue visible: probe for more bandwidth */
 				if (reasonable_amount_of_data_transmitted)
 					window_size = std::min(
-							(window_size + 50),
+							(window_size + std::max(window_size / 4, 10)),
 							MAX_RELIABLE_WINDOW_SIZE);
-			} else if (successful_to_lost_ratio > 0.15f) {
+			} else if (rtt_avg > rtt_min * 1.5f) {
+				/* queue is building up: drain it */
 				window_size = std::max(
-						(window_size - 100),
+						(window_size - std::max(window_size / 8, 10)),
 						MIN_RELIABLE_WINDOW_SIZE);
-			} else if (successful_to_lost_ratio > 0.1f) {
+			}
+
+			/* never go below the measured bandwidth-delay product;
+			 * packets_successful is a one second sample, so it doubles as
+			 * a delivery rate in packets per second */
+			int bdp_packets = (int) (packets_successful * rtt_min) + 1;
+			window_size = std::max(window_size,
+					std::min(bdp_packets, MAX_RELIABLE_WINDOW_SIZE));
+		} else {
+			/* dynamic window size */
+			float successful_to_lost_ratio = 0.0f;
+			bool done = false;
+
+			if (packets_successful > 0) {
+				successful_to_lost_ratio = packet_loss/packets_successful;
+			} else if (packet_loss > 0) {
 				window_size = std::max(
-						(window_size - 50),
+						(window_size - 10),
 						MIN_RELIABLE_WINDOW_SIZE);
+				done = true;
+			}
+
+			if (!done) {
+				if ((successful_to_lost_ratio < 0.01f) &&
+					(window_size < MAX_RELIABLE_WINDOW_SIZE)) {
+					/* don't even think about increasing if we didn't even
+					 * use major parts of our window */
+					if (reasonable_amount_of_data_transmitted)
+						window_size = std::min(
+								(window_size + 100),
+								MAX_RELIABLE_WINDOW_SIZE);
+				} else if ((successful_to_lost_ratio < 0.05f) &&
+						(window_size < MAX_RELIABLE_WINDOW_SIZE)) {
+					/* don't even think about increasing if we didn't even
+					 * use major parts of our window */
+					if (reasonable_amount_of_data_transmitted)
+						window_size = std::min(
+								(window_size + 50),
+								MAX_RELIABLE_WINDOW_SIZE);
+				} else if (successful_to_lost_ratio > 0.15f) {
+					window_size = std::max(
+							(window_size - 100),
+							MIN_RELIABLE_WINDOW_SIZE);
+				} else if (successful_to_lost_ratio > 0.1f) {
+					window_size = std::max(
+							(window_size - 50),
+							MIN_RELIABLE_WINDOW_SIZE);
+				}
 			}
 		}
 	}
@@ -917,8 +946,11 @@ void Peer::Drop()
 UDPPeer::UDPPeer(u16 a_id, Address a_address, Connection* connection) :
 	Peer(a_address,a_id,connection)
 {
-	for (Channel &channel : channels)
+	const bool delay_based = g_settings->get("congestion_control") == "delay";
+	for (Channel &channel : channels) {
 		channel.setWindowSize(g_settings->getU16("max_packets_per_iteration"));
+		channel.setDelayBasedControl(delay_based);
+	}
 }
 
 bool UDPPeer::getAddress(MTProtocols type,Address& toset)
@@ -1013,7 +1045,7 @@ bool UDPPeer::processReliableSendCommand(
 
 	bool have_sequence_number = true;
 	bool have_initial_sequence_number = false;
-	std::queue<BufferedPacket> toadd;
+	std::queue<BufferedPacketPtr> toadd;
 	volatile u16 initial_sequence_number = 0;
 
 	for (SharedBuffer<u8> &original : originals) {
@@ -1032,7 +1064,7 @@ bool UDPPeer::processReliableSendCommand(
 		SharedBuffer<u8> reliable = makeReliablePacket(original, seqnum);
 
 		// Add base headers and make a packet
-		BufferedPacket p = con::makePacket(address, reliable,
+		BufferedPacketPtr p = con::makePacket(address, reliable,
 				m_connection->GetProtocolID(), m_connection->GetPeerID(),
 				c.channelnum);
 
@@ -1042,7 +1074,7 @@ bool UDPPeer::processReliableSendCommand(
 	if (have_sequence_number) {
 		volatile u16 pcount = 0;
 		while (!toadd.empty()) {
-			BufferedPacket p = toadd.front();
+			BufferedPacketPtr p = toadd.front();
 			toadd.pop();
 //			LOG(dout_con<<connection->getDesc()
 //					<< " queuing reliable packet for peer_id: " << c.peer_id
@@ -1148,10 +1180,14 @@ SharedBuffer<u8> UDPPeer::addSplitPacket(u8 channel, const BufferedPacket &toadd
 Connection::Connection(u32 protocol_id, u32 max_packet_size, float timeout,
 		bool ipv6, PeerHandler *peerhandler) :
 	m_udpSocket(ipv6),
+	m_command_queue(COMMAND_QUEUE_CAPACITY),
+	m_event_queue(EVENT_QUEUE_CAPACITY),
 	m_protocol_id(protocol_id),
 	m_sendThread(new ConnectionSendThread(max_packet_size, timeout)),
 	m_receiveThread(new ConnectionReceiveThread(max_packet_size)),
-	m_bc_peerhandler(peerhandler)
+	m_bc_peerhandler(peerhandler),
+	m_max_packet_size(max_packet_size),
+	m_receive_thread_count(g_settings->getU16("receive_thread_count"))
 
 {
 	m_udpSocket.setTimeoutMs(5);
@@ -1163,6 +1199,56 @@ Connection::Connection(u32 protocol_id, u32 max_packet_size, float timeout,
 	m_receiveThread->start();
 }
 
+void Connection::prepareShardReceive()
+{
+	if (m_receive_thread_count <= 1)
+		return;
+
+	// All sockets sharing the port need SO_REUSEPORT before binding
+	m_shard_receive_possible = m_udpSocket.enableReusePort();
+	if (!m_shard_receive_possible) {
+		warningstream << getDesc() << " receive_thread_count > 1 but "
+			"SO_REUSEPORT is not available, using a single "
+			"receive thread" << std::endl;
+	}
+}
+
+void Connection::startShardReceiveThreads(Address bind_address)
+{
+	if (!m_shard_receive_possible || !m_shard_receive_threads.empty())
+		return;
+
+	for (u16 i = 1; i < m_receive_thread_count; i++) {
+		std::unique_ptr<UDPSocket> socket(
+			new UDPSocket(bind_address.isIPv6()));
+		socket->setTimeoutMs(5);
+
+		if (!socket->enableReusePort())
+			return;
+
+		try {
+			socket->Bind(bind_address);
+		} catch (SocketException &e) {
+			errorstream << getDesc() << " failed to bind receive "
+				"shard " << i << ": " << e.what() << std::endl;
+			return;
+		}
+
+		std::unique_ptr<ConnectionReceiveThread> thread(
+			new ConnectionReceiveThread(m_max_packet_size));
+		thread->setParent(this);
+		thread->setShardSocket(socket.get(), i);
+		thread->start();
+
+		m_shard_sockets.push_back(std::move(socket));
+		m_shard_receive_threads.push_back(std::move(thread));
+	}
+
+	dout_con << getDesc() << " receiving on "
+		<< (m_shard_receive_threads.size() + 1)
+		<< " sharded sockets" << std::endl;
+}
+
 
 Connection::~Connection()
 {
@@ -1170,6 +1256,8 @@ Connection::~Connection()
 	// request threads to stop
 	m_sendThread->stop();
 	m_receiveThread->stop();
+	for (auto &thread : m_shard_receive_threads)
+		thread->stop();
 
 	//TODO for some unkonwn reason send/receive threads do not exit as they're
 	// supposed to be but wait on peer timeout. To speed up shutdown we reduce
@@ -1179,6 +1267,8 @@ Connection::~Connection()
 	// wait for threads to finish
 	m_sendThread->wait();
 	m_receiveThread->wait();
+	for (auto &thread : m_shard_receive_threads)
+		thread->wait();
 
 	// Delete peers
 	for (auto &peer : m_peers) {
@@ -1190,7 +1280,26 @@ Connection::~Connection()
 void Connection::putEvent(ConnectionEvent &e)
 {
 	assert(e.type != CONNEVENT_NONE); // Pre-condition
-	m_event_queue.push_back(e);
+
+	// Attribute incoming traffic to the packet type
+	if (e.type == CONNEVENT_DATA_RECEIVED && e.data.getSize() >= 2)
+		m_rx_pkt_stats.record(readU16(&e.data[0]), e.data.getSize());
+
+	// The ring only fills up if the consumer stalls for a long time.
+	// Events must never be dropped.
+	while (!m_event_queue.push_back(e))
+		std::this_thread::yield();
+	m_event_signal.post();
+}
+
+void Connection::printPacketTypeStats(std::ostream &os)
+{
+	// Which command name table applies depends on which end we are
+	bool is_server = m_peer_id == PEER_ID_SERVER;
+	os << "Sent:" << std::endl;
+	m_tx_pkt_stats.report(os, is_server);
+	os << "Received:" << std::endl;
+	m_rx_pkt_stats.report(os, !is_server);
 }
 
 void Connection::TriggerSend()
@@ -1268,21 +1377,27 @@ bool Connection::deletePeer(session_t peer_id, bool timeout)
 
 ConnectionEvent Connection::waitEvent(u32 timeout_ms)
 {
-	try {
-		return m_event_queue.pop_front(timeout_ms);
-	} catch(ItemNotFoundException &ex) {
-		ConnectionEvent e;
-		e.type = CONNEVENT_NONE;
-		return e;
-	}
+	ConnectionEvent e;
+	// The semaphore count equals the number of queued events, so the
+	// pop always succeeds after a successful wait
+	if (m_event_signal.wait(timeout_ms))
+		m_event_queue.pop_front(&e);
+	return e;
 }
 
 void Connection::putCommand(ConnectionCommand &c)
 {
-	if (!m_shutting_down) {
-		m_command_queue.push_back(c);
+	if (m_shutting_down)
+		return;
+
+	// The ring only fills up if the send thread stalls; it drains the
+	// whole queue at least every 50ms, so waiting here is rare and short.
+	// Commands must never be dropped.
+	while (!m_command_queue.push_back(c)) {
 		m_sendThread->Trigger();
+		std::this_thread::yield();
 	}
+	m_sendThread->Trigger();
 }
 
 void Connection::Serve(Address bind_addr)
@@ -1339,15 +1454,22 @@ void Connection::Receive(NetworkPacket* pkt)
 				continue;
 			}
 
+			if (m_session_log)
+				m_session_log->writeData(e.peer_id, *e.data,
+						e.data.getSize());
 			pkt->putRawPacket(*e.data, e.data.getSize(), e.peer_id);
 			return;
 		case CONNEVENT_PEER_ADDED: {
+			if (m_session_log)
+				m_session_log->writePeerAdded(e.peer_id);
 			UDPPeer tmp(e.peer_id, e.address, this);
 			if (m_bc_peerhandler)
 				m_bc_peerhandler->peerAdded(&tmp);
 			continue;
 		}
 		case CONNEVENT_PEER_REMOVED: {
+			if (m_session_log)
+				m_session_log->writePeerRemoved(e.peer_id, e.timeout);
 			UDPPeer tmp(e.peer_id, e.address, this);
 			if (m_bc_peerhandler)
 				m_bc_peerhandler->deletingPeer(&tmp, e.timeout);
@@ -1361,6 +1483,22 @@ void Connection::Receive(NetworkPacket* pkt)
 	throw NoIncomingDataException("No incoming data");
 }
 
+bool Connection::startRecording(const std::string &path)
+{
+	auto log = std::make_unique<SessionLogWriter>();
+	if (!log->open(path))
+		return false;
+	m_session_log = std::move(log);
+	actionstream << getDesc() << ": recording session to "" << path
+		<< """ << std::endl;
+	return true;
+}
+
+void Connection::stopRecording()
+{
+	m_session_log.reset();
+}
+
 void Connection::Send(session_t peer_id, u8 channelnum,
 		NetworkPacket *pkt, bool reliable)
 {
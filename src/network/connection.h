@@ -28,10 +28,16 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/thread.h"
 #include "util/numeric.h"
 #include "networkprotocol.h"
+#include "networkstats.h"
 #include <iostream>
 #include <fstream>
 #include <list>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class SessionLogWriter;
 
 class NetworkPacket;
 
@@ -51,6 +57,11 @@ typedef enum MTProtocols {
 
 #define SEQNUM_MAX 65535
 
+// Size of the lock-free command ring between the other threads and the
+// send thread. Must be a power of two.
+#define COMMAND_QUEUE_CAPACITY 1024
+#define EVENT_QUEUE_CAPACITY 4096
+
 inline bool seqnum_higher(u16 totest, u16 base)
 {
 	if (totest > base)
@@ -102,8 +113,16 @@ struct BufferedPacket
 	unsigned int resend_count = 0;
 };
 
+/*
+	BufferedPackets are passed around by refcounted pointer so that queueing,
+	buffering for resend and resending never copy the payload. shared_ptr
+	refcounting is atomic, so the pointers may cross the send/receive thread
+	boundary.
+*/
+typedef std::shared_ptr<BufferedPacket> BufferedPacketPtr;
+
 // This adds the base headers to the data and makes a packet out of it
-BufferedPacket makePacket(Address &address, const SharedBuffer<u8> &data,
+BufferedPacketPtr makePacket(Address &address, const SharedBuffer<u8> &data,
 		u32 protocol_id, session_t sender_peer_id, u8 channel);
 
 // Depending on size, make a TYPE_ORIGINAL or TYPE_SPLIT packet
@@ -220,12 +239,29 @@ with a buffer in the receiving and transmitting end.
 //#define TYPE_RELIABLE 3
 #define RELIABLE_HEADER_SIZE 3
 #define SEQNUM_INITIAL 65500
+/*
+BATCH: Several complete packets (without their base headers) coalesced
+into one datagram to cut per-packet overhead. Each sub-packet is
+prefixed with its size and processed exactly as if it had arrived in
+its own datagram.
+- Only sent when the packet_batching setting is enabled; peers that
+  don't know this type drop the whole datagram.
+	Header (1 byte):
+	[0] u8 type
+	then for each sub-packet:
+	[+0] u16 size
+	[+2] u8[size] packet, starting with its own u8 type
+*/
+#define BATCH_HEADER_SIZE 1
+// Max total size of a batch datagram; must stay below the receive buffer (1500)
+#define MAX_BATCH_PACKET_SIZE 1400
 
 enum PacketType: u8 {
 	PACKET_TYPE_CONTROL = 0,
 	PACKET_TYPE_ORIGINAL = 1,
 	PACKET_TYPE_SPLIT = 2,
 	PACKET_TYPE_RELIABLE = 3,
+	PACKET_TYPE_BATCH = 4,
 	PACKET_TYPE_MAX
 };
 /*
@@ -233,7 +269,7 @@ enum PacketType: u8 {
 	for fast access to the smallest one.
 */
 
-typedef std::list<BufferedPacket>::iterator RPBSearchResult;
+typedef std::list<BufferedPacketPtr>::iterator RPBSearchResult;
 
 class ReliablePacketBuffer
 {
@@ -242,12 +278,12 @@ public:
 
 	bool getFirstSeqnum(u16& result);
 
-	BufferedPacket popFirst();
-	BufferedPacket popSeqnum(u16 seqnum);
-	void insert(BufferedPacket &p, u16 next_expected);
+	BufferedPacketPtr popFirst();
+	BufferedPacketPtr popSeqnum(u16 seqnum);
+	void insert(const BufferedPacketPtr &p, u16 next_expected);
 
 	void incrementTimeouts(float dtime);
-	std::list<BufferedPacket> getTimedOuts(float timeout,
+	std::list<BufferedPacketPtr> getTimedOuts(float timeout,
 			unsigned int max_packets);
 
 	void print();
@@ -259,7 +295,10 @@ public:
 private:
 	RPBSearchResult findPacket(u16 seqnum); // does not perform locking
 
-	std::list<BufferedPacket> m_list;
+	std::list<BufferedPacketPtr> m_list;
+	// Index into m_list by sequence number, so that each incoming ACK
+	// finds its packet in O(1) instead of scanning the send window
+	std::unordered_map<u16, RPBSearchResult> m_index;
 
 	u16 m_oldest_non_answered_ack;
 
@@ -416,7 +455,7 @@ public:
 	ReliablePacketBuffer outgoing_reliables_sent;
 
 	//queued reliable packets
-	std::queue<BufferedPacket> queued_reliables;
+	std::queue<BufferedPacketPtr> queued_reliables;
 
 	//queue commands prior splitting to packets
 	std::deque<ConnectionCommand> queued_commands;
@@ -432,7 +471,7 @@ public:
 	void UpdateBytesLost(unsigned int bytes);
 	void UpdateBytesReceived(unsigned int bytes);
 
-	void UpdateTimers(float dtime);
+	void UpdateTimers(float dtime, float rtt_min, float rtt_avg);
 
 	const float getCurrentDownloadRateKB()
 		{ MutexAutoLock lock(m_internal_mutex); return cur_kbps; };
@@ -459,9 +498,14 @@ public:
 	const unsigned int getWindowSize() const { return window_size; };
 
 	void setWindowSize(unsigned int size) { window_size = size; };
+
+	// Selects between the classic loss-ratio window control and the
+	// delay-based one ("congestion_control" setting)
+	void setDelayBasedControl(bool enable) { m_delay_based_control = enable; };
 private:
 	std::mutex m_internal_mutex;
 	int window_size = MIN_RELIABLE_WINDOW_SIZE;
+	bool m_delay_based_control = false;
 
 	u16 next_incoming_seqnum = SEQNUM_INITIAL;
 
@@ -555,6 +599,15 @@ class Peer {
 
 		bool isTimedOut(float timeout);
 
+		/*
+			Receive shard this peer's packets arrive on (SO_REUSEPORT
+			sharding). The kernel hashes a sender consistently to one
+			socket, so this is stable; each receive thread only drains
+			the ordered buffers of its own peers.
+		*/
+		u8 getReceiveShard() const { return m_receive_shard; }
+		void setReceiveShard(u8 shard) { m_receive_shard = shard; }
+
 		unsigned int m_increment_packets_remaining = 9;
 		unsigned int m_increment_bytes_remaining = 0;
 
@@ -623,6 +676,8 @@ class Peer {
 		rttstats m_rtt;
 		float m_last_rtt = -1.0f;
 
+		u8 m_receive_shard = 0;
+
 		// current usage count
 		unsigned int m_usage = 0;
 
@@ -780,6 +835,33 @@ public:
 	const std::string getDesc();
 	void DisconnectPeer(session_t peer_id);
 
+	/*
+		Session recording and replay (see network/sessionlog.h).
+
+		Recording captures every event handed to the application by
+		Receive() with a timestamp; it runs on the receiving thread, so
+		no extra locking is involved.
+	*/
+	bool startRecording(const std::string &path);
+	void stopRecording();
+
+	// Creates a server-side peer without any network handshake and
+	// returns its id (or PEER_ID_INEXISTENT). The PEER_ADDED event
+	// reaches the application as usual; outgoing packets go to the
+	// given address, which the replay driver points at loopback.
+	session_t simulatePeer(Address &address)
+	{
+		return createPeer(address, MTP_MINETEST_RELIABLE_UDP, 0);
+	}
+
+	// Re-enqueues a recorded payload as if it had just been received
+	void injectReceivedData(session_t peer_id, const SharedBuffer<u8> &data)
+	{
+		ConnectionEvent e;
+		e.dataReceived(peer_id, data);
+		putEvent(e);
+	}
+
 protected:
 	PeerHelper getPeerNoEx(session_t peer_id);
 	u16   lookupPeer(Address& sender);
@@ -801,13 +883,36 @@ protected:
 	}
 
 	UDPSocket m_udpSocket;
-	MutexedQueue<ConnectionCommand> m_command_queue;
+	// Lock-free: filled by the env and receive threads, drained in bulk
+	// by the send thread. Capacity must be a power of two.
+	MPSCQueue<ConnectionCommand> m_command_queue;
+
+	// Per-packet-type traffic counters, keyed by the command id at the
+	// start of each payload. Updated by the connection threads.
+	PacketTypeStats m_tx_pkt_stats;
+	PacketTypeStats m_rx_pkt_stats;
+
+	// Writes tables of the per-packet-type counters of both directions
+	void printPacketTypeStats(std::ostream &os);
 
 	void putEvent(ConnectionEvent &e);
 
 	void TriggerSend();
+
+	/*
+		SO_REUSEPORT receive sharding ("receive_thread_count" setting).
+		prepareShardReceive() must run before the main socket binds;
+		startShardReceiveThreads() binds the extra sockets to the same
+		address and starts one receive thread per socket.
+	*/
+	void prepareShardReceive();
+	void startShardReceiveThreads(Address bind_address);
 private:
-	MutexedQueue<ConnectionEvent> m_event_queue;
+	// Lock-free: filled by the connection threads, drained by the
+	// game-side thread in waitEvent(). The semaphore carries the item
+	// count so waitEvent() can sleep with a timeout.
+	MPMCQueue<ConnectionEvent> m_event_queue;
+	Semaphore m_event_signal;
 
 	session_t m_peer_id = 0;
 	u32 m_protocol_id;
@@ -819,6 +924,13 @@ private:
 	std::unique_ptr<ConnectionSendThread> m_sendThread;
 	std::unique_ptr<ConnectionReceiveThread> m_receiveThread;
 
+	// Extra receive sockets/threads for SO_REUSEPORT sharding
+	std::vector<std::unique_ptr<UDPSocket>> m_shard_sockets;
+	std::vector<std::unique_ptr<ConnectionReceiveThread>> m_shard_receive_threads;
+	u32 m_max_packet_size;
+	u16 m_receive_thread_count;
+	bool m_shard_receive_possible = false;
+
 	std::mutex m_info_mutex;
 
 	// Backwards compatibility
@@ -828,6 +940,9 @@ private:
 	bool m_shutting_down = false;
 
 	session_t m_next_remote_peer_id = 2;
+
+	// Only accessed by the thread calling Receive()
+	std::unique_ptr<SessionLogWriter> m_session_log;
 };
 
 } // namespace
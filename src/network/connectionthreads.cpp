@@ -62,6 +62,35 @@ static u8 readChannel(u8 *packetdata)
 	return readU8(&packetdata[6]);
 }
 
+/*
+	Extracts the command id of the payload carried by a buffered reliable,
+	for per-packet-type statistics. Returns false if it cannot be
+	determined (control packets, SPLIT chunks other than the first).
+*/
+static bool getCommandFromReliable(const BufferedPacket &p, u16 *command)
+{
+	u32 off = BASE_HEADER_SIZE + RELIABLE_HEADER_SIZE;
+	if (p.data.getSize() < off + 1)
+		return false;
+
+	u8 type = readU8(&p.data[off]);
+	off += 1;
+	if (type == PACKET_TYPE_SPLIT) {
+		// Only the first chunk starts with the command id
+		// (u16 seqnum, u16 chunk_count, u16 chunk_num before the data)
+		if (p.data.getSize() < off + 6 || readU16(&p.data[off + 4]) != 0)
+			return false;
+		off += 6;
+	} else if (type != PACKET_TYPE_ORIGINAL) {
+		return false;
+	}
+
+	if (p.data.getSize() < off + 2)
+		return false;
+	*command = readU16(&p.data[off]);
+	return true;
+}
+
 /******************************************************************************/
 /* Connection Threads                                                         */
 /******************************************************************************/
@@ -71,7 +100,8 @@ ConnectionSendThread::ConnectionSendThread(unsigned int max_packet_size,
 	Thread("ConnectionSend"),
 	m_max_packet_size(max_packet_size),
 	m_timeout(timeout),
-	m_max_data_packets_per_iteration(g_settings->getU16("max_packets_per_iteration"))
+	m_max_data_packets_per_iteration(g_settings->getU16("max_packets_per_iteration")),
+	m_enable_packet_batching(g_settings->getBool("packet_batching"))
 {
 }
 
@@ -111,14 +141,30 @@ void *ConnectionSendThread::run()
 		runTimeouts(dtime);
 
 		/* translate commands to packets */
-		ConnectionCommand c = m_connection->m_command_queue.pop_frontNoEx(0);
-		while (c.type != CONNCMD_NONE) {
+		// Taken in bulk so the synchronization cost is amortized over
+		// all commands queued since the last iteration
+		m_command_batch.clear();
+		m_connection->m_command_queue.pop_bulk(m_command_batch,
+				COMMAND_QUEUE_CAPACITY);
+		for (ConnectionCommand &c : m_command_batch) {
+			// Attribute outgoing traffic to the packet type
+			if ((c.type == CONNCMD_SEND || c.type == CONNCMD_SEND_TO_ALL) &&
+					c.data.getSize() >= 2)
+				m_connection->m_tx_pkt_stats.record(readU16(&c.data[0]),
+					c.data.getSize());
+
 			if (c.reliable)
 				processReliableCommand(c);
 			else
 				processNonReliableCommand(c);
+		}
 
-			c = m_connection->m_command_queue.pop_frontNoEx(0);
+		/* feed per-type tx counters to the profiler now and then */
+		m_profiler_dump_timer += dtime;
+		if (m_profiler_dump_timer > 10.0f) {
+			m_profiler_dump_timer = 0.0f;
+			m_connection->m_tx_pkt_stats.dumpProfiler(g_profiler,
+				m_connection->GetPeerID() == PEER_ID_SERVER);
 		}
 
 		/* send non reliable packets */
@@ -204,7 +250,7 @@ void ConnectionSendThread::runTimeouts(float dtime)
 		float resend_timeout = udpPeer->getResendTimeout();
 		bool retry_count_exceeded = false;
 		for (Channel &channel : udpPeer->channels) {
-			std::list<BufferedPacket> timed_outs;
+			std::list<BufferedPacketPtr> timed_outs;
 
 			// Remove timed out incomplete unreliable split packets
 			channel.incoming_splits.removeUnreliableTimedOuts(dtime, m_timeout);
@@ -226,8 +272,7 @@ void ConnectionSendThread::runTimeouts(float dtime)
 
 			m_iteration_packets_avaialble -= timed_outs.size();
 
-			for (std::list<BufferedPacket>::iterator k = timed_outs.begin();
-				k != timed_outs.end(); ++k) {
+			for (const BufferedPacketPtr &k : timed_outs) {
 				session_t peer_id = readPeerId(*(k->data));
 				u8 channelnum = readChannel(*(k->data));
 				u16 seqnum = readU16(&(k->data[BASE_HEADER_SIZE + 1]));
@@ -251,7 +296,12 @@ void ConnectionSendThread::runTimeouts(float dtime)
 					<< ", seqnum=" << seqnum
 					<< std::endl);
 
-				rawSend(*k);
+				u16 command;
+				if (getCommandFromReliable(**k, &command))
+					m_connection->m_tx_pkt_stats.recordResend(command,
+						k->data.getSize());
+
+				rawSend(**k);
 
 				// do not handle rtt here as we can't decide if this packet was
 				// lost or really takes more time to transmit
@@ -261,7 +311,8 @@ void ConnectionSendThread::runTimeouts(float dtime)
 				break; /* no need to check other channels if we already did timeout */
 			}
 
-			channel.UpdateTimers(dtime);
+			channel.UpdateTimers(dtime, udpPeer->getStat(MIN_RTT),
+				udpPeer->getStat(AVG_RTT));
 		}
 
 		/* skip to next peer if we did timeout */
@@ -307,10 +358,10 @@ void ConnectionSendThread::rawSend(const BufferedPacket &packet)
 	}
 }
 
-void ConnectionSendThread::sendAsPacketReliable(BufferedPacket &p, Channel *channel)
+void ConnectionSendThread::bufferReliable(BufferedPacketPtr &p, Channel *channel)
 {
 	try {
-		p.absolute_send_time = porting::getTimeMs();
+		p->absolute_send_time = porting::getTimeMs();
 		// Buffer the packet
 		channel->outgoing_reliables_sent.insert(p,
 			(channel->readOutgoingSequenceNumber() - MAX_RELIABLE_WINDOW_SIZE)
@@ -321,9 +372,72 @@ void ConnectionSendThread::sendAsPacketReliable(BufferedPacket &p, Channel *chan
 			<< "WARNING: Going to send a reliable packet"
 			<< " in outgoing buffer" << std::endl);
 	}
+}
+
+void ConnectionSendThread::sendAsPacketReliable(BufferedPacketPtr &p, Channel *channel)
+{
+	bufferReliable(p, channel);
 
 	// Send the packet
-	rawSend(p);
+	rawSend(*p);
+}
+
+void ConnectionSendThread::queueForBatch(BufferedPacketPtr &p, Channel *channel)
+{
+	bufferReliable(p, channel);
+
+	u32 subpacket_size = p->data.getSize() - BASE_HEADER_SIZE;
+
+	// Batched datagrams must fit into the receiver's buffer; flush and
+	// start a new batch if this packet would push us over the limit.
+	if (!m_pending_batch.empty() &&
+			BASE_HEADER_SIZE + BATCH_HEADER_SIZE + m_pending_batch_size
+				+ 2 + subpacket_size > MAX_BATCH_PACKET_SIZE)
+		flushPacketBatch();
+
+	m_pending_batch.push_back(p);
+	m_pending_batch_size += 2 + subpacket_size;
+}
+
+void ConnectionSendThread::flushPacketBatch()
+{
+	if (m_pending_batch.empty())
+		return;
+
+	// A batch of one is sent as-is; the batch framing would only add bytes
+	if (m_pending_batch.size() == 1) {
+		rawSend(*m_pending_batch[0]);
+		m_pending_batch.clear();
+		m_pending_batch_size = 0;
+		return;
+	}
+
+	BufferedPacket batch(BASE_HEADER_SIZE + BATCH_HEADER_SIZE
+		+ m_pending_batch_size);
+	batch.address = m_pending_batch[0]->address;
+
+	// All batched packets share peer and channel, so their base headers
+	// are identical; reuse the first one.
+	memcpy(*batch.data, &m_pending_batch[0]->data[0], BASE_HEADER_SIZE);
+	writeU8(&batch.data[BASE_HEADER_SIZE], PACKET_TYPE_BATCH);
+
+	u32 offset = BASE_HEADER_SIZE + BATCH_HEADER_SIZE;
+	for (const BufferedPacketPtr &p : m_pending_batch) {
+		u32 subpacket_size = p->data.getSize() - BASE_HEADER_SIZE;
+		writeU16(&batch.data[offset], subpacket_size);
+		memcpy(&batch.data[offset + 2], &p->data[BASE_HEADER_SIZE],
+			subpacket_size);
+		offset += 2 + subpacket_size;
+	}
+
+	LOG(dout_con << m_connection->getDesc()
+		<< " INFO: sending batch of " << m_pending_batch.size()
+		<< " reliable packets (" << batch.data.getSize()
+		<< " bytes)" << std::endl);
+	rawSend(batch);
+
+	m_pending_batch.clear();
+	m_pending_batch_size = 0;
 }
 
 bool ConnectionSendThread::rawSendAsPacket(session_t peer_id, u8 channelnum,
@@ -353,7 +467,7 @@ bool ConnectionSendThread::rawSendAsPacket(session_t peer_id, u8 channelnum,
 		peer->getAddress(MTP_MINETEST_RELIABLE_UDP, peer_address);
 
 		// Add base headers and make a packet
-		BufferedPacket p = con::makePacket(peer_address, reliable,
+		BufferedPacketPtr p = con::makePacket(peer_address, reliable,
 			m_connection->GetProtocolID(), m_connection->GetPeerID(),
 			channelnum);
 
@@ -378,13 +492,25 @@ bool ConnectionSendThread::rawSendAsPacket(session_t peer_id, u8 channelnum,
 
 	Address peer_address;
 	if (peer->getAddress(MTP_UDP, peer_address)) {
-		// Add base headers and make a packet
-		BufferedPacket p = con::makePacket(peer_address, data,
-			m_connection->GetProtocolID(), m_connection->GetPeerID(),
-			channelnum);
+		// Write the base header on the stack and send it together with the
+		// payload as one datagram; unreliable packets are never buffered so
+		// there is no need to copy them into a BufferedPacket first.
+		u8 base_header[BASE_HEADER_SIZE];
+		writeU32(&base_header[0], m_connection->GetProtocolID());
+		writeU16(&base_header[4], m_connection->GetPeerID());
+		writeU8(&base_header[6], channelnum);
 
-		// Send the packet
-		rawSend(p);
+		try {
+			m_connection->m_udpSocket.Send(peer_address, base_header,
+				BASE_HEADER_SIZE, *data, data.getSize());
+			LOG(dout_con << m_connection->getDesc()
+				<< " rawSend: " << (BASE_HEADER_SIZE + data.getSize())
+				<< " bytes sent" << std::endl);
+		} catch (SendFailedException &e) {
+			LOG(derr_con << m_connection->getDesc()
+				<< "Connection::rawSend(): SendFailedException: "
+				<< peer_address.serializeString() << std::endl);
+		}
 		return true;
 	}
 
@@ -495,8 +621,10 @@ void ConnectionSendThread::serve(Address bind_address)
 	LOG(dout_con << m_connection->getDesc()
 		<< "UDP serving at port " << bind_address.serializeString() << std::endl);
 	try {
+		m_connection->prepareShardReceive();
 		m_connection->m_udpSocket.Bind(bind_address);
 		m_connection->SetPeerID(PEER_ID_SERVER);
+		m_connection->startShardReceiveThreads(bind_address);
 	}
 	catch (SocketException &e) {
 		// Create event
@@ -712,16 +840,21 @@ void ConnectionSendThread::sendPackets(float dtime)
 					channel.outgoing_reliables_sent.size()
 					< channel.getWindowSize() &&
 					peer->m_increment_packets_remaining > 0) {
-				BufferedPacket p = channel.queued_reliables.front();
+				BufferedPacketPtr p = channel.queued_reliables.front();
 				channel.queued_reliables.pop();
 				LOG(dout_con << m_connection->getDesc()
 					<< " INFO: sending a queued reliable packet "
 					<< " channel: " << i
-					<< ", seqnum: " << readU16(&p.data[BASE_HEADER_SIZE + 1])
+					<< ", seqnum: " << readU16(&p->data[BASE_HEADER_SIZE + 1])
 					<< std::endl);
-				sendAsPacketReliable(p, &channel);
+				if (m_enable_packet_batching)
+					queueForBatch(p, &channel);
+				else
+					sendAsPacketReliable(p, &channel);
 				peer->m_increment_packets_remaining--;
 			}
+			// Batches may not span peers or channels
+			flushPacketBatch();
 		}
 	}
 
@@ -893,7 +1026,7 @@ void ConnectionReceiveThread::receive()
 	/* first of all read packets from socket */
 	/* check for incoming data available */
 	while ((loop_count < 10) &&
-		(m_connection->m_udpSocket.WaitData(50))) {
+		(m_socket->WaitData(50))) {
 		loop_count++;
 		try {
 			if (packet_queued) {
@@ -917,7 +1050,7 @@ void ConnectionReceiveThread::receive()
 			}
 
 			Address sender;
-			s32 received_size = m_connection->m_udpSocket.Receive(sender, *packetdata,
+			s32 received_size = m_socket->Receive(sender, *packetdata,
 				packet_maxsize);
 
 			if ((received_size < BASE_HEADER_SIZE) ||
@@ -987,6 +1120,9 @@ void ConnectionReceiveThread::receive()
 			}
 
 			peer->ResetTimeout();
+			// The kernel hashes a sender consistently to one socket, so
+			// this only changes when the peer's address changes
+			peer->setReceiveShard(m_shard);
 
 			Channel *channel = 0;
 
@@ -1041,6 +1177,11 @@ bool ConnectionReceiveThread::getFromBuffers(session_t &peer_id, SharedBuffer<u8
 		if (!peer)
 			continue;
 
+		// With sharded receive every peer is processed by exactly one
+		// thread; draining another shard's buffers would race with it
+		if (peer->getReceiveShard() != m_shard)
+			continue;
+
 		if (dynamic_cast<UDPPeer *>(&peer) == 0)
 			continue;
 
@@ -1059,10 +1200,10 @@ bool ConnectionReceiveThread::checkIncomingBuffers(Channel *channel,
 	u16 firstseqnum = 0;
 	if (channel->incoming_reliables.getFirstSeqnum(firstseqnum)) {
 		if (firstseqnum == channel->readNextIncomingSeqNum()) {
-			BufferedPacket p = channel->incoming_reliables.popFirst();
-			peer_id = readPeerId(*p.data);
-			u8 channelnum = readChannel(*p.data);
-			u16 seqnum = readU16(&p.data[BASE_HEADER_SIZE + 1]);
+			BufferedPacketPtr p = channel->incoming_reliables.popFirst();
+			peer_id = readPeerId(*p->data);
+			u8 channelnum = readChannel(*p->data);
+			u16 seqnum = readU16(&p->data[BASE_HEADER_SIZE + 1]);
 
 			LOG(dout_con << m_connection->getDesc()
 				<< "UNBUFFERING TYPE_RELIABLE"
@@ -1075,8 +1216,8 @@ bool ConnectionReceiveThread::checkIncomingBuffers(Channel *channel,
 
 			u32 headers_size = BASE_HEADER_SIZE + RELIABLE_HEADER_SIZE;
 			// Get out the inside packet and re-process it
-			SharedBuffer<u8> payload(p.data.getSize() - headers_size);
-			memcpy(*payload, &p.data[headers_size], payload.getSize());
+			SharedBuffer<u8> payload(p->data.getSize() - headers_size);
+			memcpy(*payload, &p->data[headers_size], payload.getSize());
 
 			dst = processPacket(channel, payload, peer_id, channelnum, true);
 			return true;
@@ -1122,6 +1263,7 @@ const ConnectionReceiveThread::PacketTypeHandler
 	{&ConnectionReceiveThread::handlePacketType_Original},
 	{&ConnectionReceiveThread::handlePacketType_Split},
 	{&ConnectionReceiveThread::handlePacketType_Reliable},
+	{&ConnectionReceiveThread::handlePacketType_Batch},
 };
 
 SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Control(Channel *channel,
@@ -1146,31 +1288,39 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Control(Channel *chan
 			<< seqnum << " ]" << std::endl);
 
 		try {
-			BufferedPacket p = channel->outgoing_reliables_sent.popSeqnum(seqnum);
+			BufferedPacketPtr p = channel->outgoing_reliables_sent.popSeqnum(seqnum);
 
 			// only calculate rtt from straight sent packets
-			if (p.resend_count == 0) {
+			if (p->resend_count == 0) {
 				// Get round trip time
 				u64 current_time = porting::getTimeMs();
 
+				float rtt = -1.0f;
+
 				// a overflow is quite unlikely but as it'd result in major
 				// rtt miscalculation we handle it here
-				if (current_time > p.absolute_send_time) {
-					float rtt = (current_time - p.absolute_send_time) / 1000.0;
+				if (current_time > p->absolute_send_time) {
+					rtt = (current_time - p->absolute_send_time) / 1000.0;
 
 					// Let peer calculate stuff according to it
 					// (avg_rtt and resend_timeout)
 					dynamic_cast<UDPPeer *>(peer)->reportRTT(rtt);
-				} else if (p.totaltime > 0) {
-					float rtt = p.totaltime;
+				} else if (p->totaltime > 0) {
+					rtt = p->totaltime;
 
 					// Let peer calculate stuff according to it
 					// (avg_rtt and resend_timeout)
 					dynamic_cast<UDPPeer *>(peer)->reportRTT(rtt);
 				}
+
+				// Attribute the latency to the packet type
+				u16 command;
+				if (rtt >= 0.0f && getCommandFromReliable(*p, &command))
+					m_connection->m_tx_pkt_stats.recordReliableRtt(
+						command, rtt);
 			}
 			// put bytes for max bandwidth calculation
-			channel->UpdateBytesSent(p.data.getSize(), 1);
+			channel->UpdateBytesSent(p->data.getSize(), 1);
 			if (channel->outgoing_reliables_sent.size() == 0)
 				m_connection->TriggerSend();
 		} catch (NotFoundException &e) {
@@ -1245,14 +1395,14 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Split(Channel *channe
 	if (peer->getAddress(MTP_UDP, peer_address)) {
 		// We have to create a packet again for buffering
 		// This isn't actually too bad an idea.
-		BufferedPacket packet = makePacket(peer_address,
+		BufferedPacketPtr packet = makePacket(peer_address,
 			packetdata,
 			m_connection->GetProtocolID(),
 			peer->id,
 			channelnum);
 
 		// Buffer the packet
-		SharedBuffer<u8> data = peer->addSplitPacket(channelnum, packet, reliable);
+		SharedBuffer<u8> data = peer->addSplitPacket(channelnum, *packet, reliable);
 
 		if (data.getSize() != 0) {
 			LOG(dout_con << m_connection->getDesc()
@@ -1324,7 +1474,7 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Reliable(Channel *cha
 		// This one comes later, buffer it.
 		// Actually we have to make a packet to buffer one.
 		// Well, we have all the ingredients, so just do it.
-		BufferedPacket packet = con::makePacket(
+		BufferedPacketPtr packet = con::makePacket(
 			peer_address,
 			packetdata,
 			m_connection->GetProtocolID(),
@@ -1364,7 +1514,7 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Reliable(Channel *cha
 	u16 queued_seqnum = 0;
 	if (channel->incoming_reliables.getFirstSeqnum(queued_seqnum)) {
 		if (queued_seqnum == seqnum) {
-			BufferedPacket queued_packet = channel->incoming_reliables.popFirst();
+			BufferedPacketPtr queued_packet = channel->incoming_reliables.popFirst();
 			/** TODO find a way to verify the new against the old packet */
 		}
 	}
@@ -1378,4 +1528,63 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Reliable(Channel *cha
 	return processPacket(channel, payload, peer->id, channelnum, true);
 }
 
+SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Batch(Channel *channel,
+	const SharedBuffer<u8> &packetdata, Peer *peer, u8 channelnum, bool reliable)
+{
+	assert(channel != NULL);
+
+	// Batches may only appear at datagram top level
+	if (reliable)
+		throw InvalidIncomingDataException("Found nested batch packet");
+
+	if (packetdata.getSize() < BATCH_HEADER_SIZE + 2)
+		throw InvalidIncomingDataException("packetdata.getSize() < BATCH_HEADER_SIZE + 2");
+
+	bool packet_queued = false;
+	u32 offset = BATCH_HEADER_SIZE;
+	u32 count = 0;
+
+	while (offset < packetdata.getSize()) {
+		if (offset + 2 > packetdata.getSize())
+			throw InvalidIncomingDataException("Truncated batch sub-packet size");
+
+		u16 subpacket_size = readU16(&packetdata[offset]);
+		offset += 2;
+
+		if (subpacket_size == 0 || offset + subpacket_size > packetdata.getSize())
+			throw InvalidIncomingDataException("Invalid batch sub-packet size");
+
+		SharedBuffer<u8> subdata(subpacket_size);
+		memcpy(*subdata, &packetdata[offset], subpacket_size);
+		offset += subpacket_size;
+		count++;
+
+		// Each sub-packet is processed like its own datagram; results are
+		// delivered here as a batch can carry more than one of them.
+		try {
+			SharedBuffer<u8> resultdata = processPacket(
+				channel, subdata, peer->id, channelnum, false);
+
+			ConnectionEvent e;
+			e.dataReceived(peer->id, resultdata);
+			m_connection->putEvent(e);
+		}
+		catch (ProcessedSilentlyException &e) {
+		}
+		catch (ProcessedQueued &e) {
+			packet_queued = true;
+		}
+	}
+
+	LOG(dout_con << m_connection->getDesc()
+		<< "TYPE_BATCH: processed " << count
+		<< " sub-packets from peer_id: " << peer->id
+		<< ", channel: " << (channelnum & 0xFF) << std::endl;)
+
+	if (packet_queued)
+		throw ProcessedQueued("Buffered future reliables from batch packet");
+
+	throw ProcessedSilentlyException("Batch sub-packets already delivered");
+}
+
 }
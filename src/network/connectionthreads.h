@@ -71,7 +71,16 @@ private:
 	void sendAsPacket(session_t peer_id, u8 channelnum, const SharedBuffer<u8> &data,
 			bool ack = false);
 
-	void sendAsPacketReliable(BufferedPacket &p, Channel *channel);
+	void sendAsPacketReliable(BufferedPacketPtr &p, Channel *channel);
+
+	// Buffers p for retransmission without sending it
+	void bufferReliable(BufferedPacketPtr &p, Channel *channel);
+
+	// Coalesces small reliables into a single PACKET_TYPE_BATCH datagram.
+	// Only packets of one peer+channel may be batched together; call
+	// flushPacketBatch() before switching to another one.
+	void queueForBatch(BufferedPacketPtr &p, Channel *channel);
+	void flushPacketBatch();
 
 	bool packetsQueued();
 
@@ -85,6 +94,17 @@ private:
 	unsigned int m_max_commands_per_iteration = 1;
 	unsigned int m_max_data_packets_per_iteration;
 	unsigned int m_max_packets_requeued = 256;
+
+	// Commands taken from the queue in bulk, reused every iteration
+	std::vector<ConnectionCommand> m_command_batch;
+
+	// Seconds until per-packet-type counters go to the profiler again
+	float m_profiler_dump_timer = 0.0f;
+
+	// Reliables waiting to be coalesced into one batch datagram
+	std::vector<BufferedPacketPtr> m_pending_batch;
+	u32 m_pending_batch_size = 0;
+	bool m_enable_packet_batching;
 };
 
 class ConnectionReceiveThread : public Thread
@@ -98,6 +118,18 @@ public:
 	{
 		assert(parent); // Pre-condition
 		m_connection = parent;
+		if (!m_socket)
+			m_socket = &parent->m_udpSocket;
+	}
+
+	// For SO_REUSEPORT sharding: receive from the given socket instead
+	// of the connection's main one. Peers are tagged with the shard
+	// their packets arrive on so each thread only drains its own.
+	void setShardSocket(UDPSocket *socket, u8 shard)
+	{
+		assert(socket); // Pre-condition
+		m_socket = socket;
+		m_shard = shard;
 	}
 
 private:
@@ -135,6 +167,9 @@ private:
 	SharedBuffer<u8> handlePacketType_Reliable(Channel *channel,
 			const SharedBuffer<u8> &packetdata, Peer *peer, u8 channelnum,
 			bool reliable);
+	SharedBuffer<u8> handlePacketType_Batch(Channel *channel,
+			const SharedBuffer<u8> &packetdata, Peer *peer, u8 channelnum,
+			bool reliable);
 
 	struct PacketTypeHandler
 	{
@@ -146,5 +181,7 @@ private:
 	static const PacketTypeHandler packetTypeRouter[PACKET_TYPE_MAX];
 
 	Connection *m_connection = nullptr;
+	UDPSocket *m_socket = nullptr;
+	u8 m_shard = 0;
 };
 }
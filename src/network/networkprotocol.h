@@ -200,9 +200,24 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 		Unknown inventory serialization fields no longer throw an error
 		Mod-specific formspec version
 		Player FOV override API
+	PROTOCOL VERSION 39:
+		Add TOCLIENT_BLOCKDATAS (batched block transfer)
+	PROTOCOL VERSION 40:
+		Add TOCLIENT_BLOCK_DELTA (partial block updates)
+	PROTOCOL VERSION 41:
+		Quantized object position updates
+		(GENERIC_CMD_UPDATE_POSITION_KEYFRAME/_DELTA)
+	PROTOCOL VERSION 42:
+		Session resumption: add AUTH_MECHANISM_SESSION_KEY and
+			TOSERVER_SESSION_REAUTH so a reconnecting client can skip
+			the full SRP exchange
+		TOCLIENT_HELLO carries a reauth challenge when
+			AUTH_MECHANISM_SESSION_KEY is offered
+	PROTOCOL VERSION 43:
+		Add TOCLIENT_MODCHANNEL_MSGS (batched mod channel delivery)
 */
 
-#define LATEST_PROTOCOL_VERSION 38
+#define LATEST_PROTOCOL_VERSION 43
 #define LATEST_PROTOCOL_VERSION_STRING TOSTRING(LATEST_PROTOCOL_VERSION)
 
 // Server's supported network protocol range
@@ -247,6 +262,7 @@ enum ToClientCommand
 		u16 deployed protocol version
 		u32 supported auth methods
 		std::string username that should be used for legacy hash (for proper casing)
+		std::string reauth challenge (only if AUTH_MECHANISM_SESSION_KEY is offered)
 	*/
 	TOCLIENT_AUTH_ACCEPT = 0x03,
 	/*
@@ -681,6 +697,27 @@ enum ToClientCommand
 		serialized and compressed node metadata
 	*/
 
+	TOCLIENT_BLOCKDATAS = 0x5a,
+	/*
+		u16 count
+		for count:
+			v3s16 position
+			u32 length
+			u8[length] serialized mapblock
+	*/
+
+	TOCLIENT_MODCHANNEL_MSGS = 0x5b,
+	/*
+		u16 count
+		for count:
+			u16 channel name length
+			std::string channel name
+			u16 sender length
+			std::string sender
+			u16 message length
+			std::string message
+	*/
+
 	TOCLIENT_SRP_BYTES_S_B = 0x60,
 	/*
 		Belonging to AUTH_MECHANISM_SRP.
@@ -695,7 +732,19 @@ enum ToClientCommand
 		u8[len] formspec
 	*/
 
-	TOCLIENT_NUM_MSG_TYPES = 0x62,
+	TOCLIENT_BLOCK_DELTA = 0x62,
+	/*
+		Changed nodes of an already-sent mapblock
+		v3s16 blockpos
+		u16 count
+		for count:
+			u16 node index (z * 16 * 16 + y * 16 + x)
+			u16 param0
+			u8 param1
+			u8 param2
+	*/
+
+	TOCLIENT_NUM_MSG_TYPES = 0x63,
 };
 
 enum ToServerCommand
@@ -910,7 +959,14 @@ enum ToServerCommand
 		std::string bytes_M
 	*/
 
-	TOSERVER_NUM_MSG_TYPES = 0x53,
+	TOSERVER_SESSION_REAUTH = 0x53,
+	/*
+		Belonging to AUTH_MECHANISM_SESSION_KEY.
+
+		std::string proof = SHA-256(cached session key .. reauth challenge)
+	*/
+
+	TOSERVER_NUM_MSG_TYPES = 0x54,
 };
 
 enum AuthMechanism
@@ -926,6 +982,10 @@ enum AuthMechanism
 
 	// Establishes a srp verification key, for first login and password changing
 	AUTH_MECHANISM_FIRST_SRP = 1 << 2,
+
+	// Single round trip reauth, proving knowledge of the SRP session key
+	// of a recent login (not valid for sudo mode)
+	AUTH_MECHANISM_SESSION_KEY = 1 << 3,
 };
 
 enum AccessDeniedCode {
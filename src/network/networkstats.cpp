@@ -0,0 +1,146 @@
+/*
+Minetest
+Copyright (C) 2013-2017 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "networkstats.h"
+#include "serveropcodes.h"
+#include "profiler.h"
+#include <iomanip>
+#include <sstream>
+
+namespace con
+{
+
+u32 PacketTypeStats::rttBucket(float rtt)
+{
+	u32 ms = (u32)(rtt * 1000.0f);
+	u32 bucket = 0;
+	while (ms > 0 && bucket < RTT_BUCKETS - 1) {
+		ms >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+const char *PacketTypeStats::getCommandName(u16 command, bool to_client)
+{
+	if (to_client) {
+		if (command < TOCLIENT_NUM_MSG_TYPES)
+			return clientCommandFactoryTable[command].name;
+	} else {
+		if (command < TOSERVER_NUM_MSG_TYPES)
+			return toServerCommandTable[command].name.c_str();
+	}
+	return nullptr;
+}
+
+// Upper bound label of the histogram bucket holding the given percentile
+static std::string percentileLabel(const u64 (&histogram)[PacketTypeStats::RTT_BUCKETS],
+		u64 total, float fraction)
+{
+	u64 target = (u64)(total * fraction);
+	if (target < 1)
+		target = 1;
+	u64 cumulated = 0;
+	for (u32 i = 0; i < PacketTypeStats::RTT_BUCKETS; i++) {
+		cumulated += histogram[i];
+		if (cumulated >= target) {
+			if (i == PacketTypeStats::RTT_BUCKETS - 1)
+				return ">8192";
+			std::ostringstream os;
+			os << "<" << (1 << i);
+			return os.str();
+		}
+	}
+	return "-";
+}
+
+void PacketTypeStats::report(std::ostream &os, bool to_client) const
+{
+	os << std::left << std::setw(36) << "command"
+		<< std::right << std::setw(12) << "count"
+		<< std::setw(14) << "kB"
+		<< std::setw(10) << "resent"
+		<< std::setw(12) << "resent kB"
+		<< std::setw(22) << "rtt ms p50/p95/p99"
+		<< std::endl;
+
+	for (u16 command = 0; command < COMMAND_SLOTS; command++) {
+		const TypeCounter &c = m_counters[command];
+		u64 count = c.count.load(std::memory_order_relaxed);
+		u64 resend_count = c.resend_count.load(std::memory_order_relaxed);
+		if (count == 0 && resend_count == 0)
+			continue;
+
+		const char *name = getCommandName(command, to_client);
+		std::ostringstream label;
+		if (name && name[0])
+			label << name;
+		else
+			label << "0x" << std::hex << command;
+
+		u64 histogram[RTT_BUCKETS];
+		u64 acked = 0;
+		for (u32 i = 0; i < RTT_BUCKETS; i++) {
+			histogram[i] = c.rtt_histogram[i].load(std::memory_order_relaxed);
+			acked += histogram[i];
+		}
+
+		std::string rtt = "-";
+		if (acked > 0) {
+			rtt = percentileLabel(histogram, acked, 0.5f) + "/"
+				+ percentileLabel(histogram, acked, 0.95f) + "/"
+				+ percentileLabel(histogram, acked, 0.99f);
+		}
+
+		os << std::left << std::setw(36) << label.str()
+			<< std::right << std::setw(12)
+			<< count
+			<< std::setw(14) << std::fixed << std::setprecision(1)
+			<< (c.bytes.load(std::memory_order_relaxed) / 1000.0)
+			<< std::setw(10)
+			<< resend_count
+			<< std::setw(12)
+			<< (c.resend_bytes.load(std::memory_order_relaxed) / 1000.0)
+			<< std::setw(22) << rtt
+			<< std::endl;
+	}
+}
+
+void PacketTypeStats::dumpProfiler(Profiler *profiler, bool to_client)
+{
+	for (u16 command = 0; command < COMMAND_SLOTS; command++) {
+		u64 bytes = m_counters[command].bytes.load(std::memory_order_relaxed);
+		u64 delta = bytes - m_profiler_dumped_bytes[command];
+		if (delta == 0)
+			continue;
+		m_profiler_dumped_bytes[command] = bytes;
+
+		const char *name = getCommandName(command, to_client);
+		std::ostringstream id;
+		id << "con tx: ";
+		if (name && name[0])
+			id << name;
+		else
+			id << "0x" << std::hex << command;
+		id << " [kB]";
+		profiler->add(id.str(), delta / 1000.0f);
+	}
+}
+
+}
@@ -0,0 +1,133 @@
+/*
+Minetest
+Copyright (C) 2013-2017 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <atomic>
+#include <iostream>
+
+class Profiler;
+
+namespace con
+{
+
+/*
+	Traffic counters for one direction of a connection, keyed by the
+	u16 command id found at the start of every packet payload.
+
+	All record*() methods are single relaxed atomic increments and may be
+	called from any of the connection threads concurrently. Reporting
+	reads the counters without locking, so a report is only approximately
+	consistent; that is fine for diagnostics.
+*/
+class PacketTypeStats
+{
+public:
+	// Command ids of both directions currently fit into one byte;
+	// anything larger is accounted to the last slot.
+	static const u16 COMMAND_SLOTS = 256;
+
+	// Reliable round trip times are kept as a histogram of log2
+	// millisecond buckets: [0,1), [1,2), [2,4), ..., [8192,inf)
+	static const u32 RTT_BUCKETS = 15;
+
+	PacketTypeStats() = default;
+
+	void record(u16 command, u32 bytes)
+	{
+		TypeCounter &c = m_counters[slotOf(command)];
+		c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+		c.count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void recordResend(u16 command, u32 bytes)
+	{
+		TypeCounter &c = m_counters[slotOf(command)];
+		c.resend_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		c.resend_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// rtt in seconds, as reported by the ACK of a reliable
+	void recordReliableRtt(u16 command, float rtt)
+	{
+		TypeCounter &c = m_counters[slotOf(command)];
+		c.rtt_histogram[rttBucket(rtt)].fetch_add(1,
+			std::memory_order_relaxed);
+	}
+
+	// Sums of the per-type counters, e.g. for the metrics exporter
+	void getTotals(u64 *bytes, u64 *packets) const
+	{
+		u64 b = 0, c = 0;
+		for (const TypeCounter &tc : m_counters) {
+			b += tc.bytes.load(std::memory_order_relaxed);
+			c += tc.count.load(std::memory_order_relaxed);
+		}
+		*bytes = b;
+		*packets = c;
+	}
+
+	/*
+		Writes a table of all packet types seen so far: count, bytes,
+		resends and rtt percentiles. to_client selects which command
+		name table is used for labeling.
+	*/
+	void report(std::ostream &os, bool to_client) const;
+
+	/*
+		Feeds the per-type byte counts gathered since the last call into
+		the profiler ("con tx: <NAME> [kB]"). Must always be called from
+		the same thread.
+	*/
+	void dumpProfiler(Profiler *profiler, bool to_client);
+
+private:
+	struct TypeCounter
+	{
+		std::atomic<u64> bytes{0};
+		std::atomic<u64> count{0};
+		std::atomic<u64> resend_bytes{0};
+		std::atomic<u64> resend_count{0};
+		std::atomic<u64> rtt_histogram[RTT_BUCKETS];
+
+		TypeCounter()
+		{
+			for (u32 i = 0; i < RTT_BUCKETS; i++)
+				rtt_histogram[i].store(0, std::memory_order_relaxed);
+		}
+	};
+
+	static u16 slotOf(u16 command)
+	{
+		return command < COMMAND_SLOTS ? command : COMMAND_SLOTS - 1;
+	}
+
+	static u32 rttBucket(float rtt);
+
+	static const char *getCommandName(u16 command, bool to_client);
+
+	TypeCounter m_counters[COMMAND_SLOTS];
+
+	// Bytes already handed to the profiler, only touched by the
+	// dumpProfiler() caller
+	u64 m_profiler_dumped_bytes[COMMAND_SLOTS] = {};
+};
+
+}
@@ -107,6 +107,7 @@ const ToServerCommandHandler toServerCommandTable[TOSERVER_NUM_MSG_TYPES] =
 	{ "TOSERVER_FIRST_SRP",                TOSERVER_STATE_NOT_CONNECTED, &Server::handleCommand_FirstSrp }, // 0x50
 	{ "TOSERVER_SRP_BYTES_A",              TOSERVER_STATE_NOT_CONNECTED, &Server::handleCommand_SrpBytesA }, // 0x51
 	{ "TOSERVER_SRP_BYTES_M",              TOSERVER_STATE_NOT_CONNECTED, &Server::handleCommand_SrpBytesM }, // 0x52
+	{ "TOSERVER_SESSION_REAUTH",           TOSERVER_STATE_NOT_CONNECTED, &Server::handleCommand_SessionReauth }, // 0x53
 };
 
 const static ClientCommandFactory null_command_factory = { "TOCLIENT_NULL", 0, false };
@@ -203,12 +204,13 @@ const ClientCommandFactory clientCommandFactoryTable[TOCLIENT_NUM_MSG_TYPES] =
 	{ "TOCLIENT_MODCHANNEL_MSG",           0, true }, // 0x57
 	{ "TOCLIENT_MODCHANNEL_SIGNAL",        0, true }, // 0x58
 	{ "TOCLIENT_NODEMETA_CHANGED",         0, true }, // 0x59
-	null_command_factory, // 0x5A
-	null_command_factory, // 0x5B
+	{ "TOCLIENT_BLOCKDATAS",               2, true }, // 0x5A
+	{ "TOCLIENT_MODCHANNEL_MSGS",          0, true }, // 0x5B
 	null_command_factory, // 0x5C
 	null_command_factory, // 0x5D
 	null_command_factory, // 0x5E
 	null_command_factory, // 0x5F
 	{ "TOSERVER_SRP_BYTES_S_B",            0, true }, // 0x60
 	{ "TOCLIENT_FORMSPEC_PREPEND",         0, true }, // 0x61
+	{ "TOCLIENT_BLOCK_DELTA",              2, true }, // 0x62
 };
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapblock.h"
 #include "modchannels.h"
 #include "nodedef.h"
+#include "porting.h"
 #include "remoteplayer.h"
 #include "rollback_interface.h"
 #include "scripting_server.h"
@@ -38,6 +39,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/base64.h"
 #include "util/pointedthing.h"
 #include "util/serialize.h"
+#include "util/sha2.h"
 #include "util/srp.h"
 
 void Server::handleCommand_Deprecated(NetworkPacket* pkt)
@@ -257,6 +259,30 @@ void Server::handleCommand_Init(NetworkPacket* pkt)
 		}
 	}
 
+	/*
+		Offer cheap session resumption when we still hold the SRP session
+		key of a recent login for this player (see handleCommand_SessionReauth)
+	*/
+	std::string reauth_challenge;
+	std::unordered_map<std::string, CachedSession>::iterator session_it =
+		m_cached_sessions.find(playername);
+	if (session_it != m_cached_sessions.end()) {
+		const CachedSession &session = session_it->second;
+		if (porting::getTimeS() >= session.expiry_time ||
+				session.enc_pwd != client->enc_pwd) {
+			// Expired, or the password entry changed since the login
+			m_cached_sessions.erase(session_it);
+		} else if (net_proto_version >= 42) {
+			unsigned char challenge_buf[32];
+			if (srp_random_bytes(challenge_buf, sizeof(challenge_buf)) == SRP_OK) {
+				auth_mechs |= AUTH_MECHANISM_SESSION_KEY;
+				reauth_challenge.assign((char *) challenge_buf,
+					sizeof(challenge_buf));
+			}
+		}
+	}
+	client->reauth_challenge = reauth_challenge;
+
 	/*
 		Answer with a TOCLIENT_HELLO
 	*/
@@ -270,6 +296,8 @@ void Server::handleCommand_Init(NetworkPacket* pkt)
 	u16 depl_compress_mode = NETPROTO_COMPRESSION_NONE;
 	resp_pkt << depl_serial_v << depl_compress_mode << net_proto_version
 		<< auth_mechs << legacyPlayerNameCasing;
+	if (auth_mechs & AUTH_MECHANISM_SESSION_KEY)
+		resp_pkt << reauth_challenge;
 
 	Send(&resp_pkt);
 
@@ -563,6 +591,8 @@ void Server::handleCommand_DeletedBlocks(NetworkPacket* pkt)
 		v3s16 p;
 		*pkt >> p;
 		client->SetBlockNotSent(p);
+		// The client no longer has the block, so it can't apply a delta
+		client->resetBlockSyncCounter(p);
 	}
 }
 
@@ -1737,6 +1767,13 @@ void Server::handleCommand_SrpBytesM(NetworkPacket* pkt)
 	std::string bytes_M;
 	*pkt >> bytes_M;
 
+	if (m_session_replay) {
+		// A recorded SRP proof can never match the fresh challenge of
+		// this run; accept the login so the session can play back
+		acceptAuth(pkt->getPeerId(), wantSudo);
+		return;
+	}
+
 	if (srp_verifier_get_session_key_length((SRPVerifier *) client->auth_data)
 			!= bytes_M.size()) {
 		actionstream << "Server: User " << client->getName()
@@ -1785,9 +1822,128 @@ void Server::handleCommand_SrpBytesM(NetworkPacket* pkt)
 		client->create_player_on_auth_success = false;
 	}
 
+	/*
+		Remember the SRP session key so this player can skip the full
+		exchange on their next connect (see handleCommand_SessionReauth)
+	*/
+	u64 reauth_timeout = g_settings->getU64("session_reauth_timeout");
+	if (!wantSudo && reauth_timeout > 0) {
+		size_t key_len = 0;
+		const unsigned char *key = srp_verifier_get_session_key(
+			(SRPVerifier *) client->auth_data, &key_len);
+		if (key && key_len > 0) {
+			// Drop expired entries of other players while we are at it
+			u64 now = porting::getTimeS();
+			for (std::unordered_map<std::string, CachedSession>::iterator
+					it = m_cached_sessions.begin();
+					it != m_cached_sessions.end();) {
+				if (now >= it->second.expiry_time)
+					m_cached_sessions.erase(it++);
+				else
+					++it;
+			}
+
+			CachedSession &session = m_cached_sessions[client->getName()];
+			session.key.assign((const char *) key, key_len);
+			session.enc_pwd = client->enc_pwd;
+			session.expiry_time = now + reauth_timeout;
+		}
+	}
+
 	acceptAuth(pkt->getPeerId(), wantSudo);
 }
 
+void Server::handleCommand_SessionReauth(NetworkPacket* pkt)
+{
+	RemoteClient* client = getClient(pkt->getPeerId(), CS_Invalid);
+	ClientState cstate = client->getState();
+
+	verbosestream << "Server: Received TOSERVER_SESSION_REAUTH." << std::endl;
+
+	// Unlike SRP this mechanism is not valid in sudo mode: changing the
+	// password must prove knowledge of the current password itself.
+	if (cstate != CS_HelloSent) {
+		actionstream << "Server: got session reauth packet in wrong state "
+			<< cstate << " from "
+			<< getPeerAddress(pkt->getPeerId()).serializeString()
+			<< ". Ignoring." << std::endl;
+		return;
+	}
+
+	if (client->chosen_mech != AUTH_MECHANISM_NONE) {
+		actionstream << "Server: got session reauth packet, while auth"
+			<< "is already going on with mech " << client->chosen_mech
+			<< " from " << getPeerAddress(pkt->getPeerId()).serializeString()
+			<< ". Ignoring." << std::endl;
+		DenyAccess(pkt->getPeerId(), SERVER_ACCESSDENIED_UNEXPECTED_DATA);
+		return;
+	}
+
+	if (!client->isMechAllowed(AUTH_MECHANISM_SESSION_KEY) ||
+			client->reauth_challenge.empty()) {
+		actionstream << "Server: Client tried to authenticate from "
+			<< getPeerAddress(pkt->getPeerId()).serializeString()
+			<< " using unallowed mech " << AUTH_MECHANISM_SESSION_KEY
+			<< "." << std::endl;
+		DenyAccess(pkt->getPeerId(), SERVER_ACCESSDENIED_UNEXPECTED_DATA);
+		return;
+	}
+
+	std::string proof;
+	*pkt >> proof;
+
+	client->chosen_mech = AUTH_MECHANISM_SESSION_KEY;
+
+	if (m_session_replay) {
+		// Recorded reauth proofs hash a challenge this run never sent
+		acceptAuth(pkt->getPeerId(), false);
+		return;
+	}
+
+	bool proof_ok = false;
+	std::unordered_map<std::string, CachedSession>::iterator session_it =
+		m_cached_sessions.find(client->getName());
+	if (session_it != m_cached_sessions.end() &&
+			porting::getTimeS() < session_it->second.expiry_time) {
+		std::string expected_input = session_it->second.key
+			+ client->reauth_challenge;
+		unsigned char expected[SHA256_DIGEST_LENGTH];
+		SHA256((const unsigned char *) expected_input.c_str(),
+			expected_input.size(), expected);
+
+		// Compare in constant time, a timing oracle would leak the digest
+		if (proof.size() == SHA256_DIGEST_LENGTH) {
+			u8 diff = 0;
+			for (size_t i = 0; i < SHA256_DIGEST_LENGTH; i++)
+				diff |= (u8) proof[i] ^ expected[i];
+			proof_ok = (diff == 0);
+		}
+	}
+
+	// The challenge is single use either way
+	client->reauth_challenge.clear();
+
+	if (!proof_ok) {
+		// Force a full SRP exchange on the next attempt
+		if (session_it != m_cached_sessions.end())
+			m_cached_sessions.erase(session_it);
+
+		std::string ip = getPeerAddress(pkt->getPeerId()).serializeString();
+		actionstream << "Server: User " << client->getName()
+			<< " at " << ip
+			<< " supplied wrong session reauth proof." << std::endl;
+		m_script->on_auth_failure(client->getName(), ip);
+		DenyAccess(pkt->getPeerId(), SERVER_ACCESSDENIED_WRONG_PASSWORD);
+		return;
+	}
+
+	// Successful logins keep the cached session alive
+	session_it->second.expiry_time = porting::getTimeS()
+		+ g_settings->getU64("session_reauth_timeout");
+
+	acceptAuth(pkt->getPeerId(), false);
+}
+
 /*
  * Mod channels
  */
@@ -0,0 +1,141 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "sessionlog.h"
+
+#include <cstring>
+#include "log.h"
+#include "porting.h"
+#include "util/serialize.h"
+
+static const char SESSIONLOG_MAGIC[4] = {'M', 'T', 'S', 'L'};
+static const u8 SESSIONLOG_VERSION = 1;
+
+/*
+	SessionLogWriter
+*/
+
+bool SessionLogWriter::open(const std::string &path)
+{
+	m_file.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_file.good()) {
+		errorstream << "SessionLogWriter: cannot open \"" << path << "\""
+			<< std::endl;
+		return false;
+	}
+	m_file.write(SESSIONLOG_MAGIC, sizeof(SESSIONLOG_MAGIC));
+	writeU8(m_file, SESSIONLOG_VERSION);
+	m_start_ms = porting::getTimeMs();
+	return true;
+}
+
+void SessionLogWriter::writeHeader(SessionLogEventType type, session_t peer_id)
+{
+	writeU8(m_file, type);
+	writeU32(m_file, (u32) (porting::getTimeMs() - m_start_ms));
+	writeU16(m_file, peer_id);
+}
+
+void SessionLogWriter::writeData(session_t peer_id, const u8 *data, u32 size)
+{
+	writeHeader(SESSIONLOG_DATA, peer_id);
+	writeU32(m_file, size);
+	m_file.write((const char *) data, size);
+}
+
+void SessionLogWriter::writePeerAdded(session_t peer_id)
+{
+	writeHeader(SESSIONLOG_PEER_ADDED, peer_id);
+}
+
+void SessionLogWriter::writePeerRemoved(session_t peer_id, bool timeout)
+{
+	writeHeader(SESSIONLOG_PEER_REMOVED, peer_id);
+	writeU8(m_file, timeout ? 1 : 0);
+}
+
+/*
+	SessionLogReader
+*/
+
+bool SessionLogReader::open(const std::string &path)
+{
+	m_file.open(path.c_str(), std::ios::in | std::ios::binary);
+	if (!m_file.good()) {
+		errorstream << "SessionLogReader: cannot open \"" << path << "\""
+			<< std::endl;
+		return false;
+	}
+	char magic[4];
+	m_file.read(magic, sizeof(magic));
+	u8 version = readU8(m_file);
+	if (!m_file.good() || memcmp(magic, SESSIONLOG_MAGIC, sizeof(magic)) != 0) {
+		errorstream << "SessionLogReader: \"" << path
+			<< "\" is not a session log" << std::endl;
+		m_file.close();
+		return false;
+	}
+	if (version != SESSIONLOG_VERSION) {
+		errorstream << "SessionLogReader: \"" << path
+			<< "\" has unsupported version " << (int) version << std::endl;
+		m_file.close();
+		return false;
+	}
+	return true;
+}
+
+bool SessionLogReader::read(SessionLogEntry *entry)
+{
+	if (!m_file.is_open())
+		return false;
+
+	u8 type = readU8(m_file);
+	entry->time_ms = readU32(m_file);
+	entry->peer_id = readU16(m_file);
+	if (m_file.eof() || !m_file.good())
+		return false;
+
+	entry->timeout = false;
+	entry->data.clear();
+
+	switch (type) {
+	case SESSIONLOG_DATA: {
+		u32 size = readU32(m_file);
+		if (!m_file.good())
+			return false;
+		entry->data.resize(size);
+		m_file.read(&entry->data[0], size);
+		break;
+	}
+	case SESSIONLOG_PEER_ADDED:
+		break;
+	case SESSIONLOG_PEER_REMOVED:
+		entry->timeout = readU8(m_file) != 0;
+		break;
+	default:
+		errorstream << "SessionLogReader: unknown event type " << (int) type
+			<< ", stopping" << std::endl;
+		return false;
+	}
+	if (!m_file.good())
+		return false;
+
+	entry->type = (SessionLogEventType) type;
+	return true;
+}
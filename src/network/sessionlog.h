@@ -0,0 +1,87 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include "irrlichttypes.h"
+#include "networkprotocol.h"
+
+/*
+	File format for recorded network sessions: everything the server
+	application saw coming out of the Connection layer, timestamped
+	relative to the start of the recording. Recorded with the
+	session_record_path setting, played back with --replay-session (see
+	session_replay_loop in server.cpp).
+
+	Layout: 4 byte magic "MTSL", u8 version, then per event
+		u8 type (SessionLogEventType)
+		u32 time since recording start in ms
+		u16 peer id
+		type SESSIONLOG_DATA:         u32 payload size, payload
+		type SESSIONLOG_PEER_REMOVED: u8 timeout flag
+	All fields are big-endian, matching util/serialize.h.
+*/
+
+enum SessionLogEventType : u8
+{
+	SESSIONLOG_DATA = 0,
+	SESSIONLOG_PEER_ADDED = 1,
+	SESSIONLOG_PEER_REMOVED = 2,
+};
+
+struct SessionLogEntry
+{
+	SessionLogEventType type = SESSIONLOG_DATA;
+	u32 time_ms = 0;
+	session_t peer_id = 0;
+	bool timeout = false;
+	std::string data;
+};
+
+class SessionLogWriter
+{
+public:
+	bool open(const std::string &path);
+	bool isOpen() const { return m_file.is_open(); }
+
+	// Timestamps are taken relative to the open() call
+	void writeData(session_t peer_id, const u8 *data, u32 size);
+	void writePeerAdded(session_t peer_id);
+	void writePeerRemoved(session_t peer_id, bool timeout);
+
+private:
+	void writeHeader(SessionLogEventType type, session_t peer_id);
+
+	std::ofstream m_file;
+	u64 m_start_ms = 0;
+};
+
+class SessionLogReader
+{
+public:
+	bool open(const std::string &path);
+
+	// Returns false at end of file or on a malformed entry
+	bool read(SessionLogEntry *entry);
+
+private:
+	std::ifstream m_file;
+};
@@ -130,6 +130,29 @@ bool UDPSocket::init(bool ipv6, bool noExceptions)
 	return true;
 }
 
+bool UDPSocket::enableReusePort()
+{
+#if !defined(_WIN32) && defined(SO_REUSEPORT)
+	int value = 1;
+	if (setsockopt(m_handle, SOL_SOCKET, SO_REUSEPORT,
+			reinterpret_cast<char *>(&value), sizeof(value)) != 0) {
+		errorstream << "UDPSocket(" << (int)m_handle
+			<< ")::enableReusePort(): failed: error "
+			<< LAST_SOCKET_ERR() << std::endl;
+		return false;
+	}
+
+	if (socket_enable_debug_output) {
+		dstream << "UDPSocket(" << (int)m_handle
+			<< ")::enableReusePort()" << std::endl;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
 UDPSocket::~UDPSocket()
 {
 	if (socket_enable_debug_output) {
@@ -248,6 +271,92 @@ void UDPSocket::Send(const Address &destination, const void *data, int size)
 		throw SendFailedException("Failed to send packet");
 }
 
+void UDPSocket::Send(const Address &destination, const void *header,
+		int header_size, const void *payload, int payload_size)
+{
+	bool dumping_packet = false; // for INTERNET_SIMULATOR
+
+	if (INTERNET_SIMULATOR)
+		dumping_packet = myrand() % INTERNET_SIMULATOR_PACKET_LOSS == 0;
+
+	if (socket_enable_debug_output) {
+		// Print packet destination and size
+		dstream << (int)m_handle << " -> ";
+		destination.print(&dstream);
+		dstream << ", size=" << (header_size + payload_size)
+			<< " (scatter-gather)";
+
+		if (dumping_packet)
+			dstream << " (DUMPED BY INTERNET_SIMULATOR)";
+
+		dstream << std::endl;
+	}
+
+	if (dumping_packet) {
+		// Lol let's forget it
+		dstream << "UDPSocket::Send(): INTERNET_SIMULATOR: dumping packet."
+			<< std::endl;
+		return;
+	}
+
+	if (destination.getFamily() != m_addr_family)
+		throw SendFailedException("Address family mismatch");
+
+	int size = header_size + payload_size;
+	int sent;
+#ifdef _WIN32
+	WSABUF buffers[2];
+	buffers[0].buf = (char *)header;
+	buffers[0].len = header_size;
+	buffers[1].buf = (char *)payload;
+	buffers[1].len = payload_size;
+	DWORD bytes_sent = 0;
+	int result;
+	if (m_addr_family == AF_INET6) {
+		struct sockaddr_in6 address = destination.getAddress6();
+		address.sin6_port = htons(destination.getPort());
+		result = WSASendTo(m_handle, buffers, 2, &bytes_sent, 0,
+				(struct sockaddr *)&address, sizeof(struct sockaddr_in6),
+				NULL, NULL);
+	} else {
+		struct sockaddr_in address = destination.getAddress();
+		address.sin_port = htons(destination.getPort());
+		result = WSASendTo(m_handle, buffers, 2, &bytes_sent, 0,
+				(struct sockaddr *)&address, sizeof(struct sockaddr_in),
+				NULL, NULL);
+	}
+	sent = (result == 0) ? (int)bytes_sent : -1;
+#else
+	struct iovec iov[2];
+	iov[0].iov_base = const_cast<void *>(header);
+	iov[0].iov_len = header_size;
+	iov[1].iov_base = const_cast<void *>(payload);
+	iov[1].iov_len = payload_size;
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	if (m_addr_family == AF_INET6) {
+		struct sockaddr_in6 address = destination.getAddress6();
+		address.sin6_port = htons(destination.getPort());
+		msg.msg_name = &address;
+		msg.msg_namelen = sizeof(struct sockaddr_in6);
+		sent = sendmsg(m_handle, &msg, 0);
+	} else {
+		struct sockaddr_in address = destination.getAddress();
+		address.sin_port = htons(destination.getPort());
+		msg.msg_name = &address;
+		msg.msg_namelen = sizeof(struct sockaddr_in);
+		sent = sendmsg(m_handle, &msg, 0);
+	}
+#endif
+
+	if (sent != size)
+		throw SendFailedException("Failed to send packet");
+}
+
 int UDPSocket::Receive(Address &sender, void *data, int size)
 {
 	// Return on timeout
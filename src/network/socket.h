@@ -53,9 +53,19 @@ public:
 
 	bool init(bool ipv6, bool noExceptions = false);
 
+	// Allows several sockets to bind the same port so the kernel shards
+	// incoming datagrams between them by sender. Must be called before
+	// Bind() on every socket sharing the port. Returns false where the
+	// platform doesn't support SO_REUSEPORT.
+	bool enableReusePort();
+
 	// void Close();
 	// bool IsOpen();
 	void Send(const Address &destination, const void *data, int size);
+	// Scatter-gather variant: header and payload are sent as one datagram
+	// without being copied into a joint buffer first
+	void Send(const Address &destination, const void *header, int header_size,
+			const void *payload, int payload_size);
 	// Returns -1 if there is no data
 	int Receive(Address &sender, void *data, int size);
 	int GetHandle(); // For debugging purposes only
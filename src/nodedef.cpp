@@ -27,6 +27,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client/renderingengine.h"
 #include "client/tile.h"
 #include <IMeshManipulator.h>
+#include <atomic>
+#include "threading/thread.h"
+#include "porting.h"
 #endif
 #include "log.h"
 #include "settings.h"
@@ -626,6 +629,8 @@ static void fillTileAttribs(ITextureSource *tsrc, TileLayer *layer,
 		layer->material_flags |= MATERIAL_FLAG_BACKFACE_CULLING;
 	if (tiledef.animation.type != TAT_NONE)
 		layer->material_flags |= MATERIAL_FLAG_ANIMATION;
+	if (tiledef.animation.type == TAT_VERTICAL_FRAMES)
+		layer->material_flags |= MATERIAL_FLAG_ANIMATION_VERTICAL_FRAMES;
 	if (tiledef.tileable_horizontal)
 		layer->material_flags |= MATERIAL_FLAG_TILEABLE_HORIZONTAL;
 	if (tiledef.tileable_vertical)
@@ -693,12 +698,8 @@ bool isWorldAligned(AlignStyle style, WorldAlignMode mode, NodeDrawType drawtype
 }
 
 void ContentFeatures::updateTextures(ITextureSource *tsrc, IShaderSource *shdsrc,
-	scene::IMeshManipulator *meshmanip, Client *client, const TextureSettings &tsettings)
+	scene::IMeshManipulator *meshmanip, const TextureSettings &tsettings)
 {
-	// minimap pixel color - the average color of a texture
-	if (tsettings.enable_minimap && !tiledef[0].name.empty())
-		minimap_color = tsrc->getTextureAverageColor(tiledef[0].name);
-
 	// Figure out the actual tiles to use
 	TileDef tdef[6];
 	for (u32 j = 0; j < 6; j++) {
@@ -872,8 +873,9 @@ void ContentFeatures::updateTextures(ITextureSource *tsrc, IShaderSource *shdsrc
 
 	if (drawtype == NDT_MESH && !mesh.empty()) {
 		// Meshnode drawtype
-		// Read the mesh and apply scale
-		mesh_ptr[0] = client->getMesh(mesh);
+		// The mesh itself was loaded by NodeDefManager::updateTextures()
+		// on the main thread (the scene manager is not thread-safe);
+		// apply scale
 		if (mesh_ptr[0]){
 			v3f scale = v3f(1.0, 1.0, 1.0) * BS * visual_scale;
 			scaleMesh(mesh_ptr[0], scale);
@@ -1001,6 +1003,10 @@ void NodeDefManager::clear()
 		m_content_features[c] = f;
 		addNameIdMapping(c, f.name);
 	}
+
+	m_day_night_can_differ.clear();
+	for (content_t c = 0; c < initial_length; c++)
+		updateLightDayNightFlag(c);
 }
 
 
@@ -1202,6 +1208,18 @@ inline void NodeDefManager::fixSelectionBoxIntUnion()
 }
 
 
+void NodeDefManager::updateLightDayNightFlag(content_t id)
+{
+	// Unregistered IDs default to true (see lightDayNightCanDiffer)
+	if (id >= m_day_night_can_differ.size())
+		m_day_night_can_differ.resize(id + 1, true);
+	// Only CPT_LIGHT nodes store light, so only they can carry
+	// different day and night values (see MapNode::isLightDayNightEq)
+	m_day_night_can_differ[id] =
+			m_content_features[id].param_type == CPT_LIGHT;
+}
+
+
 void NodeDefManager::eraseIdFromGroups(content_t id)
 {
 	// For all groups in m_group_to_items...
@@ -1253,6 +1271,7 @@ content_t NodeDefManager::set(const std::string &name, const ContentFeatures &de
 
 	getNodeBoxUnion(def.selection_box, def, &m_selection_box_union);
 	fixSelectionBoxIntUnion();
+	updateLightDayNightFlag(id);
 
 	// Add this content to the list of all groups it belongs to
 	for (const auto &group : def.groups) {
@@ -1361,6 +1380,61 @@ void NodeDefManager::applyTextureOverrides(const std::string &override_filepath)
 	}
 }
 
+#ifndef SERVER
+/*
+	Resolves tiles for node definitions pulled from a shared cursor.
+	Texture and shader generation still happens on the main thread (which
+	services the request queues meanwhile), but tile attribute resolution,
+	cached lookups and the facedir mesh rotation caches run in parallel.
+*/
+class NodeDefUpdateTexturesThread : public Thread
+{
+public:
+	NodeDefUpdateTexturesThread(std::vector<ContentFeatures> *features,
+			std::atomic<u32> *cursor, std::atomic<u32> *done,
+			ITextureSource *tsrc, IShaderSource *shdsrc,
+			scene::IMeshManipulator *meshmanip,
+			const TextureSettings *tsettings):
+		Thread("NodeDefTextures"),
+		m_features(features),
+		m_cursor(cursor),
+		m_done(done),
+		m_tsrc(tsrc),
+		m_shdsrc(shdsrc),
+		m_meshmanip(meshmanip),
+		m_tsettings(tsettings)
+	{
+	}
+
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		u32 size = m_features->size();
+		for (;;) {
+			u32 i = m_cursor->fetch_add(1);
+			if (i >= size)
+				break;
+			(*m_features)[i].updateTextures(m_tsrc, m_shdsrc, m_meshmanip,
+					*m_tsettings);
+			m_done->fetch_add(1);
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+		return nullptr;
+	}
+
+private:
+	std::vector<ContentFeatures> *m_features;
+	std::atomic<u32> *m_cursor;
+	std::atomic<u32> *m_done;
+	ITextureSource *m_tsrc;
+	IShaderSource *m_shdsrc;
+	scene::IMeshManipulator *m_meshmanip;
+	const TextureSettings *m_tsettings;
+};
+#endif
+
 void NodeDefManager::updateTextures(IGameDef *gamedef,
 	void (*progress_callback)(void *progress_args, u32 progress, u32 max_progress),
 	void *progress_callback_args)
@@ -1370,8 +1444,8 @@ void NodeDefManager::updateTextures(IGameDef *gamedef,
 		"textures in node definitions" << std::endl;
 
 	Client *client = (Client *)gamedef;
-	ITextureSource *tsrc = client->tsrc();
-	IShaderSource *shdsrc = client->getShaderSource();
+	IWritableTextureSource *tsrc = client->getWritableTextureSource();
+	IWritableShaderSource *shdsrc = client->getWritableShaderSource();
 	scene::IMeshManipulator *meshmanip =
 		RenderingEngine::get_scene_manager()->getMeshManipulator();
 	TextureSettings tsettings;
@@ -1379,11 +1453,66 @@ void NodeDefManager::updateTextures(IGameDef *gamedef,
 
 	u32 size = m_content_features.size();
 
+	// Pre-pass on the main thread: load node meshes and palettes.
+	// Neither the scene manager nor image loading is thread-safe, and
+	// warming the palette cache lets the workers take the lock-only
+	// lookup path in TextureSource::getPalette().
 	for (u32 i = 0; i < size; i++) {
 		ContentFeatures *f = &(m_content_features[i]);
-		f->updateTextures(tsrc, shdsrc, meshmanip, client, tsettings);
-		progress_callback(progress_callback_args, i, size);
+		if (f->drawtype == NDT_MESH && !f->mesh.empty())
+			f->mesh_ptr[0] = client->getMesh(f->mesh);
+		if (f->param_type_2 == CPT2_COLOR ||
+				f->param_type_2 == CPT2_COLORED_FACEDIR ||
+				f->param_type_2 == CPT2_COLORED_WALLMOUNTED)
+			tsrc->getPalette(f->palette_name);
+	}
+
+	u32 thread_count = Thread::getNumberOfProcessors();
+	thread_count = rangelim(thread_count, 1, 8);
+
+	std::atomic<u32> cursor(0);
+	std::atomic<u32> done(0);
+	std::vector<NodeDefUpdateTexturesThread *> threads;
+	for (u32 i = 0; i < thread_count; i++) {
+		threads.push_back(new NodeDefUpdateTexturesThread(
+				&m_content_features, &cursor, &done,
+				tsrc, shdsrc, meshmanip, &tsettings));
+		threads.back()->start();
+	}
+
+	// Service the texture and shader request queues until the workers
+	// are done; only the main thread may drive the video driver.
+	u32 reported = 0;
+	while (done.load() < size) {
+		tsrc->processQueue();
+		shdsrc->processQueue();
+
+		u32 d = done.load();
+		if (d != reported) {
+			progress_callback(progress_callback_args, d, size);
+			reported = d;
+		} else {
+			sleep_ms(0);
+		}
+	}
+
+	for (NodeDefUpdateTexturesThread *thread : threads) {
+		thread->wait();
+		delete thread;
 	}
+
+	// Minimap colors are sampled back from the generated textures,
+	// which again requires the video driver
+	if (tsettings.enable_minimap) {
+		for (u32 i = 0; i < size; i++) {
+			ContentFeatures *f = &(m_content_features[i]);
+			if (!f->tiledef[0].name.empty())
+				f->minimap_color =
+					tsrc->getTextureAverageColor(f->tiledef[0].name);
+		}
+	}
+
+	progress_callback(progress_callback_args, size, size);
 #endif
 }
 
@@ -1462,6 +1591,7 @@ void NodeDefManager::deSerialize(std::istream &is)
 
 		getNodeBoxUnion(f.selection_box, f, &m_selection_box_union);
 		fixSelectionBoxIntUnion();
+		updateLightDayNightFlag(i);
 	}
 }
 
@@ -434,8 +434,15 @@ struct ContentFeatures
 	}
 
 #ifndef SERVER
+	/*
+		Resolves the tiles of this node definition. May be called from a
+		worker thread: texture and shader generation is queued to the main
+		thread, which must service the queues meanwhile (see
+		NodeDefManager::updateTextures()). mesh_ptr[0] must already be
+		loaded by the caller on the main thread.
+	*/
 	void updateTextures(ITextureSource *tsrc, IShaderSource *shdsrc,
-		scene::IMeshManipulator *meshmanip, Client *client, const TextureSettings &tsettings);
+		scene::IMeshManipulator *meshmanip, const TextureSettings &tsettings);
 #endif
 };
 
@@ -525,6 +532,18 @@ public:
 		return m_selection_box_int_union;
 	}
 
+	/*!
+	 * Tells whether nodes of the given content type can ever carry
+	 * different day and night light values (i.e. use CPT_LIGHT).
+	 * Precomputed at registration into a packed bitset, so per-node
+	 * scans like MapBlock::actuallyUpdateDayNightDiff() can test it
+	 * without fetching the ContentFeatures.
+	 */
+	inline bool lightDayNightCanDiffer(content_t c) const {
+		return c < m_day_night_can_differ.size() ?
+			(bool) m_day_night_can_differ[c] : true;
+	}
+
 	/*!
 	 * Checks whether a node connects to an adjacent node.
 	 * @param from the node to be checked
@@ -682,9 +701,24 @@ private:
 	 */
 	void fixSelectionBoxIntUnion();
 
+	/*!
+	 * Refreshes the \ref m_day_night_can_differ bit of a content ID
+	 * from its registered features.
+	 * @param id a content ID with valid ContentFeatures
+	 */
+	void updateLightDayNightFlag(content_t id);
+
 	//! Features indexed by ID.
 	std::vector<ContentFeatures> m_content_features;
 
+	/*!
+	 * Packed per-content flags telling whether a content type can ever
+	 * have differing day/night light, indexed by ID. Kept in sync with
+	 * \ref m_content_features by \ref updateLightDayNightFlag().
+	 * Note: Not serialized.
+	 */
+	std::vector<bool> m_day_night_can_differ;
+
 	//! A mapping for fast conversion between names and IDs
 	NameIdMapping m_name_id_mapping;
 
@@ -40,22 +40,44 @@ NodeMetadata::~NodeMetadata()
 	delete m_inventory;
 }
 
-void NodeMetadata::serialize(std::ostream &os, u8 version, bool disk) const
+void NodeMetadata::serialize(std::ostream &os, u8 version, bool disk)
 {
+	int slot = disk ? 1 : 0;
+	bool clean = !isModified() && !m_inventory->checkModified();
+	if (clean && m_serialize_cache_version[slot] == version) {
+		// Nothing changed since this variant was last serialized
+		os << m_serialize_cache[slot];
+		return;
+	}
+	if (!clean) {
+		// Both variants went stale
+		m_serialize_cache_version[0] = 0;
+		m_serialize_cache_version[1] = 0;
+	}
+
+	std::ostringstream ss(std::ios::binary);
 	int num_vars = disk ? m_stringvars.size() : countNonPrivate();
-	writeU32(os, num_vars);
+	writeU32(ss, num_vars);
 	for (const auto &sv : m_stringvars) {
 		bool priv = isPrivate(sv.first);
 		if (!disk && priv)
 			continue;
 
-		os << serializeString(sv.first);
-		os << serializeLongString(sv.second);
+		ss << serializeString(sv.first);
+		ss << serializeLongString(sv.second);
 		if (version >= 2)
-			writeU8(os, (priv) ? 1 : 0);
+			writeU8(ss, (priv) ? 1 : 0);
 	}
 
-	m_inventory->serialize(os);
+	m_inventory->serialize(ss);
+
+	m_serialize_cache[slot] = ss.str();
+	m_serialize_cache_version[slot] = version;
+	// The modified flags now only mean "caches stale"; clear them
+	setModified(false);
+	m_inventory->setModified(false);
+
+	os << m_serialize_cache[slot];
 }
 
 void NodeMetadata::deSerialize(std::istream &is, u8 version)
@@ -73,6 +95,9 @@ void NodeMetadata::deSerialize(std::istream &is, u8 version)
 	}
 
 	m_inventory->deSerialize(is);
+
+	// Invalidate the serialization cache
+	setModified(true);
 }
 
 void NodeMetadata::clear()
@@ -94,6 +119,8 @@ void NodeMetadata::markPrivate(const std::string &name, bool set)
 		m_privatevars.insert(name);
 	else
 		m_privatevars.erase(name);
+	// Changes the network variant of the serialized form
+	setModified(true);
 }
 
 int NodeMetadata::countNonPrivate() const
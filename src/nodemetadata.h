@@ -40,7 +40,7 @@ public:
 	NodeMetadata(IItemDefManager *item_def_mgr);
 	~NodeMetadata();
 
-	void serialize(std::ostream &os, u8 version, bool disk=true) const;
+	void serialize(std::ostream &os, u8 version, bool disk=true);
 	void deSerialize(std::istream &is, u8 version);
 
 	void clear();
@@ -63,6 +63,18 @@ private:
 
 	Inventory *m_inventory;
 	std::unordered_set<std::string> m_privatevars;
+
+	/*
+		Cached serialized form, one slot each for the network and disk
+		variants. Valid while the modified flags stay clear; node
+		metadata has no other consumer of Metadata::isModified() or the
+		inventory dirty flag, so serialization owns them as its
+		invalidation signal. Saving a block full of untouched chests
+		then reuses the cached bytes instead of re-serializing each
+		inventory.
+	*/
+	std::string m_serialize_cache[2];
+	u8 m_serialize_cache_version[2] = {0, 0}; // 0 = invalid
 };
 
 
@@ -97,6 +109,13 @@ public:
 	// Deletes all
 	void clear();
 
+	// Exchanges contents (and ownership of them) with another list
+	void swap(NodeMetadataList &other)
+	{
+		std::swap(m_is_metadata_owner, other.m_is_metadata_owner);
+		std::swap(m_data, other.m_data);
+	}
+
 	size_t size() const { return m_data.size(); }
 
 	NodeMetadataMap::const_iterator begin()
@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serialization.h"
 #include "util/serialize.h"
 #include "constants.h" // MAP_BLOCKSIZE
+#include <set>
 
 /*
 	NodeTimer
@@ -60,10 +61,10 @@ void NodeTimerList::serialize(std::ostream &os, u8 map_format_version) const
 		writeU16(os, m_timers.size());
 	}
 
-	for (const auto &timer : m_timers) {
-		NodeTimer t = timer.second;
+	for (const TimerEntry &e : m_timers) {
+		const NodeTimer &t = e.timer;
 		NodeTimer nt = NodeTimer(t.timeout,
-			t.timeout - (f32)(timer.first - m_time), t.position);
+			t.timeout - (f32)(e.trigger_time - m_time), t.position);
 		v3s16 p = t.position;
 
 		u16 p16 = p.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE + p.Y * MAP_BLOCKSIZE + p.X;
@@ -92,6 +93,7 @@ void NodeTimerList::deSerialize(std::istream &is, u8 map_format_version)
 
 	u16 count = readU16(is);
 
+	std::set<v3s16> positions;
 	for (u16 i = 0; i < count; i++) {
 		u16 p16 = readU16(is);
 
@@ -113,7 +115,7 @@ void NodeTimerList::deSerialize(std::istream &is, u8 map_format_version)
 			continue;
 		}
 
-		if (m_iterators.find(p) != m_iterators.end()) {
+		if (!positions.insert(p).second) {
 			warningstream<<"NodeTimerList::deSerialize(): "
 					<<"already set data at position"
 					<<"("<<p.X<<","<<p.Y<<","<<p.Z<<"): Ignoring."
@@ -125,26 +127,26 @@ void NodeTimerList::deSerialize(std::istream &is, u8 map_format_version)
 	}
 }
 
-std::vector<NodeTimer> NodeTimerList::step(float dtime)
+bool NodeTimerList::step(float dtime, std::vector<NodeTimer> &elapsed_timers)
 {
-	std::vector<NodeTimer> elapsed_timers;
 	m_time += dtime;
-	if (m_next_trigger_time == -1. || m_time < m_next_trigger_time) {
-		return elapsed_timers;
-	}
-	std::multimap<double, NodeTimer>::iterator i = m_timers.begin();
+	if (m_next_trigger_time == -1. || m_time < m_next_trigger_time)
+		return false;
+	bool triggered = false;
 	// Process timers
-	for (; i != m_timers.end() && i->first <= m_time; ++i) {
-		NodeTimer t = i->second;
-		t.elapsed = t.timeout + (f32)(m_time - i->first);
+	for (size_t i = 0; i < m_timers.size();) {
+		if (m_timers[i].trigger_time > m_time) {
+			i++;
+			continue;
+		}
+		NodeTimer t = m_timers[i].timer;
+		t.elapsed = t.timeout + (f32)(m_time - m_timers[i].trigger_time);
 		elapsed_timers.push_back(t);
-		m_iterators.erase(t.position);
+		triggered = true;
+		// Delete the elapsed timer
+		m_timers[i] = m_timers.back();
+		m_timers.pop_back();
 	}
-	// Delete elapsed timers
-	m_timers.erase(m_timers.begin(), i);
-	if (m_timers.empty())
-		m_next_trigger_time = -1.;
-	else
-		m_next_trigger_time = m_timers.begin()->first;
-	return elapsed_timers;
+	updateNextTriggerTime();
+	return triggered;
 }
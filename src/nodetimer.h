@@ -21,7 +21,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irr_v3d.h"
 #include <iostream>
-#include <map>
 #include <vector>
 
 /*
@@ -52,6 +51,11 @@ public:
 
 /*
 	List of timers of all the nodes of a block
+
+	The timers are kept in a flat vector together with their absolute
+	trigger time; a block rarely carries more than a handful of them, so
+	linear scans beat tree containers and the cached next-trigger time
+	makes stepping an idle block a simple comparison.
 */
 
 class NodeTimerList
@@ -65,43 +69,36 @@ public:
 
 	// Get timer
 	NodeTimer get(const v3s16 &p) {
-		std::map<v3s16, std::multimap<double, NodeTimer>::iterator>::iterator n =
-			m_iterators.find(p);
-		if (n == m_iterators.end())
-			return NodeTimer();
-		NodeTimer t = n->second->second;
-		t.elapsed = t.timeout - (n->second->first - m_time);
-		return t;
+		for (const TimerEntry &e : m_timers) {
+			if (e.timer.position == p) {
+				NodeTimer t = e.timer;
+				t.elapsed = t.timeout - (f32)(e.trigger_time - m_time);
+				return t;
+			}
+		}
+		return NodeTimer();
 	}
 	// Deletes timer
 	void remove(v3s16 p) {
-		std::map<v3s16, std::multimap<double, NodeTimer>::iterator>::iterator n =
-			m_iterators.find(p);
-		if(n != m_iterators.end()) {
-			double removed_time = n->second->first;
-			m_timers.erase(n->second);
-			m_iterators.erase(n);
-			// Yes, this is float equality, but it is not a problem
-			// since we only test equality of floats as an ordered type
-			// and thus we never lose precision
-			if (removed_time == m_next_trigger_time) {
-				if (m_timers.empty())
-					m_next_trigger_time = -1.;
-				else
-					m_next_trigger_time = m_timers.begin()->first;
+		for (std::vector<TimerEntry>::iterator it = m_timers.begin();
+				it != m_timers.end(); ++it) {
+			if (it->timer.position == p) {
+				double removed_time = it->trigger_time;
+				*it = m_timers.back();
+				m_timers.pop_back();
+				// Yes, this is float equality, but it is not a problem
+				// since we only test equality of floats as an ordered type
+				// and thus we never lose precision
+				if (removed_time == m_next_trigger_time)
+					updateNextTriggerTime();
+				return;
 			}
 		}
 	}
 	// Undefined behaviour if there already is a timer
 	void insert(NodeTimer timer) {
-		v3s16 p = timer.position;
 		double trigger_time = m_time + (double)(timer.timeout - timer.elapsed);
-		std::multimap<double, NodeTimer>::iterator it =
-			m_timers.insert(std::pair<double, NodeTimer>(
-				trigger_time, timer
-			));
-		m_iterators.insert(
-			std::pair<v3s16, std::multimap<double, NodeTimer>::iterator>(p, it));
+		m_timers.emplace_back(trigger_time, timer);
 		if (m_next_trigger_time == -1. || trigger_time < m_next_trigger_time)
 			m_next_trigger_time = trigger_time;
 	}
@@ -113,16 +110,33 @@ public:
 	// Deletes all timers
 	void clear() {
 		m_timers.clear();
-		m_iterators.clear();
 		m_next_trigger_time = -1.;
 	}
 
-	// Move forward in time, returns elapsed timers
-	std::vector<NodeTimer> step(float dtime);
+	// Move forward in time; appends elapsed timers to the given vector
+	// and returns whether any timer elapsed. Idle blocks pay only the
+	// next-trigger comparison.
+	bool step(float dtime, std::vector<NodeTimer> &elapsed_timers);
 
 private:
-	std::multimap<double, NodeTimer> m_timers;
-	std::map<v3s16, std::multimap<double, NodeTimer>::iterator> m_iterators;
+	struct TimerEntry {
+		double trigger_time;
+		NodeTimer timer;
+
+		TimerEntry(double trigger_time_, const NodeTimer &timer_):
+			trigger_time(trigger_time_), timer(timer_) {}
+	};
+
+	void updateNextTriggerTime() {
+		m_next_trigger_time = -1.;
+		for (const TimerEntry &e : m_timers) {
+			if (m_next_trigger_time == -1. ||
+					e.trigger_time < m_next_trigger_time)
+				m_next_trigger_time = e.trigger_time;
+		}
+	}
+
+	std::vector<TimerEntry> m_timers;
 	double m_next_trigger_time = -1.0;
 	double m_time = 0.0;
 };
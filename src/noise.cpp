@@ -77,14 +77,71 @@ void PcgRandom::seed(u64 state, u64 seq)
 }
 
 
+// The PCG32 output permutation (XSH-RR)
+static inline u32 pcgOutput(u64 oldstate)
+{
+	u32 xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
+	u32 rot = oldstate >> 59u;
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+
 u32 PcgRandom::next()
 {
 	u64 oldstate = m_state;
 	m_state = oldstate * 6364136223846793005ULL + m_inc;
 
-	u32 xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
-	u32 rot = oldstate >> 59u;
-	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	return pcgOutput(oldstate);
+}
+
+
+void PcgRandom::fill(u32 *out, size_t len)
+{
+	/*
+		Emits exactly the same values as len successive next() calls.
+
+		next() chains every state through a 64-bit multiply, so each
+		value waits out the full latency of the one before it.  Here four
+		streams start at four consecutive states and each advances four
+		steps at a time (the constants below fold four LCG steps into
+		one), giving the CPU four independent dependency chains to
+		overlap.
+	*/
+	static const u64 mult = 6364136223846793005ULL;
+
+	if (len < 16) {
+		for (size_t i = 0; i < len; i++)
+			out[i] = next();
+		return;
+	}
+
+	// state * a4 + c4 == four applications of state * mult + m_inc
+	const u64 a2 = mult * mult;
+	const u64 c2 = (mult + 1) * m_inc;
+	const u64 a4 = a2 * a2;
+	const u64 c4 = (a2 + 1) * c2;
+
+	u64 s0 = m_state;
+	u64 s1 = s0 * mult + m_inc;
+	u64 s2 = s1 * mult + m_inc;
+	u64 s3 = s2 * mult + m_inc;
+
+	size_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		out[i]     = pcgOutput(s0);
+		out[i + 1] = pcgOutput(s1);
+		out[i + 2] = pcgOutput(s2);
+		out[i + 3] = pcgOutput(s3);
+		s0 = s0 * a4 + c4;
+		s1 = s1 * a4 + c4;
+		s2 = s2 * a4 + c4;
+		s3 = s3 * a4 + c4;
+	}
+
+	// s0 has advanced i steps in total, making it the next unemitted state
+	m_state = s0;
+	for (; i < len; i++)
+		out[i] = next();
 }
 
 
@@ -165,6 +222,25 @@ s32 PcgRandom::randNormalDist(s32 min, s32 max, int num_trials)
 	return myround((float)accum / num_trials);
 }
 
+
+u32 BufferedPcgRandom::range(u32 bound)
+{
+	// If the bound is 0, we cover the whole RNG's range
+	if (bound == 0)
+		return next();
+
+	// Same rejection scheme as PcgRandom::range() (see the explanation
+	// there), applied to the buffered stream so that results match the
+	// unbuffered generator value for value
+	u32 threshold = -bound % bound;
+	u32 r;
+
+	while ((r = next()) < threshold)
+		;
+
+	return r % bound;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 float noise2d(int x, int y, s32 seed)
@@ -445,6 +521,8 @@ Noise::~Noise()
 	delete[] persist_buf;
 	delete[] noise_buf;
 	delete[] result;
+	delete[] xfrac_buf;
+	delete[] xcell_buf;
 }
 
 
@@ -463,12 +541,16 @@ void Noise::allocBuffers()
 	delete[] gradient_buf;
 	delete[] persist_buf;
 	delete[] result;
+	delete[] xfrac_buf;
+	delete[] xcell_buf;
 
 	try {
 		size_t bufsize = sx * sy * sz;
 		this->persist_buf  = NULL;
 		this->gradient_buf = new float[bufsize];
 		this->result       = new float[bufsize];
+		this->xfrac_buf    = new float[sx];
+		this->xcell_buf    = new u32[sx];
 	} catch (std::bad_alloc &e) {
 		throw InvalidNoiseParamsException();
 	}
@@ -535,6 +617,124 @@ void Noise::resizeNoiseBuf(bool is3d)
 }
 
 
+/*
+ * Vectorized kernels for the interpolation stage of the bulk gradient maps.
+ *
+ * The scalar loops below carry the current lattice cell and the fractional
+ * x offset through an incremental recurrence (u += step_x; wrap at 1.0).
+ * To keep the vectorized output bit-identical to the scalar output - a hard
+ * requirement, since map generation must be reproducible across machines -
+ * that exact recurrence is first run as a cheap scalar pre-pass that records
+ * the cell index and fraction for every column of the row, and only the
+ * (dominant) interpolation arithmetic is then done 8 lanes at a time, with
+ * the same operation order as the scalar helpers in noise.h.
+ *
+ * AVX2 is detected at runtime; anything else (including ARM) takes the
+ * original scalar path.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define NOISE_HAVE_AVX2 1
+#include <immintrin.h>
+
+static bool cpuHasAvx2()
+{
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	return has_avx2;
+}
+
+// Same polynomial and operation order as easeCurve() in noise.h
+__attribute__((target("avx2")))
+static inline __m256 easeCurveAvx2(__m256 t)
+{
+	__m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+	__m256 inner = _mm256_add_ps(
+		_mm256_mul_ps(t,
+			_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(6.f), t),
+				_mm256_set1_ps(15.f))),
+		_mm256_set1_ps(10.f));
+	return _mm256_mul_ps(t3, inner);
+}
+
+// Same operation order as linearInterpolation(); deliberately no FMA, which
+// would change rounding relative to the scalar code
+__attribute__((target("avx2")))
+static inline __m256 linearInterpolationAvx2(__m256 v0, __m256 v1, __m256 t)
+{
+	return _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), t));
+}
+
+// Interpolates one output row of a 2D gradient map.  ty is pre-eased by the
+// caller when easing is enabled.  Returns the number of columns processed;
+// the caller finishes the remainder with the scalar helpers.
+__attribute__((target("avx2")))
+static u32 interpGradientRow2DAvx2(const float *noise_buf, u32 nlx,
+	u32 noisey, const u32 *xcell, const float *xfrac, float ty, bool eased,
+	float *out, u32 sx)
+{
+	const float *row0 = noise_buf + (size_t)noisey * nlx;
+	const float *row1 = row0 + nlx;
+	__m256 vty = _mm256_set1_ps(ty);
+	u32 i = 0;
+	for (; i + 8 <= sx; i += 8) {
+		__m256i cell = _mm256_loadu_si256((const __m256i *)&xcell[i]);
+		__m256 v00 = _mm256_i32gather_ps(row0,     cell, 4);
+		__m256 v10 = _mm256_i32gather_ps(row0 + 1, cell, 4);
+		__m256 v01 = _mm256_i32gather_ps(row1,     cell, 4);
+		__m256 v11 = _mm256_i32gather_ps(row1 + 1, cell, 4);
+		__m256 tx = _mm256_loadu_ps(&xfrac[i]);
+		if (eased)
+			tx = easeCurveAvx2(tx);
+		__m256 top = linearInterpolationAvx2(v00, v10, tx);
+		__m256 bot = linearInterpolationAvx2(v01, v11, tx);
+		_mm256_storeu_ps(&out[i],
+			linearInterpolationAvx2(top, bot, vty));
+	}
+	return i;
+}
+
+// 3D counterpart; ty/tz are pre-eased by the caller when easing is enabled
+__attribute__((target("avx2")))
+static u32 interpGradientRow3DAvx2(const float *noise_buf, u32 nlx, u32 nly,
+	u32 noisey, u32 noisez, const u32 *xcell, const float *xfrac,
+	float ty, float tz, bool eased, float *out, u32 sx)
+{
+	const float *row00 = noise_buf +
+		((size_t)noisez * nly + noisey) * nlx;
+	const float *row10 = row00 + nlx;
+	const float *row01 = row00 + (size_t)nly * nlx;
+	const float *row11 = row01 + nlx;
+	__m256 vty = _mm256_set1_ps(ty);
+	__m256 vtz = _mm256_set1_ps(tz);
+	u32 i = 0;
+	for (; i + 8 <= sx; i += 8) {
+		__m256i cell = _mm256_loadu_si256((const __m256i *)&xcell[i]);
+		__m256 v000 = _mm256_i32gather_ps(row00,     cell, 4);
+		__m256 v100 = _mm256_i32gather_ps(row00 + 1, cell, 4);
+		__m256 v010 = _mm256_i32gather_ps(row10,     cell, 4);
+		__m256 v110 = _mm256_i32gather_ps(row10 + 1, cell, 4);
+		__m256 v001 = _mm256_i32gather_ps(row01,     cell, 4);
+		__m256 v101 = _mm256_i32gather_ps(row01 + 1, cell, 4);
+		__m256 v011 = _mm256_i32gather_ps(row11,     cell, 4);
+		__m256 v111 = _mm256_i32gather_ps(row11 + 1, cell, 4);
+		__m256 tx = _mm256_loadu_ps(&xfrac[i]);
+		if (eased)
+			tx = easeCurveAvx2(tx);
+		__m256 bi0 = linearInterpolationAvx2(
+			linearInterpolationAvx2(v000, v100, tx),
+			linearInterpolationAvx2(v010, v110, tx), vty);
+		__m256 bi1 = linearInterpolationAvx2(
+			linearInterpolationAvx2(v001, v101, tx),
+			linearInterpolationAvx2(v011, v111, tx), vty);
+		_mm256_storeu_ps(&out[i],
+			linearInterpolationAvx2(bi0, bi1, vtz));
+	}
+	return i;
+}
+
+#endif // AVX2
+
+
 /*
  * NB:  This algorithm is not optimal in terms of space complexity.  The entire
  * integer lattice of noise points could be done as 2 lines instead, and for 3D,
@@ -578,6 +778,49 @@ void Noise::gradientMap2D(
 	//calculate interpolations
 	index  = 0;
 	noisey = 0;
+
+#if NOISE_HAVE_AVX2
+	if (cpuHasAvx2() && sx >= 8) {
+		for (j = 0; j != sy; j++) {
+			// Scalar pre-pass: the exact cell/fraction recurrence of the
+			// scalar loop below, recorded per column
+			u = orig_u;
+			noisex = 0;
+			for (i = 0; i != sx; i++) {
+				xfrac_buf[i] = u;
+				xcell_buf[i] = noisex;
+				u += step_x;
+				if (u >= 1.0) {
+					u -= 1.0;
+					noisex++;
+				}
+			}
+
+			float ty = eased ? easeCurve(v) : v;
+			i = interpGradientRow2DAvx2(noise_buf, nlx, noisey,
+				xcell_buf, xfrac_buf, ty, eased,
+				&gradient_buf[index], sx);
+			for (; i != sx; i++) {
+				noisex = xcell_buf[i];
+				gradient_buf[index + i] = interpolate(
+					noise_buf[idx(noisex,     noisey)],
+					noise_buf[idx(noisex + 1, noisey)],
+					noise_buf[idx(noisex,     noisey + 1)],
+					noise_buf[idx(noisex + 1, noisey + 1)],
+					xfrac_buf[i], v);
+			}
+			index += sx;
+
+			v += step_y;
+			if (v >= 1.0) {
+				v -= 1.0;
+				noisey++;
+			}
+		}
+		return;
+	}
+#endif
+
 	for (j = 0; j != sy; j++) {
 		v00 = noise_buf[idx(0, noisey)];
 		v10 = noise_buf[idx(1, noisey)];
@@ -649,6 +892,65 @@ void Noise::gradientMap3D(
 	index  = 0;
 	noisey = 0;
 	noisez = 0;
+
+#if NOISE_HAVE_AVX2
+	if (cpuHasAvx2() && sx >= 8) {
+		bool eased = np.flags & NOISE_FLAG_EASED;
+		for (k = 0; k != sz; k++) {
+			v = orig_v;
+			noisey = 0;
+			float tz = eased ? easeCurve(w) : w;
+			for (j = 0; j != sy; j++) {
+				// Scalar pre-pass: the exact cell/fraction recurrence of
+				// the scalar loop below, recorded per column
+				u = orig_u;
+				noisex = 0;
+				for (i = 0; i != sx; i++) {
+					xfrac_buf[i] = u;
+					xcell_buf[i] = noisex;
+					u += step_x;
+					if (u >= 1.0) {
+						u -= 1.0;
+						noisex++;
+					}
+				}
+
+				float ty = eased ? easeCurve(v) : v;
+				i = interpGradientRow3DAvx2(noise_buf, nlx, nly,
+					noisey, noisez, xcell_buf, xfrac_buf, ty, tz,
+					eased, &gradient_buf[index], sx);
+				for (; i != sx; i++) {
+					noisex = xcell_buf[i];
+					gradient_buf[index + i] = interpolate(
+						noise_buf[idx(noisex,     noisey,     noisez)],
+						noise_buf[idx(noisex + 1, noisey,     noisez)],
+						noise_buf[idx(noisex,     noisey + 1, noisez)],
+						noise_buf[idx(noisex + 1, noisey + 1, noisez)],
+						noise_buf[idx(noisex,     noisey,     noisez + 1)],
+						noise_buf[idx(noisex + 1, noisey,     noisez + 1)],
+						noise_buf[idx(noisex,     noisey + 1, noisez + 1)],
+						noise_buf[idx(noisex + 1, noisey + 1, noisez + 1)],
+						xfrac_buf[i], v, w);
+				}
+				index += sx;
+
+				v += step_y;
+				if (v >= 1.0) {
+					v -= 1.0;
+					noisey++;
+				}
+			}
+
+			w += step_z;
+			if (w >= 1.0) {
+				w -= 1.0;
+				noisez++;
+			}
+		}
+		return;
+	}
+#endif
+
 	for (k = 0; k != sz; k++) {
 		v = orig_v;
 		noisey = 0;
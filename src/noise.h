@@ -85,6 +85,9 @@ public:
 	u32 range(u32 bound);
 	s32 range(s32 min, s32 max);
 	void bytes(void *out, size_t len);
+	// Emits exactly the same values as len successive next() calls, but
+	// generated from several independent streams so they pipeline
+	void fill(u32 *out, size_t len);
 	s32 randNormalDist(s32 min, s32 max, int num_trials=6);
 
 private:
@@ -92,6 +95,51 @@ private:
 	u64 m_inc;
 };
 
+/*
+	Serves PcgRandom values out of fill()ed batches.  The value stream is
+	identical to calling the wrapped generator directly - range() performs
+	the same rejection steps on the buffered values - so consumers keep
+	their deterministic output.  Note that the wrapped generator usually
+	ends up advanced past the last value actually consumed, so only wrap
+	generators that are thrown away afterwards, like the chunk-local ones
+	of ore placement.
+*/
+class BufferedPcgRandom {
+public:
+	const static s32 RANDOM_MIN   = PcgRandom::RANDOM_MIN;
+	const static s32 RANDOM_MAX   = PcgRandom::RANDOM_MAX;
+	const static u32 RANDOM_RANGE = PcgRandom::RANDOM_RANGE;
+
+	BufferedPcgRandom(PcgRandom &pr) : m_pr(pr) {}
+
+	inline u32 next()
+	{
+		if (m_pos == BATCH_SIZE) {
+			m_pr.fill(m_buffer, BATCH_SIZE);
+			m_pos = 0;
+		}
+		return m_buffer[m_pos++];
+	}
+
+	u32 range(u32 bound);
+
+	inline s32 range(s32 min, s32 max)
+	{
+		if (max < min)
+			throw PrngException("Invalid range (max < min)");
+
+		// Cast to s64 first, otherwise this could overflow
+		u32 bound = (s64)max - (s64)min + 1;
+		return range(bound) + min;
+	}
+
+private:
+	static const size_t BATCH_SIZE = 256;
+	PcgRandom &m_pr;
+	u32 m_buffer[BATCH_SIZE];
+	size_t m_pos = BATCH_SIZE;
+};
+
 #define NOISE_FLAG_DEFAULTS    0x01
 #define NOISE_FLAG_EASED       0x02
 #define NOISE_FLAG_ABSVALUE    0x04
@@ -138,6 +186,10 @@ public:
 	float *gradient_buf = nullptr;
 	float *persist_buf = nullptr;
 	float *result = nullptr;
+	// Per-row lattice cell/fraction tables used by the vectorized
+	// interpolation kernels (see gradientMap2D/3D in noise.cpp)
+	float *xfrac_buf = nullptr;
+	u32 *xcell_buf = nullptr;
 
 	Noise(NoiseParams *np, s32 seed, u32 sx, u32 sy, u32 sz=1);
 	~Noise();
@@ -69,6 +69,9 @@ std::string ObjectProperties::dump()
 	os << ", eye_height=" << eye_height;
 	os << ", zoom_fov=" << zoom_fov;
 	os << ", use_texture_alpha=" << use_texture_alpha;
+	os << ", sleep_distance=" << sleep_distance;
+	os << ", sleep_step_interval=" << sleep_step_interval;
+	os << ", suspend_distance=" << suspend_distance;
 	return os.str();
 }
 
@@ -120,6 +123,349 @@ void ObjectProperties::serialize(std::ostream &os) const
 	// Never remove anything, because we don't want new versions of this
 }
 
+// Field ids for the delta representation. Append only; never renumber.
+enum ObjectPropertiesField {
+	OPF_HP_MAX,
+	OPF_BREATH_MAX,
+	OPF_PHYSICAL,
+	OPF_COLLIDE_WITH_OBJECTS,
+	OPF_WEIGHT,
+	OPF_COLLISIONBOX,
+	OPF_SELECTIONBOX,
+	OPF_POINTABLE,
+	OPF_VISUAL,
+	OPF_MESH,
+	OPF_VISUAL_SIZE,
+	OPF_TEXTURES,
+	OPF_COLORS,
+	OPF_SPRITEDIV,
+	OPF_INITIAL_SPRITE_BASEPOS,
+	OPF_IS_VISIBLE,
+	OPF_MAKES_FOOTSTEP_SOUND,
+	OPF_STEPHEIGHT,
+	OPF_AUTOMATIC_ROTATE,
+	OPF_AUTOMATIC_FACE_MOVEMENT_DIR,
+	OPF_AUTOMATIC_FACE_MOVEMENT_DIR_OFFSET,
+	OPF_BACKFACE_CULLING,
+	OPF_GLOW,
+	OPF_NAMETAG,
+	OPF_NAMETAG_COLOR,
+	OPF_AUTOMATIC_FACE_MOVEMENT_MAX_ROTATION_PER_SEC,
+	OPF_INFOTEXT,
+	OPF_WIELD_ITEM,
+	OPF_STATIC_SAVE,
+	OPF_EYE_HEIGHT,
+	OPF_ZOOM_FOV,
+	OPF_USE_TEXTURE_ALPHA,
+};
+
+std::string ObjectProperties::serializeDelta(const ObjectProperties &from) const
+{
+	std::ostringstream fields(std::ios::binary);
+	u8 count = 0;
+
+	if (hp_max != from.hp_max) {
+		writeU8(fields, OPF_HP_MAX);
+		writeU16(fields, hp_max);
+		count++;
+	}
+	if (breath_max != from.breath_max) {
+		writeU8(fields, OPF_BREATH_MAX);
+		writeU16(fields, breath_max);
+		count++;
+	}
+	if (physical != from.physical) {
+		writeU8(fields, OPF_PHYSICAL);
+		writeU8(fields, physical);
+		count++;
+	}
+	if (collideWithObjects != from.collideWithObjects) {
+		writeU8(fields, OPF_COLLIDE_WITH_OBJECTS);
+		writeU8(fields, collideWithObjects);
+		count++;
+	}
+	if (weight != from.weight) {
+		writeU8(fields, OPF_WEIGHT);
+		writeF32(fields, weight);
+		count++;
+	}
+	if (collisionbox != from.collisionbox) {
+		writeU8(fields, OPF_COLLISIONBOX);
+		writeV3F32(fields, collisionbox.MinEdge);
+		writeV3F32(fields, collisionbox.MaxEdge);
+		count++;
+	}
+	if (selectionbox != from.selectionbox) {
+		writeU8(fields, OPF_SELECTIONBOX);
+		writeV3F32(fields, selectionbox.MinEdge);
+		writeV3F32(fields, selectionbox.MaxEdge);
+		count++;
+	}
+	if (pointable != from.pointable) {
+		writeU8(fields, OPF_POINTABLE);
+		writeU8(fields, pointable);
+		count++;
+	}
+	if (visual != from.visual) {
+		writeU8(fields, OPF_VISUAL);
+		fields << serializeString(visual);
+		count++;
+	}
+	if (mesh != from.mesh) {
+		writeU8(fields, OPF_MESH);
+		fields << serializeString(mesh);
+		count++;
+	}
+	if (visual_size != from.visual_size) {
+		writeU8(fields, OPF_VISUAL_SIZE);
+		writeV3F32(fields, visual_size);
+		count++;
+	}
+	if (textures != from.textures) {
+		writeU8(fields, OPF_TEXTURES);
+		writeU16(fields, textures.size());
+		for (const std::string &texture : textures)
+			fields << serializeString(texture);
+		count++;
+	}
+	if (colors != from.colors) {
+		writeU8(fields, OPF_COLORS);
+		writeU16(fields, colors.size());
+		for (video::SColor color : colors)
+			writeARGB8(fields, color);
+		count++;
+	}
+	if (spritediv != from.spritediv) {
+		writeU8(fields, OPF_SPRITEDIV);
+		writeV2S16(fields, spritediv);
+		count++;
+	}
+	if (initial_sprite_basepos != from.initial_sprite_basepos) {
+		writeU8(fields, OPF_INITIAL_SPRITE_BASEPOS);
+		writeV2S16(fields, initial_sprite_basepos);
+		count++;
+	}
+	if (is_visible != from.is_visible) {
+		writeU8(fields, OPF_IS_VISIBLE);
+		writeU8(fields, is_visible);
+		count++;
+	}
+	if (makes_footstep_sound != from.makes_footstep_sound) {
+		writeU8(fields, OPF_MAKES_FOOTSTEP_SOUND);
+		writeU8(fields, makes_footstep_sound);
+		count++;
+	}
+	if (stepheight != from.stepheight) {
+		writeU8(fields, OPF_STEPHEIGHT);
+		writeF32(fields, stepheight);
+		count++;
+	}
+	if (automatic_rotate != from.automatic_rotate) {
+		writeU8(fields, OPF_AUTOMATIC_ROTATE);
+		writeF32(fields, automatic_rotate);
+		count++;
+	}
+	if (automatic_face_movement_dir != from.automatic_face_movement_dir) {
+		writeU8(fields, OPF_AUTOMATIC_FACE_MOVEMENT_DIR);
+		writeU8(fields, automatic_face_movement_dir);
+		count++;
+	}
+	if (automatic_face_movement_dir_offset !=
+			from.automatic_face_movement_dir_offset) {
+		writeU8(fields, OPF_AUTOMATIC_FACE_MOVEMENT_DIR_OFFSET);
+		writeF32(fields, automatic_face_movement_dir_offset);
+		count++;
+	}
+	if (backface_culling != from.backface_culling) {
+		writeU8(fields, OPF_BACKFACE_CULLING);
+		writeU8(fields, backface_culling);
+		count++;
+	}
+	if (glow != from.glow) {
+		writeU8(fields, OPF_GLOW);
+		writeS8(fields, glow);
+		count++;
+	}
+	if (nametag != from.nametag) {
+		writeU8(fields, OPF_NAMETAG);
+		fields << serializeString(nametag);
+		count++;
+	}
+	if (nametag_color != from.nametag_color) {
+		writeU8(fields, OPF_NAMETAG_COLOR);
+		writeARGB8(fields, nametag_color);
+		count++;
+	}
+	if (automatic_face_movement_max_rotation_per_sec !=
+			from.automatic_face_movement_max_rotation_per_sec) {
+		writeU8(fields, OPF_AUTOMATIC_FACE_MOVEMENT_MAX_ROTATION_PER_SEC);
+		writeF32(fields, automatic_face_movement_max_rotation_per_sec);
+		count++;
+	}
+	if (infotext != from.infotext) {
+		writeU8(fields, OPF_INFOTEXT);
+		fields << serializeString(infotext);
+		count++;
+	}
+	if (wield_item != from.wield_item) {
+		writeU8(fields, OPF_WIELD_ITEM);
+		fields << serializeString(wield_item);
+		count++;
+	}
+	if (static_save != from.static_save) {
+		writeU8(fields, OPF_STATIC_SAVE);
+		writeU8(fields, static_save);
+		count++;
+	}
+	if (eye_height != from.eye_height) {
+		writeU8(fields, OPF_EYE_HEIGHT);
+		writeF32(fields, eye_height);
+		count++;
+	}
+	if (zoom_fov != from.zoom_fov) {
+		writeU8(fields, OPF_ZOOM_FOV);
+		writeF32(fields, zoom_fov);
+		count++;
+	}
+	if (use_texture_alpha != from.use_texture_alpha) {
+		writeU8(fields, OPF_USE_TEXTURE_ALPHA);
+		writeU8(fields, use_texture_alpha);
+		count++;
+	}
+
+	if (count == 0)
+		return "";
+
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, 1); // delta version
+	writeU8(os, count);
+	os << fields.str();
+	return os.str();
+}
+
+void ObjectProperties::deSerializeDelta(std::istream &is)
+{
+	int version = readU8(is);
+	if (version != 1)
+		throw SerializationError("unsupported ObjectProperties delta version");
+
+	u8 count = readU8(is);
+	for (u8 i = 0; i < count; i++) {
+		u8 field = readU8(is);
+		switch (field) {
+		case OPF_HP_MAX:
+			hp_max = readU16(is);
+			break;
+		case OPF_BREATH_MAX:
+			breath_max = readU16(is);
+			break;
+		case OPF_PHYSICAL:
+			physical = readU8(is);
+			break;
+		case OPF_COLLIDE_WITH_OBJECTS:
+			collideWithObjects = readU8(is);
+			break;
+		case OPF_WEIGHT:
+			weight = readF32(is);
+			break;
+		case OPF_COLLISIONBOX:
+			collisionbox.MinEdge = readV3F32(is);
+			collisionbox.MaxEdge = readV3F32(is);
+			break;
+		case OPF_SELECTIONBOX:
+			selectionbox.MinEdge = readV3F32(is);
+			selectionbox.MaxEdge = readV3F32(is);
+			break;
+		case OPF_POINTABLE:
+			pointable = readU8(is);
+			break;
+		case OPF_VISUAL:
+			visual = deSerializeString(is);
+			break;
+		case OPF_MESH:
+			mesh = deSerializeString(is);
+			break;
+		case OPF_VISUAL_SIZE:
+			visual_size = readV3F32(is);
+			break;
+		case OPF_TEXTURES: {
+			textures.clear();
+			u32 texture_count = readU16(is);
+			for (u32 j = 0; j < texture_count; j++)
+				textures.push_back(deSerializeString(is));
+			break;
+		}
+		case OPF_COLORS: {
+			colors.clear();
+			u32 color_count = readU16(is);
+			for (u32 j = 0; j < color_count; j++)
+				colors.push_back(readARGB8(is));
+			break;
+		}
+		case OPF_SPRITEDIV:
+			spritediv = readV2S16(is);
+			break;
+		case OPF_INITIAL_SPRITE_BASEPOS:
+			initial_sprite_basepos = readV2S16(is);
+			break;
+		case OPF_IS_VISIBLE:
+			is_visible = readU8(is);
+			break;
+		case OPF_MAKES_FOOTSTEP_SOUND:
+			makes_footstep_sound = readU8(is);
+			break;
+		case OPF_STEPHEIGHT:
+			stepheight = readF32(is);
+			break;
+		case OPF_AUTOMATIC_ROTATE:
+			automatic_rotate = readF32(is);
+			break;
+		case OPF_AUTOMATIC_FACE_MOVEMENT_DIR:
+			automatic_face_movement_dir = readU8(is);
+			break;
+		case OPF_AUTOMATIC_FACE_MOVEMENT_DIR_OFFSET:
+			automatic_face_movement_dir_offset = readF32(is);
+			break;
+		case OPF_BACKFACE_CULLING:
+			backface_culling = readU8(is);
+			break;
+		case OPF_GLOW:
+			glow = readS8(is);
+			break;
+		case OPF_NAMETAG:
+			nametag = deSerializeString(is);
+			break;
+		case OPF_NAMETAG_COLOR:
+			nametag_color = readARGB8(is);
+			break;
+		case OPF_AUTOMATIC_FACE_MOVEMENT_MAX_ROTATION_PER_SEC:
+			automatic_face_movement_max_rotation_per_sec = readF32(is);
+			break;
+		case OPF_INFOTEXT:
+			infotext = deSerializeString(is);
+			break;
+		case OPF_WIELD_ITEM:
+			wield_item = deSerializeString(is);
+			break;
+		case OPF_STATIC_SAVE:
+			static_save = readU8(is);
+			break;
+		case OPF_EYE_HEIGHT:
+			eye_height = readF32(is);
+			break;
+		case OPF_ZOOM_FOV:
+			zoom_fov = readF32(is);
+			break;
+		case OPF_USE_TEXTURE_ALPHA:
+			use_texture_alpha = readU8(is);
+			break;
+		default:
+			// The payload length is unknown; bail out
+			throw SerializationError("unknown ObjectProperties delta field");
+		}
+	}
+}
+
 void ObjectProperties::deSerialize(std::istream &is)
 {
 	int version = readU8(is);
@@ -61,9 +61,26 @@ struct ObjectProperties
 	float eye_height = 1.625f;
 	float zoom_fov = 0.0f;
 	bool use_texture_alpha = false;
+	/*
+		Distance-tiered sleep. Server-side stepping behavior only, so
+		these are not serialized to clients. Distances are in nodes and
+		relative to the nearest player; 0 disables the respective tier.
+	*/
+	float sleep_distance = 0.0f;
+	float sleep_step_interval = 2.0f;
+	float suspend_distance = 0.0f;
 
 	ObjectProperties();
 	std::string dump();
 	void serialize(std::ostream &os) const;
 	void deSerialize(std::istream &is);
+
+	/*
+		Delta representation: only the fields that differ from `from`
+		are written, each tagged with a stable field id. Returns an
+		empty string when nothing differs. deSerializeDelta() applied
+		to a copy of `from` reproduces *this.
+	*/
+	std::string serializeDelta(const ObjectProperties &from) const;
+	void deSerializeDelta(std::istream &is);
 };
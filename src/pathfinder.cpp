@@ -25,8 +25,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "pathfinder.h"
 #include "serverenvironment.h"
 #include "server.h"
+#include "mapblock.h"
 #include "nodedef.h"
 
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <set>
+
 //#define PATHFINDER_DEBUG
 //#define PATHFINDER_CALC_TIME
 
@@ -268,6 +274,15 @@ private:
 	 */
 	bool          buildCostmap();
 
+	/**
+	 * find a corridor of mapblocks from source to destination by
+	 * searching the block-level abstraction graph (cached open-face
+	 * masks, see MapBlock::cachePathOpenFaces). On success m_corridor
+	 * is filled with the blocks the fine search may use.
+	 * @return true/false if a corridor was found
+	 */
+	bool          buildBlockCorridor();
+
 	/**
 	 * calculate cost of movement
 	 * @param pos real world position to start movement
@@ -317,6 +332,11 @@ private:
 
 	bool m_prefetch = true;              /**< prefetch cost data                       */
 
+	/** restrict the search to the blocks in m_corridor */
+	bool m_use_corridor = false;
+	/** blocks the fine search may visit (PA_HIERARCHICAL) */
+	std::set<v3s16> m_corridor;
+
 	v3s16 m_start;                /**< source position                          */
 	v3s16 m_destination;          /**< destination position                     */
 
@@ -378,6 +398,103 @@ private:
 #endif
 };
 
+/** Parameters identifying one path query */
+struct PathCacheKey {
+	ServerEnvironment *env;
+	v3s16 source;
+	v3s16 destination;
+	unsigned int searchdistance;
+	unsigned int max_jump;
+	unsigned int max_drop;
+	PathAlgorithm algo;
+
+	bool operator<(const PathCacheKey &o) const
+	{
+		if (env != o.env)
+			return std::less<ServerEnvironment *>()(env, o.env);
+		if (source != o.source)
+			return source < o.source;
+		if (destination != o.destination)
+			return destination < o.destination;
+		if (searchdistance != o.searchdistance)
+			return searchdistance < o.searchdistance;
+		if (max_jump != o.max_jump)
+			return max_jump < o.max_jump;
+		if (max_drop != o.max_drop)
+			return max_drop < o.max_drop;
+		return algo < o.algo;
+	}
+};
+
+/**
+ * Cache of recently computed paths, shared by all get_path() calls.
+ * Each entry remembers the change counter of every block its path runs
+ * through and is dropped as soon as one of those blocks was modified,
+ * unloaded or replaced. Only used from the server thread.
+ */
+class PathCache {
+public:
+	/** returns the cached path, or nullptr on miss/staleness */
+	const std::vector<v3s16> *lookup(const PathCacheKey &key)
+	{
+		std::map<PathCacheKey, Entry>::iterator it = m_entries.find(key);
+		if (it == m_entries.end())
+			return nullptr;
+
+		Map *map = &key.env->getMap();
+		for (const std::pair<v3s16, u32> &b : it->second.blocks) {
+			MapBlock *block = map->getBlockNoCreateNoEx(b.first);
+			if (!block || block->change_counter != b.second) {
+				m_entries.erase(it);
+				return nullptr;
+			}
+		}
+		return &it->second.path;
+	}
+
+	void insert(const PathCacheKey &key, const std::vector<v3s16> &path)
+	{
+		if (m_entries.size() >= CACHE_SIZE_LIMIT)
+			m_entries.clear();
+
+		Entry &e = m_entries[key];
+		e.path = path;
+
+		// Record the blocks whose content the path depends on: the
+		// path nodes themselves plus the ground and clearance nodes
+		// directly below and above them
+		Map *map = &key.env->getMap();
+		std::set<v3s16> blockpos;
+		for (const v3s16 &p : path) {
+			blockpos.insert(getNodeBlockPos(p + v3s16(0, -1, 0)));
+			blockpos.insert(getNodeBlockPos(p));
+			blockpos.insert(getNodeBlockPos(p + v3s16(0, 1, 0)));
+		}
+		e.blocks.reserve(blockpos.size());
+		for (const v3s16 &bp : blockpos) {
+			MapBlock *block = map->getBlockNoCreateNoEx(bp);
+			if (!block) {
+				// Shouldn't happen for a just-found path; don't cache
+				m_entries.erase(key);
+				return;
+			}
+			e.blocks.emplace_back(bp, block->change_counter);
+		}
+	}
+
+private:
+	static const size_t CACHE_SIZE_LIMIT = 256;
+
+	struct Entry {
+		std::vector<v3s16> path;
+		/** blockpos and change counter of all blocks the path touches */
+		std::vector<std::pair<v3s16, u32>> blocks;
+	};
+	std::map<PathCacheKey, Entry> m_entries;
+};
+
+static PathCache g_path_cache;
+
 /******************************************************************************/
 /* implementation                                                             */
 /******************************************************************************/
@@ -390,11 +507,21 @@ std::vector<v3s16> get_path(ServerEnvironment* env,
 							unsigned int max_drop,
 							PathAlgorithm algo)
 {
+	PathCacheKey key = {env, source, destination,
+			searchdistance, max_jump, max_drop, algo};
+	if (const std::vector<v3s16> *cached = g_path_cache.lookup(key))
+		return *cached;
+
 	Pathfinder searchclass;
 
-	return searchclass.getPath(env,
+	std::vector<v3s16> path = searchclass.getPath(env,
 				source, destination,
 				searchdistance, max_jump, max_drop, algo);
+
+	if (!path.empty())
+		g_path_cache.insert(key, path);
+
+	return path;
 }
 
 /******************************************************************************/
@@ -498,6 +625,13 @@ void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
 
 	v3s16 realpos = m_pathf->getRealPos(ipos);
 
+	if (m_pathf->m_use_corridor && m_pathf->m_corridor.find(
+			getNodeBlockPos(realpos)) == m_pathf->m_corridor.end()) {
+		// Outside the block-level corridor
+		elem.type = 'i';
+		return;
+	}
+
 	MapNode current = m_pathf->m_env->getMap().getNode(realpos);
 	MapNode below   = m_pathf->m_env->getMap().getNode(realpos + v3s16(0, -1, 0));
 
@@ -638,6 +772,15 @@ std::vector<v3s16> Pathfinder::getPath(ServerEnvironment *env,
 	m_max_index_y = diff.Y;
 	m_max_index_z = diff.Z;
 
+	m_use_corridor = false;
+	if (algo == PA_HIERARCHICAL) {
+		// Restrict the fine search to a corridor of blocks found at
+		// block level first. When no corridor is found (e.g. because of
+		// unloaded blocks) this degrades to a plain A* search.
+		m_prefetch = false;
+		m_use_corridor = buildBlockCorridor();
+	}
+
 	delete m_nodes_container;
 	if (diff.getLength() > 5) {
 		m_nodes_container = new MapGridNodeContainer(this);
@@ -682,6 +825,7 @@ std::vector<v3s16> Pathfinder::getPath(ServerEnvironment *env,
 			break;
 		case PA_PLAIN_NP:
 		case PA_PLAIN:
+		case PA_HIERARCHICAL:
 			update_cost_retval = updateCostHeuristic(StartIndex, v3s16(0, 0, 0), 0, 0);
 			break;
 		default:
@@ -689,6 +833,28 @@ std::vector<v3s16> Pathfinder::getPath(ServerEnvironment *env,
 			break;
 	}
 
+	if (!update_cost_retval && m_use_corridor) {
+		// The block-level graph is optimistic, so the corridor may not
+		// contain an actual path; retry without the restriction
+		VERBOSE_TARGET << "no path in block corridor, retrying without"
+				<< std::endl;
+		m_use_corridor = false;
+		m_min_target_distance = -1;
+
+		delete m_nodes_container;
+		m_nodes_container = new MapGridNodeContainer(this);
+
+		PathGridnode &startpos2 = getIndexElement(StartIndex);
+		PathGridnode &endpos2   = getIndexElement(EndIndex);
+		if (startpos2.valid && endpos2.valid) {
+			endpos2.target      = true;
+			startpos2.source    = true;
+			startpos2.totalcost = 0;
+			update_cost_retval = updateCostHeuristic(StartIndex,
+					v3s16(0, 0, 0), 0, 0);
+		}
+	}
+
 	if (update_cost_retval) {
 
 #ifdef PATHFINDER_DEBUG
@@ -864,6 +1030,121 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 	return retval;
 }
 
+/******************************************************************************/
+bool Pathfinder::buildBlockCorridor()
+{
+	// Upper bound on expanded blocks; queries this large are hopeless
+	// at node level anyway
+	const size_t max_visited = 2048;
+
+	Map *map = &m_env->getMap();
+
+	v3s16 src_bp = getNodeBlockPos(m_start);
+	v3s16 dst_bp = getNodeBlockPos(m_destination);
+	v3s16 bpmin  = getNodeBlockPos(m_limits.MinEdge);
+	v3s16 bpmax  = getNodeBlockPos(m_limits.MaxEdge);
+
+	static const v3s16 dirs[6] = {
+		v3s16( 1, 0, 0), v3s16(-1, 0, 0),
+		v3s16( 0, 1, 0), v3s16( 0,-1, 0),
+		v3s16( 0, 0, 1), v3s16( 0, 0,-1),
+	};
+	// Face left through dirs[i]; dirs/faces are ordered so that i ^ 1
+	// is the opposite direction/face
+	static const u8 face_bits[6] = {
+		MapBlock::PATH_FACE_XP, MapBlock::PATH_FACE_XM,
+		MapBlock::PATH_FACE_YP, MapBlock::PATH_FACE_YM,
+		MapBlock::PATH_FACE_ZP, MapBlock::PATH_FACE_ZM,
+	};
+
+	struct QueueEntry {
+		int estimate;
+		v3s16 pos;
+	};
+	struct QueueCmp {
+		bool operator()(const QueueEntry &a, const QueueEntry &b) const
+		{
+			return a.estimate > b.estimate;
+		}
+	};
+	auto heuristic = [&dst_bp] (const v3s16 &bp) {
+		return std::abs(bp.X - dst_bp.X) + std::abs(bp.Y - dst_bp.Y)
+				+ std::abs(bp.Z - dst_bp.Z);
+	};
+
+	// A* over the block graph. All edges cost 1, so visited blocks
+	// never need to be reopened.
+	std::map<v3s16, v3s16> origins; // visited block -> predecessor
+	std::map<v3s16, int> cost;
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, QueueCmp> open;
+
+	origins[src_bp] = src_bp;
+	cost[src_bp] = 0;
+	open.push({heuristic(src_bp), src_bp});
+
+	bool found = false;
+	while (!open.empty()) {
+		QueueEntry e = open.top();
+		open.pop();
+
+		if (e.pos == dst_bp) {
+			found = true;
+			break;
+		}
+		if (origins.size() > max_visited)
+			break;
+
+		MapBlock *block = map->getBlockNoCreateNoEx(e.pos);
+		if (!block)
+			continue;
+		block->cachePathOpenFaces();
+		int g = cost[e.pos];
+
+		for (int i = 0; i < 6; i++) {
+			if (!(block->path_open_faces & face_bits[i]))
+				continue;
+
+			v3s16 np = e.pos + dirs[i];
+			if (np.X < bpmin.X || np.X > bpmax.X ||
+					np.Y < bpmin.Y || np.Y > bpmax.Y ||
+					np.Z < bpmin.Z || np.Z > bpmax.Z)
+				continue;
+			if (origins.find(np) != origins.end())
+				continue;
+
+			MapBlock *nblock = map->getBlockNoCreateNoEx(np);
+			if (!nblock)
+				continue;
+			nblock->cachePathOpenFaces();
+			if (!(nblock->path_open_faces & face_bits[i ^ 1]))
+				continue;
+
+			origins[np] = e.pos;
+			cost[np] = g + 1;
+			open.push({g + 1 + heuristic(np), np});
+		}
+	}
+
+	if (!found)
+		return false;
+
+	// The corridor consists of the blocks on the found block path plus
+	// all their neighbors, so the node-level path has room to wind
+	m_corridor.clear();
+	v3s16 bp = dst_bp;
+	while (true) {
+		v3s16 n;
+		for (n.X = -1; n.X <= 1; n.X++)
+		for (n.Y = -1; n.Y <= 1; n.Y++)
+		for (n.Z = -1; n.Z <= 1; n.Z++)
+			m_corridor.insert(bp + n);
+		if (bp == src_bp)
+			break;
+		bp = origins[bp];
+	}
+	return true;
+}
+
 /******************************************************************************/
 v3s16 Pathfinder::getIndexPos(v3s16 pos)
 {
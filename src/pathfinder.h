@@ -46,7 +46,9 @@ typedef enum {
 typedef enum {
 	PA_DIJKSTRA,           /**< Dijkstra shortest path algorithm             */
 	PA_PLAIN,            /**< A* algorithm using heuristics to find a path */
-	PA_PLAIN_NP          /**< A* algorithm without prefetching of map data */
+	PA_PLAIN_NP,         /**< A* algorithm without prefetching of map data */
+	PA_HIERARCHICAL      /**< A* restricted to a corridor of mapblocks found
+	                          by a block-level search first                  */
 } PathAlgorithm;
 
 /******************************************************************************/
@@ -60,42 +60,118 @@ Profiler::Profiler()
 	m_start_time = porting::getTimeMs();
 }
 
-void Profiler::add(const std::string &name, float value)
+std::shared_ptr<Profiler::ThreadData> Profiler::getThreadData()
 {
-	MutexAutoLock lock(m_mutex);
-	{
-		/* No average shall have been used; mark add used as -2 */
-		std::map<std::string, int>::iterator n = m_avgcounts.find(name);
-		if (n == m_avgcounts.end()) {
-			m_avgcounts[name] = -2;
-		} else {
-			if (n->second == -1)
-				n->second = -2;
-			assert(n->second == -2);
-		}
+	// One entry per profiler instance this thread has sampled into. The
+	// weak_ptr expires when the owning profiler is destroyed, which also
+	// guards against a new profiler reusing a dead one's address.
+	static thread_local std::map<const Profiler *,
+			std::weak_ptr<ThreadData>> tl_buffers;
+
+	auto it = tl_buffers.find(this);
+	if (it != tl_buffers.end()) {
+		std::shared_ptr<ThreadData> td = it->second.lock();
+		if (td)
+			return td;
 	}
-	{
-		std::map<std::string, float>::iterator n = m_data.find(name);
-		if (n == m_data.end())
-			m_data[name] = value;
+
+	// Drop buffers of destroyed profilers while we are here
+	for (auto stale = tl_buffers.begin(); stale != tl_buffers.end();) {
+		if (stale->second.expired())
+			tl_buffers.erase(stale++);
 		else
-			n->second += value;
+			++stale;
+	}
+
+	std::shared_ptr<ThreadData> td = std::make_shared<ThreadData>();
+	{
+		MutexAutoLock lock(m_mutex);
+		m_threads.push_back(td);
+	}
+	tl_buffers[this] = td;
+	return td;
+}
+
+void Profiler::mergeThreadData()
+{
+	for (const std::shared_ptr<ThreadData> &td : m_threads) {
+		MutexAutoLock lock(td->mutex);
+
+		for (const auto &it : td->data) {
+			const DataPair &pair = it.second;
+			if (pair.avgcount == -2) {
+				/* No average shall have been used; mark add used as -2 */
+				std::map<std::string, int>::iterator n =
+						m_avgcounts.find(it.first);
+				if (n == m_avgcounts.end()) {
+					m_avgcounts[it.first] = -2;
+				} else {
+					if (n->second == -1)
+						n->second = -2;
+					assert(n->second == -2);
+				}
+			} else if (pair.avgcount >= 1) {
+				int &count = m_avgcounts[it.first];
+				assert(count != -2);
+				count = MYMAX(count, 0) + pair.avgcount;
+			}
+			m_data[it.first] += pair.value;
+		}
+		td->data.clear();
+
+		for (const auto &it : td->graphvalues)
+			m_graphvalues[it.first] += it.second;
+		td->graphvalues.clear();
 	}
 }
 
+void Profiler::add(const std::string &name, float value)
+{
+	std::shared_ptr<ThreadData> td = getThreadData();
+	MutexAutoLock lock(td->mutex);
+	DataPair &pair = td->data[name];
+	assert(pair.avgcount < 0);
+	pair.avgcount = -2;
+	pair.value += value;
+}
+
 void Profiler::avg(const std::string &name, float value)
+{
+	std::shared_ptr<ThreadData> td = getThreadData();
+	MutexAutoLock lock(td->mutex);
+	DataPair &pair = td->data[name];
+	assert(pair.avgcount != -2);
+	pair.avgcount = MYMAX(pair.avgcount, 0) + 1;
+	pair.value += value;
+}
+
+void Profiler::graphAdd(const std::string &id, float value)
+{
+	std::shared_ptr<ThreadData> td = getThreadData();
+	MutexAutoLock lock(td->mutex);
+	td->graphvalues[id] += value;
+}
+
+void Profiler::graphGet(GraphValues &result)
 {
 	MutexAutoLock lock(m_mutex);
-	int &count = m_avgcounts[name];
+	mergeThreadData();
+	result = m_graphvalues;
+	m_graphvalues.clear();
+}
 
-	assert(count != -2);
-	count = MYMAX(count, 0) + 1;
-	m_data[name] += value;
+void Profiler::getValues(GraphValues &result)
+{
+	MutexAutoLock lock(m_mutex);
+	mergeThreadData();
+	for (const auto &it : m_data)
+		result[it.first] = getValueNoLock(it.first);
 }
 
 void Profiler::clear()
 {
 	MutexAutoLock lock(m_mutex);
+	mergeThreadData();
 	for (auto &it : m_data) {
 		it.second = 0;
 	}
@@ -103,7 +179,18 @@ void Profiler::clear()
 	m_start_time = porting::getTimeMs();
 }
 
-float Profiler::getValue(const std::string &name) const
+void Profiler::remove(const std::string &name)
+{
+	MutexAutoLock lock(m_mutex);
+	for (const std::shared_ptr<ThreadData> &td : m_threads) {
+		MutexAutoLock td_lock(td->mutex);
+		td->data.erase(name);
+	}
+	m_avgcounts.erase(name);
+	m_data.erase(name);
+}
+
+float Profiler::getValueNoLock(const std::string &name) const
 {
 	auto numerator = m_data.find(name);
 	if (numerator == m_data.end())
@@ -118,7 +205,7 @@ float Profiler::getValue(const std::string &name) const
 	return numerator->second;
 }
 
-int Profiler::getAvgCount(const std::string &name) const
+int Profiler::getAvgCountNoLock(const std::string &name) const
 {
 	auto n = m_avgcounts.find(name);
 
@@ -128,6 +215,20 @@ int Profiler::getAvgCount(const std::string &name) const
 	return 1;
 }
 
+float Profiler::getValue(const std::string &name)
+{
+	MutexAutoLock lock(m_mutex);
+	mergeThreadData();
+	return getValueNoLock(name);
+}
+
+int Profiler::getAvgCount(const std::string &name)
+{
+	MutexAutoLock lock(m_mutex);
+	mergeThreadData();
+	return getAvgCountNoLock(name);
+}
+
 u64 Profiler::getElapsedMs() const
 {
 	return porting::getTimeMs() - m_start_time;
@@ -163,6 +264,7 @@ int Profiler::print(std::ostream &o, u32 page, u32 pagecount)
 void Profiler::getPage(GraphValues &o, u32 page, u32 pagecount)
 {
 	MutexAutoLock lock(m_mutex);
+	mergeThreadData();
 
 	u32 minindex, maxindex;
 	paging(m_data.size(), page, pagecount, minindex, maxindex);
@@ -177,6 +279,6 @@ void Profiler::getPage(GraphValues &o, u32 page, u32 pagecount)
 			continue;
 		}
 
-		o[i.first] = i.second / getAvgCount(i.first);
+		o[i.first] = i.second / getAvgCountNoLock(i.first);
 	}
 }
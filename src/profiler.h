@@ -21,9 +21,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irrlichttypes.h"
 #include <cassert>
+#include <memory>
 #include <string>
 #include <map>
 #include <ostream>
+#include <vector>
 
 #include "threading/mutex_auto_lock.h"
 #include "util/timetaker.h"
@@ -35,6 +37,10 @@ extern Profiler *g_profiler;
 
 /*
 	Time profiler
+
+	Samples accumulate into per-thread buffers, so instrumenting hot paths
+	never contends on a shared lock; the buffers are folded into the merged
+	maps whenever something reads or clears the profiler.
 */
 
 class Profiler
@@ -46,8 +52,8 @@ public:
 	void avg(const std::string &name, float value);
 	void clear();
 
-	float getValue(const std::string &name) const;
-	int getAvgCount(const std::string &name) const;
+	float getValue(const std::string &name);
+	int getAvgCount(const std::string &name);
 	u64 getElapsedMs() const;
 
 	typedef std::map<std::string, float> GraphValues;
@@ -56,33 +62,43 @@ public:
 	int print(std::ostream &o, u32 page = 1, u32 pagecount = 1);
 	void getPage(GraphValues &o, u32 page, u32 pagecount);
 
+	void graphAdd(const std::string &id, float value);
+	void graphGet(GraphValues &result);
 
-	void graphAdd(const std::string &id, float value)
-	{
-		MutexAutoLock lock(m_mutex);
-		std::map<std::string, float>::iterator i =
-				m_graphvalues.find(id);
-		if(i == m_graphvalues.end())
-			m_graphvalues[id] = value;
-		else
-			i->second += value;
-	}
-	void graphGet(GraphValues &result)
-	{
-		MutexAutoLock lock(m_mutex);
-		result = m_graphvalues;
-		m_graphvalues.clear();
-	}
+	// A merged snapshot of all raw values, e.g. for the metrics exporter
+	void getValues(GraphValues &result);
 
-	void remove(const std::string& name)
-	{
-		MutexAutoLock lock(m_mutex);
-		m_avgcounts.erase(name);
-		m_data.erase(name);
-	}
+	void remove(const std::string &name);
 
 private:
+	struct DataPair
+	{
+		float value = 0.0f;
+		// -1 = unused, -2 = add() was used, >= 0 = avg() sample count
+		int avgcount = -1;
+	};
+
+	// Per-thread sample buffer. Its mutex is only ever contended while a
+	// reader merges, so taking it per sample is practically free.
+	struct ThreadData
+	{
+		std::mutex mutex;
+		std::map<std::string, DataPair> data;
+		std::map<std::string, float> graphvalues;
+	};
+
+	// Returns the calling thread's buffer, creating and registering it on
+	// first use. The returned shared_ptr keeps the buffer alive even if
+	// the profiler is destroyed mid-sample.
+	std::shared_ptr<ThreadData> getThreadData();
+	// Folds every thread buffer into the merged maps (m_mutex must be held)
+	void mergeThreadData();
+	float getValueNoLock(const std::string &name) const;
+	int getAvgCountNoLock(const std::string &name) const;
+
+	// Protects m_threads and the merged maps below
 	std::mutex m_mutex;
+	std::vector<std::shared_ptr<ThreadData>> m_threads;
 	std::map<std::string, float> m_data;
 	std::map<std::string, int> m_avgcounts;
 	std::map<std::string, float> m_graphvalues;
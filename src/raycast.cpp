@@ -21,6 +21,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irr_v3d.h"
 #include "irr_aabb3d.h"
 #include "constants.h"
+#include "map.h"
+#include "mapblock.h"
 
 bool RaycastSort::operator() (const PointedThing &pt1,
 	const PointedThing &pt2) const
@@ -67,6 +69,22 @@ RaycastState::RaycastState(const core::line3d<f32> &shootline,
 }
 
 
+MapNode RaycastNodeCache::getNode(Map &map, v3s16 p, bool *is_valid_position)
+{
+	v3s16 blockpos = getNodeBlockPos(p);
+	if (blockpos != m_blockpos) {
+		m_block = map.getBlockNoCreateNoEx(blockpos);
+		m_blockpos = blockpos;
+	}
+	if (m_block == NULL) {
+		*is_valid_position = false;
+		return {CONTENT_IGNORE};
+	}
+
+	v3s16 relpos = p - blockpos * MAP_BLOCKSIZE;
+	return m_block->getNodeNoCheck(relpos, is_valid_position);
+}
+
 bool boxLineCollision(const aabb3f &box, const v3f &start,
 	const v3f &dir, v3f *collision_point, v3s16 *collision_normal)
 {
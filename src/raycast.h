@@ -22,6 +22,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "voxelalgorithms.h"
 #include "util/pointedthing.h"
 
+class Map;
+class MapBlock;
+
 //! Sorts PointedThings based on their distance.
 struct RaycastSort
 {
@@ -63,6 +66,24 @@ public:
 	bool m_initialization_needed = true;
 };
 
+/*!
+ * Small block-lookup cache for raycasts. Consecutive tested nodes are
+ * almost always in the same map block, and batched rays pass through
+ * shared blocks too, so remembering the last fetched block avoids most
+ * of the per-node map lookups. Only valid while the map is locked; do
+ * not keep a cache across steps.
+ */
+class RaycastNodeCache
+{
+public:
+	//! Same contract as Map::getNode with is_valid_position.
+	MapNode getNode(Map &map, v3s16 p, bool *is_valid_position);
+
+private:
+	MapBlock *m_block = nullptr;
+	v3s16 m_blockpos = v3s16(S16_MAX, S16_MAX, S16_MAX);
+};
+
 /*!
  * Checks if a line and a box intersects.
  * @param[in]  box              box to test collision
@@ -30,11 +30,12 @@ ReflowScan::ReflowScan(Map *map, const NodeDefManager *ndef) :
 {
 }
 
-void ReflowScan::scan(MapBlock *block, UniqueQueue<v3s16> *liquid_queue)
+void ReflowScan::scan(MapBlock *block, LiquidTransformQueue *liquid_queue)
 {
 	m_block_pos = block->getPos();
 	m_rel_block_pos = block->getPosRelative();
 	m_liquid_queue = liquid_queue;
+	u32 start_queue_size = liquid_queue->size();
 
 	// Prepare the lookup which is a 3x3x3 array of the blocks surrounding the
 	// scanned block. Blocks are only added to the lookup if they are really
@@ -60,6 +61,11 @@ void ReflowScan::scan(MapBlock *block, UniqueQueue<v3s16> *liquid_queue)
 		scanColumn(-1, i);
 		scanColumn(MAP_BLOCKSIZE, i);
 	}
+
+	// If nothing was queued, the block's liquids are settled and, as long
+	// as no node is modified, the scan can be skipped when the block is
+	// unloaded and loaded again.
+	block->reflow_settled = liquid_queue->size() == start_queue_size;
 }
 
 inline MapBlock *ReflowScan::lookupBlock(int x, int y, int z)
@@ -87,7 +93,17 @@ inline bool ReflowScan::isLiquidFlowableTo(int x, int y, int z)
 	// Tests whether (x,y,z) is a node to which liquid might flow.
 	bool valid_position;
 	MapBlock *block = lookupBlock(x, y, z);
-	if (block) {
+	if (!block) {
+		// There is liquid next to an unloaded block; that block must get
+		// a full scan when it is loaded, since the liquid might flow into
+		// it then.
+		int bx = (MAP_BLOCKSIZE + x) / MAP_BLOCKSIZE;
+		int by = (MAP_BLOCKSIZE + y) / MAP_BLOCKSIZE;
+		int bz = (MAP_BLOCKSIZE + z) / MAP_BLOCKSIZE;
+		m_map->dropSettledLiquids(m_block_pos + v3s16(bx - 1, by - 1, bz - 1));
+		return false;
+	}
+	{
 		int dx = (MAP_BLOCKSIZE + x) % MAP_BLOCKSIZE;
 		int dy = (MAP_BLOCKSIZE + y) % MAP_BLOCKSIZE;
 		int dz = (MAP_BLOCKSIZE + z) % MAP_BLOCKSIZE;
@@ -139,46 +155,76 @@ void ReflowScan::scanColumn(int x, int z)
 	bool was_checked = false;
 	bool was_pushed = false;
 
-	// Scan through the whole block
-	for (s16 y = MAP_BLOCKSIZE - 1; y >= 0; y--) {
-		MapNode node = block->getNodeNoCheck(dx, y, dz, &valid_position);
-		const ContentFeatures &f = m_ndef->get(node);
-		bool is_ignore = node.getContent() == CONTENT_IGNORE;
-		bool is_liquid = f.isLiquid();
+	if (!block->liquid_columns_cached)
+		block->updateLiquidColumns();
 
-		if (is_ignore || was_ignore || is_liquid == was_liquid) {
-			// Neither topmost node of liquid column nor topmost node below column
-			was_checked = false;
-			was_pushed = false;
-		} else if (is_liquid) {
-			// This is the topmost node in the column
-			bool is_pushed = false;
-			if (f.liquid_type == LIQUID_FLOWING ||
-					isLiquidHorizontallyFlowable(x, y, z)) {
-				m_liquid_queue->push_back(m_rel_block_pos + v3s16(x, y, z));
-				is_pushed = true;
-			}
-			// Remember waschecked and waspushed to avoid repeated
-			// checks/pushes in case the column consists of only this node
-			was_checked = true;
-			was_pushed = is_pushed;
-		} else {
-			// This is the topmost node below a liquid column
-			if (!was_pushed && (f.floodable ||
-					(!was_checked && isLiquidHorizontallyFlowable(x, y + 1, z)))) {
-				// Activate the lowest node in the column which is one
-				// node above this one
-				m_liquid_queue->push_back(m_rel_block_pos + v3s16(x, y + 1, z));
+	if (!was_liquid && !(block->liquid_columns[dz] & (1 << dx))) {
+		// The column contains no liquid and none can enter it from above,
+		// so no node in it can be queued; jump straight to the node below
+		// the block. (This matches the state the full loop would leave
+		// behind: the node at y = 0 with nothing checked or pushed.)
+		MapNode node = block->getNodeNoCheck(dx, 0, dz, &valid_position);
+		was_ignore = node.getContent() == CONTENT_IGNORE;
+		was_liquid = false;
+	} else {
+		// Scan through the whole block
+		for (s16 y = MAP_BLOCKSIZE - 1; y >= 0; y--) {
+			MapNode node = block->getNodeNoCheck(dx, y, dz, &valid_position);
+			const ContentFeatures &f = m_ndef->get(node);
+			bool is_ignore = node.getContent() == CONTENT_IGNORE;
+			bool is_liquid = f.isLiquid();
+
+			if (is_ignore || was_ignore || is_liquid == was_liquid) {
+				// Neither topmost node of liquid column nor topmost node below column
+				was_checked = false;
+				was_pushed = false;
+				if (is_liquid && was_ignore && !above && y == MAP_BLOCKSIZE - 1) {
+					// Liquid right below an unloaded block; that block
+					// must get a full scan when it is loaded as it might
+					// let this node flow then
+					m_map->dropSettledLiquids(m_block_pos +
+						v3s16((MAP_BLOCKSIZE + x) / MAP_BLOCKSIZE - 1, 1,
+							(MAP_BLOCKSIZE + z) / MAP_BLOCKSIZE - 1));
+				}
+			} else if (is_liquid) {
+				// This is the topmost node in the column
+				bool is_pushed = false;
+				if (f.liquid_type == LIQUID_FLOWING ||
+						isLiquidHorizontallyFlowable(x, y, z)) {
+					m_liquid_queue->push_back(m_rel_block_pos + v3s16(x, y, z));
+					is_pushed = true;
+				}
+				// Remember waschecked and waspushed to avoid repeated
+				// checks/pushes in case the column consists of only this node
+				was_checked = true;
+				was_pushed = is_pushed;
+			} else {
+				// This is the topmost node below a liquid column
+				if (!was_pushed && (f.floodable ||
+						(!was_checked && isLiquidHorizontallyFlowable(x, y + 1, z)))) {
+					// Activate the lowest node in the column which is one
+					// node above this one
+					m_liquid_queue->push_back(m_rel_block_pos + v3s16(x, y + 1, z));
+				}
 			}
-		}
 
-		was_liquid = is_liquid;
-		was_ignore = is_ignore;
+			was_liquid = is_liquid;
+			was_ignore = is_ignore;
+		}
 	}
 
 	// Check the node below the current block
 	MapBlock *below = lookupBlock(x, -1, z);
-	if (below) {
+	if (!below) {
+		if (was_liquid && !was_ignore) {
+			// Liquid right above an unloaded block; that block must get a
+			// full scan when it is loaded, the liquid might flow down
+			// into it then
+			m_map->dropSettledLiquids(m_block_pos +
+				v3s16((MAP_BLOCKSIZE + x) / MAP_BLOCKSIZE - 1, -1,
+					(MAP_BLOCKSIZE + z) / MAP_BLOCKSIZE - 1));
+		}
+	} else {
 		MapNode node = below->getNodeNoCheck(dx, MAP_BLOCKSIZE - 1, dz, &valid_position);
 		const ContentFeatures &f = m_ndef->get(node);
 		bool is_ignore = node.getContent() == CONTENT_IGNORE;
@@ -19,17 +19,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
-#include "util/container.h"
 #include "irrlichttypes_bloated.h"
 
 class NodeDefManager;
 class Map;
 class MapBlock;
+class LiquidTransformQueue;
 
 class ReflowScan {
 public:
 	ReflowScan(Map *map, const NodeDefManager *ndef);
-	void scan(MapBlock *block, UniqueQueue<v3s16> *liquid_queue);
+	void scan(MapBlock *block, LiquidTransformQueue *liquid_queue);
 
 private:
 	MapBlock *lookupBlock(int x, int y, int z);
@@ -41,7 +41,7 @@ private:
 	Map *m_map = nullptr;
 	const NodeDefManager *m_ndef = nullptr;
 	v3s16 m_block_pos, m_rel_block_pos;
-	UniqueQueue<v3s16> *m_liquid_queue = nullptr;
+	LiquidTransformQueue *m_liquid_queue = nullptr;
 	MapBlock *m_lookup[3 * 3 * 3];
 	u32 m_lookup_state_bitset;
 };
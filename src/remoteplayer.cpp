@@ -73,9 +73,9 @@ void RemotePlayer::serializeExtraAttributes(std::string &output)
 	assert(m_sao);
 	Json::Value json_root;
 
-	const StringMap &attrs = m_sao->getMeta().getStrings();
+	const MetadataStringMap &attrs = m_sao->getMeta().getStrings();
 	for (const auto &attr : attrs) {
-		json_root[attr.first] = attr.second;
+		json_root[attr.first] = attr.second.str();
 	}
 
 	output = fastWriteJson(json_root);
@@ -227,6 +227,7 @@ const RemotePlayerChatResult RemotePlayer::canSendChatMessage()
 void RemotePlayer::onSuccessfulSave()
 {
 	setModified(false);
+	setInventoryModified(false);
 	if (m_sao)
 		m_sao->getMeta().setModified(false);
 }
@@ -112,6 +112,17 @@ public:
 
 	inline void setModified(const bool x) { m_dirty = x; }
 
+	// Inventory dirty flag for the player database. The inventory's own
+	// modified flags belong to the network send path (which clears them
+	// after each TOCLIENT_INVENTORY), so persistence keeps a sticky flag
+	// of its own that only onSuccessfulSave() resets.
+	bool checkInventoryModified() const
+	{
+		return m_inv_dirty || inventory.checkModified();
+	}
+
+	inline void setInventoryModified(const bool x) { m_inv_dirty = x; }
+
 	void setLocalAnimations(v2s32 frames[4], float frame_speed)
 	{
 		for (int i = 0; i < 4; i++)
@@ -128,6 +139,19 @@ public:
 
 	void setDirty(bool dirty) { m_dirty = true; }
 
+	// Memoized craft prediction, keyed by a hash of the craft grid
+	// contents (see Server::UpdateCrafting)
+	bool checkCraftPredictionCached(u64 grid_hash) const
+	{
+		return m_craft_predict_valid && grid_hash == m_craft_predict_hash;
+	}
+
+	void setCraftPredictionHash(u64 grid_hash)
+	{
+		m_craft_predict_hash = grid_hash;
+		m_craft_predict_valid = true;
+	}
+
 	u16 protocol_version = 0;
 
 	// v1 for clients older than 5.1.0-dev
@@ -150,6 +174,10 @@ private:
 
 	PlayerSAO *m_sao = nullptr;
 	bool m_dirty = false;
+	bool m_inv_dirty = false;
+
+	u64 m_craft_predict_hash = 0;
+	bool m_craft_predict_valid = false;
 
 	static bool m_setting_cache_loaded;
 	static float m_setting_chat_message_limit_per_10sec;
@@ -31,9 +31,30 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "inventorymanager.h" // deserializing InventoryLocations
 #include "sqlite3.h"
 #include "filesys.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/thread.h"
 
 #define POINTS_PER_NODE (16.0)
 
+/*
+	Flushes queued rollback actions to SQLite off the server thread,
+	whenever RollbackManager::addAction has collected a batch
+*/
+class RollbackFlushThread : public UpdateThread
+{
+public:
+	RollbackFlushThread(RollbackManager *manager) :
+		UpdateThread("RollbackFlush"),
+		m_manager(manager)
+	{}
+
+protected:
+	void doUpdate() { m_manager->flush(); }
+
+private:
+	RollbackManager *m_manager;
+};
+
 #define SQLRES(f, good) \
 	if ((f) != (good)) {\
 		throw FileNotGoodException(std::string("RollbackManager: " \
@@ -109,11 +130,18 @@ RollbackManager::RollbackManager(const std::string & world_path,
 		migrate(txt_filename);
 		fs::DeleteSingleFileOrEmptyDirectory(migrating_flag);
 	}
+
+	flush_thread = new RollbackFlushThread(this);
+	flush_thread->start();
 }
 
 
 RollbackManager::~RollbackManager()
 {
+	flush_thread->stop();
+	flush_thread->wait();
+	delete flush_thread;
+
 	flush();
 
 	FINALIZE_STATEMENT(stmt_insert);
@@ -911,12 +939,24 @@ std::string RollbackManager::getSuspect(v3s16 p, float nearness_shortcut,
 
 void RollbackManager::flush()
 {
+	// Steal the queued actions, so reportAction() never waits for the
+	// transaction below
+	std::list<RollbackAction> to_write;
+	{
+		MutexAutoLock lock(action_buffer_mutex);
+		to_write.swap(action_todisk_buffer);
+	}
+	if (to_write.empty()) {
+		return;
+	}
+
+	MutexAutoLock dblock(database_mutex);
 	sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
 
 	std::list<RollbackAction>::const_iterator iter;
 
-	for (iter  = action_todisk_buffer.begin();
-			iter != action_todisk_buffer.end();
+	for (iter  = to_write.begin();
+			iter != to_write.end();
 			++iter) {
 		if (iter->actor.empty()) {
 			continue;
@@ -926,24 +966,30 @@ void RollbackManager::flush()
 	}
 
 	sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
-	action_todisk_buffer.clear();
 }
 
 
 void RollbackManager::addAction(const RollbackAction & action)
 {
-	action_todisk_buffer.push_back(action);
+	size_t queued;
+	{
+		MutexAutoLock lock(action_buffer_mutex);
+		action_todisk_buffer.push_back(action);
+		queued = action_todisk_buffer.size();
+	}
 	action_latest_buffer.push_back(action);
 
-	// Flush to disk sometimes
-	if (action_todisk_buffer.size() >= 500) {
-		flush();
+	// Flush to disk sometimes, off the server thread
+	if (queued >= 500) {
+		flush_thread->deferUpdate();
 	}
 }
 
 std::list<RollbackAction> RollbackManager::getEntriesSince(time_t first_time)
 {
 	flush();
+
+	MutexAutoLock dblock(database_mutex);
 	return getActionsSince(first_time);
 }
 
@@ -954,6 +1000,7 @@ std::list<RollbackAction> RollbackManager::getNodeActors(v3s16 pos, int range,
 	time_t cur_time = time(0);
 	time_t first_time = cur_time - seconds;
 
+	MutexAutoLock dblock(database_mutex);
 	return getActionsSince_range(first_time, pos, range, limit);
 }
 
@@ -966,6 +1013,7 @@ std::list<RollbackAction> RollbackManager::getRevertActions(
 
 	flush();
 
+	MutexAutoLock dblock(database_mutex);
 	return getActionsSince(first_time, actor_filter);
 }
 
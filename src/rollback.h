@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irr_v3d.h"
 #include "rollback_interface.h"
 #include <list>
+#include <mutex>
 #include <vector>
 #include "sqlite3.h"
 
@@ -30,6 +31,7 @@ class IGameDef;
 
 struct ActionRow;
 struct Entity;
+class RollbackFlushThread;
 
 class RollbackManager: public IRollbackManager
 {
@@ -84,6 +86,19 @@ private:
 	std::string current_actor;
 	bool current_actor_is_guess = false;
 
+	// Writes queued actions in batched transactions so the server
+	// thread never waits for SQLite
+	RollbackFlushThread *flush_thread = nullptr;
+
+	// Protects action_todisk_buffer (filled by the server thread,
+	// drained by the flush thread)
+	std::mutex action_buffer_mutex;
+	// Protects the database connection, the prepared statements and the
+	// knownActors/knownNodes caches
+	std::mutex database_mutex;
+
+	// Suspect lookups are served from action_latest_buffer, which is
+	// only ever touched by the server thread
 	std::list<RollbackAction> action_todisk_buffer;
 	std::list<RollbackAction> action_latest_buffer;
 
@@ -326,6 +326,9 @@ void read_object_properties(lua_State *L, int index,
 
 	getfloatfield(L, -1, "zoom_fov", prop->zoom_fov);
 	getboolfield(L, -1, "use_texture_alpha", prop->use_texture_alpha);
+	getfloatfield(L, -1, "sleep_distance", prop->sleep_distance);
+	getfloatfield(L, -1, "sleep_step_interval", prop->sleep_step_interval);
+	getfloatfield(L, -1, "suspend_distance", prop->suspend_distance);
 }
 
 /******************************************************************************/
@@ -410,6 +413,12 @@ void push_object_properties(lua_State *L, ObjectProperties *prop)
 	lua_setfield(L, -2, "zoom_fov");
 	lua_pushboolean(L, prop->use_texture_alpha);
 	lua_setfield(L, -2, "use_texture_alpha");
+	lua_pushnumber(L, prop->sleep_distance);
+	lua_setfield(L, -2, "sleep_distance");
+	lua_pushnumber(L, prop->sleep_step_interval);
+	lua_setfield(L, -2, "sleep_step_interval");
+	lua_pushnumber(L, prop->suspend_distance);
+	lua_setfield(L, -2, "suspend_distance");
 }
 
 /******************************************************************************/
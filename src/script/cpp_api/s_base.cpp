@@ -26,6 +26,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "filesys.h"
 #include "content/mods.h"
 #include "porting.h"
+#include "threading/thread.h"
+#include "threading/mutex_auto_lock.h"
 #include "util/string.h"
 #include "server.h"
 #ifndef SERVER
@@ -68,6 +70,47 @@ public:
 };
 
 
+/*
+	Sampling profiler
+
+	The sampler thread never touches the Lua state directly; it only arms
+	a one-shot count hook via lua_sethook(), which is the one part of the
+	Lua API that may be called from another thread. The hook then runs on
+	whichever engine thread is executing Lua and charges one sample to the
+	mod recorded as the callback origin. If no Lua code is running the
+	armed hook fires on the next entry into Lua instead, so idle engine
+	time is mostly not attributed, and the cost when sampling is disabled
+	is zero.
+*/
+
+class LuaSamplerThread : public Thread
+{
+public:
+	LuaSamplerThread(ScriptApiBase *script, u64 interval_ms) :
+		Thread("LuaSampler"),
+		m_script(script),
+		m_interval_ms(interval_ms)
+	{
+	}
+
+	void *run()
+	{
+		while (!stopRequested()) {
+			sleep_ms(m_interval_ms);
+			m_script->requestSample();
+		}
+		return nullptr;
+	}
+
+private:
+	ScriptApiBase *m_script;
+	u64 m_interval_ms;
+};
+
+// Minimum time between budget breach warnings for the same mod
+#define BUDGET_WARN_INTERVAL_MS 10000
+
+
 /*
 	ScriptApiBase
 */
@@ -126,9 +169,91 @@ ScriptApiBase::ScriptApiBase(ScriptingType type):
 
 ScriptApiBase::~ScriptApiBase()
 {
+	disableSampling();
 	lua_close(m_luastack);
 }
 
+void ScriptApiBase::enableSampling(u64 interval_ms, float step_budget_ms)
+{
+	if (m_sampler_thread)
+		return;
+	m_sampling_interval_ms = interval_ms > 0 ? interval_ms : 1;
+	m_step_budget_ms = step_budget_ms;
+	m_sampler_thread = new LuaSamplerThread(this, m_sampling_interval_ms);
+	m_sampler_thread->start();
+}
+
+void ScriptApiBase::disableSampling()
+{
+	if (!m_sampler_thread)
+		return;
+	m_sampler_thread->stop();
+	m_sampler_thread->wait();
+	delete m_sampler_thread;
+	m_sampler_thread = nullptr;
+	// Make sure no armed hook outlives the thread
+	lua_sethook(m_luastack, nullptr, 0, 0);
+}
+
+void ScriptApiBase::requestSample()
+{
+	lua_sethook(m_luastack, samplingHook, LUA_MASKCOUNT, 1);
+}
+
+void ScriptApiBase::samplingHook(lua_State *L, lua_Debug *ar)
+{
+	// One-shot: disarm before doing anything else
+	lua_sethook(L, nullptr, 0, 0);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_SCRIPTAPI);
+	ScriptApiBase *script = (ScriptApiBase *)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	script->recordSample();
+}
+
+void ScriptApiBase::recordSample()
+{
+	// Runs on the scripting thread, so reading m_last_run_mod is safe
+	std::string mod = m_last_run_mod.empty() ? "??" : m_last_run_mod;
+	MutexAutoLock lock(m_sample_mutex);
+	m_sample_counts[mod]++;
+	m_step_sample_counts[mod]++;
+}
+
+std::unordered_map<std::string, u64> ScriptApiBase::getSampleCounts()
+{
+	MutexAutoLock lock(m_sample_mutex);
+	return m_sample_counts;
+}
+
+void ScriptApiBase::stepSampleWindow()
+{
+	if (!m_sampler_thread)
+		return;
+
+	std::unordered_map<std::string, u64> step_counts;
+	{
+		MutexAutoLock lock(m_sample_mutex);
+		step_counts.swap(m_step_sample_counts);
+	}
+	if (m_step_budget_ms <= 0.0f)
+		return;
+
+	u64 now = porting::getTimeMs();
+	for (const auto &it : step_counts) {
+		// Each sample stands for roughly one sampling interval of CPU
+		float est_ms = it.second * (float)m_sampling_interval_ms;
+		if (est_ms <= m_step_budget_ms)
+			continue;
+		u64 &last_warn = m_budget_warn_time[it.first];
+		if (now - last_warn < BUDGET_WARN_INTERVAL_MS)
+			continue;
+		last_warn = now;
+		warningstream << "Mod \"" << it.first << "\" used an estimated "
+			<< est_ms << " ms of CPU during one server step (budget: "
+			<< m_step_budget_ms << " ms)" << std::endl;
+	}
+}
+
 int ScriptApiBase::luaPanic(lua_State *L)
 {
 	std::ostringstream oss;
@@ -160,6 +285,12 @@ void ScriptApiBase::clientOpenLibs(lua_State *L)
 	}
 }
 
+int ScriptApiBase::getMemoryUsageKB()
+{
+	RecursiveMutexAutoLock scriptlock(m_luastackmutex);
+	return lua_gc(m_luastack, LUA_GCCOUNT, 0);
+}
+
 void ScriptApiBase::loadMod(const std::string &script_path,
 		const std::string &mod_name)
 {
@@ -69,6 +69,7 @@ class Server;
 #ifndef SERVER
 class Client;
 #endif
+class LuaSamplerThread;
 class IGameDef;
 class Environment;
 class GUIEngine;
@@ -112,8 +113,26 @@ public:
 	void setOriginDirect(const char *origin);
 	void setOriginFromTableRaw(int index, const char *fxn);
 
+	/*
+		Sampling profiler: a timer thread periodically charges one sample
+		to the mod recorded as the callback origin, without instrumenting
+		any Lua code. See the implementation notes in s_base.cpp.
+	*/
+	void enableSampling(u64 interval_ms, float step_budget_ms);
+	void disableSampling();
+	/// Arms a one-shot hook on the Lua state; called by the sampler thread.
+	void requestSample();
+	/// Returns a copy of the accumulated per-mod sample counts.
+	std::unordered_map<std::string, u64> getSampleCounts();
+	/// Closes the per-step budget accounting window, logging mods whose
+	/// estimated CPU use exceeded the budget. Call once per server step.
+	void stepSampleWindow();
+
 	void clientOpenLibs(lua_State *L);
 
+	/// Current Lua heap size as reported by the garbage collector, in KB.
+	int getMemoryUsageKB();
+
 protected:
 	friend class LuaABM;
 	friend class LuaLBM;
@@ -154,6 +173,18 @@ protected:
 private:
 	static int luaPanic(lua_State *L);
 
+	static void samplingHook(lua_State *L, lua_Debug *ar);
+	void recordSample();
+
+	LuaSamplerThread *m_sampler_thread = nullptr;
+	u64             m_sampling_interval_ms = 0;
+	float           m_step_budget_ms = 0.0f;
+	std::mutex      m_sample_mutex;
+	std::unordered_map<std::string, u64> m_sample_counts;
+	std::unordered_map<std::string, u64> m_step_sample_counts;
+	// Last budget breach warning per mod; main thread only
+	std::unordered_map<std::string, u64> m_budget_warn_time;
+
 	lua_State      *m_luastack = nullptr;
 
 	IGameDef       *m_gamedef = nullptr;
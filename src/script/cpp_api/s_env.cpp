@@ -46,6 +46,9 @@ void ScriptApiEnv::environment_Step(float dtime)
 	SCRIPTAPI_PRECHECKHEADER
 	//infostream << "scriptapi_environment_step" << std::endl;
 
+	// Per-mod CPU budget accounting for the sampling profiler
+	stepSampleWindow();
+
 	// Get core.registered_globalsteps
 	lua_getglobal(L, "core");
 	lua_getfield(L, -1, "registered_globalsteps");
@@ -58,6 +61,39 @@ void ScriptApiEnv::environment_Step(float dtime)
 				std::string("environment_Step: ") + e.what() + "\n"
 				+ script_get_backtrace(L));
 	}
+
+	// Rate-limited globalsteps: the timers are advanced here so that
+	// callbacks which are not yet due never cross into Lua
+	int error_handler = PUSH_ERROR_HANDLER(L);
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "registered_rated_globalsteps");
+	if (lua_istable(L, -1)) {
+		size_t len = lua_objlen(L, -1);
+		for (size_t i = 1; i <= len; i++) {
+			lua_rawgeti(L, -1, i);
+			lua_getfield(L, -1, "timer");
+			lua_getfield(L, -2, "interval");
+			float timer = lua_tonumber(L, -2) + dtime;
+			float interval = lua_tonumber(L, -1);
+			lua_pop(L, 2);
+			lua_pushnumber(L, timer < interval ? timer : 0.0f);
+			lua_setfield(L, -2, "timer");
+			if (timer >= interval) {
+				lua_getfield(L, -1, "func");
+				// The callback gets the time elapsed since its last run
+				lua_pushnumber(L, timer);
+				try {
+					PCALL_RESL(L, lua_pcall(L, 1, 0, error_handler));
+				} catch (LuaError &e) {
+					getServer()->setAsyncFatalError(
+							std::string("environment_Step: ") + e.what() + "\n"
+							+ script_get_backtrace(L));
+				}
+			}
+			lua_pop(L, 1); // Pop entry
+		}
+	}
+	lua_pop(L, 3); // Pop list, core and error handler
 }
 
 void ScriptApiEnv::player_event(ServerActiveObject *player, const std::string &type)
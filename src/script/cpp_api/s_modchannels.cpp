@@ -35,6 +35,25 @@ void ScriptApiModChannels::on_modchannel_message(const std::string &channel,
 	runCallbacks(3, RUN_CALLBACKS_MODE_AND);
 }
 
+void ScriptApiModChannels::on_modchannel_messages(
+		const std::vector<ModChannelMsg> &messages)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	// One lock and one callback table lookup for the whole batch
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "registered_on_modchannel_message");
+	int table = lua_gettop(L);
+	for (const ModChannelMsg &msg : messages) {
+		lua_pushvalue(L, table);
+		lua_pushstring(L, msg.channel.c_str());
+		lua_pushstring(L, msg.sender.c_str());
+		lua_pushstring(L, msg.message.c_str());
+		runCallbacks(3, RUN_CALLBACKS_MODE_AND);
+		lua_pop(L, 1);
+	}
+}
+
 void ScriptApiModChannels::on_modchannel_signal(
 		const std::string &channel, ModChannelSignal signal)
 {
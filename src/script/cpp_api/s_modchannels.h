@@ -27,5 +27,7 @@ class ScriptApiModChannels : virtual public ScriptApiBase
 public:
 	void on_modchannel_message(const std::string &channel, const std::string &sender,
 			const std::string &message);
+	// Delivers a whole batch with a single lock/stack setup
+	void on_modchannel_messages(const std::vector<ModChannelMsg> &messages);
 	void on_modchannel_signal(const std::string &channel, ModChannelSignal signal);
 };
@@ -312,8 +312,10 @@ LuaAreaStore::LuaAreaStore(const std::string &type)
 		as = new SpatialAreaStore();
 	} else
 #endif
-	{
+	if (type == "Vector") {
 		as = new VectorAreaStore();
+	} else {
+		as = new RTreeAreaStore();
 	}
 }
 
@@ -245,7 +245,7 @@ void LuaEmergeAreaCallback(v3s16 blockpos, EmergeAction action, void *param)
 
 	// state must be protected by envlock
 	Server *server = state->script->getServer();
-	MutexAutoLock envlock(server->m_env_mutex);
+	SharedMutexWriteLock envlock(server->m_env_mutex);
 
 	state->refcount--;
 
@@ -293,15 +293,17 @@ int ModApiEnvMod::l_bulk_set_node(lua_State *L)
 
 	MapNode n = readnode(L, 2, ndef);
 
-	// Do it
-	bool succeeded = true;
+	std::vector<v3s16> positions;
+	positions.reserve(len);
 	for (s32 i = 1; i <= len; i++) {
 		lua_rawgeti(L, 1, i);
-		if (!env->setNode(read_v3s16(L, -1), n))
-			succeeded = false;
+		positions.push_back(read_v3s16(L, -1));
 		lua_pop(L, 1);
 	}
 
+	// Do it with a single combined lighting update
+	bool succeeded = env->bulkSetNode(positions, n);
+
 	lua_pushboolean(L, succeeded);
 	return 1;
 }
@@ -776,11 +778,32 @@ int ModApiEnvMod::l_find_node_near(lua_State *L)
 	}
 #endif
 
+	// Remember per mapblock whether it can contain any of the wanted
+	// contents, so searches over barren blocks don't read every node
+	Map &map = env->getMap();
+	std::map<v3s16, bool> block_relevant;
+
 	for (int d = start_radius; d <= radius; d++) {
-		std::vector<v3s16> list = FacePositionCache::getFacePositions(d);
+		const std::vector<v3s16> &list = FacePositionCache::getFacePositions(d);
 		for (const v3s16 &i : list) {
 			v3s16 p = pos + i;
-			content_t c = env->getMap().getNode(p).getContent();
+			v3s16 bp = getNodeBlockPos(p);
+			auto it = block_relevant.find(bp);
+			if (it == block_relevant.end()) {
+				MapBlock *block = map.getBlockNoCreateNoEx(bp);
+				bool relevant;
+				if (block) {
+					block->cacheContents();
+					relevant = block->mayContainContent(filter);
+				} else {
+					// Unloaded positions read as "ignore"
+					relevant = CONTAINS(filter, CONTENT_IGNORE);
+				}
+				it = block_relevant.emplace(bp, relevant).first;
+			}
+			if (!it->second)
+				continue;
+			content_t c = map.getNode(p).getContent();
 			if (CONTAINS(filter, c)) {
 				push_v3s16(L, p);
 				return 1;
@@ -826,13 +849,41 @@ int ModApiEnvMod::l_find_nodes_in_area(lua_State *L)
 	std::vector<u32> individual_count;
 	individual_count.resize(filter.size());
 
+	// Determine for each touched mapblock whether it can contain any of
+	// the wanted contents; blocks that provably cannot are skipped
+	// wholesale below. Unloaded positions read as "ignore".
+	Map &map = env->getMap();
+	v3s16 bpmin = getNodeBlockPos(minp);
+	v3s16 bpmax = getNodeBlockPos(maxp);
+	std::map<v3s16, bool> block_relevant;
+	for (s16 bx = bpmin.X; bx <= bpmax.X; bx++)
+	for (s16 by = bpmin.Y; by <= bpmax.Y; by++)
+	for (s16 bz = bpmin.Z; bz <= bpmax.Z; bz++) {
+		v3s16 bp(bx, by, bz);
+		MapBlock *block = map.getBlockNoCreateNoEx(bp);
+		bool relevant;
+		if (block) {
+			block->cacheContents();
+			relevant = block->mayContainContent(filter);
+		} else {
+			relevant = CONTAINS(filter, CONTENT_IGNORE);
+		}
+		block_relevant[bp] = relevant;
+	}
+
 	lua_newtable(L);
 	u64 i = 0;
 	for (s16 x = minp.X; x <= maxp.X; x++)
 	for (s16 y = minp.Y; y <= maxp.Y; y++)
 	for (s16 z = minp.Z; z <= maxp.Z; z++) {
 		v3s16 p(x, y, z);
-		content_t c = env->getMap().getNode(p).getContent();
+		v3s16 bp = getNodeBlockPos(p);
+		if (!block_relevant[bp]) {
+			// Jump to the last node of this block on the z axis
+			z = bp.Z * MAP_BLOCKSIZE + (MAP_BLOCKSIZE - 1);
+			continue;
+		}
+		content_t c = map.getNode(p).getContent();
 
 		std::vector<content_t>::iterator it = std::find(filter.begin(), filter.end(), c);
 		if (it != filter.end()) {
@@ -1013,6 +1064,49 @@ int ModApiEnvMod::l_line_of_sight(lua_State *L)
 	return 1;
 }
 
+// line_of_sight_batch(lines[, max_opaque]) -> list of booleans, blocking positions
+int ModApiEnvMod::l_line_of_sight_batch(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+
+	u32 max_opaque = 1;
+	if (lua_isnumber(L, 2))
+		max_opaque = MYMAX(1, lua_tonumber(L, 2));
+
+	size_t num_lines = lua_objlen(L, 1);
+	std::vector<std::pair<v3f, v3f>> lines;
+	lines.reserve(num_lines);
+	for (size_t i = 0; i < num_lines; i++) {
+		lua_rawgeti(L, 1, i + 1);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		lua_rawgeti(L, -1, 1);
+		v3f pos1 = checkFloatPos(L, -1);
+		lua_pop(L, 1);
+		lua_rawgeti(L, -1, 2);
+		v3f pos2 = checkFloatPos(L, -1);
+		lua_pop(L, 2);
+		lines.emplace_back(pos1, pos2);
+	}
+
+	std::vector<std::pair<bool, v3s16>> results;
+	env->line_of_sight_batch(lines, max_opaque, results);
+
+	lua_createtable(L, results.size(), 0);
+	lua_newtable(L);
+	for (size_t i = 0; i < results.size(); i++) {
+		lua_pushboolean(L, results[i].first);
+		lua_rawseti(L, -3, i + 1);
+		if (!results[i].first) {
+			push_v3s16(L, results[i].second);
+			lua_rawseti(L, -2, i + 1);
+		}
+	}
+
+	return 2;
+}
+
 // fix_light(p1, p2)
 int ModApiEnvMod::l_fix_light(lua_State *L)
 {
@@ -1047,6 +1141,56 @@ int ModApiEnvMod::l_raycast(lua_State *L)
 	return LuaRaycast::create_object(L);
 }
 
+// raycast_batch(rays, objects, liquids) -> table of pointed things
+int ModApiEnvMod::l_raycast_batch(lua_State *L)
+{
+	MAP_LOCK_REQUIRED;
+
+	ScriptApiItem *script = getScriptApi<ScriptApiItem>(L);
+	GET_ENV_PTR;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+
+	bool objects = true;
+	bool liquids = false;
+	if (lua_isboolean(L, 2)) {
+		objects = readParam<bool>(L, 2);
+	}
+	if (lua_isboolean(L, 3)) {
+		liquids = readParam<bool>(L, 3);
+	}
+
+	size_t num_rays = lua_objlen(L, 1);
+	std::vector<RaycastState> states;
+	states.reserve(num_rays);
+	for (size_t i = 0; i < num_rays; i++) {
+		lua_rawgeti(L, 1, i + 1);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		lua_rawgeti(L, -1, 1);
+		v3f pos1 = checkFloatPos(L, -1);
+		lua_pop(L, 1);
+		lua_rawgeti(L, -1, 2);
+		v3f pos2 = checkFloatPos(L, -1);
+		lua_pop(L, 2);
+		states.emplace_back(core::line3d<f32>(pos1, pos2),
+			objects, liquids);
+	}
+
+	std::vector<PointedThing> results;
+	env->raycastBatch(states, results);
+
+	lua_createtable(L, results.size(), 0);
+	for (size_t i = 0; i < results.size(); i++) {
+		if (results[i].type == POINTEDTHING_NOTHING)
+			lua_pushboolean(L, false);
+		else
+			script->pushPointedThing(results[i], true);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	return 1;
+}
+
 // load_area(p1, [p2])
 // load mapblocks in area p1..p2, but do not generate map
 int ModApiEnvMod::l_load_area(lua_State *L)
@@ -1167,6 +1311,9 @@ int ModApiEnvMod::l_find_path(lua_State *L)
 		if (algorithm == "A*")
 			algo = PA_PLAIN;
 
+		if (algorithm == "A*_hierarchical")
+			algo = PA_HIERARCHICAL;
+
 		if (algorithm == "Dijkstra")
 			algo = PA_DIJKSTRA;
 	}
@@ -1190,6 +1337,48 @@ int ModApiEnvMod::l_find_path(lua_State *L)
 	return 0;
 }
 
+// Reads a treedef table (as accepted by spawn_tree()) at the given stack
+// index; returns false if there is no table there
+static bool read_tree_def(lua_State *L, int idx,
+	const NodeDefManager *ndef, treegen::TreeDef &tree_def)
+{
+	std::string trunk,leaves,fruit;
+
+	if(!lua_istable(L, idx))
+		return false;
+
+	getstringfield(L, idx, "axiom", tree_def.initial_axiom);
+	getstringfield(L, idx, "rules_a", tree_def.rules_a);
+	getstringfield(L, idx, "rules_b", tree_def.rules_b);
+	getstringfield(L, idx, "rules_c", tree_def.rules_c);
+	getstringfield(L, idx, "rules_d", tree_def.rules_d);
+	getstringfield(L, idx, "trunk", trunk);
+	tree_def.trunknode=ndef->getId(trunk);
+	getstringfield(L, idx, "leaves", leaves);
+	tree_def.leavesnode=ndef->getId(leaves);
+	tree_def.leaves2_chance=0;
+	getstringfield(L, idx, "leaves2", leaves);
+	if (!leaves.empty()) {
+		tree_def.leaves2node=ndef->getId(leaves);
+		getintfield(L, idx, "leaves2_chance", tree_def.leaves2_chance);
+	}
+	getintfield(L, idx, "angle", tree_def.angle);
+	getintfield(L, idx, "iterations", tree_def.iterations);
+	if (!getintfield(L, idx, "random_level", tree_def.iterations_random_level))
+		tree_def.iterations_random_level = 0;
+	getstringfield(L, idx, "trunk_type", tree_def.trunk_type);
+	getboolfield(L, idx, "thin_branches", tree_def.thin_branches);
+	tree_def.fruit_chance=0;
+	getstringfield(L, idx, "fruit", fruit);
+	if (!fruit.empty()) {
+		tree_def.fruitnode=ndef->getId(fruit);
+		getintfield(L, idx, "fruit_chance",tree_def.fruit_chance);
+	}
+	tree_def.explicit_seed = getintfield(L, idx, "seed", tree_def.seed);
+
+	return true;
+}
+
 // spawn_tree(pos, treedef)
 int ModApiEnvMod::l_spawn_tree(lua_State *L)
 {
@@ -1198,41 +1387,9 @@ int ModApiEnvMod::l_spawn_tree(lua_State *L)
 	v3s16 p0 = read_v3s16(L, 1);
 
 	treegen::TreeDef tree_def;
-	std::string trunk,leaves,fruit;
 	const NodeDefManager *ndef = env->getGameDef()->ndef();
 
-	if(lua_istable(L, 2))
-	{
-		getstringfield(L, 2, "axiom", tree_def.initial_axiom);
-		getstringfield(L, 2, "rules_a", tree_def.rules_a);
-		getstringfield(L, 2, "rules_b", tree_def.rules_b);
-		getstringfield(L, 2, "rules_c", tree_def.rules_c);
-		getstringfield(L, 2, "rules_d", tree_def.rules_d);
-		getstringfield(L, 2, "trunk", trunk);
-		tree_def.trunknode=ndef->getId(trunk);
-		getstringfield(L, 2, "leaves", leaves);
-		tree_def.leavesnode=ndef->getId(leaves);
-		tree_def.leaves2_chance=0;
-		getstringfield(L, 2, "leaves2", leaves);
-		if (!leaves.empty()) {
-			tree_def.leaves2node=ndef->getId(leaves);
-			getintfield(L, 2, "leaves2_chance", tree_def.leaves2_chance);
-		}
-		getintfield(L, 2, "angle", tree_def.angle);
-		getintfield(L, 2, "iterations", tree_def.iterations);
-		if (!getintfield(L, 2, "random_level", tree_def.iterations_random_level))
-			tree_def.iterations_random_level = 0;
-		getstringfield(L, 2, "trunk_type", tree_def.trunk_type);
-		getboolfield(L, 2, "thin_branches", tree_def.thin_branches);
-		tree_def.fruit_chance=0;
-		getstringfield(L, 2, "fruit", fruit);
-		if (!fruit.empty()) {
-			tree_def.fruitnode=ndef->getId(fruit);
-			getintfield(L, 2, "fruit_chance",tree_def.fruit_chance);
-		}
-		tree_def.explicit_seed = getintfield(L, 2, "seed", tree_def.seed);
-	}
-	else
+	if (!read_tree_def(L, 2, ndef, tree_def))
 		return 0;
 
 	treegen::error e;
@@ -1247,6 +1404,37 @@ int ModApiEnvMod::l_spawn_tree(lua_State *L)
 	return 1;
 }
 
+// spawn_trees(positions, treedef)
+int ModApiEnvMod::l_spawn_trees(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	if (!lua_istable(L, 1))
+		return 0;
+
+	std::vector<v3s16> positions;
+	positions.reserve(lua_objlen(L, 1));
+	for (lua_pushnil(L); lua_next(L, 1); lua_pop(L, 1))
+		positions.push_back(read_v3s16(L, -1));
+
+	treegen::TreeDef tree_def;
+	const NodeDefManager *ndef = env->getGameDef()->ndef();
+
+	if (!read_tree_def(L, 2, ndef, tree_def))
+		return 0;
+
+	treegen::error e;
+	if ((e = treegen::spawn_ltrees(env, positions, ndef, tree_def)) != treegen::SUCCESS) {
+		if (e == treegen::UNBALANCED_BRACKETS) {
+			luaL_error(L, "spawn_trees(): closing ']' has no matching opening bracket");
+		} else {
+			luaL_error(L, "spawn_trees(): unknown error");
+		}
+	}
+
+	return 1;
+}
+
 // transforming_liquid_add(pos)
 int ModApiEnvMod::l_transforming_liquid_add(lua_State *L)
 {
@@ -1319,9 +1507,12 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(get_voxel_manip);
 	API_FCT(clear_objects);
 	API_FCT(spawn_tree);
+	API_FCT(spawn_trees);
 	API_FCT(find_path);
 	API_FCT(line_of_sight);
+	API_FCT(line_of_sight_batch);
 	API_FCT(raycast);
+	API_FCT(raycast_batch);
 	API_FCT(transforming_liquid_add);
 	API_FCT(forceload_block);
 	API_FCT(forceload_free_block);
@@ -163,12 +163,21 @@ private:
 	// spawn_tree(pos, treedef)
 	static int l_spawn_tree(lua_State *L);
 
+	// spawn_trees(positions, treedef)
+	static int l_spawn_trees(lua_State *L);
+
 	// line_of_sight(pos1, pos2) -> true/false
 	static int l_line_of_sight(lua_State *L);
 
+	// line_of_sight_batch(lines, max_opaque) -> list of booleans, blocking positions
+	static int l_line_of_sight_batch(lua_State *L);
+
 	// raycast(pos1, pos2, objects, liquids) -> Raycast
 	static int l_raycast(lua_State *L);
 
+	// raycast_batch(rays, objects, liquids) -> table of pointed things
+	static int l_raycast_batch(lua_State *L);
+
 	// find_path(pos1, pos2, searchdistance,
 	//     max_jump, max_drop, algorithm) -> table containing path
 	static int l_find_path(lua_State *L);
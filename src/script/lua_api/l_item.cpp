@@ -30,11 +30,36 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 
 
+/*
+	Recycling pool for the userdata-held stacks. thread_local so no
+	locking is needed; objects freed by one thread simply migrate to
+	its pool and are reused by whatever that thread allocates next.
+*/
+static const size_t ITEMSTACK_POOL_LIMIT = 256;
+static thread_local std::vector<LuaItemStack *> itemstack_pool;
+
+static LuaItemStack *acquireLuaItemStack(ItemStack &&item)
+{
+	if (!itemstack_pool.empty()) {
+		LuaItemStack *o = itemstack_pool.back();
+		itemstack_pool.pop_back();
+		o->getItem() = std::move(item);
+		return o;
+	}
+	return new LuaItemStack(std::move(item));
+}
+
 // garbage collector
 int LuaItemStack::gc_object(lua_State *L)
 {
 	LuaItemStack *o = *(LuaItemStack **)(lua_touserdata(L, 1));
-	delete o;
+	if (itemstack_pool.size() < ITEMSTACK_POOL_LIMIT) {
+		// Release the name/metadata strings before pooling
+		o->getItem().clear();
+		itemstack_pool.push_back(o);
+	} else {
+		delete o;
+	}
 	return 0;
 }
 
@@ -240,7 +265,7 @@ int LuaItemStack::l_to_table(lua_State *L)
 		lua_setfield(L, -2, "metadata");
 
 		lua_newtable(L);
-		const StringMap &fields = item.metadata.getStrings();
+		const MetadataStringMap &fields = item.metadata.getStrings();
 		for (const auto &field : fields) {
 			const std::string &name = field.first;
 			if (name.empty())
@@ -377,7 +402,7 @@ int LuaItemStack::l_take_item(lua_State *L)
 	if(!lua_isnone(L, 2))
 		takecount = luaL_checkinteger(L, 2);
 	ItemStack taken = item.takeItem(takecount);
-	create(L, taken);
+	create(L, std::move(taken));
 	return 1;
 }
 
@@ -391,7 +416,7 @@ int LuaItemStack::l_peek_item(lua_State *L)
 	if(!lua_isnone(L, 2))
 		peekcount = lua_tointeger(L, 2);
 	ItemStack peekaboo = item.peekItem(peekcount);
-	create(L, peekaboo);
+	create(L, std::move(peekaboo));
 	return 1;
 }
 
@@ -400,6 +425,11 @@ LuaItemStack::LuaItemStack(const ItemStack &item):
 {
 }
 
+LuaItemStack::LuaItemStack(ItemStack &&item):
+	m_stack(std::move(item))
+{
+}
+
 const ItemStack& LuaItemStack::getItem() const
 {
 	return m_stack;
@@ -415,22 +445,22 @@ int LuaItemStack::create_object(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
 	ItemStack item = read_item(L, 1, getGameDef(L)->idef());
-	LuaItemStack *o = new LuaItemStack(item);
-	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
-	luaL_getmetatable(L, className);
-	lua_setmetatable(L, -2);
-	return 1;
+	return create(L, std::move(item));
 }
 // Not callable from Lua
-int LuaItemStack::create(lua_State *L, const ItemStack &item)
+int LuaItemStack::create(lua_State *L, ItemStack &&item)
 {
 	NO_MAP_LOCK_REQUIRED;
-	LuaItemStack *o = new LuaItemStack(item);
+	LuaItemStack *o = acquireLuaItemStack(std::move(item));
 	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
 	luaL_getmetatable(L, className);
 	lua_setmetatable(L, -2);
 	return 1;
 }
+int LuaItemStack::create(lua_State *L, const ItemStack &item)
+{
+	return create(L, ItemStack(item));
+}
 
 LuaItemStack* LuaItemStack::checkobject(lua_State *L, int narg)
 {
@@ -124,6 +124,7 @@ private:
 
 public:
 	LuaItemStack(const ItemStack &item);
+	LuaItemStack(ItemStack &&item);
 	~LuaItemStack() = default;
 
 	const ItemStack& getItem() const;
@@ -132,7 +133,10 @@ public:
 	// LuaItemStack(itemstack or itemstring or table or nil)
 	// Creates an LuaItemStack and leaves it on top of stack
 	static int create_object(lua_State *L);
-	// Not callable from Lua
+	// Not callable from Lua. Userdata-held stacks churn at very high
+	// rates through callback arguments, so they are recycled through a
+	// per-thread pool instead of being heap-allocated each time.
+	static int create(lua_State *L, ItemStack &&item);
 	static int create(lua_State *L, const ItemStack &item);
 	static LuaItemStack* checkobject(lua_State *L, int narg);
 	static void Register(lua_State *L);
@@ -254,7 +254,7 @@ void MetaDataRef::handleToTable(lua_State *L, Metadata *meta)
 {
 	lua_newtable(L);
 	{
-		const StringMap &fields = meta->getStrings();
+		const MetadataStringMap &fields = meta->getStrings();
 		for (const auto &field : fields) {
 			const std::string &name = field.first;
 			const std::string &value = field.second;
@@ -24,6 +24,74 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "porting.h"
 #include "util/numeric.h"
+#include "threading/mutex_auto_lock.h"
+#include <mutex>
+#include <vector>
+
+/*
+	Pool of Noise instances keyed by parameters, seed and size.
+
+	Mods that create a fresh PerlinNoiseMap per generated chunk would
+	otherwise allocate and free several megabytes of noise buffers per
+	chunk. A released Noise whose parameters match a later request is
+	handed back out with its buffers intact. Guarded by a mutex because
+	mapgen Lua states run on emerge threads.
+*/
+struct NoisePoolEntry
+{
+	NoiseParams np;
+	s32 seed;
+	v3s16 size;
+	Noise *noise;
+};
+
+static std::vector<NoisePoolEntry> g_noise_pool;
+static std::mutex g_noise_pool_mutex;
+
+// The buffers are large (several MB for an 80^3 map), keep few of them
+static const size_t NOISE_POOL_MAX_ENTRIES = 4;
+
+static bool noise_params_equal(const NoiseParams &a, const NoiseParams &b)
+{
+	return a.offset == b.offset && a.scale == b.scale &&
+		a.spread == b.spread && a.seed == b.seed &&
+		a.octaves == b.octaves && a.persist == b.persist &&
+		a.lacunarity == b.lacunarity && a.flags == b.flags;
+}
+
+static Noise *acquireNoise(NoiseParams *np, s32 seed, v3s16 size)
+{
+	{
+		MutexAutoLock lock(g_noise_pool_mutex);
+		for (auto it = g_noise_pool.begin();
+				it != g_noise_pool.end(); ++it) {
+			if (it->seed == seed && it->size == size &&
+					noise_params_equal(it->np, *np)) {
+				Noise *n = it->noise;
+				g_noise_pool.erase(it);
+				return n;
+			}
+		}
+	}
+	return new Noise(np, seed, size.X, size.Y, size.Z);
+}
+
+static void releaseNoise(Noise *noise, const NoiseParams &np, s32 seed,
+		v3s16 size)
+{
+	MutexAutoLock lock(g_noise_pool_mutex);
+	if (g_noise_pool.size() >= NOISE_POOL_MAX_ENTRIES) {
+		// Evict the oldest entry
+		delete g_noise_pool.front().noise;
+		g_noise_pool.erase(g_noise_pool.begin());
+	}
+	NoisePoolEntry entry;
+	entry.np = np;
+	entry.seed = seed;
+	entry.size = size;
+	entry.noise = noise;
+	g_noise_pool.push_back(entry);
+}
 
 ///////////////////////////////////////
 /*
@@ -147,7 +215,7 @@ LuaPerlinNoiseMap::LuaPerlinNoiseMap(NoiseParams *params, s32 seed, v3s16 size)
 	m_is3d = size.Z > 1;
 	np = *params;
 	try {
-		noise = new Noise(&np, seed, size.X, size.Y, size.Z);
+		noise = acquireNoise(&np, seed, size);
 	} catch (InvalidNoiseParamsException &e) {
 		throw LuaError(e.what());
 	}
@@ -156,7 +224,8 @@ LuaPerlinNoiseMap::LuaPerlinNoiseMap(NoiseParams *params, s32 seed, v3s16 size)
 
 LuaPerlinNoiseMap::~LuaPerlinNoiseMap()
 {
-	delete noise;
+	releaseNoise(noise, np, noise->seed,
+			v3s16(noise->sx, noise->sy, noise->sz));
 }
 
 
@@ -270,6 +339,44 @@ int LuaPerlinNoiseMap::l_get_3d_map_flat(lua_State *L)
 }
 
 
+int LuaPerlinNoiseMap::l_get_2d_map_raw(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaPerlinNoiseMap *o = checkobject(L, 1);
+	v2f p = readParam<v2f>(L, 2);
+
+	Noise *n = o->noise;
+	n->perlinMap2D(p.X, p.Y);
+
+	// The result buffer as-is: sx * sy native-endian floats. A single
+	// string allocation instead of one table store per value; LuaJIT
+	// scripts can cast the string data pointer with the FFI.
+	lua_pushlstring(L, (const char *)n->result,
+			n->sx * n->sy * sizeof(float));
+	return 1;
+}
+
+
+int LuaPerlinNoiseMap::l_get_3d_map_raw(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaPerlinNoiseMap *o = checkobject(L, 1);
+	v3f p = check_v3f(L, 2);
+
+	if (!o->m_is3d)
+		return 0;
+
+	Noise *n = o->noise;
+	n->perlinMap3D(p.X, p.Y, p.Z);
+
+	lua_pushlstring(L, (const char *)n->result,
+			n->sx * n->sy * n->sz * sizeof(float));
+	return 1;
+}
+
+
 int LuaPerlinNoiseMap::l_calc_2d_map(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
@@ -393,9 +500,11 @@ const char LuaPerlinNoiseMap::className[] = "PerlinNoiseMap";
 luaL_Reg LuaPerlinNoiseMap::methods[] = {
 	luamethod_aliased(LuaPerlinNoiseMap, get_2d_map,      get2dMap),
 	luamethod_aliased(LuaPerlinNoiseMap, get_2d_map_flat, get2dMap_flat),
+	luamethod_aliased(LuaPerlinNoiseMap, get_2d_map_raw,  get2dMap_raw),
 	luamethod_aliased(LuaPerlinNoiseMap, calc_2d_map,     calc2dMap),
 	luamethod_aliased(LuaPerlinNoiseMap, get_3d_map,      get3dMap),
 	luamethod_aliased(LuaPerlinNoiseMap, get_3d_map_flat, get3dMap_flat),
+	luamethod_aliased(LuaPerlinNoiseMap, get_3d_map_raw,  get3dMap_raw),
 	luamethod_aliased(LuaPerlinNoiseMap, calc_3d_map,     calc3dMap),
 	luamethod_aliased(LuaPerlinNoiseMap, get_map_slice,   getMapSlice),
 	{0,0}
@@ -72,8 +72,10 @@ class LuaPerlinNoiseMap : public ModApiBase
 
 	static int l_get_2d_map(lua_State *L);
 	static int l_get_2d_map_flat(lua_State *L);
+	static int l_get_2d_map_raw(lua_State *L);
 	static int l_get_3d_map(lua_State *L);
 	static int l_get_3d_map_flat(lua_State *L);
+	static int l_get_3d_map_raw(lua_State *L);
 
 	static int l_calc_2d_map(lua_State *L);
 	static int l_calc_3d_map(lua_State *L);
@@ -22,10 +22,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "cpp_api/s_base.h"
+#include "scripting_server.h"
 #include "server.h"
 #include "environment.h"
 #include "remoteplayer.h"
 #include "log.h"
+#include "util/tunables.h"
 #include <algorithm>
 
 // request_shutdown()
@@ -47,6 +49,14 @@ int ModApiServer::l_get_server_status(lua_State *L)
 	return 1;
 }
 
+// get_network_stats()
+int ModApiServer::l_get_network_stats(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	lua_pushstring(L, getServer(L)->getNetworkStatsString().c_str());
+	return 1;
+}
+
 // get_server_uptime()
 int ModApiServer::l_get_server_uptime(lua_State *L)
 {
@@ -505,10 +515,90 @@ int ModApiServer::l_set_last_run_mod(lua_State *L)
 	return 0;
 }
 
+// do_async_callback(func, params)
+int ModApiServer::l_do_async_callback(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	ServerScripting *script = getScriptApi<ServerScripting>(L);
+
+	size_t func_length, param_length;
+	const char *serialized_func_raw = luaL_checklstring(L, 1, &func_length);
+	const char *serialized_param_raw = luaL_checklstring(L, 2, &param_length);
+
+	sanity_check(serialized_func_raw != NULL);
+	sanity_check(serialized_param_raw != NULL);
+
+	std::string serialized_func(serialized_func_raw, func_length);
+	std::string serialized_param(serialized_param_raw, param_length);
+
+	lua_pushinteger(L, script->queueAsync(serialized_func, serialized_param));
+	return 1;
+}
+
+// get_finished_jobs()
+int ModApiServer::l_get_finished_jobs(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	getScriptApi<ServerScripting>(L)->pushAsyncResults(L);
+	return 1;
+}
+
+// get_sampling_profile()
+int ModApiServer::l_get_sampling_profile(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	std::unordered_map<std::string, u64> counts =
+			getScriptApiBase(L)->getSampleCounts();
+
+	lua_newtable(L);
+	for (const auto &it : counts) {
+		lua_pushnumber(L, it.second);
+		lua_setfield(L, -2, it.first.c_str());
+	}
+	return 1;
+}
+
+// get_tunables()
+int ModApiServer::l_get_tunables(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	lua_newtable(L);
+	for (const TunableRegistry::TunableInfo &info : g_tunables->getAll()) {
+		lua_newtable(L);
+		lua_pushnumber(L, info.value);
+		lua_setfield(L, -2, "value");
+		lua_pushnumber(L, info.min);
+		lua_setfield(L, -2, "min");
+		lua_pushnumber(L, info.max);
+		lua_setfield(L, -2, "max");
+		lua_pushstring(L, info.help.c_str());
+		lua_setfield(L, -2, "help");
+		lua_setfield(L, -2, info.name.c_str());
+	}
+	return 1;
+}
+
+// set_tunable(name, value)
+int ModApiServer::l_set_tunable(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	std::string name = luaL_checkstring(L, 1);
+	std::string value = luaL_checkstring(L, 2);
+	std::string error;
+	if (!g_tunables->set(name, value, &error)) {
+		lua_pushboolean(L, false);
+		lua_pushstring(L, error.c_str());
+		return 2;
+	}
+	lua_pushboolean(L, true);
+	return 1;
+}
+
 void ModApiServer::Initialize(lua_State *L, int top)
 {
 	API_FCT(request_shutdown);
 	API_FCT(get_server_status);
+	API_FCT(get_network_stats);
 	API_FCT(get_server_uptime);
 	API_FCT(get_worldpath);
 	API_FCT(is_singleplayer);
@@ -539,4 +629,11 @@ void ModApiServer::Initialize(lua_State *L, int top)
 
 	API_FCT(get_last_run_mod);
 	API_FCT(set_last_run_mod);
+
+	API_FCT(do_async_callback);
+	API_FCT(get_finished_jobs);
+
+	API_FCT(get_sampling_profile);
+	API_FCT(get_tunables);
+	API_FCT(set_tunable);
 }
@@ -30,6 +30,9 @@ private:
 	// get_server_status()
 	static int l_get_server_status(lua_State *L);
 
+	// get_network_stats()
+	static int l_get_network_stats(lua_State *L);
+
 	// get_server_uptime()
 	static int l_get_server_uptime(lua_State *L);
 
@@ -106,6 +109,21 @@ private:
 	// set_last_run_mod(modname)
 	static int l_set_last_run_mod(lua_State *L);
 
+	// do_async_callback(func, params)
+	static int l_do_async_callback(lua_State *L);
+
+	// get_finished_jobs()
+	static int l_get_finished_jobs(lua_State *L);
+
+	// get_sampling_profile()
+	static int l_get_sampling_profile(lua_State *L);
+
+	// get_tunables()
+	static int l_get_tunables(lua_State *L);
+
+	// set_tunable(name, value)
+	static int l_set_tunable(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
 };
@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server.h"
 #include "mapgen/mapgen.h"
 #include "voxelalgorithms.h"
+#include <cstring>
 
 // garbage collector
 int LuaVoxelManip::gc_object(lua_State *L)
@@ -106,6 +107,50 @@ int LuaVoxelManip::l_set_data(lua_State *L)
 	return 0;
 }
 
+int LuaVoxelManip::l_get_raw_data(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkobject(L, 1);
+	MMVManip *vm = o->vm;
+
+	u32 volume = vm->m_area.getVolume();
+
+	// The node array as-is: 4 bytes per node, native layout (param0 as
+	// native-endian u16, then param1 and param2). A single string
+	// allocation instead of one table store per node; LuaJIT scripts
+	// can cast the string data pointer with the FFI and index it
+	// without any further copies.
+	lua_pushlstring(L, (const char *)vm->m_data,
+			volume * sizeof(MapNode));
+
+	return 1;
+}
+
+int LuaVoxelManip::l_set_raw_data(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkobject(L, 1);
+	MMVManip *vm = o->vm;
+
+	if (lua_type(L, 2) != LUA_TSTRING)
+		throw LuaError("VoxelManip:set_raw_data called with missing "
+				"parameter");
+
+	size_t len;
+	const char *data = lua_tolstring(L, 2, &len);
+
+	u32 volume = vm->m_area.getVolume();
+	if (len != volume * sizeof(MapNode))
+		throw LuaError("VoxelManip:set_raw_data called with data of "
+				"wrong size for the emerged area");
+
+	memcpy(vm->m_data, data, len);
+
+	return 0;
+}
+
 int LuaVoxelManip::l_write_to_map(lua_State *L)
 {
 	MAP_LOCK_REQUIRED;
@@ -174,8 +219,12 @@ int LuaVoxelManip::l_update_liquids(lua_State *L)
 	mg.vm   = vm;
 	mg.ndef = ndef;
 
-	mg.updateLiquid(&map->m_transforming_liquid,
-			vm->m_area.MinEdge, vm->m_area.MaxEdge);
+	UniqueQueue<v3s16> trans_liquid;
+	mg.updateLiquid(&trans_liquid, vm->m_area.MinEdge, vm->m_area.MaxEdge);
+	while (trans_liquid.size()) {
+		map->transforming_liquid_add(trans_liquid.front());
+		trans_liquid.pop_front();
+	}
 
 	return 0;
 }
@@ -462,6 +511,8 @@ const luaL_Reg LuaVoxelManip::methods[] = {
 	luamethod(LuaVoxelManip, read_from_map),
 	luamethod(LuaVoxelManip, get_data),
 	luamethod(LuaVoxelManip, set_data),
+	luamethod(LuaVoxelManip, get_raw_data),
+	luamethod(LuaVoxelManip, set_raw_data),
 	luamethod(LuaVoxelManip, get_node_at),
 	luamethod(LuaVoxelManip, set_node_at),
 	luamethod(LuaVoxelManip, write_to_map),
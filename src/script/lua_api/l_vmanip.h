@@ -44,6 +44,8 @@ private:
 	static int l_read_from_map(lua_State *L);
 	static int l_get_data(lua_State *L);
 	static int l_set_data(lua_State *L);
+	static int l_get_raw_data(lua_State *L);
+	static int l_set_raw_data(lua_State *L);
 	static int l_write_to_map(lua_State *L);
 
 	static int l_get_node_at(lua_State *L);
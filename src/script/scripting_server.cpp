@@ -50,6 +50,8 @@ extern "C" {
 #include "lualib.h"
 }
 
+#define SERVER_NUM_ASYNC_THREADS 4
+
 ServerScripting::ServerScripting(Server* server):
 		ScriptApiBase(ScriptingType::Server)
 {
@@ -82,6 +84,28 @@ ServerScripting::ServerScripting(Server* server):
 	lua_setglobal(L, "INIT");
 
 	infostream << "SCRIPTAPI: Initialized game modules" << std::endl;
+
+	// Initialize the asynchronous worker environment
+	asyncEngine.registerStateInitializer(InitializeAsync);
+	asyncEngine.registerStateInitializer(ModApiUtil::InitializeAsync);
+	asyncEngine.initialize(SERVER_NUM_ASYNC_THREADS);
+
+	// Start the sampling profiler if requested
+	if (g_settings->getBool("profiler.sampling")) {
+		enableSampling(g_settings->getU64("profiler.sampling_interval_ms"),
+				g_settings->getFloat("profiler.mod_step_budget_ms"));
+	}
+}
+
+unsigned int ServerScripting::queueAsync(const std::string &serialized_func,
+		const std::string &serialized_param)
+{
+	return asyncEngine.queueAsyncJob(serialized_func, serialized_param);
+}
+
+void ServerScripting::pushAsyncResults(lua_State *L)
+{
+	asyncEngine.pushFinishedJobs(L);
 }
 
 void ServerScripting::InitializeModApi(lua_State *L, int top)
@@ -122,6 +146,18 @@ void ServerScripting::InitializeModApi(lua_State *L, int top)
 	ModApiChannels::Initialize(L, top);
 }
 
+void ServerScripting::InitializeAsync(lua_State *L, int top)
+{
+	// Classes usable without an attached environment
+	LuaAreaStore::Register(L);
+	LuaPerlinNoise::Register(L);
+	LuaPerlinNoiseMap::Register(L);
+	LuaPseudoRandom::Register(L);
+	LuaPcgRandom::Register(L);
+	LuaSecureRandom::Register(L);
+	LuaSettings::Register(L);
+}
+
 void log_deprecated(const std::string &message)
 {
 	log_deprecated(NULL, message);
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #pragma once
+#include "cpp_api/s_async.h"
 #include "cpp_api/s_base.h"
 #include "cpp_api/s_entity.h"
 #include "cpp_api/s_env.h"
@@ -48,8 +49,18 @@ public:
 
 	// use ScriptApiBase::loadMod() to load mods
 
+	// Pass a job to the async worker pool
+	unsigned int queueAsync(const std::string &serialized_func,
+			const std::string &serialized_param);
+
+	// Push a table of finished async job results onto the stack
+	void pushAsyncResults(lua_State *L);
+
 private:
 	void InitializeModApi(lua_State *L, int top);
+	static void InitializeAsync(lua_State *L, int top);
+
+	AsyncEngine asyncEngine;
 };
 
 void log_deprecated(const std::string &message);
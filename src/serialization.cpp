@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/serialize.h"
 
 #include "zlib.h"
+#include <zstd.h>
 
 /* report a zlib or i/o error */
 void zerr(int ret)
@@ -51,47 +52,138 @@ void zerr(int ret)
     }
 }
 
-void compressZlib(const u8 *data, size_t data_size, std::ostream &os, int level)
+// Cached per-thread zlib contexts, merely reset between uses; a fresh
+// deflateInit costs as much as compressing a small payload.
+
+struct ZlibDeflateCtx
 {
 	z_stream z;
+	bool initialized = false;
+	int level = Z_DEFAULT_COMPRESSION;
+
+	~ZlibDeflateCtx()
+	{
+		if (initialized)
+			deflateEnd(&z);
+	}
+};
+
+static z_stream *getZlibDeflateStream(int level)
+{
+	static thread_local ZlibDeflateCtx ctx;
+
+	if (!ctx.initialized) {
+		ctx.z.zalloc = Z_NULL;
+		ctx.z.zfree = Z_NULL;
+		ctx.z.opaque = Z_NULL;
+		if (deflateInit(&ctx.z, level) != Z_OK)
+			throw SerializationError("compressZlib: deflateInit failed");
+		ctx.initialized = true;
+		ctx.level = level;
+		return &ctx.z;
+	}
+
+	// Also discards the state of a stream an exception abandoned halfway
+	if (deflateReset(&ctx.z) != Z_OK)
+		throw SerializationError("compressZlib: deflateReset failed");
+	if (level != ctx.level) {
+		if (deflateParams(&ctx.z, level, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw SerializationError("compressZlib: deflateParams failed");
+		ctx.level = level;
+	}
+	return &ctx.z;
+}
+
+struct ZlibInflateCtx
+{
+	z_stream z;
+	bool initialized = false;
+
+	~ZlibInflateCtx()
+	{
+		if (initialized)
+			inflateEnd(&z);
+	}
+};
+
+static z_stream *getZlibInflateStream()
+{
+	static thread_local ZlibInflateCtx ctx;
+
+	if (!ctx.initialized) {
+		ctx.z.zalloc = Z_NULL;
+		ctx.z.zfree = Z_NULL;
+		ctx.z.opaque = Z_NULL;
+		if (inflateInit(&ctx.z) != Z_OK)
+			throw SerializationError("decompressZlib: inflateInit failed");
+		ctx.initialized = true;
+		return &ctx.z;
+	}
+
+	if (inflateReset(&ctx.z) != Z_OK)
+		throw SerializationError("decompressZlib: inflateReset failed");
+	return &ctx.z;
+}
+
+ZlibCompressor::ZlibCompressor(std::ostream &os, int level):
+	m_os(os),
+	m_stream(getZlibDeflateStream(level))
+{
+}
+
+void ZlibCompressor::write(const u8 *data, size_t size)
+{
 	const s32 bufsize = 16384;
 	char output_buffer[bufsize];
-	int status = 0;
-	int ret;
 
-	z.zalloc = Z_NULL;
-	z.zfree = Z_NULL;
-	z.opaque = Z_NULL;
+	m_stream->next_in = (Bytef*)data;
+	m_stream->avail_in = size;
+	while (m_stream->avail_in > 0) {
+		m_stream->next_out = (Bytef*)output_buffer;
+		m_stream->avail_out = bufsize;
 
-	ret = deflateInit(&z, level);
-	if(ret != Z_OK)
-		throw SerializationError("compressZlib: deflateInit failed");
+		int status = deflate(m_stream, Z_NO_FLUSH);
+		if (status != Z_OK) {
+			zerr(status);
+			throw SerializationError("ZlibCompressor: deflate failed");
+		}
+		int count = bufsize - m_stream->avail_out;
+		if (count)
+			m_os.write(output_buffer, count);
+	}
+}
 
-	// Point zlib to our input buffer
-	z.next_in = (Bytef*)&data[0];
-	z.avail_in = data_size;
-	// And get all output
-	for(;;)
-	{
-		z.next_out = (Bytef*)output_buffer;
-		z.avail_out = bufsize;
+void ZlibCompressor::finish()
+{
+	const s32 bufsize = 16384;
+	char output_buffer[bufsize];
 
-		status = deflate(&z, Z_FINISH);
-		if(status == Z_NEED_DICT || status == Z_DATA_ERROR
-				|| status == Z_MEM_ERROR)
-		{
+	m_stream->next_in = nullptr;
+	m_stream->avail_in = 0;
+	for (;;) {
+		m_stream->next_out = (Bytef*)output_buffer;
+		m_stream->avail_out = bufsize;
+
+		int status = deflate(m_stream, Z_FINISH);
+		if (status == Z_NEED_DICT || status == Z_DATA_ERROR
+				|| status == Z_MEM_ERROR) {
 			zerr(status);
-			throw SerializationError("compressZlib: deflate failed");
+			throw SerializationError("ZlibCompressor: deflate failed");
 		}
-		int count = bufsize - z.avail_out;
-		if(count)
-			os.write(output_buffer, count);
+		int count = bufsize - m_stream->avail_out;
+		if (count)
+			m_os.write(output_buffer, count);
 		// This determines zlib has given all output
-		if(status == Z_STREAM_END)
+		if (status == Z_STREAM_END)
 			break;
 	}
+}
 
-	deflateEnd(&z);
+void compressZlib(const u8 *data, size_t data_size, std::ostream &os, int level)
+{
+	ZlibCompressor compressor(os, level);
+	compressor.write(data, data_size);
+	compressor.finish();
 }
 
 void compressZlib(const std::string &data, std::ostream &os, int level)
@@ -99,25 +191,104 @@ void compressZlib(const std::string &data, std::ostream &os, int level)
 	compressZlib((u8*)data.c_str(), data.size(), os, level);
 }
 
+// Cached per-thread compression contexts; creating one per call would
+// dominate the cost of compressing a block.
+static ZSTD_CCtx *getZstdCCtx()
+{
+	static thread_local ZSTD_CCtx *ctx = ZSTD_createCCtx();
+	if (!ctx)
+		throw SerializationError("compressZstd: failed to create context");
+	return ctx;
+}
+
+static ZSTD_DCtx *getZstdDCtx()
+{
+	static thread_local ZSTD_DCtx *ctx = ZSTD_createDCtx();
+	if (!ctx)
+		throw SerializationError("decompressZstd: failed to create context");
+	return ctx;
+}
+
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level)
+{
+	ZSTD_CCtx *ctx = getZstdCCtx();
+	const size_t bufsize = 16384;
+	char output_buffer[bufsize];
+
+	ZSTD_CCtx_reset(ctx, ZSTD_reset_session_only);
+	ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, level);
+
+	ZSTD_inBuffer input = { data, data_size, 0 };
+
+	for (;;) {
+		ZSTD_outBuffer output = { output_buffer, bufsize, 0 };
+		size_t ret = ZSTD_compressStream2(ctx, &output, &input, ZSTD_e_end);
+		if (ZSTD_isError(ret))
+			throw SerializationError(std::string("compressZstd: ")
+					+ ZSTD_getErrorName(ret));
+		if (output.pos)
+			os.write(output_buffer, output.pos);
+		// Zero means the frame is complete and fully flushed
+		if (ret == 0)
+			break;
+	}
+}
+
+void compressZstd(const std::string &data, std::ostream &os, int level)
+{
+	compressZstd((u8*)data.c_str(), data.size(), os, level);
+}
+
+void decompressZstd(std::istream &is, std::ostream &os)
+{
+	ZSTD_DCtx *ctx = getZstdDCtx();
+	const size_t bufsize = 16384;
+	char input_buffer[bufsize];
+	char output_buffer[bufsize];
+
+	ZSTD_DCtx_reset(ctx, ZSTD_reset_session_only);
+
+	ZSTD_inBuffer input = { input_buffer, 0, 0 };
+	size_t ret;
+
+	do {
+		if (input.pos == input.size) {
+			is.read(input_buffer, bufsize);
+			input.size = is.gcount();
+			input.pos = 0;
+			if (input.size == 0)
+				throw SerializationError("decompressZstd: "
+						"unexpected end of input");
+		}
+
+		ZSTD_outBuffer output = { output_buffer, bufsize, 0 };
+		ret = ZSTD_decompressStream(ctx, &output, &input);
+		if (ZSTD_isError(ret))
+			throw SerializationError(std::string("decompressZstd: ")
+					+ ZSTD_getErrorName(ret));
+		if (output.pos)
+			os.write(output_buffer, output.pos);
+	} while (ret != 0);
+
+	// Unget all the data that the decompressor didn't take
+	is.clear(); // Just in case EOF is set
+	for (size_t i = input.size - input.pos; i > 0; i--) {
+		is.unget();
+		if (is.fail() || is.bad())
+			throw SerializationError("decompressZstd: unget failed");
+	}
+}
+
 void decompressZlib(std::istream &is, std::ostream &os)
 {
-	z_stream z;
+	z_stream &z = *getZlibInflateStream();
 	const s32 bufsize = 16384;
 	char input_buffer[bufsize];
 	char output_buffer[bufsize];
 	int status = 0;
-	int ret;
 	int bytes_read = 0;
 	int input_buffer_len = 0;
 
-	z.zalloc = Z_NULL;
-	z.zfree = Z_NULL;
-	z.opaque = Z_NULL;
-
-	ret = inflateInit(&z);
-	if(ret != Z_OK)
-		throw SerializationError("dcompressZlib: inflateInit failed");
-
 	z.avail_in = 0;
 
 	//dstream<<"initial fail="<<is.fail()<<" bad="<<is.bad()<<std::endl;
@@ -179,8 +350,6 @@ void decompressZlib(std::istream &is, std::ostream &os)
 			break;
 		}
 	}
-
-	inflateEnd(&z);
 }
 
 void compress(const SharedBuffer<u8> &data, std::ostream &os, u8 version)
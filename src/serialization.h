@@ -63,13 +63,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 	26: Never written; read the same as 25
 	27: Added light spreading flags to blocks
 	28: Added "private" flag to NodeMetadata
+	29: Per-block content palette and run-length encoded bulk node data
 */
 // This represents an uninitialized or invalid format
 #define SER_FMT_VER_INVALID 255
 // Highest supported serialization version
-#define SER_FMT_VER_HIGHEST_READ 28
+#define SER_FMT_VER_HIGHEST_READ 29
 // Saved on disk version
-#define SER_FMT_VER_HIGHEST_WRITE 28
+#define SER_FMT_VER_HIGHEST_WRITE 29
 // Lowest supported serialization version
 #define SER_FMT_VER_LOWEST_READ 0
 // Lowest serialization version for writing
@@ -89,6 +90,42 @@ void compressZlib(const u8 *data, size_t data_size, std::ostream &os, int level
 void compressZlib(const std::string &data, std::ostream &os, int level = -1);
 void decompressZlib(std::istream &is, std::ostream &os);
 
+struct z_stream_s;
+
+/*
+	Compresses any number of buffers into a single zlib stream.
+	compressZlib() is a one-buffer wrapper around this; use the class
+	directly when concatenating several payloads, so the setup cost is
+	paid once per stream instead of once per piece.
+
+	The underlying deflate context is cached per thread, so only one
+	ZlibCompressor may be active per thread at a time. The stream is not
+	valid until finish() has been called.
+*/
+class ZlibCompressor
+{
+public:
+	ZlibCompressor(std::ostream &os, int level = -1);
+
+	void write(const u8 *data, size_t size);
+	void write(const std::string &data)
+	{
+		write((const u8 *)data.c_str(), data.size());
+	}
+	// Flushes pending output and ends the zlib stream
+	void finish();
+
+private:
+	std::ostream &m_os;
+	z_stream_s *m_stream;
+};
+
+// Zstd, used for bulk node data from serialization version 29 on.
+// level = 0 selects the zstd default.
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 0);
+void compressZstd(const std::string &data, std::ostream &os, int level = 0);
+void decompressZstd(std::istream &is, std::ostream &os);
+
 // These choose between zlib and a self-made one according to version
 void compress(const SharedBuffer<u8> &data, std::ostream &os, u8 version);
 //void compress(const std::string &data, std::ostream &os, u8 version);
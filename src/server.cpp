@@ -21,6 +21,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <iostream>
 #include <queue>
 #include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <cstring>
+#include <unordered_map>
 #include "network/connection.h"
 #include "network/networkprotocol.h"
 #include "network/serveropcodes.h"
@@ -38,6 +43,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "genericobject.h"
 #include "settings.h"
 #include "profiler.h"
+#include "metrics.h"
+#include "network/sessionlog.h"
 #include "log.h"
 #include "scripting_server.h"
 #include "nodedef.h"
@@ -54,6 +61,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serverlist.h"
 #include "util/string.h"
 #include "rollback.h"
+#include "util/memstats.h"
+#include "util/numeric.h"
+#include "util/tunables.h"
 #include "util/serialize.h"
 #include "util/thread.h"
 #include "defaultsettings.h"
@@ -65,6 +75,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "chatmessage.h"
 #include "chat_interface.h"
 #include "remoteplayer.h"
+#include "porting.h"
 
 class ClientNotFoundException : public BaseException
 {
@@ -243,7 +254,7 @@ Server::~Server()
 			L"*** Server shutting down"));
 
 	if (m_env) {
-		MutexAutoLock envlock(m_env_mutex);
+		SharedMutexWriteLock envlock(m_env_mutex);
 
 		infostream << "Server: Saving players" << std::endl;
 		m_env->saveLoadedPlayers();
@@ -273,7 +284,7 @@ Server::~Server()
 		m_emerge->stopThreads();
 
 	if (m_env) {
-		MutexAutoLock envlock(m_env_mutex);
+		SharedMutexWriteLock envlock(m_env_mutex);
 
 		// Execute script shutdown hooks
 		infostream << "Executing shutdown hooks" << std::endl;
@@ -292,6 +303,11 @@ Server::~Server()
 	// Delete things in the reverse order of creation
 	delete m_emerge;
 	delete m_env;
+
+	// The final metadata saves above (and the map metadata written by the
+	// map destructor just now) were queued on the shared writer thread;
+	// make sure they are on disk before tearing down any further
+	fs::flushAsyncWrites();
 	delete m_rollback;
 	delete m_banmanager;
 	delete m_itemdef;
@@ -307,10 +323,6 @@ Server::~Server()
 		delete detached_inventory.second;
 	}
 
-	while (!m_unsent_map_edit_queue.empty()) {
-		delete m_unsent_map_edit_queue.front();
-		m_unsent_map_edit_queue.pop();
-	}
 }
 
 void Server::init()
@@ -342,11 +354,17 @@ void Server::init()
 	}
 
 	//lock environment
-	MutexAutoLock envlock(m_env_mutex);
+	SharedMutexWriteLock envlock(m_env_mutex);
 
 	// Create the Map (loads map_meta.txt, overriding configured mapgen params)
 	ServerMap *servermap = new ServerMap(m_path_world, this, m_emerge);
 
+	if (g_settings->getBool("map_save_async"))
+		servermap->startSaveThread();
+
+	if (g_settings->getBool("map_prefetch"))
+		servermap->startPrefetchThread();
+
 	// Initialize scripting
 	infostream << "Server: Initializing Lua" << std::endl;
 
@@ -405,6 +423,7 @@ void Server::init()
 	m_env->loadMeta();
 
 	m_liquid_transform_every = g_settings->getFloat("liquid_update");
+	m_tick_budget_ms = (u64)(g_settings->getFloat("dedicated_server_step") * 1000.0f);
 	m_max_chatmessage_length = g_settings->getU16("chat_message_max_size");
 	m_csm_restriction_flags = g_settings->getU64("csm_restriction_flags");
 	m_csm_restriction_noderange = g_settings->getU32("csm_restriction_noderange");
@@ -425,6 +444,19 @@ void Server::start()
 	// Start thread
 	m_thread->start();
 
+	// Start the metrics listener if enabled
+	u16 metrics_port = g_settings->getU16("metrics_port");
+	if (metrics_port != 0 && !m_metrics_thread) {
+		m_metrics_thread = new MetricsServerThread(
+				g_settings->get("metrics_address"), metrics_port);
+		m_metrics_thread->start();
+	}
+
+	// Record the inbound packet stream if requested
+	std::string record_path = g_settings->get("session_record_path");
+	if (!record_path.empty())
+		m_con->startRecording(record_path);
+
 	// ASCII art for the win!
 	std::cerr
 		<< "        .__               __                   __   " << std::endl
@@ -450,6 +482,13 @@ void Server::stop()
 	//m_emergethread.stop();
 
 	infostream<<"Server: Threads stopped"<<std::endl;
+
+	if (m_metrics_thread) {
+		m_metrics_thread->stop();
+		m_metrics_thread->wait();
+		delete m_metrics_thread;
+		m_metrics_thread = nullptr;
+	}
 }
 
 void Server::step(float dtime)
@@ -473,6 +512,10 @@ void Server::step(float dtime)
 	}
 }
 
+// Coalesced node edits per block and tick above which the per-node sends
+// are dropped in favor of resending the block whole
+#define MAX_SINGLE_EDITS_PER_BLOCK 8
+
 void Server::AsyncRunStep(bool initial_step)
 {
 
@@ -492,6 +535,11 @@ void Server::AsyncRunStep(bool initial_step)
 
 	ScopeProfiler sp(g_profiler, "Server::AsyncRunStep()", SPT_AVG);
 
+	// Deadline for deferrable subtasks: once the tick has used up most of
+	// its budget, saves, unloads and liquid updates are pushed to a later
+	// tick instead of overshooting the step time even further.
+	const u64 step_start_ms = porting::getTimeMs();
+
 	{
 		MutexAutoLock lock1(m_step_dtime_mutex);
 		m_step_dtime -= dtime;
@@ -524,7 +572,7 @@ void Server::AsyncRunStep(bool initial_step)
 	}
 
 	{
-		MutexAutoLock lock(m_env_mutex);
+		SharedMutexWriteLock lock(m_env_mutex);
 		// Figure out and report maximum lag to environment
 		float max_lag = m_env->getMaxLagEstimate();
 		max_lag *= 0.9998; // Decrease slowly (about half per 5 minutes)
@@ -536,18 +584,115 @@ void Server::AsyncRunStep(bool initial_step)
 		}
 		m_env->reportMaxLagEstimate(max_lag);
 		// Step environment
+		u64 step_begin_us = porting::getTimeUs();
 		m_env->step(dtime);
+		g_metrics->observe("minetest_env_step_seconds",
+				"Environment step duration",
+				(porting::getTimeUs() - step_begin_us) / 1e6);
+
+		// Finalize chunks the emerge threads have generated since the
+		// last tick (emerge pipeline)
+		m_emerge->finalizeCompletedChunks();
+
+		// Refresh the player positions that prioritize the emerge queues
+		// and publish the lock-free player snapshot for this tick
+		std::vector<v3s16> peer_block_positions;
+		std::unordered_set<session_t> active_peers;
+		std::vector<PlayerSnapshot> player_snapshot;
+		for (const session_t peer_id : m_clients.getClientIDs()) {
+			active_peers.insert(peer_id);
+			PlayerSAO *playersao = getPlayerSAO(peer_id);
+			if (!playersao)
+				continue;
+			v3f position = playersao->getBasePosition();
+			peer_block_positions.push_back(getNodeBlockPos(
+				floatToInt(position, BS)));
+			RemotePlayer *player = m_env->getPlayer(peer_id);
+			player_snapshot.push_back({peer_id,
+				player ? std::string(player->getName()) : "", position});
+		}
+		m_emerge->updatePlayerPositions(peer_block_positions, active_peers);
+		std::atomic_store(&m_player_snapshot,
+			std::shared_ptr<const std::vector<PlayerSnapshot>>(
+				std::make_shared<const std::vector<PlayerSnapshot>>(
+					std::move(player_snapshot))));
+
+		// Refresh the slow-moving metrics once per second
+		if (m_metrics_interval.step(dtime, 1.0f)) {
+			g_metrics->setGauge("minetest_players",
+					"Number of connected players",
+					m_env->getPlayerCount());
+			g_metrics->setGauge("minetest_active_objects",
+					"Number of active server objects",
+					m_env->getActiveObjectsCount());
+			g_metrics->setGauge("minetest_emerge_queue_depth",
+					"Number of blocks queued for emerging",
+					m_emerge->getQueuedCount());
+
+			u64 bytes, packets;
+			m_con->m_tx_pkt_stats.getTotals(&bytes, &packets);
+			g_metrics->setCounter("minetest_network_tx_bytes_total",
+					"Bytes sent over the network", bytes);
+			g_metrics->setCounter("minetest_network_tx_packets_total",
+					"Packets sent over the network", packets);
+			m_con->m_rx_pkt_stats.getTotals(&bytes, &packets);
+			g_metrics->setCounter("minetest_network_rx_bytes_total",
+					"Bytes received over the network", bytes);
+			g_metrics->setCounter("minetest_network_rx_packets_total",
+					"Packets received over the network", packets);
+
+			// The Lua heap can only be sampled, not hooked
+			static MemoryPool *lua_pool =
+					g_memstats->registerPool("lua_heap");
+			lua_pool->set((u64) m_script->getMemoryUsageKB() * 1024);
+
+			for (const MemoryStats::PoolInfo &info : g_memstats->getAll()) {
+				g_profiler->avg("Memory: " + info.name + " [MiB]",
+						(float) info.current / (1024.0f * 1024.0f));
+				g_metrics->setGauge("minetest_memory_" + info.name + "_bytes",
+						"Bytes accounted to the " + info.name + " pool",
+						info.current);
+			}
+		}
 	}
 
 	static const float map_timer_and_unload_dtime = 2.92;
-	if(m_map_timer_and_unload_interval.step(dtime, map_timer_and_unload_dtime))
+	if(tickDeadlineAllows(step_start_ms, m_map_timer_deferrals) &&
+			m_map_timer_and_unload_interval.step(dtime, map_timer_and_unload_dtime))
 	{
-		MutexAutoLock lock(m_env_mutex);
+		SharedMutexWriteLock lock(m_env_mutex);
 		// Run Map's timers and unload unused data
 		ScopeProfiler sp(g_profiler, "Server: map timer and unload");
 		m_env->getMap().timerUpdate(map_timer_and_unload_dtime,
 			g_settings->getFloat("server_unload_unused_data_timeout"),
 			U32_MAX);
+
+		// On top of the timeout rule, enforce the configured memory
+		// budget so exploration cannot grow the map cache without bound
+		static TunableInt *tune_map_memory_budget = g_tunables->registerInt(
+				"server_map_memory_budget",
+				g_settings->getU32("server_map_memory_budget"), 0, 1048576,
+				"Map cache memory budget in MiB (0 = no budget)");
+		u64 budget_mb = tune_map_memory_budget->get();
+		if (budget_mb > 0) {
+			std::vector<v3s16> player_block_positions;
+			for (session_t peer_id : m_clients.getClientIDs()) {
+				PlayerSAO *playersao = getPlayerSAO(peer_id);
+				if (playersao)
+					player_block_positions.push_back(getNodeBlockPos(
+						floatToInt(playersao->getBasePosition(), BS)));
+			}
+			// Active blocks (which include forceloaded ones once the
+			// active block list has been updated) must survive the
+			// budget; merge in the live forceloaded list too, since it
+			// may have changed since that update
+			std::set<v3s16> keep_blocks = *m_env->getActiveBlocks();
+			const std::set<v3s16> *forceloaded = m_env->getForceloadedBlocks();
+			keep_blocks.insert(forceloaded->begin(), forceloaded->end());
+			m_env->getMap().evictBlocksOverBudget(
+					budget_mb * 1024 * 1024, player_block_positions,
+					&keep_blocks);
+		}
 	}
 
 	/*
@@ -555,7 +700,7 @@ void Server::AsyncRunStep(bool initial_step)
 	*/
 	if (m_admin_chat) {
 		if (!m_admin_chat->command_queue.empty()) {
-			MutexAutoLock lock(m_env_mutex);
+			SharedMutexWriteLock lock(m_env_mutex);
 			while (!m_admin_chat->command_queue.empty()) {
 				ChatEvent *evt = m_admin_chat->command_queue.pop_frontNoEx();
 				handleChatInterfaceEvent(evt);
@@ -572,14 +717,22 @@ void Server::AsyncRunStep(bool initial_step)
 
 	/* Transform liquids */
 	m_liquid_transform_timer += dtime;
-	if(m_liquid_transform_timer >= m_liquid_transform_every)
+	if(m_liquid_transform_timer >= m_liquid_transform_every &&
+			tickDeadlineAllows(step_start_ms, m_liquid_transform_deferrals))
 	{
 		m_liquid_transform_timer -= m_liquid_transform_every;
 
-		MutexAutoLock lock(m_env_mutex);
+		SharedMutexWriteLock lock(m_env_mutex);
 
 		ScopeProfiler sp(g_profiler, "Server: liquid transform");
 
+		// Refresh the player positions that prioritize the liquid queue
+		// (the tick-old snapshot is plenty accurate for prioritization)
+		std::vector<v3s16> player_positions;
+		for (const PlayerSnapshot &player : *getPlayerSnapshot())
+			player_positions.push_back(floatToInt(player.position, BS));
+		m_env->getMap().transforming_liquid_set_players(player_positions);
+
 		std::map<v3s16, MapBlock*> modified_blocks;
 		m_env->getMap().transformLiquids(modified_blocks, m_env);
 
@@ -621,14 +774,14 @@ void Server::AsyncRunStep(bool initial_step)
 	*/
 	{
 		//infostream<<"Server: Checking added and deleted active objects"<<std::endl;
-		MutexAutoLock envlock(m_env_mutex);
+		SharedMutexWriteLock envlock(m_env_mutex);
 
 		m_clients.lock();
 		const RemoteClientMap &clients = m_clients.getClientList();
 		ScopeProfiler sp(g_profiler, "Server: update objects within range");
 
 		for (const auto &client_it : clients) {
-			RemoteClient *client = client_it.second;
+			RemoteClient *client = client_it.second.get();
 
 			if (client->getState() < CS_DefinitionsSent)
 				continue;
@@ -663,7 +816,7 @@ void Server::AsyncRunStep(bool initial_step)
 		Send object messages
 	*/
 	{
-		MutexAutoLock envlock(m_env_mutex);
+		SharedMutexWriteLock envlock(m_env_mutex);
 		ScopeProfiler sp(g_profiler, "Server: send SAO messages");
 
 		// Key = object id
@@ -686,14 +839,14 @@ void Server::AsyncRunStep(bool initial_step)
 			else {
 				message_list = n->second;
 			}
-			message_list->push_back(aom);
+			message_list->push_back(std::move(aom));
 		}
 
 		m_clients.lock();
 		const RemoteClientMap &clients = m_clients.getClientList();
 		// Route data to every client
 		for (const auto &client_it : clients) {
-			RemoteClient *client = client_it.second;
+			RemoteClient *client = client_it.second.get();
 			PlayerSAO *player = getPlayerSAO(client->peer_id);
 			std::string reliable_data;
 			std::string unreliable_data;
@@ -709,8 +862,20 @@ void Server::AsyncRunStep(bool initial_step)
 				std::vector<ActiveObjectMessage>* list = buffered_message.second;
 				// Go through every message
 				for (const ActiveObjectMessage &aom : *list) {
+					const u8 aom_cmd = aom.datastring[0];
 					// Send position updates to players who do not see the attachment
-					if (aom.datastring[0] == GENERIC_CMD_UPDATE_POSITION) {
+					if (aom_cmd == GENERIC_CMD_UPDATE_POSITION ||
+							aom_cmd == GENERIC_CMD_UPDATE_POSITION_KEYFRAME ||
+							aom_cmd == GENERIC_CMD_UPDATE_POSITION_DELTA) {
+						// Objects queue both encodings; pick the one the
+						// client's protocol version understands
+						if (aom_cmd == GENERIC_CMD_UPDATE_POSITION) {
+							if (client->net_proto_version >= 41)
+								continue;
+						} else if (client->net_proto_version < 41) {
+							continue;
+						}
+
 						if (sao->getId() == player->getId())
 							continue;
 
@@ -721,19 +886,12 @@ void Server::AsyncRunStep(bool initial_step)
 								client->m_known_objects.end())
 							continue;
 					}
-					// Compose the full new data with header
-					std::string new_data;
-					// Add object id
-					char buf[2];
-					writeU16((u8*)&buf[0], aom.id);
-					new_data.append(buf, 2);
-					// Add data
-					new_data += serializeString(aom.datastring);
-					// Add data to buffer
-					if (aom.reliable)
-						reliable_data += new_data;
-					else
-						unreliable_data += new_data;
+					// Append object id + length-prefixed data straight
+					// onto the send buffer
+					std::string &buffer = aom.reliable ?
+						reliable_data : unreliable_data;
+					putU16(buffer, aom.id);
+					putString(buffer, aom.datastring);
 				}
 			}
 			/*
@@ -761,72 +919,57 @@ void Server::AsyncRunStep(bool initial_step)
 	*/
 	{
 		// We will be accessing the environment
-		MutexAutoLock lock(m_env_mutex);
-
-		// Don't send too many at a time
-		//u32 count = 0;
+		SharedMutexWriteLock lock(m_env_mutex);
 
 		// Single change sending is disabled if queue size is not small
-		bool disable_single_change_sending = false;
-		if(m_unsent_map_edit_queue.size() >= 4)
-			disable_single_change_sending = true;
+		bool disable_single_change_sending = m_unsent_node_edits.size() >= 4;
 
-		int event_count = m_unsent_map_edit_queue.size();
+		int event_count = m_unsent_node_edits.size() +
+			m_unsent_meta_updates.size() +
+			(m_unsent_other_blocks.empty() ? 0 : 1);
 
 		// We'll log the amount of each
 		Profiler prof;
 
 		std::list<v3s16> node_meta_updates;
 
-		while (!m_unsent_map_edit_queue.empty()) {
-			MapEditEvent* event = m_unsent_map_edit_queue.front();
-			m_unsent_map_edit_queue.pop();
+		// Blocks edited so many times this tick that sending every node
+		// change individually would cost more than resending the block
+		std::map<v3s16, u32> edits_per_block;
+		for (const auto &it : m_unsent_node_edits)
+			edits_per_block[getNodeBlockPos(it.first)]++;
+
+		for (const auto &it : m_unsent_node_edits) {
+			const MapEditEvent &event = it.second;
+
+			if (edits_per_block[getNodeBlockPos(it.first)] >
+					MAX_SINGLE_EDITS_PER_BLOCK) {
+				// Collapse into a whole-block resend below
+				prof.add("collapsed into block resend", 1);
+				m_unsent_other_blocks.insert(event.modified_blocks.begin(),
+					event.modified_blocks.end());
+				continue;
+			}
 
 			// Players far away from the change are stored here.
 			// Instead of sending the changes, MapBlocks are set not sent
 			// for them.
 			std::unordered_set<u16> far_players;
 
-			switch (event->type) {
+			switch (event.type) {
 			case MEET_ADDNODE:
 			case MEET_SWAPNODE:
 				prof.add("MEET_ADDNODE", 1);
-				sendAddNode(event->p, event->n, &far_players,
+				sendAddNode(event.p, event.n, &far_players,
 						disable_single_change_sending ? 5 : 30,
-						event->type == MEET_ADDNODE);
+						event.type == MEET_ADDNODE);
 				break;
 			case MEET_REMOVENODE:
 				prof.add("MEET_REMOVENODE", 1);
-				sendRemoveNode(event->p, &far_players,
+				sendRemoveNode(event.p, &far_players,
 						disable_single_change_sending ? 5 : 30);
 				break;
-			case MEET_BLOCK_NODE_METADATA_CHANGED: {
-				verbosestream << "Server: MEET_BLOCK_NODE_METADATA_CHANGED" << std::endl;
-				prof.add("MEET_BLOCK_NODE_METADATA_CHANGED", 1);
-				if (!event->is_private_change) {
-					// Don't send the change yet. Collect them to eliminate dupes.
-					node_meta_updates.remove(event->p);
-					node_meta_updates.push_back(event->p);
-				}
-
-				if (MapBlock *block = m_env->getMap().getBlockNoCreateNoEx(
-						getNodeBlockPos(event->p))) {
-					block->raiseModified(MOD_STATE_WRITE_NEEDED,
-						MOD_REASON_REPORT_META_CHANGE);
-				}
-				break;
-			}
-			case MEET_OTHER:
-				infostream << "Server: MEET_OTHER" << std::endl;
-				prof.add("MEET_OTHER", 1);
-				for (const v3s16 &modified_block : event->modified_blocks) {
-					m_clients.markBlockposAsNotSent(modified_block);
-				}
-				break;
 			default:
-				prof.add("unknown", 1);
-				warningstream << "Server: Unknown MapEditEvent "
-						<< ((u32)event->type) << std::endl;
 				break;
 			}
 
@@ -836,7 +979,7 @@ void Server::AsyncRunStep(bool initial_step)
 			if (!far_players.empty()) {
 				// Convert list format to that wanted by SetBlocksNotSent
 				std::map<v3s16, MapBlock*> modified_blocks2;
-				for (const v3s16 &modified_block : event->modified_blocks) {
+				for (const v3s16 &modified_block : event.modified_blocks) {
 					modified_blocks2[modified_block] =
 							m_env->getMap().getBlockNoCreateNoEx(modified_block);
 				}
@@ -847,8 +990,26 @@ void Server::AsyncRunStep(bool initial_step)
 						client->SetBlocksNotSent(modified_blocks2);
 				}
 			}
+		}
+		m_unsent_node_edits.clear();
 
-			delete event;
+		for (const auto &it : m_unsent_meta_updates) {
+			prof.add("MEET_BLOCK_NODE_METADATA_CHANGED", 1);
+			if (!it.second) // not a private change
+				node_meta_updates.push_back(it.first);
+
+			if (MapBlock *block = m_env->getMap().getBlockNoCreateNoEx(
+					getNodeBlockPos(it.first))) {
+				block->raiseModified(MOD_STATE_WRITE_NEEDED,
+					MOD_REASON_REPORT_META_CHANGE);
+			}
+		}
+		m_unsent_meta_updates.clear();
+
+		if (!m_unsent_other_blocks.empty()) {
+			prof.add("MEET_OTHER", 1);
+			m_clients.markBlockposAsNotSent(m_unsent_other_blocks);
+			m_unsent_other_blocks.clear();
 		}
 
 		if (event_count >= 5) {
@@ -864,6 +1025,9 @@ void Server::AsyncRunStep(bool initial_step)
 			sendMetadataChanged(node_meta_updates);
 	}
 
+	// Flush mod channel messages queued this tick as combined packets
+	sendQueuedModChannelMessages();
+
 	/*
 		Trigger emergethread (it somehow gets to a non-triggered but
 		bysy state sometimes)
@@ -884,16 +1048,15 @@ void Server::AsyncRunStep(bool initial_step)
 		counter += dtime;
 		static thread_local const float save_interval =
 			g_settings->getFloat("server_map_save_interval");
-		if (counter >= save_interval) {
+		if (counter >= save_interval &&
+				tickDeadlineAllows(step_start_ms, m_savemap_deferrals)) {
 			counter = 0.0;
-			MutexAutoLock lock(m_env_mutex);
+			SharedMutexWriteLock lock(m_env_mutex);
 
 			ScopeProfiler sp(g_profiler, "Server: map saving (sum)");
 
-			// Save ban file
-			if (m_banmanager->isModified()) {
-				m_banmanager->save();
-			}
+			// Write the ban file on the ban manager's own thread
+			m_banmanager->deferSave();
 
 			// Save changed parts of map
 			m_env->getMap().save(MOD_STATE_WRITE_NEEDED);
@@ -909,6 +1072,23 @@ void Server::AsyncRunStep(bool initial_step)
 	m_shutdown_state.tick(dtime, this);
 }
 
+bool Server::tickDeadlineAllows(u64 start_ms, u8 &deferrals)
+{
+	// Never defer more than a few consecutive ticks; the work is merely
+	// delayed, not dropped, since the callers keep their timer state.
+	if (deferrals >= 3) {
+		deferrals = 0;
+		return true;
+	}
+	if (porting::getTimeMs() - start_ms >= m_tick_budget_ms) {
+		deferrals++;
+		g_profiler->add("Server: deferred subtasks [#]", 1);
+		return false;
+	}
+	deferrals = 0;
+	return true;
+}
+
 void Server::Receive()
 {
 	session_t peer_id = 0;
@@ -1020,7 +1200,7 @@ inline void Server::handleCommand(NetworkPacket *pkt)
 void Server::ProcessData(NetworkPacket *pkt)
 {
 	// Environment is locked first.
-	MutexAutoLock envlock(m_env_mutex);
+	SharedMutexWriteLock envlock(m_env_mutex);
 
 	ScopeProfiler sp(g_profiler, "Server: Process network packet (sum)");
 	u32 peer_id = pkt->getPeerId();
@@ -1114,7 +1294,37 @@ void Server::onMapEditEvent(const MapEditEvent &event)
 	if (m_ignore_map_edit_events_area.contains(event.getArea()))
 		return;
 
-	m_unsent_map_edit_queue.push(new MapEditEvent(event));
+	switch (event.type) {
+	case MEET_ADDNODE:
+	case MEET_REMOVENODE:
+	case MEET_SWAPNODE: {
+		// Last writer wins per node; the touched blocks are unioned in
+		// case an earlier edit updated lighting further away
+		MapEditEvent &queued = m_unsent_node_edits[event.p];
+		queued.type = event.type;
+		queued.p = event.p;
+		queued.n = event.n;
+		queued.modified_blocks.insert(event.modified_blocks.begin(),
+			event.modified_blocks.end());
+		break;
+	}
+	case MEET_BLOCK_NODE_METADATA_CHANGED: {
+		auto it = m_unsent_meta_updates.find(event.p);
+		if (it == m_unsent_meta_updates.end())
+			m_unsent_meta_updates[event.p] = event.is_private_change;
+		else
+			it->second = it->second && event.is_private_change;
+		break;
+	}
+	case MEET_OTHER:
+		m_unsent_other_blocks.insert(event.modified_blocks.begin(),
+			event.modified_blocks.end());
+		break;
+	default:
+		warningstream << "Server: Unknown MapEditEvent "
+				<< ((u32)event.type) << std::endl;
+		break;
+	}
 }
 
 Inventory* Server::getInventory(const InventoryLocation &loc)
@@ -1464,6 +1674,7 @@ void Server::SendInventory(PlayerSAO *sao, bool incremental)
 	sao->getInventory()->serialize(os, incremental);
 	sao->getInventory()->setModified(false);
 	player->setModified(true);
+	player->setInventoryModified(true);
 
 	const std::string &s = os.str();
 	pkt.putRawString(s.c_str(), s.size());
@@ -1749,9 +1960,8 @@ void Server::SendPlayerHP(session_t peer_id)
 	m_script->player_event(playersao,"health_changed");
 
 	// Send to other clients
-	std::string str = gob_cmd_punched(playersao->getHP());
-	ActiveObjectMessage aom(playersao->getId(), true, str);
-	playersao->m_messages_out.push(aom);
+	playersao->m_messages_out.push(ActiveObjectMessage(playersao->getId(),
+		true, gob_cmd_punched(playersao->getHP())));
 }
 
 void Server::SendPlayerBreath(PlayerSAO *sao)
@@ -2229,6 +2439,9 @@ void Server::sendMetadataChanged(const std::list<v3s16> &meta_updates, float far
 			if (!client->isBlockSent(block_pos) || (player &&
 					player_pos.getDistanceFrom(intToFloat(pos, BS)) > maxd)) {
 				client->SetBlockNotSent(block_pos);
+				// A delta can't carry the changed metadata, the full
+				// block has to be sent
+				client->resetBlockSyncCounter(block_pos);
 				continue;
 			}
 
@@ -2273,10 +2486,50 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 	Send(&pkt);
 }
 
+void Server::SendBlocksBatchedNoLock(session_t peer_id,
+		std::vector<std::pair<v3s16, std::string>> &blocks)
+{
+	u32 payload_size = 2;
+	for (const auto &b : blocks)
+		payload_size += 6 + 4 + b.second.size();
+
+	NetworkPacket pkt(TOCLIENT_BLOCKDATAS, payload_size, peer_id);
+
+	pkt << (u16) blocks.size();
+	for (const auto &b : blocks) {
+		pkt << b.first;
+		pkt.putLongString(b.second);
+	}
+	Send(&pkt);
+}
+
+void Server::SendBlockDeltaNoLock(session_t peer_id, MapBlock *block,
+		const std::vector<u16> &indices)
+{
+	NetworkPacket pkt(TOCLIENT_BLOCK_DELTA, 6 + 2 + indices.size() * 6,
+			peer_id);
+
+	pkt << block->getPos();
+	pkt << (u16) indices.size();
+
+	for (u16 index : indices) {
+		v3s16 rel(index % MAP_BLOCKSIZE,
+				(index / MapBlock::ystride) % MAP_BLOCKSIZE,
+				index / MapBlock::zstride);
+		bool pos_ok;
+		MapNode n = block->getNodeNoCheck(rel, &pos_ok);
+		pkt << index << n.param0 << n.param1 << n.param2;
+	}
+	Send(&pkt);
+}
+
 void Server::SendBlocks(float dtime)
 {
-	MutexAutoLock envlock(m_env_mutex);
-	//TODO check if one big lock could be faster then multiple small ones
+	// Block sending only reads the environment (block contents, player
+	// positions); per-client bookkeeping is behind the m_clients lock and
+	// the block usage timers it refreshes are only ever touched from this
+	// thread. A read lock keeps it from serializing against other readers.
+	SharedMutexReadLock envlock(m_env_mutex);
 
 	std::vector<PrioritySortedBlockTransfer> queue;
 
@@ -2315,6 +2568,18 @@ void Server::SendBlocks(float dtime)
 	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
 	Map &map = m_env->getMap();
 
+	// Blocks for clients that understand TOCLIENT_BLOCKDATAS are packed
+	// into combined packets instead of one packet per block, cutting the
+	// per-packet overhead during join-time streaming.
+	const size_t batch_max_blocks = 16;
+	const size_t batch_max_bytes = 64 * 1024;
+	struct BlockBatch
+	{
+		std::vector<std::pair<v3s16, std::string>> blocks;
+		size_t bytes = 0;
+	};
+	std::unordered_map<session_t, BlockBatch> batches;
+
 	for (const PrioritySortedBlockTransfer &block_to_send : queue) {
 		if (total_sending >= max_blocks_to_send)
 			break;
@@ -2328,12 +2593,49 @@ void Server::SendBlocks(float dtime)
 		if (!client)
 			continue;
 
-		SendBlockNoLock(block_to_send.peer_id, block, client->serialization_version,
-				client->net_proto_version);
+		// If the client already has an older version of this block, send
+		// only the nodes changed since then instead of the full block.
+		u32 synced_counter;
+		std::vector<u16> changed_indices;
+		bool delta_sent = false;
+		if (client->net_proto_version >= 40 &&
+				client->getBlockSyncCounter(block_to_send.pos, &synced_counter) &&
+				block->getChangedNodesSince(synced_counter, changed_indices)) {
+			SendBlockDeltaNoLock(block_to_send.peer_id, block, changed_indices);
+			delta_sent = true;
+		} else if (client->net_proto_version >= 39) {
+			std::ostringstream os(std::ios_base::binary);
+			block->serialize(os, client->serialization_version, false);
+			block->serializeNetworkSpecific(os);
+
+			BlockBatch &batch = batches[block_to_send.peer_id];
+			batch.blocks.emplace_back(block_to_send.pos, os.str());
+			batch.bytes += batch.blocks.back().second.size();
+			if (batch.blocks.size() >= batch_max_blocks ||
+					batch.bytes >= batch_max_bytes) {
+				SendBlocksBatchedNoLock(block_to_send.peer_id, batch.blocks);
+				batch.blocks.clear();
+				batch.bytes = 0;
+			}
+		} else {
+			SendBlockNoLock(block_to_send.peer_id, block,
+					client->serialization_version, client->net_proto_version);
+		}
+
+		g_profiler->add(delta_sent ? "Server: blocks sent as delta"
+				: "Server: blocks sent in full", 1);
 
 		client->SentBlock(block_to_send.pos);
+		if (client->net_proto_version >= 40)
+			client->setBlockSyncCounter(block_to_send.pos,
+					block->getChangeCounter());
 		total_sending++;
 	}
+
+	for (auto &it : batches) {
+		if (!it.second.blocks.empty())
+			SendBlocksBatchedNoLock(it.first, it.second.blocks);
+	}
 	m_clients.unlock();
 }
 
@@ -2356,6 +2658,63 @@ bool Server::SendBlock(session_t peer_id, const v3s16 &blockpos)
 	return true;
 }
 
+/*
+	Persistent media hash index
+
+	Stores the SHA1 of every media file together with its size and
+	modification time, so warm restarts only hash files that changed.
+
+	Format (text, one file per line after the header):
+		MTMEDIAINDEX 1
+		<size> <mtime> <sha1_base64> <filepath>
+*/
+
+struct MediaIndexEntry
+{
+	long long size;
+	long long mtime;
+	std::string sha1_base64;
+};
+
+static void loadMediaIndex(const std::string &index_path,
+		std::unordered_map<std::string, MediaIndexEntry> &index)
+{
+	std::ifstream is(index_path.c_str());
+	if (!is.good())
+		return;
+
+	std::string line;
+	if (!std::getline(is, line) || line != "MTMEDIAINDEX 1")
+		return;
+
+	while (std::getline(is, line)) {
+		std::istringstream iss(line);
+		MediaIndexEntry entry;
+		std::string filepath;
+		if (!(iss >> entry.size >> entry.mtime >> entry.sha1_base64))
+			continue;
+		iss.get(); // the separating space
+		if (!std::getline(iss, filepath) || filepath.empty())
+			continue;
+		index[filepath] = entry;
+	}
+}
+
+static void saveMediaIndex(const std::string &index_path,
+		const std::unordered_map<std::string, MediaIndexEntry> &index)
+{
+	std::ostringstream os;
+	os << "MTMEDIAINDEX 1\n";
+	for (const auto &it : index) {
+		const MediaIndexEntry &entry = it.second;
+		os << entry.size << ' ' << entry.mtime << ' '
+			<< entry.sha1_base64 << ' ' << it.first << '\n';
+	}
+	if (!fs::safeWriteToFile(index_path, os.str()))
+		warningstream << "Server: Could not write media hash index to "
+				<< index_path << std::endl;
+}
+
 void Server::fillMediaCache()
 {
 	infostream<<"Server: Calculating media file checksums"<<std::endl;
@@ -2366,6 +2725,25 @@ void Server::fillMediaCache()
 	fs::GetRecursiveDirs(paths, m_gamespec.path + DIR_DELIM + "textures");
 	fs::GetRecursiveDirs(paths, porting::path_user + DIR_DELIM + "textures" + DIR_DELIM + "server");
 
+	// Load the persistent hash index; files with unchanged size and
+	// mtime reuse their stored hash instead of being re-read
+	std::string index_path = porting::path_cache + DIR_DELIM +
+			"server_media_index.txt";
+	std::unordered_map<std::string, MediaIndexEntry> index;
+	loadMediaIndex(index_path, index);
+	std::unordered_map<std::string, MediaIndexEntry> new_index;
+
+	struct HashTask {
+		std::string filename;
+		std::string filepath;
+		long long size;
+		long long mtime;
+		bool indexable;
+		std::string sha1_base64; // Filled by the workers; empty = failed
+		std::string sha1_hex;
+	};
+	std::vector<HashTask> tasks;
+
 	// Collect media file information from paths into cache
 	for (const std::string &mediapath : paths) {
 		std::vector<fs::DirListNode> dirlist = fs::GetDirListing(mediapath);
@@ -2394,15 +2772,45 @@ void Server::fillMediaCache()
 						<< filename << "\"" << std::endl;
 				continue;
 			}
-			// Ok, attempt to load the file and add to cache
+			// Ok, the file is interesting
 			std::string filepath;
 			filepath.append(mediapath).append(DIR_DELIM).append(filename);
 
+			HashTask task;
+			task.filename = filename;
+			task.filepath = filepath;
+			task.indexable = fs::GetFileSizeAndMTime(filepath,
+					&task.size, &task.mtime);
+
+			if (task.indexable) {
+				auto it = index.find(filepath);
+				if (it != index.end() && it->second.size == task.size &&
+						it->second.mtime == task.mtime) {
+					// Unchanged since last boot, reuse the hash
+					m_media[filename] = MediaInfo(filepath,
+							it->second.sha1_base64);
+					new_index[filepath] = it->second;
+					continue;
+				}
+			}
+			tasks.push_back(std::move(task));
+		}
+	}
+
+	// Read and hash only the new or changed files, in parallel
+	std::atomic<u32> cursor(0);
+	auto hash_worker = [&]() {
+		while (true) {
+			u32 i = cursor.fetch_add(1);
+			if (i >= tasks.size())
+				break;
+			HashTask &task = tasks[i];
+
 			// Read data
-			std::ifstream fis(filepath.c_str(), std::ios_base::binary);
+			std::ifstream fis(task.filepath.c_str(), std::ios_base::binary);
 			if (!fis.good()) {
 				errorstream << "Server::fillMediaCache(): Could not open \""
-						<< filename << "\" for reading" << std::endl;
+						<< task.filename << "\" for reading" << std::endl;
 				continue;
 			}
 			std::ostringstream tmp_os(std::ios_base::binary);
@@ -2421,12 +2829,12 @@ void Server::fillMediaCache()
 			}
 			if(bad) {
 				errorstream<<"Server::fillMediaCache(): Failed to read \""
-						<< filename << "\"" << std::endl;
+						<< task.filename << "\"" << std::endl;
 				continue;
 			}
 			if(tmp_os.str().length() == 0) {
 				errorstream << "Server::fillMediaCache(): Empty file \""
-						<< filepath << "\"" << std::endl;
+						<< task.filepath << "\"" << std::endl;
 				continue;
 			}
 
@@ -2434,16 +2842,43 @@ void Server::fillMediaCache()
 			sha1.addBytes(tmp_os.str().c_str(), tmp_os.str().length());
 
 			unsigned char *digest = sha1.getDigest();
-			std::string sha1_base64 = base64_encode(digest, 20);
-			std::string sha1_hex = hex_encode((char*)digest, 20);
+			task.sha1_base64 = base64_encode(digest, 20);
+			task.sha1_hex = hex_encode((char*)digest, 20);
 			free(digest);
+		}
+	};
 
-			// Put in list
-			m_media[filename] = MediaInfo(filepath, sha1_base64);
-			verbosestream << "Server: " << sha1_hex << " is " << filename
-					<< std::endl;
+	u32 thread_count = rangelim(std::thread::hardware_concurrency(), 1, 8);
+	std::vector<std::thread> workers;
+	for (u32 t = 1; t < thread_count; t++)
+		workers.emplace_back(hash_worker);
+	hash_worker();
+	for (std::thread &worker : workers)
+		worker.join();
+
+	for (const HashTask &task : tasks) {
+		if (task.sha1_base64.empty())
+			continue;
+
+		// Put in list
+		m_media[task.filename] = MediaInfo(task.filepath, task.sha1_base64);
+		verbosestream << "Server: " << task.sha1_hex << " is "
+				<< task.filename << std::endl;
+
+		if (task.indexable) {
+			MediaIndexEntry entry;
+			entry.size = task.size;
+			entry.mtime = task.mtime;
+			entry.sha1_base64 = task.sha1_base64;
+			new_index[task.filepath] = entry;
 		}
 	}
+
+	// Rewrite the index when anything was hashed or files disappeared
+	if (!tasks.empty() || new_index.size() != index.size()) {
+		fs::CreateAllDirs(porting::path_cache);
+		saveMediaIndex(index_path, new_index);
+	}
 }
 
 void Server::sendMediaAnnouncement(session_t peer_id, const std::string &lang_code)
@@ -2588,7 +3023,8 @@ void Server::sendRequestedMedia(session_t peer_id,
 	}
 }
 
-void Server::sendDetachedInventory(const std::string &name, session_t peer_id)
+void Server::sendDetachedInventory(const std::string &name, session_t peer_id,
+	bool incremental)
 {
 	const auto &inv_it = m_detached_inventories.find(name);
 	const auto &player_it = m_detached_inventories_player.find(name);
@@ -2610,28 +3046,65 @@ void Server::sendDetachedInventory(const std::string &name, session_t peer_id)
 		peer_id = p->getPeerId();
 	}
 
-	NetworkPacket pkt(TOCLIENT_DETACHED_INVENTORY, 0, peer_id);
-	pkt << name;
+	const bool removed = (inv_it == m_detached_inventories.end());
 
-	if (inv_it == m_detached_inventories.end()) {
-		pkt << false; // Remove inventory
-	} else {
-		pkt << true; // Update inventory
-
-		// Serialization & NetworkPacket isn't a love story
+	// Serialization & NetworkPacket isn't a love story
+	std::string full_data, delta_data;
+	if (!removed) {
 		std::ostringstream os(std::ios_base::binary);
 		inv_it->second->serialize(os);
-		inv_it->second->setModified(false);
+		full_data = os.str();
+		if (incremental) {
+			std::ostringstream os_delta(std::ios_base::binary);
+			inv_it->second->serialize(os_delta, true);
+			delta_data = os_delta.str();
+		}
+	}
 
-		const std::string &os_str = os.str();
-		pkt << static_cast<u16>(os_str.size()); // HACK: to keep compatibility with 5.0.0 clients
-		pkt.putRawString(os_str);
+	auto send_to = [&] (session_t peer, const std::string &data) {
+		NetworkPacket pkt(TOCLIENT_DETACHED_INVENTORY, 0, peer);
+		pkt << name;
+		if (removed) {
+			pkt << false; // Remove inventory
+		} else {
+			pkt << true; // Update inventory
+			pkt << static_cast<u16>(data.size()); // HACK: to keep compatibility with 5.0.0 clients
+			pkt.putRawString(data);
+		}
+		Send(&pkt);
+	};
+
+	if (peer_id != PEER_ID_INEXISTENT) {
+		// Targeted sends are initial sends; the client has no previous
+		// state to apply a delta on, so always send the full inventory.
+		// Do not mark the inventory handled: other clients may still be
+		// waiting for an update.
+		send_to(peer_id, full_data);
+		return;
 	}
 
-	if (peer_id == PEER_ID_INEXISTENT)
+	if (removed || !incremental) {
+		NetworkPacket pkt(TOCLIENT_DETACHED_INVENTORY, 0, peer_id);
+		pkt << name;
+		if (removed) {
+			pkt << false; // Remove inventory
+		} else {
+			pkt << true; // Update inventory
+			pkt << static_cast<u16>(full_data.size()); // HACK: to keep compatibility with 5.0.0 clients
+			pkt.putRawString(full_data);
+		}
 		m_clients.sendToAll(&pkt);
-	else
-		Send(&pkt);
+	} else {
+		// Clients from protocol 38 on understand the "KeepList"/"Keep"
+		// delta format; older ones get the full inventory
+		for (session_t client_id : m_clients.getClientIDs()) {
+			send_to(client_id, m_clients.getProtocolVersion(client_id) >= 38 ?
+				delta_data : full_data);
+		}
+	}
+
+	if (!removed)
+		inv_it->second->setModified(false);
 }
 
 void Server::sendDetachedInventories(session_t peer_id, bool incremental)
@@ -2644,7 +3117,7 @@ void Server::sendDetachedInventories(session_t peer_id, bool incremental)
 				continue;
 		}
 
-		sendDetachedInventory(name, peer_id);
+		sendDetachedInventory(name, peer_id, incremental);
 	}
 }
 
@@ -2744,8 +3217,9 @@ void Server::acceptAuth(session_t peer_id, bool forSudoMode)
 
 		NetworkPacket resp_pkt(TOCLIENT_AUTH_ACCEPT, 1 + 6 + 8 + 4, peer_id);
 
-		// Right now, the auth mechs don't change between login and sudo mode.
-		u32 sudo_auth_mechs = client->allowed_auth_mechs;
+		// Right now, the auth mechs don't change between login and sudo mode,
+		// except that session reauth can't prove the current password.
+		u32 sudo_auth_mechs = client->allowed_auth_mechs & ~AUTH_MECHANISM_SESSION_KEY;
 		client->allowed_sudo_mechs = sudo_auth_mechs;
 
 		resp_pkt << v3f(0,0,0) << (u64) m_env->getServerMap().getSeed()
@@ -2836,7 +3310,7 @@ void Server::DeleteClient(session_t peer_id, ClientDeletionReason reason)
 			}
 		}
 		{
-			MutexAutoLock env_lock(m_env_mutex);
+			SharedMutexWriteLock env_lock(m_env_mutex);
 			m_clients.DeleteClient(peer_id);
 		}
 	}
@@ -2859,6 +3333,22 @@ void Server::UpdateCrafting(RemotePlayer *player)
 		return;
 	}
 
+	// The modified flag is also raised by changes that leave the grid
+	// contents intact (e.g. a move into another list that was bounced
+	// back), so additionally compare a hash of the grid contents against
+	// the last prediction before re-running recipe resolution.
+	std::ostringstream grid_os(std::ios::binary);
+	for (u32 i = 0; i < clist->getSize(); i++) {
+		clist->getItem(i).serialize(grid_os);
+		grid_os << '\n';
+	}
+	std::string grid_str = grid_os.str();
+	u64 grid_hash = murmur_hash_64_ua(grid_str.data(), grid_str.length(), 0xdeadbeef);
+	if (player->checkCraftPredictionCached(grid_hash)) {
+		verbosestream << "Skip Server::UpdateCrafting(): grid contents unchanged" << std::endl;
+		return;
+	}
+
 	// Get a preview for crafting
 	ItemStack preview;
 	InventoryLocation loc;
@@ -2873,6 +3363,8 @@ void Server::UpdateCrafting(RemotePlayer *player)
 		// Put the new preview in
 		plist->changeItem(0, preview);
 	}
+
+	player->setCraftPredictionHash(grid_hash);
 }
 
 void Server::handleChatInterfaceEvent(ChatEvent *evt)
@@ -3026,6 +3518,11 @@ PlayerSAO *Server::getPlayerSAO(session_t peer_id)
 	return player->getPlayerSAO();
 }
 
+std::shared_ptr<const std::vector<Server::PlayerSnapshot>> Server::getPlayerSnapshot()
+{
+	return std::atomic_load(&m_player_snapshot);
+}
+
 std::wstring Server::getStatusString()
 {
 	std::wostringstream os(std::ios_base::binary);
@@ -3037,30 +3534,30 @@ std::wstring Server::getStatusString()
 	// Max lag estimate
 	os << L", max_lag=" << (m_env ? m_env->getMaxLagEstimate() : 0);
 
-	// Information about clients
+	// Information about clients, from the lock-free snapshot so status
+	// requests never touch the environment
 	bool first = true;
 	os << L", clients={";
-	if (m_env) {
-		std::vector<session_t> clients = m_clients.getClientIDs();
-		for (session_t client_id : clients) {
-			RemotePlayer *player = m_env->getPlayer(client_id);
-
-			// Get name of player
-			std::wstring name = L"unknown";
-			if (player)
-				name = narrow_to_wide(player->getName());
-
-			// Add name to information string
-			if (!first)
-				os << L", ";
-			else
-				first = false;
-
-			os << name;
-		}
+	std::shared_ptr<const std::vector<PlayerSnapshot>> players =
+		getPlayerSnapshot();
+	for (const PlayerSnapshot &player : *players) {
+		std::wstring name = player.name.empty() ? L"unknown" :
+			narrow_to_wide(player.name);
+
+		// Add name to information string
+		if (!first)
+			os << L", ";
+		else
+			first = false;
+
+		os << name;
 	}
 	os << L"}";
 
+	// Per-subsystem memory pools, current/peak
+	os << std::endl << L"# Server: memory: "
+		<< narrow_to_wide(g_memstats->getSummary());
+
 	if (m_env && !((ServerMap*)(&m_env->getMap()))->isSavingEnabled())
 		os << std::endl << L"# Server: " << " WARNING: Map saving is disabled.";
 
@@ -3070,6 +3567,13 @@ std::wstring Server::getStatusString()
 	return os.str();
 }
 
+std::string Server::getNetworkStatsString()
+{
+	std::ostringstream os;
+	m_con->printPacketTypeStats(os);
+	return os.str();
+}
+
 std::set<std::string> Server::getPlayerEffectivePrivs(const std::string &name)
 {
 	std::set<std::string> privs;
@@ -3758,6 +4262,80 @@ void dedicated_server_loop(Server &server, bool &kill)
 #endif
 }
 
+void session_replay_loop(Server &server, bool &kill,
+		const std::string &path, float speed)
+{
+	SessionLogReader reader;
+	if (!reader.open(path))
+		return;
+	if (speed <= 0.0f)
+		speed = 1.0f;
+
+	verbosestream << "session_replay_loop()" << std::endl;
+
+	const float steplen = g_settings->getFloat("dedicated_server_step");
+
+	// Recorded peer ids map to freshly created ones
+	std::unordered_map<session_t, session_t> peer_map;
+	u32 injected = 0;
+
+	SessionLogEntry entry;
+	bool have_entry = reader.read(&entry);
+	u64 start_ms = porting::getTimeMs();
+	con::Connection *con = server.getConnection();
+
+	while (have_entry && !kill && !server.isShutdownRequested()) {
+		sleep_ms((int) (steplen * 1000.0f / speed));
+		server.step(steplen);
+
+		u32 replay_ms = (u32) ((porting::getTimeMs() - start_ms) * speed);
+		while (have_entry && entry.time_ms <= replay_ms) {
+			switch (entry.type) {
+			case SESSIONLOG_PEER_ADDED: {
+				// Outgoing traffic for this peer goes to a loopback
+				// port nobody listens on
+				Address address(127, 0, 0, 1, (u16) (20000 + entry.peer_id));
+				session_t live_id = con->simulatePeer(address);
+				if (live_id != PEER_ID_INEXISTENT)
+					peer_map[entry.peer_id] = live_id;
+				break;
+			}
+			case SESSIONLOG_PEER_REMOVED: {
+				auto it = peer_map.find(entry.peer_id);
+				if (it != peer_map.end()) {
+					con->DisconnectPeer(it->second);
+					peer_map.erase(it);
+				}
+				break;
+			}
+			case SESSIONLOG_DATA: {
+				// Data from peers that joined before the recording
+				// started has no peer mapping and is dropped
+				auto it = peer_map.find(entry.peer_id);
+				if (it != peer_map.end()) {
+					SharedBuffer<u8> data(entry.data.size());
+					memcpy(*data, entry.data.c_str(), entry.data.size());
+					con->injectReceivedData(it->second, data);
+					injected++;
+				}
+				break;
+			}
+			}
+			have_entry = reader.read(&entry);
+		}
+	}
+
+	// Let the server work through the tail of the log
+	for (int i = 0; i < (int) (2.0f / steplen) && !kill; i++) {
+		sleep_ms((int) (steplen * 1000.0f));
+		server.step(steplen);
+	}
+
+	actionstream << "session_replay_loop: replayed " << injected
+		<< " packets from \"" << path << "\" at " << speed << "x"
+		<< std::endl;
+}
+
 /*
  * Mod channels
  */
@@ -3791,8 +4369,7 @@ ModChannel* Server::getModChannel(const std::string &channel)
 void Server::broadcastModChannelMessage(const std::string &channel,
 		const std::string &message, session_t from_peer)
 {
-	const std::vector<u16> &peers = m_modchannel_mgr->getChannelPeers(channel);
-	if (peers.empty())
+	if (m_modchannel_mgr->getChannelPeers(channel).empty())
 		return;
 
 	if (message.size() > STRING_MAX_LEN) {
@@ -3802,23 +4379,78 @@ void Server::broadcastModChannelMessage(const std::string &channel,
 		return;
 	}
 
+	// The sender name is resolved now in case the peer disconnects
+	// before the queue is flushed
 	std::string sender;
 	if (from_peer != PEER_ID_SERVER) {
 		sender = getPlayerName(from_peer);
 	}
 
-	NetworkPacket resp_pkt(TOCLIENT_MODCHANNEL_MSG,
-			2 + channel.size() + 2 + sender.size() + 2 + message.size());
-	resp_pkt << channel << sender << message;
-	for (session_t peer_id : peers) {
-		// Ignore sender
-		if (peer_id == from_peer)
+	// Messages are only queued here; sendQueuedModChannelMessages()
+	// combines everything a subscriber should get this tick into one
+	// packet, since many small messages otherwise multiply the
+	// per-packet overhead by the subscriber count.
+	m_modchannel_msg_queue.push_back({channel, sender, message, from_peer});
+}
+
+void Server::sendQueuedModChannelMessages()
+{
+	if (m_modchannel_msg_queue.empty())
+		return;
+
+	std::vector<PendingModChannelMsg> queue;
+	queue.swap(m_modchannel_msg_queue);
+
+	// Collect the messages each subscriber should receive
+	std::unordered_map<session_t, std::vector<const PendingModChannelMsg *>>
+			batches;
+	for (const PendingModChannelMsg &pending : queue) {
+		for (session_t peer_id : m_modchannel_mgr->getChannelPeers(pending.channel)) {
+			// Ignore sender; the server consumes its copy through the
+			// script pass below instead of a packet
+			if (peer_id == pending.from_peer || peer_id == PEER_ID_SERVER)
+				continue;
+			batches[peer_id].push_back(&pending);
+		}
+	}
+
+	for (const auto &it : batches) {
+		session_t peer_id = it.first;
+		const std::vector<const PendingModChannelMsg *> &msgs = it.second;
+
+		if (msgs.size() > 1 &&
+				m_clients.getProtocolVersion(peer_id) >= 43) {
+			size_t payload_size = 2;
+			for (const PendingModChannelMsg *msg : msgs)
+				payload_size += 2 + msg->channel.size() + 2 +
+						msg->sender.size() + 2 + msg->message.size();
+
+			NetworkPacket pkt(TOCLIENT_MODCHANNEL_MSGS, payload_size, peer_id);
+			pkt << (u16) msgs.size();
+			for (const PendingModChannelMsg *msg : msgs)
+				pkt << msg->channel << msg->sender << msg->message;
+			Send(&pkt);
 			continue;
+		}
 
-		Send(peer_id, &resp_pkt);
+		// Single message, or an older client that only understands
+		// one message per packet
+		for (const PendingModChannelMsg *msg : msgs) {
+			NetworkPacket pkt(TOCLIENT_MODCHANNEL_MSG,
+					2 + msg->channel.size() + 2 + msg->sender.size() +
+					2 + msg->message.size(), peer_id);
+			pkt << msg->channel << msg->sender << msg->message;
+			Send(&pkt);
+		}
 	}
 
-	if (from_peer != PEER_ID_SERVER) {
-		m_script->on_modchannel_message(channel, sender, message);
+	// One signal-handling pass for everything the server itself should see
+	std::vector<ModChannelMsg> script_msgs;
+	for (const PendingModChannelMsg &pending : queue) {
+		if (pending.from_peer != PEER_ID_SERVER)
+			script_msgs.push_back({pending.channel, pending.sender,
+					pending.message});
 	}
+	if (!script_msgs.empty())
+		m_script->on_modchannel_messages(script_msgs);
 }
@@ -36,9 +36,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serverenvironment.h"
 #include "clientiface.h"
 #include "chatmessage.h"
+#include "threading/shared_mutex.h"
 #include <string>
 #include <list>
 #include <map>
+#include <memory>
 #include <vector>
 
 class ChatEvent;
@@ -62,6 +64,7 @@ class ServerEnvironment;
 struct SimpleSoundSpec;
 struct CloudParams;
 class ServerThread;
+class MetricsServerThread;
 class ServerModManager;
 
 enum ClientDeletionReason {
@@ -170,6 +173,7 @@ public:
 	void handleCommand_FirstSrp(NetworkPacket* pkt);
 	void handleCommand_SrpBytesA(NetworkPacket* pkt);
 	void handleCommand_SrpBytesM(NetworkPacket* pkt);
+	void handleCommand_SessionReauth(NetworkPacket* pkt);
 
 	void ProcessData(NetworkPacket *pkt);
 
@@ -201,6 +205,23 @@ public:
 	std::wstring getStatusString();
 	inline double getUptime() const { return m_uptime.m_value; }
 
+	// Per-packet-type network counters, formatted as a table
+	std::string getNetworkStatsString();
+
+	// One entry per connected player, refreshed once per server tick
+	struct PlayerSnapshot {
+		session_t peer_id;
+		std::string name;
+		v3f position;
+	};
+
+	/*
+		Returns the player list published by the last tick. Lock-free and
+		safe from any thread: the snapshot is immutable and swapped
+		atomically, so it may be up to one tick stale but never torn.
+	*/
+	std::shared_ptr<const std::vector<PlayerSnapshot>> getPlayerSnapshot();
+
 	// read shutdown state
 	inline bool isShutdownRequested() const { return m_shutdown_state.is_requested; }
 
@@ -255,6 +276,11 @@ public:
 	// Envlock and conlock should be locked when using scriptapi
 	ServerScripting *getScriptIface(){ return m_script; }
 
+	// For the session replay driver (session_replay_loop); replay mode
+	// skips the auth proofs that cannot match a fresh challenge
+	con::Connection *getConnection() { return m_con.get(); }
+	void setSessionReplayMode(bool v) { m_session_replay = v; }
+
 	// actions: time-reversed list
 	// Return value: success/failure
 	bool rollbackRevertActions(const std::list<RollbackAction> &actions,
@@ -354,8 +380,22 @@ public:
 	// Bind address
 	Address m_bind_addr;
 
-	// Environment mutex (envlock)
-	std::mutex m_env_mutex;
+	/*
+		Environment mutex (envlock).
+
+		A reader-writer lock: everything that mutates the environment or
+		the map (environment step, packet handling, emerge finalization,
+		map edit sending) takes SharedMutexWriteLock, while read-mostly
+		consumers like SendBlocks() take SharedMutexReadLock so they do
+		not serialize against each other. A read lock permits no
+		modification of the environment, the map or its blocks; client
+		bookkeeping is fine as it is behind the m_clients lock.
+
+		The hottest cross-thread queries (player names and positions) do
+		not need the lock at all: they are published once per tick as an
+		immutable snapshot, see getPlayerSnapshot().
+	*/
+	SharedMutex m_env_mutex;
 
 private:
 	friend class EmergeThread;
@@ -418,6 +458,9 @@ private:
 	void SendOverrideDayNightRatio(session_t peer_id, bool do_override, float ratio);
 	void broadcastModChannelMessage(const std::string &channel,
 			const std::string &message, session_t from_peer);
+	// Flushes the per-tick mod channel message queue as one combined
+	// packet per subscriber; called from AsyncRunStep()
+	void sendQueuedModChannelMessages();
 
 	/*
 		Send a node removal/addition event to all clients except ignore_id.
@@ -436,6 +479,11 @@ private:
 
 	// Environment and Connection must be locked when called
 	void SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver, u16 net_proto_version);
+	void SendBlocksBatchedNoLock(session_t peer_id,
+			std::vector<std::pair<v3s16, std::string>> &blocks);
+	// Sends only the given nodes of the block (delta block update)
+	void SendBlockDeltaNoLock(session_t peer_id, MapBlock *block,
+			const std::vector<u16> &indices);
 
 	// Sends blocks to clients (locks env and con on its own)
 	void SendBlocks(float dtime);
@@ -445,7 +493,8 @@ private:
 	void sendRequestedMedia(session_t peer_id,
 			const std::vector<std::string> &tosend);
 
-	void sendDetachedInventory(const std::string &name, session_t peer_id);
+	void sendDetachedInventory(const std::string &name, session_t peer_id,
+			bool incremental = false);
 
 	// Adds a ParticleSpawner on peer with peer_id (PEER_ID_INEXISTENT == all)
 	void SendAddParticleSpawner(session_t peer_id, u16 protocol_version,
@@ -513,6 +562,14 @@ private:
 
 	void handlePeerChanges();
 
+	/*
+		Returns true if a deferrable AsyncRunStep() subtask may still run
+		within the tick's time budget. A subtask that was deferred on
+		several consecutive ticks runs regardless, so sustained overload
+		cannot starve it.
+	*/
+	bool tickDeadlineAllows(u64 start_ms, u8 &deferrals);
+
 	/*
 		Variables
 	*/
@@ -526,6 +583,8 @@ private:
 	u16 m_max_chatmessage_length;
 	// For "dedicated" server list flag
 	bool m_dedicated;
+	// Replaying a recorded session (see session_replay_loop)
+	bool m_session_replay = false;
 
 	// Thread can set; step() will throw as ServerError
 	MutexedVariable<std::string> m_async_fatal_error;
@@ -537,6 +596,14 @@ private:
 	float m_emergethread_trigger_timer = 0.0f;
 	float m_savemap_timer = 0.0f;
 	IntervalLimiter m_map_timer_and_unload_interval;
+	IntervalLimiter m_metrics_interval;
+
+	// Deadline handling for deferrable background subtasks; the budget is
+	// derived from dedicated_server_step (see init())
+	u64 m_tick_budget_ms = 90;
+	u8 m_map_timer_deferrals = 0;
+	u8 m_liquid_transform_deferrals = 0;
+	u8 m_savemap_deferrals = 0;
 
 	// Environment
 	ServerEnvironment *m_env = nullptr;
@@ -586,6 +653,9 @@ private:
 	// The server mainly operates in this thread
 	ServerThread *m_thread = nullptr;
 
+	// Optional Prometheus metrics listener (metrics_port setting)
+	MetricsServerThread *m_metrics_thread = nullptr;
+
 	/*
 		Time related stuff
 	*/
@@ -594,6 +664,13 @@ private:
 	// Uptime of server in seconds
 	MutexedVariable<double> m_uptime;
 
+	/*
+		Player snapshot for getPlayerSnapshot(). Replaced wholesale each
+		tick under envlock (std::atomic_store); readers never lock.
+	*/
+	std::shared_ptr<const std::vector<PlayerSnapshot>> m_player_snapshot =
+		std::make_shared<const std::vector<PlayerSnapshot>>();
+
 	/*
 	 	Client interface
 	*/
@@ -608,6 +685,21 @@ private:
 
 	std::unordered_map<session_t, std::string> m_formspec_state_data;
 
+	/*
+		SRP session keys of recent logins, so reconnecting clients can
+		prove their identity without another full SRP exchange (see
+		handleCommand_SessionReauth). Keyed by player name. Entries die
+		after "session_reauth_timeout" seconds or when the password
+		entry they were checked against changes.
+	*/
+	struct CachedSession
+	{
+		std::string key;     // SRP session key of the last full login
+		std::string enc_pwd; // password entry that login was verified against
+		u64 expiry_time;     // absolute time in seconds (porting::getTimeS)
+	};
+	std::unordered_map<std::string, CachedSession> m_cached_sessions;
+
 	/*
 		Random stuff
 	*/
@@ -627,10 +719,22 @@ private:
 	*/
 
 	/*
-		Queue of map edits from the environment for sending to the clients
+		Map edits from the environment waiting to be sent to the clients.
 		This is behind m_env_mutex
+
+		Edits are coalesced per tick instead of queued verbatim: repeated
+		edits of one node keep only the newest state (last writer wins),
+		metadata changes are deduplicated per position and MEET_OTHER
+		events merge into one set of blocks, so a mod hammering the same
+		block produces one client notification per block per tick.
 	*/
-	std::queue<MapEditEvent*> m_unsent_map_edit_queue;
+	std::map<v3s16, MapEditEvent> m_unsent_node_edits;
+	// Node position -> is_private_change (false as soon as any change
+	// at that position was public)
+	std::map<v3s16, bool> m_unsent_meta_updates;
+	// Blocks to mark as not sent (merged MEET_OTHER events and blocks
+	// whose per-node edits were collapsed into a whole-block resend)
+	std::set<v3s16> m_unsent_other_blocks;
 	/*
 		If a non-empty area, map edit events contained within are left
 		unsent. Done at map generation time to speed up editing of the
@@ -665,6 +769,16 @@ private:
 
 	// ModChannel manager
 	std::unique_ptr<ModChannelMgr> m_modchannel_mgr;
+
+	// Mod channel messages waiting for the per-tick combined send
+	struct PendingModChannelMsg
+	{
+		std::string channel;
+		std::string sender;
+		std::string message;
+		session_t from_peer;
+	};
+	std::vector<PendingModChannelMsg> m_modchannel_msg_queue;
 };
 
 /*
@@ -673,3 +787,10 @@ private:
 	Shuts down when kill is set to true.
 */
 void dedicated_server_loop(Server &server, bool &kill);
+
+/*
+	Feeds a session recorded with the session_record_path setting back
+	into the server at original or accelerated speed (--replay-session)
+*/
+void session_replay_loop(Server &server, bool &kill,
+		const std::string &path, float speed);
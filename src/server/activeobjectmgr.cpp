@@ -25,6 +25,53 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 namespace server
 {
 
+v3s16 ActiveObjectMgr::getCell(const v3f &pos)
+{
+	return getNodeBlockPos(floatToInt(pos, BS));
+}
+
+void ActiveObjectMgr::insertToCell(u16 id, v3s16 cell)
+{
+	m_grid[cell].push_back(id);
+	m_object_cell[id] = cell;
+}
+
+void ActiveObjectMgr::removeFromCell(u16 id)
+{
+	auto cell_it = m_object_cell.find(id);
+	if (cell_it == m_object_cell.end())
+		return;
+
+	auto grid_it = m_grid.find(cell_it->second);
+	if (grid_it != m_grid.end()) {
+		std::vector<u16> &ids = grid_it->second;
+		for (size_t i = 0; i < ids.size(); i++) {
+			if (ids[i] == id) {
+				ids[i] = ids.back();
+				ids.pop_back();
+				break;
+			}
+		}
+		if (ids.empty())
+			m_grid.erase(grid_it);
+	}
+	m_object_cell.erase(cell_it);
+}
+
+void ActiveObjectMgr::updateObjectPos(u16 id, const v3f &pos)
+{
+	auto cell_it = m_object_cell.find(id);
+	if (cell_it == m_object_cell.end())
+		return;
+
+	v3s16 cell = getCell(pos);
+	if (cell_it->second == cell)
+		return;
+
+	removeFromCell(id);
+	insertToCell(id, cell);
+}
+
 void ActiveObjectMgr::clear(const std::function<bool(ServerActiveObject *, u16)> &cb)
 {
 	std::vector<u16> objects_to_remove;
@@ -37,6 +84,7 @@ void ActiveObjectMgr::clear(const std::function<bool(ServerActiveObject *, u16)>
 
 	// Remove references from m_active_objects
 	for (u16 i : objects_to_remove) {
+		removeFromCell(i);
 		m_active_objects.erase(i);
 	}
 }
@@ -88,6 +136,7 @@ bool ActiveObjectMgr::registerObject(ServerActiveObject *obj)
 	}
 
 	m_active_objects[obj->getId()] = obj;
+	insertToCell(obj->getId(), getCell(obj->getBasePosition()));
 
 	verbosestream << "Server::ActiveObjectMgr::addActiveObjectRaw(): "
 			<< "Added id=" << obj->getId() << "; there are now "
@@ -106,6 +155,7 @@ void ActiveObjectMgr::removeObject(u16 id)
 		return;
 	}
 
+	removeFromCell(id);
 	m_active_objects.erase(id);
 	delete obj;
 }
@@ -115,13 +165,43 @@ void ActiveObjectMgr::getObjectsInsideRadius(
 		const v3f &pos, float radius, std::vector<u16> &result)
 {
 	float r2 = radius * radius;
-	for (auto &activeObject : m_active_objects) {
-		ServerActiveObject *obj = activeObject.second;
-		u16 id = activeObject.first;
-		const v3f &objectpos = obj->getBasePosition();
-		if (objectpos.getDistanceFromSQ(pos) > r2)
+
+	v3s16 min_cell = getCell(pos - v3f(radius, radius, radius));
+	v3s16 max_cell = getCell(pos + v3f(radius, radius, radius));
+	u64 num_cells = (u64)(max_cell.X - min_cell.X + 1) *
+			(max_cell.Y - min_cell.Y + 1) * (max_cell.Z - min_cell.Z + 1);
+
+	// For very large radii walking the cells would be slower than the
+	// plain scan over all objects
+	if (num_cells >= m_active_objects.size()) {
+		for (auto &activeObject : m_active_objects) {
+			ServerActiveObject *obj = activeObject.second;
+			u16 id = activeObject.first;
+			const v3f &objectpos = obj->getBasePosition();
+			if (objectpos.getDistanceFromSQ(pos) > r2)
+				continue;
+			result.push_back(id);
+		}
+		return;
+	}
+
+	v3s16 cell;
+	for (cell.X = min_cell.X; cell.X <= max_cell.X; cell.X++)
+	for (cell.Y = min_cell.Y; cell.Y <= max_cell.Y; cell.Y++)
+	for (cell.Z = min_cell.Z; cell.Z <= max_cell.Z; cell.Z++) {
+		auto it = m_grid.find(cell);
+		if (it == m_grid.end())
 			continue;
-		result.push_back(id);
+
+		for (u16 id : it->second) {
+			ServerActiveObject *obj = getActiveObject(id);
+			if (!obj)
+				continue;
+			const v3f &objectpos = obj->getBasePosition();
+			if (objectpos.getDistanceFromSQ(pos) > r2)
+				continue;
+			result.push_back(id);
+		}
 	}
 }
 
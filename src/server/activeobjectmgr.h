@@ -20,9 +20,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <functional>
+#include <unordered_map>
 #include <vector>
 #include "../activeobjectmgr.h"
 #include "serverobject.h"
+#include "util/numeric.h"
 
 namespace server
 {
@@ -41,5 +43,20 @@ public:
 	void getAddedActiveObjectsAroundPos(const v3f &player_pos, f32 radius,
 			f32 player_radius, std::set<u16> &current_objects,
 			std::queue<u16> &added_objects);
+
+	// Keeps the spatial grid in sync when an object moves; called from
+	// ServerActiveObject::setBasePosition()
+	void updateObjectPos(u16 id, const v3f &pos);
+
+private:
+	static v3s16 getCell(const v3f &pos);
+	void insertToCell(u16 id, v3s16 cell);
+	void removeFromCell(u16 id);
+
+	// Mapblock-granular spatial grid of object ids, so radius queries
+	// only touch nearby cells instead of every active object
+	std::unordered_map<v3s16, std::vector<u16>, v3s16Hash> m_grid;
+	// Cell each object is currently filed under
+	std::unordered_map<u16, v3s16> m_object_cell;
 };
 } // namespace server
@@ -18,12 +18,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "serverenvironment.h"
+#include "util/tunables.h"
 #include "content_sao.h"
 #include "settings.h"
 #include "log.h"
 #include "mapblock.h"
 #include "nodedef.h"
 #include "nodemetadata.h"
+#include "noise.h"
 #include "gamedef.h"
 #include "map.h"
 #include "porting.h"
@@ -36,6 +38,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/basic_macros.h"
 #include "util/pointedthing.h"
 #include "threading/mutex_auto_lock.h"
+#include "threading/thread.h"
 #include "filesys.h"
 #include "gameparams.h"
 #include "database/database-dummy.h"
@@ -45,6 +48,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "database/database-postgresql.h"
 #endif
 #include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <thread>
 
 #define LBM_NAME_ALLOWED_CHARS "abcdefghijklmnopqrstuvwxyz0123456789_:"
 
@@ -320,6 +326,34 @@ void fillViewConeBlock(v3s16 p0,
 	}
 }
 
+void ActiveBlockList::applyDiff(const std::set<v3s16> &old_blocks,
+	const std::set<v3s16> &new_blocks,
+	std::map<v3s16, u16> &refs, std::set<v3s16> &list,
+	std::set<v3s16> *removed, std::set<v3s16> *added)
+{
+	for (v3s16 p : old_blocks) {
+		if (new_blocks.find(p) != new_blocks.end())
+			continue;
+		auto it = refs.find(p);
+		assert(it != refs.end());
+		if (--it->second == 0) {
+			refs.erase(it);
+			list.erase(p);
+			if (removed)
+				removed->insert(p);
+		}
+	}
+	for (v3s16 p : new_blocks) {
+		if (old_blocks.find(p) != old_blocks.end())
+			continue;
+		if (++refs[p] == 1) {
+			list.insert(p);
+			if (added)
+				added->insert(p);
+		}
+	}
+}
+
 void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
 	s16 active_block_range,
 	s16 active_object_range,
@@ -327,57 +361,112 @@ void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
 	std::set<v3s16> &blocks_added)
 {
 	/*
-		Create the new list
+		Update the contribution of each player. The radius and view cone
+		fills are only redone when the player crossed a mapblock boundary,
+		turned far enough for the view cone to move, or changed their
+		wanted range; otherwise the cached block sets stay valid.
 	*/
-	std::set<v3s16> newlist = m_forceloaded_list;
-	m_abm_list = m_forceloaded_list;
-	for (const PlayerSAO *playersao : active_players) {
-		v3s16 pos = getNodeBlockPos(floatToInt(playersao->getBasePosition(), BS));
-		fillRadiusBlock(pos, active_block_range, m_abm_list);
-		fillRadiusBlock(pos, active_block_range, newlist);
+	for (auto &it : m_contributions)
+		it.second.seen = false;
 
+	for (PlayerSAO *playersao : active_players) {
+		v3s16 pos = getNodeBlockPos(floatToInt(playersao->getBasePosition(), BS));
 		s16 player_ao_range = std::min(active_object_range, playersao->getWantedRange());
-		// only do this if this would add blocks
-		if (player_ao_range > active_block_range) {
-			v3f camera_dir = v3f(0,0,1);
+		bool has_cone = player_ao_range > active_block_range;
+		v3f camera_dir = v3f(0,0,1);
+		if (has_cone) {
 			camera_dir.rotateYZBy(playersao->getLookPitch());
 			camera_dir.rotateXZBy(playersao->getRotation().Y);
+		}
+
+		auto cit = m_contributions.find(playersao->getId());
+		bool fresh = (cit == m_contributions.end());
+		Contribution &c = fresh ?
+			m_contributions[playersao->getId()] : cit->second;
+		c.seen = true;
+
+		bool moved = fresh || c.block_pos != pos;
+		// The view cone also shifts slightly as the eye moves inside a
+		// block; tolerating that until a boundary is crossed trades a
+		// little hysteresis at the cone edge for not redoing the fill
+		// every cycle.
+		bool turned = c.has_cone != has_cone || c.ao_range != player_ao_range ||
+			(has_cone && c.camera_dir.dotProduct(camera_dir) < 0.995f);
+		if (!moved && !turned)
+			continue;
+
+		std::set<v3s16> abm_blocks;
+		fillRadiusBlock(pos, active_block_range, abm_blocks);
+		std::set<v3s16> all_blocks = abm_blocks;
+		if (has_cone) {
 			fillViewConeBlock(pos,
 				player_ao_range,
 				playersao->getEyePosition(),
 				camera_dir,
 				playersao->getFov(),
-				newlist);
+				all_blocks);
 		}
-	}
 
-	/*
-		Find out which blocks on the old list are not on the new list
-	*/
-	// Go through old list
-	for (v3s16 p : m_list) {
-		// If not on new list, it's been removed
-		if (newlist.find(p) == newlist.end())
-			blocks_removed.insert(p);
+		applyDiff(c.abm_blocks, abm_blocks, m_abm_refs, m_abm_list,
+			nullptr, nullptr);
+		applyDiff(c.blocks, all_blocks, m_list_refs, m_list,
+			&blocks_removed, &blocks_added);
+
+		c.block_pos = pos;
+		c.camera_dir = camera_dir;
+		c.ao_range = player_ao_range;
+		c.has_cone = has_cone;
+		c.abm_blocks = std::move(abm_blocks);
+		c.blocks = std::move(all_blocks);
 	}
 
-	/*
-		Find out which blocks on the new list are not on the old list
-	*/
-	// Go through new list
-	for (v3s16 p : newlist) {
-		// If not on old list, it's been added
-		if(m_list.find(p) == m_list.end())
-			blocks_added.insert(p);
+	// Drop the contributions of players that are gone
+	for (auto it = m_contributions.begin(); it != m_contributions.end();) {
+		if (it->second.seen) {
+			++it;
+			continue;
+		}
+		Contribution &c = it->second;
+		applyDiff(c.abm_blocks, std::set<v3s16>(), m_abm_refs, m_abm_list,
+			nullptr, nullptr);
+		applyDiff(c.blocks, std::set<v3s16>(), m_list_refs, m_list,
+			&blocks_removed, &blocks_added);
+		it = m_contributions.erase(it);
+	}
+
+	// The forceloaded list is mutated by mods between updates; diff it
+	// against the state it had last time. Forceloaded blocks count into
+	// both the full list and the ABM list.
+	if (m_forceloaded_list != m_forceloaded_cache) {
+		applyDiff(m_forceloaded_cache, m_forceloaded_list, m_abm_refs,
+			m_abm_list, nullptr, nullptr);
+		applyDiff(m_forceloaded_cache, m_forceloaded_list, m_list_refs,
+			m_list, &blocks_removed, &blocks_added);
+		m_forceloaded_cache = m_forceloaded_list;
+	}
+
+	// A block that was dropped by one contributor and picked up by
+	// another in the same update is neither removed nor added
+	for (auto it = blocks_added.begin(); it != blocks_added.end();) {
+		auto rit = blocks_removed.find(*it);
+		if (rit != blocks_removed.end()) {
+			blocks_removed.erase(rit);
+			it = blocks_added.erase(it);
+		} else {
+			++it;
+		}
 	}
 
-	/*
-		Update m_list
-	*/
-	m_list.clear();
-	for (v3s16 p : newlist) {
-		m_list.insert(p);
+	// Retry blocks whose activation failed last time
+	for (v3s16 p : m_retry) {
+		if (m_list_refs.find(p) != m_list_refs.end()) {
+			m_list.insert(p);
+			blocks_added.insert(p);
+		}
+		if (m_abm_refs.find(p) != m_abm_refs.end())
+			m_abm_list.insert(p);
 	}
+	m_retry.clear();
 }
 
 /*
@@ -397,6 +486,17 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 	m_path_world(path_world),
 	m_rgen(seed())
 {
+	// Determine how many threads to use for the ABM candidate scan
+	s16 abm_threads = 1;
+	g_settings->getS16NoEx("num_abm_threads", abm_threads);
+	// If automatic, leave a proc for the main thread and one for
+	// some other misc thread
+	if (abm_threads == 0)
+		abm_threads = Thread::getNumberOfProcessors() - 2;
+	if (abm_threads < 1)
+		abm_threads = 1;
+	m_abm_workers = abm_threads;
+
 	// Determine which database backend to use
 	std::string conf_path = path_world + DIR_DELIM + "world.mt";
 	Settings conf;
@@ -471,6 +571,7 @@ ServerEnvironment::~ServerEnvironment()
 	m_map->drop();
 
 	// Delete ActiveBlockModifiers
+	delete m_abm_scheduler;
 	for (ABMWithState &m_abm : m_abms) {
 		delete m_abm.abm;
 	}
@@ -512,6 +613,22 @@ RemotePlayer *ServerEnvironment::getPlayer(const char* name)
 	return NULL;
 }
 
+float ServerEnvironment::getDistanceToNearestPlayer(const v3f &pos)
+{
+	float nearest = -1.0f;
+	for (RemotePlayer *player : m_players) {
+		if (player->getPeerId() == PEER_ID_INEXISTENT)
+			continue;
+		PlayerSAO *sao = player->getPlayerSAO();
+		if (!sao)
+			continue;
+		float d = sao->getBasePosition().getDistanceFrom(pos);
+		if (nearest < 0.0f || d < nearest)
+			nearest = d;
+	}
+	return nearest;
+}
+
 void ServerEnvironment::addPlayer(RemotePlayer *player)
 {
 	/*
@@ -563,6 +680,52 @@ bool ServerEnvironment::line_of_sight(v3f pos1, v3f pos2, v3s16 *p)
 	return true;
 }
 
+void ServerEnvironment::line_of_sight_batch(
+	const std::vector<std::pair<v3f, v3f>> &lines, u32 max_opaque,
+	std::vector<std::pair<bool, v3s16>> &results)
+{
+	Map &map = getMap();
+
+	/* One-entry block cache. Consecutive steps of a line, and usually the
+	   next line of a batch between nearby points, stay within the same
+	   mapblock, so this removes nearly all of the per-node block lookups
+	   that line_of_sight() pays through Map::getNode(). */
+	v3s16 cached_bp(S16_MAX, S16_MAX, S16_MAX);
+	MapBlock *cached_block = nullptr;
+
+	results.clear();
+	results.reserve(lines.size());
+	for (const auto &line : lines) {
+		voxalgo::VoxelLineIterator iterator(line.first / BS,
+			(line.second - line.first) / BS);
+		u32 opaque_count = 0;
+		bool clear = true;
+		v3s16 blocked_pos;
+		do {
+			v3s16 p = iterator.m_current_node_pos;
+			v3s16 bp = getNodeBlockPos(p);
+			if (bp != cached_bp) {
+				cached_block = map.getBlockNoCreateNoEx(bp);
+				cached_bp = bp;
+			}
+			// As in line_of_sight(), unloaded areas block the line
+			MapNode n(CONTENT_IGNORE);
+			if (cached_block) {
+				bool pos_ok;
+				n = cached_block->getNodeNoCheck(p - bp * MAP_BLOCKSIZE, &pos_ok);
+			}
+
+			if (n.param0 != CONTENT_AIR && ++opaque_count >= max_opaque) {
+				clear = false;
+				blocked_pos = p;
+				break;
+			}
+			iterator.next();
+		} while (iterator.m_current_index <= iterator.m_last_index);
+		results.emplace_back(clear, blocked_pos);
+	}
+}
+
 void ServerEnvironment::kickAllPlayers(AccessDeniedCode reason,
 	const std::string &str_reason, bool reconnect)
 {
@@ -654,12 +817,9 @@ void ServerEnvironment::saveMeta()
 	args.writeLines(ss);
 	ss<<"EnvArgsEnd\n";
 
-	if(!fs::safeWriteToFile(path, ss.str()))
-	{
-		infostream<<"ServerEnvironment::saveMeta(): Failed to write "
-			<<path<<std::endl;
-		throw SerializationError("Couldn't save env meta");
-	}
+	// Written on the shared writer thread so the periodic save tick does
+	// no filesystem I/O while it holds the environment lock
+	fs::safeWriteToFileAsync(path, ss.str());
 }
 
 void ServerEnvironment::loadMeta()
@@ -738,58 +898,50 @@ struct ActiveABM
 	int chance;
 	std::vector<content_t> required_neighbors;
 	bool check_required_neighbors; // false if required_neighbors is known to be empty
+	bool due = false; // whether the ABM is due in the current cycle
 };
 
-class ABMHandler
+/*
+	ABMScheduler
+
+	Persistent scheduler for ActiveBlockModifiers. The trigger contents and
+	neighbors of each ABM are resolved once, and a timing wheel tracks when
+	each ABM is next due, so the steady-state ABM cycle rebuilds nothing.
+	Intervals longer than one wheel rotation are handled with a per-entry
+	rotation counter instead of further wheel levels, which covers the
+	interval range ABMs actually use.
+*/
+class ABMScheduler
 {
-private:
-	ServerEnvironment *m_env;
-	std::vector<std::vector<ActiveABM> *> m_aabms;
 public:
-	ABMHandler(std::vector<ABMWithState> &abms,
-		float dtime_s, ServerEnvironment *env,
-		bool use_timers):
-		m_env(env)
+	static const u32 WHEEL_SLOTS = 64;
+
+	ABMScheduler(std::vector<ABMWithState> &abms, float slot_width,
+		ServerEnvironment *env):
+		m_slot_width(MYMAX(slot_width, 0.001f)),
+		m_num_abms(abms.size())
 	{
-		if(dtime_s < 0.001)
-			return;
 		const NodeDefManager *ndef = env->getGameDef()->ndef();
-		for (ABMWithState &abmws : abms) {
-			ActiveBlockModifier *abm = abmws.abm;
-			float trigger_interval = abm->getTriggerInterval();
-			if(trigger_interval < 0.001)
-				trigger_interval = 0.001;
-			float actual_interval = dtime_s;
-			if(use_timers){
-				abmws.timer += dtime_s;
-				if(abmws.timer < trigger_interval)
-					continue;
-				abmws.timer -= trigger_interval;
-				actual_interval = trigger_interval;
-			}
+		m_entries.resize(abms.size());
+		for (size_t i = 0; i < abms.size(); i++) {
+			Entry &e = m_entries[i];
+			ActiveBlockModifier *abm = abms[i].abm;
+			e.aabm.abm = abm;
+			e.trigger_interval = MYMAX(abm->getTriggerInterval(), 0.001f);
+			e.simple_catch_up = abm->getSimpleCatchUp();
 			float chance = abm->getTriggerChance();
-			if(chance == 0)
+			if (chance == 0)
 				chance = 1;
-			ActiveABM aabm;
-			aabm.abm = abm;
-			if (abm->getSimpleCatchUp()) {
-				float intervals = actual_interval / trigger_interval;
-				if(intervals == 0)
-					continue;
-				aabm.chance = chance / intervals;
-				if(aabm.chance == 0)
-					aabm.chance = 1;
-			} else {
-				aabm.chance = chance;
-			}
+			e.base_chance = chance;
+			e.aabm.chance = chance;
 
 			// Trigger neighbors
 			const std::vector<std::string> &required_neighbors_s =
 				abm->getRequiredNeighbors();
 			for (const std::string &required_neighbor_s : required_neighbors_s) {
-				ndef->getIds(required_neighbor_s, aabm.required_neighbors);
+				ndef->getIds(required_neighbor_s, e.aabm.required_neighbors);
 			}
-			aabm.check_required_neighbors = !required_neighbors_s.empty();
+			e.aabm.check_required_neighbors = !required_neighbors_s.empty();
 
 			// Trigger contents
 			const std::vector<std::string> &contents_s = abm->getTriggerContents();
@@ -798,19 +950,157 @@ public:
 				ndef->getIds(content_s, ids);
 				for (content_t c : ids) {
 					if (c >= m_aabms.size())
-						m_aabms.resize(c + 256, NULL);
-					if (!m_aabms[c])
-						m_aabms[c] = new std::vector<ActiveABM>;
-					m_aabms[c]->push_back(aabm);
+						m_aabms.resize(c + 256);
+					if (!CONTAINS(m_aabms[c], &e.aabm))
+						m_aabms[c].push_back(&e.aabm);
 				}
 			}
 		}
+		// Entry addresses are stable from here on; schedule the first
+		// triggers at random offsets to spread processing, like
+		// ABMWithState's timer initialization did.
+		for (size_t i = 0; i < m_entries.size(); i++) {
+			u32 slots = slotsFor(m_entries[i].trigger_interval);
+			scheduleIn(i, 1 + myrand() % slots);
+		}
 	}
 
-	~ABMHandler()
+	// Number of ABMs this scheduler was built for, used to detect that
+	// new ABMs were registered and the scheduler must be rebuilt.
+	size_t size() const { return m_num_abms; }
+
+	// Per-content lookup of all registered ABMs. Entries that are not due
+	// in the current cycle have their 'due' flag unset.
+	std::vector<std::vector<ActiveABM *>> &getLookup() { return m_aabms; }
+
+	// Advance the wheel by one slot. Marks the ABMs that are due this
+	// cycle and recomputes their effective chance (simple catch-up).
+	// Returns the number of due ABMs.
+	size_t advance()
+	{
+		m_time += m_slot_width;
+		for (ActiveABM *aabm : m_due)
+			aabm->due = false;
+		m_due.clear();
+
+		m_current_slot = (m_current_slot + 1) % WHEEL_SLOTS;
+		std::vector<size_t> slot;
+		slot.swap(m_slots[m_current_slot]);
+		for (size_t i : slot) {
+			Entry &e = m_entries[i];
+			if (e.rounds > 0) {
+				// Not due until a later wheel rotation
+				e.rounds--;
+				m_slots[m_current_slot].push_back(i);
+				continue;
+			}
+
+			float elapsed = (float)(m_time - e.last_run);
+			e.last_run = m_time;
+			int chance = e.base_chance;
+			if (e.simple_catch_up && elapsed > e.trigger_interval) {
+				float intervals = elapsed / e.trigger_interval;
+				chance = e.base_chance / intervals;
+				if (chance == 0)
+					chance = 1;
+			}
+			e.aabm.chance = chance;
+			e.aabm.due = true;
+			m_due.push_back(&e.aabm);
+
+			scheduleIn(i, slotsFor(e.trigger_interval));
+		}
+		return m_due.size();
+	}
+
+	// Mark the simple-catch-up ABMs whose interval fits within dtime_s as
+	// due for a one-shot catch-up cycle, with their chance scaled for the
+	// number of missed intervals like advance() does. The regular wheel
+	// timing is not touched; the marks stay valid until the next advance()
+	// or setupCatchUp() call. Returns the number of due ABMs.
+	size_t setupCatchUp(float dtime_s)
+	{
+		for (ActiveABM *aabm : m_due)
+			aabm->due = false;
+		m_due.clear();
+
+		for (Entry &e : m_entries) {
+			if (!e.simple_catch_up || dtime_s < e.trigger_interval)
+				continue;
+			float intervals = dtime_s / e.trigger_interval;
+			int chance = e.base_chance / intervals;
+			if (chance == 0)
+				chance = 1;
+			e.aabm.chance = chance;
+			e.aabm.due = true;
+			m_due.push_back(&e.aabm);
+		}
+		return m_due.size();
+	}
+
+private:
+	struct Entry
+	{
+		ActiveABM aabm;
+		float trigger_interval;
+		int base_chance;
+		bool simple_catch_up;
+		u32 rounds = 0; // full wheel rotations left before the entry is due
+		double last_run = 0.0;
+	};
+
+	u32 slotsFor(float interval) const
+	{
+		u32 slots = (u32)(interval / m_slot_width + 0.5f);
+		return MYMAX(slots, 1);
+	}
+
+	void scheduleIn(size_t index, u32 slots_ahead)
+	{
+		u32 rounds = (slots_ahead - 1) / WHEEL_SLOTS;
+		u32 remainder = slots_ahead - rounds * WHEEL_SLOTS;
+		m_entries[index].rounds = rounds;
+		m_slots[(m_current_slot + remainder) % WHEEL_SLOTS].push_back(index);
+	}
+
+	float m_slot_width;
+	size_t m_num_abms;
+	u32 m_current_slot = 0;
+	double m_time = 0.0;
+	std::vector<Entry> m_entries;
+	std::vector<size_t> m_slots[WHEEL_SLOTS];
+	std::vector<std::vector<ActiveABM *>> m_aabms;
+	std::vector<ActiveABM *> m_due;
+};
+
+// A node that passed the content and chance checks during the scan phase.
+// The neighbor check and the actual trigger happen later, serialized.
+struct ABMCandidate
+{
+	v3s16 p0; // node position relative to the block
+	MapNode n; // node as seen by the scan
+	ActiveABM *aabm;
+};
+
+class ABMHandler
+{
+private:
+	ServerEnvironment *m_env;
+	std::vector<std::vector<ActiveABM *>> &m_aabms;
+
+	// Candidate lists larger than this are not cached on the block;
+	// such blocks get a full scan every cycle instead.
+	static const size_t CANDIDATE_CACHE_MAX = 1024;
+
+	// At most this many triggers are applied by a catch-up pass, so that
+	// reactivating a block cannot stall the server thread no matter how
+	// long the block was unloaded.
+	static const size_t CATCHUP_TRIGGERS_MAX = 256;
+public:
+	ABMHandler(ABMScheduler *scheduler, ServerEnvironment *env):
+		m_env(env),
+		m_aabms(scheduler->getLookup())
 	{
-		for (auto &aabms : m_aabms)
-			delete aabms;
 	}
 
 	// Find out how many objects the given block and its neighbours contain.
@@ -841,37 +1131,66 @@ public:
 		return active_object_count;
 
 	}
-	void apply(MapBlock *block, int &blocks_scanned, int &abms_run, int &blocks_cached)
+	// Scan a block for nodes that pass the content and chance checks.
+	// Touches nothing besides the block itself, so multiple blocks can be
+	// scanned concurrently as long as the map is not modified meanwhile.
+	void scan(MapBlock *block, PcgRandom &rng, std::vector<ABMCandidate> &dst,
+		int &blocks_scanned, int &blocks_cached)
 	{
 		if(m_aabms.empty() || block->isDummy())
 			return;
 
-		// Check the content type cache first
-		// to see whether there are any ABMs
-		// to be run at all for this block.
+		// Check the content type cache first to see which of the due ABMs
+		// can trigger in this block at all.
+		std::vector<ActiveABM *> relevant;
 		if (block->contents_cached) {
-			blocks_cached++;
-			bool run_abms = false;
 			for (content_t c : block->contents) {
-				if (c < m_aabms.size() && m_aabms[c]) {
-					run_abms = true;
+				if (c >= m_aabms.size())
+					continue;
+				for (ActiveABM *aabm : m_aabms[c]) {
+					if (aabm->due && !CONTAINS(relevant, aabm))
+						relevant.push_back(aabm);
+				}
+			}
+			if (relevant.empty()) {
+				blocks_cached++;
+				return;
+			}
+
+			// If every relevant ABM has a valid candidate list cached on
+			// the block, the full node scan can be skipped entirely.
+			bool all_cached = true;
+			for (ActiveABM *aabm : relevant) {
+				if (block->abm_candidates.find(aabm->abm) ==
+						block->abm_candidates.end()) {
+					all_cached = false;
 					break;
 				}
 			}
-			if (!run_abms)
+			if (all_cached) {
+				blocks_cached++;
+				for (ActiveABM *aabm : relevant) {
+					for (u16 idx : block->abm_candidates[aabm->abm]) {
+						if (rng.range((u32)aabm->chance) != 0)
+							continue;
+						v3s16 p0(idx % MAP_BLOCKSIZE,
+							(idx / MapBlock::ystride) % MAP_BLOCKSIZE,
+							idx / MapBlock::zstride);
+						dst.push_back({p0, block->getNodeUnsafe(p0), aabm});
+					}
+				}
 				return;
+			}
 		} else {
 			// Clear any caching
 			block->contents.clear();
+			block->abm_candidates.clear();
 		}
 		blocks_scanned++;
 
-		ServerMap *map = &m_env->getServerMap();
-
-		u32 active_object_count_wider;
-		u32 active_object_count = this->countObjects(block, map, active_object_count_wider);
-		m_env->m_added_objects = 0;
-
+		// Full scan; rebuilds the content type cache and the candidate
+		// lists of the due ABMs as a side effect.
+		std::unordered_map<ActiveABM *, std::vector<u16>> found;
 		v3s16 p0;
 		for(p0.X=0; p0.X<MAP_BLOCKSIZE; p0.X++)
 		for(p0.Y=0; p0.Y<MAP_BLOCKSIZE; p0.Y++)
@@ -889,56 +1208,124 @@ public:
 				}
 			}
 
-			if (c >= m_aabms.size() || !m_aabms[c])
+			if (c >= m_aabms.size())
 				continue;
 
-			v3s16 p = p0 + block->getPosRelative();
-			for (ActiveABM &aabm : *m_aabms[c]) {
-				if (myrand() % aabm.chance != 0)
+			for (ActiveABM *aabm : m_aabms[c]) {
+				if (!aabm->due)
+					continue;
+				found[aabm].push_back(p0.Z * MapBlock::zstride +
+					p0.Y * MapBlock::ystride + p0.X);
+				if (rng.range((u32)aabm->chance) != 0)
 					continue;
+				dst.push_back({p0, n, aabm});
+			}
+		}
+		block->contents_cached = !block->do_not_cache_contents;
 
-				// Check neighbors
-				if (aabm.check_required_neighbors) {
-					v3s16 p1;
-					for(p1.X = p0.X-1; p1.X <= p0.X+1; p1.X++)
-					for(p1.Y = p0.Y-1; p1.Y <= p0.Y+1; p1.Y++)
-					for(p1.Z = p0.Z-1; p1.Z <= p0.Z+1; p1.Z++)
-					{
-						if(p1 == p0)
-							continue;
-						content_t c;
-						if (block->isValidPosition(p1)) {
-							// if the neighbor is found on the same map block
-							// get it straight from there
-							const MapNode &n = block->getNodeUnsafe(p1);
-							c = n.getContent();
-						} else {
-							// otherwise consult the map
-							MapNode n = map->getNode(p1 + block->getPosRelative());
-							c = n.getContent();
-						}
-						if (CONTAINS(aabm.required_neighbors, c))
-							goto neighbor_found;
+		// Remember the candidate lists for the next cycles. They stay
+		// valid until raiseModified() invalidates them.
+		if (block->contents_cached) {
+			for (auto &it : found) {
+				if (it.second.size() <= CANDIDATE_CACHE_MAX)
+					block->abm_candidates[it.first->abm] = std::move(it.second);
+			}
+		}
+	}
+
+	// Run the neighbor checks and Lua triggers for the candidates found by
+	// scan(). May modify the map, so this must stay on the server thread.
+	void applyTriggers(MapBlock *block, const std::vector<ABMCandidate> &candidates,
+		int &abms_run)
+	{
+		if (candidates.empty())
+			return;
+
+		ServerMap *map = &m_env->getServerMap();
+
+		u32 active_object_count_wider;
+		u32 active_object_count = this->countObjects(block, map, active_object_count_wider);
+		m_env->m_added_objects = 0;
+
+		for (const ABMCandidate &cand : candidates) {
+			const v3s16 &p0 = cand.p0;
+			// An earlier trigger may have changed the node since the scan
+			const MapNode &n = block->getNodeUnsafe(p0);
+			if (n.getContent() != cand.n.getContent())
+				continue;
+
+			ActiveABM &aabm = *cand.aabm;
+			v3s16 p = p0 + block->getPosRelative();
+
+			// Check neighbors
+			if (aabm.check_required_neighbors) {
+				v3s16 p1;
+				for(p1.X = p0.X-1; p1.X <= p0.X+1; p1.X++)
+				for(p1.Y = p0.Y-1; p1.Y <= p0.Y+1; p1.Y++)
+				for(p1.Z = p0.Z-1; p1.Z <= p0.Z+1; p1.Z++)
+				{
+					if(p1 == p0)
+						continue;
+					content_t c;
+					if (block->isValidPosition(p1)) {
+						// if the neighbor is found on the same map block
+						// get it straight from there
+						const MapNode &n = block->getNodeUnsafe(p1);
+						c = n.getContent();
+					} else {
+						// otherwise consult the map
+						MapNode n = map->getNode(p1 + block->getPosRelative());
+						c = n.getContent();
 					}
-					// No required neighbor found
-					continue;
-				}
-				neighbor_found:
-
-				abms_run++;
-				// Call all the trigger variations
-				aabm.abm->trigger(m_env, p, n);
-				aabm.abm->trigger(m_env, p, n,
-					active_object_count, active_object_count_wider);
-
-				// Count surrounding objects again if the abms added any
-				if(m_env->m_added_objects > 0) {
-					active_object_count = countObjects(block, map, active_object_count_wider);
-					m_env->m_added_objects = 0;
+					if (CONTAINS(aabm.required_neighbors, c))
+						goto neighbor_found;
 				}
+				// No required neighbor found
+				continue;
+			}
+			neighbor_found:
+
+			abms_run++;
+			// Call all the trigger variations
+			aabm.abm->trigger(m_env, p, n);
+			aabm.abm->trigger(m_env, p, n,
+				active_object_count, active_object_count_wider);
+
+			// Count surrounding objects again if the abms added any
+			if(m_env->m_added_objects > 0) {
+				active_object_count = countObjects(block, map, active_object_count_wider);
+				m_env->m_added_objects = 0;
 			}
 		}
-		block->contents_cached = !block->do_not_cache_contents;
+	}
+
+	void apply(MapBlock *block, int &blocks_scanned, int &abms_run, int &blocks_cached)
+	{
+		std::vector<ABMCandidate> candidates;
+		PcgRandom rng(myrand());
+		scan(block, rng, candidates, blocks_scanned, blocks_cached);
+		applyTriggers(block, candidates, abms_run);
+	}
+
+	// Bounded catch-up pass for a reactivated block. Expects the catch-up
+	// chances to have been set up with ABMScheduler::setupCatchUp(); runs
+	// a single scan with them and caps the number of triggers applied.
+	void applyCatchUp(MapBlock *block, int &blocks_scanned, int &abms_run,
+		int &blocks_cached)
+	{
+		std::vector<ABMCandidate> candidates;
+		PcgRandom rng(myrand());
+		scan(block, rng, candidates, blocks_scanned, blocks_cached);
+		if (candidates.size() > CATCHUP_TRIGGERS_MAX) {
+			// Keep a random subset so the cap does not systematically
+			// starve the ABMs or block regions scanned last.
+			for (size_t i = 0; i < CATCHUP_TRIGGERS_MAX; i++) {
+				s32 j = rng.range((s32)i, (s32)candidates.size() - 1);
+				std::swap(candidates[i], candidates[j]);
+			}
+			candidates.resize(CATCHUP_TRIGGERS_MAX);
+		}
+		applyTriggers(block, candidates, abms_run);
 	}
 };
 
@@ -981,8 +1368,8 @@ void ServerEnvironment::activateBlock(MapBlock *block, u32 additional_dtime)
 	m_lbm_mgr.applyLBMs(this, block, stamp);
 
 	// Run node timers
-	std::vector<NodeTimer> elapsed_timers =
-		block->m_node_timers.step((float)dtime_s);
+	std::vector<NodeTimer> elapsed_timers;
+	block->m_node_timers.step((float)dtime_s, elapsed_timers);
 	if (!elapsed_timers.empty()) {
 		MapNode n;
 		for (const NodeTimer &elapsed_timer : elapsed_timers) {
@@ -993,6 +1380,27 @@ void ServerEnvironment::activateBlock(MapBlock *block, u32 additional_dtime)
 					elapsed_timer.position));
 		}
 	}
+
+	/* Statistical ABM catch-up. Instead of replaying every missed ABM cycle
+	   individually, run one batched pass with the trigger chances scaled for
+	   the elapsed time (the same model advance() uses for slow cycles), so
+	   reactivation cost stays bounded no matter how long the block was
+	   unloaded. */
+	if ((float)dtime_s >= m_cache_abm_interval && !m_abms.empty()) {
+		if (!m_abm_scheduler || m_abm_scheduler->size() != m_abms.size()) {
+			delete m_abm_scheduler;
+			m_abm_scheduler = new ABMScheduler(m_abms, m_cache_abm_interval, this);
+		}
+		if (m_abm_scheduler->setupCatchUp((float)dtime_s) > 0) {
+			ABMHandler abmhandler(m_abm_scheduler, this);
+			int blocks_scanned = 0;
+			int abms_run = 0;
+			int blocks_cached = 0;
+			abmhandler.applyCatchUp(block, blocks_scanned, abms_run,
+				blocks_cached);
+			g_profiler->avg("ServerEnv: ABM catch-up triggers", abms_run);
+		}
+	}
 }
 
 void ServerEnvironment::addActiveBlockModifier(ActiveBlockModifier *abm)
@@ -1038,6 +1446,53 @@ bool ServerEnvironment::setNode(v3s16 p, const MapNode &n)
 	return true;
 }
 
+bool ServerEnvironment::bulkSetNode(const std::vector<v3s16> &positions,
+	const MapNode &n)
+{
+	if (positions.empty())
+		return true;
+
+	const NodeDefManager *ndef = m_server->ndef();
+	const ContentFeatures &cf_new = ndef->get(n);
+
+	// Old nodes, kept for the destructor callbacks
+	std::vector<MapNode> oldnodes;
+	oldnodes.reserve(positions.size());
+	for (const v3s16 &p : positions)
+		oldnodes.push_back(m_map->getNode(p));
+
+	// Call destructors
+	for (size_t i = 0; i < positions.size(); i++) {
+		if (ndef->get(oldnodes[i]).has_on_destruct)
+			m_script->node_on_destruct(positions[i], oldnodes[i]);
+	}
+
+	// Replace the nodes with one combined lighting update
+	std::vector<std::pair<v3s16, MapNode>> nodes;
+	nodes.reserve(positions.size());
+	for (const v3s16 &p : positions)
+		nodes.emplace_back(p, n);
+	bool succeeded = m_map->addNodesWithEvent(nodes);
+
+	// Update active VoxelManipulator if a mapgen thread
+	for (const v3s16 &p : positions)
+		m_map->updateVManip(p);
+
+	// Call post-destructors
+	for (size_t i = 0; i < positions.size(); i++) {
+		if (ndef->get(oldnodes[i]).has_after_destruct)
+			m_script->node_after_destruct(positions[i], oldnodes[i]);
+	}
+
+	// Call constructors
+	if (cf_new.has_on_construct) {
+		for (const v3s16 &p : positions)
+			m_script->node_on_construct(p, n);
+	}
+
+	return succeeded;
+}
+
 bool ServerEnvironment::removeNode(v3s16 p)
 {
 	const NodeDefManager *ndef = m_server->ndef();
@@ -1261,10 +1716,16 @@ void ServerEnvironment::step(float dtime)
 		*/
 		// use active_object_send_range_blocks since that is max distance
 		// for active objects sent the client anyway
-		static thread_local const s16 active_object_range =
-				g_settings->getS16("active_object_send_range_blocks");
-		static thread_local const s16 active_block_range =
-				g_settings->getS16("active_block_range");
+		static TunableInt *tune_active_object_range = g_tunables->registerInt(
+				"active_object_send_range_blocks",
+				g_settings->getS16("active_object_send_range_blocks"),
+				1, 64, "Active object send range in mapblocks");
+		static TunableInt *tune_active_block_range = g_tunables->registerInt(
+				"active_block_range",
+				g_settings->getS16("active_block_range"),
+				1, 64, "Active block radius per player in mapblocks");
+		s16 active_object_range = tune_active_object_range->get();
+		s16 active_block_range = tune_active_block_range->get();
 		std::set<v3s16> blocks_removed;
 		std::set<v3s16> blocks_added;
 		m_active_blocks.update(players, active_block_range, active_object_range,
@@ -1293,8 +1754,7 @@ void ServerEnvironment::step(float dtime)
 		for (const v3s16 &p: blocks_added) {
 			MapBlock *block = m_map->getBlockOrEmerge(p);
 			if (!block) {
-				m_active_blocks.m_list.erase(p);
-				m_active_blocks.m_abm_list.erase(p);
+				m_active_blocks.invalidate(p);
 				continue;
 			}
 
@@ -1302,6 +1762,11 @@ void ServerEnvironment::step(float dtime)
 		}
 	}
 
+	/*
+		Activate queued stored objects, bounded per step
+	*/
+	processActivationQueue();
+
 	/*
 		Mess around in active blocks
 	*/
@@ -1310,6 +1775,9 @@ void ServerEnvironment::step(float dtime)
 
 		float dtime = m_cache_nodetimer_interval;
 
+		// Reused across blocks; most blocks have no elapsed timer
+		std::vector<NodeTimer> elapsed_timers;
+
 		for (const v3s16 &p: m_active_blocks.m_list) {
 			MapBlock *block = m_map->getBlockNoCreateNoEx(p);
 			if (!block)
@@ -1327,7 +1795,8 @@ void ServerEnvironment::step(float dtime)
 					MOD_REASON_BLOCK_EXPIRED);
 
 			// Run node timers
-			std::vector<NodeTimer> elapsed_timers = block->m_node_timers.step(dtime);
+			elapsed_timers.clear();
+			block->m_node_timers.step(dtime, elapsed_timers);
 			if (!elapsed_timers.empty()) {
 				MapNode n;
 				v3s16 p2;
@@ -1347,8 +1816,15 @@ void ServerEnvironment::step(float dtime)
 		ScopeProfiler sp(g_profiler, "SEnv: modify in blocks avg per interval", SPT_AVG);
 		TimeTaker timer("modify in active blocks per interval");
 
-		// Initialize handling of ActiveBlockModifiers
-		ABMHandler abmhandler(m_abms, m_cache_abm_interval, this, true);
+		// The scheduler persists across cycles; rebuild it only if ABMs
+		// were registered since it was built.
+		if (!m_abm_scheduler || m_abm_scheduler->size() != m_abms.size()) {
+			delete m_abm_scheduler;
+			m_abm_scheduler = new ABMScheduler(m_abms, m_cache_abm_interval, this);
+		}
+		size_t num_due = m_abm_scheduler->advance();
+
+		ABMHandler abmhandler(m_abm_scheduler, this);
 
 		int blocks_scanned = 0;
 		int abms_run = 0;
@@ -1361,28 +1837,70 @@ void ServerEnvironment::step(float dtime)
 		std::copy(m_active_blocks.m_abm_list.begin(), m_active_blocks.m_abm_list.end(), output.begin());
 		std::shuffle(output.begin(), output.end(), m_rgen);
 
-		int i = 0;
-		// The time budget for ABMs is 20%.
-		u32 max_time_ms = m_cache_abm_interval * 1000 / 5;
+		// Resolve the blocks up front; workers must not touch the map
+		std::vector<MapBlock *> blocks;
+		blocks.reserve(output.size());
 		for (const v3s16 &p : output) {
 			MapBlock *block = m_map->getBlockNoCreateNoEx(p);
 			if (!block)
 				continue;
 
-			i++;
-
 			// Set current time as timestamp
 			block->setTimestampNoChangedFlag(m_game_time);
+			blocks.push_back(block);
+		}
 
+		// Scan the blocks for candidate nodes. The scan is read-only with
+		// respect to the map, so it can be spread over multiple threads;
+		// the Lua triggers below always run on the server thread.
+		std::vector<std::vector<ABMCandidate>> candidates(blocks.size());
+		if (num_due == 0) {
+			// No ABM is due this cycle; nothing to scan
+		} else if (m_abm_workers > 1 && blocks.size() > 1) {
+			std::atomic<size_t> next_block(0);
+			std::vector<int> scanned(m_abm_workers, 0);
+			std::vector<int> cached(m_abm_workers, 0);
+			// Seed on this thread; myrand() is not thread-safe
+			std::vector<u64> seeds(m_abm_workers);
+			for (size_t id = 0; id < m_abm_workers; id++)
+				seeds[id] = myrand();
+			auto worker = [&] (size_t id) {
+				PcgRandom rng(seeds[id]);
+				size_t i;
+				while ((i = next_block.fetch_add(1)) < blocks.size()) {
+					abmhandler.scan(blocks[i], rng, candidates[i],
+						scanned[id], cached[id]);
+				}
+			};
+			std::vector<std::thread> threads;
+			for (size_t id = 1; id < m_abm_workers; id++)
+				threads.emplace_back(worker, id);
+			worker(0);
+			for (std::thread &t : threads)
+				t.join();
+			for (size_t id = 0; id < m_abm_workers; id++) {
+				blocks_scanned += scanned[id];
+				blocks_cached += cached[id];
+			}
+		} else {
+			PcgRandom rng(myrand());
+			for (size_t i = 0; i < blocks.size(); i++)
+				abmhandler.scan(blocks[i], rng, candidates[i],
+					blocks_scanned, blocks_cached);
+		}
+
+		// The time budget for ABMs is 20%.
+		u32 max_time_ms = m_cache_abm_interval * 1000 / 5;
+		for (size_t i = 0; i < blocks.size(); i++) {
 			/* Handle ActiveBlockModifiers */
-			abmhandler.apply(block, blocks_scanned, abms_run, blocks_cached);
+			abmhandler.applyTriggers(blocks[i], candidates[i], abms_run);
 
 			u32 time_ms = timer.getTimerTime();
 
 			if (time_ms > max_time_ms) {
 				warningstream << "active block modifiers took "
-					  << time_ms << "ms (processed " << i << " of "
-					  << output.size() << " active blocks)" << std::endl;
+					  << time_ms << "ms (processed " << (i + 1) << " of "
+					  << blocks.size() << " active blocks)" << std::endl;
 				break;
 			}
 		}
@@ -1421,7 +1939,8 @@ void ServerEnvironment::step(float dtime)
 			obj->step(dtime, send_recommended);
 			// Read messages from object
 			while (!obj->m_messages_out.empty()) {
-				this->m_active_object_messages.push(obj->m_messages_out.front());
+				this->m_active_object_messages.push(
+					std::move(obj->m_messages_out.front()));
 				obj->m_messages_out.pop();
 			}
 		};
@@ -1614,7 +2133,7 @@ ActiveObjectMessage ServerEnvironment::getActiveObjectMessage()
 	if(m_active_object_messages.empty())
 		return ActiveObjectMessage(0);
 
-	ActiveObjectMessage message = m_active_object_messages.front();
+	ActiveObjectMessage message = std::move(m_active_object_messages.front());
 	m_active_object_messages.pop();
 	return message;
 }
@@ -1800,7 +2319,11 @@ static void print_hexdump(std::ostream &o, const std::string &data)
 }
 
 /*
-	Convert stored objects from blocks near the players to active.
+	Queue stored objects from blocks near the players for activation.
+
+	The actual conversion happens in processActivationQueue(), bounded
+	per server step, so that loading an entity-dense block does not
+	activate hundreds of objects within a single tick.
 */
 void ServerEnvironment::activateObjects(MapBlock *block, u32 dtime_s)
 {
@@ -1811,10 +2334,6 @@ void ServerEnvironment::activateObjects(MapBlock *block, u32 dtime_s)
 	if(block->m_static_objects.m_stored.empty())
 		return;
 
-	verbosestream<<"ServerEnvironment::activateObjects(): "
-		<<"activating objects of block "<<PP(block->getPos())
-		<<" ("<<block->m_static_objects.m_stored.size()
-		<<" objects)"<<std::endl;
 	bool large_amount = (block->m_static_objects.m_stored.size() > g_settings->getU16("max_objects_per_block"));
 	if (large_amount) {
 		errorstream<<"suspiciously large amount of objects detected: "
@@ -1828,42 +2347,107 @@ void ServerEnvironment::activateObjects(MapBlock *block, u32 dtime_s)
 		return;
 	}
 
-	// Activate stored objects
-	std::vector<StaticObject> new_stored;
-	for (const StaticObject &s_obj : block->m_static_objects.m_stored) {
-		// Create an active object from the data
-		ServerActiveObject *obj = ServerActiveObject::create
-			((ActiveObjectType) s_obj.type, this, 0, s_obj.pos, s_obj.data);
-		// If couldn't create object, store static data back.
-		if(obj == NULL) {
-			errorstream<<"ServerEnvironment::activateObjects(): "
-				<<"failed to create active object from static object "
-				<<"in block "<<PP(s_obj.pos/BS)
-				<<" type="<<(int)s_obj.type<<" data:"<<std::endl;
-			print_hexdump(verbosestream, s_obj.data);
-
-			new_stored.push_back(s_obj);
+	// Already queued? (happens if the block was deactivated and activated
+	// again before its queue entry was fully drained)
+	for (const PendingActivation &pa : m_activation_queue) {
+		if (pa.blockpos == block->getPos())
+			return;
+	}
+
+	verbosestream<<"ServerEnvironment::activateObjects(): "
+		<<"queueing objects of block "<<PP(block->getPos())
+		<<" ("<<block->m_static_objects.m_stored.size()
+		<<" objects)"<<std::endl;
+	m_activation_queue.push_back({block->getPos(), dtime_s});
+}
+
+/*
+	Convert queued stored objects to active objects, nearest queued
+	block first so entities close to players appear before distant ones.
+*/
+void ServerEnvironment::processActivationQueue()
+{
+	if (m_activation_queue.empty())
+		return;
+
+	static TunableInt *tune_max_activations = g_tunables->registerInt(
+		"max_object_activations_per_step",
+		g_settings->getU16("max_object_activations_per_step"),
+		0, U16_MAX, "Static object activation budget per step, 0 = unlimited");
+	s64 max_activations = tune_max_activations->get();
+	u32 budget = max_activations > 0 ? (u32) max_activations : U32_MAX;
+
+	while (budget > 0 && !m_activation_queue.empty()) {
+		// Pick the queued block nearest to a player
+		size_t best = 0;
+		float best_d = 0.0f;
+		for (size_t i = 0; i < m_activation_queue.size(); i++) {
+			v3f center = intToFloat(m_activation_queue[i].blockpos
+				* MAP_BLOCKSIZE + v3s16(MAP_BLOCKSIZE / 2), BS);
+			float d = getDistanceToNearestPlayer(center);
+			if (d < 0.0f)
+				d = FLT_MAX;
+			if (i == 0 || d < best_d) {
+				best = i;
+				best_d = d;
+			}
+		}
+
+		PendingActivation pa = m_activation_queue[best];
+		MapBlock *block = m_map->getBlockNoCreateNoEx(pa.blockpos);
+		if (!block || block->m_static_objects.m_stored.empty()
+				|| !m_active_blocks.contains(pa.blockpos)) {
+			// Block was unloaded or deactivated again; leftover objects
+			// stay stored and are re-queued on the next activation.
+			m_activation_queue[best] = m_activation_queue.back();
+			m_activation_queue.pop_back();
 			continue;
 		}
-		verbosestream<<"ServerEnvironment::activateObjects(): "
-			<<"activated static object pos="<<PP(s_obj.pos/BS)
-			<<" type="<<(int)s_obj.type<<std::endl;
-		// This will also add the object to the active static list
-		addActiveObjectRaw(obj, false, dtime_s);
-	}
 
-	// Clear stored list
-	block->m_static_objects.m_stored.clear();
-	// Add leftover failed stuff to stored list
-	for (const StaticObject &s_obj : new_stored) {
-		block->m_static_objects.m_stored.push_back(s_obj);
+		// Activate stored objects until the budget runs out
+		std::vector<StaticObject> &stored = block->m_static_objects.m_stored;
+		std::vector<StaticObject> failed;
+		while (budget > 0 && !stored.empty()) {
+			StaticObject s_obj = stored.back();
+			stored.pop_back();
+			budget--;
+			// Create an active object from the data
+			ServerActiveObject *obj = ServerActiveObject::create
+				((ActiveObjectType) s_obj.type, this, 0, s_obj.pos, s_obj.getData());
+			// If couldn't create object, store static data back.
+			if(obj == NULL) {
+				errorstream<<"ServerEnvironment::processActivationQueue(): "
+					<<"failed to create active object from static object "
+					<<"in block "<<PP(s_obj.pos/BS)
+					<<" type="<<(int)s_obj.type<<" data:"<<std::endl;
+				print_hexdump(verbosestream, s_obj.getData());
+
+				failed.push_back(s_obj);
+				continue;
+			}
+			verbosestream<<"ServerEnvironment::processActivationQueue(): "
+				<<"activated static object pos="<<PP(s_obj.pos/BS)
+				<<" type="<<(int)s_obj.type<<std::endl;
+			// This will also add the object to the active static list
+			addActiveObjectRaw(obj, false, pa.dtime_s);
+		}
+
+		// Put failed objects back in front so the rest of the block is
+		// drained before they are retried
+		stored.insert(stored.begin(), failed.begin(), failed.end());
+		if (stored.size() == failed.size()) {
+			// Done with this block; anything left is a failed object and
+			// is retried on the next activation, as before
+			m_activation_queue[best] = m_activation_queue.back();
+			m_activation_queue.pop_back();
+		}
 	}
 
 	/*
-		Note: Block hasn't really been modified here.
+		Note: Blocks haven't really been modified here.
 		The objects have just been activated and moved from the stored
 		static list to the active static list.
-		As such, the block is essentially the same.
+		As such, the blocks are essentially the same.
 		Thus, do not call block->raiseModified(MOD_STATE_WRITE_NEEDED).
 		Otherwise there would be a huge amount of unnecessary I/O.
 	*/
@@ -1950,7 +2534,7 @@ void ServerEnvironment::deactivateFarObjects(bool _force_delete)
 
 						float save_movem = obj->getMinimumSavedMovement();
 
-						if (static_old.data == s_obj.data &&
+						if (static_old.getData() == s_obj.getData() &&
 							(static_old.pos - objectpos).getLength() < save_movem)
 							data_changed = false;
 					} else {
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "server/activeobjectmgr.h"
 #include "util/numeric.h"
+#include <map>
 #include <set>
 #include <random>
 
@@ -38,6 +39,7 @@ class AuthDatabase;
 class PlayerSAO;
 class ServerEnvironment;
 class ActiveBlockModifier;
+class ABMScheduler;
 struct StaticObject;
 class ServerActiveObject;
 class Server;
@@ -169,6 +171,20 @@ public:
 
 	void clear(){
 		m_list.clear();
+		m_abm_list.clear();
+		m_contributions.clear();
+		m_list_refs.clear();
+		m_abm_refs.clear();
+		m_forceloaded_cache.clear();
+		m_retry.clear();
+	}
+
+	// Remove a block whose activation failed from the merged lists while
+	// keeping its reference counts, so the next update() retries it
+	void invalidate(v3s16 p) {
+		m_list.erase(p);
+		m_abm_list.erase(p);
+		m_retry.insert(p);
 	}
 
 	std::set<v3s16> m_list;
@@ -176,6 +192,38 @@ public:
 	std::set<v3s16> m_forceloaded_list;
 
 private:
+	// Cached contribution of one player (or of the forceloaded list), so
+	// that it is only recomputed when the player crosses a mapblock
+	// boundary or turns far enough for the view cone to matter.
+	struct Contribution
+	{
+		v3s16 block_pos;
+		v3f camera_dir;
+		s16 ao_range = 0;
+		bool has_cone = false;
+		bool seen = false;
+		std::set<v3s16> blocks;
+		std::set<v3s16> abm_blocks;
+	};
+
+	// Diff one contributor's block set against its previous state,
+	// maintaining the per-block reference counts and the merged list.
+	static void applyDiff(const std::set<v3s16> &old_blocks,
+		const std::set<v3s16> &new_blocks,
+		std::map<v3s16, u16> &refs, std::set<v3s16> &list,
+		std::set<v3s16> *removed, std::set<v3s16> *added);
+
+	// Keyed by the active object id of the player
+	std::map<u16, Contribution> m_contributions;
+	// Number of contributors per block; a block is active iff its
+	// reference count is nonzero
+	std::map<v3s16, u16> m_list_refs;
+	std::map<v3s16, u16> m_abm_refs;
+	// Copy of m_forceloaded_list as of the last update, diffed against
+	// the live list (which mods mutate at any time between updates)
+	std::set<v3s16> m_forceloaded_cache;
+	// Blocks removed with invalidate(), re-added on the next update
+	std::set<v3s16> m_retry;
 };
 
 /*
@@ -321,6 +369,10 @@ public:
 	bool setNode(v3s16 p, const MapNode &n);
 	bool removeNode(v3s16 p);
 	bool swapNode(v3s16 p, const MapNode &n);
+	// Sets many nodes with a single combined lighting update. The node
+	// callbacks run in phases (all destructors, then all constructors)
+	// instead of interleaved per node.
+	bool bulkSetNode(const std::vector<v3s16> &positions, const MapNode &n);
 
 	// Find all active objects inside a radius around a point
 	void getObjectsInsideRadius(std::vector<u16> &objects, const v3f &pos, float radius)
@@ -328,6 +380,13 @@ public:
 		return m_ao_manager.getObjectsInsideRadius(pos, radius, objects);
 	}
 
+	// Keep the object manager's spatial index in sync; called by
+	// ServerActiveObject::setBasePosition()
+	void updateActiveObjectPosition(u16 id, const v3f &pos)
+	{
+		m_ao_manager.updateObjectPos(id, pos);
+	}
+
 	// Clear objects, loading and going through every MapBlock
 	void clearObjects(ClearObjectsMode mode);
 
@@ -344,12 +403,22 @@ public:
 	 */
 	bool line_of_sight(v3f pos1, v3f pos2, v3s16 *p = NULL);
 
+	/*
+		Check several lines of sight in one go, sharing a block cache.
+		For each line the result is (clear, blocking node position); a
+		line counts as blocked once max_opaque non-air nodes (>= 1) were
+		crossed.
+	*/
+	void line_of_sight_batch(const std::vector<std::pair<v3f, v3f>> &lines,
+			u32 max_opaque, std::vector<std::pair<bool, v3s16>> &results);
+
 	u32 getGameTime() const { return m_game_time; }
 
 	void reportMaxLagEstimate(float f) { m_max_lag_estimate = f; }
 	float getMaxLagEstimate() { return m_max_lag_estimate; }
 
 	std::set<v3s16>* getForceloadedBlocks() { return &m_active_blocks.m_forceloaded_list; };
+	std::set<v3s16>* getActiveBlocks() { return &m_active_blocks.m_list; };
 
 	// Sets the static object status all the active objects in the specified block
 	// This is only really needed for deleting blocks from the map
@@ -359,6 +428,12 @@ public:
 	RemotePlayer *getPlayer(const session_t peer_id);
 	RemotePlayer *getPlayer(const char* name);
 	u32 getPlayerCount() const { return m_players.size(); }
+	size_t getActiveObjectsCount() const
+	{ return m_ao_manager.getActiveObjectsCount(); }
+
+	// Returns the distance (in BS units) from pos to the nearest
+	// connected player, or -1.0f if no player is connected.
+	float getDistanceToNearestPlayer(const v3f &pos);
 
 	static bool migratePlayersDatabase(const GameParams &game_params,
 			const Settings &cmd_args);
@@ -400,10 +475,15 @@ private:
 	void removeRemovedObjects();
 
 	/*
-		Convert stored objects from block to active
+		Queue stored objects of a block for activation
 	*/
 	void activateObjects(MapBlock *block, u32 dtime_s);
 
+	/*
+		Convert queued stored objects to active, bounded per call
+	*/
+	void processActivationQueue();
+
 	/*
 		Convert objects that are not in active blocks to static.
 
@@ -444,6 +524,13 @@ private:
 	IntervalLimiter m_object_management_interval;
 	// List of active blocks
 	ActiveBlockList m_active_blocks;
+	// Blocks whose stored objects still wait for activation
+	// (see activateObjects() / processActivationQueue())
+	struct PendingActivation {
+		v3s16 blockpos;
+		u32 dtime_s;
+	};
+	std::vector<PendingActivation> m_activation_queue;
 	IntervalLimiter m_active_blocks_management_interval;
 	IntervalLimiter m_active_block_modifier_interval;
 	IntervalLimiter m_active_blocks_nodemetadata_interval;
@@ -457,6 +544,10 @@ private:
 	u32 m_last_clear_objects_time = 0;
 	// Active block modifiers
 	std::vector<ABMWithState> m_abms;
+	// Number of threads used for the ABM candidate scan
+	size_t m_abm_workers = 1;
+	// Persistent ABM trigger scheduler, created on first use
+	ABMScheduler *m_abm_scheduler = nullptr;
 	LBMManager m_lbm_mgr;
 	// An interval for generally sending object positions and stuff
 	float m_recommended_send_interval = 0.1f;
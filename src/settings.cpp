@@ -781,6 +781,7 @@ bool Settings::setEntry(const std::string &name, const void *data,
 		entry.group    = set_group ? *(Settings **)data : NULL;
 		entry.is_group = set_group;
 	}
+	bumpGeneration();
 
 	delete old_group;
 
@@ -804,6 +805,31 @@ bool Settings::setDefault(const std::string &name, const std::string &value)
 }
 
 
+void Settings::setDefaults(const SettingDefault *defaults, size_t count)
+{
+	std::vector<Settings *> old_groups;
+
+	{
+		MutexAutoLock lock(m_mutex);
+
+		m_defaults.reserve(m_defaults.size() + count);
+		for (size_t i = 0; i < count; i++) {
+			SettingsEntry &entry = m_defaults[defaults[i].name];
+			if (entry.group)
+				old_groups.push_back(entry.group);
+
+			entry.value    = defaults[i].value;
+			entry.group    = NULL;
+			entry.is_group = false;
+		}
+	}
+	bumpGeneration();
+
+	for (Settings *group : old_groups)
+		delete group;
+}
+
+
 bool Settings::setGroup(const std::string &name, Settings *group)
 {
 	return setEntry(name, &group, true, false);
@@ -916,6 +942,7 @@ bool Settings::remove(const std::string &name)
 		delete it->second.group;
 		m_settings.erase(it);
 		m_mutex.unlock();
+		bumpGeneration();
 
 		doCallbacks(name);
 		return true;
@@ -947,6 +974,7 @@ void Settings::updateValue(const Settings &other, const std::string &name)
 
 	try {
 		m_settings[name] = other.get(name);
+		bumpGeneration();
 	} catch (SettingNotFoundException &e) {
 	}
 }
@@ -996,6 +1024,7 @@ void Settings::updateNoLock(const Settings &other)
 {
 	m_settings.insert(other.m_settings.begin(), other.m_settings.end());
 	m_defaults.insert(other.m_defaults.begin(), other.m_defaults.end());
+	bumpGeneration();
 }
 
 
@@ -1016,6 +1045,7 @@ void Settings::clearDefaultsNoLock()
 			it != m_defaults.end(); ++it)
 		delete it->second.group;
 	m_defaults.clear();
+	bumpGeneration();
 }
 
 
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irrlichttypes_bloated.h"
 #include "util/string.h"
+#include <atomic>
 #include <string>
 #include <list>
 #include <set>
@@ -90,6 +91,12 @@ struct SettingsEntry {
 
 typedef std::unordered_map<std::string, SettingsEntry> SettingEntries;
 
+// A compiled-in default, loaded in bulk via Settings::setDefaults()
+struct SettingDefault {
+	const char *name;
+	const char *value;
+};
+
 class Settings {
 public:
 	Settings() = default;
@@ -190,6 +197,11 @@ public:
 		bool set_group, bool set_default);
 	bool set(const std::string &name, const std::string &value);
 	bool setDefault(const std::string &name, const std::string &value);
+	// Loads a table of compiled-in defaults in one pass: one lock, one
+	// generation bump, and no per-entry name/value validation (the table
+	// entries are trusted literals).  Later duplicates override earlier
+	// ones, so platform override blocks can just follow the base entries.
+	void setDefaults(const SettingDefault *defaults, size_t count);
 	bool setGroup(const std::string &name, Settings *group);
 	bool setGroupDefault(const std::string &name, Settings *group);
 	bool setBool(const std::string &name, bool value);
@@ -220,11 +232,23 @@ public:
 	void deregisterChangedCallback(const std::string &name,
 		SettingsChangedCallback cbf, void *userdata = NULL);
 
+	// Counter incremented on every modification; polling it is much
+	// cheaper than a getter call, see SettingsCache below
+	u64 getGeneration() const
+	{
+		return m_generation.load(std::memory_order_relaxed);
+	}
+
 private:
 	void updateNoLock(const Settings &other);
 	void clearNoLock();
 	void clearDefaultsNoLock();
 
+	void bumpGeneration()
+	{
+		m_generation.fetch_add(1, std::memory_order_relaxed);
+	}
+
 	void doCallbacks(const std::string &name) const;
 
 	SettingEntries m_settings;
@@ -237,4 +261,43 @@ private:
 	// All methods that access m_settings/m_defaults directly should lock this.
 	mutable std::mutex m_mutex;
 
+	// Bumped by every method that modifies m_settings/m_defaults
+	std::atomic<u64> m_generation{1};
+
+};
+
+/*
+	Typed cache of resolved setting values for per-frame/per-tick code.
+
+	Derive from this, store the subscribed values as plain members filled
+	in by readSettings(), and call poll() at the top of the hot loop:
+	readSettings() only runs when the settings generation has changed, so
+	steady-state polling costs one atomic load instead of a mutex and a
+	string lookup per value, while runtime reconfiguration keeps working.
+*/
+class SettingsCache
+{
+public:
+	SettingsCache(Settings *settings) : m_cache_settings(settings) {}
+	virtual ~SettingsCache() = default;
+
+	// Refreshes the cached values if anything changed the settings since
+	// the last call. Returns true if readSettings() ran.
+	bool poll()
+	{
+		u64 generation = m_cache_settings->getGeneration();
+		if (generation == m_cache_generation)
+			return false;
+		m_cache_generation = generation;
+		readSettings(m_cache_settings);
+		return true;
+	}
+
+protected:
+	// Resolve and store the subscribed values
+	virtual void readSettings(Settings *settings) = 0;
+
+private:
+	Settings *m_cache_settings;
+	u64 m_cache_generation = 0;
 };
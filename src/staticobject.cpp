@@ -25,7 +25,7 @@ StaticObject::StaticObject(const ServerActiveObject *s_obj, const v3f &pos_):
 	type(s_obj->getType()),
 	pos(pos_)
 {
-	s_obj->getStaticData(&data);
+	s_obj->getStaticData(&m_data);
 }
 
 void StaticObject::serialize(std::ostream &os)
@@ -35,7 +35,13 @@ void StaticObject::serialize(std::ostream &os)
 	// pos
 	writeV3F1000(os, pos);
 	// data
-	os<<serializeString(data);
+	if (m_raw) {
+		// Not materialized; write the slice straight from the raw buffer
+		writeU16(os, m_raw_size);
+		os.write(m_raw->data() + m_raw_offset, m_raw_size);
+	} else {
+		os<<serializeString(m_data);
+	}
 }
 void StaticObject::deSerialize(std::istream &is, u8 version)
 {
@@ -44,7 +50,8 @@ void StaticObject::deSerialize(std::istream &is, u8 version)
 	// pos
 	pos = readV3F1000(is);
 	// data
-	data = deSerializeString(is);
+	m_data = deSerializeString(is);
+	m_raw = nullptr;
 }
 
 void StaticObjectList::serialize(std::ostream &os)
@@ -90,9 +97,26 @@ void StaticObjectList::deSerialize(std::istream &is)
 	u8 version = readU8(is);
 	// count
 	u16 count = readU16(is);
+
+	// Decode the headers eagerly but keep all data blobs together in one
+	// shared buffer; each object only records its slice of it. The
+	// majority of stored objects are re-serialized without ever being
+	// activated, so their data never needs to be split out.
+	std::shared_ptr<std::string> raw = std::make_shared<std::string>();
+	m_stored.reserve(count);
 	for(u16 i = 0; i < count; i++) {
 		StaticObject s_obj;
-		s_obj.deSerialize(is, version);
+		// type
+		s_obj.type = readU8(is);
+		// pos
+		s_obj.pos = readV3F1000(is);
+		// data, as an opaque slice
+		u16 size = readU16(is);
+		u32 offset = raw->size();
+		raw->resize(offset + size);
+		if (size > 0)
+			is.read(&(*raw)[offset], size);
+		s_obj.setDataSlice(raw, offset, size);
 		m_stored.push_back(s_obj);
 	}
 }
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include "irrlichttypes_bloated.h"
+#include <memory>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -32,13 +33,50 @@ struct StaticObject
 {
 	u8 type = 0;
 	v3f pos;
-	std::string data;
 
 	StaticObject() = default;
 	StaticObject(const ServerActiveObject *s_obj, const v3f &pos_);
 
 	void serialize(std::ostream &os);
 	void deSerialize(std::istream &is, u8 version);
+
+	/*
+		The object data blob. Objects decoded from a block keep it as an
+		opaque slice of the shared raw buffer (see
+		StaticObjectList::deSerialize) and only materialize their own
+		copy when it is first asked for; most stored objects are
+		re-serialized without ever being activated.
+	*/
+	const std::string &getData() const
+	{
+		if (m_raw) {
+			m_data.assign(*m_raw, m_raw_offset, m_raw_size);
+			m_raw = nullptr;
+		}
+		return m_data;
+	}
+
+	void setData(const std::string &d)
+	{
+		m_data = d;
+		m_raw = nullptr;
+	}
+
+	void setDataSlice(const std::shared_ptr<const std::string> &raw,
+		u32 offset, u32 size)
+	{
+		m_raw = raw;
+		m_raw_offset = offset;
+		m_raw_size = size;
+	}
+
+private:
+	friend class StaticObjectList;
+
+	mutable std::string m_data;
+	mutable std::shared_ptr<const std::string> m_raw;
+	u32 m_raw_offset = 0;
+	u32 m_raw_size = 0;
 };
 
 class StaticObjectList
@@ -0,0 +1,75 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "threading/shared_mutex.h"
+
+void SharedMutex::lock()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_writers_waiting++;
+	m_writer_cv.wait(lock, [this] {
+		return m_readers == 0 && !m_writer_active;
+	});
+	m_writers_waiting--;
+	m_writer_active = true;
+}
+
+bool SharedMutex::try_lock()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_readers > 0 || m_writer_active)
+		return false;
+	m_writer_active = true;
+	return true;
+}
+
+void SharedMutex::unlock()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_writer_active = false;
+	if (m_writers_waiting > 0)
+		m_writer_cv.notify_one();
+	else
+		m_reader_cv.notify_all();
+}
+
+void SharedMutex::lock_shared()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_reader_cv.wait(lock, [this] {
+		return !m_writer_active && m_writers_waiting == 0;
+	});
+	m_readers++;
+}
+
+bool SharedMutex::try_lock_shared()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_writer_active || m_writers_waiting > 0)
+		return false;
+	m_readers++;
+	return true;
+}
+
+void SharedMutex::unlock_shared()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (--m_readers == 0 && m_writers_waiting > 0)
+		m_writer_cv.notify_one();
+}
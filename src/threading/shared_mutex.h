@@ -0,0 +1,80 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+
+/*
+	A reader-writer mutex (std::shared_mutex is C++17, we build as C++11).
+
+	Writer-preferring: once a writer is waiting, new readers block until
+	it has run, so a steady stream of readers cannot starve writers like
+	the environment step. Neither lock is recursive.
+
+	lock()/try_lock()/unlock() follow the BasicLockable/Lockable concepts,
+	so writers can use std::unique_lock<SharedMutex> (including
+	std::defer_lock / std::try_to_lock construction).
+*/
+class SharedMutex
+{
+public:
+	// Exclusive (writer) lock
+	void lock();
+	bool try_lock();
+	void unlock();
+
+	// Shared (reader) lock
+	void lock_shared();
+	bool try_lock_shared();
+	void unlock_shared();
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_reader_cv;
+	std::condition_variable m_writer_cv;
+	u32 m_readers = 0;
+	u32 m_writers_waiting = 0;
+	bool m_writer_active = false;
+};
+
+// RAII helpers in the style of MutexAutoLock
+using SharedMutexWriteLock = std::unique_lock<SharedMutex>;
+
+class SharedMutexReadLock
+{
+public:
+	SharedMutexReadLock(SharedMutex &mutex) : m_mutex(mutex)
+	{
+		m_mutex.lock_shared();
+	}
+
+	~SharedMutexReadLock()
+	{
+		m_mutex.unlock_shared();
+	}
+
+	DISABLE_CLASS_COPY(SharedMutexReadLock)
+
+private:
+	SharedMutex &m_mutex;
+};
@@ -0,0 +1,232 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "thread_pool.h"
+#include "threading/mutex_auto_lock.h"
+#include "threading/thread.h"
+#include "debug.h"
+#include "util/numeric.h"
+#include "util/string.h"
+
+static ThreadPool main_thread_pool("Pool");
+ThreadPool *g_thread_pool = &main_thread_pool;
+
+class PoolWorkerThread : public Thread
+{
+public:
+	PoolWorkerThread(ThreadPool *pool, const std::string &name):
+		Thread(name),
+		m_pool(pool)
+	{
+	}
+
+private:
+	void *run()
+	{
+		m_pool->workerLoop();
+		return nullptr;
+	}
+
+	ThreadPool *m_pool;
+};
+
+ThreadPool::ThreadPool(const std::string &name):
+	m_name(name)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+	stop();
+}
+
+void ThreadPool::start(u32 thread_count, bool bind_affinity)
+{
+	if (isStarted())
+		return;
+
+	const u32 num_cores = Thread::getNumberOfProcessors();
+	if (thread_count == 0)
+		thread_count = num_cores;
+	thread_count = rangelim(thread_count, 1, 64);
+
+	m_stop_requested = false;
+	for (u32 i = 0; i < thread_count; i++) {
+		PoolWorkerThread *worker =
+				new PoolWorkerThread(this, m_name + itos(i));
+		worker->start();
+		if (bind_affinity)
+			worker->bindToProcessor(i % num_cores);
+		m_workers.push_back(worker);
+	}
+}
+
+void ThreadPool::stop()
+{
+	if (!isStarted())
+		return;
+
+	{
+		MutexAutoLock lock(m_mutex);
+		// Discard everything that has not started yet; running tasks
+		// finish and balance the group counters on their way out
+		for (int prio = 0; prio < TASK_PRIORITY_COUNT; prio++) {
+			for (const Task &task : m_queues[prio])
+				m_groups[task.group_id].admitted--;
+			m_queues[prio].clear();
+		}
+		for (Group &group : m_groups) {
+			for (int prio = 0; prio < TASK_PRIORITY_COUNT; prio++)
+				group.deferred[prio].clear();
+		}
+		m_stop_requested = true;
+	}
+	m_task_cond.notify_all();
+
+	for (PoolWorkerThread *worker : m_workers) {
+		worker->wait();
+		delete worker;
+	}
+	m_workers.clear();
+}
+
+u32 ThreadPool::registerGroup(const std::string &name, u32 max_running)
+{
+	MutexAutoLock lock(m_mutex);
+	Group group;
+	group.name = name;
+	group.max_running = max_running;
+	m_groups.push_back(std::move(group));
+	return m_groups.size() - 1;
+}
+
+void ThreadPool::setGroupLimit(u32 group_id, u32 max_running)
+{
+	{
+		MutexAutoLock lock(m_mutex);
+		sanity_check(group_id < m_groups.size());
+		m_groups[group_id].max_running = max_running;
+		admitDeferred(group_id);
+	}
+	m_task_cond.notify_all();
+}
+
+void ThreadPool::submit(u32 group_id, TaskPriority priority,
+		std::function<void()> fn)
+{
+	// Without workers the task still has to run somewhere
+	if (!isStarted()) {
+		fn();
+		return;
+	}
+
+	{
+		MutexAutoLock lock(m_mutex);
+		sanity_check(group_id < m_groups.size());
+		Group &group = m_groups[group_id];
+		if (group.admitted >= groupLimit(group)) {
+			group.deferred[priority].push_back(std::move(fn));
+			return;
+		}
+		group.admitted++;
+		m_queues[priority].push_back(Task{group_id, std::move(fn)});
+	}
+	m_task_cond.notify_one();
+}
+
+void ThreadPool::drainGroup(u32 group_id)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	sanity_check(group_id < m_groups.size());
+	Group &group = m_groups[group_id];
+
+	for (int prio = 0; prio < TASK_PRIORITY_COUNT; prio++)
+		group.deferred[prio].clear();
+	for (int prio = 0; prio < TASK_PRIORITY_COUNT; prio++) {
+		std::deque<Task> &queue = m_queues[prio];
+		for (auto it = queue.begin(); it != queue.end();) {
+			if (it->group_id == group_id) {
+				it = queue.erase(it);
+				group.admitted--;
+			} else {
+				++it;
+			}
+		}
+	}
+
+	m_idle_cond.wait(lock, [&] {
+		return m_groups[group_id].running == 0;
+	});
+}
+
+u32 ThreadPool::admitDeferred(u32 group_id)
+{
+	Group &group = m_groups[group_id];
+	u32 admitted = 0;
+	while (group.admitted < groupLimit(group)) {
+		int prio = TASK_PRIORITY_COUNT - 1;
+		while (prio >= 0 && group.deferred[prio].empty())
+			prio--;
+		if (prio < 0)
+			break;
+		group.admitted++;
+		m_queues[prio].push_back(Task{group_id,
+				std::move(group.deferred[prio].front())});
+		group.deferred[prio].pop_front();
+		admitted++;
+	}
+	return admitted;
+}
+
+void ThreadPool::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		Task task;
+		bool have_task = false;
+		for (int prio = TASK_PRIORITY_COUNT - 1; prio >= 0; prio--) {
+			if (!m_queues[prio].empty()) {
+				task = std::move(m_queues[prio].front());
+				m_queues[prio].pop_front();
+				have_task = true;
+				break;
+			}
+		}
+		if (!have_task) {
+			if (m_stop_requested)
+				return;
+			m_task_cond.wait(lock);
+			continue;
+		}
+
+		m_groups[task.group_id].running++;
+		lock.unlock();
+		task.fn();
+		lock.lock();
+
+		// registerGroup() may have grown the vector in between
+		Group &group = m_groups[task.group_id];
+		group.running--;
+		group.admitted--;
+		if (admitDeferred(task.group_id) > 0)
+			m_task_cond.notify_all();
+		if (group.running == 0)
+			m_idle_cond.notify_all();
+	}
+}
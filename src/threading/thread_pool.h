@@ -0,0 +1,115 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+
+class PoolWorkerThread;
+
+// Higher priorities run first
+enum TaskPriority {
+	TASK_PRIORITY_LOW = 0,
+	TASK_PRIORITY_NORMAL,
+	TASK_PRIORITY_HIGH,
+	TASK_PRIORITY_COUNT,
+};
+
+/*
+	A shared pool of worker threads for short-lived tasks, so subsystems do
+	not each spin up their own workers and oversubscribe small machines.
+
+	Subsystems register a named group with a concurrency cap; the cap bounds
+	how many of the group's tasks run at once (adjustable at runtime via
+	setGroupLimit()), so one bursty producer cannot monopolize the pool.
+	Groups are never unregistered; they live for the process lifetime.
+
+	If the pool has not been started, submit() runs the task inline on the
+	calling thread, so callers need no fallback path of their own.
+*/
+class ThreadPool
+{
+public:
+	friend class PoolWorkerThread;
+
+	ThreadPool(const std::string &name);
+	~ThreadPool();
+
+	// thread_count == 0 selects one worker per processor core
+	void start(u32 thread_count, bool bind_affinity);
+	// Finishes running tasks, discards pending ones and joins the workers
+	void stop();
+
+	bool isStarted() const { return !m_workers.empty(); }
+
+	// max_running == 0 means no cap beyond the pool size
+	u32 registerGroup(const std::string &name, u32 max_running);
+	void setGroupLimit(u32 group_id, u32 max_running);
+
+	void submit(u32 group_id, TaskPriority priority, std::function<void()> fn);
+
+	// Discards the group's pending tasks and waits until none of its tasks
+	// are running anymore. Call before destroying state the tasks use.
+	void drainGroup(u32 group_id);
+
+private:
+	struct Task {
+		u32 group_id;
+		std::function<void()> fn;
+	};
+	struct Group {
+		std::string name;
+		u32 max_running;
+		// Tasks sitting in the run queues or currently running
+		u32 admitted = 0;
+		u32 running = 0;
+		// Tasks held back by the concurrency cap, per priority
+		std::deque<std::function<void()>> deferred[TASK_PRIORITY_COUNT];
+	};
+
+	// Runs tasks until stop(); executed by every worker thread
+	void workerLoop();
+	// Moves deferred tasks of the group into the run queues as far as its
+	// cap allows and returns how many it moved. m_mutex must be held.
+	u32 admitDeferred(u32 group_id);
+
+	static u32 groupLimit(const Group &group)
+	{
+		return group.max_running == 0 ? U32_MAX : group.max_running;
+	}
+
+	std::string m_name;
+	std::mutex m_mutex;
+	std::condition_variable m_task_cond;
+	// Signalled whenever a group runs out of work, for drainGroup()
+	std::condition_variable m_idle_cond;
+	std::vector<Group> m_groups;
+	std::deque<Task> m_queues[TASK_PRIORITY_COUNT];
+	std::vector<PoolWorkerThread *> m_workers;
+	bool m_stop_requested = false;
+};
+
+// Process-wide pool, started from init_common()
+extern ThreadPool *g_thread_pool;
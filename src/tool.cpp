@@ -25,6 +25,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "exceptions.h"
 #include "util/serialize.h"
 #include "util/numeric.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
 
 void ToolGroupCap::toJson(Json::Value &object) const
 {
@@ -182,8 +186,100 @@ void ToolCapabilities::deserializeJson(std::istream &is)
 	}
 }
 
+/*
+	Dig param resolution runs on every pointed-node frame for every
+	digging player (and again from Lua), so results are memoized. The
+	cache key is a canonical (sorted) byte rendering of the node groups
+	and of the tool capability fields the result depends on; keeping
+	the full key in the map means distinct inputs can never alias each
+	other the way plain hashes could.
+*/
+
+template <typename T>
+static void appendKeyBytes(std::string &key, T val)
+{
+	char buf[sizeof(T)];
+	memcpy(buf, &val, sizeof(T));
+	key.append(buf, sizeof(T));
+}
+
+static void appendDigGroupsKey(std::string &key, const ItemGroupList &groups)
+{
+	std::vector<const ItemGroupList::value_type *> sorted;
+	sorted.reserve(groups.size());
+	for (const auto &group : groups)
+		sorted.push_back(&group);
+	std::sort(sorted.begin(), sorted.end(),
+		[](const ItemGroupList::value_type *a,
+			const ItemGroupList::value_type *b) {
+			return a->first < b->first;
+		});
+	for (const auto *group : sorted) {
+		key += group->first;
+		key += '\0';
+		appendKeyBytes(key, (s32)group->second);
+	}
+}
+
+static void appendToolCapabilitiesKey(std::string &key, const ToolCapabilities *tp)
+{
+	std::vector<const ToolGCMap::value_type *> sorted;
+	sorted.reserve(tp->groupcaps.size());
+	for (const auto &groupcap : tp->groupcaps)
+		sorted.push_back(&groupcap);
+	std::sort(sorted.begin(), sorted.end(),
+		[](const ToolGCMap::value_type *a, const ToolGCMap::value_type *b) {
+			return a->first < b->first;
+		});
+	for (const auto *groupcap : sorted) {
+		const ToolGroupCap &cap = groupcap->second;
+		key += groupcap->first;
+		key += '\0';
+		appendKeyBytes(key, (s32)cap.maxlevel);
+		appendKeyBytes(key, (s32)cap.uses);
+		std::vector<std::pair<int, float>> times(cap.times.begin(),
+			cap.times.end());
+		std::sort(times.begin(), times.end(),
+			[](const std::pair<int, float> &a, const std::pair<int, float> &b) {
+				return a.first < b.first;
+			});
+		appendKeyBytes(key, (u32)times.size());
+		for (const auto &time : times) {
+			appendKeyBytes(key, (s32)time.first);
+			appendKeyBytes(key, time.second);
+		}
+	}
+}
+
+static DigParams getDigParamsUncached(const ItemGroupList &groups,
+		const ToolCapabilities *tp);
+
 DigParams getDigParams(const ItemGroupList &groups,
 		const ToolCapabilities *tp)
+{
+	// Thread-local since both the client and the server thread resolve
+	// dig params; bounded by periodically dropping the whole cache.
+	thread_local std::unordered_map<std::string, DigParams> dig_params_cache;
+
+	std::string key;
+	key.reserve(64);
+	appendToolCapabilitiesKey(key, tp);
+	key += '|';
+	appendDigGroupsKey(key, groups);
+
+	auto cached = dig_params_cache.find(key);
+	if (cached != dig_params_cache.end())
+		return cached->second;
+
+	DigParams params = getDigParamsUncached(groups, tp);
+	if (dig_params_cache.size() >= 1024)
+		dig_params_cache.clear();
+	dig_params_cache[std::move(key)] = params;
+	return params;
+}
+
+static DigParams getDigParamsUncached(const ItemGroupList &groups,
+		const ToolCapabilities *tp)
 {
 	// Group dig_immediate defaults to fixed time and no wear
 	if (tp->groupcaps.find("dig_immediate") == tp->groupcaps.cend()) {
@@ -30,6 +30,8 @@ public:
 
 	void genericStoreTest(AreaStore *store);
 	void testVectorStore();
+	void testRTreeStore();
+	void testRTreeBulkLoad();
 	void testSpatialStore();
 	void testSerialization();
 };
@@ -39,6 +41,8 @@ static TestAreaStore g_test_instance;
 void TestAreaStore::runTests(IGameDef *gamedef)
 {
 	TEST(testVectorStore);
+	TEST(testRTreeStore);
+	TEST(testRTreeBulkLoad);
 #if USE_SPATIAL
 	TEST(testSpatialStore);
 #endif
@@ -53,6 +57,50 @@ void TestAreaStore::testVectorStore()
 	genericStoreTest(&store);
 }
 
+void TestAreaStore::testRTreeStore()
+{
+	RTreeAreaStore store;
+	genericStoreTest(&store);
+}
+
+void TestAreaStore::testRTreeBulkLoad()
+{
+	// Enough areas that the STR build produces several tree levels
+	RTreeAreaStore store;
+	std::vector<Area> areas;
+	for (s16 i = 0; i < 1000; i++) {
+		Area a(v3s16(i * 10, 0, 0), v3s16(i * 10 + 5, 10, 10));
+		areas.push_back(a);
+	}
+	store.bulkInsert(areas);
+	UASSERTEQ(size_t, store.size(), 1000);
+
+	std::vector<Area *> res;
+	store.getAreasForPos(&res, v3s16(4203, 5, 5));
+	UASSERTEQ(size_t, res.size(), 1);
+	UASSERTEQ(s16, res[0]->minedge.X, 4200);
+	res.clear();
+
+	store.getAreasInArea(&res, v3s16(0, 0, 0), v3s16(100, 10, 10), false);
+	UASSERTEQ(size_t, res.size(), 10);
+	res.clear();
+
+	// Mixed tree and pending-list content
+	Area b(v3s16(4201, 2, 2), v3s16(4204, 8, 8));
+	store.insertArea(&b);
+	store.getAreasForPos(&res, v3s16(4203, 5, 5));
+	UASSERTEQ(size_t, res.size(), 2);
+	res.clear();
+
+	UASSERT(store.removeArea(b.id));
+	store.getAreasForPos(&res, v3s16(4203, 5, 5));
+	UASSERTEQ(size_t, res.size(), 1);
+	UASSERT(store.removeArea(res[0]->id));
+	res.clear();
+	store.getAreasForPos(&res, v3s16(4203, 5, 5));
+	UASSERTEQ(size_t, res.size(), 0);
+}
+
 void TestAreaStore::testSpatialStore()
 {
 #if USE_SPATIAL
@@ -26,9 +26,16 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 class TestClientActiveObject : public ClientActiveObject
 {
 public:
-	TestClientActiveObject() : ClientActiveObject(0, nullptr, nullptr) {}
+	TestClientActiveObject(const v3f &pos = v3f()) :
+			ClientActiveObject(0, nullptr, nullptr), m_position(pos) {}
 	~TestClientActiveObject() = default;
 	ActiveObjectType getType() const { return ACTIVEOBJECT_TYPE_TEST; }
+
+	const v3f getPosition() const { return m_position; }
+	void setPosition(const v3f &pos) { m_position = pos; }
+
+private:
+	v3f m_position;
 };
 
 class TestClientActiveObjectMgr : public TestBase
@@ -42,6 +49,8 @@ public:
 	void testFreeID();
 	void testRegisterObject();
 	void testRemoveObject();
+	void testGetActiveObjects();
+	void testGetActiveObjectsMoved();
 };
 
 static TestClientActiveObjectMgr g_test_instance;
@@ -51,6 +60,8 @@ void TestClientActiveObjectMgr::runTests(IGameDef *gamedef)
 	TEST(testFreeID);
 	TEST(testRegisterObject)
 	TEST(testRemoveObject)
+	TEST(testGetActiveObjects)
+	TEST(testGetActiveObjectsMoved)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -115,3 +126,64 @@ void TestClientActiveObjectMgr::testRemoveObject()
 
 	caomgr.clear();
 }
+
+void TestClientActiveObjectMgr::testGetActiveObjects()
+{
+	client::ActiveObjectMgr caomgr;
+	static const v3f cao_pos[] = {
+			v3f(10, 40, 10),
+			v3f(740, 100, -304),
+			v3f(-200, 100, -304),
+			v3f(740, -740, -304),
+			v3f(1500, -740, -304),
+	};
+
+	for (const auto &p : cao_pos) {
+		caomgr.registerObject(new TestClientActiveObject(p));
+	}
+
+	std::vector<DistanceSortedActiveObject> result;
+	caomgr.getActiveObjects(v3f(), 50, result);
+	UASSERTCMP(int, ==, result.size(), 1);
+
+	result.clear();
+	caomgr.getActiveObjects(v3f(), 750, result);
+	UASSERTCMP(int, ==, result.size(), 2);
+
+	caomgr.clear();
+}
+
+void TestClientActiveObjectMgr::testGetActiveObjectsMoved()
+{
+	client::ActiveObjectMgr caomgr;
+
+	// Enough objects that the radius query uses the spatial grid
+	// instead of the plain scan
+	std::vector<TestClientActiveObject *> caos;
+	for (int i = 0; i < 20; i++) {
+		auto tcao = new TestClientActiveObject(v3f(i * 500, 0, 0));
+		UASSERT(caomgr.registerObject(tcao));
+		caos.push_back(tcao);
+	}
+
+	std::vector<DistanceSortedActiveObject> result;
+	caomgr.getActiveObjects(v3f(10000, 0, 0), 50, result);
+	UASSERTCMP(int, ==, result.size(), 0);
+
+	// Move one object far away; stepping re-bins it, so the query must
+	// find it at the new position and no longer at the old one
+	TestClientActiveObject *moved = caos[0];
+	moved->setPosition(v3f(10000, 0, 0));
+	caomgr.step(0.0f, [](ClientActiveObject *cao) {});
+
+	result.clear();
+	caomgr.getActiveObjects(v3f(10000, 0, 0), 50, result);
+	UASSERTCMP(int, ==, result.size(), 1);
+	UASSERT(result[0].obj == moved);
+
+	result.clear();
+	caomgr.getActiveObjects(v3f(), 50, result);
+	UASSERTCMP(int, ==, result.size(), 0);
+
+	caomgr.clear();
+}
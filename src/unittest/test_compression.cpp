@@ -37,6 +37,7 @@ public:
 	void testRLECompression();
 	void testZlibCompression();
 	void testZlibLargeData();
+	void testZlibStreaming();
 };
 
 static TestCompression g_test_instance;
@@ -46,6 +47,7 @@ void TestCompression::runTests(IGameDef *gamedef)
 	TEST(testRLECompression);
 	TEST(testZlibCompression);
 	TEST(testZlibLargeData);
+	TEST(testZlibStreaming);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -170,3 +172,34 @@ void TestCompression::testZlibLargeData()
 				i, str_decompressed[i], i, data_in[i]);
 	}
 }
+
+void TestCompression::testZlibStreaming()
+{
+	std::string pieces[3];
+	pieces[0] = "The quick brown fox ";
+	pieces[1].append(10000, 'z');
+	pieces[2] = " jumps over the lazy dog";
+
+	// Several writes must produce one stream holding the concatenation
+	std::ostringstream os_compressed(std::ios_base::binary);
+	ZlibCompressor compressor(os_compressed);
+	for (const std::string &piece : pieces)
+		compressor.write(piece);
+	compressor.finish();
+
+	std::istringstream is_compressed(os_compressed.str(),
+			std::ios_base::binary);
+	std::ostringstream os_decompressed(std::ios_base::binary);
+	decompressZlib(is_compressed, os_decompressed);
+
+	UASSERT(os_decompressed.str() == pieces[0] + pieces[1] + pieces[2]);
+
+	// The cached context must come out clean for the next stream,
+	// including one at a different compression level
+	std::ostringstream os2(std::ios_base::binary);
+	compressZlib(pieces[0], os2, 1);
+	std::istringstream is2(os2.str(), std::ios_base::binary);
+	std::ostringstream os2_decompressed(std::ios_base::binary);
+	decompressZlib(is2, os2_decompressed);
+	UASSERT(os2_decompressed.str() == pieces[0]);
+}
@@ -32,10 +32,12 @@ public:
 	void runTests(IGameDef *gamedef);
 
 	void testSerializeDeserialize(IItemDefManager *idef);
+	void testItemStackDeserialize(IItemDefManager *idef);
 
 	static const char *serialized_inventory_in;
 	static const char *serialized_inventory_out;
 	static const char *serialized_inventory_inc;
+	static const char *serialized_inventory_inc_slot;
 };
 
 static TestInventory g_test_instance;
@@ -43,6 +45,7 @@ static TestInventory g_test_instance;
 void TestInventory::runTests(IGameDef *gamedef)
 {
 	TEST(testSerializeDeserialize, gamedef->getItemDefManager());
+	TEST(testItemStackDeserialize, gamedef->getItemDefManager());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -72,6 +75,14 @@ void TestInventory::testSerializeDeserialize(IItemDefManager *idef)
 	inv.serialize(inv_os, true);
 	UASSERTEQ(std::string, inv_os.str(), serialized_inventory_inc);
 
+	// Changing one slot turns only that slot into a non-"Keep" line
+	inv.getList("main")->changeItem(2, ItemStack("default:dirt", 5, 0, idef));
+	inv_os.str("");
+	inv_os.clear();
+	inv.serialize(inv_os, true);
+	UASSERTEQ(std::string, inv_os.str(), serialized_inventory_inc_slot);
+	inv.setModified(false);
+
 	ItemStack leftover = inv.getList("main")->takeItem(7, 99 - 12);
 	ItemStack wanted = ItemStack("default:dirt", 99 - 12, 0, idef);
 	UASSERT(leftover == wanted);
@@ -80,6 +91,35 @@ void TestInventory::testSerializeDeserialize(IItemDefManager *idef)
 	UASSERT(leftover == wanted);
 }
 
+void TestInventory::testItemStackDeserialize(IItemDefManager *idef)
+{
+	// The string overload takes a fast path for plain itemstrings; it has
+	// to agree with the stream parser on all of these
+	const char *itemstrings[] = {
+		"default:dirt",
+		"default:dirt 5",
+		"default:dirt 99 0",
+		"default:pick_stone 1 21323",
+		"not_registered_anywhere 4",
+		"default:dirt 0",
+		"\"quoted name\" 2",
+		"",
+	};
+
+	for (const char *itemstring : itemstrings) {
+		ItemStack fast;
+		fast.deSerialize(itemstring, idef);
+
+		std::istringstream is(itemstring, std::ios::binary);
+		ItemStack ref;
+		ref.deSerialize(is, idef);
+
+		UASSERTEQ(std::string, fast.name, ref.name);
+		UASSERTEQ(u16, fast.count, ref.count);
+		UASSERTEQ(u16, fast.wear, ref.wear);
+	}
+}
+
 const char *TestInventory::serialized_inventory_in =
 	"List 0 10\n"
 	"Width 3\n"
@@ -124,3 +164,20 @@ const char *TestInventory::serialized_inventory_inc =
 	"KeepList main\n"
 	"KeepList abc\n"
 	"EndInventory\n";
+
+const char *TestInventory::serialized_inventory_inc_slot =
+	"List main 10\n"
+	"Width 5\n"
+	"Keep\n"
+	"Keep\n"
+	"Item default:dirt 5\n"
+	"Keep\n"
+	"Keep\n"
+	"Keep\n"
+	"Keep\n"
+	"Keep\n"
+	"Keep\n"
+	"Keep\n"
+	"EndInventoryList\n"
+	"KeepList abc\n"
+	"EndInventory\n";
@@ -37,6 +37,8 @@ public:
 	void testPcgRandomRange();
 	void testPcgRandomBytes();
 	void testPcgRandomNormalDist();
+	void testPcgRandomFill();
+	void testBufferedPcgRandom();
 
 	static const int expected_pseudorandom_results[256];
 	static const u32 expected_pcgrandom_results[256];
@@ -54,6 +56,8 @@ void TestRandom::runTests(IGameDef *gamedef)
 	TEST(testPcgRandomRange);
 	TEST(testPcgRandomBytes);
 	TEST(testPcgRandomNormalDist);
+	TEST(testPcgRandomFill);
+	TEST(testBufferedPcgRandom);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -186,6 +190,52 @@ void TestRandom::testPcgRandomNormalDist()
 }
 
 
+void TestRandom::testPcgRandomFill()
+{
+	PcgRandom filled(814538, 998877);
+	PcgRandom reference(814538, 998877);
+	u32 buf[1000];
+
+	// fill() must emit exactly the next() sequence for any length,
+	// including the scalar small-length and tail paths
+	static const size_t lens[] = {1, 7, 15, 16, 17, 19, 100, 256, 1000};
+	for (size_t len : lens) {
+		filled.fill(buf, len);
+		for (size_t i = 0; i != len; i++)
+			UASSERTEQ(u32, buf[i], reference.next());
+	}
+
+	// ...and leave the generator state as if next() had been called
+	for (u32 i = 0; i != 100; i++)
+		UASSERTEQ(u32, filled.next(), reference.next());
+}
+
+
+void TestRandom::testBufferedPcgRandom()
+{
+	PcgRandom wrapped(555, 777);
+	PcgRandom reference(555, 777);
+	BufferedPcgRandom buffered(wrapped);
+
+	// The buffered stream must match the unbuffered generator value for
+	// value, for both raw values and (rejection-sampled) ranges
+	for (u32 i = 0; i != 10000; i++) {
+		switch (i % 3) {
+		case 0:
+			UASSERTEQ(u32, buffered.next(), reference.next());
+			break;
+		case 1:
+			UASSERTEQ(u32, buffered.range(1 + i), reference.range(1 + i));
+			break;
+		default:
+			UASSERTEQ(s32, buffered.range(-200, (s32)(i % 3000)),
+				reference.range(-200, (s32)(i % 3000)));
+			break;
+		}
+	}
+}
+
+
 const int TestRandom::expected_pseudorandom_results[256] = {
 	0x02fa, 0x60d5, 0x6c10, 0x606b, 0x098b, 0x5f1e, 0x4f56, 0x3fbd, 0x77af,
 	0x4fe9, 0x419a, 0x6fe1, 0x177b, 0x6858, 0x36f8, 0x6d83, 0x14fc, 0x2d62,
@@ -44,6 +44,7 @@ public:
 	void testVecPut();
 	void testStringLengthLimits();
 	void testBufReader();
+	void testBulkEndian();
 	void testFloatFormat();
 
 	std::string teststring2;
@@ -72,6 +73,7 @@ void TestSerialization::runTests(IGameDef *gamedef)
 	TEST(testVecPut);
 	TEST(testStringLengthLimits);
 	TEST(testBufReader);
+	TEST(testBulkEndian);
 	TEST(testFloatFormat);
 }
 
@@ -625,6 +627,54 @@ void TestSerialization::testBufReader()
 	UASSERT(!buf.getRawDataNoEx(raw_data, sizeof(raw_data)));
 }
 
+void TestSerialization::testBulkEndian()
+{
+	static const u32 count = 67; // deliberately not a multiple of a SIMD lane
+
+	u16 src16[count];
+	u32 src32[count];
+	for (u32 i = 0; i < count; i++) {
+		src16[i] = 0x0102 * (i + 1);
+		src32[i] = 0x01020304 * (i + 1);
+	}
+
+	// The bulk results must match the element-wise routines exactly
+	u8 buf[4 * count];
+	writeU16Bulk(buf, src16, count);
+	for (u32 i = 0; i < count; i++)
+		UASSERT(readU16(&buf[2 * i]) == src16[i]);
+	u16 dest16[count];
+	readU16Bulk(buf, dest16, count);
+	UASSERT(!memcmp(dest16, src16, sizeof(src16)));
+
+	writeU32Bulk(buf, src32, count);
+	for (u32 i = 0; i < count; i++)
+		UASSERT(readU32(&buf[4 * i]) == src32[i]);
+	u32 dest32[count];
+	readU32Bulk(buf, dest32, count);
+	UASSERT(!memcmp(dest32, src32, sizeof(src32)));
+
+	// Strided access, as used for fields of struct arrays
+	struct {
+		u16 value;
+		u16 pad;
+	} strided[count];
+	for (u32 i = 0; i < count; i++) {
+		strided[i].value = src16[i];
+		strided[i].pad = 0xDEAD;
+	}
+	writeU16Bulk(buf, &strided[0].value, count, sizeof(strided[0]));
+	for (u32 i = 0; i < count; i++)
+		UASSERT(readU16(&buf[2 * i]) == src16[i]);
+
+	memset(strided, 0, sizeof(strided));
+	readU16Bulk(buf, &strided[0].value, count, sizeof(strided[0]));
+	for (u32 i = 0; i < count; i++) {
+		UASSERT(strided[i].value == src16[i]);
+		UASSERT(strided[i].pad == 0);
+	}
+}
+
 void TestSerialization::testFloatFormat()
 {
 	FloatType type = getFloatSerializationType();
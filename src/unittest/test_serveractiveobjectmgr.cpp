@@ -47,6 +47,7 @@ public:
 	void testRegisterObject();
 	void testRemoveObject();
 	void testGetObjectsInsideRadius();
+	void testGetObjectsInsideRadiusMoved();
 	void testGetAddedActiveObjectsAroundPos();
 };
 
@@ -58,6 +59,7 @@ void TestServerActiveObjectMgr::runTests(IGameDef *gamedef)
 	TEST(testRegisterObject)
 	TEST(testRemoveObject)
 	TEST(testGetObjectsInsideRadius);
+	TEST(testGetObjectsInsideRadiusMoved);
 	TEST(testGetAddedActiveObjectsAroundPos);
 }
 
@@ -159,6 +161,41 @@ void TestServerActiveObjectMgr::testGetObjectsInsideRadius()
 	clearSAOMgr(&saomgr);
 }
 
+void TestServerActiveObjectMgr::testGetObjectsInsideRadiusMoved()
+{
+	server::ActiveObjectMgr saomgr;
+
+	// Enough objects that the radius query uses the spatial grid
+	// instead of the plain scan
+	std::vector<TestServerActiveObject *> saos;
+	for (int i = 0; i < 20; i++) {
+		auto tsao = new TestServerActiveObject(v3f(i * 500, 0, 0));
+		UASSERT(saomgr.registerObject(tsao));
+		saos.push_back(tsao);
+	}
+
+	std::vector<u16> result;
+	saomgr.getObjectsInsideRadius(v3f(10000, 0, 0), 50, result);
+	UASSERTCMP(int, ==, result.size(), 0);
+
+	// Move one object far away; the query must find it at the new
+	// position and no longer at the old one
+	TestServerActiveObject *moved = saos[0];
+	moved->setBasePosition(v3f(10000, 0, 0));
+	saomgr.updateObjectPos(moved->getId(), moved->getBasePosition());
+
+	result.clear();
+	saomgr.getObjectsInsideRadius(v3f(10000, 0, 0), 50, result);
+	UASSERTCMP(int, ==, result.size(), 1);
+	UASSERT(result[0] == moved->getId());
+
+	result.clear();
+	saomgr.getObjectsInsideRadius(v3f(), 50, result);
+	UASSERTCMP(int, ==, result.size(), 0);
+
+	clearSAOMgr(&saomgr);
+}
+
 void TestServerActiveObjectMgr::testGetAddedActiveObjectsAroundPos()
 {
 	server::ActiveObjectMgr saomgr;
@@ -21,7 +21,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <atomic>
 #include "threading/semaphore.h"
+#include "threading/shared_mutex.h"
 #include "threading/thread.h"
+#include "threading/thread_pool.h"
+#include "util/container.h"
 
 
 class TestThreading : public TestBase {
@@ -33,6 +36,9 @@ public:
 	void testStartStopWait();
 	void testThreadKill();
 	void testAtomicSemaphoreThread();
+	void testMPMCQueue();
+	void testThreadPool();
+	void testSharedMutex();
 };
 
 static TestThreading g_test_instance;
@@ -42,6 +48,9 @@ void TestThreading::runTests(IGameDef *gamedef)
 	TEST(testStartStopWait);
 	TEST(testThreadKill);
 	TEST(testAtomicSemaphoreThread);
+	TEST(testMPMCQueue);
+	TEST(testThreadPool);
+	TEST(testSharedMutex);
 }
 
 class SimpleTestThread : public Thread {
@@ -181,3 +190,247 @@ void TestThreading::testAtomicSemaphoreThread()
 	UASSERT(val == num_threads * 0x10000);
 }
 
+
+class MPMCProducerThread : public Thread {
+public:
+	MPMCProducerThread(MPMCQueue<u32> &queue, u32 count) :
+		Thread("MPMCProducer"),
+		m_queue(queue),
+		m_count(count)
+	{
+	}
+
+private:
+	void *run()
+	{
+		for (u32 i = 1; i <= m_count; i++) {
+			while (!m_queue.push_back(i))
+				sleep_ms(0);
+		}
+		return NULL;
+	}
+
+	MPMCQueue<u32> &m_queue;
+	u32 m_count;
+};
+
+class MPMCConsumerThread : public Thread {
+public:
+	MPMCConsumerThread(MPMCQueue<u32> &queue, std::atomic<u64> &sum,
+			std::atomic<u32> &taken, u32 expected) :
+		Thread("MPMCConsumer"),
+		m_queue(queue),
+		m_sum(sum),
+		m_taken(taken),
+		m_expected(expected)
+	{
+	}
+
+private:
+	void *run()
+	{
+		u32 val;
+		while (m_taken < m_expected) {
+			if (m_queue.pop_front(&val)) {
+				m_sum += val;
+				m_taken++;
+			} else {
+				sleep_ms(0);
+			}
+		}
+		return NULL;
+	}
+
+	MPMCQueue<u32> &m_queue;
+	std::atomic<u64> &m_sum;
+	std::atomic<u32> &m_taken;
+	u32 m_expected;
+};
+
+
+void TestThreading::testMPMCQueue()
+{
+	static const u8 num_producers = 4;
+	static const u8 num_consumers = 4;
+	static const u32 per_producer = 10000;
+
+	// Deliberately much smaller than the item count so the queue
+	// repeatedly fills up and drains
+	MPMCQueue<u32> queue(64);
+	std::atomic<u64> sum(0);
+	std::atomic<u32> taken(0);
+
+	MPMCProducerThread *producers[num_producers];
+	MPMCConsumerThread *consumers[num_consumers];
+	for (auto &thread : producers) {
+		thread = new MPMCProducerThread(queue, per_producer);
+		UASSERT(thread->start());
+	}
+	for (auto &thread : consumers) {
+		thread = new MPMCConsumerThread(queue, sum, taken,
+				num_producers * per_producer);
+		UASSERT(thread->start());
+	}
+
+	for (MPMCProducerThread *thread : producers) {
+		thread->wait();
+		delete thread;
+	}
+	for (MPMCConsumerThread *thread : consumers) {
+		thread->wait();
+		delete thread;
+	}
+
+	UASSERT(taken == num_producers * per_producer);
+	UASSERT(sum == (u64)num_producers * per_producer * (per_producer + 1) / 2);
+
+	// The queue must be empty again
+	u32 val;
+	UASSERT(queue.pop_front(&val) == false);
+}
+
+
+void TestThreading::testThreadPool()
+{
+	ThreadPool pool("TestPool");
+	pool.start(4, false);
+
+	static const u32 group_limit = 2;
+	static const u32 num_tasks = 200;
+
+	u32 group = pool.registerGroup("test", group_limit);
+	std::atomic<u32> done(0);
+	std::atomic<u32> running(0);
+	std::atomic<bool> cap_exceeded(false);
+
+	for (u32 i = 0; i < num_tasks; i++) {
+		pool.submit(group, TASK_PRIORITY_NORMAL, [&] {
+			if (++running > group_limit)
+				cap_exceeded = true;
+			sleep_ms(0);
+			--running;
+			done++;
+		});
+	}
+
+	while (done < num_tasks)
+		sleep_ms(1);
+	// Everything is done already, so this must return immediately
+	pool.drainGroup(group);
+
+	UASSERT(done == num_tasks);
+	UASSERT(!cap_exceeded);
+
+	// An unstarted pool runs tasks inline
+	pool.stop();
+	bool ran_inline = false;
+	pool.submit(group, TASK_PRIORITY_NORMAL, [&] { ran_inline = true; });
+	UASSERT(ran_inline);
+}
+
+
+class RWWriterThread : public Thread {
+public:
+	RWWriterThread(SharedMutex &rwlock, u32 *counters, u32 count) :
+		Thread("RWWriter"),
+		m_rwlock(rwlock),
+		m_counters(counters),
+		m_count(count)
+	{
+	}
+
+private:
+	void *run()
+	{
+		for (u32 i = 0; i < m_count; i++) {
+			SharedMutexWriteLock lock(m_rwlock);
+			m_counters[0]++;
+			m_counters[1]++;
+		}
+		return NULL;
+	}
+
+	SharedMutex &m_rwlock;
+	u32 *m_counters;
+	u32 m_count;
+};
+
+class RWReaderThread : public Thread {
+public:
+	RWReaderThread(SharedMutex &rwlock, const u32 *counters,
+			std::atomic<bool> &torn) :
+		Thread("RWReader"),
+		m_rwlock(rwlock),
+		m_counters(counters),
+		m_torn(torn)
+	{
+	}
+
+private:
+	void *run()
+	{
+		while (!stopRequested()) {
+			SharedMutexReadLock lock(m_rwlock);
+			// Both counters move together under the write lock, so a
+			// reader seeing them differ means a writer got in beside us
+			if (m_counters[0] != m_counters[1])
+				m_torn = true;
+		}
+		return NULL;
+	}
+
+	SharedMutex &m_rwlock;
+	const u32 *m_counters;
+	std::atomic<bool> &m_torn;
+};
+
+
+void TestThreading::testSharedMutex()
+{
+	SharedMutex rwlock;
+
+	// Readers may share the lock, but they exclude writers (and the
+	// other way around)
+	UASSERT(rwlock.try_lock_shared());
+	UASSERT(rwlock.try_lock_shared());
+	UASSERT(rwlock.try_lock() == false);
+	rwlock.unlock_shared();
+	rwlock.unlock_shared();
+	UASSERT(rwlock.try_lock());
+	UASSERT(rwlock.try_lock_shared() == false);
+	UASSERT(rwlock.try_lock() == false);
+	rwlock.unlock();
+
+	static const u8 num_writers = 2;
+	static const u8 num_readers = 4;
+	static const u32 per_writer = 10000;
+
+	u32 counters[2] = {0, 0};
+	std::atomic<bool> torn(false);
+
+	RWReaderThread *readers[num_readers];
+	for (auto &thread : readers) {
+		thread = new RWReaderThread(rwlock, counters, torn);
+		UASSERT(thread->start());
+	}
+
+	RWWriterThread *writers[num_writers];
+	for (auto &thread : writers) {
+		thread = new RWWriterThread(rwlock, counters, per_writer);
+		UASSERT(thread->start());
+	}
+
+	for (RWWriterThread *thread : writers) {
+		thread->wait();
+		delete thread;
+	}
+	for (RWReaderThread *thread : readers) {
+		thread->stop();
+		thread->wait();
+		delete thread;
+	}
+
+	UASSERT(!torn);
+	UASSERT(counters[0] == num_writers * per_writer);
+	UASSERT(counters[1] == num_writers * per_writer);
+}
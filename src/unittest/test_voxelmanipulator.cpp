@@ -34,6 +34,7 @@ public:
 
 	void testVoxelArea();
 	void testVoxelManipulator(const NodeDefManager *nodedef);
+	void testVoxelManipulatorGrowth();
 };
 
 static TestVoxelManipulator g_test_instance;
@@ -42,6 +43,7 @@ void TestVoxelManipulator::runTests(IGameDef *gamedef)
 {
 	TEST(testVoxelArea);
 	TEST(testVoxelManipulator, gamedef->getNodeDefManager());
+	TEST(testVoxelManipulatorGrowth);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -106,3 +108,37 @@ void TestVoxelManipulator::testVoxelManipulator(const NodeDefManager *nodedef)
 	UASSERT(v.getNode(v3s16(-1,0,-1)).getContent() == t_CONTENT_GRASS);
 	EXCEPTION_CHECK(InvalidPositionException, v.getNode(v3s16(0,1,1)));
 }
+
+
+void TestVoxelManipulator::testVoxelManipulatorGrowth()
+{
+	VoxelManipulator v;
+
+	// Data must survive growth along Z (the contiguous slab fast path)
+	v.addArea(VoxelArea(v3s16(-2,-2,-2), v3s16(2,2,2)));
+	v.setNode(v3s16(-2,-2,-2), MapNode(t_CONTENT_STONE));
+	v.setNode(v3s16(2,2,2), MapNode(t_CONTENT_GRASS));
+
+	v.addArea(VoxelArea(v3s16(-2,-2,-5), v3s16(2,2,5)));
+	UASSERT(v.m_area == VoxelArea(v3s16(-2,-2,-5), v3s16(2,2,5)));
+	UASSERT(v.getNode(v3s16(-2,-2,-2)).getContent() == t_CONTENT_STONE);
+	UASSERT(v.getNode(v3s16(2,2,2)).getContent() == t_CONTENT_GRASS);
+	EXCEPTION_CHECK(InvalidPositionException, v.getNode(v3s16(0,0,5)));
+
+	// ...and growth along every axis (the general relayout path)
+	v.addArea(VoxelArea(v3s16(-6,-6,-6), v3s16(6,6,6)));
+	UASSERT(v.getNode(v3s16(-2,-2,-2)).getContent() == t_CONTENT_STONE);
+	UASSERT(v.getNode(v3s16(2,2,2)).getContent() == t_CONTENT_GRASS);
+
+	// A reservation covers the area without creating data, and makes
+	// later addArea calls inside it no-ops
+	VoxelManipulator r;
+	r.reserveArea(VoxelArea(v3s16(0,0,0), v3s16(15,15,15)));
+	UASSERT(r.m_area.contains(v3s16(15,15,15)));
+	UASSERT(!r.exists(v3s16(0,0,0)));
+
+	r.setNode(v3s16(7,7,7), MapNode(t_CONTENT_STONE));
+	r.addArea(VoxelArea(v3s16(4,4,4), v3s16(11,11,11)));
+	UASSERT(r.m_area == VoxelArea(v3s16(0,0,0), v3s16(15,15,15)));
+	UASSERT(r.getNode(v3s16(7,7,7)).getContent() == t_CONTENT_STONE);
+}
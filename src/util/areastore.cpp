@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/areastore.h"
 #include "util/serialize.h"
 #include "util/container.h"
+#include <algorithm>
+#include <cmath>
 
 #if USE_SPATIAL
 	#include <spatialindex/SpatialIndex.h>
@@ -50,7 +52,7 @@ AreaStore *AreaStore::getOptimalImplementation()
 #if USE_SPATIAL
 	return new SpatialAreaStore();
 #else
-	return new VectorAreaStore();
+	return new RTreeAreaStore();
 #endif
 }
 
@@ -110,11 +112,18 @@ void AreaStore::deserialize(std::istream &is)
 
 	bool read_ids = is.good(); // EOF for old formats
 
-	for (auto &area : areas) {
-		if (read_ids)
+	if (read_ids) {
+		for (auto &area : areas)
 			area.id = readU32(is);
-		insertArea(&area);
 	}
+
+	bulkInsert(areas);
+}
+
+void AreaStore::bulkInsert(std::vector<Area> &areas)
+{
+	for (Area &area : areas)
+		insertArea(&area);
 }
 
 void AreaStore::invalidateCache()
@@ -242,6 +251,281 @@ void VectorAreaStore::getAreasInArea(std::vector<Area *> *result,
 	}
 }
 
+////
+// RTreeAreaStore
+////
+
+static inline void expand_box(v3s16 &minedge, v3s16 &maxedge,
+		const v3s16 &mine, const v3s16 &maxe)
+{
+	minedge.X = MYMIN(minedge.X, mine.X);
+	minedge.Y = MYMIN(minedge.Y, mine.Y);
+	minedge.Z = MYMIN(minedge.Z, mine.Z);
+	maxedge.X = MYMAX(maxedge.X, maxe.X);
+	maxedge.Y = MYMAX(maxedge.Y, maxe.Y);
+	maxedge.Z = MYMAX(maxedge.Z, maxe.Z);
+}
+
+// One Sort-Tile-Recursive pass: orders `order` so that consecutive runs
+// of `cap` items form spatially coherent tiles. `center` maps an item
+// and an axis (0..2) to the item's doubled box center on that axis.
+template <typename GetCenter>
+static void str_order(std::vector<u32> &order, u32 cap, const GetCenter &center)
+{
+	u32 n = order.size();
+	if (n <= cap)
+		return;
+
+	u32 num_groups = (n + cap - 1) / cap;
+	u32 nx = (u32)std::ceil(std::cbrt((double)num_groups));
+	u32 slab_x = (n + nx - 1) / nx;
+
+	std::sort(order.begin(), order.end(),
+		[&center](u32 a, u32 b) { return center(a, 0) < center(b, 0); });
+
+	for (u32 xb = 0; xb < n; xb += slab_x) {
+		u32 xe = MYMIN(n, xb + slab_x);
+		u32 s = xe - xb;
+		u32 groups_here = (s + cap - 1) / cap;
+		u32 ny = (u32)std::ceil(std::sqrt((double)groups_here));
+		u32 slab_y = (s + ny - 1) / ny;
+
+		std::sort(order.begin() + xb, order.begin() + xe,
+			[&center](u32 a, u32 b) { return center(a, 1) < center(b, 1); });
+
+		for (u32 yb = xb; yb < xe; yb += slab_y) {
+			u32 ye = MYMIN(xe, yb + slab_y);
+			std::sort(order.begin() + yb, order.begin() + ye,
+				[&center](u32 a, u32 b) { return center(a, 2) < center(b, 2); });
+		}
+	}
+}
+
+void RTreeAreaStore::rebuild()
+{
+	m_nodes.clear();
+	m_children.clear();
+	m_entries.clear();
+	m_pending.clear();
+	m_root = U32_MAX;
+
+	if (areas_map.empty())
+		return;
+
+	std::vector<Area *> all;
+	all.reserve(areas_map.size());
+	for (auto &it : areas_map)
+		all.push_back(&it.second);
+
+	std::vector<u32> order(all.size());
+	for (u32 i = 0; i < order.size(); i++)
+		order[i] = i;
+	str_order(order, NODE_CAPACITY, [&all](u32 c, int axis) -> s32 {
+		const Area *a = all[c];
+		switch (axis) {
+		case 0: return (s32)a->minedge.X + a->maxedge.X;
+		case 1: return (s32)a->minedge.Y + a->maxedge.Y;
+		default: return (s32)a->minedge.Z + a->maxedge.Z;
+		}
+	});
+
+	// Leaf level
+	std::vector<u32> level;
+	u32 n = order.size();
+	m_entries.reserve(n);
+	for (u32 begin = 0; begin < n; begin += NODE_CAPACITY) {
+		u32 cnt = MYMIN(NODE_CAPACITY, n - begin);
+		Node node;
+		node.leaf = true;
+		node.first = m_entries.size();
+		node.count = cnt;
+		node.minedge = all[order[begin]]->minedge;
+		node.maxedge = all[order[begin]]->maxedge;
+		for (u32 i = begin; i < begin + cnt; i++) {
+			Area *a = all[order[i]];
+			m_entries.push_back(a);
+			expand_box(node.minedge, node.maxedge, a->minedge, a->maxedge);
+		}
+		level.push_back(m_nodes.size());
+		m_nodes.push_back(node);
+	}
+
+	// Upper levels, until a single root remains
+	while (level.size() > 1) {
+		str_order(level, NODE_CAPACITY, [this](u32 c, int axis) -> s32 {
+			const Node &nd = m_nodes[c];
+			switch (axis) {
+			case 0: return (s32)nd.minedge.X + nd.maxedge.X;
+			case 1: return (s32)nd.minedge.Y + nd.maxedge.Y;
+			default: return (s32)nd.minedge.Z + nd.maxedge.Z;
+			}
+		});
+		std::vector<u32> next;
+		u32 ln = level.size();
+		for (u32 begin = 0; begin < ln; begin += NODE_CAPACITY) {
+			u32 cnt = MYMIN(NODE_CAPACITY, ln - begin);
+			Node node;
+			node.leaf = false;
+			node.first = m_children.size();
+			node.count = cnt;
+			node.minedge = m_nodes[level[begin]].minedge;
+			node.maxedge = m_nodes[level[begin]].maxedge;
+			for (u32 i = begin; i < begin + cnt; i++) {
+				const Node &child = m_nodes[level[i]];
+				m_children.push_back(level[i]);
+				expand_box(node.minedge, node.maxedge,
+						child.minedge, child.maxedge);
+			}
+			next.push_back(m_nodes.size());
+			m_nodes.push_back(node);
+		}
+		level.swap(next);
+	}
+	m_root = level[0];
+}
+
+bool RTreeAreaStore::insertArea(Area *a)
+{
+	if (a->id == U32_MAX)
+		a->id = getNextId();
+	std::pair<AreaMap::iterator, bool> res =
+			areas_map.insert(std::make_pair(a->id, *a));
+	if (!res.second)
+		// ID is not unique
+		return false;
+	m_pending.push_back(&res.first->second);
+	if (m_pending.size() >= PENDING_REBUILD_LIMIT)
+		rebuild();
+	invalidateCache();
+	return true;
+}
+
+void RTreeAreaStore::bulkInsert(std::vector<Area> &areas)
+{
+	// Areas with known ids first, so that fresh ids cannot collide
+	for (Area &area : areas) {
+		if (area.id != U32_MAX)
+			areas_map.insert(std::make_pair(area.id, area));
+	}
+	for (Area &area : areas) {
+		if (area.id == U32_MAX) {
+			area.id = getNextId();
+			areas_map.insert(std::make_pair(area.id, area));
+		}
+	}
+	rebuild();
+	invalidateCache();
+}
+
+bool RTreeAreaStore::removeArea(u32 id)
+{
+	AreaMap::iterator it = areas_map.find(id);
+	if (it == areas_map.end())
+		return false;
+	Area *a = &it->second;
+
+	std::vector<Area *>::iterator p_it =
+			std::find(m_pending.begin(), m_pending.end(), a);
+	if (p_it != m_pending.end())
+		m_pending.erase(p_it);
+	else if (m_root != U32_MAX)
+		removeFromTree(m_root, a);
+
+	areas_map.erase(it);
+	invalidateCache();
+	return true;
+}
+
+bool RTreeAreaStore::removeFromTree(u32 node_id, Area *a)
+{
+	Node &node = m_nodes[node_id];
+	if (!AST_CONTAINS_AREA(node.minedge, node.maxedge, a))
+		return false;
+
+	if (node.leaf) {
+		for (u32 i = 0; i < node.count; i++) {
+			if (m_entries[node.first + i] == a) {
+				// Swap-remove within the leaf's range
+				m_entries[node.first + i] =
+						m_entries[node.first + node.count - 1];
+				node.count--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	for (u32 i = 0; i < node.count; i++) {
+		if (removeFromTree(m_children[node.first + i], a))
+			return true;
+	}
+	return false;
+}
+
+void RTreeAreaStore::queryNode(u32 node_id, std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap) const
+{
+	const Node &node = m_nodes[node_id];
+	if (!AST_AREAS_OVERLAP(minedge, maxedge, (&node)))
+		return;
+
+	if (node.leaf) {
+		for (u32 i = 0; i < node.count; i++) {
+			Area *area = m_entries[node.first + i];
+			if (accept_overlap ? AST_AREAS_OVERLAP(minedge, maxedge, area) :
+					AST_CONTAINS_AREA(minedge, maxedge, area)) {
+				result->push_back(area);
+			}
+		}
+	} else {
+		for (u32 i = 0; i < node.count; i++)
+			queryNode(m_children[node.first + i], result,
+					minedge, maxedge, accept_overlap);
+	}
+}
+
+void RTreeAreaStore::queryNodePos(u32 node_id, std::vector<Area *> *result,
+		v3s16 pos) const
+{
+	const Node &node = m_nodes[node_id];
+	if (!AST_CONTAINS_PT((&node), pos))
+		return;
+
+	if (node.leaf) {
+		for (u32 i = 0; i < node.count; i++) {
+			Area *area = m_entries[node.first + i];
+			if (AST_CONTAINS_PT(area, pos))
+				result->push_back(area);
+		}
+	} else {
+		for (u32 i = 0; i < node.count; i++)
+			queryNodePos(m_children[node.first + i], result, pos);
+	}
+}
+
+void RTreeAreaStore::getAreasForPosImpl(std::vector<Area *> *result, v3s16 pos)
+{
+	for (Area *area : m_pending) {
+		if (AST_CONTAINS_PT(area, pos))
+			result->push_back(area);
+	}
+	if (m_root != U32_MAX)
+		queryNodePos(m_root, result, pos);
+}
+
+void RTreeAreaStore::getAreasInArea(std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap)
+{
+	for (Area *area : m_pending) {
+		if (accept_overlap ? AST_AREAS_OVERLAP(minedge, maxedge, area) :
+				AST_CONTAINS_AREA(minedge, maxedge, area)) {
+			result->push_back(area);
+		}
+	}
+	if (m_root != U32_MAX)
+		queryNode(m_root, result, minedge, maxedge, accept_overlap);
+}
+
 #if USE_SPATIAL
 
 static inline SpatialIndex::Region get_spatial_region(const v3s16 minedge,
@@ -69,6 +69,11 @@ public:
 	/// @return Whether the area insertion was successful.
 	virtual bool insertArea(Area *a) = 0;
 
+	/// Inserts many areas at once, assigning IDs to those that lack
+	/// one. The default just calls insertArea() per area;
+	/// implementations may build their index in bulk instead.
+	virtual void bulkInsert(std::vector<Area> &areas);
+
 	/// Removes an area from the store by ID.
 	/// @return Whether the area was in the store and removed.
 	virtual bool removeArea(u32 id) = 0;
@@ -144,6 +149,57 @@ private:
 };
 
 
+/*
+	An in-memory R-tree bulk-loaded with the Sort-Tile-Recursive (STR)
+	algorithm, so deserializing a large store builds the whole index in
+	one pass instead of one insertion at a time. Later insertions go to
+	a small pending list that is scanned linearly and folded into the
+	tree once it grows too big. Queries descend the tree instead of
+	scanning every area.
+*/
+class RTreeAreaStore : public AreaStore {
+public:
+	virtual bool insertArea(Area *a);
+	virtual void bulkInsert(std::vector<Area> &areas);
+	virtual bool removeArea(u32 id);
+	virtual void getAreasInArea(std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap);
+
+protected:
+	virtual void getAreasForPosImpl(std::vector<Area *> *result, v3s16 pos);
+
+private:
+	static const u32 NODE_CAPACITY = 16;
+	/// Pending insertions are folded into the tree at this size
+	static const size_t PENDING_REBUILD_LIMIT = 256;
+
+	struct Node {
+		// Bounding box of everything below this node
+		v3s16 minedge, maxedge;
+		// First index into m_children (inner node) or m_entries (leaf)
+		u32 first;
+		u32 count;
+		bool leaf;
+	};
+
+	/// Rebuilds the whole tree from areas_map with an STR bulk load.
+	void rebuild();
+	/// Removes the area from the subtree; bounding boxes are left as
+	/// (possibly loose) supersets.
+	bool removeFromTree(u32 node_id, Area *a);
+	void queryNode(u32 node_id, std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap) const;
+	void queryNodePos(u32 node_id, std::vector<Area *> *result,
+		v3s16 pos) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<u32> m_children; // child node ids, contiguous per inner node
+	std::vector<Area *> m_entries; // leaf entries, contiguous per leaf
+	std::vector<Area *> m_pending; // inserted but not yet in the tree
+	u32 m_root = U32_MAX;
+};
+
+
 #if USE_SPATIAL
 
 class SpatialAreaStore : public AreaStore {
@@ -21,8 +21,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irrlichttypes.h"
 #include "exceptions.h"
+#include "debug.h"
+#include "basic_macros.h"
 #include "threading/mutex_auto_lock.h"
 #include "threading/semaphore.h"
+#include <atomic>
 #include <list>
 #include <vector>
 #include <map>
@@ -233,6 +236,240 @@ protected:
 	Semaphore m_signal;
 };
 
+/*
+	Bounded lock-free multi-producer single-consumer queue.
+
+	push_back() may be called from any number of threads concurrently;
+	pop_front() and pop_bulk() must only ever be called from one thread.
+	Implemented as a ring of slots with per-slot sequence counters, so
+	producers and the consumer never take a mutex.
+
+	Unlike MutexedQueue there is no blocking pop; the consumer is expected
+	to bring its own wakeup mechanism (e.g. a semaphore it was already
+	sleeping on anyway).
+*/
+template<typename T>
+class MPSCQueue
+{
+public:
+	// capacity must be a power of two
+	MPSCQueue(size_t capacity) :
+		m_slots(new Slot[capacity]),
+		m_capacity_mask(capacity - 1)
+	{
+		sanity_check((capacity & (capacity - 1)) == 0);
+		for (size_t i = 0; i < capacity; i++)
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~MPSCQueue()
+	{
+		delete[] m_slots;
+	}
+
+	DISABLE_CLASS_COPY(MPSCQueue)
+
+	/*
+		Returns false if the queue is full. The caller has to decide
+		whether to retry or to drop the entry; nothing is ever dropped
+		silently.
+	*/
+	bool push_back(const T &t)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+		for (;;) {
+			Slot &slot = m_slots[pos & m_capacity_mask];
+			size_t seq = slot.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				// Slot is free, try to claim it
+				if (m_tail.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed)) {
+					slot.value = t;
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+				// Another producer claimed it, pos was updated by the CAS
+			} else if (diff < 0) {
+				// Slot still holds a value the consumer has not taken yet
+				return false;
+			} else {
+				// Slot was claimed by a faster producer, move on
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns false if the queue is empty
+	bool pop_front(T *t)
+	{
+		Slot &slot = m_slots[m_head & m_capacity_mask];
+		size_t seq = slot.sequence.load(std::memory_order_acquire);
+		if ((intptr_t)seq - (intptr_t)(m_head + 1) < 0)
+			return false;
+		*t = std::move(slot.value);
+		slot.value = T();
+		// Mark the slot reusable for the producers' next lap
+		slot.sequence.store(m_head + m_capacity_mask + 1,
+			std::memory_order_release);
+		m_head++;
+		return true;
+	}
+
+	// Appends up to max entries to dest, returns the number taken
+	size_t pop_bulk(std::vector<T> &dest, size_t max)
+	{
+		size_t count = 0;
+		T t;
+		while (count < max && pop_front(&t)) {
+			dest.push_back(std::move(t));
+			count++;
+		}
+		return count;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	Slot *m_slots;
+	const size_t m_capacity_mask;
+	std::atomic<size_t> m_tail{0};
+	// Only ever touched by the consumer
+	size_t m_head = 0;
+};
+
+/*
+	Bounded lock-free multi-producer multi-consumer queue.
+
+	Same slot/sequence scheme as MPSCQueue, but the head is claimed with
+	a CAS as well, so any number of threads may push and pop
+	concurrently. The bulk helpers amortize call overhead for high-rate
+	users draining or filling many entries at once.
+
+	As with MPSCQueue there is no blocking pop; pair the queue with a
+	Semaphore when consumers need to sleep.
+*/
+template<typename T>
+class MPMCQueue
+{
+public:
+	// capacity must be a power of two
+	MPMCQueue(size_t capacity) :
+		m_slots(new Slot[capacity]),
+		m_capacity_mask(capacity - 1)
+	{
+		sanity_check((capacity & (capacity - 1)) == 0);
+		for (size_t i = 0; i < capacity; i++)
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~MPMCQueue()
+	{
+		delete[] m_slots;
+	}
+
+	DISABLE_CLASS_COPY(MPMCQueue)
+
+	/*
+		Returns false if the queue is full. The caller has to decide
+		whether to retry or to drop the entry; nothing is ever dropped
+		silently.
+	*/
+	bool push_back(const T &t)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+		for (;;) {
+			Slot &slot = m_slots[pos & m_capacity_mask];
+			size_t seq = slot.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				// Slot is free, try to claim it
+				if (m_tail.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed)) {
+					slot.value = t;
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+				// Another producer claimed it, pos was updated by the CAS
+			} else if (diff < 0) {
+				// Slot still holds a value no consumer has taken yet
+				return false;
+			} else {
+				// Slot was claimed by a faster producer, move on
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns false if the queue is empty
+	bool pop_front(T *t)
+	{
+		size_t pos = m_head.load(std::memory_order_relaxed);
+		for (;;) {
+			Slot &slot = m_slots[pos & m_capacity_mask];
+			size_t seq = slot.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				// Slot holds a value, try to claim it
+				if (m_head.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed)) {
+					*t = std::move(slot.value);
+					slot.value = T();
+					// Mark the slot reusable for the producers' next lap
+					slot.sequence.store(pos + m_capacity_mask + 1,
+						std::memory_order_release);
+					return true;
+				}
+				// Another consumer claimed it, pos was updated by the CAS
+			} else if (diff < 0) {
+				// Empty (or the producer has not published the value yet)
+				return false;
+			} else {
+				// Slot was claimed by a faster consumer, move on
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Pushes entries from src until the queue fills up, returns the
+	// number pushed
+	size_t push_bulk(const T *src, size_t count)
+	{
+		size_t pushed = 0;
+		while (pushed < count && push_back(src[pushed]))
+			pushed++;
+		return pushed;
+	}
+
+	// Appends up to max entries to dest, returns the number taken
+	size_t pop_bulk(std::vector<T> &dest, size_t max)
+	{
+		size_t count = 0;
+		T t;
+		while (count < max && pop_front(&t)) {
+			dest.push_back(std::move(t));
+			count++;
+		}
+		return count;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	Slot *m_slots;
+	const size_t m_capacity_mask;
+	std::atomic<size_t> m_tail{0};
+	std::atomic<size_t> m_head{0};
+};
+
 template<typename K, typename V>
 class LRUCache
 {
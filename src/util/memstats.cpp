@@ -0,0 +1,86 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "memstats.h"
+
+#include <iomanip>
+#include <sstream>
+#include "threading/mutex_auto_lock.h"
+
+static MemoryStats main_memory_stats;
+MemoryStats *g_memstats = &main_memory_stats;
+
+MemoryPool *MemoryStats::registerPool(const std::string &name)
+{
+	MutexAutoLock lock(m_mutex);
+	auto it = m_pools.find(name);
+	if (it != m_pools.end())
+		return it->second;
+	MemoryPool *pool = new MemoryPool();
+	m_pools[name] = pool;
+	return pool;
+}
+
+std::vector<MemoryStats::PoolInfo> MemoryStats::getAll()
+{
+	MutexAutoLock lock(m_mutex);
+	std::vector<PoolInfo> result;
+	result.reserve(m_pools.size());
+	for (const auto &it : m_pools)
+		result.push_back({it.first, it.second->getCurrent(),
+				it.second->getPeak()});
+	return result;
+}
+
+static double to_mib(u64 bytes)
+{
+	return (double) bytes / (1024.0 * 1024.0);
+}
+
+void MemoryStats::writeReport(std::ostream &os)
+{
+	u64 total = 0, total_peak = 0;
+	os << std::fixed << std::setprecision(1);
+	for (const PoolInfo &info : getAll()) {
+		os << std::setw(30) << std::left << info.name
+			<< std::setw(10) << std::right << to_mib(info.current)
+			<< " MiB  (peak " << to_mib(info.peak) << " MiB)"
+			<< std::endl;
+		total += info.current;
+		total_peak += info.peak;
+	}
+	os << std::setw(30) << std::left << "total accounted"
+		<< std::setw(10) << std::right << to_mib(total)
+		<< " MiB  (peak " << to_mib(total_peak) << " MiB)" << std::endl;
+}
+
+std::string MemoryStats::getSummary()
+{
+	std::ostringstream os;
+	os << std::fixed << std::setprecision(1);
+	bool first = true;
+	for (const PoolInfo &info : getAll()) {
+		if (!first)
+			os << ", ";
+		first = false;
+		os << info.name << "=" << to_mib(info.current) << "/"
+			<< to_mib(info.peak) << "MiB";
+	}
+	return os.str();
+}
@@ -0,0 +1,120 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+
+/*
+	Per-subsystem memory accounting, so that a climbing RSS can be
+	attributed to the owner that grew (map cache vs. mesh cache vs. Lua)
+	instead of guessed at.
+
+	Each major allocation owner registers a pool once and keeps the
+	handle; add()/sub() are relaxed atomic updates, cheap enough to sit
+	directly in allocation paths. Owners that can only be sampled (the
+	Lua heap) report an absolute figure through set() instead. Every
+	pool tracks its high-water mark so a regression is visible even
+	after the spike has passed.
+
+	Pools are aggregated once per second into Profiler gauges by the
+	server and summarized in /status; see Server::AsyncRunStep() and
+	Server::getStatusString().
+
+	Handles stay valid for the lifetime of the process. The counters
+	only cover what the owners report, not allocator overhead, so they
+	are a lower bound on the real footprint.
+*/
+
+class MemoryPool
+{
+public:
+	MemoryPool() = default;
+
+	DISABLE_CLASS_COPY(MemoryPool);
+
+	void add(u64 bytes)
+	{
+		u64 now = m_current.fetch_add(bytes,
+				std::memory_order_relaxed) + bytes;
+		updatePeak(now);
+	}
+
+	void sub(u64 bytes)
+	{
+		m_current.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+	// For owners that are sampled rather than hooked (e.g. the Lua heap)
+	void set(u64 bytes)
+	{
+		m_current.store(bytes, std::memory_order_relaxed);
+		updatePeak(bytes);
+	}
+
+	u64 getCurrent() const { return m_current.load(std::memory_order_relaxed); }
+	u64 getPeak() const { return m_peak.load(std::memory_order_relaxed); }
+
+private:
+	void updatePeak(u64 now)
+	{
+		u64 peak = m_peak.load(std::memory_order_relaxed);
+		while (now > peak && !m_peak.compare_exchange_weak(peak, now,
+				std::memory_order_relaxed))
+			;
+	}
+
+	std::atomic<u64> m_current{0};
+	std::atomic<u64> m_peak{0};
+};
+
+class MemoryStats
+{
+public:
+	// Registering an existing name returns the existing handle
+	MemoryPool *registerPool(const std::string &name);
+
+	struct PoolInfo
+	{
+		std::string name;
+		u64 current;
+		u64 peak;
+	};
+	std::vector<PoolInfo> getAll();
+
+	// One "name  current  (peak ...)" line per pool, in MiB
+	void writeReport(std::ostream &os);
+
+	// Compact single-line "name=current/peakMiB, ..." form for /status
+	std::string getSummary();
+
+private:
+	// Guards the map; updates through handles never take it
+	std::mutex m_mutex;
+	std::map<std::string, MemoryPool *> m_pools;
+};
+
+extern MemoryStats *g_memstats;
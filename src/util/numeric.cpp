@@ -97,63 +97,51 @@ u64 murmur_hash_64_ua(const void *key, int len, unsigned int seed)
 }
 
 /*
-	blockpos_b: position of block in block coordinates
+	center: center of the area in world coordinates
+	radius: bounding sphere radius of the area in world coordinates
 	camera_pos: position of camera in nodes
 	camera_dir: an unit vector pointing to camera direction
 	range: viewing range
 	distance_ptr: return location for distance from the camera
 */
-bool isBlockInSight(v3s16 blockpos_b, v3f camera_pos, v3f camera_dir,
+bool isAreaInSight(v3f center, f32 radius, v3f camera_pos, v3f camera_dir,
 		f32 camera_fov, f32 range, f32 *distance_ptr)
 {
-	// Maximum radius of a block.  The magic number is
-	// sqrt(3.0) / 2.0 in literal form.
-	static constexpr const f32 block_max_radius = 0.866025403784f * MAP_BLOCKSIZE * BS;
-
-	v3s16 blockpos_nodes = blockpos_b * MAP_BLOCKSIZE;
-
-	// Block center position
-	v3f blockpos(
-			((float)blockpos_nodes.X + MAP_BLOCKSIZE/2) * BS,
-			((float)blockpos_nodes.Y + MAP_BLOCKSIZE/2) * BS,
-			((float)blockpos_nodes.Z + MAP_BLOCKSIZE/2) * BS
-	);
-
-	// Block position relative to camera
-	v3f blockpos_relative = blockpos - camera_pos;
+	// Area position relative to camera
+	v3f center_relative = center - camera_pos;
 
 	// Total distance
-	f32 d = MYMAX(0, blockpos_relative.getLength() - block_max_radius);
+	f32 d = MYMAX(0, center_relative.getLength() - radius);
 
 	if (distance_ptr)
 		*distance_ptr = d;
 
-	// If block is far away, it's not in sight
+	// If area is far away, it's not in sight
 	if (d > range)
 		return false;
 
-	// If block is (nearly) touching the camera, don't
+	// If area is (nearly) touching the camera, don't
 	// bother validating further (that is, render it anyway)
 	if (d == 0)
 		return true;
 
 	// Adjust camera position, for purposes of computing the angle,
-	// such that a block that has any portion visible with the
+	// such that an area that has any portion visible with the
 	// current camera position will have the center visible at the
 	// adjusted postion
-	f32 adjdist = block_max_radius / cos((M_PI - camera_fov) / 2);
+	f32 adjdist = radius / cos((M_PI - camera_fov) / 2);
 
-	// Block position relative to adjusted camera
-	v3f blockpos_adj = blockpos - (camera_pos - camera_dir * adjdist);
+	// Area position relative to adjusted camera
+	v3f center_adj = center - (camera_pos - camera_dir * adjdist);
 
 	// Distance in camera direction (+=front, -=back)
-	f32 dforward = blockpos_adj.dotProduct(camera_dir);
+	f32 dforward = center_adj.dotProduct(camera_dir);
 
 	// Cosine of the angle between the camera direction
-	// and the block direction (camera_dir is an unit vector)
-	f32 cosangle = dforward / blockpos_adj.getLength();
+	// and the area direction (camera_dir is an unit vector)
+	f32 cosangle = dforward / center_adj.getLength();
 
-	// If block is not in the field of view, skip it
+	// If area is not in the field of view, skip it
 	// HOTFIX: use sligthly increased angle (+10%) to fix too agressive
 	// culling. Somebody have to find out whats wrong with the math here.
 	// Previous value: camera_fov / 2
@@ -163,6 +151,33 @@ bool isBlockInSight(v3s16 blockpos_b, v3f camera_pos, v3f camera_dir,
 	return true;
 }
 
+/*
+	blockpos_b: position of block in block coordinates
+	camera_pos: position of camera in nodes
+	camera_dir: an unit vector pointing to camera direction
+	range: viewing range
+	distance_ptr: return location for distance from the camera
+*/
+bool isBlockInSight(v3s16 blockpos_b, v3f camera_pos, v3f camera_dir,
+		f32 camera_fov, f32 range, f32 *distance_ptr)
+{
+	// Maximum radius of a block.  The magic number is
+	// sqrt(3.0) / 2.0 in literal form.
+	static constexpr const f32 block_max_radius = 0.866025403784f * MAP_BLOCKSIZE * BS;
+
+	v3s16 blockpos_nodes = blockpos_b * MAP_BLOCKSIZE;
+
+	// Block center position
+	v3f blockpos(
+			((float)blockpos_nodes.X + MAP_BLOCKSIZE/2) * BS,
+			((float)blockpos_nodes.Y + MAP_BLOCKSIZE/2) * BS,
+			((float)blockpos_nodes.Z + MAP_BLOCKSIZE/2) * BS
+	);
+
+	return isAreaInSight(blockpos, block_max_radius, camera_pos, camera_dir,
+			camera_fov, range, distance_ptr);
+}
+
 s16 adjustDist(s16 dist, float zoom_fov)
 {
 	// 1.775 ~= 72 * PI / 180 * 1.4, the default FOV on the client.
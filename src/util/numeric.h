@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irr_v2d.h"
 #include "irr_v3d.h"
 #include "irr_aabb3d.h"
+#include <functional>
 #include <matrix4.h>
 
 #define rangelim(d, min, max) ((d) < (min) ? (min) : ((d) > (max) ? (max) : (d)))
@@ -94,6 +95,26 @@ inline void getContainerPosWithOffset(const v3s16 &p, s16 d, v3s16 &container, v
 	getContainerPosWithOffset(p.Z, d, container.Z, offset.Z);
 }
 
+// Hasher for using v3s16 as a key in unordered containers
+struct v3s16Hash
+{
+	std::size_t operator()(const v3s16 &p) const
+	{
+		u64 k = ((u64)(u16)p.Z << 32) | ((u64)(u16)p.Y << 16) | (u16)p.X;
+		return std::hash<u64>()(k);
+	}
+};
+
+// Hasher for using v2s16 as a key in unordered containers
+struct v2s16Hash
+{
+	std::size_t operator()(const v2s16 &p) const
+	{
+		u32 k = ((u32)(u16)p.Y << 16) | (u16)p.X;
+		return std::hash<u32>()(k);
+	}
+};
+
 
 inline bool isInArea(v3s16 p, s16 d)
 {
@@ -247,6 +268,9 @@ inline u32 calc_parity(u32 v)
 
 u64 murmur_hash_64_ua(const void *key, int len, unsigned int seed);
 
+bool isAreaInSight(v3f center, f32 radius, v3f camera_pos, v3f camera_dir,
+		f32 camera_fov, f32 range, f32 *distance_ptr=NULL);
+
 bool isBlockInSight(v3s16 blockpos_b, v3f camera_pos, v3f camera_dir,
 		f32 camera_fov, f32 range, f32 *distance_ptr=NULL);
 
@@ -159,6 +159,77 @@ inline void writeU64(u8 *data, u64 i)
 
 #endif // HAVE_ENDIAN_H
 
+//////////////// bulk routines ////////////////
+
+/*
+	Convert whole arrays between native and big-endian representation in
+	one pass. The stride is the distance in bytes between consecutive
+	native-side elements, so a field of a struct array (e.g.
+	MapNode::param0) can be converted without gathering it into a
+	temporary first. With the default stride the contiguous loops compile
+	to vectorized byte shuffles on modern compilers, or to a plain memcpy
+	on big-endian targets.
+*/
+
+inline void readU16Bulk(const u8 *data, u16 *dest, u32 count,
+		u32 dest_stride = sizeof(u16))
+{
+	if (dest_stride == sizeof(u16)) {
+#if HAVE_ENDIAN_H && (__BYTE_ORDER == __BIG_ENDIAN)
+		memcpy(dest, data, 2 * (size_t)count);
+#else
+		for (u32 i = 0; i < count; i++)
+			dest[i] = readU16(&data[2 * i]);
+#endif
+		return;
+	}
+	u8 *dest_raw = (u8 *)dest;
+	for (u32 i = 0; i < count; i++) {
+		u16 val = readU16(&data[2 * i]);
+		memcpy(dest_raw + (size_t)i * dest_stride, &val, 2);
+	}
+}
+
+inline void writeU16Bulk(u8 *data, const u16 *src, u32 count,
+		u32 src_stride = sizeof(u16))
+{
+	if (src_stride == sizeof(u16)) {
+#if HAVE_ENDIAN_H && (__BYTE_ORDER == __BIG_ENDIAN)
+		memcpy(data, src, 2 * (size_t)count);
+#else
+		for (u32 i = 0; i < count; i++)
+			writeU16(&data[2 * i], src[i]);
+#endif
+		return;
+	}
+	const u8 *src_raw = (const u8 *)src;
+	for (u32 i = 0; i < count; i++) {
+		u16 val;
+		memcpy(&val, src_raw + (size_t)i * src_stride, 2);
+		writeU16(&data[2 * i], val);
+	}
+}
+
+inline void readU32Bulk(const u8 *data, u32 *dest, u32 count)
+{
+#if HAVE_ENDIAN_H && (__BYTE_ORDER == __BIG_ENDIAN)
+	memcpy(dest, data, 4 * (size_t)count);
+#else
+	for (u32 i = 0; i < count; i++)
+		dest[i] = readU32(&data[4 * i]);
+#endif
+}
+
+inline void writeU32Bulk(u8 *data, const u32 *src, u32 count)
+{
+#if HAVE_ENDIAN_H && (__BYTE_ORDER == __BIG_ENDIAN)
+	memcpy(data, src, 4 * (size_t)count);
+#else
+	for (u32 i = 0; i < count; i++)
+		writeU32(&data[4 * i], src[i]);
+#endif
+}
+
 //////////////// read routines ////////////////
 
 inline u8 readU8(const u8 *data)
@@ -435,6 +506,57 @@ MAKE_STREAM_WRITE_FXN(v2f,   V2F32,    8);
 MAKE_STREAM_WRITE_FXN(v3f,   V3F32,   12);
 MAKE_STREAM_WRITE_FXN(video::SColor, ARGB8, 4);
 
+////
+//// std::string append wrapper for data write
+////
+
+// Appending onto a std::string is considerably cheaper than pushing the
+// same value through a std::ostringstream, and the result can be moved
+// onwards instead of copied out of a stringbuf.  Used by message builders
+// on hot paths, e.g. the active object commands in genericobject.cpp.
+#define MAKE_STRING_WRITE_FXN(T, N, S)            \
+	inline void put ## N(std::string &str, T val) \
+	{                                             \
+		char buf[S];                              \
+		write ## N((u8 *)buf, val);               \
+		str.append(buf, sizeof(buf));             \
+	}
+
+MAKE_STRING_WRITE_FXN(u8,    U8,       1);
+MAKE_STRING_WRITE_FXN(u16,   U16,      2);
+MAKE_STRING_WRITE_FXN(u32,   U32,      4);
+MAKE_STRING_WRITE_FXN(u64,   U64,      8);
+MAKE_STRING_WRITE_FXN(s8,    S8,       1);
+MAKE_STRING_WRITE_FXN(s16,   S16,      2);
+MAKE_STRING_WRITE_FXN(s32,   S32,      4);
+MAKE_STRING_WRITE_FXN(s64,   S64,      8);
+MAKE_STRING_WRITE_FXN(f32,   F1000,    4);
+MAKE_STRING_WRITE_FXN(f32,   F32,      4);
+MAKE_STRING_WRITE_FXN(v2s16, V2S16,    4);
+MAKE_STRING_WRITE_FXN(v3s16, V3S16,    6);
+MAKE_STRING_WRITE_FXN(v2s32, V2S32,    8);
+MAKE_STRING_WRITE_FXN(v3s32, V3S32,   12);
+MAKE_STRING_WRITE_FXN(v3f,   V3F1000, 12);
+MAKE_STRING_WRITE_FXN(v2f,   V2F32,    8);
+MAKE_STRING_WRITE_FXN(v3f,   V3F32,   12);
+MAKE_STRING_WRITE_FXN(video::SColor, ARGB8, 4);
+
+// Appends plain with its length in the first two bytes, like
+// serializeString() without the temporary
+inline void putString(std::string &str, const std::string &plain)
+{
+	putU16(str, plain.size());
+	str.append(plain);
+}
+
+// Appends plain with its length in the first four bytes, like
+// serializeLongString() without the temporary
+inline void putLongString(std::string &str, const std::string &plain)
+{
+	putU32(str, plain.size());
+	str.append(plain);
+}
+
 ////
 //// More serialization stuff
 ////
@@ -0,0 +1,73 @@
+/*
+Minetest
+Copyright (C) 2010-2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "util/sharedstring.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/memstats.h"
+#include <mutex>
+#include <unordered_map>
+
+/*
+	The global intern table holds weak references, so it never keeps a
+	string alive by itself; the custom deleter drops an entry once the
+	last SharedString referencing it is gone. The table is shared
+	between threads (server step, emerge threads, ...), hence the lock.
+*/
+static std::unordered_map<std::string, std::weak_ptr<const std::string>>
+		g_intern_table;
+static std::mutex g_intern_table_mutex;
+
+static void eraseInterned(const std::string *str)
+{
+	{
+		MutexAutoLock lock(g_intern_table_mutex);
+		auto it = g_intern_table.find(*str);
+		// A concurrent intern() may have rebound the entry to a fresh
+		// copy already; only erase it if it still refers to nothing.
+		if (it != g_intern_table.end() && it->second.expired())
+			g_intern_table.erase(it);
+	}
+	static MemoryPool *pool = g_memstats->registerPool("shared_strings");
+	pool->sub(str->size());
+	delete str;
+}
+
+std::shared_ptr<const std::string> SharedString::intern(const std::string &str)
+{
+	if (str.empty())
+		return nullptr;
+
+	MutexAutoLock lock(g_intern_table_mutex);
+
+	auto it = g_intern_table.find(str);
+	if (it != g_intern_table.end()) {
+		if (std::shared_ptr<const std::string> existing = it->second.lock())
+			return existing;
+	}
+
+	std::shared_ptr<const std::string> fresh(new std::string(str),
+			eraseInterned);
+	g_intern_table[str] = fresh;
+
+	// Accounts the interned heap copies, i.e. the actual footprint of
+	// node/item metadata strings after deduplication
+	static MemoryPool *pool = g_memstats->registerPool("shared_strings");
+	pool->add(str.size());
+	return fresh;
+}
@@ -0,0 +1,95 @@
+/*
+Minetest
+Copyright (C) 2010-2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+/*
+	An immutable, reference-counted string deduplicated through a global
+	intern table. Assigning identical contents to many SharedStrings
+	(e.g. the formspec of every chest on a server) keeps a single heap
+	copy alive; it is freed when the last reference goes away. The
+	underlying string is never modified in place, so mutation is
+	copy-on-write by construction: assignment rebinds to another
+	interned copy.
+*/
+class SharedString
+{
+public:
+	SharedString() = default;
+
+	SharedString(const std::string &str) : m_str(intern(str)) {}
+
+	SharedString &operator=(const std::string &str)
+	{
+		m_str = intern(str);
+		return *this;
+	}
+
+	const std::string &str() const
+	{
+		static const std::string empty_string;
+		return m_str ? *m_str : empty_string;
+	}
+
+	operator const std::string &() const { return str(); }
+
+	const char *c_str() const { return str().c_str(); }
+	size_t size() const { return str().size(); }
+	bool empty() const { return !m_str || m_str->empty(); }
+
+	friend bool operator==(const SharedString &a, const SharedString &b)
+	{
+		// Interned equal contents share one copy
+		return a.m_str == b.m_str || a.str() == b.str();
+	}
+	friend bool operator==(const SharedString &a, const std::string &b)
+	{
+		return a.str() == b;
+	}
+	friend bool operator==(const std::string &a, const SharedString &b)
+	{
+		return a == b.str();
+	}
+	friend bool operator!=(const SharedString &a, const SharedString &b)
+	{
+		return !(a == b);
+	}
+	friend bool operator!=(const SharedString &a, const std::string &b)
+	{
+		return !(a == b);
+	}
+	friend bool operator!=(const std::string &a, const SharedString &b)
+	{
+		return !(a == b);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const SharedString &s)
+	{
+		return os << s.str();
+	}
+
+private:
+	static std::shared_ptr<const std::string> intern(const std::string &str);
+
+	std::shared_ptr<const std::string> m_str;
+};
@@ -0,0 +1,111 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+
+/*
+	Arena for fixed-size memory chunks.
+
+	Carves chunks out of large slabs and recycles freed chunks through a
+	free list, so alloc() and free() are O(1) and constant churn of
+	equally sized objects (e.g. map block node arrays) doesn't fragment
+	the general allocator. Memory is only returned to the system when the
+	arena itself is destroyed.
+
+	The caller is responsible for constructing/destroying objects in the
+	returned memory; the arena hands out raw storage only.
+*/
+class SlabArena
+{
+public:
+	SlabArena(size_t chunk_size, size_t chunks_per_slab = 64) :
+		m_chunk_size(chunk_size < sizeof(void *) ? sizeof(void *) : chunk_size),
+		m_chunks_per_slab(chunks_per_slab)
+	{
+		assert(chunks_per_slab > 0);
+	}
+
+	~SlabArena()
+	{
+		for (char *slab : m_slabs)
+			delete[] slab;
+	}
+
+	DISABLE_CLASS_COPY(SlabArena)
+
+	void *alloc()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_free_list) {
+			char *slab = new char[m_chunk_size * m_chunks_per_slab];
+			m_slabs.push_back(slab);
+			// Thread the fresh slab onto the free list
+			for (size_t i = 0; i < m_chunks_per_slab; i++) {
+				FreeChunk *c = (FreeChunk *)(slab + i * m_chunk_size);
+				c->next = m_free_list;
+				m_free_list = c;
+			}
+		}
+		FreeChunk *c = m_free_list;
+		m_free_list = c->next;
+		m_used_count++;
+		return c;
+	}
+
+	void free(void *ptr)
+	{
+		if (!ptr)
+			return;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		FreeChunk *c = (FreeChunk *)ptr;
+		c->next = m_free_list;
+		m_free_list = c;
+		m_used_count--;
+	}
+
+	// Number of chunks currently handed out
+	size_t getUsedCount() const { return m_used_count; }
+
+	// Total memory held by the arena, used or not, in bytes
+	size_t getCapacityBytes() const
+	{
+		return m_slabs.size() * m_chunks_per_slab * m_chunk_size;
+	}
+
+private:
+	struct FreeChunk
+	{
+		FreeChunk *next;
+	};
+
+	const size_t m_chunk_size;
+	const size_t m_chunks_per_slab;
+
+	std::mutex m_mutex;
+	std::vector<char *> m_slabs;
+	FreeChunk *m_free_list = nullptr;
+	size_t m_used_count = 0;
+};
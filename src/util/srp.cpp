@@ -1038,3 +1038,18 @@ void srp_user_verify_session(struct SRPUser *usr, const unsigned char *bytes_HAM
 	if (memcmp(usr->H_AMK, bytes_HAMK, hash_length(usr->hash_alg)) == 0)
 		usr->authenticated = 1;
 }
+
+SRP_Result srp_random_bytes(unsigned char *buff, size_t size)
+{
+	if (size > RAND_BUFF_MAX) return SRP_ERR;
+
+	if (init_random() != SRP_OK) /* Only happens once */
+		return SRP_ERR;
+
+	if (RAND_BUFF_MAX - g_rand_idx < size)
+		if (fill_buff() != SRP_OK) return SRP_ERR;
+
+	memcpy(buff, &g_rand_buff[g_rand_idx], size);
+	g_rand_idx += size;
+	return SRP_OK;
+}
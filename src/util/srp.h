@@ -189,3 +189,11 @@ void srp_user_process_challenge(struct SRPUser *usr,
 
 /* bytes_HAMK must be exactly srp_user_get_session_key_length() bytes in size */
 void srp_user_verify_session(struct SRPUser *usr, const unsigned char *bytes_HAMK);
+
+/* Fills buff with cryptographically secure random data, using the same
+ * entropy source as the rest of this library. size must not be larger
+ * than 128 bytes.
+ *
+ * Returns SRP_OK on success, and SRP_ERR on error.
+ */
+SRP_Result srp_random_bytes(unsigned char *buff, size_t size);
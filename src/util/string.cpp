@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <sstream>
 #include <iomanip>
 #include <map>
+#include <unordered_map>
 
 #ifndef _WIN32
 	#include <iconv.h>
@@ -167,6 +168,31 @@ std::string wide_to_utf8(const std::wstring &input)
 
 #endif // _WIN32
 
+std::wstring utf8_to_wide_cached(const std::string &input)
+{
+	// The table is emptied once it reaches CACHE_MAX_ENTRIES so one-off
+	// strings cannot grow it without bound, and strings longer than
+	// CACHE_MAX_LENGTH are unlikely to repeat and bypass it entirely.
+	static const size_t CACHE_MAX_ENTRIES = 256;
+	static const size_t CACHE_MAX_LENGTH = 256;
+
+	if (input.length() > CACHE_MAX_LENGTH)
+		return utf8_to_wide(input);
+
+	static thread_local std::unordered_map<std::string, std::wstring> cache;
+
+	auto it = cache.find(input);
+	if (it != cache.end())
+		return it->second;
+
+	if (cache.size() >= CACHE_MAX_ENTRIES)
+		cache.clear();
+
+	std::wstring converted = utf8_to_wide(input);
+	cache[input] = converted;
+	return converted;
+}
+
 // You must free the returned string!
 // The returned string is allocated using new
 wchar_t *utf8_to_wide_c(const char *str)
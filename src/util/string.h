@@ -66,6 +66,11 @@ struct FlagDesc {
 std::wstring utf8_to_wide(const std::string &input);
 std::string wide_to_utf8(const std::wstring &input);
 
+// Variant of utf8_to_wide() for strings that are re-converted every frame
+// (HUD text, item counts, pointed object info). Keeps a small per-thread
+// table of recent conversions so an unchanged string is a hash lookup.
+std::wstring utf8_to_wide_cached(const std::string &input);
+
 wchar_t *utf8_to_wide_c(const char *str);
 
 // NEVER use those two functions unless you have a VERY GOOD reason to
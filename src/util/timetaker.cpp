@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "porting.h"
 #include "log.h"
+#include "tracerecorder.h"
 #include <ostream>
 
 TimeTaker::TimeTaker(const std::string &name, u64 *result, TimePrecision prec)
@@ -29,12 +30,17 @@ TimeTaker::TimeTaker(const std::string &name, u64 *result, TimePrecision prec)
 	m_result = result;
 	m_precision = prec;
 	m_time1 = porting::getTime(prec);
+	if (g_trace_recorder->isRecording())
+		m_trace_time1 = porting::getTimeUs();
 }
 
 u64 TimeTaker::stop(bool quiet)
 {
 	if (m_running) {
 		u64 dtime = porting::getTime(m_precision) - m_time1;
+		if (m_trace_time1 != 0 && !m_name.empty())
+			g_trace_recorder->record(m_name, m_trace_time1,
+					porting::getTimeUs());
 		if (m_result != nullptr) {
 			(*m_result) += dtime;
 		} else {
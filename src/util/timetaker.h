@@ -44,6 +44,9 @@ public:
 private:
 	std::string m_name;
 	u64 m_time1;
+	// Start time in microseconds, only taken while the event trace
+	// recorder is running (see util/tracerecorder.h)
+	u64 m_trace_time1 = 0;
 	bool m_running = true;
 	TimePrecision m_precision;
 	u64 *m_result = nullptr;
@@ -0,0 +1,112 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "tracerecorder.h"
+#include "threading/mutex_auto_lock.h"
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+static TraceRecorder main_trace_recorder;
+TraceRecorder *g_trace_recorder = &main_trace_recorder;
+
+TraceRecorder::~TraceRecorder()
+{
+	if (!isRecording() || m_dump_path.empty())
+		return;
+
+	// The log streams may already be gone during static destruction
+	if (dump(m_dump_path))
+		std::cerr << "Event trace written to " << m_dump_path << std::endl;
+}
+
+void TraceRecorder::start(const std::string &dump_path)
+{
+	MutexAutoLock lock(m_mutex);
+	m_dump_path = dump_path;
+	m_ring.resize(RING_SIZE);
+	m_head = 0;
+	m_wrapped = false;
+	m_recording.store(true, std::memory_order_relaxed);
+}
+
+void TraceRecorder::record(const std::string &name, u64 time_start_us,
+		u64 time_end_us)
+{
+	static thread_local u64 tl_thread_id =
+			std::hash<std::thread::id>()(std::this_thread::get_id());
+
+	if (!isRecording())
+		return;
+
+	MutexAutoLock lock(m_mutex);
+	TraceEvent &ev = m_ring[m_head];
+	ev.name = name;
+	ev.time_start_us = time_start_us;
+	ev.duration_us = time_end_us - time_start_us;
+	ev.thread_id = tl_thread_id;
+
+	if (++m_head == m_ring.size()) {
+		m_head = 0;
+		m_wrapped = true;
+	}
+}
+
+static void write_json_string(std::ostream &os, const std::string &s)
+{
+	os << '"';
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			os << '\\' << c;
+		else if ((unsigned char)c < 0x20)
+			os << ' ';
+		else
+			os << c;
+	}
+	os << '"';
+}
+
+bool TraceRecorder::dump(const std::string &path)
+{
+	MutexAutoLock lock(m_mutex);
+
+	std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!os.good())
+		return false;
+
+	os << "{\"traceEvents\":[";
+
+	const size_t count = m_wrapped ? m_ring.size() : m_head;
+	const size_t first = m_wrapped ? m_head : 0;
+	for (size_t i = 0; i < count; i++) {
+		const TraceEvent &ev = m_ring[(first + i) % m_ring.size()];
+		if (i > 0)
+			os << ",";
+		os << "\n{\"name\":";
+		write_json_string(os, ev.name);
+		os << ",\"ph\":\"X\",\"cat\":\"minetest\",\"pid\":0"
+			<< ",\"tid\":" << ev.thread_id
+			<< ",\"ts\":" << ev.time_start_us
+			<< ",\"dur\":" << ev.duration_us << "}";
+	}
+
+	os << "\n]}\n";
+	return os.good();
+}
@@ -0,0 +1,81 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TraceRecorder;
+extern TraceRecorder *g_trace_recorder;
+
+/*
+	Records named begin/end spans with thread ids into a ring buffer and
+	writes them out as chrome://tracing compatible JSON ("Complete" events,
+	open the file via chrome://tracing or https://ui.perfetto.dev).
+
+	Recording is off by default; TimeTaker feeds the recorder once it has
+	been started (see the event_tracing setting). The ring keeps the most
+	recent RING_SIZE spans, so the dump shows the tail of the session.
+*/
+class TraceRecorder
+{
+public:
+	// Events kept before the oldest are overwritten
+	static const size_t RING_SIZE = 65536;
+
+	~TraceRecorder();
+
+	// Starts recording; dump_path is written when the recorder is
+	// destroyed (and by explicit dump() calls).
+	void start(const std::string &dump_path);
+
+	bool isRecording() const
+	{
+		return m_recording.load(std::memory_order_relaxed);
+	}
+
+	void record(const std::string &name, u64 time_start_us, u64 time_end_us);
+
+	// Writes the buffered events as trace JSON, oldest first
+	bool dump(const std::string &path);
+
+private:
+	struct TraceEvent
+	{
+		std::string name;
+		u64 time_start_us;
+		u64 duration_us;
+		u64 thread_id;
+	};
+
+	std::atomic<bool> m_recording{false};
+
+	// Protects the ring; only held for the copy in record() and while
+	// dumping, and recording is opt-in diagnostics anyway
+	std::mutex m_mutex;
+	std::vector<TraceEvent> m_ring;
+	size_t m_head = 0;
+	bool m_wrapped = false;
+
+	std::string m_dump_path;
+};
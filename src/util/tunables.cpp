@@ -0,0 +1,129 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "tunables.h"
+
+#include <iomanip>
+#include <sstream>
+#include "log.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/string.h"
+
+static TunableRegistry main_tunable_registry;
+TunableRegistry *g_tunables = &main_tunable_registry;
+
+TunableInt *TunableRegistry::registerInt(const std::string &name, s64 initial,
+		s64 min, s64 max, const std::string &help)
+{
+	MutexAutoLock lock(m_mutex);
+	auto it = m_ints.find(name);
+	if (it != m_ints.end())
+		return it->second;
+	TunableInt *tunable = new TunableInt(initial, min, max, help);
+	m_ints[name] = tunable;
+	return tunable;
+}
+
+TunableFloat *TunableRegistry::registerFloat(const std::string &name,
+		float initial, float min, float max, const std::string &help)
+{
+	MutexAutoLock lock(m_mutex);
+	auto it = m_floats.find(name);
+	if (it != m_floats.end())
+		return it->second;
+	TunableFloat *tunable = new TunableFloat(initial, min, max, help);
+	m_floats[name] = tunable;
+	return tunable;
+}
+
+bool TunableRegistry::set(const std::string &name, const std::string &value,
+		std::string *error)
+{
+	MutexAutoLock lock(m_mutex);
+
+	auto int_it = m_ints.find(name);
+	if (int_it != m_ints.end()) {
+		s64 parsed;
+		try {
+			parsed = std::stoll(value);
+		} catch (std::exception &) {
+			*error = "\"" + value + "\" is not an integer";
+			return false;
+		}
+		if (!int_it->second->set(parsed)) {
+			std::ostringstream os;
+			os << "value out of range [" << int_it->second->getMin()
+				<< ".." << int_it->second->getMax() << "]";
+			*error = os.str();
+			return false;
+		}
+		infostream << "Tunable " << name << " set to " << parsed << std::endl;
+		return true;
+	}
+
+	auto float_it = m_floats.find(name);
+	if (float_it != m_floats.end()) {
+		float parsed;
+		try {
+			parsed = std::stof(value);
+		} catch (std::exception &) {
+			*error = "\"" + value + "\" is not a number";
+			return false;
+		}
+		if (!float_it->second->set(parsed)) {
+			std::ostringstream os;
+			os << "value out of range [" << float_it->second->getMin()
+				<< ".." << float_it->second->getMax() << "]";
+			*error = os.str();
+			return false;
+		}
+		infostream << "Tunable " << name << " set to " << parsed << std::endl;
+		return true;
+	}
+
+	*error = "no tunable named \"" + name + "\"";
+	return false;
+}
+
+void TunableRegistry::writeReport(std::ostream &os)
+{
+	for (const TunableInfo &info : getAll()) {
+		os << std::setw(45) << std::left << info.name
+			<< " = " << info.value << "  [" << info.min << ".."
+			<< info.max << "]  " << info.help << std::endl;
+	}
+}
+
+std::vector<TunableRegistry::TunableInfo> TunableRegistry::getAll()
+{
+	MutexAutoLock lock(m_mutex);
+	std::vector<TunableInfo> result;
+	result.reserve(m_ints.size() + m_floats.size());
+	for (const auto &it : m_ints) {
+		result.push_back({it.first, (double) it.second->get(),
+			(double) it.second->getMin(), (double) it.second->getMax(),
+			it.second->getHelp()});
+	}
+	for (const auto &it : m_floats) {
+		result.push_back({it.first, (double) it.second->get(),
+			(double) it.second->getMin(), (double) it.second->getMax(),
+			it.second->getHelp()});
+	}
+	return result;
+}
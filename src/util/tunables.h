@@ -0,0 +1,146 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+
+/*
+	Registry of runtime performance knobs, so a struggling live server
+	can be tuned without a restart.
+
+	A subsystem registers its knob once at init (usually with the
+	matching setting as the initial value) and keeps the returned
+	handle; get() is a relaxed atomic load, cheap enough for hot loops.
+	Values are changed at runtime through TunableRegistry::set(),
+	exposed to mods as core.set_tunable()/core.get_tunables() and from
+	there as the /tunables and /set_tunable chat commands.
+
+	Handles stay valid for the lifetime of the process. Changes are not
+	persisted; adjust the underlying setting once an experiment sticks.
+*/
+
+class TunableInt
+{
+public:
+	TunableInt(s64 initial, s64 min, s64 max, const std::string &help):
+		m_value(initial),
+		m_min(min),
+		m_max(max),
+		m_help(help)
+	{}
+
+	DISABLE_CLASS_COPY(TunableInt);
+
+	s64 get() const { return m_value.load(std::memory_order_relaxed); }
+
+	bool set(s64 value)
+	{
+		if (value < m_min || value > m_max)
+			return false;
+		m_value.store(value, std::memory_order_relaxed);
+		return true;
+	}
+
+	s64 getMin() const { return m_min; }
+	s64 getMax() const { return m_max; }
+	const std::string &getHelp() const { return m_help; }
+
+private:
+	std::atomic<s64> m_value;
+	const s64 m_min;
+	const s64 m_max;
+	const std::string m_help;
+};
+
+class TunableFloat
+{
+public:
+	TunableFloat(float initial, float min, float max, const std::string &help):
+		m_value(initial),
+		m_min(min),
+		m_max(max),
+		m_help(help)
+	{}
+
+	DISABLE_CLASS_COPY(TunableFloat);
+
+	float get() const { return m_value.load(std::memory_order_relaxed); }
+
+	bool set(float value)
+	{
+		if (value < m_min || value > m_max)
+			return false;
+		m_value.store(value, std::memory_order_relaxed);
+		return true;
+	}
+
+	float getMin() const { return m_min; }
+	float getMax() const { return m_max; }
+	const std::string &getHelp() const { return m_help; }
+
+private:
+	std::atomic<float> m_value;
+	const float m_min;
+	const float m_max;
+	const std::string m_help;
+};
+
+class TunableRegistry
+{
+public:
+	// Registering an existing name returns the existing handle; the
+	// initial value and range of the first registration win
+	TunableInt *registerInt(const std::string &name, s64 initial,
+			s64 min, s64 max, const std::string &help);
+	TunableFloat *registerFloat(const std::string &name, float initial,
+			float min, float max, const std::string &help);
+
+	// Parses and range-checks value; on failure *error says why
+	bool set(const std::string &name, const std::string &value,
+			std::string *error);
+
+	// One "name = value  [min..max]  help" line per tunable
+	void writeReport(std::ostream &os);
+
+	struct TunableInfo
+	{
+		std::string name;
+		double value;
+		double min;
+		double max;
+		std::string help;
+	};
+	std::vector<TunableInfo> getAll();
+
+private:
+	// Guards the maps; reads through handles never take it
+	std::mutex m_mutex;
+	std::map<std::string, TunableInt *> m_ints;
+	std::map<std::string, TunableFloat *> m_floats;
+};
+
+extern TunableRegistry *g_tunables;
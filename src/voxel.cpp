@@ -22,7 +22,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gettime.h"
 #include "nodedef.h"
 #include "util/directiontables.h"
+#include "util/memstats.h"
 #include "util/timetaker.h"
+#include "threading/event.h"
+#include "threading/thread_pool.h"
+#include <atomic>
 #include <cstring>  // memcpy, memset
 
 /*
@@ -33,6 +37,38 @@ u64 emerge_time = 0;
 u64 emerge_load_time = 0;
 u64 clearflag_time = 0;
 
+void VoxelArea::forEachZSlab(const std::function<void(s16 z_min, s16 z_max)> &fn,
+	u32 max_tasks) const
+{
+	s32 sz = m_cache_extent.Z;
+	if (sz <= 0)
+		return;
+
+	u32 tasks = MYMIN(max_tasks, (u32)sz);
+	if (tasks <= 1 || !g_thread_pool || !g_thread_pool->isStarted()) {
+		fn(MinEdge.Z, MaxEdge.Z);
+		return;
+	}
+
+	static u32 group_id = g_thread_pool->registerGroup("voxel_volume", 0);
+
+	Event done;
+	std::atomic<u32> remaining(tasks - 1);
+	for (u32 t = 1; t < tasks; t++) {
+		s16 z_min = MinEdge.Z + (s16)(t * sz / tasks);
+		s16 z_max = MinEdge.Z + (s16)((t + 1) * sz / tasks) - 1;
+		g_thread_pool->submit(group_id, TASK_PRIORITY_HIGH,
+				[&fn, &done, &remaining, z_min, z_max]() {
+			fn(z_min, z_max);
+			if (--remaining == 0)
+				done.signal();
+		});
+	}
+	// Run the first slab on the calling thread instead of sitting idle
+	fn(MinEdge.Z, MinEdge.Z + (s16)(sz / tasks) - 1);
+	done.wait();
+}
+
 VoxelManipulator::~VoxelManipulator()
 {
 	clear();
@@ -40,6 +76,9 @@ VoxelManipulator::~VoxelManipulator()
 
 void VoxelManipulator::clear()
 {
+	static MemoryPool *pool = g_memstats->registerPool("vmanip");
+	if (m_data)
+		pool->sub((u64) m_area.getVolume() * (sizeof(MapNode) + 1));
 	// Reset area to volume=0
 	m_area = VoxelArea();
 	delete[] m_data;
@@ -170,22 +209,45 @@ void VoxelManipulator::addArea(const VoxelArea &area)
 	assert(new_flags);
 	memset(new_flags, VOXELFLAG_NO_DATA, new_size);
 
+	static MemoryPool *pool = g_memstats->registerPool("vmanip");
+	pool->add((u64) new_size * (sizeof(MapNode) + 1));
+
 	// Copy old data
-	s32 old_x_width = m_area.MaxEdge.X - m_area.MinEdge.X + 1;
-	for(s32 z=m_area.MinEdge.Z; z<=m_area.MaxEdge.Z; z++)
-	for(s32 y=m_area.MinEdge.Y; y<=m_area.MaxEdge.Y; y++)
-	{
-		unsigned int old_index = m_area.index(m_area.MinEdge.X,y,z);
-		unsigned int new_index = new_area.index(m_area.MinEdge.X,y,z);
+	if (!m_area.hasEmptyExtent()) {
+		if (m_area.MinEdge.X == new_area.MinEdge.X &&
+				m_area.MaxEdge.X == new_area.MaxEdge.X &&
+				m_area.MinEdge.Y == new_area.MinEdge.Y &&
+				m_area.MaxEdge.Y == new_area.MaxEdge.Y) {
+			// The area only grew along Z, so the old data is a single
+			// contiguous slab in the new layout
+			s32 old_volume = m_area.getVolume();
+			s32 new_index = new_area.index(m_area.MinEdge);
+
+			memcpy(&new_data[new_index], m_data,
+					old_volume * sizeof(MapNode));
+			memcpy(&new_flags[new_index], m_flags,
+					old_volume * sizeof(u8));
+		} else {
+			s32 old_x_width = m_area.MaxEdge.X - m_area.MinEdge.X + 1;
+			for(s32 z=m_area.MinEdge.Z; z<=m_area.MaxEdge.Z; z++)
+			for(s32 y=m_area.MinEdge.Y; y<=m_area.MaxEdge.Y; y++)
+			{
+				unsigned int old_index = m_area.index(m_area.MinEdge.X,y,z);
+				unsigned int new_index = new_area.index(m_area.MinEdge.X,y,z);
 
-		memcpy(&new_data[new_index], &m_data[old_index],
-				old_x_width * sizeof(MapNode));
-		memcpy(&new_flags[new_index], &m_flags[old_index],
-				old_x_width * sizeof(u8));
+				memcpy(&new_data[new_index], &m_data[old_index],
+						old_x_width * sizeof(MapNode));
+				memcpy(&new_flags[new_index], &m_flags[old_index],
+						old_x_width * sizeof(u8));
+			}
+		}
 	}
 
 	// Replace area, data and flags
 
+	if (m_data)
+		pool->sub((u64) m_area.getVolume() * (sizeof(MapNode) + 1));
+
 	m_area = new_area;
 
 	MapNode *old_data = m_data;
@@ -268,6 +330,54 @@ void VoxelManipulator::copyTo(MapNode *dst, const VoxelArea& dst_area,
 	}
 }
 
+bool VoxelManipulator::equalsTo(const MapNode *dst, const VoxelArea &dst_area,
+		v3s16 dst_pos, v3s16 from_pos, const v3s16 &size)
+{
+	for(s16 z=0; z<size.Z; z++)
+	for(s16 y=0; y<size.Y; y++)
+	{
+		s32 i_dst = dst_area.index(dst_pos.X, dst_pos.Y+y, dst_pos.Z+z);
+		s32 i_local = m_area.index(from_pos.X, from_pos.Y+y, from_pos.Z+z);
+		for (s16 x = 0; x < size.X; x++) {
+			if (m_data[i_local].getContent() != CONTENT_IGNORE &&
+					!(m_data[i_local] == dst[i_dst]))
+				return false;
+			i_dst++;
+			i_local++;
+		}
+	}
+	return true;
+}
+
+bool VoxelManipulator::equalsToUniform(const MapNode &dst_node,
+		v3s16 from_pos, const v3s16 &size)
+{
+	for(s16 z=0; z<size.Z; z++)
+	for(s16 y=0; y<size.Y; y++)
+	{
+		s32 i_local = m_area.index(from_pos.X, from_pos.Y+y, from_pos.Z+z);
+		for (s16 x = 0; x < size.X; x++) {
+			if (m_data[i_local].getContent() != CONTENT_IGNORE &&
+					!(m_data[i_local] == dst_node))
+				return false;
+			i_local++;
+		}
+	}
+	return true;
+}
+
+void VoxelManipulator::fill(const MapNode &n, v3s16 to_pos, const v3s16 &size)
+{
+	for(s16 z=0; z<size.Z; z++)
+	for(s16 y=0; y<size.Y; y++)
+	{
+		s32 i_local = m_area.index(to_pos.X, to_pos.Y+y, to_pos.Z+z);
+		for (s16 x = 0; x < size.X; x++)
+			m_data[i_local + x] = n;
+		memset(&m_flags[i_local], 0, size.X);
+	}
+}
+
 /*
 	Algorithms
 	-----------------------------------------------------
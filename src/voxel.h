@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <cassert>
 #include "exceptions.h"
 #include "mapnode.h"
+#include <functional>
 #include <set>
 #include <list>
 #include "util/basic_macros.h"
@@ -309,6 +310,43 @@ public:
 		i += a.Z * extent.X * extent.Y + a.Y * extent.X + a.X;
 	}
 
+	/*
+		Calls fn(i, y, z) once for every x row of the sub-area, where i is
+		the array index (in this area) of the row's first node, i.e. of
+		(sub.MinEdge.X, y, z).  The row is sub extent X nodes long and
+		contiguous in memory, so callers can march a raw pointer over it.
+		Rows are visited in memory order (y inner, z outer).  sub must be
+		contained in this area.
+	*/
+	template <typename F>
+	void forEachXRow(const VoxelArea &sub, F &&fn) const
+	{
+		for (s16 z = sub.MinEdge.Z; z <= sub.MaxEdge.Z; z++) {
+			u32 i = index(sub.MinEdge.X, sub.MinEdge.Y, z);
+			for (s16 y = sub.MinEdge.Y; y <= sub.MaxEdge.Y;
+					y++, i += m_cache_extent.X) {
+				fn(i, y, z);
+			}
+		}
+	}
+
+	template <typename F>
+	void forEachXRow(F &&fn) const
+	{
+		forEachXRow(*this, std::forward<F>(fn));
+	}
+
+	/*
+		Calls fn(z_min, z_max) for consecutive, disjoint Z slabs that
+		together cover [MinEdge.Z, MaxEdge.Z], distributing the slabs over
+		the global thread pool when it is running (and inline otherwise).
+		Blocks until all slabs have completed.  fn must be safe to run
+		concurrently on disjoint slabs, which holds for the typical volume
+		pass that only touches nodes within its own Z range.
+	*/
+	void forEachZSlab(const std::function<void(s16 z_min, s16 z_max)> &fn,
+			u32 max_tasks = 4) const;
+
 	/*
 		Print method for debugging
 	*/
@@ -465,6 +503,20 @@ public:
 
 	void addArea(const VoxelArea &area);
 
+	/*
+		Pre-grows the covered area to include the given one with a single
+		allocation. The new space holds no data (VOXELFLAG_NO_DATA), just
+		like space added by addArea(). Callers that know the extents they
+		are going to cover should reserve them up front; every later
+		addArea() inside the reservation (including the implicit ones in
+		getNode()/setNode()) is then a cheap containment check instead of
+		a relayout copy of all existing data.
+	*/
+	void reserveArea(const VoxelArea &area)
+	{
+		addArea(area);
+	}
+
 	/*
 		Copy data and set flags to 0
 		dst_area.getExtent() <= src_area.getExtent()
@@ -476,6 +528,24 @@ public:
 	void copyTo(MapNode *dst, const VoxelArea& dst_area,
 			v3s16 dst_pos, v3s16 from_pos, const v3s16 &size);
 
+	/*
+		Returns true if copyTo would not change dst, i.e. every node of
+		this manipulator in the given area is either CONTENT_IGNORE or
+		already equal to the destination
+	*/
+	bool equalsTo(const MapNode *dst, const VoxelArea &dst_area,
+			v3s16 dst_pos, v3s16 from_pos, const v3s16 &size);
+
+	// Same, but against an area consisting of a single repeated node
+	bool equalsToUniform(const MapNode &dst_node, v3s16 from_pos,
+			const v3s16 &size);
+
+	/*
+		Fill an area with one node and mark it as existing data;
+		the counterpart of copyFrom for homogeneous sources
+	*/
+	void fill(const MapNode &n, v3s16 to_pos, const v3s16 &size);
+
 	/*
 		Algorithms
 	*/
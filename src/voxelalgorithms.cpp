@@ -74,6 +74,16 @@ struct ChangingLight {
 	{}
 };
 
+/*!
+ * Recycled backing storage for the LightQueue vectors. Relights run many
+ * times per step and the frontier allocations would otherwise outweigh
+ * the actual light math; each thread keeps its freed vectors around for
+ * the next LightQueue it constructs.
+ */
+static thread_local std::vector<std::vector<ChangingLight>> light_scratch_pool;
+//! Scratch vectors that grew beyond this many elements are not kept.
+static const size_t LIGHT_SCRATCH_CAPACITY_MAX = 1 << 15;
+
 /*!
  * A fast, priority queue-like container to contain ChangingLights.
  * The ChangingLights are ordered by the given light levels.
@@ -93,10 +103,36 @@ struct LightQueue {
 	{
 		max_light = LIGHT_SUN;
 		for (u8 i = 0; i <= LIGHT_SUN; i++) {
-			lights[i].reserve(reserve);
+			if (!light_scratch_pool.empty()) {
+				lights[i] = std::move(light_scratch_pool.back());
+				light_scratch_pool.pop_back();
+			}
+			if (lights[i].capacity() < reserve)
+				lights[i].reserve(reserve);
+		}
+	}
+
+	LightQueue(LightQueue &&other) :
+		max_light(other.max_light)
+	{
+		for (u8 i = 0; i <= LIGHT_SUN; i++)
+			lights[i] = std::move(other.lights[i]);
+	}
+
+	~LightQueue()
+	{
+		// Donate the allocations to the next relight on this thread
+		for (u8 i = 0; i <= LIGHT_SUN; i++) {
+			if (lights[i].capacity() == 0 ||
+					lights[i].capacity() > LIGHT_SCRATCH_CAPACITY_MAX)
+				continue;
+			lights[i].clear();
+			light_scratch_pool.push_back(std::move(lights[i]));
 		}
 	}
 
+	DISABLE_CLASS_COPY(LightQueue)
+
 	/*!
 	 * Returns the next brightest ChangingLight and
 	 * removes it from the queue.
@@ -693,7 +729,29 @@ void update_block_border_lighting(Map *map, MapBlock *block,
 {
 	const NodeDefManager *ndef = map->getNodeDefManager();
 	bool is_valid_position;
-	for (LightBank bank : banks) {
+
+	// Fetch the neighbors once and determine from the persisted per-face
+	// "lighting complete" flags which boundaries actually need a relight.
+	// Terrain that was fully lit when it was saved proves completeness on
+	// both sides of every face, making the whole update a no-op.
+	MapBlock *others[6];
+	u8 incomplete[2] = {0, 0}; // per bank, bit d = face d needs a relight
+	for (direction d = 0; d < 6; d++) {
+		v3s16 otherpos = block->getPos() + neighbor_dirs[d];
+		others[d] = map->getBlockNoCreateNoEx(otherpos);
+		if (others[d] == NULL)
+			continue;
+		for (u8 b = 0; b < 2; b++) {
+			if (!block->isLightingComplete(banks[b], d) ||
+					!others[d]->isLightingComplete(banks[b], 5 - d))
+				incomplete[b] |= 1 << d;
+		}
+	}
+	if (incomplete[0] == 0 && incomplete[1] == 0)
+		return;
+
+	for (u8 b = 0; b < 2; b++) {
+		LightBank bank = banks[b];
 		// Since invalid light is not common, do not allocate
 		// memory if not needed.
 		UnlightQueue disappearing_lights(0);
@@ -701,16 +759,9 @@ void update_block_border_lighting(Map *map, MapBlock *block,
 		// Get incorrect lights
 		for (direction d = 0; d < 6; d++) {
 			// For each direction
-			// Get neighbor block
-			v3s16 otherpos = block->getPos() + neighbor_dirs[d];
-			MapBlock *other = map->getBlockNoCreateNoEx(otherpos);
-			if (other == NULL) {
-				continue;
-			}
-			// Only update if lighting was not completed.
-			if (block->isLightingComplete(bank, d) &&
-					other->isLightingComplete(bank, 5 - d))
+			if (!(incomplete[b] & (1 << d)))
 				continue;
+			MapBlock *other = others[d];
 			// Reset flags
 			block->setLightingComplete(bank, d, true);
 			other->setLightingComplete(bank, 5 - d, true);